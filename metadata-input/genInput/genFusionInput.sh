@@ -1108,7 +1108,7 @@ verifyFiles()
 #!/bin/bash
 usage(){
 
-    description="Usage: $0 [arg1] [orbit number] [.txt output filepath] [--SQL | --dir]
+    description="Usage: $0 [arg1] [orbit number] [.txt output filepath] [--SQL | --dir | --tar [MISR path dir]]
 
 DESCRIPTION:
 \tThis script generates one single, canonical Basic Fusion input file list. It parses the database given to it through the basicFusion/metadata-input/queries.bash script and orders the files properly.
@@ -1117,16 +1117,20 @@ ARGUMENTS:
 \t[arg1]                        -- The SQLite database made from the scripts in metadata-input/build
 \t[orbit number]                -- The orbit to create the input file list for
 \t[.txt output filepath]        -- The path to place the resulting output file.
-\t[--SQL | --dir]               -- If --SQL, arg1 denotes path to the SQLite database.
+\t[--SQL | --dir | --tar]       -- If --SQL, arg1 denotes path to the SQLite database.
 \t                                 If --dir, arg1 denotes a directory where the files to be used for the BF input generation
 \t                                 reside.
+\t                                 If --tar, arg1 denotes the per-orbit archive.tar file. The files are listed as
+\t                                 archive.tar/member, which basicFusion reads without extracting the archive.
+\t[MISR path dir]               -- With --tar, the directory searched for the MISR HRLL and AGP files named in the
+\t                                 MISR_PATH_FILES.txt member of the archive.
 "
     while read -r line; do
         printf "$line\n"
     done <<< "$description"
 }
 
-if [ "$#" -ne 4 ]; then
+if [ "$#" -ne 4 ] && ! [ "$#" -eq 5 -a "$4" == "--tar" ]; then
     usage
     exit 1
 fi
@@ -1135,6 +1139,7 @@ DB=$1; shift
 ORBIT=$1; shift
 ORDERED="$1"; shift
 INPUT_OPT="$1"; shift
+MISR_PATH_DIR="$1"
 
 UNORDERED="$ORDERED".unorderedDB
 
@@ -1182,6 +1187,31 @@ elif [ $INPUT_OPT == "--dir" ]; then
         fileListings="${fileListings}${file}\n"
     done
 
+    orbitPlusOne=$((ORBIT + 1))
+    MOPLINES=$( printf "$fileListings" | grep "$MOP_RE")
+    CERLINES=$( printf "$fileListings" | grep "$CER_RE")
+    MODLINES=$( printf "$fileListings" | grep "$MOD_RE")
+    ASTLINES=$( printf "$fileListings" | grep "$AST_RE")
+    MISLINES=$( printf "$fileListings" | grep -e "$MIS1_RE" -e "$MIS2_RE" | grep -v "_O[0-9]*${orbitPlusOne}_" )
+elif [ $INPUT_OPT == "--tar" ]; then
+    # Make $DB an absolute path
+    DB="$(cd $(dirname $DB) && pwd)/$(basename $DB)"
+
+    # List the members of the archive, named as archive.tar/member
+    fileListings="$(tar -tf "$DB" | grep -v '/$' | sed "s|^|$DB/|")\n"
+
+    # The MISR HRLL and AGP files are not in the archive. MISR_PATH_FILES.txt names them.
+    if [ -n "$MISR_PATH_DIR" ]; then
+        for pathFile in $(tar -xOf "$DB" --wildcards '*MISR_PATH_FILES*'); do
+            pathFileAbs=$(find "$MISR_PATH_DIR" -name "$pathFile" | head -n 1)
+            if [ -z "$pathFileAbs" ]; then
+                echo "ERROR: Failed to find $pathFile in $MISR_PATH_DIR" >&2
+                exit 1
+            fi
+            fileListings="${fileListings}${pathFileAbs}\n"
+        done
+    fi
+
     orbitPlusOne=$((ORBIT + 1))
     MOPLINES=$( printf "$fileListings" | grep "$MOP_RE")
     CERLINES=$( printf "$fileListings" | grep "$CER_RE")
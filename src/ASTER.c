@@ -31,7 +31,9 @@ int obtain_gain_index(int32 sd_id,short gain_index[15]);
 char* obtain_gain_info(char *whole_string);
 short get_band_index(char *band_index_str);
 short get_gain_stat(char *gain_stat_str);
-int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t VNIRgeoGroupID,char*latname,char*lonname,int32 h4_type,hid_t h5_type,int32 inFileID, hid_t outputFileID, char* granuleAppend);
+int readThenWrite_ASTER_HR_LatLon(BFcontext_t* ctx,hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t VNIRgeoGroupID,char*latname,char*lonname,int32 h4_type,hid_t h5_type,int32 inFileID, hid_t outputFileID, char* granuleAppend);
+static herr_t indexSubsystemLatLon( const BFcontext_t* ctx, hid_t geoGroupID, const char* latname, const char* lonname, const double* lat,
+                                    const double* lon, int numLines, int numPixels );
 
 
 /*
@@ -51,9 +53,10 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
     argv[1] = input granule file path
     argv[2] = NOT USED
     argv[3] = output file name
+    ctx     = The conversion context. ctx->unpack is the radiance output mode (see initContext).
 
  EFFECTS:
-    Modifies the output file denoted by the globla outputFile hid_t variable. 
+    Modifies the output file denoted by ctx->outputFile.
     Allocates spaces as needed.
 
  RETURN:
@@ -62,7 +65,7 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
     RET_SUCCESS     -- Success
 */
 
-int ASTER( char* argv[],int aster_count,int unpack)
+int ASTER( BFcontext_t* ctx, char* argv[],int aster_count )
 {
     /*
         Need to add checks for the existence of the VNIR group.
@@ -73,6 +76,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
     /***************************************************************************
      *                                VARIABLES                                *
      ***************************************************************************/
+    int unpack = ctx->unpack;
     int32 inFileID = 0;
     int32 inHFileID = 0;
     int32 h4_status = 0;
@@ -183,7 +187,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
     /*
      *    * Open the HDF file for reading.
      *       */
-    inHFileID = Hopen(argv[1],DFACC_READ, 0);
+    inHFileID = Hopen(inputFilePath(argv[1]),DFACC_READ, 0);
     if ( inHFileID < 0 )
     {
         WARN_MSG("Failed to open ASTER file.\n\t%s\n", argv[1]);
@@ -229,7 +233,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
     inHFileID = 0;
 
     /* open the input file */
-    inFileID = SDstart( argv[1], DFACC_READ );
+    inFileID = SDstart( inputFilePath(argv[1]), DFACC_READ );
     if ( inFileID < 0 )
     {
         FATAL_MSG("Failed to open the ASTER input file.\n\t%s\n", argv[1]);
@@ -237,6 +241,25 @@ int ASTER( char* argv[],int aster_count,int unpack)
         goto cleanupFail;
     }
 
+    /* Skip scenes outside the BF_TIME_WINDOW, or whose geolocation grid (spanning the scene corners)
+     * does not overlap the BF_BBOX box
+     */
+    {
+        int inside = subsetGranuleTime( argv[1], 3 );
+        if ( inside == 1 )
+            inside = subsetSDSOverlaps( inFileID, "Latitude", "Longitude", DFNT_FLOAT64, 1 );
+        if ( inside == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to check the ASTER scene against the subset.\n");
+            goto cleanupFail;
+        }
+        if ( inside == 0 )
+        {
+            retVal = RET_SUCCESS_NO_PROCESS;
+            goto cleanup;
+        }
+    }
+
 
     /********************************************************************************
      *                                GROUP CREATION                                *
@@ -245,9 +268,12 @@ int ASTER( char* argv[],int aster_count,int unpack)
     /* ASTER root group */
 
     /* MY 2016-12-20: Create the root group when converting the first granule */
-    if(aster_count == 1)
+    /* The first granule written to this file is not necessarily aster_count 1 (e.g. when the
+     * granules of one orbit are distributed over several MPI ranks), so check for the group itself.
+     */
+    if( H5Lexists( ctx->outputFile, "ASTER", H5P_DEFAULT ) <= 0 )
     {
-        createGroup( &outputFile, &ASTERrootGroupID, "ASTER" );
+        createGroup( &ctx->outputFile, &ASTERrootGroupID, "ASTER" );
         if ( ASTERrootGroupID == EXIT_FAILURE )
         {
             FATAL_MSG("Failed to create ASTER root group.\n");
@@ -269,12 +295,12 @@ int ASTER( char* argv[],int aster_count,int unpack)
                                     "For example, 01112010002054 represents January 11th, 2010, "
                                     "at the 0 hour, the 20th minute, the 54th second UTC.";
 
-        if(H5LTset_attribute_string(outputFile,"ASTER",comment_name,comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"ASTER",comment_name,comment_value) <0){
             FATAL_MSG("Failed to add the ASTER comment attribute.\n");
             goto cleanupFail;
         }
 
-        if(H5LTset_attribute_string(outputFile,"ASTER",time_comment_name,time_comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"ASTER",time_comment_name,time_comment_value) <0){
             FATAL_MSG("Failed to add the ASTER time comment attribute.\n");
             goto cleanupFail;
         }
@@ -284,7 +310,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
     else
     {
 
-        ASTERrootGroupID = H5Gopen2(outputFile, "/ASTER",H5P_DEFAULT);
+        ASTERrootGroupID = H5Gopen2(ctx->outputFile, "/ASTER",H5P_DEFAULT);
         if(ASTERrootGroupID <0)
         {
             FATAL_MSG("Failed to open the ASTER root group in the output file.\n");
@@ -603,9 +629,9 @@ int ASTER( char* argv[],int aster_count,int unpack)
         goto cleanupFail;
     }
     // create dataset
-    if ( aster_count == 1 )
+    if ( H5Lexists( ctx->outputFile, pointAngleDimName, H5P_DEFAULT ) <= 0 )
     {    
-        tempDsetID = H5Dcreate2( outputFile, pointAngleDimName, H5T_NATIVE_FLOAT, simplSpace, H5P_DEFAULT, H5P_DEFAULT,
+        tempDsetID = H5Dcreate2( ctx->outputFile, pointAngleDimName, H5T_NATIVE_FLOAT, simplSpace, H5P_DEFAULT, H5P_DEFAULT,
                                        H5P_DEFAULT);
         if ( tempDsetID < 0 )
         {
@@ -614,14 +640,14 @@ int ASTER( char* argv[],int aster_count,int unpack)
             goto cleanupFail;
         }
         // set dataset as a dimension scale
-        status = H5DSset_scale( tempDsetID, "Placeholder" );
+        status = H5DSset_scale( tempDsetID, NULL );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to set dataset as dimension scale.\n");
             goto cleanupFail;
         }
         
-        iStatus = change_dim_attr_NAME_value(tempDsetID);
+        iStatus = change_dim_attr_NAME_value(ctx,tempDsetID);
         if ( iStatus == FAIL )
         {
             FATAL_MSG("Failed to set the NAME attribute for a dimension.\n");
@@ -630,7 +656,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
     }
     else
     {
-        tempDsetID = H5Dopen2( outputFile, pointAngleDimName, H5P_DEFAULT);
+        tempDsetID = H5Dopen2( ctx->outputFile, pointAngleDimName, H5P_DEFAULT);
         if ( tempDsetID < 0 )
         {
             FATAL_MSG("Failed to open dataset.\n");
@@ -663,7 +689,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             goto cleanupFail;
         }
     
-        status = H5DSattach_scale( pointingDsetID, tempDsetID, 0); 
+        status = registerDimScale( ctx, pointingDsetID, tempDsetID, 0); 
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach scale to dataset.\n");
@@ -677,9 +703,9 @@ int ASTER( char* argv[],int aster_count,int unpack)
 
     /* Create a Solar_Geometry dimension (same process as the dimension for pointing_angle) */
 
-    if ( aster_count == 1 )
+    if ( H5Lexists( ctx->outputFile, solarGeomDimName, H5P_DEFAULT ) <= 0 )
     {
-        solarGeomDim = H5Dcreate2( outputFile, solarGeomDimName, H5T_NATIVE_FLOAT, simplSpace, H5P_DEFAULT, H5P_DEFAULT,
+        solarGeomDim = H5Dcreate2( ctx->outputFile, solarGeomDimName, H5T_NATIVE_FLOAT, simplSpace, H5P_DEFAULT, H5P_DEFAULT,
                                        H5P_DEFAULT);
         if ( solarGeomDim < 0 )
         {
@@ -688,14 +714,14 @@ int ASTER( char* argv[],int aster_count,int unpack)
             goto cleanupFail;
         }
 
-        status = H5DSset_scale( solarGeomDim, "Placeholder" );
+        status = H5DSset_scale( solarGeomDim, NULL );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to set dataset as dimension scale.\n");
             goto cleanupFail;
         }
 
-        iStatus = change_dim_attr_NAME_value(solarGeomDim);
+        iStatus = change_dim_attr_NAME_value(ctx,solarGeomDim);
         if ( iStatus == FAIL )
         {
             FATAL_MSG("Failed to set the NAME attribute for a dimension.\n");
@@ -704,7 +730,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
     } 
     else
     {
-        solarGeomDim = H5Dopen2( outputFile, solarGeomDimName, H5P_DEFAULT );
+        solarGeomDim = H5Dopen2( ctx->outputFile, solarGeomDimName, H5P_DEFAULT );
         if ( solarGeomDim < 0 )
         {
             FATAL_MSG("Failed to open dataset.\n");
@@ -800,7 +826,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         goto cleanupFail;
     }
 
-    status = H5DSattach_scale( tempDsetID, solarGeomDim, 0);
+    status = registerDimScale( ctx, tempDsetID, solarGeomDim, 0);
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach scale to dataset.\n");
@@ -832,7 +858,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         goto cleanupFail;
     }
 
-    status = H5DSattach_scale( tempDsetID, solarGeomDim, 0);
+    status = registerDimScale( ctx, tempDsetID, solarGeomDim, 0);
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach scale to dataset.\n");
@@ -847,7 +873,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
 
 
     /* MY 2016-12-20: The following if-block will unpack the ASTER radiance data. I would like to clean up the code a little bit later.*/
-    if(unpack == 1)
+    if(unpack != UNPACK_NONE)
     {
 
         /* table 2-3 at https://lpdaac.usgs.gov/sites/default/files/public/product_documentation/aster_l1t_users_guide.pdf
@@ -904,7 +930,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         {
 
             /* SWIR */
-            imageData4ID = readThenWrite_ASTER_Unpack( SWIRgroupID, "ImageData4",
+            imageData4ID = readThenWrite_ASTER_Unpack( ctx, SWIRgroupID, "ImageData4",
                            DFNT_UINT8, inFileID,unc[gain_index[4]][4] );
             if ( imageData4ID == EXIT_FAILURE )
             {
@@ -913,7 +939,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData5ID = readThenWrite_ASTER_Unpack( SWIRgroupID, "ImageData5",
+            imageData5ID = readThenWrite_ASTER_Unpack( ctx, SWIRgroupID, "ImageData5",
                            DFNT_UINT8, inFileID, unc[gain_index[5]][5] );
             if ( imageData5ID == EXIT_FAILURE )
             {
@@ -923,7 +949,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData6ID = readThenWrite_ASTER_Unpack( SWIRgroupID, "ImageData6",
+            imageData6ID = readThenWrite_ASTER_Unpack( ctx, SWIRgroupID, "ImageData6",
                            DFNT_UINT8, inFileID, unc[gain_index[6]][6]);
             if ( imageData6ID == EXIT_FAILURE )
             {
@@ -932,7 +958,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData7ID = readThenWrite_ASTER_Unpack( SWIRgroupID, "ImageData7",
+            imageData7ID = readThenWrite_ASTER_Unpack( ctx, SWIRgroupID, "ImageData7",
                            DFNT_UINT8, inFileID, unc[gain_index[7]][7] );
             if ( imageData7ID == EXIT_FAILURE )
             {
@@ -942,7 +968,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData8ID = readThenWrite_ASTER_Unpack( SWIRgroupID, "ImageData8",
+            imageData8ID = readThenWrite_ASTER_Unpack( ctx, SWIRgroupID, "ImageData8",
                            DFNT_UINT8, inFileID, unc[gain_index[8]][8]);
             if ( imageData8ID == EXIT_FAILURE )
             {
@@ -952,7 +978,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData9ID = readThenWrite_ASTER_Unpack( SWIRgroupID, "ImageData9",
+            imageData9ID = readThenWrite_ASTER_Unpack( ctx, SWIRgroupID, "ImageData9",
                            DFNT_UINT8, inFileID,unc[gain_index[9]][9]);
             if ( imageData9ID == EXIT_FAILURE )
             {
@@ -965,7 +991,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         /* VNIR */
         if(vnir_grp_ref >0)
         {
-            imageData1ID = readThenWrite_ASTER_Unpack( VNIRgroupID, "ImageData1",
+            imageData1ID = readThenWrite_ASTER_Unpack( ctx, VNIRgroupID, "ImageData1",
                            DFNT_UINT8, inFileID,unc[gain_index[0]][0] );
             if ( imageData1ID == EXIT_FAILURE )
             {
@@ -974,7 +1000,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData2ID = readThenWrite_ASTER_Unpack( VNIRgroupID, "ImageData2",
+            imageData2ID = readThenWrite_ASTER_Unpack( ctx, VNIRgroupID, "ImageData2",
                            DFNT_UINT8, inFileID,unc[gain_index[1]][1] );
             if ( imageData2ID == EXIT_FAILURE )
             {
@@ -984,7 +1010,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData3NID = readThenWrite_ASTER_Unpack( VNIRgroupID, "ImageData3N",
+            imageData3NID = readThenWrite_ASTER_Unpack( ctx, VNIRgroupID, "ImageData3N",
                             DFNT_UINT8, inFileID,unc[gain_index[2]][2] );
             if ( imageData3NID == EXIT_FAILURE )
             {
@@ -1001,7 +1027,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             imageData3Bindex = SDnametoindex(inFileID,"ImageData3B");
             if(imageData3Bindex != FAIL)
             {
-                imageData3BID = readThenWrite_ASTER_Unpack( VNIRgroupID, "ImageData3B",
+                imageData3BID = readThenWrite_ASTER_Unpack( ctx, VNIRgroupID, "ImageData3B",
                                 DFNT_UINT8, inFileID,unc[gain_index[3]][3] );
                 if ( imageData3BID == EXIT_FAILURE )
                 {
@@ -1016,7 +1042,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         /* TIR */
         if ( tir_grp_ref > 0 )
         {
-            imageData10ID = readThenWrite_ASTER_Unpack( TIRgroupID, "ImageData10",
+            imageData10ID = readThenWrite_ASTER_Unpack( ctx, TIRgroupID, "ImageData10",
                             DFNT_UINT16, inFileID,unc[gain_index[10]][10] );
             if ( imageData10ID == EXIT_FAILURE )
             {
@@ -1026,7 +1052,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData11ID = readThenWrite_ASTER_Unpack( TIRgroupID, "ImageData11",
+            imageData11ID = readThenWrite_ASTER_Unpack( ctx, TIRgroupID, "ImageData11",
                             DFNT_UINT16, inFileID, unc[gain_index[11]][11] );
             if ( imageData11ID == EXIT_FAILURE )
             {
@@ -1036,7 +1062,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData12ID = readThenWrite_ASTER_Unpack( TIRgroupID, "ImageData12",
+            imageData12ID = readThenWrite_ASTER_Unpack( ctx, TIRgroupID, "ImageData12",
                             DFNT_UINT16, inFileID, unc[gain_index[12]][12] );
             if ( imageData12ID == EXIT_FAILURE )
             {
@@ -1046,7 +1072,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData13ID = readThenWrite_ASTER_Unpack( TIRgroupID, "ImageData13",
+            imageData13ID = readThenWrite_ASTER_Unpack( ctx, TIRgroupID, "ImageData13",
                             DFNT_UINT16, inFileID, unc[gain_index[12]][12] );
             if ( imageData13ID == EXIT_FAILURE )
             {
@@ -1056,7 +1082,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
 
-            imageData14ID = readThenWrite_ASTER_Unpack( TIRgroupID, "ImageData14",
+            imageData14ID = readThenWrite_ASTER_Unpack( ctx, TIRgroupID, "ImageData14",
                             DFNT_UINT16, inFileID,unc[gain_index[13]][13] );
             if ( imageData14ID == EXIT_FAILURE )
             {
@@ -1071,7 +1097,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
     {
         if ( swir_grp_ref > 0 )
         {
-            imageData4ID = readThenWrite(NULL, SWIRgroupID, "ImageData4",
+            imageData4ID = readThenWrite(ctx,NULL, SWIRgroupID, "ImageData4",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData4ID == EXIT_FAILURE )
             {
@@ -1080,7 +1106,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData5ID = readThenWrite(NULL, SWIRgroupID, "ImageData5",
+            imageData5ID = readThenWrite(ctx,NULL, SWIRgroupID, "ImageData5",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData5ID == EXIT_FAILURE )
             {
@@ -1089,7 +1115,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData6ID = readThenWrite(NULL, SWIRgroupID, "ImageData6",
+            imageData6ID = readThenWrite(ctx,NULL, SWIRgroupID, "ImageData6",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData6ID == EXIT_FAILURE )
             {
@@ -1098,7 +1124,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData7ID = readThenWrite(NULL, SWIRgroupID, "ImageData7",
+            imageData7ID = readThenWrite(ctx,NULL, SWIRgroupID, "ImageData7",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData7ID == EXIT_FAILURE )
             {
@@ -1107,7 +1133,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData8ID = readThenWrite(NULL, SWIRgroupID, "ImageData8",
+            imageData8ID = readThenWrite(ctx,NULL, SWIRgroupID, "ImageData8",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData8ID == EXIT_FAILURE )
             {
@@ -1116,7 +1142,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData9ID = readThenWrite(NULL, SWIRgroupID, "ImageData9",
+            imageData9ID = readThenWrite(ctx,NULL, SWIRgroupID, "ImageData9",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData9ID == EXIT_FAILURE )
             {
@@ -1129,7 +1155,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         /* VNIR */
         if(vnir_grp_ref >0)
         {
-            imageData1ID = readThenWrite(NULL, VNIRgroupID, "ImageData1",
+            imageData1ID = readThenWrite(ctx,NULL, VNIRgroupID, "ImageData1",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData1ID == EXIT_FAILURE )
             {
@@ -1139,7 +1165,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
 
             }
 
-            imageData2ID = readThenWrite(NULL, VNIRgroupID, "ImageData2",
+            imageData2ID = readThenWrite(ctx,NULL, VNIRgroupID, "ImageData2",
                                          DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData2ID == EXIT_FAILURE )
             {
@@ -1148,7 +1174,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData3NID = readThenWrite(NULL, VNIRgroupID, "ImageData3N",
+            imageData3NID = readThenWrite(ctx,NULL, VNIRgroupID, "ImageData3N",
                                           DFNT_UINT8, H5T_STD_U8LE, inFileID,1 );
             if ( imageData3NID == EXIT_FAILURE )
             {
@@ -1165,7 +1191,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             if(imageData3Bindex != FAIL)
             {
 
-                imageData3BID = readThenWrite(NULL, VNIRgroupID, "ImageData3B",
+                imageData3BID = readThenWrite(ctx,NULL, VNIRgroupID, "ImageData3B",
                                               DFNT_UINT8, H5T_STD_U8LE, inFileID,1);
                 if ( imageData3BID == EXIT_FAILURE )
                 {
@@ -1181,7 +1207,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         /* TIR */
         if ( tir_grp_ref > 0 )
         {
-            imageData10ID = readThenWrite(NULL, TIRgroupID, "ImageData10",
+            imageData10ID = readThenWrite(ctx,NULL, TIRgroupID, "ImageData10",
                                           DFNT_UINT16, H5T_STD_U16LE, inFileID,1 );
             if ( imageData10ID == EXIT_FAILURE )
             {
@@ -1190,7 +1216,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData11ID = readThenWrite(NULL, TIRgroupID, "ImageData11",
+            imageData11ID = readThenWrite(ctx,NULL, TIRgroupID, "ImageData11",
                                           DFNT_UINT16, H5T_STD_U16LE, inFileID,1 );
             if ( imageData11ID == EXIT_FAILURE )
             {
@@ -1199,7 +1225,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData12ID = readThenWrite(NULL, TIRgroupID, "ImageData12",
+            imageData12ID = readThenWrite(ctx,NULL, TIRgroupID, "ImageData12",
                                           DFNT_UINT16, H5T_STD_U16LE, inFileID,1 );
             if ( imageData12ID == EXIT_FAILURE )
             {
@@ -1208,7 +1234,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData13ID = readThenWrite(NULL, TIRgroupID, "ImageData13",
+            imageData13ID = readThenWrite(ctx,NULL, TIRgroupID, "ImageData13",
                                           DFNT_UINT16, H5T_STD_U16LE, inFileID,1 );
             if ( imageData13ID == EXIT_FAILURE )
             {
@@ -1217,7 +1243,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 goto cleanupFail;
             }
 
-            imageData14ID = readThenWrite(NULL, TIRgroupID, "ImageData14",
+            imageData14ID = readThenWrite(ctx,NULL, TIRgroupID, "ImageData14",
                                           DFNT_UINT16, H5T_STD_U16LE, inFileID,1 );
             if ( imageData14ID == EXIT_FAILURE )
             {
@@ -1248,7 +1274,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(VNIRgroupID, radianceNames[i],"_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(VNIRgroupID, radianceNames[i],"_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add VNIR radiance _FillValue attribute.\n");
@@ -1256,7 +1282,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(VNIRgroupID, radianceNames[i],"valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(VNIRgroupID, radianceNames[i],"valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add VNIR radiance valid_min attribute.\n");
@@ -1264,7 +1290,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = 569.0;
-        status = H5LTset_attribute_float(VNIRgroupID, radianceNames[i],"valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(VNIRgroupID, radianceNames[i],"valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add VNIR radiance valid_max attribute.\n");
@@ -1287,7 +1313,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(SWIRgroupID, radianceNames[i+4],"_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(SWIRgroupID, radianceNames[i+4],"_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add SWIR radiance _FillValue attribute.\n");
@@ -1295,7 +1321,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(SWIRgroupID, radianceNames[i+4],"valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(SWIRgroupID, radianceNames[i+4],"valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add SWIR radiance valid_min attribute.\n");
@@ -1303,7 +1329,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = 569.0;
-        status = H5LTset_attribute_float(SWIRgroupID, radianceNames[i+4],"valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(SWIRgroupID, radianceNames[i+4],"valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add SWIR radiance valid_max attribute.\n");
@@ -1323,7 +1349,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             goto cleanupFail;
         }
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(TIRgroupID, radianceNames[i+10],"_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(TIRgroupID, radianceNames[i+10],"_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add TIR radiance _FillValue attribute.\n");
@@ -1331,7 +1357,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(TIRgroupID, radianceNames[i+10],"valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(TIRgroupID, radianceNames[i+10],"valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add TIR radiance valid_min attribute.\n");
@@ -1339,7 +1365,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
 
         fltTemp = 569.0;
-        status = H5LTset_attribute_float(TIRgroupID, radianceNames[i+10],"valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(TIRgroupID, radianceNames[i+10],"valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add TIR radiance valid_max attribute.\n");
@@ -1351,19 +1377,19 @@ int ASTER( char* argv[],int aster_count,int unpack)
     // Copy the dimensions
     if(vnir_grp_ref >0)
     {
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData1", outputFile, imageData1ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData1", ctx->outputFile, imageData1ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData2", outputFile, imageData2ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData2", ctx->outputFile, imageData2ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData3N", outputFile, imageData3NID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData3N", ctx->outputFile, imageData3NID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
@@ -1371,7 +1397,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         }
         if ( imageData3BID)
         {
-            errStatus = copyDimension(granuleSuffix, inFileID, "ImageData3B", outputFile, imageData3BID);
+            errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData3B", ctx->outputFile, imageData3BID);
             if ( errStatus == FAIL )
             {
                 FATAL_MSG("Failed to copy dimensions.\n");
@@ -1382,37 +1408,37 @@ int ASTER( char* argv[],int aster_count,int unpack)
 
     if ( swir_grp_ref > 0 )
     {
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData4", outputFile, imageData4ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData4", ctx->outputFile, imageData4ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData5", outputFile, imageData5ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData5", ctx->outputFile, imageData5ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData6", outputFile, imageData6ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData6", ctx->outputFile, imageData6ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData7", outputFile, imageData7ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData7", ctx->outputFile, imageData7ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData8", outputFile, imageData8ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData8", ctx->outputFile, imageData8ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData9", outputFile, imageData9ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData9", ctx->outputFile, imageData9ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
@@ -1422,31 +1448,31 @@ int ASTER( char* argv[],int aster_count,int unpack)
 
     if ( tir_grp_ref > 0 )
     {
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData10", outputFile, imageData10ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData10", ctx->outputFile, imageData10ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData11", outputFile, imageData11ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData11", ctx->outputFile, imageData11ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData12", outputFile, imageData12ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData12", ctx->outputFile, imageData12ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData13", outputFile, imageData13ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData13", ctx->outputFile, imageData13ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
             goto cleanupFail;
         }
-        errStatus = copyDimension(granuleSuffix, inFileID, "ImageData14", outputFile, imageData14ID);
+        errStatus = copyDimension(ctx,granuleSuffix, inFileID, "ImageData14", ctx->outputFile, imageData14ID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions.\n");
@@ -1456,7 +1482,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
 
 
     /* geolocation */
-    latDataID = readThenWrite(NULL, geoGroupID, "Latitude",
+    latDataID = readThenWrite(ctx,NULL, geoGroupID, "Latitude",
                               DFNT_FLOAT64, H5T_NATIVE_DOUBLE, inFileID,0 );
     if ( latDataID == EXIT_FAILURE )
     {
@@ -1464,7 +1490,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         latDataID = 0;
         goto cleanupFail;
     }
-    errStatus = copyDimension( NULL, inFileID, "Latitude", outputFile, latDataID);
+    errStatus = copyDimension( ctx, NULL, inFileID, "Latitude", ctx->outputFile, latDataID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
@@ -1479,7 +1505,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         goto cleanupFail;
     }
 
-    lonDataID = readThenWrite(NULL, geoGroupID, "Longitude",
+    lonDataID = readThenWrite(ctx,NULL, geoGroupID, "Longitude",
                               DFNT_FLOAT64, H5T_NATIVE_DOUBLE, inFileID,0 );
     if ( lonDataID == EXIT_FAILURE )
     {
@@ -1487,7 +1513,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
         lonDataID = 0;
         goto cleanupFail;
     }
-    errStatus = copyDimension( NULL, inFileID, "Longitude", outputFile, lonDataID);
+    errStatus = copyDimension( ctx, NULL, inFileID, "Longitude", ctx->outputFile, lonDataID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
@@ -1501,8 +1527,15 @@ int ASTER( char* argv[],int aster_count,int unpack)
         goto cleanupFail;
     }
 
+    /* The granule box. The subsystems are indexed by readThenWrite_ASTER_HR_LatLon. */
+    if ( indexGeolocation( ctx, "ASTER", geoGroupID, "Latitude", "Longitude", SPATIAL_UNIT_ALL ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to index the ASTER geolocation.\n");
+        goto cleanupFail;
+    }
+
     // Adding high-resolution lat/lon dataset
-    if(unpack == 1)
+    if(unpack != UNPACK_NONE)
     {
 
         if ( swir_grp_ref > 0 )
@@ -1538,7 +1571,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
             }
 
         }
-        iStatus = readThenWrite_ASTER_HR_LatLon(SWIRgeoGroupID,TIRgeoGroupID,VNIRgeoGroupID,"Latitude","Longitude",DFNT_FLOAT64,H5T_NATIVE_DOUBLE,inFileID, outputFile, granuleSuffix);
+        iStatus = readThenWrite_ASTER_HR_LatLon(ctx,SWIRgeoGroupID,TIRgeoGroupID,VNIRgeoGroupID,"Latitude","Longitude",DFNT_FLOAT64,H5T_NATIVE_DOUBLE,inFileID, ctx->outputFile, granuleSuffix);
 
         if ( iStatus == EXIT_FAILURE )
         {
@@ -1727,7 +1760,7 @@ int ASTER( char* argv[],int aster_count,int unpack)
                 }
             }
         } 
-    } // end if ( unpack == 1 )
+    } // end if ( unpack != UNPACK_NONE )
 
 
     /* release identifiers */
@@ -1742,6 +1775,7 @@ cleanupFO:
         retVal = FAIL_OPEN;
     }
 
+cleanup:
     if ( solar_geometryGroup ) H5Gclose(solar_geometryGroup);
     if ( inHFileID ) Vend(inHFileID);
     if ( inHFileID ) Hclose(inHFileID);
@@ -2016,7 +2050,7 @@ int obtain_gain_index(int32 sd_id,short gain_index[15])
     return ret_value;
 }
 
-int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t VNIRgeoGroupID,char*latname,char*lonname,int32 h4_type,hid_t h5_type,int32 inFileID, hid_t outputFileID, char* granuleAppend )
+int readThenWrite_ASTER_HR_LatLon(BFcontext_t* ctx,hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t VNIRgeoGroupID,char*latname,char*lonname,int32 h4_type,hid_t h5_type,int32 inFileID, hid_t outputFileID, char* granuleAppend )
 {
 
     int retVal = 0;
@@ -2159,12 +2193,11 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
         asterLatLonSpherical(latBuffer,lonBuffer,lat_swir_buffer,lon_swir_buffer,nSWIR_ImageLine,nSWIR_ImagePixel);
 
         // SWIR Latitude
-        if (Generate2D_Dataset(SWIRgeoGroupID,latname,h5_type,lat_swir_buffer,SWIR_ImageLine_DimID,SWIR_ImagePixel_DimID,nSWIR_ImageLine,nSWIR_ImagePixel,1)<0)
+        if (Generate2D_Dataset(ctx,SWIRgeoGroupID,latname,h5_type,lat_swir_buffer,SWIR_ImageLine_DimID,SWIR_ImagePixel_DimID,nSWIR_ImageLine,nSWIR_ImagePixel,1)<0)
         {
             FATAL_MSG("Cannot generate 2-D ASTER lat/lon.\n");
             goto cleanupFail;
         }
-        free(lat_swir_buffer); lat_swir_buffer = NULL;
         if(H5LTset_attribute_string(SWIRgeoGroupID,latname,"units","degrees_north")<0)
         {
             FATAL_MSG("Unable to insert ASTER latitude units attribute.\n");
@@ -2172,11 +2205,18 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
         }
 
         //SWIR Longitude
-        if (Generate2D_Dataset(SWIRgeoGroupID,lonname,h5_type,lon_swir_buffer,SWIR_ImageLine_DimID,SWIR_ImagePixel_DimID,nSWIR_ImageLine,nSWIR_ImagePixel,1)<0)
+        if (Generate2D_Dataset(ctx,SWIRgeoGroupID,lonname,h5_type,lon_swir_buffer,SWIR_ImageLine_DimID,SWIR_ImagePixel_DimID,nSWIR_ImageLine,nSWIR_ImagePixel,1)<0)
         {
             FATAL_MSG("Cannot generate 2-D ASTER lat/lon.\n");
             goto cleanupFail;
         }
+        if ( indexSubsystemLatLon( ctx, SWIRgeoGroupID, latname, lonname, lat_swir_buffer, lon_swir_buffer, nSWIR_ImageLine,
+                                   nSWIR_ImagePixel ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to index the ASTER SWIR geolocation.\n");
+            goto cleanupFail;
+        }
+        free(lat_swir_buffer); lat_swir_buffer = NULL;
         free(lon_swir_buffer); lon_swir_buffer = NULL;
         if(H5LTset_attribute_string(SWIRgeoGroupID,lonname,"units","degrees_east")<0)
         {
@@ -2213,12 +2253,11 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
         asterLatLonSpherical(latBuffer,lonBuffer,lat_tir_buffer,lon_tir_buffer,nTIR_ImageLine,nTIR_ImagePixel);
 
         // TIR Latitude
-        if (Generate2D_Dataset(TIRgeoGroupID,latname,h5_type,lat_tir_buffer,TIR_ImageLine_DimID,TIR_ImagePixel_DimID,nTIR_ImageLine,nTIR_ImagePixel,1)<0)
+        if (Generate2D_Dataset(ctx,TIRgeoGroupID,latname,h5_type,lat_tir_buffer,TIR_ImageLine_DimID,TIR_ImagePixel_DimID,nTIR_ImageLine,nTIR_ImagePixel,1)<0)
         {
             FATAL_MSG("Cannot generate 2-D ASTER lat/lon.\n");
             goto cleanupFail;
         }
-        free(lat_tir_buffer); lat_tir_buffer = NULL;
         if(H5LTset_attribute_string(TIRgeoGroupID,latname,"units","degrees_north")<0)
         {
             FATAL_MSG("Unable to insert ASTER latitude units attribute.\n");
@@ -2226,11 +2265,18 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
         }
 
         //TIR Longitude
-        if (Generate2D_Dataset(TIRgeoGroupID,lonname,h5_type,lon_tir_buffer,TIR_ImageLine_DimID,TIR_ImagePixel_DimID,nTIR_ImageLine,nTIR_ImagePixel,1)<0)
+        if (Generate2D_Dataset(ctx,TIRgeoGroupID,lonname,h5_type,lon_tir_buffer,TIR_ImageLine_DimID,TIR_ImagePixel_DimID,nTIR_ImageLine,nTIR_ImagePixel,1)<0)
         {
             FATAL_MSG("Cannot generate 2-D ASTER lat/lon.\n");
             goto cleanupFail;
         }
+        if ( indexSubsystemLatLon( ctx, TIRgeoGroupID, latname, lonname, lat_tir_buffer, lon_tir_buffer, nTIR_ImageLine,
+                                   nTIR_ImagePixel ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to index the ASTER TIR geolocation.\n");
+            goto cleanupFail;
+        }
+        free(lat_tir_buffer); lat_tir_buffer = NULL;
         free(lon_tir_buffer); lon_tir_buffer = NULL;
         if(H5LTset_attribute_string(TIRgeoGroupID,lonname,"units","degrees_east")<0)
         {
@@ -2268,12 +2314,11 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
         asterLatLonSpherical(latBuffer,lonBuffer,lat_vnir_buffer,lon_vnir_buffer,nVNIR_ImageLine,nVNIR_ImagePixel);
 
         // VNIR Latitude
-        if (Generate2D_Dataset(VNIRgeoGroupID,latname,h5_type,lat_vnir_buffer,VNIR_ImageLine_DimID,VNIR_ImagePixel_DimID,nVNIR_ImageLine,nVNIR_ImagePixel,1)<0)
+        if (Generate2D_Dataset(ctx,VNIRgeoGroupID,latname,h5_type,lat_vnir_buffer,VNIR_ImageLine_DimID,VNIR_ImagePixel_DimID,nVNIR_ImageLine,nVNIR_ImagePixel,1)<0)
         {
             FATAL_MSG("Cannot generate 2-D ASTER lat/lon.\n");
             goto cleanupFail;
         }
-        free(lat_vnir_buffer); lat_vnir_buffer = NULL;
         if(H5LTset_attribute_string(VNIRgeoGroupID,latname,"units","degrees_north")<0)
         {
             FATAL_MSG("Unable to insert ASTER latitude units attribute.\n");
@@ -2281,11 +2326,18 @@ int readThenWrite_ASTER_HR_LatLon(hid_t SWIRgeoGroupID,hid_t TIRgeoGroupID,hid_t
         }
 
         //VNIR Longitude
-        if (Generate2D_Dataset(VNIRgeoGroupID,lonname,h5_type,lon_vnir_buffer,VNIR_ImageLine_DimID,VNIR_ImagePixel_DimID,nVNIR_ImageLine,nVNIR_ImagePixel,1)<0)
+        if (Generate2D_Dataset(ctx,VNIRgeoGroupID,lonname,h5_type,lon_vnir_buffer,VNIR_ImageLine_DimID,VNIR_ImagePixel_DimID,nVNIR_ImageLine,nVNIR_ImagePixel,1)<0)
         {
             FATAL_MSG("Cannot generate 2-D ASTER lat/lon.\n");
             goto cleanupFail;
         }
+        if ( indexSubsystemLatLon( ctx, VNIRgeoGroupID, latname, lonname, lat_vnir_buffer, lon_vnir_buffer, nVNIR_ImageLine,
+                                   nVNIR_ImagePixel ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to index the ASTER VNIR geolocation.\n");
+            goto cleanupFail;
+        }
+        free(lat_vnir_buffer); lat_vnir_buffer = NULL;
         free(lon_vnir_buffer); lon_vnir_buffer = NULL;
         if(H5LTset_attribute_string(VNIRgeoGroupID,lonname,"units","degrees_east")<0)
         {
@@ -2330,3 +2382,63 @@ cleanupFail:
     return EXIT_SUCCESS;
 
 }
+
+/*
+                    indexSubsystemLatLon
+    DESCRIPTION:
+        This function adds the high-resolution geolocation of one ASTER subsystem to the spatial index
+        (see indexGeolocationBuffer) while it is still in memory. The whole subsystem is one box.
+    ARGUMENTS:
+        1. ctx        -- The conversion context
+        2. geoGroupID -- The Geolocation group of the subsystem
+        3. latname    -- The name of the latitude dataset
+        4. lonname    -- The name of the longitude dataset
+        5. lat        -- The latitudes
+        6. lon        -- The longitudes
+        7. numLines   -- The number of image lines
+        8. numPixels  -- The number of image pixels
+    EFFECTS:
+        Writes the index table.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t indexSubsystemLatLon( const BFcontext_t* ctx, hid_t geoGroupID, const char* latname, const char* lonname, const double* lat,
+                                    const double* lon, int numLines, int numPixels )
+{
+    ssize_t pathSize = H5Iget_name( geoGroupID, NULL, 0 );
+    char* latPath = NULL;
+    char* lonPath = NULL;
+    herr_t status = FATAL_ERR;
+
+    if ( pathSize < 0 )
+    {
+        FATAL_MSG("Failed to get the size of the path name.\n");
+        return FATAL_ERR;
+    }
+    latPath = calloc( pathSize + strlen(latname) + 2, 1 );
+    lonPath = calloc( pathSize + strlen(lonname) + 2, 1 );
+    if ( latPath == NULL || lonPath == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanup;
+    }
+    if ( H5Iget_name( geoGroupID, latPath, pathSize + 1 ) < 0 )
+    {
+        FATAL_MSG("Failed to retrieve the path name.\n");
+        goto cleanup;
+    }
+    strcpy( lonPath, latPath );
+    strcat( latPath, "/" );
+    strcat( latPath, latname );
+    strcat( lonPath, "/" );
+    strcat( lonPath, lonname );
+
+    status = indexGeolocationBuffer( ctx, "ASTER", latPath, lonPath, lat, lon, numLines, numPixels, SPATIAL_UNIT_ALL );
+
+cleanup:
+    free(latPath);
+    free(lonPath);
+    return status;
+}
@@ -9,7 +9,7 @@
 #define DIM_MAX 10
 
 int obtain_start_end_index(int* sindex_ptr,int* endex_ptr,double *jd,int32 size,OInfo_t orbit_info);
-herr_t CERESinsertAttrs( hid_t objectID, char* long_nameVal, char* unitsVal, float valid_rangeMin, float valid_rangeMax );
+herr_t CERESinsertAttrs( const BFcontext_t* ctx, hid_t objectID, char* long_nameVal, char* unitsVal, float valid_rangeMin, float valid_rangeMax );
 
 /*      CERES()
  *
@@ -17,6 +17,7 @@ herr_t CERESinsertAttrs( hid_t objectID, char* long_nameVal, char* unitsVal, flo
  *      CERES handles copying over all of the data from the CERES input files.
  *
  *  ARGUMENTS:
+ *      ctx             -- The conversion context
  *      argv[0]         -- program name
  *      argv[1]         -- output file name
  *      argv[2]         -- CERES file name
@@ -27,7 +28,7 @@ herr_t CERESinsertAttrs( hid_t objectID, char* long_nameVal, char* unitsVal, flo
  *      c_count         -- The number of elements remaining after subsetting 
  *
  *  EFFECTS:
- *      Modifies the outputFile HDF5 file to contain the appropriate CERES data.
+ *      Modifies the ctx->outputFile HDF5 file to contain the appropriate CERES data.
  *      Allocates memory as needed.
  *
  *  RETURN:
@@ -35,7 +36,7 @@ herr_t CERESinsertAttrs( hid_t objectID, char* long_nameVal, char* unitsVal, flo
  *      FAIL_OPEN       -- Failed to open a file
  *      RET_SUCCESS     -- Success
  */
-int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_stride,int32*c_count)
+int CERES( BFcontext_t* ctx, char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_stride,int32*c_count)
 {
 
 #define NUM_TIME 3
@@ -103,7 +104,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
     char cameraName[4] = {0};
 
     /* open the input file */
-    fileID = SDstart( argv[2], DFACC_READ );
+    fileID = SDstart( inputFilePath(argv[2]), DFACC_READ );
     if ( fileID < 0 )
     {
         WARN_MSG("Unable to open CERES file.\n\t%s\n", argv[2]);
@@ -113,9 +114,9 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
 
     /* Open/create the CERES root group */
 
-    if( H5Lexists(outputFile, "CERES", H5P_DEFAULT) <= 0 )
+    if( H5Lexists(ctx->outputFile, "CERES", H5P_DEFAULT) <= 0 )
     {
-        if ( createGroup( &outputFile, &rootCERES_g, "CERES" ) )
+        if ( createGroup( &ctx->outputFile, &rootCERES_g, "CERES" ) )
         {
             FATAL_MSG("Failed to create CERES root group.\n");
             rootCERES_g = 0;
@@ -127,7 +128,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
                         "of data acquisition in UTC with the YYYYMMDDhh format."
                         " Y: year. M: month. D: day. h: hour. For example, "
                         "2007070316 represents July 3rd, 2007 at the 16th hour UTC.";
-        if(H5LTset_attribute_string(outputFile,"CERES",time_comment_name,time_comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"CERES",time_comment_name,time_comment_value) <0){
             FATAL_MSG("Failed to add the CERES time comment attribute.\n");
             goto cleanupFail;
         }
@@ -135,7 +136,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
     }
     else
     {
-        rootCERES_g =  H5Gopen2( outputFile, "CERES", H5P_DEFAULT );
+        rootCERES_g =  H5Gopen2( ctx->outputFile, "CERES", H5P_DEFAULT );
         if ( rootCERES_g < 0 )
         {
             FATAL_MSG("Unable to open CERES root group.\n");
@@ -283,10 +284,10 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
 
         /* Only do the CERES geolocation unit conversion if transferring lat or lon */
         if ( strstr("Latitude", outTimePosName[i] ) || strstr("Longitude", outTimePosName[i]) )
-            generalDsetID_d = readThenWriteSubset( 1, outTimePosName[i], geolocationID_g, inTimePosName[i], h4Type, h5Type,
+            generalDsetID_d = readThenWriteSubset( ctx, 1, outTimePosName[i], geolocationID_g, inTimePosName[i], h4Type, h5Type,
                                                fileID,c_start,c_stride,c_count);
         else
-            generalDsetID_d = readThenWriteSubset( 0, outTimePosName[i], geolocationID_g, inTimePosName[i], h4Type, h5Type,
+            generalDsetID_d = readThenWriteSubset( ctx, 0, outTimePosName[i], geolocationID_g, inTimePosName[i], h4Type, h5Type,
                                                fileID,c_start,c_stride,c_count);
 
 
@@ -306,11 +307,11 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         // Don't know the difference of this if, else block KY 2017-10-22
         if(index == 1)
         {
-            status = copyDimensionSubset( dimSuffix, fileID, inTimePosName[i], outputFile, generalDsetID_d, *c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inTimePosName[i], ctx->outputFile, generalDsetID_d, *c_count );
         }
         else
         { 
-            status = copyDimensionSubset( dimSuffix, fileID, inTimePosName[i], outputFile, generalDsetID_d, *c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inTimePosName[i], ctx->outputFile, generalDsetID_d, *c_count );
         }
         if ( status == FAIL )
         {
@@ -325,9 +326,9 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         
         // Ignore the valid_range attribute at CERES.
         if ( strstr("Latitude", outTimePosName[i] ) || strstr("Longitude", outTimePosName[i]) )
-            status = convert_SD_Attrs(fileID,geolocationID_g,NewcorrectName,inTimePosName[i],"valid_range");
+            status = convert_SD_Attrs(ctx,fileID,geolocationID_g,NewcorrectName,inTimePosName[i],"valid_range");
         else 
-            status = convert_SD_Attrs(fileID,geolocationID_g,NewcorrectName,inTimePosName[i],NULL);
+            status = convert_SD_Attrs(ctx,fileID,geolocationID_g,NewcorrectName,inTimePosName[i],NULL);
            
         if ( status != 0 )
         {
@@ -382,6 +383,12 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         }
     }
 
+    if ( indexGeolocation( ctx, "CERES", geolocationID_g, "Latitude", "Longitude", SPATIAL_UNIT_CERES ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to index the CERES geolocation.\n");
+        goto cleanupFail;
+    }
+
     /******************
      * VIEWING ANGLES *
      ******************/
@@ -391,7 +398,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         h4Type = DFNT_FLOAT32;
         h5Type = H5T_NATIVE_FLOAT;
 
-        generalDsetID_d = readThenWriteSubset( 0, outViewingAngles[i], viewingAngleID_g, inViewingAngles[i], h4Type, h5Type, fileID,c_start,c_stride,c_count);
+        generalDsetID_d = readThenWriteSubset( ctx, 0, outViewingAngles[i], viewingAngleID_g, inViewingAngles[i], h4Type, h5Type, fileID,c_start,c_stride,c_count);
         if ( generalDsetID_d == FATAL_ERR )
         {
             FATAL_MSG("Failed to insert \"%s\" dataset.\n", inViewingAngles[i]);
@@ -400,9 +407,9 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         }
 
         if(index == 1)
-            status = copyDimensionSubset( dimSuffix, fileID, inViewingAngles[i], outputFile, generalDsetID_d,*c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inViewingAngles[i], ctx->outputFile, generalDsetID_d,*c_count );
         else
-            status = copyDimensionSubset( dimSuffix, fileID, inViewingAngles[i], outputFile, generalDsetID_d,*c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inViewingAngles[i], ctx->outputFile, generalDsetID_d,*c_count );
         if ( status == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions for %s.\n", inViewingAngles[i] );
@@ -412,7 +419,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         H5Dclose(generalDsetID_d);
         generalDsetID_d = 0;
         char* NewcorrectName = correct_name(outViewingAngles[i]);
-        convert_SD_Attrs(fileID,viewingAngleID_g,NewcorrectName,inViewingAngles[i],NULL);
+        convert_SD_Attrs(ctx,fileID,viewingAngleID_g,NewcorrectName,inViewingAngles[i],NULL);
         free(NewcorrectName);
     }
 
@@ -434,7 +441,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
             h5Type = H5T_NATIVE_INT;
         }
 
-        generalDsetID_d = readThenWriteSubset( 0, outFilteredRadiance[i], radianceID_g, inFilteredRadiance[i], h4Type, h5Type, fileID,c_start,c_stride,c_count);
+        generalDsetID_d = readThenWriteSubset( ctx, 0, outFilteredRadiance[i], radianceID_g, inFilteredRadiance[i], h4Type, h5Type, fileID,c_start,c_stride,c_count);
         if ( generalDsetID_d == FATAL_ERR )
         {
             FATAL_MSG("Failed to insert \"%s\" dataset.\n", inFilteredRadiance[i]);
@@ -443,9 +450,9 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         }
 
         if(index == 1)
-            status = copyDimensionSubset( dimSuffix, fileID, inFilteredRadiance[i], outputFile, generalDsetID_d,*c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inFilteredRadiance[i], ctx->outputFile, generalDsetID_d,*c_count );
         else
-            status = copyDimensionSubset( dimSuffix, fileID, inFilteredRadiance[i], outputFile, generalDsetID_d,*c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inFilteredRadiance[i], ctx->outputFile, generalDsetID_d,*c_count );
         if ( status == FAIL )
         {
             FATAL_MSG("Failed to copy dimensions for %s.\n", inFilteredRadiance[i] );
@@ -455,7 +462,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         H5Dclose(generalDsetID_d);
         generalDsetID_d = 0;
         char* NewcorrectName = correct_name(outFilteredRadiance[i]);
-        convert_SD_Attrs(fileID,radianceID_g,NewcorrectName,inFilteredRadiance[i],NULL);
+        convert_SD_Attrs(ctx,fileID,radianceID_g,NewcorrectName,inFilteredRadiance[i],NULL);
 
         free(NewcorrectName);
     }
@@ -469,7 +476,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         h4Type = DFNT_FLOAT32;
         h5Type = H5T_NATIVE_FLOAT;
 
-        generalDsetID_d = readThenWriteSubset( 0, outUnfilteredRadiance[i], radianceID_g, inUnfilteredRadiance[i], h4Type, h5Type, fileID,c_start,c_stride,c_count);
+        generalDsetID_d = readThenWriteSubset( ctx, 0, outUnfilteredRadiance[i], radianceID_g, inUnfilteredRadiance[i], h4Type, h5Type, fileID,c_start,c_stride,c_count);
         if ( generalDsetID_d == FATAL_ERR )
         {
             FATAL_MSG("Failed to insert \"%s\" dataset.\n", inUnfilteredRadiance[i]);
@@ -478,9 +485,9 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         }
 
         if(index == 1)
-            status = copyDimensionSubset( dimSuffix, fileID, inUnfilteredRadiance[i], outputFile, generalDsetID_d,*c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inUnfilteredRadiance[i], ctx->outputFile, generalDsetID_d,*c_count );
         else
-            status = copyDimensionSubset( dimSuffix, fileID, inUnfilteredRadiance[i], outputFile, generalDsetID_d,*c_count );
+            status = copyDimensionSubset( ctx, dimSuffix, fileID, inUnfilteredRadiance[i], ctx->outputFile, generalDsetID_d,*c_count );
 
         if ( status == FAIL )
         {
@@ -491,7 +498,7 @@ int CERES( char* argv[],int index,int ceres_fm_count,int32*c_start,int32*c_strid
         H5Dclose(generalDsetID_d);
         generalDsetID_d = 0;
         char* NewcorrectName = correct_name(outUnfilteredRadiance[i]);
-        convert_SD_Attrs(fileID,radianceID_g,NewcorrectName,inUnfilteredRadiance[i],NULL);
+        convert_SD_Attrs(ctx,fileID,radianceID_g,NewcorrectName,inUnfilteredRadiance[i],NULL);
         free(NewcorrectName);
     }
 
@@ -533,7 +540,7 @@ int CERES_OrbitInfo(char*argv[],int* start_index_ptr,int* end_index_ptr,OInfo_t
     int32 num_attrs;                // number of attributes
 
     char* datasetName = "Time of observation";
-    sd_id = SDstart( argv[2], DFACC_READ );
+    sd_id = SDstart( inputFilePath(argv[2]), DFACC_READ );
     if ( sd_id < 0 )
     {
         FATAL_MSG("Unable to open CERES file.\n\t%s\n", argv[2]);
@@ -606,6 +613,41 @@ int CERES_OrbitInfo(char*argv[],int* start_index_ptr,int* end_index_ptr,OInfo_t
 
 
     }
+
+    /* Keep only the footprints over the BF_BBOX box */
+    if ( bfSubset.useBox && *start_index_ptr >= 0 && *end_index_ptr >= *start_index_ptr )
+    {
+        float* colatBuf = NULL;
+        float* lonBuf = NULL;
+        unsigned int subStart = *start_index_ptr;
+        unsigned int subEnd = *end_index_ptr;
+
+        if ( H4readData( sd_id, "Colatitude of CERES FOV at surface", (void**)&colatBuf, NULL, NULL, DFNT_FLOAT32, NULL, NULL, NULL ) == FATAL_ERR ||
+             H4readData( sd_id, "Longitude of CERES FOV at surface", (void**)&lonBuf, NULL, NULL, DFNT_FLOAT32, NULL, NULL, NULL ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to read the CERES geolocation.\n");
+            SDendaccess(sds_id);
+            SDend(sd_id);
+            if ( colatBuf ) free(colatBuf);
+            if ( lonBuf ) free(lonBuf);
+            if ( julian_date != NULL ) free(julian_date);
+            return FATAL_ERR;
+        }
+
+        if ( subsetTrackRange( colatBuf + subStart, lonBuf + subStart, 1, 1, &subStart, &subEnd ) == RET_SUCCESS_NO_PROCESS )
+        {
+            *start_index_ptr = -1;
+            *end_index_ptr = -1;
+        }
+        else
+        {
+            *start_index_ptr = subStart;
+            *end_index_ptr = subEnd;
+        }
+        free(colatBuf);
+        free(lonBuf);
+    }
+
 #if DEBUG
     printf("starting index is %d\n",*start_index_ptr);
     printf("ending index is %d\n",*end_index_ptr);
@@ -619,106 +661,36 @@ int CERES_OrbitInfo(char*argv[],int* start_index_ptr,int* end_index_ptr,OInfo_t
     return 0;
 
 }
-herr_t CERESinsertAttrs( hid_t objectID, char* long_nameVal, char* unitsVal, float valid_rangeMin, float valid_rangeMax )
+herr_t CERESinsertAttrs( const BFcontext_t* ctx, hid_t objectID, char* long_nameVal, char* unitsVal, float valid_rangeMin, float valid_rangeMax )
 {
 
-    hsize_t dimSize = 0;
-    hid_t attrID = 0;
-    hid_t dataspaceID = 0;
+    attrStage_t stage;
     float floatBuff2[2] = {0.0};
-    herr_t status = 0;
-    /********************* long_name*****************************/
-    attrID = attrCreateString( objectID, "long_name", long_nameVal );
-    if ( attrID == FATAL_ERR )
-    {
-        FATAL_MSG("Cannot create CERES \"long_name\" attribute.\n");
-        return FATAL_ERR;
-    }
-    H5Aclose(attrID);
-    /********************* units ********************************/
-    attrID = attrCreateString( objectID, "units", unitsVal );
-    if ( attrID == FATAL_ERR )
-    {
-        FATAL_MSG("Cannot create CERES \"units\" attribute.\n");
-        return FATAL_ERR;
-    }
-
-    H5Aclose(attrID);
-    /********************* format *******************************/
-    attrID = attrCreateString( objectID, "format", "32-BitFloat" );
-    if ( attrID == FATAL_ERR )
-    {
-        FATAL_MSG("Cannot create CERES \"format\" attribute.\n");
-        return FATAL_ERR;
-    }
-
-    H5Aclose(attrID);
-    /********************* coordsys *****************************/
-    attrID = attrCreateString( objectID, "coordsys", "not used" );
-    if ( attrID == FATAL_ERR )
-    {
-        FATAL_MSG("Cannot create CERES \"coordsys\" attribute.\n");
-        return FATAL_ERR;
-    }
-
-    H5Aclose(attrID);
-    /********************* valid_range **************************/
-    dimSize = 2;
-    dataspaceID = H5Screate_simple( 1, &dimSize, NULL );
-    if ( dataspaceID < 0 )
-    {
-        FATAL_MSG("Failed to create simple dataspace.\n");
-        return FATAL_ERR;
-    }
-    attrID = H5Acreate(objectID, "valid_range", H5T_NATIVE_FLOAT, dataspaceID, H5P_DEFAULT, H5P_DEFAULT );
-    if ( attrID < 0 )
-    {
-        FATAL_MSG("Failed to create CERES \"valid_range\" attribute\n");
-        H5Sclose(dataspaceID);
-        return FATAL_ERR;
-    }
+    float fillValue = 3.4028235e38;
+    const char* format = "32-BitFloat";
+    const char* coordsys = "not used";
 
+    /* The string attributes have the layout of attrCreateString: one element without a terminator */
+    initAttrStage( ctx, &stage, objectID );
     floatBuff2[0] = valid_rangeMin;
     floatBuff2[1] = valid_rangeMax;
-    status = H5Awrite( attrID, H5T_NATIVE_FLOAT, floatBuff2 );
-    if ( status < 0 )
-    {
-        FATAL_MSG("Failed to write to CERES attribute.\n");
-        H5Sclose(dataspaceID);
-        H5Aclose(attrID);
-        return FATAL_ERR;
-    }
-
-    H5Aclose( attrID );
-    H5Sclose(dataspaceID);
-    /********************* _FillValue****************************/
-    dimSize = 1;
-    dataspaceID = H5Screate_simple( 1, &dimSize, NULL );
-    if ( dataspaceID < 0 )
-    {
-        FATAL_MSG("Failed to create simple dataspace.\n");
-        return FATAL_ERR;
-    }
-    attrID = H5Acreate( objectID, "_FillValue", H5T_NATIVE_FLOAT,
-                        dataspaceID, H5P_DEFAULT, H5P_DEFAULT );
-    if ( attrID < 0 )
-    {
-        FATAL_MSG("Failed to create CERES \"valid_range\" attribute\n");
-        H5Sclose(dataspaceID);
+    if ( stageAttr( &stage, "long_name", getStringType( ctx, strlen(long_nameVal) ), 1, long_nameVal ) == FATAL_ERR ||
+         stageAttr( &stage, "units", getStringType( ctx, strlen(unitsVal) ), 1, unitsVal ) == FATAL_ERR ||
+         stageAttr( &stage, "format", getStringType( ctx, strlen(format) ), 1, format ) == FATAL_ERR ||
+         stageAttr( &stage, "coordsys", getStringType( ctx, strlen(coordsys) ), 1, coordsys ) == FATAL_ERR ||
+         stageAttr( &stage, "valid_range", H5T_NATIVE_FLOAT, 2, floatBuff2 ) == FATAL_ERR ||
+         stageAttr( &stage, "_FillValue", H5T_NATIVE_FLOAT, 1, &fillValue ) == FATAL_ERR )
+    {
+        FATAL_MSG("Cannot stage the CERES attributes.\n");
+        discardAttrStage( &stage );
         return FATAL_ERR;
     }
 
-    floatBuff2[0] = 3.4028235e38;
-    status = H5Awrite( attrID, H5T_NATIVE_FLOAT, floatBuff2 );
-    if ( status < 0 )
+    if ( flushAttrStage( &stage ) == FATAL_ERR )
     {
-        FATAL_MSG("Failed to write to CERES attribute.\n");
-        H5Sclose(dataspaceID);
-        H5Aclose(attrID);
+        FATAL_MSG("Cannot write the CERES attributes.\n");
         return FATAL_ERR;
     }
-    H5Aclose( attrID );
-    H5Sclose(dataspaceID);
 
     return RET_SUCCESS;
 
@@ -7,7 +7,7 @@
 
 /* MY(Kent Yang myang6@hdfgroup.org) 2016-12-20, mostly re-write the handling of MISR */
 float Obtain_scale_factor(int32 h4_file_id, char* band_name);
-herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID );
+herr_t blockCentrTme( BFcontext_t* ctx, int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID );
 
 /* May provide a list for all MISR group and variable names */
 
@@ -32,10 +32,11 @@ herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID );
     fileList[11]    -- MISR GP file path
     fileList[12]    -- MISR HRLL file path
 
-    int unpack      -- Determines whether unpacking behavior is enabled.
+    BFcontext_t* ctx -- The conversion context. ctx->unpack is the radiance output mode, UNPACK_NONE,
+                        UNPACK_FLOAT or UNPACK_SCALED (see initContext).
 
  EFFECTS:
-    Modifies the outputFile HDF5 file to contain the appropriate MISR data.
+    Modifies the ctx->outputFile HDF5 file to contain the appropriate MISR data.
     Allocates memory as needed.
 
  RETURN:
@@ -44,12 +45,14 @@ herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID );
     RET_SUCCESS     -- Success
 */
     
-int MISR( char* fileList[],int unpack )
+int MISR( BFcontext_t* ctx, char* fileList[] )
 {
     /****************************************
      *      VARIABLES       *
      ****************************************/
 
+    int unpack = ctx->unpack;
+
     /* File IDs */
 
     char *camera_name[9]= {"AA","AF","AN","BA","BF","CA","CF","DA","DF"};
@@ -182,7 +185,7 @@ int MISR( char* fileList[],int unpack )
      */
     short openFail = 0;
 
-    geoFileID = SDstart( fileList[10], DFACC_READ );
+    geoFileID = SDstart( inputFilePath(fileList[10]), DFACC_READ );
     if ( geoFileID == -1 )
     {
         WARN_MSG("Failed to open MISR file.\n\t%s\n", fileList[10]);
@@ -191,7 +194,7 @@ int MISR( char* fileList[],int unpack )
     }
 
     if(strncmp(fileList[11],misr_geom_miss,strlen(misr_geom_miss))!=0) { 
-    gmpFileID = SDstart( fileList[11], DFACC_READ );
+    gmpFileID = SDstart( inputFilePath(fileList[11]), DFACC_READ );
     if ( gmpFileID == -1 )
     {
         WARN_MSG("Failed to open MISR file.\n\t%s\n", fileList[11]);
@@ -200,7 +203,7 @@ int MISR( char* fileList[],int unpack )
     }
     }
 
-    hgeoFileID = SDstart( fileList[12], DFACC_READ );
+    hgeoFileID = SDstart( inputFilePath(fileList[12]), DFACC_READ );
     if ( hgeoFileID == -1 )
     {
         WARN_MSG("Failed to open MISR file.\n\t%s\n", fileList[12]);
@@ -213,7 +216,7 @@ int MISR( char* fileList[],int unpack )
     { 
         if(misr_camera_miss_ID[i] == 1) 
             continue;
-        h4FileID[i] = SDstart(fileList[i+1],DFACC_READ);
+        h4FileID[i] = SDstart(inputFilePath(fileList[i+1]),DFACC_READ);
         if ( h4FileID[i] < 0 )
         {
             h4FileID[i] = 0;
@@ -225,7 +228,7 @@ int MISR( char* fileList[],int unpack )
         *                     *       */
 
         /* Need to use the H interface to obtain scale_factor */
-        inHFileID[i] = Hopen(fileList[i+1],DFACC_READ, 0);
+        inHFileID[i] = Hopen(inputFilePath(fileList[i+1]),DFACC_READ, 0);
         if(inHFileID[i] <0)
         {
             inHFileID[i] = 0;
@@ -238,11 +241,58 @@ int MISR( char* fileList[],int unpack )
     //if ( openFail ) goto cleanupFO;
     if ( openFail ) goto cleanupFail;
 
-    createGroup( &outputFile, &MISRrootGroupID, "MISR" );
+    /* Find the SOM blocks that overlap the BF_BBOX box from a coarse sample of the AGP geolocation. The
+     * blocks outside of [blockStart, blockStart+blockCount) are not read and are written as fill values,
+     * so that the datasets keep their 180-block layout.
+     */
+    if ( bfSubset.useBox )
+    {
+        int32 agpStart[3]  = {0, 0, 0};
+        int32 agpStride[3] = {1, 8, 8};
+        int32 agpCount[3]  = {SOM_NUM_BLOCKS, 16, 64};
+        double* sampleLat = NULL;
+        double* sampleLon = NULL;
+        size_t blockSize = 16*64;
+        int32 firstBlock = -1;
+        int32 lastBlock = -1;
+
+        if ( H4readData( geoFileID, geo_name[0], (void**)&sampleLat, NULL, NULL, DFNT_FLOAT64,
+                         agpStart, agpStride, agpCount ) == FATAL_ERR ||
+             H4readData( geoFileID, geo_name[1], (void**)&sampleLon, NULL, NULL, DFNT_FLOAT64,
+                         agpStart, agpStride, agpCount ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to read the MISR AGP geolocation.\n");
+            free(sampleLat);
+            free(sampleLon);
+            goto cleanupFail;
+        }
+
+        for ( int32 block = 0; block < SOM_NUM_BLOCKS; block++ )
+        {
+            if ( subsetExtentOverlaps( sampleLat + block*blockSize, sampleLon + block*blockSize, blockSize ) )
+            {
+                if ( firstBlock < 0 ) firstBlock = block;
+                lastBlock = block;
+            }
+        }
+        free(sampleLat);
+        free(sampleLon);
+
+        if ( firstBlock < 0 )
+        {
+            retVal = RET_SUCCESS_NO_PROCESS;
+            goto cleanup;
+        }
+        bfSubset.blockStart = firstBlock;
+        bfSubset.blockCount = lastBlock - firstBlock + 1;
+    }
+
+    createGroup( &ctx->outputFile, &MISRrootGroupID, "MISR" );
     if ( MISRrootGroupID == FATAL_ERR )
     {
         FATAL_MSG("Failed to create MISR root group.\n");
-        return FATAL_ERR;
+        MISRrootGroupID = 0;
+        goto cleanupFail;
     }
 
     { // Comments for MISR descriptions.
@@ -264,24 +314,24 @@ int MISR( char* fileList[],int unpack )
                                    "indicates the data was acquired for orbit 40110.";
                           
 
-        if(H5LTset_attribute_string(outputFile,"MISR",comment_name,comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"MISR",comment_name,comment_value) <0){
             FATAL_MSG("Failed to add the MISR comment attribute.\n");
             goto cleanupFail;
         }
 
-        if(H5LTset_attribute_string(outputFile,"MISR",la_comment_name,la_comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"MISR",la_comment_name,la_comment_value) <0){
             FATAL_MSG("Failed to add the MISR comment attribute.\n");
             goto cleanupFail;
         }
 
 
-        if(H5LTset_attribute_string(outputFile,"MISR",time_comment_name,time_comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"MISR",time_comment_name,time_comment_value) <0){
             FATAL_MSG("Failed to add the MISR time comment attribute.\n");
             goto cleanupFail;
         }
  
     }
-    if(H5LTset_attribute_string(outputFile,"MISR","GranuleName",granList)<0)
+    if(H5LTset_attribute_string(ctx->outputFile,"MISR","GranuleName",granList)<0)
     {
         FATAL_MSG("Cannot add granule list.\n");
         goto cleanupFail;
@@ -294,7 +344,7 @@ int MISR( char* fileList[],int unpack )
     else {
     // Extract the time substring from the file path
     fileTime = getTime( fileList[1], 4 );
-    if(H5LTset_attribute_string(outputFile,"MISR","GranuleTime",fileTime)<0)
+    if(H5LTset_attribute_string(ctx->outputFile,"MISR","GranuleTime",fileTime)<0)
     {
         FATAL_MSG("Cannot add the time stamp\n");
         goto cleanupFail;
@@ -318,7 +368,7 @@ int MISR( char* fileList[],int unpack )
     }
 
 
-    latitudeID  = readThenWrite( NULL,geoGroupID,geo_name[0],DFNT_FLOAT32,H5T_NATIVE_FLOAT,geoFileID,1);
+    latitudeID  = readThenWrite( ctx, NULL,geoGroupID,geo_name[0],DFNT_FLOAT32,H5T_NATIVE_FLOAT,geoFileID,1);
     if ( latitudeID == FATAL_ERR )
     {
         FATAL_MSG("MISR readThenWrite function failed (latitude dataset).\n");
@@ -357,7 +407,7 @@ int MISR( char* fileList[],int unpack )
     }
 
     // Copy over the dimensions
-    errStatus = copyDimension( NULL, geoFileID, geo_name[0], outputFile, latitudeID);
+    errStatus = copyDimension( ctx, NULL, geoFileID, geo_name[0], ctx->outputFile, latitudeID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
@@ -368,7 +418,7 @@ int MISR( char* fileList[],int unpack )
     free(correctedName);
     correctedName = NULL;
 
-    longitudeID = readThenWrite( NULL,geoGroupID,geo_name[1],DFNT_FLOAT32,H5T_NATIVE_FLOAT,geoFileID,1);
+    longitudeID = readThenWrite( ctx, NULL,geoGroupID,geo_name[1],DFNT_FLOAT32,H5T_NATIVE_FLOAT,geoFileID,1);
     if ( longitudeID == FATAL_ERR )
     {
         FATAL_MSG("MISR readThenWrite function failed (longitude dataset).\n");
@@ -407,13 +457,20 @@ int MISR( char* fileList[],int unpack )
     }
 
     // Copy over the dimensions
-    errStatus = copyDimension( NULL, geoFileID, geo_name[1], outputFile, longitudeID);
+    errStatus = copyDimension( ctx, NULL, geoFileID, geo_name[1], ctx->outputFile, longitudeID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
         goto cleanupFail;
     }
 
+    /* One box per SOM block. The high-resolution geolocation covers the same blocks. */
+    if ( indexGeolocation( ctx, "MISR", geoGroupID, geo_name[0], geo_name[1], SPATIAL_UNIT_MISR ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to index the MISR geolocation.\n");
+        goto cleanupFail;
+    }
+
     free(correctedName);
     correctedName = NULL;
 
@@ -427,7 +484,7 @@ int MISR( char* fileList[],int unpack )
     }
 
 
-    hr_latitudeID  = readThenWrite( NULL,hr_geoGroupID,geo_name[0],DFNT_FLOAT32,H5T_NATIVE_FLOAT,hgeoFileID,1);
+    hr_latitudeID  = readThenWrite( ctx, NULL,hr_geoGroupID,geo_name[0],DFNT_FLOAT32,H5T_NATIVE_FLOAT,hgeoFileID,1);
     if ( hr_latitudeID == FATAL_ERR )
     {
         FATAL_MSG("MISR readThenWrite function failed (latitude dataset).\n");
@@ -444,7 +501,7 @@ int MISR( char* fileList[],int unpack )
     }
 
     // Copy over the dimensions
-    errStatus = copyDimension( NULL, hgeoFileID, geo_name[0], outputFile, hr_latitudeID);
+    errStatus = copyDimension( ctx, NULL, hgeoFileID, geo_name[0], ctx->outputFile, hr_latitudeID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
@@ -455,7 +512,7 @@ int MISR( char* fileList[],int unpack )
     free(correctedName);
     correctedName = NULL;
 
-    hr_longitudeID = readThenWrite( NULL,hr_geoGroupID,geo_name[1],DFNT_FLOAT32,H5T_NATIVE_FLOAT,hgeoFileID,1);
+    hr_longitudeID = readThenWrite( ctx, NULL,hr_geoGroupID,geo_name[1],DFNT_FLOAT32,H5T_NATIVE_FLOAT,hgeoFileID,1);
     if ( hr_longitudeID == FATAL_ERR )
     {
         FATAL_MSG("MISR readThenWrite function failed (longitude dataset).\n");
@@ -472,7 +529,7 @@ int MISR( char* fileList[],int unpack )
     }
 
     // Copy over the dimensions
-    errStatus = copyDimension( NULL, hgeoFileID, geo_name[1], outputFile, hr_longitudeID);
+    errStatus = copyDimension( ctx, NULL, hgeoFileID, geo_name[1], ctx->outputFile, hr_longitudeID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
@@ -491,7 +548,7 @@ int MISR( char* fileList[],int unpack )
         goto cleanupFail;
     }
 
-    solarAzimuthID = readThenWrite( NULL,gmpSolarGeoGroupID,solar_geom_name[0],DFNT_FLOAT64,H5T_NATIVE_DOUBLE,gmpFileID,0);
+    solarAzimuthID = readThenWrite( ctx, NULL,gmpSolarGeoGroupID,solar_geom_name[0],DFNT_FLOAT64,H5T_NATIVE_DOUBLE,gmpFileID,0);
     if ( solarAzimuthID == FATAL_ERR )
     {
         FATAL_MSG("MISR readThenWrite function failed (solarAzimuth dataset).\n");
@@ -499,7 +556,7 @@ int MISR( char* fileList[],int unpack )
         goto cleanupFail;
     }
     // Copy over the dimensions
-    errStatus = copyDimension( NULL, gmpFileID, solar_geom_name[0], outputFile, solarAzimuthID);
+    errStatus = copyDimension( ctx, NULL, gmpFileID, solar_geom_name[0], ctx->outputFile, solarAzimuthID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
@@ -527,7 +584,7 @@ int MISR( char* fileList[],int unpack )
     free(correctedName);
     correctedName = NULL;
 
-    solarZenithID = readThenWrite( NULL,gmpSolarGeoGroupID,solar_geom_name[1],DFNT_FLOAT64,H5T_NATIVE_DOUBLE,gmpFileID,0);
+    solarZenithID = readThenWrite( ctx, NULL,gmpSolarGeoGroupID,solar_geom_name[1],DFNT_FLOAT64,H5T_NATIVE_DOUBLE,gmpFileID,0);
     if ( solarZenithID == FATAL_ERR )
     {
         FATAL_MSG("MISR readThenWrite function failed (solarZenith dataset).\n");
@@ -536,7 +593,7 @@ int MISR( char* fileList[],int unpack )
     }
 
     // Copy over the dimensions
-    errStatus = copyDimension( NULL, gmpFileID, solar_geom_name[1], outputFile, solarZenithID);
+    errStatus = copyDimension( ctx, NULL, gmpFileID, solar_geom_name[1], ctx->outputFile, solarZenithID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimensions.\n");
@@ -616,7 +673,7 @@ int MISR( char* fileList[],int unpack )
         {
 
             // If we choose to unpack the data.
-            if(unpack == 1)
+            if(unpack != UNPACK_NONE)
             {
 
                 float scale_factor = -1.;
@@ -627,7 +684,7 @@ int MISR( char* fileList[],int unpack )
                     goto cleanupFail;
                 }
                 if(has_LAI_DIM1 == 0) {
-                    has_LAI_DIM1 = H5Lexists(outputFile,"/MISR_LA_POS_DIM",H5P_DEFAULT);
+                    has_LAI_DIM1 = H5Lexists(ctx->outputFile,"/MISR_LA_POS_DIM",H5P_DEFAULT);
                     if(has_LAI_DIM1 <0) {
                         FATAL_MSG("Failed to check MISR Low Accuracy Position dimension .\n)");
                         goto cleanupFail;
@@ -635,7 +692,7 @@ int MISR( char* fileList[],int unpack )
                     
                 }
                 // Pass LAI_DIM1
-                h5DataFieldID =  readThenWrite_MISR_Unpack( h5DataGroupID, camera_name[i],radiance_name[j],  &correctedName,DFNT_UINT16,
+                h5DataFieldID =  readThenWrite_MISR_Unpack( ctx, h5DataGroupID, camera_name[i],radiance_name[j],  &correctedName,DFNT_UINT16,
                                  h4FileID[i],scale_factor,&has_LAI_DIM1);
                 if ( h5DataFieldID == FATAL_ERR )
                 {
@@ -650,7 +707,7 @@ int MISR( char* fileList[],int unpack )
             {
                 //correctedName = correct_name(radiance_name[j]);
 
-                h5DataFieldID =  readThenWrite( NULL, h5DataGroupID, radiance_name[j], DFNT_UINT16,
+                h5DataFieldID =  readThenWrite( ctx, NULL, h5DataGroupID, radiance_name[j], DFNT_UINT16,
                                                 H5T_NATIVE_USHORT,h4FileID[i],1);
                 if ( h5DataFieldID == FATAL_ERR )
                 {
@@ -666,7 +723,7 @@ int MISR( char* fileList[],int unpack )
             if ( correctedName == NULL )
                 correctedName = correct_name(radiance_name[j]);
 
-          if(unpack == 1) {
+          if(unpack != UNPACK_NONE) {
             status = H5LTset_attribute_string( h5DataGroupID, correctedName, "coordinates", LRcoord );
             if ( status < 0 )
             {
@@ -681,7 +738,7 @@ int MISR( char* fileList[],int unpack )
                 goto cleanupFail;
             }
 
-            errStatus = H5LTset_attribute_float( h5DataGroupID, correctedName,"_FillValue",&tempFloat,1);
+            errStatus = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float( h5DataGroupID, correctedName,"_FillValue",&tempFloat,1);
 
             if ( errStatus < 0 )
             {
@@ -691,7 +748,7 @@ int MISR( char* fileList[],int unpack )
 
             tempFloat = 0.0;
 
-            errStatus = H5LTset_attribute_float( h5DataGroupID, correctedName,"valid_min",&tempFloat,1);
+            errStatus = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float( h5DataGroupID, correctedName,"valid_min",&tempFloat,1);
 
             if ( errStatus < 0 )
             {
@@ -701,7 +758,7 @@ int MISR( char* fileList[],int unpack )
 
             tempFloat = 800.0;
 
-            errStatus = H5LTset_attribute_float( h5DataGroupID, correctedName,"valid_max",&tempFloat,1);
+            errStatus = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float( h5DataGroupID, correctedName,"valid_max",&tempFloat,1);
 
             if ( errStatus < 0 )
             {
@@ -717,35 +774,35 @@ int MISR( char* fileList[],int unpack )
 
                 // We have to create our own dimensions. Here just use the hard-coded dimensions to avoid a massive dimension retrieval routine calls.
                 // No need to create the the first dimension since the block number is always 180
-                if(attachDimension(outputFile,an_rad_dims[(j-1)*3],h5DataFieldID,0)!=RET_SUCCESS) {
+                if(attachDimension(ctx,ctx->outputFile,an_rad_dims[(j-1)*3],h5DataFieldID,0)!=RET_SUCCESS) {
                    FATAL_MSG("Error attaching MISR AN SOM dimenson.  \n");
                    goto cleanupFail;
                 }
                 hid_t an_xdim_id = 0;
-                if(makePureDim(outputFile,an_rad_dims[(j-1)*3+1],AnXdimDspaceID,H5T_NATIVE_INT,&an_xdim_id)!=RET_SUCCESS) {
+                if(makePureDim(ctx,ctx->outputFile,an_rad_dims[(j-1)*3+1],AnXdimDspaceID,H5T_NATIVE_INT,&an_xdim_id)!=RET_SUCCESS) {
                    FATAL_MSG("Error creating MISR AN X dimenson.  \n");
                    goto cleanupFail;
                 }
                 H5Dclose(an_xdim_id);
-                if(attachDimension(outputFile,an_rad_dims[(j-1)*3+1],h5DataFieldID,1)!=RET_SUCCESS) {
+                if(attachDimension(ctx,ctx->outputFile,an_rad_dims[(j-1)*3+1],h5DataFieldID,1)!=RET_SUCCESS) {
                    FATAL_MSG("Error attaching MISR AN X dimenson.  \n");
                    goto cleanupFail;
                 }
 
                 hid_t an_ydim_id = 0;
-                if(makePureDim(outputFile,an_rad_dims[(j-1)*3+2],AnYdimDspaceID,H5T_NATIVE_INT,&an_ydim_id)!=RET_SUCCESS) {
+                if(makePureDim(ctx,ctx->outputFile,an_rad_dims[(j-1)*3+2],AnYdimDspaceID,H5T_NATIVE_INT,&an_ydim_id)!=RET_SUCCESS) {
                    FATAL_MSG("Error creating MISR AN X dimenson.  \n");
                    goto cleanupFail;
                 }
                 H5Dclose(an_ydim_id);
-                if(attachDimension(outputFile,an_rad_dims[(j-1)*3+2],h5DataFieldID,2)!=RET_SUCCESS) {
+                if(attachDimension(ctx,ctx->outputFile,an_rad_dims[(j-1)*3+2],h5DataFieldID,2)!=RET_SUCCESS) {
                    FATAL_MSG("Error attaching MISR AN X dimenson.  \n");
                    goto cleanupFail;
                 }
 
             }
             else {
-                errStatus = copyDimension( NULL, h4FileID[i], radiance_name[j], outputFile, h5DataFieldID);
+                errStatus = copyDimension( ctx, NULL, h4FileID[i], radiance_name[j], ctx->outputFile, h5DataFieldID);
                 if ( errStatus == FAIL )
                 {
                     FATAL_MSG("Failed to copy dimensions.\n");
@@ -771,7 +828,7 @@ int MISR( char* fileList[],int unpack )
         /* Inserting the "BlueConversionFactor... etc. */
         for (int j = 0; j<4; j++)
         {
-            h5BRFFieldID = readThenWrite( NULL,h5BRFGroupID,BRF_CF_name[j],DFNT_FLOAT32,
+            h5BRFFieldID = readThenWrite( ctx, NULL,h5BRFGroupID,BRF_CF_name[j],DFNT_FLOAT32,
                                                  H5T_NATIVE_FLOAT,h4FileID[i],0);
             if ( h5BRFFieldID == FATAL_ERR )
             {
@@ -781,7 +838,7 @@ int MISR( char* fileList[],int unpack )
             }
 
             // Copy over the dimensions
-            errStatus = copyDimension( NULL, h4FileID[i], BRF_CF_name[j], outputFile, h5BRFFieldID);
+            errStatus = copyDimension( ctx, NULL, h4FileID[i], BRF_CF_name[j], ctx->outputFile, h5BRFFieldID);
             if ( errStatus == FAIL )
             {
                 FATAL_MSG("Failed to copy dimensions.\n");
@@ -811,7 +868,7 @@ int MISR( char* fileList[],int unpack )
         /* Inserting the "AaAzimuth", "AaGlitter", "AaScatter"... etc. */
         for (int j = 0; j<4; j++)
         {
-            h5SensorGeomFieldID = readThenWrite( NULL,h5SensorGeomGroupID,band_geom_name[i*4+j],DFNT_FLOAT64,
+            h5SensorGeomFieldID = readThenWrite( ctx, NULL,h5SensorGeomGroupID,band_geom_name[i*4+j],DFNT_FLOAT64,
                                                  H5T_NATIVE_DOUBLE,gmpFileID,0);
             if ( h5SensorGeomFieldID == FATAL_ERR )
             {
@@ -821,7 +878,7 @@ int MISR( char* fileList[],int unpack )
             }
 
             // Copy over the dimensions
-            errStatus = copyDimension( NULL, gmpFileID, band_geom_name[i*4+j], outputFile, h5SensorGeomFieldID);
+            errStatus = copyDimension( ctx, NULL, gmpFileID, band_geom_name[i*4+j], ctx->outputFile, h5SensorGeomFieldID);
             if ( errStatus == FAIL )
             {
                 FATAL_MSG("Failed to copy dimensions.\n");
@@ -860,7 +917,7 @@ int MISR( char* fileList[],int unpack )
         /******************************************************/
         /* Insert the "perBlockMetadataTime" into output file */
         /******************************************************/
-        status = blockCentrTme( inHFileID[i], h5CameraGroupID, outputFile);    
+        status = blockCentrTme( ctx, inHFileID[i], h5CameraGroupID, ctx->outputFile);    
         if ( status == FATAL_ERR )
         {
             FATAL_MSG("Failed to create the BlockCenterTime dataset.\n");
@@ -902,8 +959,8 @@ cleanupFO:
         retVal = FAIL_OPEN;
     }
 
-
-
+cleanup:
+    bfSubset.blockCount = 0;
     if (MISRrootGroupID)        H5Gclose(MISRrootGroupID);
     if ( geoFileID )            SDend(geoFileID);
     if ( hgeoFileID )           SDend(hgeoFileID);
@@ -1158,18 +1215,19 @@ float Obtain_scale_factor(int32 h4_file_id, char* band_name)
 
  ARGUMENTS:
     IN
+        BFcontext_t* ctx    -- The conversion context
         int32 inHFileID     -- The input HDF4 H identifier where the BlockCenterTime Vdata will be found
         hid_t BCTgroupID    -- Where the output BlockCenterTime dataset will go
         hid_t dimGroupID    -- Where the corresponding dimension will be placed (if it does not already exist)
 
  EFFECTS:
-    Adds 1 dataset and 1 dimension to the output HDF5 file "outputFile" (which is a global variable)
+    Adds 1 dataset and 1 dimension to the output HDF5 file ctx->outputFile
 
  RETURN:
     RET_SUCCESS
     FATAL_ERR
 */
-herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID )
+herr_t blockCentrTme( BFcontext_t* ctx, int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID )
 {
     
     const char* perBlockMet = "PerBlockMetadataTime";
@@ -1410,7 +1468,7 @@ herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID )
     }
 
     /* We need to create a dimension specifically for the BlockCenterTime dataset. It will be a pure dimension. */
-    htri_t linkExists = H5Lexists( outputFile, dimName, H5P_DEFAULT);
+    htri_t linkExists = H5Lexists( ctx->outputFile, dimName, H5P_DEFAULT);
     if ( linkExists < 0 )
     {
         FATAL_MSG("Failed to determine if the dimension %s exists.\n", dimName);
@@ -1418,7 +1476,7 @@ herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID )
     }
     if ( linkExists )
     {
-        dimID = H5Dopen2( outputFile, dimName, H5P_DEFAULT);
+        dimID = H5Dopen2( ctx->outputFile, dimName, H5P_DEFAULT);
         if ( dimID < 0 )
         {
             FATAL_MSG("Failed to open the dimension.\n");
@@ -1441,7 +1499,7 @@ herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID )
             goto cleanupFail;
         }
 
-        status = makePureDim( dimGroupID, dimName, dSpaceID, H5T_NATIVE_INT, &dimID );
+        status = makePureDim( ctx, dimGroupID, dimName, dSpaceID, H5T_NATIVE_INT, &dimID );
         if ( status != RET_SUCCESS )
         {
             FATAL_MSG("Failed to create dimension.\n");
@@ -1449,7 +1507,7 @@ herr_t blockCentrTme( int32 inHFileID, hid_t BCTgroupID, hid_t dimGroupID )
         }
     }
 
-    if ( H5DSattach_scale( perBlockMetaDset, dimID, 0 ) < 0 )
+    if ( registerDimScale( ctx, perBlockMetaDset, dimID, 0 ) < 0 )
     {
         FATAL_MSG("Failed to attach dimension.\n");
         goto cleanupFail;
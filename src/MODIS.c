@@ -11,7 +11,7 @@
 
 /* MY(myang6@hdfgroup.org) 2016-12-20, handling the MODIS files with and without MOD02HKM and MOD02QKM. */
 
-int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGroupID,char* latname,char* lonname,int32 h4_type,hid_t h5_type,int32 MOD03FileID,hid_t outputFile,int modis_special_dims);
+int readThenWrite_MODIS_HR_LatLon(BFcontext_t* ctx,hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGroupID,char* latname,char* lonname,int32 h4_type,hid_t h5_type,int32 MOD03FileID,hid_t outputFileID,int modis_special_dims);
 
 int check_MODIS_special_dimension(int32 SD_FileID);
 /*      MODIS()
@@ -29,10 +29,11 @@ int check_MODIS_special_dimension(int32 SD_FileID);
     argv[5]     = NOT USED
     argv[6]     = output filename (already exists);
     modis_count = The granule's index
-    unpack      = A boolean value that specifies if unpacking should be performed
+    ctx         = The conversion context. ctx->unpack is the radiance output mode, UNPACK_NONE,
+                  UNPACK_FLOAT or UNPACK_SCALED (see initContext)
 
  EFFECTS:
-    Modifies the output HDF5 file (already exists, the identifier is a global variable) to contain the proper MODIS data.
+    Modifies the output HDF5 file (already exists, the identifier is ctx->outputFile) to contain the proper MODIS data.
     Allocates memory as needed.
 
  RETURN:
@@ -41,12 +42,13 @@ int check_MODIS_special_dimension(int32 SD_FileID);
     FAIL_OPEN       -- Some input file failed to open
 */
 
-int MODIS( char* argv[],int modis_count, int unpack)
+int MODIS( BFcontext_t* ctx, char* argv[],int modis_count )
 {
     /*************
      * VARIABLES *
      *************/
 
+    int unpack = ctx->unpack;
     const char* emissiveDim        =   "Band_1KM_Emissive_MODIS_SWATH_Type_L1B";
     const char* refSBDim           =   "Band_1KM_RefSB_MODIS_SWATH_Type_L1B";
     const char* _250M_MOD_SWATHDim =   "Band_250M_MODIS_SWATH_Type_L1B";
@@ -178,7 +180,7 @@ int MODIS( char* argv[],int modis_count, int unpack)
 
     short openFailed = 0;
     /* The program will skip this granule if any of the files failed to open */
-    _1KMFileID = SDstart( argv[1], DFACC_READ );
+    _1KMFileID = SDstart( inputFilePath(argv[1]), DFACC_READ );
     if ( _1KMFileID < 0 )
     {
         WARN_MSG( "Unable to open 1KM file.\n\t%s\n", argv[1] );
@@ -188,7 +190,7 @@ int MODIS( char* argv[],int modis_count, int unpack)
 
     if (argv[2]!= NULL)
     {
-        _500mFileID = SDstart( argv[2], DFACC_READ );
+        _500mFileID = SDstart( inputFilePath(argv[2]), DFACC_READ );
         if ( _500mFileID < 0 )
         {
             WARN_MSG("Unable to open 500m file.\n\t%s\n", argv[2]);
@@ -199,7 +201,7 @@ int MODIS( char* argv[],int modis_count, int unpack)
 
     if (argv[3]!= NULL)
     {
-        _250mFileID = SDstart( argv[3], DFACC_READ );
+        _250mFileID = SDstart( inputFilePath(argv[3]), DFACC_READ );
         if ( _250mFileID < 0 )
         {
             WARN_MSG("Unable to open 250m file.\n\t%s\n", argv[3]);
@@ -208,7 +210,7 @@ int MODIS( char* argv[],int modis_count, int unpack)
         }
     }
 
-    MOD03FileID = SDstart( argv[4], DFACC_READ );
+    MOD03FileID = SDstart( inputFilePath(argv[4]), DFACC_READ );
     if ( MOD03FileID < 0 )
     {
         WARN_MSG("Unable to open MOD03 file.\n\t%s\n", argv[4]);
@@ -218,6 +220,23 @@ int MODIS( char* argv[],int modis_count, int unpack)
 
     if ( openFailed ) goto cleanupFO;
 
+    /* Skip granules outside the BF_TIME_WINDOW or without any pixel in the BF_BBOX box */
+    {
+        int inside = subsetGranuleTime( argv[1], 2 );
+        if ( inside == 1 )
+            inside = subsetSDSOverlaps( MOD03FileID, "Latitude", "Longitude", DFNT_FLOAT32, 0 );
+        if ( inside == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to check the MODIS granule against the subset.\n");
+            goto cleanupFail;
+        }
+        if ( inside == 0 )
+        {
+            retVal = RET_SUCCESS_NO_PROCESS;
+            goto cleanup;
+        }
+    }
+
     // Some MODIS has dimension size 2040 rather than 2030, we need to use a different dimension name.
     short has_MODIS_special_dimension = check_MODIS_special_dimension(_1KMFileID);
     if(check_MODIS_special_dimension(_1KMFileID) <0) {
@@ -242,10 +261,10 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     //create root MODIS group
 
     // Check if MODIS group exists yet
-    htri_t exists = H5Lexists( outputFile, "MODIS", H5P_DEFAULT );
+    htri_t exists = H5Lexists( ctx->outputFile, "MODIS", H5P_DEFAULT );
     if ( exists <= 0 )
     {
-        if ( createGroup( &outputFile, &MODISrootGroupID, "MODIS" ) == FATAL_ERR )
+        if ( createGroup( &ctx->outputFile, &MODISrootGroupID, "MODIS" ) == FATAL_ERR )
         {
             FATAL_MSG("Failed to create MODIS root group.\n");
             MODISrootGroupID = 0;
@@ -265,12 +284,12 @@ printf("The MODIS %s has 2030 \n",argv[1]);
                                    "the 16th hour and the 10th minute (UTC) on July 3rd, 2007.";
                           
 
-        if(H5LTset_attribute_string(outputFile,"MODIS",comment_name,comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"MODIS",comment_name,comment_value) <0){
             FATAL_MSG("Failed to add the MODIS comment attribute.\n");
             goto cleanupFail;
         }
 
-        if(H5LTset_attribute_string(outputFile,"MODIS",time_comment_name,time_comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"MODIS",time_comment_name,time_comment_value) <0){
             FATAL_MSG("Failed to add the MODIS time comment attribute.\n");
             goto cleanupFail;
         }
@@ -278,7 +297,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     }
     else
     {
-        MODISrootGroupID = H5Gopen2(outputFile, "/MODIS",H5P_DEFAULT);
+        MODISrootGroupID = H5Gopen2(ctx->outputFile, "/MODIS",H5P_DEFAULT);
 
         if (MODISrootGroupID <0)
         {
@@ -469,7 +488,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     /*_______________latitude data under geolocation_______________*/
 
-    latitudeDatasetID = readThenWrite( NULL, MODIS1KMgeolocationGroupID,
+    latitudeDatasetID = readThenWrite( ctx, NULL, MODIS1KMgeolocationGroupID,
                                        "Latitude",
                                        DFNT_FLOAT32, H5T_NATIVE_FLOAT, MOD03FileID,1);
     if ( latitudeDatasetID == FATAL_ERR )
@@ -510,9 +529,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     // copy dimensions over
     if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, MOD03FileID, "Latitude", outputFile, latitudeDatasetID);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, MOD03FileID, "Latitude", ctx->outputFile, latitudeDatasetID);
     else 
-        errStatus = copyDimension( NULL, MOD03FileID, "Latitude", outputFile, latitudeDatasetID);
+        errStatus = copyDimension( ctx, NULL, MOD03FileID, "Latitude", ctx->outputFile, latitudeDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -525,7 +544,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     latitudeDatasetID = 0;
 
     /*_______________longitude data under geolocation______________*/
-    longitudeDatasetID = readThenWrite( NULL, MODIS1KMgeolocationGroupID,
+    longitudeDatasetID = readThenWrite( ctx, NULL, MODIS1KMgeolocationGroupID,
                                         "Longitude",
                                         DFNT_FLOAT32, H5T_NATIVE_FLOAT, MOD03FileID,1);
     if ( longitudeDatasetID == FATAL_ERR )
@@ -565,9 +584,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     // Copy dimensions over
     
     if(has_MODIS_special_dimension >0) 
-       errStatus = copyDimension_MODIS_Special( NULL, MOD03FileID, "Longitude", outputFile, longitudeDatasetID);
+       errStatus = copyDimension_MODIS_Special( ctx, NULL, MOD03FileID, "Longitude", ctx->outputFile, longitudeDatasetID);
     else 
-       errStatus = copyDimension( NULL, MOD03FileID, "Longitude", outputFile, longitudeDatasetID);
+       errStatus = copyDimension( ctx, NULL, MOD03FileID, "Longitude", ctx->outputFile, longitudeDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -577,6 +596,12 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     longitudeDatasetID = 0;
     if ( status < 0 ) WARN_MSG("H5Dclose\n");
 
+    if ( indexGeolocation( ctx, "MODIS", MODIS1KMgeolocationGroupID, "Latitude", "Longitude", SPATIAL_UNIT_MODIS ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to index the MODIS geolocation.\n");
+        goto cleanupFail;
+    }
+
 
 
 
@@ -637,12 +662,12 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     /*_______________EV_1KM_RefSB data_______________*/
 
     // IF WE ARE UNPACKING DATA
-    if (unpack == 1)
+    if (unpack != UNPACK_NONE)
     {
         if (argv[2]!=NULL)
         {
 
-            _1KMDatasetID = readThenWrite_MODIS_Unpack( MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB", DFNT_UINT16,
+            _1KMDatasetID = readThenWrite_MODIS_Unpack( ctx, MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB", DFNT_UINT16,
                             _1KMFileID);
             if ( _1KMDatasetID == FATAL_ERR )
             {
@@ -653,7 +678,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
             /*______________EV_1KM_RefSB_Uncert_Indexes______________*/
             
-            _1KMUncertID = readThenWrite_MODIS_Uncert_Unpack( MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB_Uncert_Indexes",
+            _1KMUncertID = readThenWrite_MODIS_Uncert_Unpack( ctx, MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB_Uncert_Indexes",
                            DFNT_UINT8, _1KMFileID );
             if ( _1KMUncertID == FATAL_ERR )
             {
@@ -667,7 +692,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     // ELSE WE ARE NOT UNPACKING DATA
     else
     {
-        _1KMDatasetID = readThenWrite( NULL, MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB", DFNT_UINT16,
+        _1KMDatasetID = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB", DFNT_UINT16,
                                        H5T_NATIVE_USHORT, _1KMFileID,1);
         if ( _1KMDatasetID == FATAL_ERR )
         {
@@ -678,7 +703,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         /*______________EV_1KM_RefSB_Uncert_Indexes______________*/
 
 
-        _1KMUncertID = readThenWrite( NULL, MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB_Uncert_Indexes",
+        _1KMUncertID = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID, "EV_1KM_RefSB_Uncert_Indexes",
                                       DFNT_UINT8, H5T_STD_U8LE, _1KMFileID,1 );
         if ( _1KMUncertID == FATAL_ERR )
         {
@@ -708,14 +733,14 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_RefSB","_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_RefSB","_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_1KM_RefSB _FillValue attribute.\n");
             goto cleanupFail;
         }
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_RefSB","valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_RefSB","valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_1KM_RefSB valid_min attribute.\n");
@@ -723,7 +748,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
 
         fltTemp = 900.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_RefSB","valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_RefSB","valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_1KM_RefSB valid_max attribute.\n");
@@ -774,9 +799,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
         // Copy the dimensions over
         if(has_MODIS_special_dimension >0) 
-            errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_1KM_RefSB", outputFile, _1KMDatasetID );
+            errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_1KM_RefSB", ctx->outputFile, _1KMDatasetID );
         else
-            errStatus = copyDimension( NULL, _1KMFileID, "EV_1KM_RefSB", outputFile, _1KMDatasetID );
+            errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_1KM_RefSB", ctx->outputFile, _1KMDatasetID );
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -809,9 +834,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
         
       if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_1KM_RefSB_Uncert_Indexes", outputFile, _1KMUncertID);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_1KM_RefSB_Uncert_Indexes", ctx->outputFile, _1KMUncertID);
       else
-        errStatus = copyDimension( NULL, _1KMFileID, "EV_1KM_RefSB_Uncert_Indexes", outputFile, _1KMUncertID);
+        errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_1KM_RefSB_Uncert_Indexes", ctx->outputFile, _1KMUncertID);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -825,10 +850,10 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     /*___________EV_1KM_Emissive___________*/
 
-    if (1==unpack)
+    if (unpack != UNPACK_NONE)
     {
 
-        _1KMEmissive = readThenWrite_MODIS_Unpack( MODIS1KMdataFieldsGroupID, "EV_1KM_Emissive",
+        _1KMEmissive = readThenWrite_MODIS_Unpack( ctx, MODIS1KMdataFieldsGroupID, "EV_1KM_Emissive",
                        DFNT_UINT16, _1KMFileID);
         if ( _1KMEmissive == FATAL_ERR )
         {
@@ -839,7 +864,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
 
 
-        _1KMEmissiveUncert = readThenWrite_MODIS_Uncert_Unpack( MODIS1KMdataFieldsGroupID,
+        _1KMEmissiveUncert = readThenWrite_MODIS_Uncert_Unpack( ctx, MODIS1KMdataFieldsGroupID,
                              "EV_1KM_Emissive_Uncert_Indexes",
                              DFNT_UINT8, _1KMFileID);
         if ( _1KMEmissiveUncert == FATAL_ERR )
@@ -853,7 +878,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     }
     else
     {
-        _1KMEmissive = readThenWrite( NULL, MODIS1KMdataFieldsGroupID, "EV_1KM_Emissive",
+        _1KMEmissive = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID, "EV_1KM_Emissive",
                                       DFNT_UINT16, H5T_NATIVE_USHORT, _1KMFileID,1);
         if ( _1KMEmissive == FATAL_ERR )
         {
@@ -862,7 +887,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
 
-        _1KMEmissiveUncert = readThenWrite( NULL, MODIS1KMdataFieldsGroupID,
+        _1KMEmissiveUncert = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID,
                                             "EV_1KM_Emissive_Uncert_Indexes",
                                             DFNT_UINT8, H5T_STD_U8LE, _1KMFileID,1);
         if ( _1KMEmissiveUncert == FATAL_ERR )
@@ -883,14 +908,14 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         goto cleanupFail;
     }
     fltTemp = -999.0;
-    status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_Emissive","_FillValue",&fltTemp, 1 );
+    status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_Emissive","_FillValue",&fltTemp, 1 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to add EV_1KM_Emissive _FillValue attribute.\n");
         goto cleanupFail;
     }
     fltTemp = 0.0;
-    status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_Emissive","valid_min",&fltTemp, 1 );
+    status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_Emissive","valid_min",&fltTemp, 1 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to add EV_1KM_Emissive valid_min attribute.\n");
@@ -898,7 +923,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     }
 
     fltTemp = 100.0;
-    status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_Emissive","valid_max",&fltTemp, 1 );
+    status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_1KM_Emissive","valid_max",&fltTemp, 1 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to add EV_1KM_Emissive valid_max attribute.\n");
@@ -944,9 +969,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     // Copy the dimensions over
     if(has_MODIS_special_dimension >0) 
-      errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_1KM_Emissive", outputFile, _1KMEmissive );
+      errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_1KM_Emissive", ctx->outputFile, _1KMEmissive );
     else 
-      errStatus = copyDimension( NULL, _1KMFileID, "EV_1KM_Emissive", outputFile, _1KMEmissive );
+      errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_1KM_Emissive", ctx->outputFile, _1KMEmissive );
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -954,9 +979,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     }
   
     if(has_MODIS_special_dimension >0) 
-      errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_1KM_Emissive_Uncert_Indexes", outputFile, _1KMEmissiveUncert);
+      errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_1KM_Emissive_Uncert_Indexes", ctx->outputFile, _1KMEmissiveUncert);
     else 
-       errStatus = copyDimension( NULL, _1KMFileID, "EV_1KM_Emissive_Uncert_Indexes", outputFile, _1KMEmissiveUncert);
+       errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_1KM_Emissive_Uncert_Indexes", ctx->outputFile, _1KMEmissiveUncert);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -976,13 +1001,13 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     /*__________EV_250_Aggr1km_RefSB_______________*/
 
-    if (unpack == 1)
+    if (unpack != UNPACK_NONE)
     {
 
         if (argv[2]!=NULL)
         {
 
-            _250Aggr1km = readThenWrite_MODIS_Unpack( MODIS1KMdataFieldsGroupID, "EV_250_Aggr1km_RefSB",
+            _250Aggr1km = readThenWrite_MODIS_Unpack( ctx, MODIS1KMdataFieldsGroupID, "EV_250_Aggr1km_RefSB",
                           DFNT_UINT16, _1KMFileID);
             if ( _250Aggr1km == FATAL_ERR )
             {
@@ -992,7 +1017,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             }
             /*__________EV_250_Aggr1km_RefSB_Uncert_Indexes_____________*/
 
-            _250Aggr1kmUncert = readThenWrite_MODIS_Uncert_Unpack( MODIS1KMdataFieldsGroupID,
+            _250Aggr1kmUncert = readThenWrite_MODIS_Uncert_Unpack( ctx, MODIS1KMdataFieldsGroupID,
                                 "EV_250_Aggr1km_RefSB_Uncert_Indexes",
                                 DFNT_UINT8, _1KMFileID);
             if ( _250Aggr1kmUncert == FATAL_ERR )
@@ -1008,7 +1033,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     else
     {
 
-        _250Aggr1km = readThenWrite( NULL, MODIS1KMdataFieldsGroupID, "EV_250_Aggr1km_RefSB",
+        _250Aggr1km = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID, "EV_250_Aggr1km_RefSB",
                                      DFNT_UINT16, H5T_NATIVE_USHORT, _1KMFileID,1);
         if ( _250Aggr1km == FATAL_ERR )
         {
@@ -1019,7 +1044,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
         /*__________EV_250_Aggr1km_RefSB_Uncert_Indexes_____________*/
 
-        _250Aggr1kmUncert = readThenWrite( NULL, MODIS1KMdataFieldsGroupID,
+        _250Aggr1kmUncert = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID,
                                            "EV_250_Aggr1km_RefSB_Uncert_Indexes",
                                            DFNT_UINT8, H5T_STD_U8LE, _1KMFileID,1);
         if ( _250Aggr1kmUncert == FATAL_ERR )
@@ -1031,7 +1056,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
 
     }
-    if ( unpack == 0 || argv[2] != NULL )
+    if ( unpack == UNPACK_NONE || argv[2] != NULL )
     {
         // ATTRIBUTES
         status = H5LTset_attribute_string(MODIS1KMdataFieldsGroupID,"EV_250_Aggr1km_RefSB","units","Watts/m^2/micrometer/steradian");
@@ -1041,7 +1066,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_250_Aggr1km_RefSB","_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_250_Aggr1km_RefSB","_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_250_Aggr1km_RefSB _FillValue attribute.\n");
@@ -1049,7 +1074,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
 
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_250_Aggr1km_RefSB","valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_250_Aggr1km_RefSB","valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_250_Aggr1km_RefSB valid_min attribute.\n");
@@ -1057,7 +1082,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
 
         fltTemp = 900.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_250_Aggr1km_RefSB","valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_250_Aggr1km_RefSB","valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_250_Aggr1km_RefSB valid_max attribute.\n");
@@ -1137,9 +1162,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
         // Copy the dimensions over
     if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_250_Aggr1km_RefSB", outputFile, _250Aggr1km );
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_250_Aggr1km_RefSB", ctx->outputFile, _250Aggr1km );
     else
-        errStatus = copyDimension( NULL, _1KMFileID, "EV_250_Aggr1km_RefSB", outputFile, _250Aggr1km );
+        errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_250_Aggr1km_RefSB", ctx->outputFile, _250Aggr1km );
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -1147,9 +1172,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
         // Copy the dimensions over
     if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_250_Aggr1km_RefSB_Uncert_Indexes", outputFile, _250Aggr1kmUncert);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_250_Aggr1km_RefSB_Uncert_Indexes", ctx->outputFile, _250Aggr1kmUncert);
     else
-        errStatus = copyDimension( NULL, _1KMFileID, "EV_250_Aggr1km_RefSB_Uncert_Indexes", outputFile, _250Aggr1kmUncert);
+        errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_250_Aggr1km_RefSB_Uncert_Indexes", ctx->outputFile, _250Aggr1kmUncert);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -1166,13 +1191,13 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     if ( status < 0 ) WARN_MSG("H5Dclose\n");
 
     /*__________EV_500_Aggr1km_RefSB____________*/
-    if (unpack == 1)
+    if (unpack != UNPACK_NONE)
     {
 
         if (argv[2]!=NULL)
         {
 
-            _500Aggr1km = readThenWrite_MODIS_Unpack( MODIS1KMdataFieldsGroupID, "EV_500_Aggr1km_RefSB",
+            _500Aggr1km = readThenWrite_MODIS_Unpack( ctx, MODIS1KMdataFieldsGroupID, "EV_500_Aggr1km_RefSB",
                           DFNT_UINT16, _1KMFileID );
             if ( _500Aggr1km == FATAL_ERR )
             {
@@ -1183,7 +1208,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
             /*__________EV_500_Aggr1km_RefSB_Uncert_Indexes____________*/
 
-            _500Aggr1kmUncert = readThenWrite_MODIS_Uncert_Unpack( MODIS1KMdataFieldsGroupID,
+            _500Aggr1kmUncert = readThenWrite_MODIS_Uncert_Unpack( ctx, MODIS1KMdataFieldsGroupID,
                                 "EV_500_Aggr1km_RefSB_Uncert_Indexes",
                                 DFNT_UINT8, _1KMFileID );
             if ( _500Aggr1kmUncert == FATAL_ERR )
@@ -1200,7 +1225,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     else
     {
-        _500Aggr1km = readThenWrite( NULL, MODIS1KMdataFieldsGroupID, "EV_500_Aggr1km_RefSB",
+        _500Aggr1km = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID, "EV_500_Aggr1km_RefSB",
                                      DFNT_UINT16, H5T_NATIVE_USHORT, _1KMFileID,1 );
         if ( _500Aggr1km == FATAL_ERR )
         {
@@ -1209,7 +1234,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
 
-        _500Aggr1kmUncert = readThenWrite( NULL, MODIS1KMdataFieldsGroupID,
+        _500Aggr1kmUncert = readThenWrite( ctx, NULL, MODIS1KMdataFieldsGroupID,
                                            "EV_500_Aggr1km_RefSB_Uncert_Indexes",
                                            DFNT_UINT8, H5T_STD_U8LE, _1KMFileID,1 );
         if ( _500Aggr1kmUncert == FATAL_ERR )
@@ -1220,7 +1245,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
     }
 
-    if ( unpack == 0 || argv[2] != NULL )
+    if ( unpack == UNPACK_NONE || argv[2] != NULL )
     {
         // ATTRIBUTES
         status = H5LTset_attribute_string(MODIS1KMdataFieldsGroupID,"EV_500_Aggr1km_RefSB","units","Watts/m^2/micrometer/steradian");
@@ -1230,21 +1255,21 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_500_Aggr1km_RefSB","_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_500_Aggr1km_RefSB","_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_500_Aggr1km_RefSB _FillValue attribute.\n");
             goto cleanupFail;
         }
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_500_Aggr1km_RefSB","valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_500_Aggr1km_RefSB","valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_500_Aggr1km_RefSB valid_min attribute.\n");
             goto cleanupFail;
         }
         fltTemp = 900.0;
-        status = H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_500_Aggr1km_RefSB","valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS1KMdataFieldsGroupID,"EV_500_Aggr1km_RefSB","valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_500_Aggr1km_RefSB valid_max attribute.\n");
@@ -1324,18 +1349,18 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
         // Copy the dimensions over
     if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_500_Aggr1km_RefSB", outputFile, _500Aggr1km );
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_500_Aggr1km_RefSB", ctx->outputFile, _500Aggr1km );
     else
-        errStatus = copyDimension( NULL, _1KMFileID, "EV_500_Aggr1km_RefSB", outputFile, _500Aggr1km );
+        errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_500_Aggr1km_RefSB", ctx->outputFile, _500Aggr1km );
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
             goto cleanupFail;
         }
     if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _1KMFileID, "EV_500_Aggr1km_RefSB_Uncert_Indexes", outputFile, _500Aggr1kmUncert);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _1KMFileID, "EV_500_Aggr1km_RefSB_Uncert_Indexes", ctx->outputFile, _500Aggr1kmUncert);
     else
-        errStatus = copyDimension( NULL, _1KMFileID, "EV_500_Aggr1km_RefSB_Uncert_Indexes", outputFile, _500Aggr1kmUncert);
+        errStatus = copyDimension( ctx, NULL, _1KMFileID, "EV_500_Aggr1km_RefSB_Uncert_Indexes", ctx->outputFile, _500Aggr1kmUncert);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -1352,7 +1377,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
 
     /*_______________Sensor Zenith under the granule group______________*/
-    SensorZenithDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(MODISgranuleGroupID,"SensorZenith",
+    SensorZenithDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(ctx,MODISgranuleGroupID,"SensorZenith",
                             DFNT_FLOAT32,  MOD03FileID);
     if ( SensorZenithDatasetID == FATAL_ERR )
     {
@@ -1362,9 +1387,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     }
 
     if(has_MODIS_special_dimension>0 )
-      errStatus = copyDimension_MODIS_Special( NULL, MOD03FileID, "SensorZenith", outputFile, SensorZenithDatasetID);
+      errStatus = copyDimension_MODIS_Special( ctx, NULL, MOD03FileID, "SensorZenith", ctx->outputFile, SensorZenithDatasetID);
     else 
-      errStatus = copyDimension( NULL, MOD03FileID, "SensorZenith", outputFile, SensorZenithDatasetID);
+      errStatus = copyDimension( ctx, NULL, MOD03FileID, "SensorZenith", ctx->outputFile, SensorZenithDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -1381,7 +1406,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
 
     /*_______________Sensor Azimuth under the granule group______________*/
-    SensorAzimuthDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(MODISgranuleGroupID,"SensorAzimuth",
+    SensorAzimuthDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(ctx,MODISgranuleGroupID,"SensorAzimuth",
                              DFNT_FLOAT32,  MOD03FileID);
     if ( SensorAzimuthDatasetID == FATAL_ERR )
     {
@@ -1392,9 +1417,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
    
     if(has_MODIS_special_dimension >0) 
-      errStatus = copyDimension_MODIS_Special( NULL, MOD03FileID, "SensorAzimuth", outputFile, SensorAzimuthDatasetID);
+      errStatus = copyDimension_MODIS_Special( ctx, NULL, MOD03FileID, "SensorAzimuth", ctx->outputFile, SensorAzimuthDatasetID);
     else 
-      errStatus = copyDimension( NULL, MOD03FileID, "SensorAzimuth", outputFile, SensorAzimuthDatasetID);
+      errStatus = copyDimension( ctx, NULL, MOD03FileID, "SensorAzimuth", ctx->outputFile, SensorAzimuthDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -1410,7 +1435,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     }
 
     /*_______________Solar Zenith under the granule group______________*/
-    SolarZenithDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(MODISgranuleGroupID,"SolarZenith",
+    SolarZenithDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(ctx,MODISgranuleGroupID,"SolarZenith",
                            DFNT_FLOAT32,  MOD03FileID);
     if ( SolarZenithDatasetID == FATAL_ERR )
     {
@@ -1420,9 +1445,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     }
 
     if(has_MODIS_special_dimension >0)
-      errStatus = copyDimension_MODIS_Special( NULL, MOD03FileID, "SolarZenith", outputFile, SolarZenithDatasetID);
+      errStatus = copyDimension_MODIS_Special( ctx, NULL, MOD03FileID, "SolarZenith", ctx->outputFile, SolarZenithDatasetID);
     else 
-      errStatus = copyDimension( NULL, MOD03FileID, "SolarZenith", outputFile, SolarZenithDatasetID);
+      errStatus = copyDimension( ctx, NULL, MOD03FileID, "SolarZenith", ctx->outputFile, SolarZenithDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -1439,7 +1464,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
 
     /*_______________Solar Azimuth under the granule group______________*/
-    SolarAzimuthDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(MODISgranuleGroupID,"SolarAzimuth",
+    SolarAzimuthDatasetID = readThenWrite_MODIS_GeoMetry_Unpack(ctx,MODISgranuleGroupID,"SolarAzimuth",
                             DFNT_FLOAT32,  MOD03FileID);
     if ( SolarAzimuthDatasetID == FATAL_ERR )
     {
@@ -1450,9 +1475,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     
     if(has_MODIS_special_dimension >0) 
-       errStatus = copyDimension_MODIS_Special( NULL, MOD03FileID, "SolarAzimuth", outputFile, SolarAzimuthDatasetID);
+       errStatus = copyDimension_MODIS_Special( ctx, NULL, MOD03FileID, "SolarAzimuth", ctx->outputFile, SolarAzimuthDatasetID);
     else 
-       errStatus = copyDimension( NULL, MOD03FileID, "SolarAzimuth", outputFile, SolarAzimuthDatasetID);
+       errStatus = copyDimension( ctx, NULL, MOD03FileID, "SolarAzimuth", ctx->outputFile, SolarAzimuthDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -1470,7 +1495,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     // The SD Sun fields are not needed. Still leave it for the time being in case they are needed.
 #if 0
     /*_______________Sun angle under the granule group______________*/
-    SDSunzenithDatasetID = readThenWrite( NULL,MODISgranuleGroupID,"SD Sun zenith",
+    SDSunzenithDatasetID = readThenWrite( ctx, NULL,MODISgranuleGroupID,"SD Sun zenith",
                                           DFNT_FLOAT32, H5T_NATIVE_FLOAT, MOD03FileID);
     if ( SDSunzenithDatasetID == FATAL_ERR )
     {
@@ -1488,7 +1513,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         goto cleanupFail;
     }
 
-    errStatus = copyDimension( MOD03FileID, "SD Sun zenith", outputFile, SDSunzenithDatasetID);
+    errStatus = copyDimension( ctx, MOD03FileID, "SD Sun zenith", ctx->outputFile, SDSunzenithDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -1536,7 +1561,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     SDSunzenithDatasetID = 0;
     if ( status < 0 ) WARN_MSG("H5Dclose\n");
 
-    SDSunazimuthDatasetID = readThenWrite( NULL,MODISgranuleGroupID,"SD Sun azimuth",
+    SDSunazimuthDatasetID = readThenWrite( ctx, NULL,MODISgranuleGroupID,"SD Sun azimuth",
                                            DFNT_FLOAT32, H5T_NATIVE_FLOAT, MOD03FileID);
     if ( SDSunazimuthDatasetID == FATAL_ERR )
     {
@@ -1555,7 +1580,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         goto cleanupFail;
     }
 
-    errStatus = copyDimension( MOD03FileID, "SD Sun azimuth", outputFile, SDSunazimuthDatasetID);
+    errStatus = copyDimension( ctx, MOD03FileID, "SD Sun azimuth", ctx->outputFile, SDSunazimuthDatasetID);
     if ( errStatus == FAIL )
     {
         FATAL_MSG("Failed to copy dimension.\n");
@@ -1619,9 +1644,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
     if (argv[2] !=NULL)
     {
 
-        if (unpack == 1)
+        if (unpack != UNPACK_NONE)
         {
-            _250Aggr500 = readThenWrite_MODIS_Unpack( MODIS500mdataFieldsGroupID,
+            _250Aggr500 = readThenWrite_MODIS_Unpack( ctx, MODIS500mdataFieldsGroupID,
                           "EV_250_Aggr500_RefSB",
                           DFNT_UINT16, _500mFileID );
             if ( _250Aggr500 == FATAL_ERR )
@@ -1632,7 +1657,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             }
             /*_____________EV_250_Aggr500_RefSB_Uncert_Indexes____________*/
 
-            _250Aggr500Uncert = readThenWrite_MODIS_Uncert_Unpack( MODIS500mdataFieldsGroupID,
+            _250Aggr500Uncert = readThenWrite_MODIS_Uncert_Unpack( ctx, MODIS500mdataFieldsGroupID,
                                 "EV_250_Aggr500_RefSB_Uncert_Indexes",
                                 DFNT_UINT8, _500mFileID );
             if ( _250Aggr500Uncert == FATAL_ERR )
@@ -1646,7 +1671,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
         else
         {
-            _250Aggr500 = readThenWrite( NULL, MODIS500mdataFieldsGroupID,
+            _250Aggr500 = readThenWrite( ctx, NULL, MODIS500mdataFieldsGroupID,
                                          "EV_250_Aggr500_RefSB",
                                          DFNT_UINT16,H5T_NATIVE_USHORT,  _500mFileID,1 );
 
@@ -1658,7 +1683,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             }
             /*_____________EV_250_Aggr500_RefSB_Uncert_Indexes____________*/
 
-            _250Aggr500Uncert = readThenWrite( NULL, MODIS500mdataFieldsGroupID,
+            _250Aggr500Uncert = readThenWrite( ctx, NULL, MODIS500mdataFieldsGroupID,
                                                "EV_250_Aggr500_RefSB_Uncert_Indexes",
                                                DFNT_UINT8,H5T_STD_U8LE, _500mFileID,1 );
             if ( _250Aggr500Uncert == FATAL_ERR )
@@ -1680,7 +1705,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_250_Aggr500_RefSB","_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_250_Aggr500_RefSB","_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_250_Aggr500_RefSB _FillValue attribute.\n");
@@ -1688,7 +1713,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
 
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_250_Aggr500_RefSB","valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_250_Aggr500_RefSB","valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_250_Aggr500_RefSB valid_min attribute.\n");
@@ -1696,7 +1721,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
 
         fltTemp = 900.0;
-        status = H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_250_Aggr500_RefSB","valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_250_Aggr500_RefSB","valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_250_Aggr500_RefSB valid_max attribute.\n");
@@ -1762,18 +1787,18 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         // Copy the dimensions over
 
       if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _500mFileID, "EV_250_Aggr500_RefSB", outputFile, _250Aggr500);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _500mFileID, "EV_250_Aggr500_RefSB", ctx->outputFile, _250Aggr500);
       else
-        errStatus = copyDimension( NULL, _500mFileID, "EV_250_Aggr500_RefSB", outputFile, _250Aggr500);
+        errStatus = copyDimension( ctx, NULL, _500mFileID, "EV_250_Aggr500_RefSB", ctx->outputFile, _250Aggr500);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
             goto cleanupFail;
         }
       if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _500mFileID, "EV_250_Aggr500_RefSB_Uncert_Indexes", outputFile, _250Aggr500Uncert);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _500mFileID, "EV_250_Aggr500_RefSB_Uncert_Indexes", ctx->outputFile, _250Aggr500Uncert);
       else
-        errStatus = copyDimension( NULL, _500mFileID, "EV_250_Aggr500_RefSB_Uncert_Indexes", outputFile, _250Aggr500Uncert);
+        errStatus = copyDimension( ctx, NULL, _500mFileID, "EV_250_Aggr500_RefSB_Uncert_Indexes", ctx->outputFile, _250Aggr500Uncert);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -1790,11 +1815,11 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         _250Aggr500Uncert = 0;
         if ( status < 0 ) WARN_MSG("H5Dclose\n");
 
-        if (unpack == 1)
+        if (unpack != UNPACK_NONE)
         {
             /*____________EV_500_RefSB_____________*/
 
-            _500RefSB = readThenWrite_MODIS_Unpack( MODIS500mdataFieldsGroupID, "EV_500_RefSB", DFNT_UINT16,
+            _500RefSB = readThenWrite_MODIS_Unpack( ctx, MODIS500mdataFieldsGroupID, "EV_500_RefSB", DFNT_UINT16,
                                                     _500mFileID );
             if ( _500RefSB == FATAL_ERR )
             {
@@ -1804,7 +1829,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             }
             /*____________EV_500_RefSB_Uncert_Indexes_____________*/
 
-            _500RefSBUncert = readThenWrite_MODIS_Uncert_Unpack( MODIS500mdataFieldsGroupID, "EV_500_RefSB_Uncert_Indexes",
+            _500RefSBUncert = readThenWrite_MODIS_Uncert_Unpack( ctx, MODIS500mdataFieldsGroupID, "EV_500_RefSB_Uncert_Indexes",
                               DFNT_UINT8, _500mFileID );
             if ( _500RefSBUncert == FATAL_ERR )
             {
@@ -1816,7 +1841,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
         else
         {
-            _500RefSB = readThenWrite( NULL, MODIS500mdataFieldsGroupID, "EV_500_RefSB", DFNT_UINT16,
+            _500RefSB = readThenWrite( ctx, NULL, MODIS500mdataFieldsGroupID, "EV_500_RefSB", DFNT_UINT16,
                                        H5T_NATIVE_USHORT, _500mFileID,1 );
             /*____________EV_500_RefSB_Uncert_Indexes_____________*/
             if ( _500RefSB == FATAL_ERR )
@@ -1825,7 +1850,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
                 _500RefSB = 0;
                 goto cleanupFail;
             }
-            _500RefSBUncert = readThenWrite( NULL, MODIS500mdataFieldsGroupID, "EV_500_RefSB_Uncert_Indexes",
+            _500RefSBUncert = readThenWrite( ctx, NULL, MODIS500mdataFieldsGroupID, "EV_500_RefSB_Uncert_Indexes",
                                              DFNT_UINT8, H5T_STD_U8LE, _500mFileID,1 );
             if ( _500RefSBUncert == FATAL_ERR )
             {
@@ -1843,21 +1868,21 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_500_RefSB","_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_500_RefSB","_FillValue",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_500_RefSB _FillValue attribute.\n");
             goto cleanupFail;
         }
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_500_RefSB","valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_500_RefSB","valid_min",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_500_RefSB valid_min attribute.\n");
             goto cleanupFail;
         } 
         fltTemp = 900.0;
-        status = H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_500_RefSB","valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS500mdataFieldsGroupID,"EV_500_RefSB","valid_max",&fltTemp, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to add EV_500_RefSB valid_max attribute.\n");
@@ -1925,18 +1950,18 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
         // Copy the dimensions over
         if(has_MODIS_special_dimension >0)
-        errStatus = copyDimension_MODIS_Special( NULL, _500mFileID, "EV_500_RefSB", outputFile, _500RefSB);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _500mFileID, "EV_500_RefSB", ctx->outputFile, _500RefSB);
        else 
-        errStatus = copyDimension( NULL, _500mFileID, "EV_500_RefSB", outputFile, _500RefSB);
+        errStatus = copyDimension( ctx, NULL, _500mFileID, "EV_500_RefSB", ctx->outputFile, _500RefSB);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
             goto cleanupFail;
         }
        if(has_MODIS_special_dimension > 0)
-        errStatus = copyDimension_MODIS_Special( NULL, _500mFileID, "EV_500_RefSB_Uncert_Indexes", outputFile, _500RefSBUncert);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _500mFileID, "EV_500_RefSB_Uncert_Indexes", ctx->outputFile, _500RefSBUncert);
        else
-        errStatus = copyDimension( NULL, _500mFileID, "EV_500_RefSB_Uncert_Indexes", outputFile, _500RefSBUncert);
+        errStatus = copyDimension( ctx, NULL, _500mFileID, "EV_500_RefSB_Uncert_Indexes", ctx->outputFile, _500RefSBUncert);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -1964,9 +1989,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
     if (argv[3] != NULL)
     {
-        if (unpack == 1)
+        if (unpack != UNPACK_NONE)
         {
-            _250RefSB = readThenWrite_MODIS_Unpack( MODIS250mdataFieldsGroupID, "EV_250_RefSB", DFNT_UINT16,
+            _250RefSB = readThenWrite_MODIS_Unpack( ctx, MODIS250mdataFieldsGroupID, "EV_250_RefSB", DFNT_UINT16,
                                                     _250mFileID );
             if ( _250RefSB == FATAL_ERR )
             {
@@ -1976,7 +2001,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             }
             /*____________EV_250_RefSB_Uncert_Indexes_____________*/
 
-            _250RefSBUncert = readThenWrite_MODIS_Uncert_Unpack( MODIS250mdataFieldsGroupID, "EV_250_RefSB_Uncert_Indexes",
+            _250RefSBUncert = readThenWrite_MODIS_Uncert_Unpack( ctx, MODIS250mdataFieldsGroupID, "EV_250_RefSB_Uncert_Indexes",
                               DFNT_UINT8, _250mFileID);
             if ( _250RefSBUncert == FATAL_ERR )
             {
@@ -1988,7 +2013,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
         else
         {
-            _250RefSB = readThenWrite( NULL, MODIS250mdataFieldsGroupID, "EV_250_RefSB", DFNT_UINT16,
+            _250RefSB = readThenWrite( ctx, NULL, MODIS250mdataFieldsGroupID, "EV_250_RefSB", DFNT_UINT16,
                                        H5T_NATIVE_USHORT, _250mFileID,1 );
             if ( _250RefSB == FATAL_ERR )
             {
@@ -1998,7 +2023,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             }
             /*____________EV_250_RefSB_Uncert_Indexes_____________*/
 
-            _250RefSBUncert = readThenWrite( NULL, MODIS250mdataFieldsGroupID, "EV_250_RefSB_Uncert_Indexes",
+            _250RefSBUncert = readThenWrite( ctx, NULL, MODIS250mdataFieldsGroupID, "EV_250_RefSB_Uncert_Indexes",
                                              DFNT_UINT8, H5T_STD_U8LE, _250mFileID,1);
             if ( _250RefSBUncert == FATAL_ERR )
             {
@@ -2017,7 +2042,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
         fltTemp = -999.0;
-        status = H5LTset_attribute_float(MODIS250mdataFieldsGroupID,"EV_250_RefSB","_FillValue",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS250mdataFieldsGroupID,"EV_250_RefSB","_FillValue",&fltTemp, 1 );
         if ( status < 0  )
         {
             FATAL_MSG("Failed to add EV_250_RefSB _FillValue attribute.\n");
@@ -2025,7 +2050,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
 
         fltTemp = 0.0;
-        status = H5LTset_attribute_float(MODIS250mdataFieldsGroupID,"EV_250_RefSB","valid_min",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS250mdataFieldsGroupID,"EV_250_RefSB","valid_min",&fltTemp, 1 );
         if ( status < 0  )
         {
             FATAL_MSG("Failed to add EV_250_RefSB valid_min attribute.\n");
@@ -2033,7 +2058,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
 
         fltTemp = 900.0;
-        status = H5LTset_attribute_float(MODIS250mdataFieldsGroupID,"EV_250_RefSB","valid_max",&fltTemp, 1 );
+        status = unpack == UNPACK_SCALED ? 0 : H5LTset_attribute_float(MODIS250mdataFieldsGroupID,"EV_250_RefSB","valid_max",&fltTemp, 1 );
         if ( status < 0  )
         {
             FATAL_MSG("Failed to add EV_250_RefSB valid_max attribute.\n");
@@ -2099,9 +2124,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         // Copy the dimensions over
 
       if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _250mFileID, "EV_250_RefSB", outputFile, _250RefSB);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _250mFileID, "EV_250_RefSB", ctx->outputFile, _250RefSB);
       else
-        errStatus = copyDimension( NULL, _250mFileID, "EV_250_RefSB", outputFile, _250RefSB);
+        errStatus = copyDimension( ctx, NULL, _250mFileID, "EV_250_RefSB", ctx->outputFile, _250RefSB);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -2109,9 +2134,9 @@ printf("The MODIS %s has 2030 \n",argv[1]);
         }
        
       if(has_MODIS_special_dimension >0) 
-        errStatus = copyDimension_MODIS_Special( NULL, _250mFileID, "EV_250_RefSB_Uncert_Indexes", outputFile, _250RefSBUncert);
+        errStatus = copyDimension_MODIS_Special( ctx, NULL, _250mFileID, "EV_250_RefSB_Uncert_Indexes", ctx->outputFile, _250RefSBUncert);
       else
-        errStatus = copyDimension( NULL, _250mFileID, "EV_250_RefSB_Uncert_Indexes", outputFile, _250RefSBUncert);
+        errStatus = copyDimension( ctx, NULL, _250mFileID, "EV_250_RefSB_Uncert_Indexes", ctx->outputFile, _250RefSBUncert);
         if ( errStatus == FAIL )
         {
             FATAL_MSG("Failed to copy dimension.\n");
@@ -2135,7 +2160,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
 
 
     // We add the high-resolution lat/lon only when the data is unpacked, This is actually an advanced basic-fusion version.
-    if(unpack == 1 && argv[2] != NULL )
+    if(unpack != UNPACK_NONE && argv[2] != NULL )
     {
         // Add MODIS interpolation data
         if ( createGroup( &MODIS500mGroupID, &MODIS500mgeolocationGroupID, "Geolocation" ) )
@@ -2152,7 +2177,7 @@ printf("The MODIS %s has 2030 \n",argv[1]);
             goto cleanupFail;
         }
 
-        if(-1 == readThenWrite_MODIS_HR_LatLon(MODIS500mgeolocationGroupID, MODIS250mgeolocationGroupID,"Latitude","Longitude",DFNT_FLOAT32,H5T_NATIVE_FLOAT,MOD03FileID,outputFile,has_MODIS_special_dimension))
+        if(-1 == readThenWrite_MODIS_HR_LatLon(ctx,MODIS500mgeolocationGroupID, MODIS250mgeolocationGroupID,"Latitude","Longitude",DFNT_FLOAT32,H5T_NATIVE_FLOAT,MOD03FileID,ctx->outputFile,has_MODIS_special_dimension))
         {
             FATAL_MSG("Failed to generate MODIS 250m and 500m geolocation fields.\n");
             goto cleanupFail;
@@ -2373,6 +2398,7 @@ cleanupFO:
         retVal = FAIL_OPEN;
     }
 
+cleanup:
     /* release associated identifiers */
     if (latitudeAttrID !=0 ) status = H5Aclose(latitudeAttrID);
     if ( status < 0 ) WARN_MSG("H5Aclose\n");
@@ -2474,10 +2500,9 @@ cleanupFO:
     return retVal;
 }
 
-int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGroupID,char* latname,char* lonname,int32 h4_type,hid_t h5_type,int32 MOD03FileID,hid_t outputFileID,int modis_special_dims)
+int readThenWrite_MODIS_HR_LatLon(BFcontext_t* ctx,hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGroupID,char* latname,char* lonname,int32 h4_type,hid_t h5_type,int32 MOD03FileID,hid_t outputFileID,int modis_special_dims)
 {
 
-    hid_t dummy_output_file_id = 0;
     int32 latRank,lonRank;
     int32 latDimSizes[DIM_MAX];
     int32 lonDimSizes[DIM_MAX];
@@ -2685,7 +2710,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
     for ( i = 0; i < DIM_MAX; i++ )
         temp[i] = (hsize_t) (2*latDimSizes[i]);
 
-    datasetID = insertDataset( &dummy_output_file_id, &MODIS500mgeoGroupID, 1, latRank,
+    datasetID = insertDataset( ctx, &MODIS500mgeoGroupID, 1, latRank,
                                temp, h5_type, latname, lat_output_500m_buffer );
 
     if ( datasetID == FATAL_ERR )
@@ -2700,7 +2725,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
         return -1;
     }
     // semi-hard-code here.
-    if(attachDimension(outputFileID,ll_500m_dimnames[0],datasetID,0) <0)
+    if(attachDimension(ctx,outputFileID,ll_500m_dimnames[0],datasetID,0) <0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n",ll_500m_dimnames[0] );
         free(latBuffer);
@@ -2711,7 +2736,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
         free(lat_output_500m_buffer);
         return -1;
     }
-    if(attachDimension(outputFileID,ll_500m_dimnames[1],datasetID,1)<0)
+    if(attachDimension(ctx,outputFileID,ll_500m_dimnames[1],datasetID,1)<0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n", ll_500m_dimnames[1] );
         free(latBuffer);
@@ -2742,7 +2767,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
         lon_output_500m_buffer[i] = (float)lon_500m_buffer[i];
 
 
-    datasetID = insertDataset( &dummy_output_file_id, &MODIS500mgeoGroupID, 1, lonRank,
+    datasetID = insertDataset( ctx, &MODIS500mgeoGroupID, 1, lonRank,
                                temp, h5_type, lonname, lon_output_500m_buffer );
 
     if ( datasetID == FATAL_ERR )
@@ -2759,7 +2784,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
         return -1;
     }
     // semi-hard-code here.
-    if(attachDimension(outputFileID,ll_500m_dimnames[0],datasetID,0) <0)
+    if(attachDimension(ctx,outputFileID,ll_500m_dimnames[0],datasetID,0) <0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n",ll_500m_dimnames[0] );
         free(latBuffer);
@@ -2772,7 +2797,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
         free(lon_output_500m_buffer);
         return -1;
     }
-    if(attachDimension(outputFileID,ll_500m_dimnames[1],datasetID,1)<0)
+    if(attachDimension(ctx,outputFileID,ll_500m_dimnames[1],datasetID,1)<0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n", ll_500m_dimnames[1] );
         free(latBuffer);
@@ -2853,7 +2878,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
     for ( i = 0; i < DIM_MAX; i++ )
         temp[i] = (hsize_t) (4*latDimSizes[i]);
 
-    datasetID = insertDataset( &dummy_output_file_id, &MODIS250mgeoGroupID, 1, latRank,
+    datasetID = insertDataset( ctx, &MODIS250mgeoGroupID, 1, latRank,
                                temp, h5_type, latname, lat_output_250m_buffer );
 
     if ( datasetID == FATAL_ERR )
@@ -2866,13 +2891,13 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
 
     free(lat_output_250m_buffer);
 
-    if(attachDimension(outputFileID,ll_250m_dimnames[0],datasetID,0) <0)
+    if(attachDimension(ctx,outputFileID,ll_250m_dimnames[0],datasetID,0) <0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n",ll_250m_dimnames[0] );
         free(lon_250m_buffer);
         return -1;
     }
-    if(attachDimension(outputFileID,ll_250m_dimnames[1],datasetID,1)<0)
+    if(attachDimension(ctx,outputFileID,ll_250m_dimnames[1],datasetID,1)<0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n", ll_250m_dimnames[1] );
         free(lon_250m_buffer);
@@ -2881,7 +2906,7 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
 
     H5Dclose(datasetID);
 
-    datasetID = insertDataset( &dummy_output_file_id, &MODIS250mgeoGroupID, 1, lonRank,
+    datasetID = insertDataset( ctx, &MODIS250mgeoGroupID, 1, lonRank,
                                temp, h5_type, lonname, lon_output_250m_buffer );
 
     if ( datasetID == FATAL_ERR )
@@ -2893,12 +2918,12 @@ int readThenWrite_MODIS_HR_LatLon(hid_t MODIS500mgeoGroupID,hid_t MODIS250mgeoGr
 
     free(lon_output_250m_buffer);
 
-    if(attachDimension(outputFileID,ll_250m_dimnames[0],datasetID,0) <0)
+    if(attachDimension(ctx,outputFileID,ll_250m_dimnames[0],datasetID,0) <0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n",ll_250m_dimnames[0] );
         return -1;
     }
-    if(attachDimension(outputFileID,ll_250m_dimnames[1],datasetID,1)<0)
+    if(attachDimension(ctx,outputFileID,ll_250m_dimnames[1],datasetID,1)<0)
     {
         FATAL_MSG("Error  opening dimension dataset ID %s dataset.\n", ll_250m_dimnames[1] );
         return -1;
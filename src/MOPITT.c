@@ -15,10 +15,11 @@
  
  DESCRIPTION:
     This function handles the MOPITT data repacking into the output Fusion file
-    given by the global hid_t variable outputFile. The MOPITT HDF5 file passed 
-    in inputFile will be read into the outputFile.
+    given by ctx->outputFile. The MOPITT HDF5 file passed 
+    in inputFile will be read into the output file.
 
  ARGUMENTS:
+    ctx         -- The conversion context
     inputFile   -- Input MOPITT file path
 
  EFFECTS:
@@ -30,7 +31,7 @@
     RET_SUCCESS     -- Success
 */
 
-int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
+int MOPITT( BFcontext_t* ctx, char* inputFile, OInfo_t cur_orbit_info )
 {
 
     hid_t file = 0;
@@ -123,17 +124,62 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         FATAL_MSG("Failed to obtain MOPITT subsetting information.\n");
         goto cleanupFail;
     }
+
+    /* Keep only the tracks that pass over the BF_BBOX box */
+    if ( bfSubset.useBox )
+    {
+        float* latBuf = NULL;
+        float* lonBuf = NULL;
+        hsize_t geoDims[2] = {0};
+        hid_t geoSpace = 0;
+        hid_t geoDset = H5Dopen2( file, LATITUDE, H5P_DEFAULT );
+
+        if ( geoDset < 0 )
+        {
+            FATAL_MSG("Failed to open the MOPITT latitude dataset.\n");
+            goto cleanupFail;
+        }
+        geoSpace = H5Dget_space( geoDset );
+        H5Sget_simple_extent_dims( geoSpace, geoDims, NULL );
+        H5Sclose(geoSpace);
+        H5Dclose(geoDset);
+        if ( geoDims[1] == 0 )
+            geoDims[1] = 1;
+
+        latBuf = malloc( geoDims[0] * geoDims[1] * sizeof(float) );
+        lonBuf = malloc( geoDims[0] * geoDims[1] * sizeof(float) );
+        if ( latBuf == NULL || lonBuf == NULL ||
+             H5LTread_dataset_float( file, LATITUDE, latBuf ) < 0 || H5LTread_dataset_float( file, LONGITUDE, lonBuf ) < 0 )
+        {
+            FATAL_MSG("Failed to read the MOPITT geolocation.\n");
+            if ( latBuf ) free(latBuf);
+            if ( lonBuf ) free(lonBuf);
+            goto cleanupFail;
+        }
+
+        status = subsetTrackRange( latBuf + startIdx * geoDims[1], lonBuf + startIdx * geoDims[1], 0, geoDims[1],
+                                   &startIdx, &endIdx );
+        free(latBuf);
+        free(lonBuf);
+        if ( status == RET_SUCCESS_NO_PROCESS )
+        {
+            /* No track of this granule is inside the box */
+            retVal = RET_SUCCESS_NO_PROCESS;
+            goto cleanup;
+        }
+    }
+
     bound[0] = startIdx;
     bound[1] = endIdx;
 
 
 
     /* If it's the first granule, create the root MOPITT group */
-    htri_t exists = H5Lexists( outputFile, "MOPITT", H5P_DEFAULT);
+    htri_t exists = H5Lexists( ctx->outputFile, "MOPITT", H5P_DEFAULT);
     if ( exists == 0 )
     {
         // create the root group
-        if ( createGroup( &outputFile, &MOPITTroot, "MOPITT" ) == FATAL_ERR )
+        if ( createGroup( &ctx->outputFile, &MOPITTroot, "MOPITT" ) == FATAL_ERR )
         {
             FATAL_MSG("Unable to create MOPITT root group.\n");
             MOPITTroot = 0;
@@ -150,12 +196,12 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
                                    "YYYYMMDD format. Y: year. M: month. D: day."
                                    " For example, 20070703 represents July 3rd, 2007.";
     
-        if(H5LTset_attribute_string(outputFile,"MOPITT",comment_name,comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"MOPITT",comment_name,comment_value) <0){
                 FATAL_MSG("Failed to add the MOPITT comment attribute.\n");
                 goto cleanupFail;
         }
     
-        if(H5LTset_attribute_string(outputFile,"MOPITT",time_comment_name,time_comment_value) <0){
+        if(H5LTset_attribute_string(ctx->outputFile,"MOPITT",time_comment_name,time_comment_value) <0){
                 FATAL_MSG("Failed to add the MOPITT time comment attribute.\n");
                 goto cleanupFail;
         }
@@ -168,7 +214,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
     }
     else
     {
-        MOPITTroot = H5Gopen2( outputFile, "MOPITT", H5P_DEFAULT );
+        MOPITTroot = H5Gopen2( ctx->outputFile, "MOPITT", H5P_DEFAULT );
         if ( MOPITTroot < 0 )
         {
             MOPITTroot = 0;
@@ -247,7 +293,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
      ********************/
 
     // insert the radiance dataset
-    radianceDataset = MOPITTinsertDataset( &file, &radianceGroup, RADIANCE, "MOPITTRadiances", H5T_NATIVE_FLOAT, 1, bound );
+    radianceDataset = MOPITTinsertDataset( ctx, &file, &radianceGroup, RADIANCE, "MOPITTRadiances", H5T_NATIVE_FLOAT, 1, bound );
     if ( radianceDataset == FATAL_ERR )
     {
         FATAL_MSG("Unable to insert MOPITT radiance dataset.\n");
@@ -274,7 +320,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
     // KY 2017-10-24
     if ( group_info.nlinks == 0 )
     {
-        ntrackID = MOPITTaddDimension( outputFile, "ntrack_1", dimSize, intArray, H5T_NATIVE_INT );
+        ntrackID = MOPITTaddDimension( ctx, ctx->outputFile, "ntrack_1", dimSize, intArray, H5T_NATIVE_INT );
         if ( ntrackID == FAIL )
         {
             ntrackID = 0;
@@ -299,28 +345,28 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         memset(intArray, 0, 34);
 
         dimSize = 29;
-        nstareID = MOPITTaddDimension( outputFile, "nstare", dimSize, intArray, H5T_NATIVE_INT );
+        nstareID = MOPITTaddDimension( ctx, ctx->outputFile, "nstare", dimSize, intArray, H5T_NATIVE_INT );
         if ( nstareID == FAIL )
         {
             nstareID = 0;
             FATAL_MSG("Failed to add MOPITT dimension.\n");
             goto cleanupFail;
         }
-        if ( change_dim_attr_NAME_value(nstareID) == FAIL )
+        if ( change_dim_attr_NAME_value(ctx,nstareID) == FAIL )
         {
             FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
             goto cleanupFail;
         }
 
         dimSize = 4;
-        npixelsID = MOPITTaddDimension( outputFile, "npixels", dimSize, intArray, H5T_NATIVE_INT );
+        npixelsID = MOPITTaddDimension( ctx, ctx->outputFile, "npixels", dimSize, intArray, H5T_NATIVE_INT );
         if ( npixelsID == FAIL )
         {
             npixelsID = 0;
             FATAL_MSG("Failed to add MOPITT dimension.\n");
             goto cleanupFail;
         }
-        if ( change_dim_attr_NAME_value(npixelsID) == FAIL )
+        if ( change_dim_attr_NAME_value(ctx,npixelsID) == FAIL )
         {
             FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
             goto cleanupFail;
@@ -328,14 +374,14 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
 
         dimSize = 8;
-        nchanID = MOPITTaddDimension( outputFile, "nchan", dimSize, intArray, H5T_NATIVE_INT );
+        nchanID = MOPITTaddDimension( ctx, ctx->outputFile, "nchan", dimSize, intArray, H5T_NATIVE_INT );
         if ( nchanID == FAIL )
         {
             nchanID = 0;
             FATAL_MSG("Failed to add MOPITT dimension.\n");
             goto cleanupFail;
         }
-        if ( change_dim_attr_NAME_value(nchanID) == FAIL )
+        if ( change_dim_attr_NAME_value(ctx,nchanID) == FAIL )
         {
             FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
             goto cleanupFail;
@@ -343,14 +389,14 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
 
         dimSize = 2;
-        nstateID = MOPITTaddDimension( outputFile, "nstate", dimSize, intArray, H5T_NATIVE_INT );
+        nstateID = MOPITTaddDimension( ctx, ctx->outputFile, "nstate", dimSize, intArray, H5T_NATIVE_INT );
         if ( nstateID == FAIL )
         {
             nstateID = 0;
             FATAL_MSG("Failed to add MOPITT dimension.\n");
             goto cleanupFail;
         }
-        if ( change_dim_attr_NAME_value(nstateID) == FAIL )
+        if ( change_dim_attr_NAME_value(ctx,nstateID) == FAIL )
         {
             FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
             goto cleanupFail;
@@ -358,7 +404,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
     }
     else if ( group_info.nlinks == 1 )
     {
-        ntrackID = MOPITTaddDimension( outputFile, "ntrack_2", dimSize, intArray, H5T_NATIVE_INT );
+        ntrackID = MOPITTaddDimension( ctx, ctx->outputFile, "ntrack_2", dimSize, intArray, H5T_NATIVE_INT );
         if ( ntrackID == FAIL )
         {
             ntrackID = 0;
@@ -370,7 +416,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
            equaled 0). So, just open them.
         */
 
-        nstareID = H5Dopen2( outputFile, "nstare", H5P_DEFAULT);
+        nstareID = H5Dopen2( ctx->outputFile, "nstare", H5P_DEFAULT);
         if ( nstareID < 0 )
         {
             FATAL_MSG("Failed to open nstare dimension.\n");
@@ -378,7 +424,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             goto cleanupFail;
         }
 
-        npixelsID = H5Dopen2( outputFile, "npixels", H5P_DEFAULT);
+        npixelsID = H5Dopen2( ctx->outputFile, "npixels", H5P_DEFAULT);
         if ( npixelsID < 0 )
         {
             FATAL_MSG("Failed to open npixels dimension.\n");
@@ -386,7 +432,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             goto cleanupFail;
         }
 
-        nchanID = H5Dopen2( outputFile, "nchan", H5P_DEFAULT);
+        nchanID = H5Dopen2( ctx->outputFile, "nchan", H5P_DEFAULT);
         if ( nchanID < 0 )
         {
             FATAL_MSG("Failed to open nchan dimension.\n");
@@ -394,7 +440,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             goto cleanupFail;
         }
 
-        nstateID = H5Dopen2( outputFile, "nstate", H5P_DEFAULT);
+        nstateID = H5Dopen2( ctx->outputFile, "nstate", H5P_DEFAULT);
         if ( nstateID < 0 )
         {
             FATAL_MSG("Failed to open nstate dimension.\n");
@@ -410,7 +456,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
 
     /* Change the NAME attribute for this dimension */
-    if ( change_dim_attr_NAME_value(ntrackID) == FAIL )
+    if ( change_dim_attr_NAME_value(ctx,ntrackID) == FAIL )
     {
         FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
         goto cleanupFail;
@@ -418,31 +464,31 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
     /* Attach these dimensions to the dataset */
     
-    status = H5DSattach_scale( radianceDataset, ntrackID, 0 );
+    status = registerDimScale( ctx, radianceDataset, ntrackID, 0 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( radianceDataset, nstareID, 1 );
+    status = registerDimScale( ctx, radianceDataset, nstareID, 1 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( radianceDataset, npixelsID, 2 );
+    status = registerDimScale( ctx, radianceDataset, npixelsID, 2 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( radianceDataset, nchanID, 3 );
+    status = registerDimScale( ctx, radianceDataset, nchanID, 3 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( radianceDataset, nstateID, 4 );
+    status = registerDimScale( ctx, radianceDataset, nstateID, 4 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
@@ -456,7 +502,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
      *********************/
 
     // insert the longitude dataset
-    longitudeDataset = MOPITTinsertDataset( &file, &geolocationGroup, LONGITUDE, "Longitude", H5T_NATIVE_FLOAT, 1, bound );
+    longitudeDataset = MOPITTinsertDataset( ctx, &file, &geolocationGroup, LONGITUDE, "Longitude", H5T_NATIVE_FLOAT, 1, bound );
     if ( longitudeDataset == FATAL_ERR )
     {
         FATAL_MSG("Unable to insert MOPITT longitude dataset.\n");
@@ -518,19 +564,19 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         ntrack, nstare, npixels
     */
 
-    status = H5DSattach_scale( longitudeDataset, ntrackID, 0 );
+    status = registerDimScale( ctx, longitudeDataset, ntrackID, 0 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( longitudeDataset, nstareID, 1 );
+    status = registerDimScale( ctx, longitudeDataset, nstareID, 1 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( longitudeDataset, npixelsID, 2 );
+    status = registerDimScale( ctx, longitudeDataset, npixelsID, 2 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
@@ -549,7 +595,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
      ********************/
 
     // insert the latitude dataset
-    latitudeDataset = MOPITTinsertDataset( &file, &geolocationGroup, LATITUDE, "Latitude", H5T_NATIVE_FLOAT, 1, bound );
+    latitudeDataset = MOPITTinsertDataset( ctx, &file, &geolocationGroup, LATITUDE, "Latitude", H5T_NATIVE_FLOAT, 1, bound );
     if ( latitudeDataset == FATAL_ERR )
     {
         FATAL_MSG("Unable to insert MOPITT latitude dataset.\n");
@@ -610,19 +656,19 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         ntrack, nstare, npixels
     */
 
-    status = H5DSattach_scale( latitudeDataset, ntrackID, 0 );
+    status = registerDimScale( ctx, latitudeDataset, ntrackID, 0 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( latitudeDataset, nstareID, 1 );
+    status = registerDimScale( ctx, latitudeDataset, nstareID, 1 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
         goto cleanupFail;
     }
-    status = H5DSattach_scale( latitudeDataset, npixelsID, 2 );
+    status = registerDimScale( ctx, latitudeDataset, npixelsID, 2 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
@@ -635,6 +681,12 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
     latitudeDataset = 0;
 
+    if ( indexGeolocation( ctx, "MOPITT", geolocationGroup, "Latitude", "Longitude", SPATIAL_UNIT_MOPITT ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to index the MOPITT geolocation.\n");
+        goto cleanupFail;
+    }
+
 
 
     /* Attach the coordinates attribute to the radiance dataset (latitude and longitude HDF5 paths) */
@@ -692,7 +744,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
      ****************/
     // insert the time dataset
     // Note that the time dataset is converted from TAI93 time to UTC time in this function.
-    timeDataset = MOPITTinsertDataset( &file, &geolocationGroup, TIME, "Time", H5T_NATIVE_DOUBLE, 1, bound);
+    timeDataset = MOPITTinsertDataset( ctx, &file, &geolocationGroup, TIME, "Time", H5T_NATIVE_DOUBLE, 1, bound);
     if ( timeDataset < 0 )
     {
         FATAL_MSG("Unable to insert MOPITT time dataset.\n");
@@ -700,7 +752,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         goto cleanupFail;
     }
 
-    status = H5DSattach_scale( timeDataset, ntrackID, 0 );
+    status = registerDimScale( ctx, timeDataset, ntrackID, 0 );
     if ( status < 0 )
     {
         FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1095,7 +1147,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 // TODO
 //#if 0
         // level0StdDev       
-        level0StdDataset = MOPITTinsertDataset( &file, &radianceGroup, L0StdDev, "Level0StdDev", H5T_NATIVE_FLOAT, 1, bound );
+        level0StdDataset = MOPITTinsertDataset( ctx, &file, &radianceGroup, L0StdDev, "Level0StdDev", H5T_NATIVE_FLOAT, 1, bound );
         if ( level0StdDataset == FATAL_ERR )
         {
             FATAL_MSG("Unable to insert MOPITT Level0StdDev dataset.\n");
@@ -1104,31 +1156,31 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         }
 
         // All the dimensions for level10StdDev habe been created. Just need to attach them. 
-        status = H5DSattach_scale( level0StdDataset, ntrackID, 0 );
+        status = registerDimScale( ctx, level0StdDataset, ntrackID, 0 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
-        status = H5DSattach_scale( level0StdDataset, nstareID, 1 );
+        status = registerDimScale( ctx, level0StdDataset, nstareID, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
-        status = H5DSattach_scale( level0StdDataset, npixelsID, 2 );
+        status = registerDimScale( ctx, level0StdDataset, npixelsID, 2 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
-        status = H5DSattach_scale( level0StdDataset, nchanID, 3 );
+        status = registerDimScale( ctx, level0StdDataset, nchanID, 3 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
-        status = H5DSattach_scale( level0StdDataset, nstateID, 4 );
+        status = registerDimScale( ctx, level0StdDataset, nstateID, 4 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1143,7 +1195,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         // Geometry datasets
         for (int i  = 0; i <4;i++) {
 
-            GeoMetryDataset[i] = MOPITTinsertDataset( &file, &radianceGroup, mop_geom[i], bf_mop_geom[i], H5T_NATIVE_FLOAT, 1, bound );
+            GeoMetryDataset[i] = MOPITTinsertDataset( ctx, &file, &radianceGroup, mop_geom[i], bf_mop_geom[i], H5T_NATIVE_FLOAT, 1, bound );
             if ( GeoMetryDataset[i] == FATAL_ERR )
             {
                 FATAL_MSG("Unable to insert MOPITT Level0StdDev dataset.\n");
@@ -1152,19 +1204,19 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
     
             // All the dimensions for level10StdDev habe been created. Just need to attach them. 
-            status = H5DSattach_scale( GeoMetryDataset[i], ntrackID, 0 );
+            status = registerDimScale( ctx, GeoMetryDataset[i], ntrackID, 0 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
                 goto cleanupFail;
             }
-            status = H5DSattach_scale( GeoMetryDataset[i], nstareID, 1 );
+            status = registerDimScale( ctx, GeoMetryDataset[i], nstareID, 1 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
                 goto cleanupFail;
             }
-            status = H5DSattach_scale( GeoMetryDataset[i], npixelsID, 2 );
+            status = registerDimScale( ctx, GeoMetryDataset[i], npixelsID, 2 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1180,7 +1232,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         // SwathQuality and PacketPositions       
         for (int i  = 0; i <2;i++) {
 
-            PacketQualityDataset[i] = MOPITTinsertDataset( &file, &radianceGroup, PacQual[i], bf_PacQual[i], H5T_NATIVE_INT, 1, bound );
+            PacketQualityDataset[i] = MOPITTinsertDataset( ctx, &file, &radianceGroup, PacQual[i], bf_PacQual[i], H5T_NATIVE_INT, 1, bound );
             if ( PacketQualityDataset[i] == FATAL_ERR )
             {
                 FATAL_MSG("Unable to insert MOPITT PacketPositions or SwathQuality dataset.\n");
@@ -1189,14 +1241,14 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
     
             // All the dimensions for level10StdDev habe been created. Just need to attach them. 
-            status = H5DSattach_scale( PacketQualityDataset[i], ntrackID, 0 );
+            status = registerDimScale( ctx, PacketQualityDataset[i], ntrackID, 0 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
                 goto cleanupFail;
             }
             if( i == 0) {
-                status = H5DSattach_scale( PacketQualityDataset[i], nstareID, 1 );
+                status = registerDimScale( ctx, PacketQualityDataset[i], nstareID, 1 );
                 if ( status < 0 )
                 {
                     FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1215,7 +1267,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         // DailyGain/DailyMeanNoise
         for (int i  = 0; i <2;i++) {
 
-            dailyGMDataset[i] = MOPITTinsertDataset( &file, &radianceGroup, DailyGainMean[i], bf_DailyGainMean[i], H5T_NATIVE_FLOAT, 1, NULL );
+            dailyGMDataset[i] = MOPITTinsertDataset( ctx, &file, &radianceGroup, DailyGainMean[i], bf_DailyGainMean[i], H5T_NATIVE_FLOAT, 1, NULL );
             if ( dailyGMDataset[i] == FATAL_ERR )
             {
                 FATAL_MSG("Unable to insert MOPITT Level0StdDev dataset.\n");
@@ -1224,19 +1276,19 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
     
             // All the dimensions for level10StdDev habe been created. Just need to attach them. 
-            status = H5DSattach_scale( dailyGMDataset[i], npixelsID, 0 );
+            status = registerDimScale( ctx, dailyGMDataset[i], npixelsID, 0 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
                 goto cleanupFail;
             }
-            status = H5DSattach_scale( dailyGMDataset[i], nchanID, 1 );
+            status = registerDimScale( ctx, dailyGMDataset[i], nchanID, 1 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
                 goto cleanupFail;
             }
-            status = H5DSattach_scale( dailyGMDataset[i], nstateID, 2 );
+            status = registerDimScale( ctx, dailyGMDataset[i], nstateID, 2 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1252,7 +1304,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         // Calibration and SecCalibration
         for (int i  = 0; i <2;i++) {
 
-            CalAndsecCalDataset[i] = MOPITTinsertDataset( &file, &radianceGroup, CalAndSecCal[i], bf_CalAndSecCal[i], H5T_NATIVE_FLOAT, 1, bound );
+            CalAndsecCalDataset[i] = MOPITTinsertDataset( ctx, &file, &radianceGroup, CalAndSecCal[i], bf_CalAndSecCal[i], H5T_NATIVE_FLOAT, 1, bound );
             if ( CalAndsecCalDataset[i] == FATAL_ERR )
             {
                 FATAL_MSG("Unable to insert MOPITT Level0StdDev dataset.\n");
@@ -1261,7 +1313,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
 
             // All the dimensions for level10StdDev habe been created. Just need to attach them. 
-            status = H5DSattach_scale( CalAndsecCalDataset[i], ntrackID, 0 );
+            status = registerDimScale( ctx, CalAndsecCalDataset[i], ntrackID, 0 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1269,13 +1321,13 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
 
             // All the dimensions for level10StdDev habe been created. Just need to attach them. 
-            status = H5DSattach_scale( CalAndsecCalDataset[i], npixelsID, 1 );
+            status = registerDimScale( ctx, CalAndsecCalDataset[i], npixelsID, 1 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
                 goto cleanupFail;
             }
-            status = H5DSattach_scale( CalAndsecCalDataset[i], nchanID, 2 );
+            status = registerDimScale( ctx, CalAndsecCalDataset[i], nchanID, 2 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1283,7 +1335,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
 
             if( i == 0) {//Calibration has dimension nstate
-                status = H5DSattach_scale( CalAndsecCalDataset[i], nstateID, 3 );
+                status = registerDimScale( ctx, CalAndsecCalDataset[i], nstateID, 3 );
                 if ( status < 0 )
                 {
                     FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1294,21 +1346,21 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
                 if ( group_info.nlinks == 0 ) {
                     dimSize = 4;
-                    nsectorID = MOPITTaddDimension( outputFile, "nsector", dimSize, intArray, H5T_NATIVE_INT );
+                    nsectorID = MOPITTaddDimension( ctx, ctx->outputFile, "nsector", dimSize, intArray, H5T_NATIVE_INT );
                     if ( nsectorID == FAIL )
                     {
                         nsectorID = 0;
                         FATAL_MSG("Failed to add MOPITT dimension.\n");
                         goto cleanupFail;
                     }
-                    if ( change_dim_attr_NAME_value(nsectorID) == FAIL )
+                    if ( change_dim_attr_NAME_value(ctx,nsectorID) == FAIL )
                     {
                         FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
                         goto cleanupFail;
                     }
                 }
                 else {
-                    nsectorID = H5Dopen2( outputFile, "nsector", H5P_DEFAULT);
+                    nsectorID = H5Dopen2( ctx->outputFile, "nsector", H5P_DEFAULT);
                     if ( nsectorID < 0 )
                     {
                         FATAL_MSG("Failed to open nsector dimension.\n");
@@ -1316,7 +1368,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
                         goto cleanupFail;
                     }
                 }
-                status = H5DSattach_scale( CalAndsecCalDataset[i], nsectorID, 3 );
+                status = registerDimScale( ctx, CalAndsecCalDataset[i], nsectorID, 3 );
                 if ( status < 0 )
                 {
                     FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1326,21 +1378,21 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
             if ( group_info.nlinks == 0 && i == 0) {
                 dimSize = 8;
-                ncalibID = MOPITTaddDimension( outputFile, "ncalib", dimSize, intArray, H5T_NATIVE_INT );
+                ncalibID = MOPITTaddDimension( ctx, ctx->outputFile, "ncalib", dimSize, intArray, H5T_NATIVE_INT );
                 if ( ncalibID == FAIL )
                 {
                     ncalibID = 0;
                     FATAL_MSG("Failed to add MOPITT dimension.\n");
                     goto cleanupFail;
                 }
-                if ( change_dim_attr_NAME_value(ncalibID) == FAIL )
+                if ( change_dim_attr_NAME_value(ctx,ncalibID) == FAIL )
                 {
                     FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
                     goto cleanupFail;
                 }
             }
             else if(group_info.nlinks ==1 && i ==0) {
-                ncalibID = H5Dopen2( outputFile, "ncalib", H5P_DEFAULT);
+                ncalibID = H5Dopen2( ctx->outputFile, "ncalib", H5P_DEFAULT);
                 if ( ncalibID < 0 )
                 {
                     FATAL_MSG("Failed to open ncalib dimension.\n");
@@ -1348,7 +1400,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
                     goto cleanupFail;
                 }
             }
-            status = H5DSattach_scale( CalAndsecCalDataset[i], ncalibID, 4 );
+            status = registerDimScale( ctx, CalAndsecCalDataset[i], ncalibID, 4 );
             if ( status < 0 )
             {
                 FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1361,7 +1413,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
         }
 
         // Engineering Data
-        engDataset = MOPITTinsertDataset( &file, &radianceGroup, EngData, "EngineeringData", H5T_NATIVE_FLOAT, 1, bound );
+        engDataset = MOPITTinsertDataset( ctx, &file, &radianceGroup, EngData, "EngineeringData", H5T_NATIVE_FLOAT, 1, bound );
         if ( engDataset == FATAL_ERR )
         {
             FATAL_MSG("Unable to insert MOPITT Engineering dataset.\n");
@@ -1369,7 +1421,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             goto cleanupFail;
         }
 
-        status = H5DSattach_scale( engDataset, ntrackID, 0 );
+        status = registerDimScale( ctx, engDataset, ntrackID, 0 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1378,27 +1430,27 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
         if ( group_info.nlinks == 0 ) {
             dimSize = 34;
-            nengpointsID = MOPITTaddDimension( outputFile, "nengpoints", dimSize, intArray, H5T_NATIVE_INT );
+            nengpointsID = MOPITTaddDimension( ctx, ctx->outputFile, "nengpoints", dimSize, intArray, H5T_NATIVE_INT );
             if ( nengpointsID == FAIL )
             {
                 nengpointsID = 0;
                 FATAL_MSG("Failed to add MOPITT dimension.\n");
                 goto cleanupFail;
             }
-            if ( change_dim_attr_NAME_value(nengpointsID) == FAIL )
+            if ( change_dim_attr_NAME_value(ctx,nengpointsID) == FAIL )
             {
                 FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
                 goto cleanupFail;
             }
             dimSize = 2;
-            nengID = MOPITTaddDimension( outputFile, "neng", dimSize, intArray, H5T_NATIVE_INT );
+            nengID = MOPITTaddDimension( ctx, ctx->outputFile, "neng", dimSize, intArray, H5T_NATIVE_INT );
             if ( nengID == FAIL )
             {
                 nengID = 0;
                 FATAL_MSG("Failed to add MOPITT dimension.\n");
                 goto cleanupFail;
             }
-            if ( change_dim_attr_NAME_value(nengID) == FAIL )
+            if ( change_dim_attr_NAME_value(ctx,nengID) == FAIL )
             {
                 FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
                 goto cleanupFail;
@@ -1407,14 +1459,14 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
         }
         else {
-            nengpointsID = H5Dopen2( outputFile, "nengpoints", H5P_DEFAULT);
+            nengpointsID = H5Dopen2( ctx->outputFile, "nengpoints", H5P_DEFAULT);
             if ( nengpointsID < 0 )
             {
                 FATAL_MSG("Failed to open nengpoints dimension.\n");
                 nengpointsID = 0;
                 goto cleanupFail;
             }
-            nengID = H5Dopen2( outputFile, "neng", H5P_DEFAULT);
+            nengID = H5Dopen2( ctx->outputFile, "neng", H5P_DEFAULT);
             if ( nengID < 0 )
             {
                 FATAL_MSG("Failed to open neng dimension.\n");
@@ -1423,13 +1475,13 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
 
         }
-        status = H5DSattach_scale( engDataset, nengpointsID, 1 );
+        status = registerDimScale( ctx, engDataset, nengpointsID, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
-        status = H5DSattach_scale( engDataset, nengID, 2 );
+        status = registerDimScale( ctx, engDataset, nengID, 2 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1442,7 +1494,7 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
 //#if 0
         // DailyMean Position Data
-        dailyMPDataset = MOPITTinsertDataset( &file, &radianceGroup, DMPosNoise, "DailyMeanPositionNoise", H5T_NATIVE_FLOAT, 1, NULL );
+        dailyMPDataset = MOPITTinsertDataset( ctx, &file, &radianceGroup, DMPosNoise, "DailyMeanPositionNoise", H5T_NATIVE_FLOAT, 1, NULL );
         if ( dailyMPDataset == FATAL_ERR )
         {
             FATAL_MSG("Unable to insert MOPITT DailyMeanPositionNoise dataset.\n");
@@ -1450,14 +1502,14 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             goto cleanupFail;
         }
 
-        status = H5DSattach_scale( dailyMPDataset, npixelsID, 0 );
+        status = registerDimScale( ctx, dailyMPDataset, npixelsID, 0 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
  
-        status = H5DSattach_scale( dailyMPDataset, nstateID, 2 );
+        status = registerDimScale( ctx, dailyMPDataset, nstateID, 2 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
@@ -1466,27 +1518,27 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
  
         if ( group_info.nlinks == 0 ) {
             dimSize = 2;
-            npchanID = MOPITTaddDimension( outputFile, "npchan", dimSize, intArray, H5T_NATIVE_INT );
+            npchanID = MOPITTaddDimension( ctx, ctx->outputFile, "npchan", dimSize, intArray, H5T_NATIVE_INT );
             if ( npchanID == FAIL )
             {
                 npchanID = 0;
                 FATAL_MSG("Failed to add MOPITT dimension.\n");
                 goto cleanupFail;
             }
-            if ( change_dim_attr_NAME_value(npchanID) == FAIL )
+            if ( change_dim_attr_NAME_value(ctx,npchanID) == FAIL )
             {
                 FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
                 goto cleanupFail;
             }
             dimSize = 5;
-            npositionID = MOPITTaddDimension( outputFile, "nposition", dimSize, intArray, H5T_NATIVE_INT );
+            npositionID = MOPITTaddDimension( ctx, ctx->outputFile, "nposition", dimSize, intArray, H5T_NATIVE_INT );
             if ( npositionID == FAIL )
             {
                 npositionID = 0;
                 FATAL_MSG("Failed to add MOPITT dimension.\n");
                 goto cleanupFail;
             }
-            if ( change_dim_attr_NAME_value(npositionID) == FAIL )
+            if ( change_dim_attr_NAME_value(ctx,npositionID) == FAIL )
             {
                 FATAL_MSG("Failed to change the NAME attribute for a dimension.\n");
                 goto cleanupFail;
@@ -1495,14 +1547,14 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
 
         }
         else {
-            npchanID = H5Dopen2( outputFile, "npchan", H5P_DEFAULT);
+            npchanID = H5Dopen2( ctx->outputFile, "npchan", H5P_DEFAULT);
             if ( npchanID < 0 )
             {
                 FATAL_MSG("Failed to open npchan dimension.\n");
                 npchanID = 0;
                 goto cleanupFail;
             }
-            npositionID = H5Dopen2( outputFile, "nposition", H5P_DEFAULT);
+            npositionID = H5Dopen2( ctx->outputFile, "nposition", H5P_DEFAULT);
             if ( npositionID < 0 )
             {
                 FATAL_MSG("Failed to open nposition dimension.\n");
@@ -1511,19 +1563,19 @@ int MOPITT( char* inputFile, OInfo_t cur_orbit_info )
             }
 
         }
-        status = H5DSattach_scale( dailyMPDataset, npchanID, 1 );
+        status = registerDimScale( ctx, dailyMPDataset, npchanID, 1 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
-        status = H5DSattach_scale( dailyMPDataset, nstateID, 2 );
+        status = registerDimScale( ctx, dailyMPDataset, nstateID, 2 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
             goto cleanupFail;
         }
-        status = H5DSattach_scale( dailyMPDataset, npositionID, 3 );
+        status = registerDimScale( ctx, dailyMPDataset, npositionID, 3 );
         if ( status < 0 )
         {
             FATAL_MSG("Failed to attach dimension scale.\n");
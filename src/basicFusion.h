@@ -0,0 +1,73 @@
+#ifndef BASICFUSION_H
+#define BASICFUSION_H
+#include <stddef.h>
+#include <hdf5.h>
+
+/* The interface of libbasicfusion, the conversion core of basicFusion as a shared library (make lib).
+ * bfConvert fuses one orbit like the basicFusion program, and hands every dataset of the output to a
+ * sink as it is produced, so that the data can go straight into an analysis pipeline or another
+ * container. The output file can be kept in memory only, in which case nothing is written to disk.
+ *
+ * The settings are read from the environment, from the same variables as the program (see initContext),
+ * and bfConvert keeps its run state in process-wide variables. So only one bfConvert may run in a process
+ * at a time, and it is not thread-safe (neither is the HDF4 library). BF_SPLIT_OUTPUT, which forks a
+ * process per instrument, is refused by the library.
+ *
+ * A dataset is handed over when the unit of work that wrote it (the MOPITT files, the CERES files, a
+ * MODIS or ASTER granule, the MISR files) is complete, with all its attributes. The datasets written
+ * at the end of the orbit (spatial index, collocation, checksum manifest) follow before bfConvert
+ * returns, and then every group with its attributes. Every dataset and group of the output file is
+ * handed over exactly once. The pointers passed to the sink are only valid during the call. The sink
+ * cannot be combined with MPI, and a sink without keepFile cannot be combined with BF_RESUME or
+ * BF_REFUSE_INSTRUMENT.
+ */
+
+typedef struct BFsinkAttr
+{
+    const char* name;
+    hid_t type;                 // Native memory type. Strings have class H5T_STRING.
+    size_t numElems;
+    const void* value;          // numElems values of type, or numElems char* for strings
+} BFsinkAttr_t;
+
+typedef struct BFsinkDataset
+{
+    const char* groupPath;      // Absolute path of the group, e.g. "/MODIS/granule_1/_1KM/Data Fields"
+    const char* name;
+    int rank;
+    const hsize_t* dims;
+    const char* const* dimScales; // Per dimension, the path of the attached dimension scale, or NULL
+    hid_t type;                 // Native memory type of buffer
+    const void* buffer;
+    size_t numAttrs;
+    const BFsinkAttr_t* attrs;  // Numeric and string attributes. Dimension scale bookkeeping is left out.
+} BFsinkDataset_t;
+
+typedef struct BFsink
+{
+    /* Called once per dataset. A negative return value stops the conversion with an error. */
+    herr_t (*dataset)( void* userData, const BFsinkDataset_t* dataset );
+    void* userData;
+    int keepFile;               // Non-zero also writes outputFile. Zero keeps the output in memory only.
+    /* Called once per group, "/" included, at the end of the orbit. May be NULL. */
+    herr_t (*group)( void* userData, const char* groupPath, size_t numAttrs, const BFsinkAttr_t* attrs );
+} BFsink_t;
+
+/*
+                    bfConvert
+    DESCRIPTION:
+        This function fuses one orbit, like running basicFusion outputFile inputList orbitTable.
+    ARGUMENTS:
+        1. outputFile -- The output file name. Only a name if the sink does not keep the file.
+        2. inputList  -- The input file list (see genFusionInput.sh)
+        3. orbitTable -- The orbit table (orbit_info.bin)
+        4. sink       -- Receives the datasets. May be NULL to only write outputFile.
+    EFFECTS:
+        Writes outputFile unless the sink keeps the output in memory. Calls the sink.
+    RETURN:
+        0 on success, -1 on failure
+*/
+
+int bfConvert( const char* outputFile, const char* inputList, const char* orbitTable, const BFsink_t* sink );
+
+#endif
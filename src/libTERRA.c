@@ -11,6 +11,7 @@
 */
 
 #include "libTERRA.h"
+#include "xxhash64.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -20,8 +21,201 @@
 #include <hdf.h>
 #include <mfhdf.h>
 #include <assert.h>
+#include <sys/stat.h>
 #define DIM_MAX 10
 
+/* A dimension scale attachment recorded by registerDimScale and written by flushDimScales */
+typedef struct dimAttach
+{
+    hid_t fileID;
+    haddr_t dsetAddr;
+    haddr_t scaleAddr;
+    unsigned int dimIndex;
+} dimAttach_t;
+
+/* The string datatypes of one context, one per size (see getStringType) */
+struct stringTypes
+{
+    struct { size_t size; hid_t type; }* types;
+    size_t num;
+    size_t size;
+};
+
+/* Reads a non-negative decimal environment variable. Returns def if it is not set or not a number. */
+static long envNumber( const char* name, long def )
+{
+    const char* s = getenv(name);
+
+    if ( s == NULL || !isdigit((int)*s) )
+        return def;
+    return strtol( s, NULL, 10 );
+}
+
+/*
+                    parseKeepBits
+    DESCRIPTION:
+        This function parses the BF_KEEP_BITS setting, a comma-separated list of a default and/or
+        name=bits rules, e.g. "12,EV_1KM_RefSB=14,Red Radiance=10" (see getKeepBits).
+    ARGUMENTS:
+        1. ctx -- The context to store the default and the rules in
+        2. s   -- The value of BF_KEEP_BITS
+    EFFECTS:
+        Sets ctx->keepBitsDefault and ctx->keepBitsRules.
+    RETURN:
+        FATAL_ERR if s is malformed
+        RET_SUCCESS otherwise
+*/
+
+static herr_t parseKeepBits( BFcontext_t* ctx, const char* s )
+{
+    while ( s && *s )
+    {
+        size_t len = strcspn( s, "," );
+        const char* eq = memchr( s, '=', len );
+        const char* value = eq ? eq + 1 : s;
+        char* end = NULL;
+        long val = strtol( value, &end, 10 );
+
+        if ( end == value || end != s + len || val < 0 || val > KEEP_BITS_MAX ||
+             ( eq && ( eq == s || (size_t)(eq - s) >= H4_MAX_NC_NAME || ctx->numKeepBitsRules == MAX_KEEP_BITS_RULES ) ) )
+        {
+            FATAL_MSG("Malformed BF_KEEP_BITS at \"%.*s\".\n\tUse a bit count from 0 to %d or name=bits, separated by commas.\n",
+                      (int) len, s, KEEP_BITS_MAX);
+            ctx->keepBitsDefault = 0;
+            ctx->numKeepBitsRules = 0;
+            return FATAL_ERR;
+        }
+
+        if ( eq )
+        {
+            keepBitsRule_t* rule = &ctx->keepBitsRules[ctx->numKeepBitsRules++];
+            memcpy( rule->name, s, eq - s );
+            rule->name[eq - s] = '\0';
+            rule->bits = (int) val;
+        }
+        else
+            ctx->keepBitsDefault = (int) val;
+
+        s += len;
+        if ( *s == ',' )
+            s++;
+    }
+
+    return RET_SUCCESS;
+}
+
+/*
+                    initContext
+    DESCRIPTION:
+        This function sets up the context of a conversion. The settings of the conversion are read
+        from the environment here, once, so that a malformed value stops the program before any
+        granule is written:
+
+        TERRA_DATA_UNPACK       0 keeps the packed input data, 2 writes scaled integers with CF
+                                packing attributes (see setScaledAttrs), and any other number or no
+                                value at all unpacks the radiances to floats.
+        USE_CHUNK               1 writes the datasets chunked.
+        USE_GZIP                The deflate level of chunked datasets, 0 to 9.
+        BF_KEEP_BITS            See getKeepBits.
+        BF_STATS                1 stores statistics of the unpacked radiances (see initDatasetStats).
+        BF_OVERVIEWS            The number of overview levels, up to OVERVIEW_MAX_LEVELS (see writeOverviews).
+        BF_SPATIAL_INDEX        0 leaves out the spatial index (see indexGeolocation).
+        BF_COLLOCATE            1 collocates the instruments (see collocateInstruments).
+        BF_COLLOCATE_CERES_KM   The CERES footprint radius, COLLOCATE_CERES_KM by default.
+        BF_CHECKSUM             1 stores checksums of every dataset (see writeChecksums).
+    ARGUMENTS:
+        1. ctx -- The context to set up
+    EFFECTS:
+        Overwrites ctx. ctx->outputFile is 0 until the caller opens the output. Release the context with
+        freeContext.
+    RETURN:
+        FATAL_ERR if a setting is malformed
+        RET_SUCCESS otherwise
+*/
+
+herr_t initContext( BFcontext_t* ctx )
+{
+    const char* s = NULL;
+    long val = 0;
+
+    memset( ctx, 0, sizeof *ctx );
+
+    val = envNumber( "TERRA_DATA_UNPACK", 1 );
+    ctx->unpack = val == 0 ? UNPACK_NONE : ( val == 2 ? UNPACK_SCALED : UNPACK_FLOAT );
+    ctx->useChunk = envNumber( "USE_CHUNK", 0 ) == 1;
+
+    val = envNumber( "USE_GZIP", 0 );
+    if ( val > 9 )
+    {
+        FATAL_MSG("The environment variable USE_GZIP should be between 0 and 9 inclusive.\n\tIts current value is %ld.\n", val);
+        return FATAL_ERR;
+    }
+    ctx->gzipLevel = (int) val;
+
+    if ( parseKeepBits( ctx, getenv("BF_KEEP_BITS") ) == FATAL_ERR )
+        return FATAL_ERR;
+
+    ctx->stats = envNumber( "BF_STATS", 0 ) == 1;
+
+    val = envNumber( "BF_OVERVIEWS", 0 );
+    if ( val > OVERVIEW_MAX_LEVELS )
+    {
+        WARN_MSG("BF_OVERVIEWS is limited to %d levels.\n", OVERVIEW_MAX_LEVELS);
+        val = OVERVIEW_MAX_LEVELS;
+    }
+    ctx->overviewLevels = (int) val;
+
+    ctx->spatialIndex = envNumber( "BF_SPATIAL_INDEX", 1 ) != 0;
+    ctx->collocate = envNumber( "BF_COLLOCATE", 0 ) != 0;
+    ctx->collocateCeresKm = COLLOCATE_CERES_KM;
+    s = getenv("BF_COLLOCATE_CERES_KM");
+    if ( s && strtod( s, NULL ) > 0.0 )
+        ctx->collocateCeresKm = strtod( s, NULL );
+    ctx->checksum = envNumber( "BF_CHECKSUM", 0 ) != 0;
+
+    /* Allocated here so that getStringType can add to it through a const context */
+    ctx->stringTypes = calloc( 1, sizeof *ctx->stringTypes );
+    if ( ctx->stringTypes == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return FATAL_ERR;
+    }
+
+    return RET_SUCCESS;
+}
+
+/*
+                    freeContext
+    DESCRIPTION:
+        This function releases what a conversion context holds. It does not close ctx->outputFile.
+        Dimension scale attachments that were not flushed are dropped.
+    ARGUMENTS:
+        1. ctx -- The context set up by initContext
+    EFFECTS:
+        Frees the TAI93 offset table, the dimension scale registry and the list of datasets handed to
+        the sink, releases the files the registry refers to and closes the string datatypes of
+        getStringType.
+    RETURN:
+        None
+*/
+
+void freeContext( BFcontext_t* ctx )
+{
+    for ( size_t i = 0; i < ctx->dimRegistryNum; i++ )
+        H5Fclose( ctx->dimRegistry[i].fileID );
+    free( ctx->dimRegistry );
+    free( ctx->TAI93toUTCoffset );
+    free( ctx->sinkSent );
+    if ( ctx->stringTypes )
+    {
+        for ( size_t i = 0; i < ctx->stringTypes->num; i++ )
+            H5Tclose( ctx->stringTypes->types[i].type );
+        free( ctx->stringTypes->types );
+        free( ctx->stringTypes );
+    }
+    memset( ctx, 0, sizeof *ctx );
+}
+
 
 /*
                         insertDataset
@@ -33,7 +227,7 @@
         identifier).
 
     ARGUMENTS:
-        1. outputFileID    -- A pointer to the file identifier of the output file.
+        1. ctx             -- The conversion context, for its settings (see initContext)
         2. datasetGroup_ID -- A pointer to the group in the output file where the data is
                               to be written to.
         3. returnDatasetID -- An integer (boolean). 0 means do not return the identifier
@@ -70,14 +264,21 @@
             Returns FATAL_ERR upon an error.
             Returns the identifier to the newly created dataset upon success.
 */
-/* OutputFileID is not used. NO need to have this parameter. MY 2017-03-03 */
-hid_t insertDataset(  hid_t const *outputFileID, hid_t *datasetGroup_ID, int returnDatasetID,
+hid_t insertDataset( const BFcontext_t* ctx, hid_t *datasetGroup_ID, int returnDatasetID,
                       int rank, hsize_t* datasetDims, hid_t dataType, const char *datasetName, const void* data_out)
 {
     hid_t memspace;
     hid_t dataset;
     herr_t status;
     char *correct_dsetname;
+    hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+
+    if(plist_id <0 || setAttrPhaseChange(plist_id) == FATAL_ERR)
+    {
+        FATAL_MSG("Cannot create the HDF5 dataset creation property list.\n");
+        if(plist_id >=0) H5Pclose(plist_id);
+        return(FATAL_ERR);
+    }
 
     memspace = H5Screate_simple( rank, datasetDims, NULL );
 
@@ -86,7 +287,8 @@ hid_t insertDataset(  hid_t const *outputFileID, hid_t *datasetGroup_ID, int ret
     correct_dsetname = correct_name(datasetName);
 
     dataset = H5Dcreate( *datasetGroup_ID, correct_dsetname, dataType, memspace,
-                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+                         H5P_DEFAULT, plist_id, H5P_DEFAULT );
+    H5Pclose(plist_id);
     if(dataset<0)
     {
         FATAL_MSG("Unable to create dataset \"%s\".\n", datasetName );
@@ -105,6 +307,15 @@ hid_t insertDataset(  hid_t const *outputFileID, hid_t *datasetGroup_ID, int ret
         return (FATAL_ERR);
     }
 
+    if ( writeChecksums( ctx, dataset, rank, datasetDims, dataType, data_out, NULL ) == FATAL_ERR )
+    {
+        FATAL_MSG("Unable to write the checksums of dataset \"%s\".\n", datasetName );
+        H5Dclose(dataset);
+        H5Sclose(memspace);
+        free(correct_dsetname);
+        return (FATAL_ERR);
+    }
+
     /* Free all remaining memory */
     free(correct_dsetname);
     H5Sclose(memspace);
@@ -126,14 +337,15 @@ hid_t insertDataset(  hid_t const *outputFileID, hid_t *datasetGroup_ID, int ret
 }
 
 /*
-                        insertDataset_comp
+                        insertDatasetChunked
     DESCRIPTION:
         This function is identical to the insertDataset() function with the addition of
-        enabling HDF compression. The compression level is set by the environment variable
-        USE_GZIP and can be an integer value from 1 to 9.
+        enabling HDF compression. The compression level is ctx->gzipLevel, set by the environment
+        variable USE_GZIP, and can be an integer value from 1 to 9. It is called through
+        insertDataset_comp() and insertDataset_comp_shuffle().
 
     ARGUMENTS:
-        1. outputFileID    -- A pointer to the file identifier of the output file.
+        1. ctx             -- The conversion context, for its settings (see initContext)
         2. datasetGroup_ID -- A pointer to the group in the output file where the data is
                               to be written to.
         3. returnDatasetID -- An integer (boolean). 0 means do not return the identifier
@@ -156,6 +368,10 @@ hid_t insertDataset(  hid_t const *outputFileID, hid_t *datasetGroup_ID, int ret
                               the type of data contained in the array may vary between
                               function calls. The appropriate casting is applied in this
                               function.
+        9. is_modis        -- Non-zero to chunk a 3-D MODIS dataset band by band.
+        10. shuffle        -- Non-zero to apply the shuffle filter before deflate.
+        11. tileRows       -- Non-zero to chunk the dataset by tileRows rows of the slowest dimension,
+                              the statistics tiles (see insertDataset_comp_tiled). Ignored with is_modis.
 
     EFFECTS:
         The data_out array will be written under the group provided by datasetGroup_ID.
@@ -170,15 +386,16 @@ hid_t insertDataset(  hid_t const *outputFileID, hid_t *datasetGroup_ID, int ret
             Returns FATAL_ERR upon an error.
             Returns the identifier to the newly created dataset upon success.
 */
-hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int returnDatasetID,
-                          int rank, hsize_t* datasetDims, hid_t dataType, const char* datasetName, void* data_out, unsigned short is_modis)
+static hid_t insertDatasetChunked( const BFcontext_t* ctx, hid_t *datasetGroup_ID, int returnDatasetID,
+                          int rank, hsize_t* datasetDims, hid_t dataType, const char* datasetName, void* data_out,
+                          unsigned short is_modis, int shuffle, hsize_t tileRows )
 {
     hid_t memspace;
     hid_t dataset;
     herr_t status;
     char *correct_dsetname;
 
-    //hsize_t chunk_dims[DIM_MAX];
+    hsize_t chunkdims[DIM_MAX];
     hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
 
     if(plist_id <0)
@@ -189,7 +406,6 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
 
     if(is_modis ==1 && rank ==3) {
 
-        hsize_t chunkdims[3];
         chunkdims[0]=1;
         chunkdims[1]=datasetDims[1];
         chunkdims[2]=datasetDims[2];     
@@ -201,7 +417,21 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
        }
 
     }
+    else if ( tileRows > 0 && rank > 0 && tileRows < datasetDims[0] )
+    {
+        chunkdims[0] = tileRows;
+        for ( int i = 1; i < rank; i++ )
+            chunkdims[i] = datasetDims[i];
+        if ( H5Pset_chunk( plist_id, rank, chunkdims ) < 0 )
+        {
+            FATAL_MSG("Cannot set the tile chunk for the HDF5 dataset creation property list.\n");
+            H5Pclose(plist_id);
+            return(FATAL_ERR);
+        }
+    }
     else {// The chunk size is the same as the array size
+    for ( int i = 0; i < rank; i++ )
+        chunkdims[i] = datasetDims[i];
     if(H5Pset_chunk(plist_id,rank,datasetDims)<0)
     {
         FATAL_MSG("Cannot set chunk for the HDF5 dataset creation property list.\n");
@@ -210,20 +440,17 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
     }
     }
 
-    short gzip_comp_level = 0;
-
-    //Set compression level,USE_GZIP must be a number
-    {
-        const char *s;
-        s = getenv("USE_GZIP");
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) >0)
-                gzip_comp_level= (unsigned int)strtol(s,NULL,0);
-    }
+    short gzip_comp_level = ctx->gzipLevel;
 
     // GZIP is only valid when the level is between 1 and 9
     if(gzip_comp_level >0 && gzip_comp_level <10)
     {
+        if(shuffle && H5Pset_shuffle(plist_id)<0)
+        {
+            FATAL_MSG("Cannot set shuffle for the HDF5 dataset creation property list.\n");
+            H5Pclose(plist_id);
+            return(FATAL_ERR);
+        }
         if(H5Pset_deflate(plist_id,gzip_comp_level)<0)
         {
             FATAL_MSG("Cannot set deflate for the HDF5 dataset creation property list.\n");
@@ -232,6 +459,12 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
         }
     }
 
+    if(setAttrPhaseChange(plist_id) == FATAL_ERR)
+    {
+        H5Pclose(plist_id);
+        return(FATAL_ERR);
+    }
+
     memspace = H5Screate_simple( rank, datasetDims, NULL );
     if(memspace <0)
     {
@@ -269,6 +502,16 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
         return (FATAL_ERR);
     }
 
+    if ( writeChecksums( ctx, dataset, rank, datasetDims, dataType, data_out, chunkdims ) == FATAL_ERR )
+    {
+        FATAL_MSG("Unable to write the checksums of dataset \"%s\".\n", datasetName );
+        H5Pclose(plist_id);
+        H5Dclose(dataset);
+        H5Sclose(memspace);
+        free(correct_dsetname);
+        return (FATAL_ERR);
+    }
+
     /* Free all remaining memory */
     free(correct_dsetname);
     H5Pclose(plist_id);
@@ -290,6 +533,58 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
 
 }
 
+/* insertDatasetChunked without the shuffle filter, the compressed insertDataset() */
+hid_t insertDataset_comp( const BFcontext_t* ctx, hid_t *datasetGroup_ID, int returnDatasetID,
+                          int rank, hsize_t* datasetDims, hid_t dataType, const char* datasetName, void* data_out, unsigned short is_modis)
+{
+    return insertDatasetChunked( ctx, datasetGroup_ID, returnDatasetID, rank, datasetDims, dataType,
+                                 datasetName, data_out, is_modis, 0, 0 );
+}
+
+/*
+                    insertDataset_comp_shuffle
+    DESCRIPTION:
+        This function is identical to insertDataset_comp() except that the shuffle filter is applied
+        before deflate. Shuffling groups the bytes of each value, so the zeroed low-order bytes of
+        bit-rounded floats (see bitRoundFloat) compress well. On unrounded floats it does not pay off.
+
+    ARGUMENTS:
+        Same as insertDataset_comp().
+
+    RETURN:
+        Same as insertDataset_comp().
+*/
+hid_t insertDataset_comp_shuffle( const BFcontext_t* ctx, hid_t *datasetGroup_ID, int returnDatasetID,
+                          int rank, hsize_t* datasetDims, hid_t dataType, const char* datasetName, void* data_out, unsigned short is_modis)
+{
+    return insertDatasetChunked( ctx, datasetGroup_ID, returnDatasetID, rank, datasetDims, dataType,
+                                 datasetName, data_out, is_modis, 1, 0 );
+}
+
+/*
+                    insertDataset_comp_tiled
+    DESCRIPTION:
+        This function is identical to insertDataset_comp(), or to insertDataset_comp_shuffle() with
+        shuffle set, except that with BF_STATS the dataset is chunked by the tiles of its statistics
+        (see initDatasetStats). A reader that skips tiles by their statistics then skips whole chunks
+        instead of decompressing the whole array.
+
+    ARGUMENTS:
+        1-8. Same as insertDataset_comp().
+        9. shuffle -- Non-zero to apply the shuffle filter before deflate
+        10. stats  -- The statistics of the dataset. Without tiles, the whole array is one chunk.
+
+    RETURN:
+        Same as insertDataset_comp().
+*/
+hid_t insertDataset_comp_tiled( const BFcontext_t* ctx, hid_t *datasetGroup_ID, int returnDatasetID,
+                          int rank, hsize_t* datasetDims, hid_t dataType, const char* datasetName, void* data_out, int shuffle,
+                          const datasetStats_t* stats )
+{
+    return insertDatasetChunked( ctx, datasetGroup_ID, returnDatasetID, rank, datasetDims, dataType,
+                                 datasetName, data_out, 0, shuffle, stats->tiles ? (hsize_t) stats->tileRows : 0 );
+}
+
 
 
 /*
@@ -317,8 +612,8 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
 
     ARGUMENTS:
         IN
-            1. input file ID pointer. Identifier already exists.
-            2. output file ID pointer. Identifier already exists.
+            1. The conversion context
+            2. input file ID pointer. Identifier already exists.
             3. input dataset absolute path string
             4. Output dataset name
             5. dataset group ID. Group identifier already exists. This is the group that the data will be read into
@@ -341,7 +636,7 @@ hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID, int
             Returns FATAL_ERR if error occurs anywhere. Else, returns the dataset identifier
 */
 
-hid_t MOPITTinsertDataset( hid_t const *inputFileID, hid_t *datasetGroup_ID,
+hid_t MOPITTinsertDataset( const BFcontext_t* ctx, hid_t const *inputFileID, hid_t *datasetGroup_ID,
                            char * inDatasetPath, char* outDatasetName, hid_t dataType, int returnDatasetID, unsigned int bound[2] )
 {
 
@@ -566,6 +861,12 @@ hid_t MOPITTinsertDataset( hid_t const *inputFileID, hid_t *datasetGroup_ID,
         }
     }
 
+    if ( writeChecksums( ctx, dataset, rank, datasetDims, dataType, data_out, NULL ) == FATAL_ERR )
+    {
+        FATAL_MSG("Unable to write the checksums of dataset \"%s\".\n", outDatasetName );
+        goto cleanupFail;
+    }
+
     if ( H5Sclose(dataspace) < 0 )
         WARN_MSG("Failed to close dataspace\n");
 
@@ -620,7 +921,8 @@ cleanupFail:
                 For read only.
     EFFECTS:
         Opens the specified file and updates the file identifier (provided in the
-        first argument) with the necessary information to access the file.
+        first argument) with the necessary information to access the file. A file
+        named archive.tar/member is read from the archive (see tarMemberFapl).
 
     RETURN:
         Returns FATAL_ERR upon failure to open file. Otherwise, returns RET_SUCCESS
@@ -628,11 +930,20 @@ cleanupFail:
 
 herr_t openFile( hid_t *file, char* inputFileName, unsigned flags  )
 {
+    hid_t fapl = tarMemberFapl( inputFileName );
+
+    if ( fapl == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to find %s.\n", inputFileName );
+        return FATAL_ERR;
+    }
+
     /*
      * Open the file and do error checking
      */
 
-    *file = H5Fopen( inputFileName, flags, H5P_DEFAULT );
+    *file = H5Fopen( inputFileName, flags, fapl );
+    if ( fapl != H5P_DEFAULT ) H5Pclose(fapl);
 
     if ( *file < 0 )
     {
@@ -644,89 +955,371 @@ herr_t openFile( hid_t *file, char* inputFileName, unsigned flags  )
 
 }
 
+/* Output file layout profiles, selected with BF_LAYOUT_PROFILE. A size of 0 keeps the HDF5 default.
+ *  throughput  -- Large metadata and small-data blocks, datasets over 1 MiB aligned to the 1 MiB Lustre
+ *                 stripe, and a metadata cache sized for the thousands of objects of an orbit.
+ *  cloud-read  -- Paged aggregation with 4 MiB pages and a page buffer, so that the metadata ends up in a
+ *                 few pages that an object store reader gets with a handful of range requests. Needs the
+ *                 1.10 file format.
+ *  archive     -- Persistent free-space tracking and modest block sizes, for the smallest file. Needs the
+ *                 1.10 file format.
+ */
+typedef struct layoutProfile
+{
+    const char* name;
+    int fileFormat;                 // 0 for the 1.8 format, 1 for the 1.10 format
+    hsize_t metaBlockSize;
+    hsize_t sdataBlockSize;
+    hsize_t alignThreshold;
+    hsize_t alignment;
+    int paged;
+    hsize_t pageSize;
+    size_t pageBufferSize;
+    int persistFreeSpace;
+    size_t mdcInitSize;
+    size_t mdcMaxSize;
+} layoutProfile_t;
+
+static const layoutProfile_t layoutProfiles[] =
+{
+    /* name          format  metaBlock   sdataBlock  alignThresh alignment paged pageSize    pageBuffer  persist mdcInit     mdcMax */
+    { "throughput",  0,      1048576,    1048576,    1048576,    1048576,  0,    0,          0,          0,      16777216,   67108864 },
+    { "cloud-read",  1,      0,          0,          0,          0,        1,    4194304,    16777216,   1,      16777216,   67108864 },
+    { "archive",     1,      65536,      65536,      0,          0,        0,    0,          0,          1,      0,          0 },
+};
+
 /*
-                createOutputFile
+                        setLayoutProfile
     DESCRIPTION:
-        This function creates an ouptut HDF5 file. If the file with outputFileName already exists, errors will be thrown.
+        This function applies the layout profile named by BF_LAYOUT_PROFILE to the creation and access
+        property lists of an output file. Without BF_LAYOUT_PROFILE only the file format is set.
     ARGUMENTS:
-        1. A pointer to the output file identifier
-        2. output file name string
+        hid_t fcpl  -- The file creation property list
+        hid_t fapl  -- The file access property list
     EFFECTS:
-        Creates a new HDF5 file if it doesn't exist. Updates argument 1.
+        Modifies fcpl and fapl.
     RETURN:
-        FATAL_ERR on failure (equivalent to non-zero number in most environments)
-        RET_SUCCESS on success (equivalent to 0 in most systems)
+        FATAL_ERR on failure or if the profile is unknown
+        RET_SUCCESS on success
 */
 
-herr_t createOutputFile( hid_t *outputFile, char* outputFileName)
+static herr_t setLayoutProfile( hid_t fcpl, hid_t fapl )
 {
-    *outputFile = H5Fcreate( outputFileName, H5F_ACC_EXCL, H5P_DEFAULT, H5P_DEFAULT );
-    if ( *outputFile < 0 )
+    const layoutProfile_t* profile = NULL;
+    const char* s = getenv("BF_LAYOUT_PROFILE");
+    /* The 1.8 file format is needed for dense attribute storage (see setAttrPhaseChange). Newer formats are
+     * not used unless the profile needs them, so that the files stay readable with HDF5 1.8.
+     */
+#if H5_VERSION_GE(1,10,2)
+    H5F_libver_t fileFormat = H5F_LIBVER_V18;
+#else
+    H5F_libver_t fileFormat = H5F_LIBVER_LATEST;
+#endif
+
+    if ( s && *s )
     {
-         FATAL_MSG("H5Fcreate -- Could not create HDF5 file. Does it already exist? If so, delete or don't\n\tcall this function.\n" );
+        for ( size_t i = 0; i < sizeof(layoutProfiles) / sizeof(layoutProfiles[0]); i++ )
+            if ( strcmp( s, layoutProfiles[i].name ) == 0 )
+                profile = &layoutProfiles[i];
+        if ( profile == NULL )
+        {
+            FATAL_MSG("Unknown BF_LAYOUT_PROFILE \"%s\". Use throughput, cloud-read or archive.\n", s);
+            return FATAL_ERR;
+        }
+    }
+
+    if ( profile && profile->fileFormat == 1 )
+    {
+#if H5_VERSION_GE(1,10,2)
+        fileFormat = H5F_LIBVER_V110;
+#else
+        FATAL_MSG("The %s layout profile needs HDF5 1.10.2 or later.\n", profile->name);
         return FATAL_ERR;
+#endif
     }
 
-    return RET_SUCCESS;
-}
+    if ( H5Pset_libver_bounds( fapl, fileFormat, fileFormat ) < 0 )
+    {
+        FATAL_MSG("Could not set the file format of the output file.\n");
+        return FATAL_ERR;
+    }
 
+    if ( profile == NULL )
+        return RET_SUCCESS;
 
-/*
-                        createGroup
-    DESCRIPTION:
-        This function creates a new group in the output HDF5 file. The new group will be
-        created as a child of referenceGroup. referenceGroup can either be a file ID, in
-        which case the new group will be created in the root directory, or a group ID, in
-        which case the new group will be created as a child of referenceGroup.
-    ARGUMENTS:
-        hid_t const *referenceGroup -- A pointer to the parent group ID
-        hid_t *newGroup             -- A pointer to the new group ID. This is a pointer so that the value of the
-                                       caller's newGroup variable will be updated to contain the ID of the new group.
-        char* groupName             -- The name of the new group.
-    EFFECTS:
-        Creates a new directory in the HDF file, updates the group pointer.
-        The name of the new group is ultimately determined by the function correct_name().
-        Caller must be aware of this fact that name of the new group will not necessarily
-        be the value passed in at groupName.
-    RETURN:
-        FATAL_ERR on failure
-        RET_SUCCESS on success
-*/
+    if ( ( profile->metaBlockSize && H5Pset_meta_block_size( fapl, profile->metaBlockSize ) < 0 ) ||
+         ( profile->sdataBlockSize && H5Pset_small_data_block_size( fapl, profile->sdataBlockSize ) < 0 ) ||
+         ( profile->alignment && H5Pset_alignment( fapl, profile->alignThreshold, profile->alignment ) < 0 ) )
+    {
+        FATAL_MSG("Could not set the block sizes of the %s layout profile.\n", profile->name);
+        return FATAL_ERR;
+    }
 
-herr_t createGroup( hid_t const *referenceGroup, hid_t *newGroup, char* groupName)
+#if H5_VERSION_GE(1,10,1)
+    if ( profile->paged || profile->persistFreeSpace )
+    {
+        H5F_fspace_strategy_t strategy = profile->paged ? H5F_FSPACE_STRATEGY_PAGE : H5F_FSPACE_STRATEGY_FSM_AGGR;
+
+        if ( H5Pset_file_space_strategy( fcpl, strategy, profile->persistFreeSpace, 1 ) < 0 ||
+             ( profile->pageSize && H5Pset_file_space_page_size( fcpl, profile->pageSize ) < 0 ) ||
+             ( profile->pageBufferSize && H5Pset_page_buffer_size( fapl, profile->pageBufferSize, 0, 0 ) < 0 ) )
+        {
+            FATAL_MSG("Could not set the file space strategy of the %s layout profile.\n", profile->name);
+            return FATAL_ERR;
+        }
+    }
+#else
+    if ( profile->paged )
+    {
+        FATAL_MSG("The %s layout profile needs HDF5 1.10.1 or later.\n", profile->name);
+        return FATAL_ERR;
+    }
+#endif
+
+    if ( profile->mdcInitSize )
+    {
+        H5AC_cache_config_t mdcConfig;
+
+        mdcConfig.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+        if ( H5Pget_mdc_config( fapl, &mdcConfig ) < 0 )
+        {
+            FATAL_MSG("Could not get the metadata cache configuration.\n");
+            return FATAL_ERR;
+        }
+        mdcConfig.set_initial_size = 1;
+        mdcConfig.initial_size = profile->mdcInitSize;
+        mdcConfig.max_size = profile->mdcMaxSize;
+        if ( mdcConfig.min_size > mdcConfig.initial_size )
+            mdcConfig.min_size = mdcConfig.initial_size;
+        if ( H5Pset_mdc_config( fapl, &mdcConfig ) < 0 )
+        {
+            FATAL_MSG("Could not set the metadata cache configuration of the %s layout profile.\n", profile->name);
+            return FATAL_ERR;
+        }
+    }
+
+    return RET_SUCCESS;
+}
+
+/* Create an output file with the layout of BF_LAYOUT_PROFILE, in memory if inMemory is set. A file in memory
+ * is written to disk when it is closed if backingStore is set, and discarded otherwise.
+ */
+static herr_t createFile( hid_t *outputFile, char* outputFileName, int inMemory, hbool_t backingStore )
 {
+    hid_t fcpl = H5Pcreate( H5P_FILE_CREATE );
+    hid_t fapl = H5Pcreate( H5P_FILE_ACCESS );
 
-    char* newGroupName = correct_name(groupName);
+    if ( fcpl < 0 || fapl < 0 || setLayoutProfile( fcpl, fapl ) == FATAL_ERR ||
+         ( inMemory && H5Pset_fapl_core( fapl, STAGE_INCREMENT, backingStore ) < 0 ) )
+    {
+        FATAL_MSG("Could not set up the property lists of the output file.\n");
+        if ( fcpl >= 0 ) H5Pclose(fcpl);
+        if ( fapl >= 0 ) H5Pclose(fapl);
+        *outputFile = FATAL_ERR;
+        return FATAL_ERR;
+    }
 
-    *newGroup = H5Gcreate( *referenceGroup, newGroupName, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
-    if ( *newGroup < 0 )
+    *outputFile = H5Fcreate( outputFileName, H5F_ACC_EXCL, fcpl, fapl );
+    H5Pclose(fcpl);
+    H5Pclose(fapl);
+    if ( *outputFile < 0 )
     {
-         FATAL_MSG("H5Gcreate -- Could not create '%s' root group.\n", newGroupName);
-        *newGroup = FATAL_ERR;
-        free(newGroupName);
+         FATAL_MSG("H5Fcreate -- Could not create HDF5 file. Does it already exist? If so, delete or don't\n\tcall this function.\n" );
         return FATAL_ERR;
     }
 
-    free(newGroupName);
     return RET_SUCCESS;
 }
 
 /*
-                        attributeCreate
+                createOutputFile
     DESCRIPTION:
-        This function creates one single attribute for the object specified by objectID.
-        It is the duty of the caller to free the attribute identifier using H5Aclose().
+        This function creates an ouptut HDF5 file. If the file with outputFileName already exists, errors will be thrown.
+        The file layout follows BF_LAYOUT_PROFILE (see setLayoutProfile).
     ARGUMENTS:
-        1. ObjectID: identifier for object to create the attribute for
-        2. attrName: string for the attribute
-        3. datatypeID: datatype identifier. This describes what type of information the
-           attribute will hold. Google: "HDF5 Predefined Datatypes"
+        1. A pointer to the output file identifier
+        2. output file name string
     EFFECTS:
-        Creates uninitialized attribute at the object specified by objectID
+        Creates a new HDF5 file if it doesn't exist. Updates argument 1.
     RETURN:
-        Returns the attribute identifier upon success.
-        Returns FATAL_ERR upon failure.
-*/
+        FATAL_ERR on failure (equivalent to non-zero number in most environments)
+        RET_SUCCESS on success (equivalent to 0 in most systems)
+*/
+
+herr_t createOutputFile( hid_t *outputFile, char* outputFileName)
+{
+    return createFile( outputFile, outputFileName, 0, 0 );
+}
+
+/*
+                createStagedOutputFile
+    DESCRIPTION:
+        This function creates an output file like createOutputFile, but the file is built in memory with the
+        HDF5 core driver. Nothing but the empty file is written to disk until the file is closed (or
+        flushed), when the whole image is written in one sequential stream. This spares parallel file
+        systems the many small metadata writes interleaved with the dataset writes.
+    ARGUMENTS:
+        1. A pointer to the output file identifier
+        2. output file name string
+    EFFECTS:
+        Creates a new HDF5 file if it doesn't exist. Updates argument 1. The file grows in memory in steps of
+        STAGE_INCREMENT bytes.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t createStagedOutputFile( hid_t *outputFile, char* outputFileName )
+{
+    return createFile( outputFile, outputFileName, 1, 1 );
+}
+
+/*
+                createMemoryOutputFile
+    DESCRIPTION:
+        This function creates an output file like createStagedOutputFile, but the file never goes to disk.
+        It is used when the output is only handed to a sink (see sinkDatasets).
+    ARGUMENTS:
+        1. A pointer to the output file identifier
+        2. output file name string, only used as the name of the file
+    EFFECTS:
+        Creates a new HDF5 file in memory. Updates argument 1. The file is discarded when it is closed.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t createMemoryOutputFile( hid_t *outputFile, char* outputFileName )
+{
+    return createFile( outputFile, outputFileName, 1, 0 );
+}
+
+/*
+                spillStagedOutputFile
+    DESCRIPTION:
+        This function writes an output file made by createStagedOutputFile to disk and reopens it with the
+        default driver, so that the rest of the output is written directly. It is the fallback when the
+        staged files outgrow the memory ceiling. The file is reopened with the access properties of
+        BF_LAYOUT_PROFILE (see setLayoutProfile), like a file made by createOutputFile.
+    ARGUMENTS:
+        1. A pointer to the output file identifier
+        2. output file name string
+    EFFECTS:
+        Closes the file and opens it again. Updates argument 1.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS_NO_PROCESS if objects in the file are still open, in which case nothing is done
+        RET_SUCCESS on success
+*/
+
+herr_t spillStagedOutputFile( hid_t *outputFile, char* outputFileName )
+{
+    hid_t fcpl = -1;
+    hid_t fapl = -1;
+
+    if ( H5Fget_obj_count( *outputFile, H5F_OBJ_ALL | H5F_OBJ_LOCAL ) > 1 )
+        return RET_SUCCESS_NO_PROCESS;
+
+    if ( H5Fclose( *outputFile ) < 0 )
+    {
+        FATAL_MSG("Failed to write the staged file %s to disk.\n", outputFileName);
+        *outputFile = 0;
+        return FATAL_ERR;
+    }
+
+    /* The creation properties are already in the file. fcpl only takes what setLayoutProfile sets on it. */
+    fcpl = H5Pcreate( H5P_FILE_CREATE );
+    fapl = H5Pcreate( H5P_FILE_ACCESS );
+    if ( fcpl < 0 || fapl < 0 || setLayoutProfile( fcpl, fapl ) == FATAL_ERR )
+    {
+        FATAL_MSG("Could not set up the access property list of %s.\n", outputFileName);
+        if ( fcpl >= 0 ) H5Pclose(fcpl);
+        if ( fapl >= 0 ) H5Pclose(fapl);
+        *outputFile = 0;
+        return FATAL_ERR;
+    }
+
+    *outputFile = H5Fopen( outputFileName, H5F_ACC_RDWR, fapl );
+    H5Pclose(fcpl);
+    H5Pclose(fapl);
+    if ( *outputFile < 0 )
+    {
+        FATAL_MSG("Failed to reopen %s.\n", outputFileName);
+        *outputFile = 0;
+        return FATAL_ERR;
+    }
+
+    return RET_SUCCESS;
+}
+
+
+/*
+                        createGroup
+    DESCRIPTION:
+        This function creates a new group in the output HDF5 file. The new group will be
+        created as a child of referenceGroup. referenceGroup can either be a file ID, in
+        which case the new group will be created in the root directory, or a group ID, in
+        which case the new group will be created as a child of referenceGroup.
+    ARGUMENTS:
+        hid_t const *referenceGroup -- A pointer to the parent group ID
+        hid_t *newGroup             -- A pointer to the new group ID. This is a pointer so that the value of the
+                                       caller's newGroup variable will be updated to contain the ID of the new group.
+        char* groupName             -- The name of the new group.
+    EFFECTS:
+        Creates a new directory in the HDF file, updates the group pointer.
+        The name of the new group is ultimately determined by the function correct_name().
+        Caller must be aware of this fact that name of the new group will not necessarily
+        be the value passed in at groupName.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t createGroup( hid_t const *referenceGroup, hid_t *newGroup, char* groupName)
+{
+
+    char* newGroupName = correct_name(groupName);
+    hid_t gcpl = H5Pcreate( H5P_GROUP_CREATE );
+
+    if ( gcpl < 0 || setAttrPhaseChange( gcpl ) == FATAL_ERR )
+    {
+        FATAL_MSG("Could not create the group creation property list.\n");
+        if ( gcpl >= 0 ) H5Pclose(gcpl);
+        *newGroup = FATAL_ERR;
+        free(newGroupName);
+        return FATAL_ERR;
+    }
+
+    *newGroup = H5Gcreate( *referenceGroup, newGroupName, H5P_DEFAULT, gcpl, H5P_DEFAULT );
+    H5Pclose(gcpl);
+    if ( *newGroup < 0 )
+    {
+         FATAL_MSG("H5Gcreate -- Could not create '%s' root group.\n", newGroupName);
+        *newGroup = FATAL_ERR;
+        free(newGroupName);
+        return FATAL_ERR;
+    }
+
+    free(newGroupName);
+    return RET_SUCCESS;
+}
+
+/*
+                        attributeCreate
+    DESCRIPTION:
+        This function creates one single attribute for the object specified by objectID.
+        It is the duty of the caller to free the attribute identifier using H5Aclose().
+    ARGUMENTS:
+        1. ObjectID: identifier for object to create the attribute for
+        2. attrName: string for the attribute
+        3. datatypeID: datatype identifier. This describes what type of information the
+           attribute will hold. Google: "HDF5 Predefined Datatypes"
+    EFFECTS:
+        Creates uninitialized attribute at the object specified by objectID
+    RETURN:
+        Returns the attribute identifier upon success.
+        Returns FATAL_ERR upon failure.
+*/
 
 hid_t attributeCreate( hid_t objectID, const char* attrName, hid_t datatypeID )
 {
@@ -1017,7 +1610,39 @@ int32 H4readData( int32 fileID, const char* datasetName, void** data, int32 *ret
         return FATAL_ERR;
     }
 
-    if(h4_count!=NULL)
+    /* While a MISR block window is set (see BFsubset_t), only the blocks inside it are read from datasets
+     * over all SOM blocks. The other blocks are set to the fill value of the dataset.
+     */
+    if ( h4_start == NULL && h4_count == NULL && bfSubset.blockCount > 0 && bfSubset.blockCount < SOM_NUM_BLOCKS &&
+         rank > 1 && dimsizes[0] == SOM_NUM_BLOCKS )
+    {
+        int32 windowCount[DIM_MAX];
+        int32 elemSize = DFKNTsize( dataType );
+        size_t blockElems = total_elems / SOM_NUM_BLOCKS;
+        unsigned char fillValue[16] = {0};
+
+        if ( elemSize <= 0 || elemSize > (int32) sizeof(fillValue) || *data == NULL )
+        {
+            FATAL_MSG("Failed to get the size of the data type.\n");
+            SDendaccess(sds_id);
+            if ( *data != NULL ) free(*data);
+            return FATAL_ERR;
+        }
+
+        if ( SDgetfillvalue( sds_id, fillValue ) == FAIL )
+            memset( *data, 0xFF, total_elems * elemSize );
+        else
+            for ( size_t i = 0; i < (size_t) total_elems; i++ )
+                memcpy( (unsigned char*) *data + i * elemSize, fillValue, elemSize );
+
+        for ( int i = 0; i < DIM_MAX; i++ )
+            windowCount[i] = dimsizes[i];
+        start[0] = bfSubset.blockStart;
+        windowCount[0] = bfSubset.blockCount;
+        status = SDreaddata( sds_id, start, stride, windowCount,
+                             (unsigned char*) *data + bfSubset.blockStart * blockElems * elemSize );
+    }
+    else if(h4_count!=NULL)
         status = SDreaddata( sds_id, start, stride, count, *data );
     else
         status = SDreaddata( sds_id, start, stride, dimsizes, *data );
@@ -1056,9 +1681,10 @@ int32 H4readData( int32 fileID, const char* datasetName, void** data, int32 *ret
         was warranted.
 
     ARGUMENTS:
-        1. objectID -- The object to create an attribute for.
-        2. name     -- The name of the attribute
-        3. value    -- The string that the attribute will contain
+        1. ctx      -- The conversion context, for its string datatypes (see getStringType)
+        2. objectID -- The object to create an attribute for.
+        3. name     -- The name of the attribute
+        4. value    -- The string that the attribute will contain
 
     EFFECTS:
         A new string attribute will be created for the object objectID.
@@ -1069,7 +1695,7 @@ int32 H4readData( int32 fileID, const char* datasetName, void** data, int32 *ret
         the identifier using H5Aclose().
 */
 
-hid_t attrCreateString( hid_t objectID, char* name, char* value )
+hid_t attrCreateString( const BFcontext_t* ctx, hid_t objectID, char* name, char* value )
 {
     /* To store a string in HDF5, we need to create our own special datatype from a
      * character type. Our "base type" is H5T_C_S1, a single byte null terminated
@@ -1079,15 +1705,17 @@ hid_t attrCreateString( hid_t objectID, char* name, char* value )
     hid_t attrID;
     herr_t status;
 
-    stringType = H5Tcopy(H5T_C_S1);
-    H5Tset_size( stringType, strlen(value));
-
+    stringType = getStringType( ctx, strlen(value) );
+    if ( stringType == FATAL_ERR )
+    {
+        FATAL_MSG("Unable to get the datatype of the %s attribute.\n", name);
+        return FATAL_ERR;
+    }
 
     attrID = attributeCreate( objectID, name, stringType );
     if ( attrID == FATAL_ERR )
     {
         FATAL_MSG("Unable to create %s attribute.\n", name);
-        H5Tclose(stringType);
         return FATAL_ERR;
     }
 
@@ -1095,167 +1723,362 @@ hid_t attrCreateString( hid_t objectID, char* name, char* value )
     if ( status < 0 )
     {
          FATAL_MSG("H5Awrite: Unable to write %s attribute.\n", name);
-        H5Tclose(stringType);
         H5Aclose(attrID);
         return FATAL_ERR;
     }
-    H5Tclose(stringType);
 
     return attrID;
 }
 
 /*
-                    readThenWrite
+                        getStringType
     DESCRIPTION:
-        This function is an abstraction of reading a dataset from an HDF4 file
-        and then writing it to the output HDF5 file. This function calls H4readData
-        which is itself an abstraction for reading input data into a data buffer, and
-        then writes that buffer to the output file using the insertDataset function.
-        Once all writing is done, it frees allocated memory and returns the HDF5 dataset
-        identifier that was created in the output file.
-
+        This function returns a fixed length, null terminated C string datatype of the given size. The
+        datatypes are created once per size and context, and shared by all the attributes the context writes
+        afterwards, instead of copying H5T_C_S1 for every attribute.
     ARGUMENTS:
-        0. outDatasetName -- The name that the output HDF5 dataset will have. Note that the actual
-                             name the output dataset will have is the one given by correct_name(outDatasetName).
-                             Therefore you cannot assume that the output name will be exactly what
-                             is passed to this argument.
-                             Set to NULL if the same name as the inDatasetName is desired.
-
-        1. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
-                             be written. Can either be an actual group ID or can be the
-                             file ID (in the latter case, data will be written to the root
-                             directory).
-        2. inDatasetName    -- A string containing the name of the dataset in the input HDF4
-                             file. The output dataset will have the same name.
-        3. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
-                             input dataset. Please reference Section 3 of the HDF4
-                             Reference Manual for a list of HDF types.
-        4. outputDataType -- An HDF5 datatype identifier. Must be of the same general type
-                             of the input data type. Please reference the HDF5 API
-                             specification under "Predefined Datatypes" for a list of HDF5
-                             datatypes.
-        5. inputFileID    -- The HDF4 input file identifier
-
-        6. comp_flag a    --  1: use the compression, other values: don't use the compression
-
+        const BFcontext_t* ctx  -- The conversion context that keeps the datatypes
+        size_t size             -- The size of the string in bytes, including the terminator if there is one
     EFFECTS:
-        Reads the input file dataset and then writes to the HDF5 output file. Returns
-        a dataset identifier for the new dataset created in the output file. It is the
-        responsibility of the caller to close the dataset ID when finished using
-        H5Dclose().
-
+        May create a new datatype, which is kept open until freeContext.
     RETURN:
-        Returns the dataset identifier if successful. Else returns FATAL_ERR upon
-        any errors.
+        FATAL_ERR on failure
+        The datatype on success. The caller MUST NOT close it.
 */
 
-hid_t readThenWrite( const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
-                     hid_t outputDataType, int32 inputFileID, unsigned short comp_flag )
+hid_t getStringType( const BFcontext_t* ctx, size_t size )
 {
-    int32 dataRank;
-    int32 dataDimSizes[DIM_MAX];
-    unsigned int* dataBuffer = NULL;
-    hid_t datasetID;
+    struct stringTypes* cache = ctx->stringTypes;
+    hid_t stringType = 0;
 
-    herr_t status;
+    if ( size == 0 )
+        size = 1;
 
-    status = H4readData( inputFileID, inDatasetName,
-                         (void**)&dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
+    for ( size_t i = 0; i < cache->num; i++ )
+        if ( cache->types[i].size == size )
+            return cache->types[i].type;
 
-    if ( status == FATAL_ERR )
+    if ( cache->num == cache->size )
     {
-        FATAL_MSG("Unable to read \"%s\" data.\n", inDatasetName );
-        if ( dataBuffer != NULL ) free(dataBuffer);
-        return (FATAL_ERR);
-    }
-
-    /* END READ DATA. BEGIN INSERTION OF DATA */
-
-    /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
-     * that need to be resolved. Thus, we need to take the DimSizes array, which is
-     * of type int32 (an HDF4 type) and put it into an array of type hsize_t.
-     * A simple casting might work, but that is dangerous considering hsize_t and int32
-     * are not simply two different names for the same type. They are two different types.
-     */
-    hsize_t temp[DIM_MAX];
-    for ( int i = 0; i < DIM_MAX; i++ )
-        temp[i] = (hsize_t) dataDimSizes[i];
-
-    if(comp_flag == 1) {
-      short use_chunk = 0;
-
-      /* If using chunk */
-      {
-        const char *s;
-        s = getenv("USE_CHUNK");
-
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) == 1)
-                use_chunk = 1;
-      }
-
-      if(use_chunk == 1)
-      {// The chunk size will always be the whole dataset size for this case.
-       if(outDatasetName) 
-        datasetID = insertDataset_comp( &outputFile, &outputGroupID, 1, dataRank,
-                                        temp, outputDataType, outDatasetName, dataBuffer,0);
-       else
-        datasetID = insertDataset_comp( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, inDatasetName, dataBuffer,0 );
- 
-     }
-     else // No compression
-     {
-       if ( outDatasetName )
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, outDatasetName, dataBuffer );
-       else
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, inDatasetName, dataBuffer );
-     }
-   }
-    else {
-      if ( outDatasetName )
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, outDatasetName, dataBuffer );
-      else
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, inDatasetName, dataBuffer );
+        size_t newSize = cache->size ? 2 * cache->size : 64;
+        void* tempPtr = realloc( cache->types, newSize * sizeof(*cache->types) );
+        if ( tempPtr == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FATAL_ERR;
+        }
+        cache->types = tempPtr;
+        cache->size = newSize;
     }
 
-    if ( datasetID == FATAL_ERR )
+    stringType = H5Tcopy( H5T_C_S1 );
+    if ( stringType < 0 || H5Tset_size( stringType, size ) < 0 ||
+         H5Tset_strpad( stringType, H5T_STR_NULLTERM ) < 0 )
     {
-        // Have warning const char* to char*:
-        const char* tempStr = outDatasetName ? outDatasetName : inDatasetName;
-        FATAL_MSG("Error writing \"%s\" dataset.\n", tempStr );
-        free(dataBuffer);
-        H5Dclose(datasetID);
-        return (FATAL_ERR);
+        FATAL_MSG("Failed to create a string datatype of size %zu.\n", size);
+        if ( stringType >= 0 ) H5Tclose(stringType);
+        return FATAL_ERR;
     }
 
+    cache->types[cache->num].size = size;
+    cache->types[cache->num].type = stringType;
+    cache->num++;
 
-    free(dataBuffer);
-
-    return datasetID;
+    return stringType;
 }
 
-float ReverseFloat( const float inFloat )
-{
-   float retVal;
-   char *floatToConvert = ( char* ) & inFloat;
-   char *returnFloat = ( char* ) & retVal;
-
-   // swap the bytes into a temporary buffer
-   returnFloat[0] = floatToConvert[3];
-   returnFloat[1] = floatToConvert[2];
-   returnFloat[2] = floatToConvert[1];
-   returnFloat[3] = floatToConvert[0];
+/*
+                        initAttrStage
+    DESCRIPTION:
+        This function prepares an attribute stage for the object objectID. Attributes added with stageAttr and
+        stageAttrString are kept in memory and written together by flushAttrStage, so that the object's
+        header is updated in one pass instead of once per attribute.
+    ARGUMENTS:
+        const BFcontext_t* ctx  -- The conversion context, for the string datatypes of stageAttrString
+        attrStage_t* stage      -- The stage to initialize
+        hid_t objectID          -- The file, group or dataset the attributes belong to. A file means its root
+                                   group.
+    EFFECTS:
+        Initializes stage.
+    RETURN:
+        None
+*/
 
-   return retVal;
+void initAttrStage( const BFcontext_t* ctx, attrStage_t* stage, hid_t objectID )
+{
+    stage->ctx = ctx;
+    stage->objectID = objectID;
+    stage->attrs = NULL;
+    stage->num = 0;
+    stage->size = 0;
 }
 
 /*
-                    readThenWriteSubset
+                        stageAttr
+    DESCRIPTION:
+        This function adds an attribute to a stage. The name and the value are copied, so the caller's
+        buffers may be reused right away.
+    ARGUMENTS:
+        attrStage_t* stage  -- The stage (see initAttrStage)
+        const char* name    -- The name of the attribute
+        hid_t memType       -- The datatype of value. It is also the datatype of the attribute in the file,
+                               and it must stay open until the stage is flushed (predefined types or the types
+                               of getStringType).
+        size_t numElems     -- The number of elements in value. 0 makes a scalar attribute of one element.
+        const void* value   -- The value of the attribute
+    EFFECTS:
+        Allocates memory in the stage.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t stageAttr( attrStage_t* stage, const char* name, hid_t memType, size_t numElems, const void* value )
+{
+    stagedAttr_t* attr = NULL;
+    size_t valueSize = H5Tget_size( memType ) * ( numElems ? numElems : 1 );
+
+    if ( valueSize == 0 )
+    {
+        FATAL_MSG("Failed to get the size of the %s attribute.\n", name);
+        return FATAL_ERR;
+    }
+
+    if ( stage->num == stage->size )
+    {
+        size_t newSize = stage->size ? 2 * stage->size : 16;
+        stagedAttr_t* tempPtr = realloc( stage->attrs, newSize * sizeof(stagedAttr_t) );
+        if ( tempPtr == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FATAL_ERR;
+        }
+        stage->attrs = tempPtr;
+        stage->size = newSize;
+    }
+
+    attr = &stage->attrs[stage->num];
+    attr->name = malloc( strlen(name) + 1 );
+    attr->value = malloc( valueSize );
+    if ( attr->name == NULL || attr->value == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        free(attr->name);
+        free(attr->value);
+        return FATAL_ERR;
+    }
+    strcpy( attr->name, name );
+    memcpy( attr->value, value, valueSize );
+    attr->type = memType;
+    attr->numElems = numElems;
+    stage->num++;
+
+    return RET_SUCCESS;
+}
+
+/*
+                        stageAttrString
+    DESCRIPTION:
+        This function adds a scalar, null terminated string attribute to a stage. The attribute has the same
+        layout as the ones written by H5LTset_attribute_string.
+    ARGUMENTS:
+        attrStage_t* stage  -- The stage (see initAttrStage)
+        const char* name    -- The name of the attribute
+        const char* value   -- The string
+    EFFECTS:
+        Allocates memory in the stage.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t stageAttrString( attrStage_t* stage, const char* name, const char* value )
+{
+    hid_t stringType = getStringType( stage->ctx, strlen(value) + 1 );
+
+    if ( stringType == FATAL_ERR )
+        return FATAL_ERR;
+
+    return stageAttr( stage, name, stringType, 0, value );
+}
+
+/*
+                        discardAttrStage
+    DESCRIPTION:
+        This function drops the attributes of a stage without writing them.
+    ARGUMENTS:
+        attrStage_t* stage  -- The stage
+    EFFECTS:
+        Frees the memory of the stage. The stage can be used again for the same object.
+    RETURN:
+        None
+*/
+
+void discardAttrStage( attrStage_t* stage )
+{
+    for ( size_t i = 0; i < stage->num; i++ )
+    {
+        free(stage->attrs[i].name);
+        free(stage->attrs[i].value);
+    }
+    free(stage->attrs);
+    stage->attrs = NULL;
+    stage->num = 0;
+    stage->size = 0;
+}
+
+/*
+                        flushAttrStage
+    DESCRIPTION:
+        This function writes the attributes of a stage to its object. An attribute that already exists on the
+        object is replaced, as H5LTset_attribute_* would do. Whether the attributes are kept in the object
+        header or in dense storage depends on the thresholds set when the object was created (see
+        setAttrPhaseChange).
+    ARGUMENTS:
+        attrStage_t* stage  -- The stage
+    EFFECTS:
+        Writes the attributes and empties the stage, also on failure.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t flushAttrStage( attrStage_t* stage )
+{
+    hid_t scalarSpace = 0;
+    hid_t attrSpace = 0;
+    hid_t attrID = 0;
+    herr_t retVal = RET_SUCCESS;
+
+    if ( stage->num == 0 )
+        return RET_SUCCESS;
+
+    scalarSpace = H5Screate( H5S_SCALAR );
+    if ( scalarSpace < 0 )
+    {
+        FATAL_MSG("Failed to create a scalar dataspace.\n");
+        discardAttrStage( stage );
+        return FATAL_ERR;
+    }
+
+    for ( size_t i = 0; i < stage->num && retVal == RET_SUCCESS; i++ )
+    {
+        stagedAttr_t* attr = &stage->attrs[i];
+        hsize_t dims = attr->numElems;
+
+        if ( H5Aexists( stage->objectID, attr->name ) > 0 && H5Adelete( stage->objectID, attr->name ) < 0 )
+        {
+            FATAL_MSG("Failed to replace the %s attribute.\n", attr->name);
+            retVal = FATAL_ERR;
+            break;
+        }
+
+        attrSpace = attr->numElems ? H5Screate_simple( 1, &dims, NULL ) : scalarSpace;
+        if ( attrSpace < 0 )
+        {
+            FATAL_MSG("Failed to create the dataspace of the %s attribute.\n", attr->name);
+            retVal = FATAL_ERR;
+            break;
+        }
+
+        attrID = H5Acreate2( stage->objectID, attr->name, attr->type, attrSpace, H5P_DEFAULT, H5P_DEFAULT );
+        if ( attrID < 0 || H5Awrite( attrID, attr->type, attr->value ) < 0 )
+        {
+            FATAL_MSG("Failed to write the %s attribute.\n", attr->name);
+            retVal = FATAL_ERR;
+        }
+
+        if ( attrID >= 0 ) H5Aclose(attrID);
+        if ( attrSpace != scalarSpace ) H5Sclose(attrSpace);
+    }
+
+    H5Sclose(scalarSpace);
+    discardAttrStage( stage );
+
+    return retVal;
+}
+
+/*
+                        setAttrPhaseChange
+    DESCRIPTION:
+        This function sets the attribute storage thresholds on a group or dataset creation property list.
+        An object keeps up to ATTR_MAX_COMPACT attributes in its header and moves them to dense storage
+        (a fractal heap indexed by a B-tree) beyond that, which keeps objects with many attributes, such as
+        the granule groups, from growing long chains of header continuation blocks. Dense storage needs the
+        1.8 file format (see createOutputFile).
+    ARGUMENTS:
+        hid_t plistID   -- The creation property list
+    EFFECTS:
+        Modifies plistID.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t setAttrPhaseChange( hid_t plistID )
+{
+    if ( H5Pset_attr_phase_change( plistID, ATTR_MAX_COMPACT, ATTR_MIN_DENSE ) < 0 )
+    {
+        FATAL_MSG("Failed to set the attribute storage thresholds.\n");
+        return FATAL_ERR;
+    }
+
+    return RET_SUCCESS;
+}
+
+/*
+                        stageH4Attr
+    DESCRIPTION:
+        This function adds an HDF4 attribute to a stage, converting its number type to the matching HDF5
+        datatype. Character attributes become null terminated strings.
+    ARGUMENTS:
+        attrStage_t* stage  -- The stage (see initAttrStage)
+        int32 h4_type       -- The HDF4 number type of the attribute
+        int32 n_values      -- The number of values of the attribute
+        char* attr_name     -- The name of the attribute
+        char* attr_value    -- The values, as read by SDreadattr
+    EFFECTS:
+        Allocates memory in the stage.
+    RETURN:
+        FAIL if the type has no HDF5 equivalent or on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t stageH4Attr( attrStage_t* stage, int32 h4_type, int32 n_values, char* attr_name, char* attr_value )
+{
+    hid_t h5memtype = 0;
+    herr_t ret = 0;
+
+    if ( h4type_to_h5type( h4_type, &h5memtype ) != 0 )
+        return FAIL;
+
+    if ( h5memtype == H5T_STRING )
+    {
+        char* attr_value_new = malloc(n_values+1);
+        if ( attr_value_new == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FAIL;
+        }
+        strncpy(attr_value_new,attr_value,n_values);
+        attr_value_new[n_values]='\0';
+        ret = stageAttrString( stage, attr_name, attr_value_new );
+        free(attr_value_new);
+        return ret;
+    }
+
+    /* Unsigned 64 bit integers are not supported by the netCDF-4 data model */
+    if ( H5Tget_class(h5memtype) != H5T_INTEGER && H5Tget_class(h5memtype) != H5T_FLOAT )
+        return FAIL;
+    if ( H5Tget_size(h5memtype) == 8 && H5Tget_class(h5memtype) == H5T_INTEGER &&
+         H5Tget_sign(h5memtype) != H5T_SGN_2 )
+        return FAIL;
+
+    return stageAttr( stage, attr_name, h5memtype, n_values, attr_value );
+}
+
+/*
+                    readThenWrite
     DESCRIPTION:
         This function is an abstraction of reading a dataset from an HDF4 file
         and then writing it to the output HDF5 file. This function calls H4readData
@@ -1264,38 +2087,31 @@ float ReverseFloat( const float inFloat )
         Once all writing is done, it frees allocated memory and returns the HDF5 dataset
         identifier that was created in the output file.
 
-        This function is the subset version of readThenWrite(). Additional arguments are
-        provided to speicify which portion of the dataset to write to the output.
-
     ARGUMENTS:
-        0. CER_LATLON     -- This boolean integer specifies whether the CERES geolocation units should be
-                             converted to latitude/longitude (from colatitude and longitude). 0 for no,
-                             non-zero for yes.
-
-        1. outDatasetName -- The name that the output HDF5 dataset will have. Note that the actual
+        ctx -- The conversion context, for the dataset layout and the unpack settings
+        0. outDatasetName -- The name that the output HDF5 dataset will have. Note that the actual
                              name the output dataset will have is the one given by correct_name(outDatasetName).
                              Therefore you cannot assume that the output name will be exactly what
                              is passed to this argument.
                              Set to NULL if the same name as the inDatasetName is desired.
 
-        2. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
+        1. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
                              be written. Can either be an actual group ID or can be the
                              file ID (in the latter case, data will be written to the root
                              directory).
-        3. inDatasetName    -- A string containing the name of the dataset in the input HDF4
+        2. inDatasetName    -- A string containing the name of the dataset in the input HDF4
                              file. The output dataset will have the same name.
-        4. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
+        3. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
                              input dataset. Please reference Section 3 of the HDF4
                              Reference Manual for a list of HDF types.
-        5. outputDataType -- An HDF5 datatype identifier. Must be of the same general type
+        4. outputDataType -- An HDF5 datatype identifier. Must be of the same general type
                              of the input data type. Please reference the HDF5 API
                              specification under "Predefined Datatypes" for a list of HDF5
                              datatypes.
-        6. inputFileID    -- The HDF4 input file identifier
+        5. inputFileID    -- The HDF4 input file identifier
+
+        6. comp_flag a    --  1: use the compression, other values: don't use the compression
 
-        7. start
-        8. stride
-        9. count
     EFFECTS:
         Reads the input file dataset and then writes to the HDF5 output file. Returns
         a dataset identifier for the new dataset created in the output file. It is the
@@ -1307,80 +2123,26 @@ float ReverseFloat( const float inFloat )
         any errors.
 */
 
-hid_t readThenWriteSubset( int CER_LATLON, const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
-                           hid_t outputDataType, int32 inputFileID,int32 *start,int32*stride,int32*count )
+hid_t readThenWrite( BFcontext_t* ctx, const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
+                     hid_t outputDataType, int32 inputFileID, unsigned short comp_flag )
 {
     int32 dataRank;
     int32 dataDimSizes[DIM_MAX];
-    void* dataBuffer = NULL;
+    unsigned int* dataBuffer = NULL;
     hid_t datasetID;
 
     herr_t status;
 
     status = H4readData( inputFileID, inDatasetName,
-                         (void**)&dataBuffer, &dataRank, dataDimSizes, inputDataType,start,stride,count );
+                         (void**)&dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
 
     if ( status == FATAL_ERR )
     {
         FATAL_MSG("Unable to read \"%s\" data.\n", inDatasetName );
-        goto cleanupFail;
-    }
-
-    /* Landon Clipp Jul 12, 2017: CERES needs its geolocation units to be consistent with other
-     * instruments. The formula for converting the geolocation is: 
-     * 
-     * latitude (new) = 90 - Colatitude (CERES old)
-     * if ( longitude > 180 )
-     *   longitude=longitude-360
-     *
-     */
-    if ( CER_LATLON )
-    {
-        /* Perform the conversion */
-        // Check if this dataset is Latitude or Longitude
-        int index = 0;
-        if ( strstr(outDatasetName, "Latitude" ) )
-        {
-            // Iterate through every dimension
-            for ( int dim = 0; dim < dataRank; dim++ )
-            {
-                // Iterate through every element in each dimension
-                for ( int elem = 0; elem < dataDimSizes[dim]; elem++ )
-                {
-
-                    /* Databuffer has to be cast to a float* for proper pointer arithmetic.
-                       This is specific just to the geolocation datasets. We know in advance that
-                       it is a floating point number.
-                     */
-                    ( (float*) dataBuffer)[index] = (float)(90.0f - ( (float*) dataBuffer)[index]);
-                    index++;
-                }
-            }
-        }
-
-        else if ( strstr(outDatasetName, "Longitude" ) )
-        {
-            // Iterate through every dimension
-            for ( int dim = 0; dim < dataRank; dim++ )
-            {
-                // Iterate through every element in each dimension
-                for ( int elem = 0; elem < dataDimSizes[dim]; elem++ )
-                {   
-                    if ( ((float*) dataBuffer)[index] > 180.0f )
-                        ( (float *) dataBuffer)[index] = ( (float *) dataBuffer)[index] - 360.0f;
-                    index++;
-                }
-            }
-        }
-
-        else
-        {
-            FATAL_MSG("The CERES_LATLON argument was given as non-zero, but neither a Latitude nor Longitude\n\tdataset was transferred!\n");
-            goto cleanupFail;
-        }
+        if ( dataBuffer != NULL ) free(dataBuffer);
+        return (FATAL_ERR);
     }
 
-
     /* END READ DATA. BEGIN INSERTION OF DATA */
 
     /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
@@ -1393,19 +2155,222 @@ hid_t readThenWriteSubset( int CER_LATLON, const char* outDatasetName, hid_t out
     for ( int i = 0; i < DIM_MAX; i++ )
         temp[i] = (hsize_t) dataDimSizes[i];
 
-    if ( outDatasetName )
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, outDatasetName, dataBuffer );
-    else
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, inDatasetName, dataBuffer );
+    if(comp_flag == 1) {
+      short use_chunk = ctx->useChunk;
 
-    if ( datasetID == FATAL_ERR )
-    {
-        // Have warning const char* to char*:
-        const char* tempStr = outDatasetName ? outDatasetName : inDatasetName;
-        FATAL_MSG("Error writing \"%s\" dataset.\n", tempStr );
-        goto cleanupFail;
+      if(use_chunk == 1)
+      {// The chunk size will always be the whole dataset size for this case.
+       if(outDatasetName) 
+        datasetID = insertDataset_comp( ctx, &outputGroupID, 1, dataRank,
+                                        temp, outputDataType, outDatasetName, dataBuffer,0);
+       else
+        datasetID = insertDataset_comp( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, inDatasetName, dataBuffer,0 );
+ 
+     }
+     else // No compression
+     {
+       if ( outDatasetName )
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, outDatasetName, dataBuffer );
+       else
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, inDatasetName, dataBuffer );
+     }
+   }
+    else {
+      if ( outDatasetName )
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, outDatasetName, dataBuffer );
+      else
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, inDatasetName, dataBuffer );
+    }
+
+    if ( datasetID == FATAL_ERR )
+    {
+        // Have warning const char* to char*:
+        const char* tempStr = outDatasetName ? outDatasetName : inDatasetName;
+        FATAL_MSG("Error writing \"%s\" dataset.\n", tempStr );
+        free(dataBuffer);
+        H5Dclose(datasetID);
+        return (FATAL_ERR);
+    }
+
+
+    free(dataBuffer);
+
+    return datasetID;
+}
+
+float ReverseFloat( const float inFloat )
+{
+   float retVal;
+   char *floatToConvert = ( char* ) & inFloat;
+   char *returnFloat = ( char* ) & retVal;
+
+   // swap the bytes into a temporary buffer
+   returnFloat[0] = floatToConvert[3];
+   returnFloat[1] = floatToConvert[2];
+   returnFloat[2] = floatToConvert[1];
+   returnFloat[3] = floatToConvert[0];
+
+   return retVal;
+}
+
+/*
+                    readThenWriteSubset
+    DESCRIPTION:
+        This function is an abstraction of reading a dataset from an HDF4 file
+        and then writing it to the output HDF5 file. This function calls H4readData
+        which is itself an abstraction for reading input data into a data buffer, and
+        then writes that buffer to the output file using the insertDataset function.
+        Once all writing is done, it frees allocated memory and returns the HDF5 dataset
+        identifier that was created in the output file.
+
+        This function is the subset version of readThenWrite(). Additional arguments are
+        provided to speicify which portion of the dataset to write to the output.
+
+    ARGUMENTS:
+        ctx -- The conversion context, for the dataset layout
+        0. CER_LATLON     -- This boolean integer specifies whether the CERES geolocation units should be
+                             converted to latitude/longitude (from colatitude and longitude). 0 for no,
+                             non-zero for yes.
+
+        1. outDatasetName -- The name that the output HDF5 dataset will have. Note that the actual
+                             name the output dataset will have is the one given by correct_name(outDatasetName).
+                             Therefore you cannot assume that the output name will be exactly what
+                             is passed to this argument.
+                             Set to NULL if the same name as the inDatasetName is desired.
+
+        2. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
+                             be written. Can either be an actual group ID or can be the
+                             file ID (in the latter case, data will be written to the root
+                             directory).
+        3. inDatasetName    -- A string containing the name of the dataset in the input HDF4
+                             file. The output dataset will have the same name.
+        4. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
+                             input dataset. Please reference Section 3 of the HDF4
+                             Reference Manual for a list of HDF types.
+        5. outputDataType -- An HDF5 datatype identifier. Must be of the same general type
+                             of the input data type. Please reference the HDF5 API
+                             specification under "Predefined Datatypes" for a list of HDF5
+                             datatypes.
+        6. inputFileID    -- The HDF4 input file identifier
+
+        7. start
+        8. stride
+        9. count
+    EFFECTS:
+        Reads the input file dataset and then writes to the HDF5 output file. Returns
+        a dataset identifier for the new dataset created in the output file. It is the
+        responsibility of the caller to close the dataset ID when finished using
+        H5Dclose().
+
+    RETURN:
+        Returns the dataset identifier if successful. Else returns FATAL_ERR upon
+        any errors.
+*/
+
+hid_t readThenWriteSubset( BFcontext_t* ctx, int CER_LATLON, const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
+                           hid_t outputDataType, int32 inputFileID,int32 *start,int32*stride,int32*count )
+{
+    int32 dataRank;
+    int32 dataDimSizes[DIM_MAX];
+    void* dataBuffer = NULL;
+    hid_t datasetID;
+
+    herr_t status;
+
+    status = H4readData( inputFileID, inDatasetName,
+                         (void**)&dataBuffer, &dataRank, dataDimSizes, inputDataType,start,stride,count );
+
+    if ( status == FATAL_ERR )
+    {
+        FATAL_MSG("Unable to read \"%s\" data.\n", inDatasetName );
+        goto cleanupFail;
+    }
+
+    /* Landon Clipp Jul 12, 2017: CERES needs its geolocation units to be consistent with other
+     * instruments. The formula for converting the geolocation is: 
+     * 
+     * latitude (new) = 90 - Colatitude (CERES old)
+     * if ( longitude > 180 )
+     *   longitude=longitude-360
+     *
+     */
+    if ( CER_LATLON )
+    {
+        /* Perform the conversion */
+        // Check if this dataset is Latitude or Longitude
+        int index = 0;
+        if ( strstr(outDatasetName, "Latitude" ) )
+        {
+            // Iterate through every dimension
+            for ( int dim = 0; dim < dataRank; dim++ )
+            {
+                // Iterate through every element in each dimension
+                for ( int elem = 0; elem < dataDimSizes[dim]; elem++ )
+                {
+
+                    /* Databuffer has to be cast to a float* for proper pointer arithmetic.
+                       This is specific just to the geolocation datasets. We know in advance that
+                       it is a floating point number.
+                     */
+                    ( (float*) dataBuffer)[index] = (float)(90.0f - ( (float*) dataBuffer)[index]);
+                    index++;
+                }
+            }
+        }
+
+        else if ( strstr(outDatasetName, "Longitude" ) )
+        {
+            // Iterate through every dimension
+            for ( int dim = 0; dim < dataRank; dim++ )
+            {
+                // Iterate through every element in each dimension
+                for ( int elem = 0; elem < dataDimSizes[dim]; elem++ )
+                {   
+                    if ( ((float*) dataBuffer)[index] > 180.0f )
+                        ( (float *) dataBuffer)[index] = ( (float *) dataBuffer)[index] - 360.0f;
+                    index++;
+                }
+            }
+        }
+
+        else
+        {
+            FATAL_MSG("The CERES_LATLON argument was given as non-zero, but neither a Latitude nor Longitude\n\tdataset was transferred!\n");
+            goto cleanupFail;
+        }
+    }
+
+
+    /* END READ DATA. BEGIN INSERTION OF DATA */
+
+    /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
+     * that need to be resolved. Thus, we need to take the DimSizes array, which is
+     * of type int32 (an HDF4 type) and put it into an array of type hsize_t.
+     * A simple casting might work, but that is dangerous considering hsize_t and int32
+     * are not simply two different names for the same type. They are two different types.
+     */
+    hsize_t temp[DIM_MAX];
+    for ( int i = 0; i < DIM_MAX; i++ )
+        temp[i] = (hsize_t) dataDimSizes[i];
+
+    if ( outDatasetName )
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, outDatasetName, dataBuffer );
+    else
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, inDatasetName, dataBuffer );
+
+    if ( datasetID == FATAL_ERR )
+    {
+        // Have warning const char* to char*:
+        const char* tempStr = outDatasetName ? outDatasetName : inDatasetName;
+        FATAL_MSG("Error writing \"%s\" dataset.\n", tempStr );
+        goto cleanupFail;
     }
 
     hid_t retVal = datasetID;
@@ -1490,577 +2455,726 @@ char *correct_name(const char* oldname)
 }
 
 /*
-                    readThenWrite_ASTER_Unpack
+                    setScaledAttrs
     DESCRIPTION:
-        This function is a specific readThenWrite function for ASTER. This function does the
-        same thing as the general readThenWrite except it performs data unpacking. Essentially,
-        unpacking the data means converting the radiance datasets from an integer type to
-        a floating point type. Doing this greatly increases the size of the data however.
-        On an abstracted level, this is what unpacking looks like:
-
-        unpackedElement = scale * packedElement + offset
-
-        The packedElement is an integer type, and the unpackedElement is a single precision
-        float type.
-
+        This function writes the CF packing attributes of a radiance dataset written as scaled integers.
+        CF readers unpack a value as packed * scale_factor + add_offset, and mask the _FillValue and
+        any value outside valid_range.
     ARGUMENTS:
-        1. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
-                             be written. Can either be an actual group ID or can be the
-                             file ID (in the latter case, data will be written to the root
-                             directory).
-        2. datasetName    -- A string containing the name of the dataset in the input HDF4
-                             file. The output dataset will have the same name.
-        3. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
-                             input dataset. Please reference Section 3 of the HDF4
-                             Reference Manual for a list of HDF types.
-        4. inputFileID    -- The HDF4 input file identifier
-        5. unc            -- The uncertainty value for the unpacking
-
+        1. ctx         -- The conversion context (see initAttrStage)
+        2. datasetID   -- The dataset identifier
+        3. packedType  -- The HDF5 type of the dataset, also the type of fillValue and validRange
+        4. fillValue   -- The packed fill value
+        5. validRange  -- The smallest and largest valid packed values
+        6. scaleFactor -- The CF scale_factor
+        7. addOffset   -- The CF add_offset
     EFFECTS:
-        Reads the input file dataset and then writes to the HDF5 output file. Returns
-        a dataset identifier for the new dataset created in the output file. It is the
-        responsibility of the caller to close the dataset ID when finished using
-        H5Dclose().
-
+        Writes the _FillValue, valid_range, scale_factor and add_offset attributes.
     RETURN:
-        Returns the dataset identifier if successful. Else returns FATAL_ERR upon
-        any errors.
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
-/* MY 2016-12-20, routine to unpack ASTER data */
-hid_t readThenWrite_ASTER_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
-                                  int32 inputFileID,float unc )
-{
-    int32 dataRank = 0;
-    int32 dataDimSizes[DIM_MAX] = {0};
-    unsigned short* tir_dataBuffer = NULL;
-    uint8_t* vsir_dataBuffer = NULL;
-    float* output_dataBuffer = NULL;
-    size_t buffer_size = 1;
-    hid_t datasetID = 0;
-    hid_t outputDataType = 0;
 
-    intn status = -1;
+static herr_t setScaledAttrs( const BFcontext_t* ctx, hid_t datasetID, hid_t packedType, const void* fillValue, const void* validRange,
+                              float scaleFactor, float addOffset )
+{
+    attrStage_t stage;
 
-    if(unc < 0)
+    initAttrStage( ctx, &stage, datasetID );
+    if ( stageAttr( &stage, "_FillValue", packedType, 0, fillValue ) == FATAL_ERR ||
+         stageAttr( &stage, "valid_range", packedType, 2, validRange ) == FATAL_ERR ||
+         stageAttr( &stage, "scale_factor", H5T_NATIVE_FLOAT, 0, &scaleFactor ) == FATAL_ERR ||
+         stageAttr( &stage, "add_offset", H5T_NATIVE_FLOAT, 0, &addOffset ) == FATAL_ERR ||
+         flushAttrStage( &stage ) == FATAL_ERR )
     {
-         FATAL_MSG("There is no valid Unit Conversion Coefficient for this dataset  %s.\n",  datasetName );
-        return (FATAL_ERR);
-
+        FATAL_MSG("Failed to write the CF packing attributes.\n");
+        discardAttrStage( &stage );
+        return FATAL_ERR;
     }
 
-    if(DFNT_UINT8 == inputDataType)
-    {
-        status = H4readData( inputFileID, datasetName,
-                             (void**)&vsir_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
-    }
-    else if(DFNT_UINT16 == inputDataType)
-    {
-        status = H4readData( inputFileID, datasetName,
-                             (void**)&tir_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
+    return RET_SUCCESS;
+}
 
-    }
-    else
-    {
-         FATAL_MSG("Unsupported datatype. Datatype must be either DFNT_UINT16 or DFNT_UINT8.\n" );
-        return (FATAL_ERR);
-    }
+/*
+                    getKeepBits
+    DESCRIPTION:
+        This function tells how many mantissa bits of an unpacked float dataset to keep. The setting
+        comes from the environment variable BF_KEEP_BITS, a comma-separated list of a default
+        and/or name=bits rules, e.g. "12,EV_1KM_RefSB=14,Red Radiance=10", parsed by initContext.
+        A rule applies when its name is a substring of the dataset name, and the last matching rule
+        wins. Zero keeps the data as is.
+    ARGUMENTS:
+        1. ctx         -- The conversion context
+        2. datasetName -- The name of the input dataset
+    EFFECTS:
+        None
+    RETURN:
+        0 if the dataset is not to be rounded
+        The number of mantissa bits to keep, from 1 to KEEP_BITS_MAX, otherwise
+*/
 
+int getKeepBits( const BFcontext_t* ctx, const char* datasetName )
+{
+    int bits = ctx->keepBitsDefault;
 
-    if ( status == FATAL_ERR )
-    {
-         FATAL_MSG("Unable to read %s data.\n",  datasetName );
-        if ( vsir_dataBuffer != NULL ) free(vsir_dataBuffer);
-        if ( tir_dataBuffer != NULL ) free(tir_dataBuffer);
-        return (FATAL_ERR);
-    }
+    for ( int i = 0; i < ctx->numKeepBitsRules; i++ )
+        if ( strstr( datasetName, ctx->keepBitsRules[i].name ) )
+            bits = ctx->keepBitsRules[i].bits;
 
-    {
-        float* temp_float_pointer = NULL;
-        uint8_t* temp_uint8_pointer = vsir_dataBuffer;
-        unsigned short* temp_uint16_pointer = tir_dataBuffer;
-        /* Now we need to unpack the data */
-        for(int i = 0; i <dataRank; i++)
-            buffer_size *=dataDimSizes[i];
+    return bits;
+}
 
-        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
+/*
+                    bitRoundFloat
+    DESCRIPTION:
+        This function rounds float data to keepBits mantissa bits (round to nearest, ties to even) and
+        zeroes the remaining bits, so that deflate can compress them. The relative error of each value
+        is at most 2^-(keepBits+1). Values from fillMin to fillMax, infinities and NaNs are left as is.
+    ARGUMENTS:
+        1. data      -- The float buffer, rounded in place
+        2. numElems  -- The number of values in the buffer
+        3. keepBits  -- The number of mantissa bits to keep, from 1 to KEEP_BITS_MAX
+        4. fillMin   -- The smallest fill value
+        5. fillMax   -- The largest fill value
+    EFFECTS:
+        Modifies the buffer.
+    RETURN:
+        None
+*/
 
-        temp_float_pointer = output_dataBuffer;
+void bitRoundFloat( float* data, size_t numElems, int keepBits, float fillMin, float fillMax )
+{
+    const int shift = KEEP_BITS_MAX - keepBits;
+    const uint32_t mask = ~(uint32_t)0 << shift;
+    const uint32_t half = shift > 0 ? ( (uint32_t)1 << ( shift - 1 ) ) - 1 : 0;
+    uint32_t bits = 0;
 
-        if(DFNT_UINT8 == inputDataType)
-        {
-            for(int i = 0; i<buffer_size; i++)
-            {
-                if(*temp_uint8_pointer == 0)
-                    *temp_float_pointer = -999;
-                else if(*temp_uint8_pointer == 1)
-                    *temp_float_pointer = 0;
-                else if(*temp_uint8_pointer == 255)// Now make no data differentiate from saturated data
-                    *temp_float_pointer = -998;
-                else
-                    *temp_float_pointer = (float)((*temp_uint8_pointer -1))*unc;
-                temp_float_pointer++;
-                temp_uint8_pointer++;
-            }
-        }
-        else if(DFNT_UINT16 == inputDataType)
-        {
-            for(int i = 0; i<buffer_size; i++)
-            {
-                if(*temp_uint16_pointer == 0)
-                    *temp_float_pointer = -999;
-                else if(*temp_uint16_pointer == 1)
-                    *temp_float_pointer = 0;
-                else if(*temp_uint16_pointer == 4095)// Now make no data differentiate from saturated data
-                    *temp_float_pointer = -998;
-                else
-                    *temp_float_pointer = (float)((*temp_uint16_pointer-1))*unc;
-                temp_float_pointer++;
-                temp_uint16_pointer++;
+    if ( shift <= 0 )
+        return;
 
-            }
-        }
+    for ( size_t i = 0; i < numElems; i++ )
+    {
+        if ( data[i] >= fillMin && data[i] <= fillMax )
+            continue;
+        memcpy( &bits, &data[i], sizeof bits );
+        if ( ( bits & 0x7f800000 ) == 0x7f800000 )
+            continue;
+        bits = ( bits + half + ( ( bits >> shift ) & 1 ) ) & mask;
+        memcpy( &data[i], &bits, sizeof bits );
+    }
+}
+
+/*
+                    setKeepBitsAttr
+    DESCRIPTION:
+        This function records on a dataset that its values were rounded by bitRoundFloat. The
+        attribute name follows the netCDF quantization convention, so netCDF readers recognize it.
+    ARGUMENTS:
+        1. datasetID -- The dataset identifier
+        2. keepBits  -- The number of mantissa bits kept
+    EFFECTS:
+        Writes the KEEP_BITS_ATTR attribute.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
 
+herr_t setKeepBitsAttr( hid_t datasetID, int keepBits )
+{
+    if ( H5LTset_attribute_int( datasetID, ".", KEEP_BITS_ATTR, &keepBits, 1 ) < 0 )
+    {
+        FATAL_MSG("Failed to write the %s attribute.\n", KEEP_BITS_ATTR);
+        return FATAL_ERR;
     }
-    /* END READ DATA. BEGIN INSERTION OF DATA */
 
-    /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
-     * that need to be resolved. Thus, we need to take the DimSizes array, which is
-     * of type int32 (an HDF4 type) and put it into an array of type hsize_t.
-     * A simple casting might work, but that is dangerous considering hsize_t and int32
-     * are not simply two different names for the same type. They are two different types.
-     */
-    hsize_t temp[DIM_MAX];
-    for ( int i = 0; i < DIM_MAX; i++ )
-        temp[i] = (hsize_t) dataDimSizes[i];
+    return RET_SUCCESS;
+}
 
-    outputDataType = H5T_NATIVE_FLOAT;
+/*
+                    initDatasetStats
+    DESCRIPTION:
+        This function prepares the statistics of an unpacked dataset. When the environment variable
+        BF_STATS is 1, the unpack kernels feed each tile of the output buffer to accumulateStats
+        right after unpacking it, while it is still in cache. A tile is a run of whole rows of the
+        slowest dimension holding at least STATS_TILE_ELEMS values: one band of a MODIS radiance,
+        one block of a MISR radiance, a few rows of an ASTER image. The histogram has STATS_HIST_BINS
+        equal bins from histMin to histMax, the range the packed values can unpack to. With USE_CHUNK,
+        the ASTER and MISR radiances are chunked by tile (see insertDataset_comp_tiled), and the MODIS
+        radiances by band, so that every tile is whole chunks.
+    ARGUMENTS:
+        1. ctx      -- The conversion context
+        2. stats    -- The statistics to initialize
+        3. rank     -- The rank of the dataset
+        4. dims     -- The dimension sizes of the dataset
+        5. fillMin  -- The smallest fill value
+        6. fillMax  -- The largest fill value
+        7. histMin  -- The lower edge of the histogram
+        8. histMax  -- The upper edge of the histogram
+    EFFECTS:
+        Allocates the tile table when BF_STATS is set. Release it with freeDatasetStats.
+        When BF_STATS is not set, the whole dataset is one tile and accumulateStats does nothing.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
 
-    short use_chunk = 0;
+herr_t initDatasetStats( const BFcontext_t* ctx, datasetStats_t* stats, int32 rank, const int32* dims, float fillMin, float fillMax,
+                         float histMin, float histMax )
+{
+    size_t rowElems = 1;
 
-    /* If using chunk */
-    {
-        const char *s;
-        s = getenv("USE_CHUNK");
+    memset( stats, 0, sizeof *stats );
+    for ( int i = 1; i < rank; i++ )
+        rowElems *= dims[i];
+    stats->tileRows = dims[0];
+    stats->tileElems = rowElems * dims[0];
+    stats->numTiles = 1;
 
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) == 1)
-                use_chunk = 1;
-    }
+    if ( !ctx->stats || dims[0] == 0 || rowElems == 0 )
+        return RET_SUCCESS;
 
-    if(use_chunk == 1)
-    {
-        datasetID = insertDataset_comp( &outputFile, &outputGroupID, 1, dataRank,
-                                        temp, outputDataType, datasetName, output_dataBuffer,0);
-    }
-    else
+    stats->tileRows = ( STATS_TILE_ELEMS + rowElems - 1 ) / rowElems;
+    if ( stats->tileRows > (size_t) dims[0] )
+        stats->tileRows = dims[0];
+    stats->tileElems = stats->tileRows * rowElems;
+    stats->numTiles = ( dims[0] + stats->tileRows - 1 ) / stats->tileRows;
+    stats->tiles = calloc( stats->numTiles, sizeof *stats->tiles );
+    if ( stats->tiles == NULL )
     {
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, datasetName, output_dataBuffer );
+        FATAL_MSG("Failed to allocate the statistics of %zu tiles.\n", stats->numTiles);
+        return FATAL_ERR;
     }
 
-
-    if ( datasetID == FATAL_ERR )
+    for ( size_t t = 0; t < stats->numTiles; t++ )
     {
-         FATAL_MSG("Error writing %s dataset.\n", datasetName );
-        if ( vsir_dataBuffer != NULL ) free(vsir_dataBuffer);
-        if ( tir_dataBuffer != NULL ) free(tir_dataBuffer);
-        if ( output_dataBuffer != NULL ) free(output_dataBuffer);
-        return (FATAL_ERR);
+        stats->tiles[t].rowStart = t * stats->tileRows;
+        stats->tiles[t].rowCount = ( t + 1 ) * stats->tileRows > (size_t) dims[0] ? dims[0] - t * stats->tileRows
+                                                                                   : stats->tileRows;
     }
+    stats->fillMin = fillMin;
+    stats->fillMax = fillMax;
+    stats->histMin = histMin;
+    stats->histMax = histMax > histMin ? histMax : histMin + 1.0f;
+    stats->enabled = 1;
 
-    if ( vsir_dataBuffer != NULL ) free(vsir_dataBuffer);
-    if ( tir_dataBuffer != NULL ) free(tir_dataBuffer);
-    if ( output_dataBuffer != NULL ) free(output_dataBuffer);
-    return datasetID;
+    return RET_SUCCESS;
 }
 
 /*
-                    readThenWrite_MISR_Unpack
+                    accumulateStats
     DESCRIPTION:
-        This function is a specific readThenWrite function for MISR. This function does the
-        same thing as the general readThenWrite except it performs data unpacking. Essentially,
-        unpacking the data means converting the radiance datasets from an integer type to
-        a floating point type. Doing this greatly increases the size of the data however.
-        On an abstracted level, this is what unpacking looks like:
+        This function adds unpacked values to the dataset and tile statistics. Values from fillMin to
+        fillMax, infinities and NaNs are counted as fill. Values outside the histogram range go to
+        its first or last bin.
+    ARGUMENTS:
+        1. stats     -- The statistics prepared by initDatasetStats
+        2. data      -- The values, starting at element first of the dataset
+        3. first     -- The index of data[0] in the dataset
+        4. numElems  -- The number of values
+    EFFECTS:
+        Updates the statistics. Does nothing if BF_STATS is not set.
+    RETURN:
+        None
+*/
 
-        unpackedElement = scale * packedElement + offset
+void accumulateStats( datasetStats_t* stats, const float* data, size_t first, size_t numElems )
+{
+    const float binScale = STATS_HIST_BINS / ( stats->histMax - stats->histMin );
 
-        The packedElement is an integer type, and the unpackedElement is a single precision
-        float type.
+    if ( !stats->enabled )
+        return;
 
-    ARGUMENTS:
-        1. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
-                             be written. Can either be an actual group ID or can be the
-                             file ID (in the latter case, data will be written to the root
-                             directory).
-        2. datasetName    -- A string containing the name of the dataset in the input HDF4
-                             file. The output dataset will have the same name.
-        3. retDatasetName -- The actual output dataset name. The output name cannot be
-                             guaranteed to be the same as the input name (argument datasetName).
-                             Function will modify the char* pointed to by this argument to point
-                             to the output dataset name.
+    while ( numElems > 0 )
+    {
+        tileStats_t* tile = &stats->tiles[first / stats->tileElems];
+        size_t n = ( first / stats->tileElems + 1 ) * stats->tileElems - first;
+        if ( n > numElems )
+            n = numElems;
 
-                             CALLER MUST FREE THIS VARIABLE!!!! It is allocated by malloc!
+        for ( size_t i = 0; i < n; i++ )
+        {
+            float v = data[i];
+            int bin = 0;
 
-        4. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
-                             input dataset. Please reference Section 3 of the HDF4
-                             Reference Manual for a list of HDF types.
-        5. inputFileID    -- The HDF4 input file identifier
-        6. scale_factor   -- Value of "scale" in the unpacking equation
+            if ( ( v >= stats->fillMin && v <= stats->fillMax ) || isnan(v) || isinf(v) )
+            {
+                tile->fillCount++;
+                continue;
+            }
+            if ( tile->validCount == 0 || v < tile->min ) tile->min = v;
+            if ( tile->validCount == 0 || v > tile->max ) tile->max = v;
+            tile->sum += v;
+            tile->validCount++;
+
+            bin = (int) ( ( v - stats->histMin ) * binScale );
+            if ( bin < 0 ) bin = 0;
+            if ( bin >= STATS_HIST_BINS ) bin = STATS_HIST_BINS - 1;
+            stats->hist[bin]++;
+        }
 
-    EFFECTS:
-        Reads the input file dataset and then writes to the HDF5 output file. Returns
-        a dataset identifier for the new dataset created in the output file. It is the
-        responsibility of the caller to close the dataset ID when finished using
-        H5Dclose().
+        data += n;
+        first += n;
+        numElems -= n;
+    }
+}
 
+/*
+                    writeDatasetStats
+    DESCRIPTION:
+        This function writes the statistics of an unpacked dataset. The dataset gets the attributes
+        valid_count, fill_count, actual_range and actual_mean, the histogram with its histogram_range,
+        and the name of its tile table in tile_statistics. The tile table is a compound dataset named
+        after the dataset with STATS_TABLE_SUFFIX, in the same group. Each row gives the first row and
+        the row count of a tile along the slowest dimension and the valid_count, fill_count, min, max
+        and mean of the tile, so that readers can skip tiles that are all fill or out of range. The
+        min, max and mean of a tile without valid values are the fill value fillMin.
+    ARGUMENTS:
+        1. ctx         -- The conversion context (see initAttrStage)
+        2. stats       -- The statistics filled by accumulateStats
+        3. groupID     -- The group of the dataset
+        4. datasetID   -- The dataset
+        5. datasetName -- The name of the dataset before correct_name
+    EFFECTS:
+        Writes the attributes and creates the tile table. Does nothing if BF_STATS is not set.
     RETURN:
-        Returns the dataset identifier if successful. Else returns FATAL_ERR upon
-        any errors.
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
-/* MY-2016-12-20 Routine to unpack MISR data */
-hid_t readThenWrite_MISR_Unpack( hid_t outputGroupID, char* cameraName,char* datasetName, char** retDatasetNamePtr,int32 inputDataType,
-                                 int32 inputFileID,float scale_factor,unsigned short * has_LAI_DIM1_ptr )
+
+herr_t writeDatasetStats( const BFcontext_t* ctx, datasetStats_t* stats, hid_t groupID, hid_t datasetID, const char* datasetName )
 {
-    int32 dataRank = 0;
-    int32 dataDimSizes[DIM_MAX] = {0};
-    unsigned short* input_dataBuffer = NULL;
-    float * output_dataBuffer = NULL;
-    hid_t datasetID = 0;
-    hid_t outputDataType = 0;
-    intn status = 0;
-    char* newdatasetName = NULL;
+    typedef struct
+    {
+        uint32_t rowStart;
+        uint32_t rowCount;
+        uint64_t validCount;
+        uint64_t fillCount;
+        float min;
+        float max;
+        float mean;
+    } tileRow_t;
+
+    tileRow_t* rows = NULL;
+    char* tableName = NULL;
+    char* correctedName = NULL;
+    hid_t rowType = -1;
+    hid_t fileType = -1;
+    hid_t space = -1;
+    hid_t table = -1;
+    hsize_t numTiles = stats->numTiles;
+    uint64_t validCount = 0;
+    uint64_t fillCount = 0;
+    float range[2] = { stats->fillMin, stats->fillMin };
+    float histRange[2] = { stats->histMin, stats->histMax };
+    double sum = 0.0;
+    double mean = stats->fillMin;
+    attrStage_t stage;
+    int fail = 0;
+
+    if ( !stats->enabled )
+        return RET_SUCCESS;
 
-    if(scale_factor < 0)
-    {
-         FATAL_MSG("The scale_factor of %s is less than 0.\n",  datasetName );
-        return (FATAL_ERR);
+    initAttrStage( ctx, &stage, datasetID );
 
+    rows = malloc( stats->numTiles * sizeof *rows );
+    correctedName = correct_name( datasetName );
+    if ( rows == NULL || correctedName == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
     }
-//printf("cameraName is %s\n",cameraName);
-    status = H4readData( inputFileID, datasetName,
-                         (void**)&input_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL);
-    if ( status < 0 )
+    tableName = malloc( strlen(correctedName) + strlen(STATS_TABLE_SUFFIX) + 1 );
+    if ( tableName == NULL )
     {
-         FATAL_MSG("Unable to read %s data.\n",  datasetName );
-        if ( input_dataBuffer != NULL ) free(input_dataBuffer);
-        return (FATAL_ERR);
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
     }
-
-    /* Before unpacking the data, we want to re-arrange the name */
-    char* RDQIName = "/RDQI";
-    char* temp_sub_dsetname = strstr(datasetName,RDQIName);
-
-
-    if(temp_sub_dsetname!=NULL && strncmp(RDQIName,temp_sub_dsetname,strlen(temp_sub_dsetname)) == 0)
+    strcpy( tableName, correctedName );
+    strcat( tableName, STATS_TABLE_SUFFIX );
+
+    for ( size_t t = 0; t < stats->numTiles; t++ )
+    {
+        const tileStats_t* tile = &stats->tiles[t];
+
+        rows[t].rowStart = tile->rowStart;
+        rows[t].rowCount = tile->rowCount;
+        rows[t].validCount = tile->validCount;
+        rows[t].fillCount = tile->fillCount;
+        rows[t].min = tile->validCount ? tile->min : stats->fillMin;
+        rows[t].max = tile->validCount ? tile->max : stats->fillMin;
+        rows[t].mean = tile->validCount ? (float) ( tile->sum / tile->validCount ) : stats->fillMin;
+
+        if ( tile->validCount && ( validCount == 0 || tile->min < range[0] ) ) range[0] = tile->min;
+        if ( tile->validCount && ( validCount == 0 || tile->max > range[1] ) ) range[1] = tile->max;
+        validCount += tile->validCount;
+        fillCount += tile->fillCount;
+        sum += tile->sum;
+    }
+    if ( validCount )
+        mean = sum / validCount;
+
+    /* The tile table */
+    rowType = H5Tcreate( H5T_COMPOUND, sizeof(tileRow_t) );
+    if ( rowType < 0 ||
+         H5Tinsert( rowType, "row_start", HOFFSET(tileRow_t, rowStart), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( rowType, "row_count", HOFFSET(tileRow_t, rowCount), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( rowType, "valid_count", HOFFSET(tileRow_t, validCount), H5T_NATIVE_UINT64 ) < 0 ||
+         H5Tinsert( rowType, "fill_count", HOFFSET(tileRow_t, fillCount), H5T_NATIVE_UINT64 ) < 0 ||
+         H5Tinsert( rowType, "min", HOFFSET(tileRow_t, min), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( rowType, "max", HOFFSET(tileRow_t, max), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( rowType, "mean", HOFFSET(tileRow_t, mean), H5T_NATIVE_FLOAT ) < 0 )
+    {
+        FATAL_MSG("Failed to create the tile statistics datatype.\n");
+        goto cleanupFail;
+    }
+    fileType = H5Tcopy( rowType );
+    if ( fileType < 0 || H5Tpack( fileType ) < 0 )
     {
-        newdatasetName = malloc( strlen(datasetName) - strlen(RDQIName) + 1 );
-        memset(newdatasetName,'\0',strlen(datasetName)-strlen(RDQIName)+1);
+        FATAL_MSG("Failed to create the tile statistics datatype.\n");
+        goto cleanupFail;
+    }
 
-        strncpy(newdatasetName,datasetName,strlen(datasetName)-strlen(RDQIName));
+    space = H5Screate_simple( 1, &numTiles, NULL );
+    if ( space < 0 )
+    {
+        FATAL_MSG("Failed to create the dataspace of %s.\n", tableName);
+        goto cleanupFail;
     }
-    else  // We will fail here.
+    table = H5Dcreate2( groupID, tableName, fileType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( table < 0 || H5Dwrite( table, rowType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows ) < 0 )
     {
-         FATAL_MSG("Error: The dataset name doesn't end with /RDQI\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to write the tile statistics table %s.\n", tableName);
+        goto cleanupFail;
     }
 
+    /* The dataset attributes */
+    if ( stageAttr( &stage, "valid_count", H5T_NATIVE_UINT64, 0, &validCount ) == FATAL_ERR ||
+         stageAttr( &stage, "fill_count", H5T_NATIVE_UINT64, 0, &fillCount ) == FATAL_ERR ||
+         stageAttr( &stage, "actual_range", H5T_NATIVE_FLOAT, 2, range ) == FATAL_ERR ||
+         stageAttr( &stage, "actual_mean", H5T_NATIVE_DOUBLE, 0, &mean ) == FATAL_ERR ||
+         stageAttr( &stage, "histogram", H5T_NATIVE_UINT64, STATS_HIST_BINS, stats->hist ) == FATAL_ERR ||
+         stageAttr( &stage, "histogram_range", H5T_NATIVE_FLOAT, 2, histRange ) == FATAL_ERR ||
+         stageAttrString( &stage, "tile_statistics", tableName ) == FATAL_ERR ||
+         flushAttrStage( &stage ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the statistics attributes of %s.\n", correctedName);
+        goto cleanupFail;
+    }
 
-
-    /* Data Unpack */
+    if ( 0 )
     {
+cleanupFail:
+        fail = 1;
+    }
 
-        float* temp_float_pointer = NULL;
-        unsigned short* temp_uint16_pointer = input_dataBuffer;
-        unsigned short* temp_uint16_pointer_mask = input_dataBuffer;
-        unsigned short temp_cklq_input_val = 0;
-        size_t buffer_size = 1;
-        unsigned short  rdqi = 0;
-        unsigned short  rdqi_mask = 3;
-        size_t num_la_data = 0;
-
-
-        for(int i = 0; i <dataRank; i++)
-            buffer_size *=dataDimSizes[i];
+    discardAttrStage( &stage );
+    if ( table >= 0 ) H5Dclose(table);
+    if ( space >= 0 ) H5Sclose(space);
+    if ( fileType >= 0 ) H5Tclose(fileType);
+    if ( rowType >= 0 ) H5Tclose(rowType);
+    free(rows);
+    free(tableName);
+    free(correctedName);
 
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
+}
 
-        for(int i = 0; i<buffer_size; i++)
-        {
-            rdqi = (*temp_uint16_pointer_mask)&rdqi_mask;
-            if(rdqi == 1){
-                temp_cklq_input_val = (*temp_uint16_pointer_mask)>>2;
-                if(temp_cklq_input_val != 16378 && temp_cklq_input_val != 16380) 
-                    num_la_data++;
-            }
-            temp_uint16_pointer_mask++;
-        }
+/*
+                    freeDatasetStats
+    DESCRIPTION:
+        This function releases the tile table allocated by initDatasetStats.
+    ARGUMENTS:
+        1. stats -- The statistics
+    EFFECTS:
+        Frees memory.
+    RETURN:
+        None
+*/
 
-#if 0
-        if(num_la_data>0)
-        {
-            has_la_data = 1;
-            la_data_pos = calloc(sizeof la_data_pos*num_la_data,dankRank);
-            temp_la_data_pos_pointer = la_data_pos;
-        }
-#endif
-        /* Need to obtain low frequency indexes */
-        if(num_la_data >0)
-        {
+void freeDatasetStats( datasetStats_t* stats )
+{
+    free( stats->tiles );
+    stats->tiles = NULL;
+    stats->enabled = 0;
+}
 
-            unsigned short*temp_ck_uint16_pointer = input_dataBuffer;
-            if(dataRank != 3) {
-                FATAL_MSG("Error MISR radiance  %s dataset should be 3-D array.\n", datasetName );
-                if(newdatasetName) free(newdatasetName);
-                if( input_dataBuffer) free(input_dataBuffer);
-                return (FATAL_ERR);
-            } 
+/*
+                    downsampleMean
+    DESCRIPTION:
+        This function halves the last two dimensions of a float array by averaging 2x2 blocks. Only
+        valid values are averaged, weighted by the number of full-resolution values each one stands
+        for, so that every level of a pyramid is the exact mean of the valid full-resolution values
+        under it. A block without valid values gets fillMin. The rows are split over OpenMP threads
+        when the library is built with OpenMP.
+    ARGUMENTS:
+        1. in        -- The input values, outer x rows x cols
+        2. inCount   -- The number of valid full-resolution values behind each input value, or NULL
+                        if the input is the full resolution
+        3. out       -- The output values, outer x ceil(rows/2) x ceil(cols/2)
+        4. outCount  -- The number of valid full-resolution values behind each output value
+        5. outer     -- The product of the leading dimensions (bands, blocks), 1 for 2-D data
+        6. rows      -- The size of the second to last dimension
+        7. cols      -- The size of the last dimension
+        8. fillMin   -- The smallest fill value
+        9. fillMax   -- The largest fill value
+    EFFECTS:
+        Fills out and outCount.
+    RETURN:
+        None
+*/
 
-            //unsigned int la_data_pos[num_la_data][3] ;
-            //unsigned int* la_data_pos =(unsigned int*)malloc(sizeof(unsigned int) *num_la_data*3) ;
-            unsigned short* la_data_pos =(unsigned short*)malloc(sizeof(unsigned short) *num_la_data*3) ;
-            //unsigned int* temp_la_data_pos = la_data_pos;
-            unsigned short* temp_la_data_pos = la_data_pos;
+static void downsampleMean( const float* in, const uint32* inCount, float* out, uint32* outCount,
+                            size_t outer, size_t rows, size_t cols, float fillMin, float fillMax )
+{
+    const size_t outRows = ( rows + 1 ) / 2;
+    const size_t outCols = ( cols + 1 ) / 2;
+    const long numOutRows = (long) ( outer * outRows );
 
-            /* obtain the low accuracy tindex */
-            /* We know the index is within the unsigned short range. This can reduce some space. */
-            unsigned int ck_count = 0;
-            for(unsigned short i =0; i <dataDimSizes[0];i++) {
-                for (unsigned short j =0;j<dataDimSizes[1];j++) {
-                    for (unsigned short k=0;k<dataDimSizes[2];k++) {
-                        rdqi = (*temp_ck_uint16_pointer)&rdqi_mask;
-                        if(rdqi == 1){
-                    
-                            temp_cklq_input_val = (*temp_ck_uint16_pointer)>>2;
-                            if(temp_cklq_input_val != 16378 && temp_cklq_input_val != 16380) {
-                                /* Remember the index */ 
-                                /* The toolkit generates block number. So the first one may be i+1.*/
-#if 0
-                                la_data_pos[ck_count][0] = i+1;
-                                la_data_pos[ck_count][1] = j;
-                                la_data_pos[ck_count][2] = k;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
 #endif
-                                *temp_la_data_pos = i+1;
-                                temp_la_data_pos++;
-                                *temp_la_data_pos = j;
-                                temp_la_data_pos++;
-                                *temp_la_data_pos = k;
-                                temp_la_data_pos++;
-                                ck_count++;
-                            }
-                        }
-                        temp_ck_uint16_pointer++;
-                    }
-                }
-            }
-
-            if(ck_count != num_la_data) {
-                FATAL_MSG("Error MISR radiance  %s dataset low accuracy index is wrong.\n", datasetName );
-                if(newdatasetName) free(newdatasetName);
-                if( input_dataBuffer) free(input_dataBuffer);
-                return (FATAL_ERR);
-            } 
-
-            hid_t la_pos_dsetid =0 ;
-            int la_pos_dset_rank = 2;
-            hsize_t la_pos_dset_dims[2];
-            la_pos_dset_dims[0]= num_la_data;
-            la_pos_dset_dims[1]= 3;
-            char* la_pos_dset_name_suffix="_low_accuracy_index";
-            size_t la_pos_dset_name_len = strlen(la_pos_dset_name_suffix)+strlen(newdatasetName)+1;
-            char* la_pos_dset_name=malloc(la_pos_dset_name_len);
-            la_pos_dset_name[la_pos_dset_name_len-1]='\0';
-            strcpy(la_pos_dset_name,newdatasetName);
-            strcat(la_pos_dset_name,la_pos_dset_name_suffix);
+    for ( long r = 0; r < numOutRows; r++ )
+    {
+        const size_t plane = r / outRows;
+        const size_t row = 2 * ( r % outRows );
 
-            /* Create a dataset to remember the postion of low accuracy data */
-            la_pos_dsetid = insertDataset_comp( &outputFile, &outputGroupID, 1, la_pos_dset_rank,
-                                           la_pos_dset_dims, H5T_NATIVE_USHORT, la_pos_dset_name, la_data_pos,0 );
-                                           //la_pos_dset_dims, H5T_NATIVE_UINT, la_pos_dset_name, la_data_pos );
+        for ( size_t c = 0; c < outCols; c++ )
+        {
+            double sum = 0.0;
+            uint32 count = 0;
 
-            if ( la_pos_dsetid == FATAL_ERR )
+            for ( size_t i = row; i < row + 2 && i < rows; i++ )
             {
-                 FATAL_MSG("Error writing %s dataset.\n", newdatasetName );
-                if(la_pos_dset_name)
-                    free(la_pos_dset_name);
-                if(newdatasetName) free(newdatasetName);
-                if( input_dataBuffer) free(input_dataBuffer);
-                H5Dclose(la_pos_dsetid);
-                return (FATAL_ERR);
-            }
-            if(la_pos_dset_name)
-                free(la_pos_dset_name);
-            free(la_data_pos);
- 
-            // Need to create/attach dimensions
-            // First the fixed 3-element dimension
-            char* lai_dim1="/MISR_LA_POS_DIM";
-            if(*has_LAI_DIM1_ptr == 0) {
-                hid_t lai_dim1_id = 0;
-                hsize_t lai_dim1_size = la_pos_dset_dims[1];
-                hid_t lai_dspace = H5Screate_simple(1,&lai_dim1_size,NULL);
-                if(makePureDim(outputFile,lai_dim1,lai_dspace,H5T_NATIVE_INT,&lai_dim1_id)!=RET_SUCCESS) {
-                    FATAL_MSG("Error creating MISR Low accuracy position dimenson.  \n");
-                    H5Sclose(lai_dspace);
-                    H5Dclose(la_pos_dsetid);
-                    if(newdatasetName) free(newdatasetName);
-                    if( input_dataBuffer) free(input_dataBuffer);
-                    return (FATAL_ERR);
+                for ( size_t j = 2 * c; j < 2 * c + 2 && j < cols; j++ )
+                {
+                    size_t k = ( plane * rows + i ) * cols + j;
+                    float v = in[k];
+                    uint32 n = inCount ? inCount[k] : 1;
+
+                    if ( n == 0 || ( v >= fillMin && v <= fillMax ) || isnan(v) || isinf(v) )
+                        continue;
+                    sum += (double) v * n;
+                    count += n;
                 }
-                H5Sclose(lai_dspace);
-                H5Dclose(lai_dim1_id);
-                *has_LAI_DIM1_ptr = 1;
             }
 
-            if(attachDimension(outputFile,lai_dim1,la_pos_dsetid,1)!=RET_SUCCESS) {
-                FATAL_MSG("Error creating MISR Low accuracy position dimenson.  \n");
-                if(newdatasetName) free(newdatasetName);
-                if( input_dataBuffer) free(input_dataBuffer);
-                H5Dclose(la_pos_dsetid);
-            }
-            // Need to create the dimension name for LA index dimension.
-            // Name will be /MISR_AN_RR_LA_INX_DIM
-            char* lai_dim0_temp="/MISR_AN_RR_LA_INX_DIM";
-            char * lai_dim0=malloc(strlen(lai_dim0_temp)+1);
-            strcpy(lai_dim0,"/MISR_");
-            strcat(lai_dim0,cameraName);
-            strcat(lai_dim0,"_");
-            char*RadName_short=malloc(3);
-            RadName_short[0] = newdatasetName[0];
-            RadName_short[1] = 'R';
-            RadName_short[2]='\0';
-            
-            strcat(lai_dim0,RadName_short);
-            free(RadName_short);
-            strcat(lai_dim0,"_LA_INX_DIM");
-            hsize_t lai_dim0_size = la_pos_dset_dims[0];
-            hid_t lai_dim0_id = 0;
-            hid_t lai_dspace0 = H5Screate_simple(1,&lai_dim0_size,NULL);
-            if(makePureDim(outputFile,lai_dim0,lai_dspace0,H5T_NATIVE_INT,&lai_dim0_id)!=RET_SUCCESS) {
-                FATAL_MSG("Error creating MISR Low accuracy index dimenson.  \n");
-                H5Sclose(lai_dspace0);
-                H5Dclose(la_pos_dsetid);
-                if(newdatasetName) free(newdatasetName);
-                if( input_dataBuffer) free(input_dataBuffer);
-                return (FATAL_ERR);
-            }
-            H5Sclose(lai_dspace0);
-            H5Dclose(lai_dim0_id);
-            if(attachDimension(outputFile,lai_dim0,la_pos_dsetid,0)!=RET_SUCCESS) {
-                FATAL_MSG("Error creating MISR Low accuracy dimenson 1.  \n");
-                if(newdatasetName) free(newdatasetName);
-                if( input_dataBuffer) free(input_dataBuffer);
-                H5Dclose(la_pos_dsetid);
-            }
-            free(lai_dim0);
-            H5Dclose(la_pos_dsetid);
-            // { } may add an attribute to the group later.
+            out[r * outCols + c] = count ? (float) ( sum / count ) : fillMin;
+            outCount[r * outCols + c] = count;
         }
+    }
+}
 
-        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
-        temp_float_pointer = output_dataBuffer;
-
-        unsigned short temp_input_val;
+/*
+                    writeOverviews
+    DESCRIPTION:
+        This function writes downsampled copies (overviews) of an unpacked radiance dataset for quick
+        looks and coarse analyses. The environment variable BF_OVERVIEWS sets the number of levels, up
+        to OVERVIEW_MAX_LEVELS. Level n halves the last two dimensions n times (factor 2^n) and is
+        computed from level n-1 (see downsampleMean). Leading dimensions (MODIS bands, MISR blocks)
+        are kept. The levels stop early once the last two dimensions reach 1.
+
+        Each level is written next to the dataset as <name>OVERVIEW_SUFFIX<factor>, with the same
+        chunking and compression, and carries the attributes overview_of, overview_factor and
+        _FillValue. The dataset itself gets the attributes overviews (the names of its levels,
+        separated by spaces) and overview_factors.
+    ARGUMENTS:
+        1. ctx         -- The conversion context
+        2. groupID     -- The group of the dataset
+        3. datasetID   -- The dataset
+        4. datasetName -- The name of the dataset before correct_name
+        5. data        -- The unpacked values of the dataset
+        6. rank        -- The rank of the dataset, at least 2
+        7. dims        -- The dimension sizes of the dataset
+        8. fillMin     -- The smallest fill value
+        9. fillMax     -- The largest fill value
+        10. is_modis   -- Chunk each band separately (see insertDataset_comp)
+        11. use_chunk  -- Write the levels chunked and compressed, as the dataset
+    EFFECTS:
+        Creates the overview datasets. Does nothing if BF_OVERVIEWS is not set.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
 
-        /* Unpacking the data, both reduced accuracy and within specifications. RDQI=0 and RDQI=1. */
-        {
-            for(int i = 0; i<buffer_size; i++)
-            {
-                rdqi = (*temp_uint16_pointer)&rdqi_mask;
-                if(rdqi == 2 || rdqi == 3)
-                    *temp_float_pointer = -999.0;
-                else
-                {
-                    temp_input_val = (*temp_uint16_pointer)>>2;
-                    if(temp_input_val == 16378 || temp_input_val == 16380)
-                        *temp_float_pointer = -999.0;
-                    else
-                        *temp_float_pointer = scale_factor*((float)temp_input_val);
-                }
-                temp_uint16_pointer++;
-                temp_float_pointer++;
-            }
-        }
+herr_t writeOverviews( const BFcontext_t* ctx, hid_t groupID, hid_t datasetID, const char* datasetName, const float* data, int32 rank,
+                       const int32* dims, float fillMin, float fillMax, unsigned short is_modis, short use_chunk )
+{
+    int numLevels = ctx->overviewLevels;
+    int factors[OVERVIEW_MAX_LEVELS];
+    size_t outer = 1;
+    size_t rows = 0;
+    size_t cols = 0;
+    const float* prev = data;
+    uint32* prevCount = NULL;
+    float* level = NULL;
+    uint32* levelCount = NULL;
+    char* levelName = NULL;
+    char* overviewList = NULL;
+    hsize_t levelDims[DIM_MAX];
+    hid_t levelID = -1;
+    attrStage_t stage;
+    int fail = 0;
+
+    if ( numLevels <= 0 || rank < 2 || rank > DIM_MAX )
+        return RET_SUCCESS;
 
-    }
+    initAttrStage( ctx, &stage, -1 );
 
+    for ( int i = 0; i < rank - 2; i++ )
+        outer *= dims[i];
+    rows = dims[rank - 2];
+    cols = dims[rank - 1];
+    for ( int i = 0; i < rank; i++ )
+        levelDims[i] = dims[i];
 
-    /* END READ DATA. BEGIN INSERTION OF DATA */
+    levelName = malloc( strlen(datasetName) + strlen(OVERVIEW_SUFFIX) + 12 );
+    overviewList = calloc( numLevels, strlen(datasetName) + strlen(OVERVIEW_SUFFIX) + 12 );
+    if ( levelName == NULL || overviewList == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
 
-    /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
-     * that need to be resolved. Thus, we need to take the DimSizes array, which is
-     * of type int32 (an HDF4 type) and put it into an array of type hsize_t.
-     * A simple casting might work, but that is dangerous considering hsize_t and int32
-     * are not simply two different names for the same type. They are two different types.
-     */
-    hsize_t temp[DIM_MAX];
-    for ( int i = 0; i < DIM_MAX; i++ )
-        temp[i] = (hsize_t) dataDimSizes[i];
+    for ( int n = 0; n < numLevels && ( rows > 1 || cols > 1 ); n++ )
+    {
+        char* correctedName = NULL;
+        int factor = 2 << n;
+        float fill = fillMin;
 
+        rows = ( rows + 1 ) / 2;
+        cols = ( cols + 1 ) / 2;
+        level = malloc( outer * rows * cols * sizeof *level );
+        levelCount = malloc( outer * rows * cols * sizeof *levelCount );
+        if ( level == NULL || levelCount == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
+        }
+        downsampleMean( prev, prevCount, level, levelCount, outer, levelDims[rank - 2], levelDims[rank - 1],
+                        fillMin, fillMax );
+        levelDims[rank - 2] = rows;
+        levelDims[rank - 1] = cols;
+
+        sprintf( levelName, "%s%s%d", datasetName, OVERVIEW_SUFFIX, factor );
+        if ( use_chunk )
+            levelID = insertDataset_comp( ctx, &groupID, 1, rank, levelDims, H5T_NATIVE_FLOAT, levelName,
+                                          level, is_modis );
+        else
+            levelID = insertDataset( ctx, &groupID, 1, rank, levelDims, H5T_NATIVE_FLOAT, levelName, level );
+        if ( levelID == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to write the overview %s.\n", levelName);
+            levelID = -1;
+            goto cleanupFail;
+        }
 
-    outputDataType = H5T_NATIVE_FLOAT;
+        correctedName = correct_name( datasetName );
+        initAttrStage( ctx, &stage, levelID );
+        if ( correctedName == NULL ||
+             stageAttrString( &stage, "overview_of", correctedName ) == FATAL_ERR ||
+             stageAttr( &stage, "overview_factor", H5T_NATIVE_INT, 0, &factor ) == FATAL_ERR ||
+             stageAttr( &stage, "_FillValue", H5T_NATIVE_FLOAT, 0, &fill ) == FATAL_ERR ||
+             flushAttrStage( &stage ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to write the attributes of the overview %s.\n", levelName);
+            free(correctedName);
+            goto cleanupFail;
+        }
+        free(correctedName);
+        H5Dclose(levelID);
+        levelID = -1;
 
-    short use_chunk = 0;
+        correctedName = correct_name( levelName );
+        if ( correctedName == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
+        }
+        if ( n > 0 )
+            strcat( overviewList, " " );
+        strcat( overviewList, correctedName );
+        free(correctedName);
+        factors[n] = factor;
+
+        if ( prev != data )
+            free( (float*) prev );
+        free(prevCount);
+        prev = level;
+        prevCount = levelCount;
+        level = NULL;
+        levelCount = NULL;
+
+        /* Link the levels written so far, so the dataset attributes always match the file */
+        initAttrStage( ctx, &stage, datasetID );
+        if ( stageAttrString( &stage, "overviews", overviewList ) == FATAL_ERR ||
+             stageAttr( &stage, "overview_factors", H5T_NATIVE_INT, n + 1, factors ) == FATAL_ERR ||
+             flushAttrStage( &stage ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to link the overviews of %s.\n", datasetName);
+            goto cleanupFail;
+        }
+    }
 
-    /* If using chunk */
+    if ( 0 )
     {
-        const char *s;
-        s = getenv("USE_CHUNK");
-
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) == 1)
-                use_chunk = 1;
+cleanupFail:
+        fail = 1;
     }
 
-    if(use_chunk == 1)
-    {
-        datasetID = insertDataset_comp( &outputFile, &outputGroupID, 1, dataRank,
-                                        temp, outputDataType, newdatasetName, output_dataBuffer,0 );
-    }
-    else
-    {
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, newdatasetName, output_dataBuffer );
-    }
-
-    //datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank ,
-    //    temp, outputDataType, newdatasetName, output_dataBuffer );
-
-    if ( datasetID == FATAL_ERR )
-    {
-         FATAL_MSG("Error writing %s dataset.\n", datasetName );
-        if(newdatasetName) free(newdatasetName);
-        if( input_dataBuffer) free(input_dataBuffer);
-        if( output_dataBuffer) free(output_dataBuffer);
-        return (FATAL_ERR);
-    }
-
-    if ( retDatasetNamePtr )
-        *retDatasetNamePtr= correct_name(newdatasetName);
+    discardAttrStage( &stage );
+    if ( levelID >= 0 ) H5Dclose(levelID);
+    if ( prev != data )
+        free( (float*) prev );
+    free(prevCount);
+    free(level);
+    free(levelCount);
+    free(levelName);
+    free(overviewList);
 
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
+}
 
-    /*
-       tempFloat = -999.0;
-       if(H5LTset_attribute_float( datasetID, correctedName,"_FillValue",&tempFloat,1)<0) {
-            FATAL_MSG("Error writing %s dataset's fillvalue attributes.\n", datasetName );
-           if(newdatasetName) free(newdatasetName);
-           if( input_dataBuffer) free(input_dataBuffer);
-           if( output_dataBuffer) free(output_dataBuffer);
-           return (FATAL_ERR);
+/*
+                    finishUnpackTile
+    DESCRIPTION:
+        This function is called by the unpack loops of the ASTER and MISR radiances when they have
+        unpacked the last value of a statistics tile (see initDatasetStats). It rounds the tile to
+        keepBits mantissa bits (see bitRoundFloat) and adds it to the statistics (see accumulateStats)
+        while the tile is still in cache.
+    ARGUMENTS:
+        1. stats     -- The statistics of the dataset
+        2. data      -- The unpacked values of the whole dataset
+        3. tileEnd   -- The index after the last value of the tile
+        4. numElems  -- The number of values of the dataset
+        5. keepBits  -- The mantissa bits to keep, 0 to leave the values as they are
+        6. fillMin   -- The smallest fill value
+        7. fillMax   -- The largest fill value
+    EFFECTS:
+        Rounds the values of the tile and updates the statistics.
+    RETURN:
+        The index after the last value of the next tile
+*/
 
-       }
-    */
+static size_t finishUnpackTile( datasetStats_t* stats, float* data, size_t tileEnd, size_t numElems, int keepBits,
+                                float fillMin, float fillMax )
+{
+    size_t tileStart = ( tileEnd - 1 ) / stats->tileElems * stats->tileElems;
 
-    free(input_dataBuffer);
-    free(output_dataBuffer);
-    if(newdatasetName) free(newdatasetName);
+    if ( keepBits > 0 )
+        bitRoundFloat( data + tileStart, tileEnd - tileStart, keepBits, fillMin, fillMax );
+    accumulateStats( stats, data + tileStart, tileStart, tileEnd - tileStart );
 
-    return datasetID;
+    return tileEnd + stats->tileElems < numElems ? tileEnd + stats->tileElems : numElems;
 }
 
 /*
-                    readThenWrite_MODIS_Unpack
+                    readThenWrite_ASTER_Unpack
     DESCRIPTION:
-        This function is a specific readThenWrite function for MODIS. This function does the
+        This function is a specific readThenWrite function for ASTER. This function does the
         same thing as the general readThenWrite except it performs data unpacking. Essentially,
         unpacking the data means converting the radiance datasets from an integer type to
         a floating point type. Doing this greatly increases the size of the data however.
@@ -2082,6 +3196,7 @@ hid_t readThenWrite_MISR_Unpack( hid_t outputGroupID, char* cameraName,char* dat
                              input dataset. Please reference Section 3 of the HDF4
                              Reference Manual for a list of HDF types.
         4. inputFileID    -- The HDF4 input file identifier
+        5. unc            -- The uncertainty value for the unpacking
 
     EFFECTS:
         Reads the input file dataset and then writes to the HDF5 output file. Returns
@@ -2093,199 +3208,155 @@ hid_t readThenWrite_MISR_Unpack( hid_t outputGroupID, char* cameraName,char* dat
         Returns the dataset identifier if successful. Else returns FATAL_ERR upon
         any errors.
 */
-
-/* MY 2016-12-20 Unpack MODIS data */
-hid_t readThenWrite_MODIS_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
-                                  int32 inputFileID)
+/* MY 2016-12-20, routine to unpack ASTER data */
+hid_t readThenWrite_ASTER_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
+                                  int32 inputFileID,float unc )
 {
-
-    //unsigned short special_values_unpacked[] = {65535,65534,65533,65532,65531,65530,65529,65528,65527,65526,65525,65500};
-    //float special_values_packed[] = {-999.0,-998.0,-997.0,-996.0,-995.0,-994.0,-993.0,-992.0,-991.0,-990.0,-989.0,-988.0};
-    char* radi_scales="radiance_scales";
-    char* radi_offset="radiance_offsets";
     int32 dataRank = 0;
     int32 dataDimSizes[DIM_MAX] = {0};
-    unsigned short* input_dataBuffer = NULL;
+    unsigned short* tir_dataBuffer = NULL;
+    uint8_t* vsir_dataBuffer = NULL;
     float* output_dataBuffer = NULL;
+    size_t buffer_size = 1;
     hid_t datasetID = 0;
     hid_t outputDataType = 0;
-
-
-    unsigned short special_values_start = 65535;
-    unsigned short special_values_stop = 65500;
-
-    float special_values_packed_start = -999.0;
+    int keepBits = 0;
+    datasetStats_t stats;
 
     intn status = -1;
 
-    status = H4readData( inputFileID, datasetName,
-                         (void**)&input_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
-    if ( status < 0 )
+    if(unc < 0)
     {
-         FATAL_MSG("Unable to read %s data.\n",  datasetName );
-        if ( input_dataBuffer ) free(input_dataBuffer);
+         FATAL_MSG("There is no valid Unit Conversion Coefficient for this dataset  %s.\n",  datasetName );
         return (FATAL_ERR);
-    }
 
+    }
 
-    /* Data Unpack */
+    /* Scaled integers are the DNs themselves: radiance = (DN-1)*unc. DN 0 is the fill value, and the
+     * saturated DN (255 or 4095) lies outside valid_range. */
+    if ( ctx->unpack == UNPACK_SCALED )
     {
+        uint8_t vsirFill = 0;
+        uint8_t vsirRange[2] = { 1, 254 };
+        unsigned short tirFill = 0;
+        unsigned short tirRange[2] = { 1, 4094 };
+        int isVSIR = ( DFNT_UINT8 == inputDataType );
 
-        /* 1. Obtain radiance_scales and radiance_offsets. */
-        int32 sds_id = -1;
-        int32 sds_index = -1;
-        int32 radi_sc_index = -1;
-        int32 radi_off_index = -1;
-        int32 radi_sc_type = -1;
-        int32 radi_off_type = -1;
-        int32 num_radi_sc_values = -1;
-        int32 num_radi_off_values = -1;
-        char temp_attr_name[H4_MAX_NC_NAME];
-
-        float* radi_sc_values = NULL;
-        float* radi_off_values = NULL;;
-
-
-        /* get the index of the dataset from the dataset's name */
-        sds_index = SDnametoindex( inputFileID, datasetName );
-        if( sds_index < 0 )
-        {
-             FATAL_MSG("-- SDnametoindex -- Failed to get index of dataset.\n");
-            free(input_dataBuffer);
-            return FATAL_ERR;
-        }
-
-        sds_id = SDselect( inputFileID, sds_index );
-        if ( sds_id < 0 )
-        {
-             FATAL_MSG("SDselect -- Failed to get the ID of the dataset.\n");
-            free(input_dataBuffer);
-            return FATAL_ERR;
-        }
-
-        radi_sc_index = SDfindattr(sds_id,radi_scales);
-        if(radi_sc_index < 0)
+        if ( !isVSIR && DFNT_UINT16 != inputDataType )
         {
-             FATAL_MSG("Cannot find attribute %s of variable %s\n",radi_scales,datasetName);
-            SDendaccess(sds_id);
-            free(input_dataBuffer);
-            return FATAL_ERR;
+             FATAL_MSG("Unsupported datatype. Datatype must be either DFNT_UINT16 or DFNT_UINT8.\n" );
+            return (FATAL_ERR);
         }
 
-        if(SDattrinfo (sds_id, radi_sc_index, temp_attr_name, &radi_sc_type, &num_radi_sc_values)<0)
+        datasetID = readThenWrite( ctx, NULL, outputGroupID, datasetName, inputDataType,
+                                   isVSIR ? H5T_NATIVE_UCHAR : H5T_NATIVE_USHORT, inputFileID, 1 );
+        if ( datasetID == FATAL_ERR )
         {
-             FATAL_MSG("Cannot obtain SDS attribute %s of variable %s\n",radi_scales,datasetName);
-            SDendaccess(sds_id);
-            free(input_dataBuffer);
-            return FATAL_ERR;
+             FATAL_MSG("Error writing %s dataset.\n", datasetName );
+            return (FATAL_ERR);
         }
 
-        radi_off_index = SDfindattr(sds_id,radi_offset);
-        if(radi_off_index < 0)
+        if ( ( isVSIR ? setScaledAttrs( ctx, datasetID, H5T_NATIVE_UCHAR, &vsirFill, vsirRange, unc, -unc )
+                      : setScaledAttrs( ctx, datasetID, H5T_NATIVE_USHORT, &tirFill, tirRange, unc, -unc ) ) == FATAL_ERR )
         {
-             FATAL_MSG("Cannot find attribute %s of variable %s\n",radi_offset,datasetName);
-            SDendaccess(sds_id);
-            free(input_dataBuffer);
-            return FATAL_ERR;
+            H5Dclose(datasetID);
+            return (FATAL_ERR);
         }
+        return datasetID;
+    }
 
+    if(DFNT_UINT8 == inputDataType)
+    {
+        status = H4readData( inputFileID, datasetName,
+                             (void**)&vsir_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
+    }
+    else if(DFNT_UINT16 == inputDataType)
+    {
+        status = H4readData( inputFileID, datasetName,
+                             (void**)&tir_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
 
-        if(SDattrinfo (sds_id, radi_off_index, temp_attr_name, &radi_off_type, &num_radi_off_values)<0)
-        {
-             FATAL_MSG("Cannot obtain SDS attribute %s of variable %s\n",radi_offset,datasetName);
-            SDendaccess(sds_id);
-            free(input_dataBuffer);
-            return FATAL_ERR;
-        }
+    }
+    else
+    {
+         FATAL_MSG("Unsupported datatype. Datatype must be either DFNT_UINT16 or DFNT_UINT8.\n" );
+        return (FATAL_ERR);
+    }
 
-        if(radi_sc_type != DFNT_FLOAT32 || radi_sc_type != radi_off_type || num_radi_sc_values != num_radi_off_values)
-        {
-             FATAL_MSG("Error: ");
-            fprintf(stderr, "Either the scale/offset datatype is not 32-bit floating-point type\n\tor there is inconsistency between scale and offset datatype or number of values\n");
-            fprintf(stderr, "\tThis is for the variable %s\n",datasetName);
-            SDendaccess(sds_id);
-            free(input_dataBuffer);
-            return FATAL_ERR;
-        }
 
+    if ( status == FATAL_ERR )
+    {
+         FATAL_MSG("Unable to read %s data.\n",  datasetName );
+        if ( vsir_dataBuffer != NULL ) free(vsir_dataBuffer);
+        if ( tir_dataBuffer != NULL ) free(tir_dataBuffer);
+        return (FATAL_ERR);
+    }
 
-        radi_sc_values = calloc((size_t)num_radi_sc_values,sizeof radi_sc_values);
-        radi_off_values= calloc((size_t)num_radi_off_values,sizeof radi_off_values);
+    {
+        float* temp_float_pointer = NULL;
+        uint8_t* temp_uint8_pointer = vsir_dataBuffer;
+        unsigned short* temp_uint16_pointer = tir_dataBuffer;
+        size_t tile_end = 0;
+        /* Now we need to unpack the data */
+        for(int i = 0; i <dataRank; i++)
+            buffer_size *=dataDimSizes[i];
 
-        if(SDreadattr(sds_id,radi_sc_index,radi_sc_values) <0)
-        {
-             FATAL_MSG("Cannot obtain SDS attribute value %s of variable %s\n",radi_scales,datasetName);
-            free(radi_sc_values);
-            free(radi_off_values);
-            SDendaccess(sds_id);
-            free(input_dataBuffer);
-            return FATAL_ERR;
-        }
+        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
 
+        temp_float_pointer = output_dataBuffer;
 
-        if(SDreadattr(sds_id,radi_off_index,radi_off_values) <0)
+        /* BF_KEEP_BITS drops the mantissa bits that the packed data never had */
+        keepBits = getKeepBits( ctx, datasetName );
+        if ( output_dataBuffer == NULL || keepBits == FATAL_ERR ||
+             initDatasetStats( ctx, &stats, dataRank, dataDimSizes, -999.0, -998.0, 0.0,
+                               ( DFNT_UINT8 == inputDataType ? 253 : 4093 ) * unc ) == FATAL_ERR )
         {
-             FATAL_MSG("Cannot obtain SDS attribute value %s of variable %s\n",radi_scales,datasetName);
-            free(radi_sc_values);
-            free(radi_off_values);
-            SDendaccess(sds_id);
-            free(input_dataBuffer);
-            return FATAL_ERR;
+            if ( vsir_dataBuffer != NULL ) free(vsir_dataBuffer);
+            if ( tir_dataBuffer != NULL ) free(tir_dataBuffer);
+            free(output_dataBuffer);
+            return (FATAL_ERR);
         }
 
-        SDendaccess(sds_id);
-
-
-        float* temp_float_pointer = NULL;
-        unsigned short* temp_uint16_pointer = input_dataBuffer;
-        size_t buffer_size = 1;
-        size_t band_buffer_size = 1;
-        int num_bands = dataDimSizes[0];
+        /* Each tile is rounded and added to the statistics right after it is unpacked, while it is in cache */
+        tile_end = stats.tileElems < buffer_size ? stats.tileElems : buffer_size;
 
-        if(num_bands != num_radi_off_values)
+        if(DFNT_UINT8 == inputDataType)
         {
-             FATAL_MSG("Error: Number of band (the first dimension size) of the variable %s\n\tis not the same as the number of scale/offset values\n",datasetName);
-            free(radi_sc_values);
-            free(radi_off_values);
-            free(input_dataBuffer);
-            return FATAL_ERR;
+            for(int i = 0; i<buffer_size; i++)
+            {
+                if(*temp_uint8_pointer == 0)
+                    *temp_float_pointer = -999;
+                else if(*temp_uint8_pointer == 1)
+                    *temp_float_pointer = 0;
+                else if(*temp_uint8_pointer == 255)// Now make no data differentiate from saturated data
+                    *temp_float_pointer = -998;
+                else
+                    *temp_float_pointer = (float)((*temp_uint8_pointer -1))*unc;
+                temp_float_pointer++;
+                temp_uint8_pointer++;
+                if ( i + 1 == tile_end )
+                    tile_end = finishUnpackTile( &stats, output_dataBuffer, tile_end, buffer_size, keepBits, -999.0, -998.0 );
+            }
         }
-
-        assert(dataRank>1);
-        for(int i = 1; i <dataRank; i++)
-            band_buffer_size *=dataDimSizes[i];
-
-        buffer_size = band_buffer_size*num_bands;
-
-        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
-
-        temp_float_pointer = output_dataBuffer;
-
-
-        for(int i = 0; i<num_bands; i++)
+        else if(DFNT_UINT16 == inputDataType)
         {
-            float temp_scale_offset = radi_sc_values[i]*radi_off_values[i];
-            for(int j = 0; j<band_buffer_size; j++)
+            for(int i = 0; i<buffer_size; i++)
             {
-                /* Check special values  , here I may need to make it a little clear.*/
-                if(((*temp_uint16_pointer)<=special_values_start) && ((*temp_uint16_pointer)>=special_values_stop))
-                    *temp_float_pointer = special_values_packed_start +(special_values_start-(*temp_uint16_pointer));
+                if(*temp_uint16_pointer == 0)
+                    *temp_float_pointer = -999;
+                else if(*temp_uint16_pointer == 1)
+                    *temp_float_pointer = 0;
+                else if(*temp_uint16_pointer == 4095)// Now make no data differentiate from saturated data
+                    *temp_float_pointer = -998;
                 else
-                {
-                    *temp_float_pointer = radi_sc_values[i]*(*temp_uint16_pointer) - temp_scale_offset;
-                }
-                temp_uint16_pointer++;
+                    *temp_float_pointer = (float)((*temp_uint16_pointer-1))*unc;
                 temp_float_pointer++;
+                temp_uint16_pointer++;
+                if ( i + 1 == tile_end )
+                    tile_end = finishUnpackTile( &stats, output_dataBuffer, tile_end, buffer_size, keepBits, -999.0, -998.0 );
+
             }
         }
-        free(radi_sc_values);
-        free(radi_off_values);
-
-
-
     }
-
-
     /* END READ DATA. BEGIN INSERTION OF DATA */
 
     /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
@@ -2300,240 +3371,392 @@ hid_t readThenWrite_MODIS_Unpack( hid_t outputGroupID, char* datasetName, int32
 
     outputDataType = H5T_NATIVE_FLOAT;
 
-//#if 0
-    short use_chunk = 0;
-
-    /* If using chunk */
-    {
-        const char *s;
-        s = getenv("USE_CHUNK");
-
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) == 1)
-                use_chunk = 1;
-    }
+    short use_chunk = ctx->useChunk;
 
     if(use_chunk == 1)
     {
-        datasetID = insertDataset_comp( &outputFile, &outputGroupID, 1, dataRank,
-                                        temp, outputDataType, datasetName, output_dataBuffer,1 );
+        datasetID = insertDataset_comp_tiled( ctx, &outputGroupID, 1, dataRank, temp, outputDataType, datasetName,
+                                              output_dataBuffer, keepBits > 0, &stats );
     }
     else
     {
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
                                    temp, outputDataType, datasetName, output_dataBuffer );
     }
-//#endif
 
 
-#if 0
-    datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                               temp, outputDataType, datasetName, output_dataBuffer );
-#endif
-
     if ( datasetID == FATAL_ERR )
     {
          FATAL_MSG("Error writing %s dataset.\n", datasetName );
-        free(input_dataBuffer);
-        free(output_dataBuffer);
+        if ( vsir_dataBuffer != NULL ) free(vsir_dataBuffer);
+        if ( tir_dataBuffer != NULL ) free(tir_dataBuffer);
+        if ( output_dataBuffer != NULL ) free(output_dataBuffer);
+        freeDatasetStats( &stats );
         return (FATAL_ERR);
     }
 
+    if ( vsir_dataBuffer != NULL ) free(vsir_dataBuffer);
+    if ( tir_dataBuffer != NULL ) free(tir_dataBuffer);
 
-    free(input_dataBuffer);
-    free(output_dataBuffer);
-
-
+    if ( ( keepBits > 0 && setKeepBitsAttr( datasetID, keepBits ) == FATAL_ERR ) ||
+         writeDatasetStats( ctx, &stats, outputGroupID, datasetID, datasetName ) == FATAL_ERR ||
+         writeOverviews( ctx, outputGroupID, datasetID, datasetName, output_dataBuffer, dataRank, dataDimSizes,
+                         -999.0f, -998.0f, 0, use_chunk ) == FATAL_ERR )
+    {
+        if ( output_dataBuffer != NULL ) free(output_dataBuffer);
+        freeDatasetStats( &stats );
+        H5Dclose(datasetID);
+        return (FATAL_ERR);
+    }
+    if ( output_dataBuffer != NULL ) free(output_dataBuffer);
+    freeDatasetStats( &stats );
     return datasetID;
 }
 
-/* Unpack MODIS uncertainty */
-hid_t readThenWrite_MODIS_Uncert_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
-        int32 inputFileID)
-{
+/*
+                    readThenWrite_MISR_Unpack
+    DESCRIPTION:
+        This function is a specific readThenWrite function for MISR. This function does the
+        same thing as the general readThenWrite except it performs data unpacking. Essentially,
+        unpacking the data means converting the radiance datasets from an integer type to
+        a floating point type. Doing this greatly increases the size of the data however.
+        On an abstracted level, this is what unpacking looks like:
 
-    char* scaling_factor="scaling_factor";
-    char* specified_uncert="specified_uncertainty";
+        unpackedElement = scale * packedElement + offset
+
+        The packedElement is an integer type, and the unpackedElement is a single precision
+        float type.
+
+    ARGUMENTS:
+        1. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
+                             be written. Can either be an actual group ID or can be the
+                             file ID (in the latter case, data will be written to the root
+                             directory).
+        2. datasetName    -- A string containing the name of the dataset in the input HDF4
+                             file. The output dataset will have the same name.
+        3. retDatasetName -- The actual output dataset name. The output name cannot be
+                             guaranteed to be the same as the input name (argument datasetName).
+                             Function will modify the char* pointed to by this argument to point
+                             to the output dataset name.
+
+                             CALLER MUST FREE THIS VARIABLE!!!! It is allocated by malloc!
+
+        4. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
+                             input dataset. Please reference Section 3 of the HDF4
+                             Reference Manual for a list of HDF types.
+        5. inputFileID    -- The HDF4 input file identifier
+        6. scale_factor   -- Value of "scale" in the unpacking equation
+
+    EFFECTS:
+        Reads the input file dataset and then writes to the HDF5 output file. Returns
+        a dataset identifier for the new dataset created in the output file. It is the
+        responsibility of the caller to close the dataset ID when finished using
+        H5Dclose().
+
+    RETURN:
+        Returns the dataset identifier if successful. Else returns FATAL_ERR upon
+        any errors.
+*/
+/* MY-2016-12-20 Routine to unpack MISR data */
+hid_t readThenWrite_MISR_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* cameraName,char* datasetName, char** retDatasetNamePtr,int32 inputDataType,
+                                 int32 inputFileID,float scale_factor,unsigned short * has_LAI_DIM1_ptr )
+{
     int32 dataRank = 0;
     int32 dataDimSizes[DIM_MAX] = {0};
-    uint8_t* input_dataBuffer = NULL;
-    float* output_dataBuffer = NULL;
+    unsigned short* input_dataBuffer = NULL;
+    float * output_dataBuffer = NULL;
     hid_t datasetID = 0;
     hid_t outputDataType = 0;
+    intn status = 0;
+    char* newdatasetName = NULL;
+    int keepBits = 0;
+    datasetStats_t stats = { 0 };
+    int scaled = ( ctx->unpack == UNPACK_SCALED );
+    unsigned short scaledFill = MISR_SCALED_FILL;
+    unsigned short scaledRange[2] = { 0, 16383 };
 
-    //Ideally the following 3 values should be retrieved from SDS APIs
-    uint8_t fvalue = 255;
-    uint8_t valid_min= 0;
-    uint8_t valid_max = 15;
-    float fvalue_packed = -999.0;
-
-    intn status = -1;
-
+    if(scale_factor < 0)
+    {
+         FATAL_MSG("The scale_factor of %s is less than 0.\n",  datasetName );
+        return (FATAL_ERR);
 
+    }
+//printf("cameraName is %s\n",cameraName);
     status = H4readData( inputFileID, datasetName,
-                         (void**)&input_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
+                         (void**)&input_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL);
     if ( status < 0 )
     {
          FATAL_MSG("Unable to read %s data.\n",  datasetName );
-        if( input_dataBuffer ) free(input_dataBuffer);
+        if ( input_dataBuffer != NULL ) free(input_dataBuffer);
         return (FATAL_ERR);
     }
 
+    /* Before unpacking the data, we want to re-arrange the name */
+    char* RDQIName = "/RDQI";
+    char* temp_sub_dsetname = strstr(datasetName,RDQIName);
 
-    /* Data Unpack */
-    {
 
-        /* 1. Obtain scaling_factor and specified uncertainty . */
-        int32 sds_id = -1;
-        int32 sds_index = -1;
-        int32 sc_index = -1;
-        int32 uncert_index = -1;
-        int32 sc_type = -1;
-        int32 uncert_type = -1;
-        int32 num_sc_values = -1;
-        int32 num_uncert_values = -1;
-        char temp_attr_name[H4_MAX_NC_NAME];
-        float* sc_values = NULL;
-        float* uncert_values = NULL;;
+    if(temp_sub_dsetname!=NULL && strncmp(RDQIName,temp_sub_dsetname,strlen(temp_sub_dsetname)) == 0)
+    {
+        newdatasetName = malloc( strlen(datasetName) - strlen(RDQIName) + 1 );
+        memset(newdatasetName,'\0',strlen(datasetName)-strlen(RDQIName)+1);
 
+        strncpy(newdatasetName,datasetName,strlen(datasetName)-strlen(RDQIName));
+    }
+    else  // We will fail here.
+    {
+         FATAL_MSG("Error: The dataset name doesn't end with /RDQI\n");
+        return FATAL_ERR;
+    }
 
-        /* get the index of the dataset from the dataset's name */
-        sds_index = SDnametoindex( inputFileID, datasetName );
-        if( sds_index < 0 )
-        {
-             FATAL_MSG("SDnametoindex -- Failed to get index of dataset.\n");
-            free(input_dataBuffer);
-            return FATAL_ERR;
-        }
 
-        sds_id = SDselect( inputFileID, sds_index );
-        if ( sds_id < 0 )
-        {
-             FATAL_MSG("SDselect -- Failed to get ID of dataset.\n");
-            free(input_dataBuffer);
-            return FATAL_ERR;
-        }
 
-        sc_index = SDfindattr(sds_id,scaling_factor);
-        if(sc_index < 0)
-        {
-             FATAL_MSG("SDfindattr -- Cannot find attribute %s of variable %s\n",scaling_factor,datasetName);
-            free(input_dataBuffer);
-            SDendaccess(sds_id);
-            return FATAL_ERR;
-        }
+    /* Data Unpack */
+    {
 
-        if(SDattrinfo (sds_id, sc_index, temp_attr_name, &sc_type, &num_sc_values)<0)
-        {
-             FATAL_MSG("SDattrinfo -- Cannot obtain SDS attribute %s of variable %s\n",scaling_factor,datasetName);
-            free(input_dataBuffer);
-            SDendaccess(sds_id);
-            return FATAL_ERR;
-        }
+        float* temp_float_pointer = NULL;
+        unsigned short* temp_uint16_pointer = input_dataBuffer;
+        unsigned short* temp_uint16_pointer_mask = input_dataBuffer;
+        unsigned short temp_cklq_input_val = 0;
+        size_t buffer_size = 1;
+        size_t tile_end = 0;
+        unsigned short  rdqi = 0;
+        unsigned short  rdqi_mask = 3;
+        size_t num_la_data = 0;
 
-        uncert_index = SDfindattr(sds_id,specified_uncert);
-        if(uncert_index < 0)
-        {
-             FATAL_MSG("SDfindattr -- Cannot find attribute %s of variable %s\n",specified_uncert,datasetName);
-            free(input_dataBuffer);
-            SDendaccess(sds_id);
-            return FATAL_ERR;
-        }
 
+        for(int i = 0; i <dataRank; i++)
+            buffer_size *=dataDimSizes[i];
 
-        if(SDattrinfo (sds_id, uncert_index, temp_attr_name, &uncert_type, &num_uncert_values)<0)
-        {
-             FATAL_MSG("SDattrinfo -- Cannot obtain attribute %s of variable %s\n",specified_uncert,datasetName);
-            free(input_dataBuffer);
-            SDendaccess(sds_id);
-            return FATAL_ERR;
-        }
 
-        if(sc_type != DFNT_FLOAT32 || num_sc_values != num_uncert_values)
+        for(int i = 0; i<buffer_size; i++)
         {
-             FATAL_MSG("Error: Either the scale datatype is not 32-bit floating-point type or there is \n\tinconsistency of number of values between scale and specified uncertainty.\n");
-            fprintf(stderr, "\tThis is for the variable %s\n",datasetName);
-            free(input_dataBuffer);
-            SDendaccess(sds_id);
-            return FATAL_ERR;
+            rdqi = (*temp_uint16_pointer_mask)&rdqi_mask;
+            if(rdqi == 1){
+                temp_cklq_input_val = (*temp_uint16_pointer_mask)>>2;
+                if(temp_cklq_input_val != 16378 && temp_cklq_input_val != 16380) 
+                    num_la_data++;
+            }
+            temp_uint16_pointer_mask++;
         }
 
-
-        sc_values = calloc((size_t)num_sc_values,sizeof sc_values);
-        uncert_values= calloc((size_t)num_uncert_values,sizeof uncert_values);
-
-        if(SDreadattr(sds_id,sc_index,sc_values) <0)
+#if 0
+        if(num_la_data>0)
         {
-             FATAL_MSG("SDreadattr -- Cannot obtain SDS attribute value %s of variable %s\n",scaling_factor,datasetName);
-            free(input_dataBuffer);
-            SDendaccess(sds_id);
-            free(sc_values);
-            free(uncert_values);
-            return FATAL_ERR;
+            has_la_data = 1;
+            la_data_pos = calloc(sizeof la_data_pos*num_la_data,dankRank);
+            temp_la_data_pos_pointer = la_data_pos;
         }
-
-        if(SDreadattr(sds_id,uncert_index,uncert_values) <0)
+#endif
+        /* Need to obtain low frequency indexes */
+        if(num_la_data >0)
         {
-             FATAL_MSG("SDattrinfo -- Cannot obtain SDS attribute value %s of variable %s\n",specified_uncert,datasetName);
-            free(input_dataBuffer);
-            SDendaccess(sds_id);
-            free(sc_values);
-            free(uncert_values);
-            return FATAL_ERR;
-        }
-
-        SDendaccess(sds_id);
 
+            unsigned short*temp_ck_uint16_pointer = input_dataBuffer;
+            if(dataRank != 3) {
+                FATAL_MSG("Error MISR radiance  %s dataset should be 3-D array.\n", datasetName );
+                if(newdatasetName) free(newdatasetName);
+                if( input_dataBuffer) free(input_dataBuffer);
+                return (FATAL_ERR);
+            } 
 
-        float* temp_float_pointer = NULL;
-        uint8_t* temp_uint8_pointer = input_dataBuffer;
-        size_t buffer_size = 1;
-        size_t band_buffer_size = 1;
-        int num_bands = dataDimSizes[0];
+            //unsigned int la_data_pos[num_la_data][3] ;
+            //unsigned int* la_data_pos =(unsigned int*)malloc(sizeof(unsigned int) *num_la_data*3) ;
+            unsigned short* la_data_pos =(unsigned short*)malloc(sizeof(unsigned short) *num_la_data*3) ;
+            //unsigned int* temp_la_data_pos = la_data_pos;
+            unsigned short* temp_la_data_pos = la_data_pos;
 
-        if(num_bands != num_uncert_values)
-        {
-             FATAL_MSG("Error: Number of band (the first dimension size) of the variable %s is not\n\tthe same as the number of scale/offset values\n",datasetName);
-            free(input_dataBuffer);
-            free(sc_values);
-            free(uncert_values);
-            return FATAL_ERR;
-        }
+            /* obtain the low accuracy tindex */
+            /* We know the index is within the unsigned short range. This can reduce some space. */
+            unsigned int ck_count = 0;
+            for(unsigned short i =0; i <dataDimSizes[0];i++) {
+                for (unsigned short j =0;j<dataDimSizes[1];j++) {
+                    for (unsigned short k=0;k<dataDimSizes[2];k++) {
+                        rdqi = (*temp_ck_uint16_pointer)&rdqi_mask;
+                        if(rdqi == 1){
+                    
+                            temp_cklq_input_val = (*temp_ck_uint16_pointer)>>2;
+                            if(temp_cklq_input_val != 16378 && temp_cklq_input_val != 16380) {
+                                /* Remember the index */ 
+                                /* The toolkit generates block number. So the first one may be i+1.*/
+#if 0
+                                la_data_pos[ck_count][0] = i+1;
+                                la_data_pos[ck_count][1] = j;
+                                la_data_pos[ck_count][2] = k;
+#endif
+                                *temp_la_data_pos = i+1;
+                                temp_la_data_pos++;
+                                *temp_la_data_pos = j;
+                                temp_la_data_pos++;
+                                *temp_la_data_pos = k;
+                                temp_la_data_pos++;
+                                ck_count++;
+                            }
+                        }
+                        temp_ck_uint16_pointer++;
+                    }
+                }
+            }
 
-        assert(dataRank>1);
-        for(int i = 1; i <dataRank; i++)
-            band_buffer_size *=dataDimSizes[i];
+            if(ck_count != num_la_data) {
+                FATAL_MSG("Error MISR radiance  %s dataset low accuracy index is wrong.\n", datasetName );
+                if(newdatasetName) free(newdatasetName);
+                if( input_dataBuffer) free(input_dataBuffer);
+                return (FATAL_ERR);
+            } 
 
-        buffer_size = band_buffer_size*num_bands;
+            hid_t la_pos_dsetid =0 ;
+            int la_pos_dset_rank = 2;
+            hsize_t la_pos_dset_dims[2];
+            la_pos_dset_dims[0]= num_la_data;
+            la_pos_dset_dims[1]= 3;
+            char* la_pos_dset_name_suffix="_low_accuracy_index";
+            size_t la_pos_dset_name_len = strlen(la_pos_dset_name_suffix)+strlen(newdatasetName)+1;
+            char* la_pos_dset_name=malloc(la_pos_dset_name_len);
+            la_pos_dset_name[la_pos_dset_name_len-1]='\0';
+            strcpy(la_pos_dset_name,newdatasetName);
+            strcat(la_pos_dset_name,la_pos_dset_name_suffix);
 
-        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
+            /* Create a dataset to remember the postion of low accuracy data */
+            la_pos_dsetid = insertDataset_comp( ctx, &outputGroupID, 1, la_pos_dset_rank,
+                                           la_pos_dset_dims, H5T_NATIVE_USHORT, la_pos_dset_name, la_data_pos,0 );
+                                           //la_pos_dset_dims, H5T_NATIVE_UINT, la_pos_dset_name, la_data_pos );
+
+            if ( la_pos_dsetid == FATAL_ERR )
+            {
+                 FATAL_MSG("Error writing %s dataset.\n", newdatasetName );
+                if(la_pos_dset_name)
+                    free(la_pos_dset_name);
+                if(newdatasetName) free(newdatasetName);
+                if( input_dataBuffer) free(input_dataBuffer);
+                H5Dclose(la_pos_dsetid);
+                return (FATAL_ERR);
+            }
+            if(la_pos_dset_name)
+                free(la_pos_dset_name);
+            free(la_data_pos);
+ 
+            // Need to create/attach dimensions
+            // First the fixed 3-element dimension
+            char* lai_dim1="/MISR_LA_POS_DIM";
+            if(*has_LAI_DIM1_ptr == 0) {
+                hid_t lai_dim1_id = 0;
+                hsize_t lai_dim1_size = la_pos_dset_dims[1];
+                hid_t lai_dspace = H5Screate_simple(1,&lai_dim1_size,NULL);
+                if(makePureDim(ctx,ctx->outputFile,lai_dim1,lai_dspace,H5T_NATIVE_INT,&lai_dim1_id)!=RET_SUCCESS) {
+                    FATAL_MSG("Error creating MISR Low accuracy position dimenson.  \n");
+                    H5Sclose(lai_dspace);
+                    H5Dclose(la_pos_dsetid);
+                    if(newdatasetName) free(newdatasetName);
+                    if( input_dataBuffer) free(input_dataBuffer);
+                    return (FATAL_ERR);
+                }
+                H5Sclose(lai_dspace);
+                H5Dclose(lai_dim1_id);
+                *has_LAI_DIM1_ptr = 1;
+            }
+
+            if(attachDimension(ctx,ctx->outputFile,lai_dim1,la_pos_dsetid,1)!=RET_SUCCESS) {
+                FATAL_MSG("Error creating MISR Low accuracy position dimenson.  \n");
+                if(newdatasetName) free(newdatasetName);
+                if( input_dataBuffer) free(input_dataBuffer);
+                H5Dclose(la_pos_dsetid);
+            }
+            // Need to create the dimension name for LA index dimension.
+            // Name will be /MISR_AN_RR_LA_INX_DIM
+            char* lai_dim0_temp="/MISR_AN_RR_LA_INX_DIM";
+            char * lai_dim0=malloc(strlen(lai_dim0_temp)+1);
+            strcpy(lai_dim0,"/MISR_");
+            strcat(lai_dim0,cameraName);
+            strcat(lai_dim0,"_");
+            char*RadName_short=malloc(3);
+            RadName_short[0] = newdatasetName[0];
+            RadName_short[1] = 'R';
+            RadName_short[2]='\0';
+            
+            strcat(lai_dim0,RadName_short);
+            free(RadName_short);
+            strcat(lai_dim0,"_LA_INX_DIM");
+            hsize_t lai_dim0_size = la_pos_dset_dims[0];
+            hid_t lai_dim0_id = 0;
+            hid_t lai_dspace0 = H5Screate_simple(1,&lai_dim0_size,NULL);
+            if(makePureDim(ctx,ctx->outputFile,lai_dim0,lai_dspace0,H5T_NATIVE_INT,&lai_dim0_id)!=RET_SUCCESS) {
+                FATAL_MSG("Error creating MISR Low accuracy index dimenson.  \n");
+                H5Sclose(lai_dspace0);
+                H5Dclose(la_pos_dsetid);
+                if(newdatasetName) free(newdatasetName);
+                if( input_dataBuffer) free(input_dataBuffer);
+                return (FATAL_ERR);
+            }
+            H5Sclose(lai_dspace0);
+            H5Dclose(lai_dim0_id);
+            if(attachDimension(ctx,ctx->outputFile,lai_dim0,la_pos_dsetid,0)!=RET_SUCCESS) {
+                FATAL_MSG("Error creating MISR Low accuracy dimenson 1.  \n");
+                if(newdatasetName) free(newdatasetName);
+                if( input_dataBuffer) free(input_dataBuffer);
+                H5Dclose(la_pos_dsetid);
+            }
+            free(lai_dim0);
+            H5Dclose(la_pos_dsetid);
+            // { } may add an attribute to the group later.
+        }
+
+        unsigned short temp_input_val;
+
+        /* Scaled integers: the DN without its RDQI bits, in place. radiance = DN*scale_factor. */
+        if ( scaled )
+        {
+            for(int i = 0; i<buffer_size; i++)
+            {
+                rdqi = (*temp_uint16_pointer)&rdqi_mask;
+                temp_input_val = (*temp_uint16_pointer)>>2;
+                if(rdqi == 2 || rdqi == 3 || temp_input_val == 16378 || temp_input_val == 16380)
+                    *temp_uint16_pointer = MISR_SCALED_FILL;
+                else
+                    *temp_uint16_pointer = temp_input_val;
+                temp_uint16_pointer++;
+            }
+        }
 
+        output_dataBuffer = scaled ? NULL : malloc(sizeof output_dataBuffer *buffer_size);
         temp_float_pointer = output_dataBuffer;
 
+        /* BF_KEEP_BITS drops the mantissa bits that the packed data never had */
+        keepBits = scaled ? 0 : getKeepBits( ctx, datasetName );
+        if ( keepBits == FATAL_ERR ||
+             ( !scaled && initDatasetStats( ctx, &stats, dataRank, dataDimSizes, -999.0, -999.0, 0.0,
+                                            16377 * scale_factor ) == FATAL_ERR ) )
+        {
+            if(newdatasetName) free(newdatasetName);
+            free(input_dataBuffer);
+            free(output_dataBuffer);
+            return (FATAL_ERR);
+        }
 
-        for(int i = 0; i<num_bands; i++)
+        /* Unpacking the data, both reduced accuracy and within specifications. RDQI=0 and RDQI=1.
+         * Each tile is rounded and added to the statistics right after it is unpacked, while it is in cache. */
+        if ( !scaled )
         {
-            for(int j = 0; j<band_buffer_size; j++)
+            tile_end = stats.tileElems < buffer_size ? stats.tileElems : buffer_size;
+            for(int i = 0; i<buffer_size; i++)
             {
-                /* Check special values  , here I may need to make it a little clear.*/
-                if((*temp_uint8_pointer)== fvalue)
-                    *temp_float_pointer = fvalue_packed;
-                else if(((*temp_uint8_pointer)<valid_min) && ((*temp_uint8_pointer)>valid_max))
-                {
-                    /* currently set any invalid value to fill values */
-                    *temp_float_pointer = fvalue_packed;
-                }
+                rdqi = (*temp_uint16_pointer)&rdqi_mask;
+                if(rdqi == 2 || rdqi == 3)
+                    *temp_float_pointer = -999.0;
                 else
                 {
-                    *temp_float_pointer = uncert_values[i]*exp((*temp_uint8_pointer)/sc_values[i]);
+                    temp_input_val = (*temp_uint16_pointer)>>2;
+                    if(temp_input_val == 16378 || temp_input_val == 16380)
+                        *temp_float_pointer = -999.0;
+                    else
+                        *temp_float_pointer = scale_factor*((float)temp_input_val);
                 }
-                temp_uint8_pointer++;
+                temp_uint16_pointer++;
                 temp_float_pointer++;
+                if ( i + 1 == tile_end )
+                    tile_end = finishUnpackTile( &stats, output_dataBuffer, tile_end, buffer_size, keepBits, -999.0, -999.0 );
             }
         }
-        free(sc_values);
-        free(uncert_values);
-
     }
 
 
@@ -2549,51 +3772,76 @@ hid_t readThenWrite_MODIS_Uncert_Unpack( hid_t outputGroupID, char* datasetName,
     for ( int i = 0; i < DIM_MAX; i++ )
         temp[i] = (hsize_t) dataDimSizes[i];
 
-    outputDataType = H5T_NATIVE_FLOAT;
-    short use_chunk = 0;
 
-    /* If using chunk */
-    {
-        const char *s;
-        s = getenv("USE_CHUNK");
+    outputDataType = scaled ? H5T_NATIVE_USHORT : H5T_NATIVE_FLOAT;
+    void* write_dataBuffer = scaled ? (void*) input_dataBuffer : (void*) output_dataBuffer;
 
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) == 1)
-                use_chunk = 1;
-    }
+    short use_chunk = ctx->useChunk;
 
     if(use_chunk == 1)
     {
-        datasetID = insertDataset_comp( &outputFile, &outputGroupID, 1, dataRank,
-                                        temp, outputDataType, datasetName, output_dataBuffer,1);
+        datasetID = insertDataset_comp_tiled( ctx, &outputGroupID, 1, dataRank, temp, outputDataType, newdatasetName,
+                                              write_dataBuffer, keepBits > 0, &stats );
     }
     else
     {
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, datasetName, output_dataBuffer );
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, newdatasetName, write_dataBuffer );
     }
 
-
     //datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank ,
-    //     temp, outputDataType, datasetName, output_dataBuffer );
+    //    temp, outputDataType, newdatasetName, output_dataBuffer );
 
     if ( datasetID == FATAL_ERR )
     {
          FATAL_MSG("Error writing %s dataset.\n", datasetName );
+        if(newdatasetName) free(newdatasetName);
+        if( input_dataBuffer) free(input_dataBuffer);
+        if( output_dataBuffer) free(output_dataBuffer);
+        freeDatasetStats( &stats );
+        return (FATAL_ERR);
+    }
+
+    if ( ( keepBits > 0 && setKeepBitsAttr( datasetID, keepBits ) == FATAL_ERR ) ||
+         ( scaled && setScaledAttrs( ctx, datasetID, H5T_NATIVE_USHORT, &scaledFill, scaledRange, scale_factor, 0.0f ) == FATAL_ERR ) ||
+         writeDatasetStats( ctx, &stats, outputGroupID, datasetID, newdatasetName ) == FATAL_ERR ||
+         ( !scaled && writeOverviews( ctx, outputGroupID, datasetID, newdatasetName, output_dataBuffer, dataRank,
+                                      dataDimSizes, -999.0f, -999.0f, 0, use_chunk ) == FATAL_ERR ) )
+    {
+        if(newdatasetName) free(newdatasetName);
         free(input_dataBuffer);
         free(output_dataBuffer);
+        freeDatasetStats( &stats );
+        H5Dclose(datasetID);
         return (FATAL_ERR);
     }
+    freeDatasetStats( &stats );
+
+    if ( retDatasetNamePtr )
+        *retDatasetNamePtr= correct_name(newdatasetName);
+
+
+    /*
+       tempFloat = -999.0;
+       if(H5LTset_attribute_float( datasetID, correctedName,"_FillValue",&tempFloat,1)<0) {
+            FATAL_MSG("Error writing %s dataset's fillvalue attributes.\n", datasetName );
+           if(newdatasetName) free(newdatasetName);
+           if( input_dataBuffer) free(input_dataBuffer);
+           if( output_dataBuffer) free(output_dataBuffer);
+           return (FATAL_ERR);
 
+       }
+    */
 
     free(input_dataBuffer);
     free(output_dataBuffer);
-
+    if(newdatasetName) free(newdatasetName);
 
     return datasetID;
 }
+
 /*
-                    readThenWrite_MODIS_GeoMetry_Unpack
+                    readThenWrite_MODIS_Unpack
     DESCRIPTION:
         This function is a specific readThenWrite function for MODIS. This function does the
         same thing as the general readThenWrite except it performs data unpacking. Essentially,
@@ -2629,18 +3877,33 @@ hid_t readThenWrite_MODIS_Uncert_Unpack( hid_t outputGroupID, char* datasetName,
         any errors.
 */
 
-/* MY 2017-03-03 Unpack MODIS Geometry data */
-hid_t readThenWrite_MODIS_GeoMetry_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
-        int32 inputFileID)
+/* MY 2016-12-20 Unpack MODIS data */
+hid_t readThenWrite_MODIS_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
+                                  int32 inputFileID)
 {
 
+    //unsigned short special_values_unpacked[] = {65535,65534,65533,65532,65531,65530,65529,65528,65527,65526,65525,65500};
+    //float special_values_packed[] = {-999.0,-998.0,-997.0,-996.0,-995.0,-994.0,-993.0,-992.0,-991.0,-990.0,-989.0,-988.0};
+    char* radi_scales="radiance_scales";
+    char* radi_offset="radiance_offsets";
     int32 dataRank = 0;
     int32 dataDimSizes[DIM_MAX] = {0};
-    short* input_dataBuffer = NULL;
+    unsigned short* input_dataBuffer = NULL;
     float* output_dataBuffer = NULL;
     hid_t datasetID = 0;
     hid_t outputDataType = 0;
 
+
+    unsigned short special_values_start = 65535;
+    unsigned short special_values_stop = 65500;
+
+    float special_values_packed_start = -999.0;
+    int keepBits = 0;
+    datasetStats_t stats = { 0 };
+    int scaled = ( ctx->unpack == UNPACK_SCALED );
+    float scaleFactor = 1.0f;
+    float addOffset = 0.0f;
+
     intn status = -1;
 
     status = H4readData( inputFileID, datasetName,
@@ -2655,21 +3918,23 @@ hid_t readThenWrite_MODIS_GeoMetry_Unpack( hid_t outputGroupID, char* datasetNam
 
     /* Data Unpack */
     {
-        /*TODO
-          We need to obtain scale_factor,units, _FillValue, valid_range and then
-             unpack them to floating-point data.
 
-             _FillValue = -32767 to _FillValue = -999.0
-             valid_range  to valid_range*scale_factor
-             units keep
-             value * scale_factor, check _FillValue and change the value to -999.0.
-             because of time contraint and information from the user's guide.
-             scale_factor is always 0.01. We just multiple the value *0.01.
-              */
+        /* 1. Obtain radiance_scales and radiance_offsets. */
+        int32 sds_id = -1;
+        int32 sds_index = -1;
+        int32 radi_sc_index = -1;
+        int32 radi_off_index = -1;
+        int32 radi_sc_type = -1;
+        int32 radi_off_type = -1;
+        int32 num_radi_sc_values = -1;
+        int32 num_radi_off_values = -1;
+        char temp_attr_name[H4_MAX_NC_NAME];
+
+        float* radi_sc_values = NULL;
+        float* radi_off_values = NULL;;
+
 
         /* get the index of the dataset from the dataset's name */
-        /* The following if 0 block may be useful for the future implementation. */
-#if 0
         sds_index = SDnametoindex( inputFileID, datasetName );
         if( sds_index < 0 )
         {
@@ -2702,35 +3967,186 @@ hid_t readThenWrite_MODIS_GeoMetry_Unpack( hid_t outputGroupID, char* datasetNam
             free(input_dataBuffer);
             return FATAL_ERR;
         }
-#endif
 
+        radi_off_index = SDfindattr(sds_id,radi_offset);
+        if(radi_off_index < 0)
+        {
+             FATAL_MSG("Cannot find attribute %s of variable %s\n",radi_offset,datasetName);
+            SDendaccess(sds_id);
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
+
+
+        if(SDattrinfo (sds_id, radi_off_index, temp_attr_name, &radi_off_type, &num_radi_off_values)<0)
+        {
+             FATAL_MSG("Cannot obtain SDS attribute %s of variable %s\n",radi_offset,datasetName);
+            SDendaccess(sds_id);
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
+
+        if(radi_sc_type != DFNT_FLOAT32 || radi_sc_type != radi_off_type || num_radi_sc_values != num_radi_off_values)
+        {
+             FATAL_MSG("Error: ");
+            fprintf(stderr, "Either the scale/offset datatype is not 32-bit floating-point type\n\tor there is inconsistency between scale and offset datatype or number of values\n");
+            fprintf(stderr, "\tThis is for the variable %s\n",datasetName);
+            SDendaccess(sds_id);
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
+
+
+        radi_sc_values = calloc((size_t)num_radi_sc_values,sizeof radi_sc_values);
+        radi_off_values= calloc((size_t)num_radi_off_values,sizeof radi_off_values);
+
+        if(SDreadattr(sds_id,radi_sc_index,radi_sc_values) <0)
+        {
+             FATAL_MSG("Cannot obtain SDS attribute value %s of variable %s\n",radi_scales,datasetName);
+            free(radi_sc_values);
+            free(radi_off_values);
+            SDendaccess(sds_id);
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
+
+
+        if(SDreadattr(sds_id,radi_off_index,radi_off_values) <0)
+        {
+             FATAL_MSG("Cannot obtain SDS attribute value %s of variable %s\n",radi_scales,datasetName);
+            free(radi_sc_values);
+            free(radi_off_values);
+            SDendaccess(sds_id);
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
+
+        SDendaccess(sds_id);
 
 
         float* temp_float_pointer = NULL;
-        short* temp_int16_pointer = input_dataBuffer;
+        unsigned short* temp_uint16_pointer = input_dataBuffer;
         size_t buffer_size = 1;
+        size_t band_buffer_size = 1;
+        int num_bands = dataDimSizes[0];
 
-        for(int i = 0; i <dataRank; i++)
-            buffer_size *=dataDimSizes[i];
+        if(num_bands != num_radi_off_values)
+        {
+             FATAL_MSG("Error: Number of band (the first dimension size) of the variable %s\n\tis not the same as the number of scale/offset values\n",datasetName);
+            free(radi_sc_values);
+            free(radi_off_values);
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
 
-        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
+        assert(dataRank>1);
+        for(int i = 1; i <dataRank; i++)
+            band_buffer_size *=dataDimSizes[i];
+
+        buffer_size = band_buffer_size*num_bands;
+
+        /* Scaled integers share one scale_factor and add_offset for all bands, so the valid radiances of the
+         * dataset are requantized onto the packed values below special_values_stop, in place. The special
+         * values keep their DNs. */
+        if ( scaled )
+        {
+            double radMin = 0.0;
+            double radMax = 0.0;
+            double rad = 0.0;
+            int haveValid = 0;
+
+            for(int i = 0; i<num_bands; i++)
+            {
+                for(int j = 0; j<band_buffer_size; j++)
+                {
+                    unsigned short dn = input_dataBuffer[i*band_buffer_size+j];
+                    if ( dn >= special_values_stop )
+                        continue;
+                    rad = (double)radi_sc_values[i]*((double)dn - radi_off_values[i]);
+                    if ( !haveValid || rad < radMin ) radMin = rad;
+                    if ( !haveValid || rad > radMax ) radMax = rad;
+                    haveValid = 1;
+                }
+            }
+
+            addOffset = (float) radMin;
+            if ( radMax > radMin )
+                scaleFactor = (float) ( ( radMax - radMin ) / ( special_values_stop - 1 ) );
+
+            for(int i = 0; i<num_bands; i++)
+            {
+                for(int j = 0; j<band_buffer_size; j++)
+                {
+                    if ( *temp_uint16_pointer < special_values_stop )
+                    {
+                        rad = (double)radi_sc_values[i]*((double)(*temp_uint16_pointer) - radi_off_values[i]);
+                        rad = ( rad - addOffset ) / scaleFactor + 0.5;
+                        if ( rad < 0.0 ) rad = 0.0;
+                        if ( rad > special_values_stop - 1 ) rad = special_values_stop - 1;
+                        *temp_uint16_pointer = (unsigned short) rad;
+                    }
+                    temp_uint16_pointer++;
+                }
+            }
+        }
+
+        output_dataBuffer = scaled ? NULL : malloc(sizeof output_dataBuffer *buffer_size);
 
         temp_float_pointer = output_dataBuffer;
-        short scaled_fillvalue = -32767;
-        float _fillvalue = -999.0;
-        float scale_factor = 0.01;
 
-        for(int i = 0; i<buffer_size; i++)
+        /* BF_KEEP_BITS drops the mantissa bits that the packed data never had. The histogram spans the
+         * radiances of the valid DNs, 0 to 32767, of all bands. */
+        keepBits = scaled ? 0 : getKeepBits( ctx, datasetName );
+        if ( keepBits != FATAL_ERR && !scaled )
         {
-            /* Check fill values, need to retrieve instead of hard-code. No resources, follow the user's guide.*/
-            if((*temp_int16_pointer)==scaled_fillvalue)
-                *temp_float_pointer = _fillvalue;
-            else
-                *temp_float_pointer = scale_factor*(*temp_int16_pointer);
+            float histMin = 0.0f;
+            float histMax = 0.0f;
+            for(int i = 0; i<num_bands; i++)
+            {
+                float low = -radi_sc_values[i]*radi_off_values[i];
+                float high = radi_sc_values[i]*(32767.0f - radi_off_values[i]);
+                if ( i == 0 || low < histMin ) histMin = low;
+                if ( i == 0 || high > histMax ) histMax = high;
+            }
+            if ( initDatasetStats( ctx, &stats, dataRank, dataDimSizes, special_values_packed_start,
+                                   special_values_packed_start + (special_values_start - special_values_stop),
+                                   histMin, histMax ) == FATAL_ERR )
+                keepBits = FATAL_ERR;
+        }
+        if ( keepBits == FATAL_ERR )
+        {
+            free(radi_sc_values);
+            free(radi_off_values);
+            free(input_dataBuffer);
+            free(output_dataBuffer);
+            return FATAL_ERR;
+        }
 
-            temp_int16_pointer++;
-            temp_float_pointer++;
+        /* A band is at least one statistics tile. Round each band and add it to the statistics right
+         * after unpacking it. */
+        for(int i = 0; !scaled && i<num_bands; i++)
+        {
+            float temp_scale_offset = radi_sc_values[i]*radi_off_values[i];
+            for(int j = 0; j<band_buffer_size; j++)
+            {
+                /* Check special values  , here I may need to make it a little clear.*/
+                if(((*temp_uint16_pointer)<=special_values_start) && ((*temp_uint16_pointer)>=special_values_stop))
+                    *temp_float_pointer = special_values_packed_start +(special_values_start-(*temp_uint16_pointer));
+                else
+                {
+                    *temp_float_pointer = radi_sc_values[i]*(*temp_uint16_pointer) - temp_scale_offset;
+                }
+                temp_uint16_pointer++;
+                temp_float_pointer++;
+            }
+
+            if ( keepBits > 0 )
+                bitRoundFloat( output_dataBuffer + i*band_buffer_size, band_buffer_size, keepBits, special_values_packed_start,
+                               special_values_packed_start + (special_values_start - special_values_stop) );
+            accumulateStats( &stats, output_dataBuffer + i*band_buffer_size, i*band_buffer_size, band_buffer_size );
         }
+        free(radi_sc_values);
+        free(radi_off_values);
 
     }
 
@@ -2747,35 +4163,31 @@ hid_t readThenWrite_MODIS_GeoMetry_Unpack( hid_t outputGroupID, char* datasetNam
     for ( int i = 0; i < DIM_MAX; i++ )
         temp[i] = (hsize_t) dataDimSizes[i];
 
-    outputDataType = H5T_NATIVE_FLOAT;
-//#if 0
-    short use_chunk = 0;
-
-    /* If using chunk */
-    {
-        const char *s;
-        s = getenv("USE_CHUNK");
+    outputDataType = scaled ? H5T_NATIVE_USHORT : H5T_NATIVE_FLOAT;
+    void* write_dataBuffer = scaled ? (void*) input_dataBuffer : (void*) output_dataBuffer;
 
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) == 1)
-                use_chunk = 1;
-    }
+//#if 0
+    short use_chunk = ctx->useChunk;
 
     if(use_chunk == 1)
     {
-        datasetID = insertDataset_comp( &outputFile, &outputGroupID, 1, dataRank,
-                                        temp, outputDataType, datasetName, output_dataBuffer,1 );
+        if ( keepBits > 0 )
+            datasetID = insertDataset_comp_shuffle( ctx, &outputGroupID, 1, dataRank,
+                                                    temp, outputDataType, datasetName, write_dataBuffer,1 );
+        else
+            datasetID = insertDataset_comp( ctx, &outputGroupID, 1, dataRank,
+                                            temp, outputDataType, datasetName, write_dataBuffer,1 );
     }
     else
     {
-        datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
-                                   temp, outputDataType, datasetName, output_dataBuffer );
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, datasetName, write_dataBuffer );
     }
 //#endif
 
 
 #if 0
-    datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank,
+    datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
                                temp, outputDataType, datasetName, output_dataBuffer );
 #endif
 
@@ -2784,2392 +4196,7635 @@ hid_t readThenWrite_MODIS_GeoMetry_Unpack( hid_t outputGroupID, char* datasetNam
          FATAL_MSG("Error writing %s dataset.\n", datasetName );
         free(input_dataBuffer);
         free(output_dataBuffer);
+        freeDatasetStats( &stats );
         return (FATAL_ERR);
     }
 
 
     free(input_dataBuffer);
+
+    if ( ( keepBits > 0 && setKeepBitsAttr( datasetID, keepBits ) == FATAL_ERR ) ||
+         writeDatasetStats( ctx, &stats, outputGroupID, datasetID, datasetName ) == FATAL_ERR ||
+         ( !scaled && writeOverviews( ctx, outputGroupID, datasetID, datasetName, output_dataBuffer, dataRank,
+                                      dataDimSizes, special_values_packed_start,
+                                      special_values_packed_start + (special_values_start - special_values_stop),
+                                      1, use_chunk ) == FATAL_ERR ) )
+    {
+        free(output_dataBuffer);
+        freeDatasetStats( &stats );
+        H5Dclose(datasetID);
+        return FATAL_ERR;
+    }
     free(output_dataBuffer);
+    freeDatasetStats( &stats );
 
+    if ( scaled )
+    {
+        unsigned short scaledFill = special_values_start;
+        unsigned short scaledRange[2] = { 0, special_values_stop - 1 };
+        if ( setScaledAttrs( ctx, datasetID, H5T_NATIVE_USHORT, &scaledFill, scaledRange, scaleFactor, addOffset ) == FATAL_ERR )
+        {
+            H5Dclose(datasetID);
+            return FATAL_ERR;
+        }
+    }
 
     return datasetID;
 }
 
-herr_t convert_SD_Attrs(int32 sd_id,hid_t h5parobj_id,char*h5obj_name,char*sds_name,char *ignore_attr_name)
+/* Unpack MODIS uncertainty */
+hid_t readThenWrite_MODIS_Uncert_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
+        int32 inputFileID)
 {
 
-    int   i = 0;
-    intn  h4_status = 0;
-    int32 sds_id = 0;
-    int32 sds_index = 0;
-    int32 dim_sizes[H4_MAX_VAR_DIMS] = {0};
-    int32 rank = 0;
-    int32 data_type = 0;
-    int32 n_attrs = 0;
-    int32   n_values = 0;
-    char    dummy_sds_name[H4_MAX_NC_NAME] = {'\0'};
-    char    attr_name[H4_MAX_NC_NAME] = {'\0'};
-    char*   attr_values= NULL;
+    char* scaling_factor="scaling_factor";
+    char* specified_uncert="specified_uncertainty";
+    int32 dataRank = 0;
+    int32 dataDimSizes[DIM_MAX] = {0};
+    uint8_t* input_dataBuffer = NULL;
+    float* output_dataBuffer = NULL;
+    hid_t datasetID = 0;
+    hid_t outputDataType = 0;
 
+    //Ideally the following 3 values should be retrieved from SDS APIs
+    uint8_t fvalue = 255;
+    uint8_t valid_min= 0;
+    uint8_t valid_max = 15;
+    float fvalue_packed = -999.0;
 
-    if(sds_name == NULL)
-        sds_id = sd_id;
-    else
-    {
-        sds_index = SDnametoindex(sd_id,sds_name);
-        sds_id = SDselect (sd_id, sds_index);
-    }
+    intn status = -1;
 
-    h4_status = SDgetinfo (sds_id, dummy_sds_name, &rank, dim_sizes,
-                           &data_type, &n_attrs);
-    if ( h4_status == -1 )
-    {
-        FATAL_MSG("Failed to get dataset info.\n");
-        if ( sds_id ) SDendaccess(sds_id);
-        return -1;
-    }
 
-    if(ignore_attr_name == NULL) {
-     for( i = 0; i <n_attrs; i++)
-     {
-        h4_status = SDattrinfo (sds_id, i, attr_name, &data_type, &n_values);
-        attr_values = malloc(n_values*DFKNTsize(data_type));
-        h4_status = SDreadattr (sds_id, i, attr_values);
-        copy_h5_attrs(data_type,n_values,attr_name,attr_values,h5parobj_id,h5obj_name);
-        free (attr_values);
-     }
+    status = H4readData( inputFileID, datasetName,
+                         (void**)&input_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
+    if ( status < 0 )
+    {
+         FATAL_MSG("Unable to read %s data.\n",  datasetName );
+        if( input_dataBuffer ) free(input_dataBuffer);
+        return (FATAL_ERR);
     }
-    else {
-     for( i = 0; i <n_attrs; i++)
-     {
-        h4_status = SDattrinfo (sds_id, i, attr_name, &data_type, &n_values);
-        if(strcmp(ignore_attr_name,attr_name)==0) 
-            continue;
-        attr_values = malloc(n_values*DFKNTsize(data_type));
-        h4_status = SDreadattr (sds_id, i, attr_values);
-        copy_h5_attrs(data_type,n_values,attr_name,attr_values,h5parobj_id,h5obj_name);
-        free (attr_values);
-     }
 
-    }
 
-    if(sds_name != NULL)
-        SDendaccess(sds_id);
-    return 0;
-}
+    /* Data Unpack */
+    {
 
-herr_t copy_h5_attrs(int32 h4_type,int32 n_values,char* attr_name,char* attr_value,hid_t par_id, char* h5obj_name)
-{
+        /* 1. Obtain scaling_factor and specified uncertainty . */
+        int32 sds_id = -1;
+        int32 sds_index = -1;
+        int32 sc_index = -1;
+        int32 uncert_index = -1;
+        int32 sc_type = -1;
+        int32 uncert_type = -1;
+        int32 num_sc_values = -1;
+        int32 num_uncert_values = -1;
+        char temp_attr_name[H4_MAX_NC_NAME];
+        float* sc_values = NULL;
+        float* uncert_values = NULL;;
 
-    size_t h5_size = 0;
-    int h5_sign = -2;
-    hid_t h5memtype = 0;
-    hid_t* h5memtype_ptr = &h5memtype;
-    h4type_to_h5type(h4_type,h5memtype_ptr);
-    h5memtype = *h5memtype_ptr;
 
-    if(h5memtype == H5T_STRING)
-    {
-        hid_t str_type = H5Tcopy(H5T_C_S1);
-        H5Tset_size(str_type,n_values+1);
-        char*attr_value_new = malloc(n_values+1);
-        strncpy(attr_value_new,attr_value,n_values);
-        attr_value_new[n_values]='\0';
-        H5Tset_strpad(str_type,H5T_STR_NULLTERM);
-        herr_t ret= H5LTset_attribute_string(par_id,h5obj_name,attr_name,(const char*)attr_value_new);
-        free(attr_value_new);
-        return ret;
-    }
-    else
-    {
-        switch (H5Tget_class(h5memtype))
+        /* get the index of the dataset from the dataset's name */
+        sds_index = SDnametoindex( inputFileID, datasetName );
+        if( sds_index < 0 )
         {
+             FATAL_MSG("SDnametoindex -- Failed to get index of dataset.\n");
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
 
-        case H5T_INTEGER:
+        sds_id = SDselect( inputFileID, sds_index );
+        if ( sds_id < 0 )
         {
-            h5_size = H5Tget_size(h5memtype);
-            h5_sign = H5Tget_sign(h5memtype);
+             FATAL_MSG("SDselect -- Failed to get ID of dataset.\n");
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
 
-            if (h5_size == 1)   // Either h5_signed char or unh5_signed char
-            {
-                if (h5_sign == H5T_SGN_2)
-                    return H5LTset_attribute_char(par_id,h5obj_name,attr_name,(const char*)attr_value,n_values);
-                else
-                    return H5LTset_attribute_uchar(par_id,h5obj_name,attr_name,(const unsigned char*)attr_value,n_values);
+        sc_index = SDfindattr(sds_id,scaling_factor);
+        if(sc_index < 0)
+        {
+             FATAL_MSG("SDfindattr -- Cannot find attribute %s of variable %s\n",scaling_factor,datasetName);
+            free(input_dataBuffer);
+            SDendaccess(sds_id);
+            return FATAL_ERR;
+        }
 
-            }
-            else if (h5_size == 2)
-            {
-                if (h5_sign == H5T_SGN_2)
-                    return H5LTset_attribute_short(par_id,h5obj_name,attr_name,(const short*)attr_value,n_values);
-                else
-                    return H5LTset_attribute_ushort(par_id,h5obj_name,attr_name,(const unsigned short*)attr_value,n_values);
-            }
-            else if (h5_size == 4)
-            {
-                if (h5_sign == H5T_SGN_2)
-                    return H5LTset_attribute_int(par_id,h5obj_name,attr_name,(const int*)attr_value,n_values);
-                else
-                    return H5LTset_attribute_uint(par_id,h5obj_name,attr_name,(const unsigned int*)attr_value,n_values);
-            }
-            else if (h5_size == 8)
-            {
-                if (h5_sign == H5T_SGN_2)
-                    return H5LTset_attribute_long_long(par_id,h5obj_name,attr_name,(const long long*)attr_value,n_values);
-                else
-                    return -1;
-            }
-            else return -1;
+        if(SDattrinfo (sds_id, sc_index, temp_attr_name, &sc_type, &num_sc_values)<0)
+        {
+             FATAL_MSG("SDattrinfo -- Cannot obtain SDS attribute %s of variable %s\n",scaling_factor,datasetName);
+            free(input_dataBuffer);
+            SDendaccess(sds_id);
+            return FATAL_ERR;
         }
-        case H5T_FLOAT:
+
+        uncert_index = SDfindattr(sds_id,specified_uncert);
+        if(uncert_index < 0)
         {
-            h5_size = H5Tget_size(h5memtype);
-            if (h5_size == 4) return H5LTset_attribute_float(par_id,h5obj_name,attr_name,(const float*)attr_value,n_values);
-            else if (h5_size == 8) return H5LTset_attribute_double(par_id,h5obj_name,attr_name,(const double*)attr_value,n_values);
-            else return -1;
+             FATAL_MSG("SDfindattr -- Cannot find attribute %s of variable %s\n",specified_uncert,datasetName);
+            free(input_dataBuffer);
+            SDendaccess(sds_id);
+            return FATAL_ERR;
         }
-        default:
-            return -1;
+
+
+        if(SDattrinfo (sds_id, uncert_index, temp_attr_name, &uncert_type, &num_uncert_values)<0)
+        {
+             FATAL_MSG("SDattrinfo -- Cannot obtain attribute %s of variable %s\n",specified_uncert,datasetName);
+            free(input_dataBuffer);
+            SDendaccess(sds_id);
+            return FATAL_ERR;
         }
-    }
-    return 0;
-}
 
+        if(sc_type != DFNT_FLOAT32 || num_sc_values != num_uncert_values)
+        {
+             FATAL_MSG("Error: Either the scale datatype is not 32-bit floating-point type or there is \n\tinconsistency of number of values between scale and specified uncertainty.\n");
+            fprintf(stderr, "\tThis is for the variable %s\n",datasetName);
+            free(input_dataBuffer);
+            SDendaccess(sds_id);
+            return FATAL_ERR;
+        }
 
-herr_t H4readSDSAttr( int32 h4FileID, char* datasetName, char* attrName, void* buffer )
-{
-    int32 statusn = 0;
-    int32 dsetIndex = SDnametoindex(h4FileID,datasetName);
-    if ( dsetIndex < 0 )
-    {
-        FATAL_MSG("Failed to get dataset index.\n");
-        return FATAL_ERR;
-    }
-    int32 dsetID = SDselect(h4FileID, dsetIndex);
-    if ( dsetID < 0 )
-    {
-        FATAL_MSG("Failed to get dataset ID.\n");
-        return FATAL_ERR;
-    }
-    int32 attrIdx = SDfindattr(dsetID,attrName);
-    if ( attrIdx < 0 )
-    {
-        FATAL_MSG("Failed to get attribute index.\n");
-        return FATAL_ERR;
-    }
-    statusn = SDreadattr(dsetID,attrIdx,(VOIDP) buffer );
-    if ( statusn < 0 )
-    {
-        FATAL_MSG("Failed to read attribute.\n");
-        return FATAL_ERR;
-    }
 
-    return RET_SUCCESS;
-}
+        sc_values = calloc((size_t)num_sc_values,sizeof sc_values);
+        uncert_values= calloc((size_t)num_uncert_values,sizeof uncert_values);
 
-/*
-        copyAttrFromName
+        if(SDreadattr(sds_id,sc_index,sc_values) <0)
+        {
+             FATAL_MSG("SDreadattr -- Cannot obtain SDS attribute value %s of variable %s\n",scaling_factor,datasetName);
+            free(input_dataBuffer);
+            SDendaccess(sds_id);
+            free(sc_values);
+            free(uncert_values);
+            return FATAL_ERR;
+        }
 
- DESCRIPTION:
-    This function copies the attribute attrName located at the HDF4 object inObjID to the 
-    HDF5 object outObjID.
+        if(SDreadattr(sds_id,uncert_index,uncert_values) <0)
+        {
+             FATAL_MSG("SDattrinfo -- Cannot obtain SDS attribute value %s of variable %s\n",specified_uncert,datasetName);
+            free(input_dataBuffer);
+            SDendaccess(sds_id);
+            free(sc_values);
+            free(uncert_values);
+            return FATAL_ERR;
+        }
 
- ARGUMENTS:
-    IN
-        int32 inFileID          -- The input HDF4 file
-        const char* inObjID     -- The name of the dataset where attrName is located.
-        const char* attrName    -- The name of the attribute to be copied
-    OUT
-        hid_t outObjID          -- Where the attribute will be copied to.
+        SDendaccess(sds_id);
 
- EFFECTS:
-    Adds an attribute to the object outObjID
 
- RETURN:
-    FATAL_ERR
-    RET_SUCCESS
+        float* temp_float_pointer = NULL;
+        uint8_t* temp_uint8_pointer = input_dataBuffer;
+        size_t buffer_size = 1;
+        size_t band_buffer_size = 1;
+        int num_bands = dataDimSizes[0];
 
-*/
-herr_t copyAttrFromName( int32 inFileID, const char* inObjName, const char* attrName, hid_t outObjID )
-{
-    int32 attrIdx = 0;
-    herr_t retVal = RET_SUCCESS;
-    intn statusn = 0;
-    int32 ntype = 0;
-    int32 count = 0;
-    int statusi = 0;
-    hid_t h5TypeOld = 0;
-    void* attrBuf = NULL;
-    hid_t attrDataspace = 0;
-    hid_t attrID = 0;
-    herr_t statuse = 0;
-    hid_t h5TypeNew = 0;
-    int32 sds_index = 0;
-    int32 sds_id = 0;
+        if(num_bands != num_uncert_values)
+        {
+             FATAL_MSG("Error: Number of band (the first dimension size) of the variable %s is not\n\tthe same as the number of scale/offset values\n",datasetName);
+            free(input_dataBuffer);
+            free(sc_values);
+            free(uncert_values);
+            return FATAL_ERR;
+        }
+
+        assert(dataRank>1);
+        for(int i = 1; i <dataRank; i++)
+            band_buffer_size *=dataDimSizes[i];
+
+        buffer_size = band_buffer_size*num_bands;
+
+        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
+
+        temp_float_pointer = output_dataBuffer;
+
+
+        for(int i = 0; i<num_bands; i++)
+        {
+            for(int j = 0; j<band_buffer_size; j++)
+            {
+                /* Check special values  , here I may need to make it a little clear.*/
+                if((*temp_uint8_pointer)== fvalue)
+                    *temp_float_pointer = fvalue_packed;
+                else if(((*temp_uint8_pointer)<valid_min) && ((*temp_uint8_pointer)>valid_max))
+                {
+                    /* currently set any invalid value to fill values */
+                    *temp_float_pointer = fvalue_packed;
+                }
+                else
+                {
+                    *temp_float_pointer = uncert_values[i]*exp((*temp_uint8_pointer)/sc_values[i]);
+                }
+                temp_uint8_pointer++;
+                temp_float_pointer++;
+            }
+        }
+        free(sc_values);
+        free(uncert_values);
 
-    // OPEN THE INPUT DATASET
-    /* get the index of the dataset from the dataset's name */
-    sds_index = SDnametoindex( inFileID, inObjName );
-    if( sds_index < 0 )
-    {
-        FATAL_MSG("SDnametoindex: Failed to get index of dataset.\n");
-        return FATAL_ERR;
     }
-    // Select the dataset
-    sds_id = SDselect( inFileID, sds_index );
-    if ( sds_id < 0 )
+
+
+    /* END READ DATA. BEGIN INSERTION OF DATA */
+
+    /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
+     * that need to be resolved. Thus, we need to take the DimSizes array, which is
+     * of type int32 (an HDF4 type) and put it into an array of type hsize_t.
+     * A simple casting might work, but that is dangerous considering hsize_t and int32
+     * are not simply two different names for the same type. They are two different types.
+     */
+    hsize_t temp[DIM_MAX];
+    for ( int i = 0; i < DIM_MAX; i++ )
+        temp[i] = (hsize_t) dataDimSizes[i];
+
+    outputDataType = H5T_NATIVE_FLOAT;
+    short use_chunk = ctx->useChunk;
+
+    if(use_chunk == 1)
     {
-        FATAL_MSG("SDselect: Failed to select dataset.\n");
-        return FATAL_ERR;
+        datasetID = insertDataset_comp( ctx, &outputGroupID, 1, dataRank,
+                                        temp, outputDataType, datasetName, output_dataBuffer,1);
     }
-    // Find the index of the attribute
-    attrIdx = SDfindattr( sds_id, attrName );
-    if ( attrIdx == FAIL )
+    else
     {
-        FATAL_MSG("Failed to find the attribute.\n");
-        goto cleanupFail;
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, datasetName, output_dataBuffer );
     }
 
-    // Get info on the attribute
-    char dummy[STR_LEN];
-    statusn = SDattrinfo( sds_id, attrIdx, dummy, &ntype, &count );
-    if ( statusn == FAIL )
-    {
-        FATAL_MSG("Failed to obtain attribute info.\n");
-        goto cleanupFail;
-    }
 
-    // Find the corresponding HDF5 datatype
-    statusi = h4type_to_h5type( ntype, &h5TypeOld );
-    if ( statusi == FAIL )
+    //datasetID = insertDataset( &outputFile, &outputGroupID, 1, dataRank ,
+    //     temp, outputDataType, datasetName, output_dataBuffer );
+
+    if ( datasetID == FATAL_ERR )
     {
-        FATAL_MSG("Failed to obtain the HDF5 datatype.\n");
-        goto cleanupFail;
+         FATAL_MSG("Error writing %s dataset.\n", datasetName );
+        free(input_dataBuffer);
+        free(output_dataBuffer);
+        return (FATAL_ERR);
     }
 
-    // Need to convert the datatype to a string of the appropriate length
-    if ( h5TypeOld == H5T_STRING )
-    {
-        h5TypeNew = H5Tcopy(H5T_C_S1);
-        H5Tset_size( h5TypeNew, count );
-    }    
-    else
-        h5TypeNew = h5TypeOld;
 
-    // Allocate attribute buffer
-    size_t size = H5Tget_size(h5TypeNew);
-    if ( size == 0 )
-    {
-        FATAL_MSG("Failed to get size of datatype.\n");
-        goto cleanupFail;
-    }
-    
-    if ( h5TypeOld == H5T_STRING ) size = 1;
-
-    attrBuf = calloc( count + 1, size );
-
-    // Read the attribute
-    statusn = SDreadattr( sds_id, attrIdx, attrBuf );
-    if ( statusn == FAIL )
-    {
-        FATAL_MSG("Failed to read the attribute.\n");
-        goto cleanupFail;
-    }
-
-    // Create a simple dataspace for the attribute
-    // We only want one string of length count, so temp_hsize will just be 1
-    // KY: We also find some attributes that use other types,so we cannot hard-code
-    // those attriabute as size 1.
-    hsize_t temp_hsize = 1;
-    // Bad,  the whole routine needs to be rewrittedn, just make it work for now. KY
-    if(h5TypeOld != H5T_STRING) 
-        temp_hsize = count;
-    attrDataspace = H5Screate_simple( 1, &temp_hsize,  NULL );
-    if ( attrDataspace < 0 )
-    {
-        FATAL_MSG("Failed to create a dataspace.\n");
-        attrDataspace = 0;
-        goto cleanupFail;
-    }
-    
-    // Create an attribute
-    attrID = H5Acreate2( outObjID, attrName, h5TypeNew, attrDataspace, H5P_DEFAULT, H5P_DEFAULT ); 
-    if ( attrID < 0 )
-    {
-        FATAL_MSG("Failed to create an attribute.\n");
-        attrID = 0;
-        goto cleanupFail;
-    }
-
-    // Write the attribute
-    statuse = H5Awrite( attrID, h5TypeNew, attrBuf );
-    if ( statuse < 0 )
-    {
-        FATAL_MSG("Failed to write to attribute.\n");
-        goto cleanupFail;
-    }
+    free(input_dataBuffer);
+    free(output_dataBuffer);
 
-    if ( 0 )
-    {
-cleanupFail:
-        retVal = FATAL_ERR;
-    }
 
-    if ( attrBuf )          free(attrBuf);
-    if ( attrDataspace )    H5Sclose(attrDataspace);    
-    if ( attrID )           H5Aclose(attrID);
-    return retVal;    
+    return datasetID;
 }
-
-/*                              getTime
+/*
+                    readThenWrite_MODIS_GeoMetry_Unpack
     DESCRIPTION:
-        This function takes a path (relative or absolute) to one of the instrument files
-        and returns a string containing the date information contained in the file name.
-        The string returned is allocated on the heap.
+        This function is a specific readThenWrite function for MODIS. This function does the
+        same thing as the general readThenWrite except it performs data unpacking. Essentially,
+        unpacking the data means converting the radiance datasets from an integer type to
+        a floating point type. Doing this greatly increases the size of the data however.
+        On an abstracted level, this is what unpacking looks like:
 
-            !!!NOTE!!!
+        unpackedElement = scale * packedElement + offset
 
-        IT IS THE DUTY OF THE CALLER
-        to free pathname when done to avoid memory leaks.
+        The packedElement is an integer type, and the unpackedElement is a single precision
+        float type.
 
-        The instrument argument is defined as follows:
-        0 = MOPITT
-        1 = CERES
-        2 = MODIS
-        3 = ASTER
-        4 = MISR
     ARGUMENTS:
-        char* pathname -- the pathname to the hdf file
-        int instrument -- an identifier specifying which instrument pathname refers to
+        1. outputGroupID  -- The HDF5 group/directory identifier for where the data is to
+                             be written. Can either be an actual group ID or can be the
+                             file ID (in the latter case, data will be written to the root
+                             directory).
+        2. datasetName    -- A string containing the name of the dataset in the input HDF4
+                             file. The output dataset will have the same name.
+        3. inputDataType  -- An HDF4 datatype identifier. Must match the data type of the
+                             input dataset. Please reference Section 3 of the HDF4
+                             Reference Manual for a list of HDF types.
+        4. inputFileID    -- The HDF4 input file identifier
+
     EFFECTS:
-        Allocates a string on the heap and returns that string
-    RETURN:
-        A valid string upon success.
-        NULL upon failure.
- */
-char* getTime( char* pathname, int instrument )
-{
-    char* retString = NULL;
-    char* start = NULL;
-    char* end = NULL;
-    int len = 0;
+        Reads the input file dataset and then writes to the HDF5 output file. Returns
+        a dataset identifier for the new dataset created in the output file. It is the
+        responsibility of the caller to close the dataset ID when finished using
+        H5Dclose().
 
-    /**********
-     * MOPITT *
-     **********/
-    if ( instrument == 0 )
-    {
-        start = strstr ( pathname, "MOP01-" );
-        if ( start == NULL )
-        {
-            FATAL_MSG("Expected MOPITT path.\n\tReceived \"%s\"\n", pathname);
-            return NULL;
-        }
+    RETURN:
+        Returns the dataset identifier if successful. Else returns FATAL_ERR upon
+        any errors.
+*/
 
-        /* start is now pointing to the 'M'. We need to offset it to
-         * point to the beginning of the date in the filename. char is
-         * size 1, so we can simply offset it by 6
-         */
-        start += 6;
-        end = strstr( pathname, ".he5" );
-        if ( end == NULL )
-        {
-            FATAL_MSG("Error in reading the pathname for %s.\n","MOPITT");
-            return NULL;
-        }
+/* MY 2017-03-03 Unpack MODIS Geometry data */
+hid_t readThenWrite_MODIS_GeoMetry_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
+        int32 inputFileID)
+{
 
-        /* end points to the '.'. Offset it by -1 */
-        end += -1;
+    int32 dataRank = 0;
+    int32 dataDimSizes[DIM_MAX] = {0};
+    short* input_dataBuffer = NULL;
+    float* output_dataBuffer = NULL;
+    hid_t datasetID = 0;
+    hid_t outputDataType = 0;
 
-        /* We want just the 8 characters after start */
-        len = 8;
-        retString = calloc ( len+1,1 );
-        strncpy( retString, start, len);
+    intn status = -1;
 
-        return retString;
+    status = H4readData( inputFileID, datasetName,
+                         (void**)&input_dataBuffer, &dataRank, dataDimSizes, inputDataType,NULL,NULL,NULL );
+    if ( status < 0 )
+    {
+         FATAL_MSG("Unable to read %s data.\n",  datasetName );
+        if ( input_dataBuffer ) free(input_dataBuffer);
+        return (FATAL_ERR);
     }
 
-    /* repeat the same general process for each instrument */
 
-    /*********
-     * CERES *
-     *********/
-    else if ( instrument == 1 )
+    /* Data Unpack */
     {
-        start = strstr( pathname, "CER_" );
-        if ( start == NULL )
+        /*TODO
+          We need to obtain scale_factor,units, _FillValue, valid_range and then
+             unpack them to floating-point data.
+
+             _FillValue = -32767 to _FillValue = -999.0
+             valid_range  to valid_range*scale_factor
+             units keep
+             value * scale_factor, check _FillValue and change the value to -999.0.
+             because of time contraint and information from the user's guide.
+             scale_factor is always 0.01. We just multiple the value *0.01.
+              */
+
+        /* get the index of the dataset from the dataset's name */
+        /* The following if 0 block may be useful for the future implementation. */
+#if 0
+        sds_index = SDnametoindex( inputFileID, datasetName );
+        if( sds_index < 0 )
         {
-            FATAL_MSG("Expected CERES path.\n\tReceived \"%s\"\n",pathname );
-            return NULL;
+             FATAL_MSG("-- SDnametoindex -- Failed to get index of dataset.\n");
+            free(input_dataBuffer);
+            return FATAL_ERR;
         }
 
-        end = pathname + strlen( pathname ) - 1;
+        sds_id = SDselect( inputFileID, sds_index );
+        if ( sds_id < 0 )
+        {
+             FATAL_MSG("SDselect -- Failed to get the ID of the dataset.\n");
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
 
-        /* end should be pointing to a number. Do a check to make sure this is true. */
-        if ( *end < '0' || *end > '9' )
+        radi_sc_index = SDfindattr(sds_id,radi_scales);
+        if(radi_sc_index < 0)
         {
-            FATAL_MSG("Error in reading the pathname for %s.\n", "CERES" );
-            return NULL;
+             FATAL_MSG("Cannot find attribute %s of variable %s\n",radi_scales,datasetName);
+            SDendaccess(sds_id);
+            free(input_dataBuffer);
+            return FATAL_ERR;
         }
 
-        len = 10;
-        retString = calloc(len+1,1);
-        strncpy( retString, end-9, len );
-        return retString;
+        if(SDattrinfo (sds_id, radi_sc_index, temp_attr_name, &radi_sc_type, &num_radi_sc_values)<0)
+        {
+             FATAL_MSG("Cannot obtain SDS attribute %s of variable %s\n",radi_scales,datasetName);
+            SDendaccess(sds_id);
+            free(input_dataBuffer);
+            return FATAL_ERR;
+        }
+#endif
 
-    }
 
-    /*********
-     * MODIS *
-     *********/
-    else if ( instrument == 2 )
-    {
-        /* this do-while loop isn't actually a loop. I just want to be able to make use
-         * of "break" to avoid unecessary checks. It was either this or the use of
-         * goto. Couldn't think of an elegant way to do the following code using else-if
-         * statements.
-         */
-        do
-        {
-            start = strstr( pathname, "MOD021KM.A" );
-            if ( start != NULL )
-            {
-                start += 10;
-                break;
-            }
 
-            start = strstr( pathname, "MOD03.A" );
-            if ( start != NULL )
-            {
-                start += 7;
-                break;
-            }
+        float* temp_float_pointer = NULL;
+        short* temp_int16_pointer = input_dataBuffer;
+        size_t buffer_size = 1;
 
-            start = strstr( pathname, "MOD02HKM.A" );
-            if ( start != NULL )
-            {
-                start += 10;
-                break;
-            }
+        for(int i = 0; i <dataRank; i++)
+            buffer_size *=dataDimSizes[i];
 
-            start = strstr( pathname, "MOD02QKM.A" );
-            if ( start != NULL )
-            {
-                start += 10;
-                break;
-            }
+        output_dataBuffer = malloc(sizeof output_dataBuffer *buffer_size);
 
-            FATAL_MSG("Expected MODIS path.\n\tReceived \"%s\"\n", pathname );
-            return NULL;
+        temp_float_pointer = output_dataBuffer;
+        short scaled_fillvalue = -32767;
+        float _fillvalue = -999.0;
+        float scale_factor = 0.01;
 
-        } while ( 0 );
+        for(int i = 0; i<buffer_size; i++)
+        {
+            /* Check fill values, need to retrieve instead of hard-code. No resources, follow the user's guide.*/
+            if((*temp_int16_pointer)==scaled_fillvalue)
+                *temp_float_pointer = _fillvalue;
+            else
+                *temp_float_pointer = scale_factor*(*temp_int16_pointer);
 
-        len = 12;
+            temp_int16_pointer++;
+            temp_float_pointer++;
+        }
 
-        retString = calloc(len+1,1);
-        strncpy( retString, start, len );
-        return retString;
     }
 
-    /*********
-     * ASTER *
-     *********/
-    else if ( instrument == 3 )
-    {
-        start = strstr( pathname, "L1T_" );
-        if ( start == NULL )
-        {
-            FATAL_MSG("Expected ASTER path.\n\tReceived \"%s\"\n", pathname );
-            return NULL;
-        }
 
-        // Skip the version number
-        start += 7;
-        len = 14;
-        retString = calloc(len+1,1);
-        strncpy( retString, start, len);
-        return retString;
-    }
+    /* END READ DATA. BEGIN INSERTION OF DATA */
 
-    /********
-     * MISR *
-     ********/
-    else if ( instrument == 4 )
+    /* Because we are converting from HDF4 to HDF5, there are a few type mismatches
+     * that need to be resolved. Thus, we need to take the DimSizes array, which is
+     * of type int32 (an HDF4 type) and put it into an array of type hsize_t.
+     * A simple casting might work, but that is dangerous considering hsize_t and int32
+     * are not simply two different names for the same type. They are two different types.
+     */
+    hsize_t temp[DIM_MAX];
+    for ( int i = 0; i < DIM_MAX; i++ )
+        temp[i] = (hsize_t) dataDimSizes[i];
+
+    outputDataType = H5T_NATIVE_FLOAT;
+//#if 0
+    short use_chunk = ctx->useChunk;
+
+    if(use_chunk == 1)
     {
-        start = strstr( pathname, "MISR_" );
-        if ( start == NULL )
-        {
-            FATAL_MSG("Expected MISR path.\n\tReceived \"%s\"\n",pathname );
-            return NULL;
-        }
+        datasetID = insertDataset_comp( ctx, &outputGroupID, 1, dataRank,
+                                        temp, outputDataType, datasetName, output_dataBuffer,1 );
+    }
+    else
+    {
+        datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                                   temp, outputDataType, datasetName, output_dataBuffer );
+    }
+//#endif
 
-        // Just want the orbit number
-        start += 32;
-        len = 6;
-        retString = calloc(len+1,1);
-        strncpy( retString, start, len);
-        return retString;
+
+#if 0
+    datasetID = insertDataset( ctx, &outputGroupID, 1, dataRank,
+                               temp, outputDataType, datasetName, output_dataBuffer );
+#endif
+
+    if ( datasetID == FATAL_ERR )
+    {
+         FATAL_MSG("Error writing %s dataset.\n", datasetName );
+        free(input_dataBuffer);
+        free(output_dataBuffer);
+        return (FATAL_ERR);
     }
 
-    FATAL_MSG("Incorrect instrument argument.\n");
 
-    return NULL;
-}
+    free(input_dataBuffer);
+    free(output_dataBuffer);
 
-/*-------------------------------------------------------------------
- * The following function has been copied from the H4toH5 library.
- * https://bitbucket.hdfgroup.org/projects/HDFEOS/repos/h4h5tools/browse/lib/src/h4toh5util.c
- *
-    Function:    h4type_to_h5type
 
-    DESCRIPTION:
-        This function converts the given HDF4 datatype to an HDF5 datatype.
-    ARGUMENTS:
-        In:
-            const int32 h4type -- The input hdf4 datatype
-        Out:
-            hid_t* h5memtype -- The corresponding HDF5 datatype
-    EFFECTS:
-        Updates caller variable to contain correct HDF5 datatype
-    RETURN:
-        FAIL upon failure
-        SUCCEED upon success
+    return datasetID;
+}
 
- */
-int  h4type_to_h5type(
-    const int32 h4type,
-    hid_t* h5memtype)
+herr_t convert_SD_Attrs(const BFcontext_t* ctx,int32 sd_id,hid_t h5parobj_id,char*h5obj_name,char*sds_name,char *ignore_attr_name)
 {
 
-    size_t h4memsize = 0;
-    switch (h4type)
+    int   i = 0;
+    intn  h4_status = 0;
+    int32 sds_id = 0;
+    int32 sds_index = 0;
+    int32 dim_sizes[H4_MAX_VAR_DIMS] = {0};
+    int32 rank = 0;
+    int32 data_type = 0;
+    int32 n_attrs = 0;
+    int32   n_values = 0;
+    char    dummy_sds_name[H4_MAX_NC_NAME] = {'\0'};
+    char    attr_name[H4_MAX_NC_NAME] = {'\0'};
+    char*   attr_values= NULL;
+    hid_t   h5obj_id = 0;
+    attrStage_t stage;
+
+
+    if(sds_name == NULL)
+        sds_id = sd_id;
+    else
     {
+        sds_index = SDnametoindex(sd_id,sds_name);
+        sds_id = SDselect (sd_id, sds_index);
+    }
 
-    case DFNT_CHAR8:
+    h4_status = SDgetinfo (sds_id, dummy_sds_name, &rank, dim_sizes,
+                           &data_type, &n_attrs);
+    if ( h4_status == -1 )
+    {
+        FATAL_MSG("Failed to get dataset info.\n");
+        if ( sds_id ) SDendaccess(sds_id);
+        return -1;
+    }
 
-        
-        h4memsize = sizeof(int8);
-        /* assume DFNT_CHAR8 C type character. */
-        *h5memtype = H5T_STRING;
-        //if(h5type) *h5type =  H5T_STRING;
-        break;
+    /* Collect all the attributes first, then write them to the HDF5 object in one pass */
+    h5obj_id = H5Oopen(h5parobj_id,h5obj_name,H5P_DEFAULT);
+    if ( h5obj_id < 0 )
+    {
+        FATAL_MSG("Failed to open the HDF5 object %s.\n", h5obj_name);
+        if(sds_name != NULL) SDendaccess(sds_id);
+        return -1;
+    }
+    initAttrStage(ctx,&stage,h5obj_id);
 
-    case DFNT_UCHAR8:
+    for( i = 0; i <n_attrs; i++)
+    {
+        h4_status = SDattrinfo (sds_id, i, attr_name, &data_type, &n_values);
+        if(ignore_attr_name != NULL && strcmp(ignore_attr_name,attr_name)==0)
+            continue;
+        attr_values = malloc(n_values*DFKNTsize(data_type));
+        h4_status = SDreadattr (sds_id, i, attr_values);
+        stageH4Attr(&stage,data_type,n_values,attr_name,attr_values);
+        free (attr_values);
+    }
 
-        h4memsize = sizeof(int8);
-        *h5memtype = H5T_STRING;
-        //if(h5type) *h5type = H5T_STRING;
-        break;
+    h4_status = flushAttrStage(&stage);
+    H5Oclose(h5obj_id);
 
-    case DFNT_INT8:
+    if(sds_name != NULL)
+        SDendaccess(sds_id);
+    if ( h4_status == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the attributes of %s.\n", h5obj_name);
+        return -1;
+    }
+    return 0;
+}
 
-        
-        //if(h5type) *h5type = H5T_STD_I8BE;
-        h4memsize = sizeof(int8);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype = H5T_NATIVE_SCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
-        {
-            FATAL_MSG("cannot convert signed INT8\n");
-            return FAIL;
-        }
-        break;
+herr_t copy_h5_attrs(const BFcontext_t* ctx,int32 h4_type,int32 n_values,char* attr_name,char* attr_value,hid_t par_id, char* h5obj_name)
+{
+    hid_t h5obj_id = 0;
+    herr_t ret = 0;
+    attrStage_t stage;
 
-    case DFNT_UINT8:
+    h5obj_id = H5Oopen(par_id,h5obj_name,H5P_DEFAULT);
+    if ( h5obj_id < 0 )
+        return -1;
 
-        
-        //if(h5type) *h5type = H5T_STD_U8BE;
-        h4memsize = sizeof(int8);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else
-        {
-            FATAL_MSG("cannot convert unsigned INT8\n");
-            return FAIL;
-        }
-        break;
+    initAttrStage(ctx,&stage,h5obj_id);
+    ret = stageH4Attr(&stage,h4_type,n_values,attr_name,attr_value);
+    if ( ret == RET_SUCCESS )
+        ret = flushAttrStage(&stage);
+    else
+        discardAttrStage(&stage);
 
-    case DFNT_NINT8:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting result may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_SCHAR;
-        h4memsize = sizeof(int8);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_SCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
-        {
-            FATAL_MSG("cannot convert native INT8\n");
-            return FAIL;
-        }
-        break;
+    H5Oclose(h5obj_id);
+    return ret < 0 ? -1 : 0;
+}
+
+
+herr_t H4readSDSAttr( int32 h4FileID, char* datasetName, char* attrName, void* buffer )
+{
+    int32 statusn = 0;
+    int32 dsetIndex = SDnametoindex(h4FileID,datasetName);
+    if ( dsetIndex < 0 )
+    {
+        FATAL_MSG("Failed to get dataset index.\n");
+        return FATAL_ERR;
+    }
+    int32 dsetID = SDselect(h4FileID, dsetIndex);
+    if ( dsetID < 0 )
+    {
+        FATAL_MSG("Failed to get dataset ID.\n");
+        return FATAL_ERR;
+    }
+    int32 attrIdx = SDfindattr(dsetID,attrName);
+    if ( attrIdx < 0 )
+    {
+        FATAL_MSG("Failed to get attribute index.\n");
+        return FATAL_ERR;
+    }
+    statusn = SDreadattr(dsetID,attrIdx,(VOIDP) buffer );
+    if ( statusn < 0 )
+    {
+        FATAL_MSG("Failed to read attribute.\n");
+        return FATAL_ERR;
+    }
+
+    return RET_SUCCESS;
+}
+
+/*
+        copyAttrFromName
+
+ DESCRIPTION:
+    This function copies the attribute attrName located at the HDF4 object inObjID to the 
+    HDF5 object outObjID.
+
+ ARGUMENTS:
+    IN
+        int32 inFileID          -- The input HDF4 file
+        const char* inObjID     -- The name of the dataset where attrName is located.
+        const char* attrName    -- The name of the attribute to be copied
+    OUT
+        hid_t outObjID          -- Where the attribute will be copied to.
+
+ EFFECTS:
+    Adds an attribute to the object outObjID
+
+ RETURN:
+    FATAL_ERR
+    RET_SUCCESS
+
+*/
+herr_t copyAttrFromName( int32 inFileID, const char* inObjName, const char* attrName, hid_t outObjID )
+{
+    int32 attrIdx = 0;
+    herr_t retVal = RET_SUCCESS;
+    intn statusn = 0;
+    int32 ntype = 0;
+    int32 count = 0;
+    int statusi = 0;
+    hid_t h5TypeOld = 0;
+    void* attrBuf = NULL;
+    hid_t attrDataspace = 0;
+    hid_t attrID = 0;
+    herr_t statuse = 0;
+    hid_t h5TypeNew = 0;
+    int32 sds_index = 0;
+    int32 sds_id = 0;
+
+    // OPEN THE INPUT DATASET
+    /* get the index of the dataset from the dataset's name */
+    sds_index = SDnametoindex( inFileID, inObjName );
+    if( sds_index < 0 )
+    {
+        FATAL_MSG("SDnametoindex: Failed to get index of dataset.\n");
+        return FATAL_ERR;
+    }
+    // Select the dataset
+    sds_id = SDselect( inFileID, sds_index );
+    if ( sds_id < 0 )
+    {
+        FATAL_MSG("SDselect: Failed to select dataset.\n");
+        return FATAL_ERR;
+    }
+    // Find the index of the attribute
+    attrIdx = SDfindattr( sds_id, attrName );
+    if ( attrIdx == FAIL )
+    {
+        FATAL_MSG("Failed to find the attribute.\n");
+        goto cleanupFail;
+    }
+
+    // Get info on the attribute
+    char dummy[STR_LEN];
+    statusn = SDattrinfo( sds_id, attrIdx, dummy, &ntype, &count );
+    if ( statusn == FAIL )
+    {
+        FATAL_MSG("Failed to obtain attribute info.\n");
+        goto cleanupFail;
+    }
+
+    // Find the corresponding HDF5 datatype
+    statusi = h4type_to_h5type( ntype, &h5TypeOld );
+    if ( statusi == FAIL )
+    {
+        FATAL_MSG("Failed to obtain the HDF5 datatype.\n");
+        goto cleanupFail;
+    }
+
+    // Need to convert the datatype to a string of the appropriate length
+    if ( h5TypeOld == H5T_STRING )
+    {
+        h5TypeNew = H5Tcopy(H5T_C_S1);
+        H5Tset_size( h5TypeNew, count );
+    }    
+    else
+        h5TypeNew = h5TypeOld;
+
+    // Allocate attribute buffer
+    size_t size = H5Tget_size(h5TypeNew);
+    if ( size == 0 )
+    {
+        FATAL_MSG("Failed to get size of datatype.\n");
+        goto cleanupFail;
+    }
+    
+    if ( h5TypeOld == H5T_STRING ) size = 1;
+
+    attrBuf = calloc( count + 1, size );
+
+    // Read the attribute
+    statusn = SDreadattr( sds_id, attrIdx, attrBuf );
+    if ( statusn == FAIL )
+    {
+        FATAL_MSG("Failed to read the attribute.\n");
+        goto cleanupFail;
+    }
+
+    // Create a simple dataspace for the attribute
+    // We only want one string of length count, so temp_hsize will just be 1
+    // KY: We also find some attributes that use other types,so we cannot hard-code
+    // those attriabute as size 1.
+    hsize_t temp_hsize = 1;
+    // Bad,  the whole routine needs to be rewrittedn, just make it work for now. KY
+    if(h5TypeOld != H5T_STRING) 
+        temp_hsize = count;
+    attrDataspace = H5Screate_simple( 1, &temp_hsize,  NULL );
+    if ( attrDataspace < 0 )
+    {
+        FATAL_MSG("Failed to create a dataspace.\n");
+        attrDataspace = 0;
+        goto cleanupFail;
+    }
+    
+    // Create an attribute
+    attrID = H5Acreate2( outObjID, attrName, h5TypeNew, attrDataspace, H5P_DEFAULT, H5P_DEFAULT ); 
+    if ( attrID < 0 )
+    {
+        FATAL_MSG("Failed to create an attribute.\n");
+        attrID = 0;
+        goto cleanupFail;
+    }
+
+    // Write the attribute
+    statuse = H5Awrite( attrID, h5TypeNew, attrBuf );
+    if ( statuse < 0 )
+    {
+        FATAL_MSG("Failed to write to attribute.\n");
+        goto cleanupFail;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        retVal = FATAL_ERR;
+    }
+
+    if ( attrBuf )          free(attrBuf);
+    if ( attrDataspace )    H5Sclose(attrDataspace);    
+    if ( attrID )           H5Aclose(attrID);
+    return retVal;    
+}
+
+/*                              getTime
+    DESCRIPTION:
+        This function takes a path (relative or absolute) to one of the instrument files
+        and returns a string containing the date information contained in the file name.
+        The string returned is allocated on the heap.
+
+            !!!NOTE!!!
+
+        IT IS THE DUTY OF THE CALLER
+        to free pathname when done to avoid memory leaks.
+
+        The instrument argument is defined as follows:
+        0 = MOPITT
+        1 = CERES
+        2 = MODIS
+        3 = ASTER
+        4 = MISR
+    ARGUMENTS:
+        char* pathname -- the pathname to the hdf file
+        int instrument -- an identifier specifying which instrument pathname refers to
+    EFFECTS:
+        Allocates a string on the heap and returns that string
+    RETURN:
+        A valid string upon success.
+        NULL upon failure.
+ */
+char* getTime( char* pathname, int instrument )
+{
+    char* retString = NULL;
+    char* start = NULL;
+    char* end = NULL;
+    int len = 0;
+
+    /**********
+     * MOPITT *
+     **********/
+    if ( instrument == 0 )
+    {
+        start = strstr ( pathname, "MOP01-" );
+        if ( start == NULL )
+        {
+            FATAL_MSG("Expected MOPITT path.\n\tReceived \"%s\"\n", pathname);
+            return NULL;
+        }
+
+        /* start is now pointing to the 'M'. We need to offset it to
+         * point to the beginning of the date in the filename. char is
+         * size 1, so we can simply offset it by 6
+         */
+        start += 6;
+        end = strstr( pathname, ".he5" );
+        if ( end == NULL )
+        {
+            FATAL_MSG("Error in reading the pathname for %s.\n","MOPITT");
+            return NULL;
+        }
+
+        /* end points to the '.'. Offset it by -1 */
+        end += -1;
+
+        /* We want just the 8 characters after start */
+        len = 8;
+        retString = calloc ( len+1,1 );
+        strncpy( retString, start, len);
+
+        return retString;
+    }
+
+    /* repeat the same general process for each instrument */
+
+    /*********
+     * CERES *
+     *********/
+    else if ( instrument == 1 )
+    {
+        start = strstr( pathname, "CER_" );
+        if ( start == NULL )
+        {
+            FATAL_MSG("Expected CERES path.\n\tReceived \"%s\"\n",pathname );
+            return NULL;
+        }
+
+        end = pathname + strlen( pathname ) - 1;
+
+        /* end should be pointing to a number. Do a check to make sure this is true. */
+        if ( *end < '0' || *end > '9' )
+        {
+            FATAL_MSG("Error in reading the pathname for %s.\n", "CERES" );
+            return NULL;
+        }
+
+        len = 10;
+        retString = calloc(len+1,1);
+        strncpy( retString, end-9, len );
+        return retString;
+
+    }
+
+    /*********
+     * MODIS *
+     *********/
+    else if ( instrument == 2 )
+    {
+        /* this do-while loop isn't actually a loop. I just want to be able to make use
+         * of "break" to avoid unecessary checks. It was either this or the use of
+         * goto. Couldn't think of an elegant way to do the following code using else-if
+         * statements.
+         */
+        do
+        {
+            start = strstr( pathname, "MOD021KM.A" );
+            if ( start != NULL )
+            {
+                start += 10;
+                break;
+            }
+
+            start = strstr( pathname, "MOD03.A" );
+            if ( start != NULL )
+            {
+                start += 7;
+                break;
+            }
+
+            start = strstr( pathname, "MOD02HKM.A" );
+            if ( start != NULL )
+            {
+                start += 10;
+                break;
+            }
+
+            start = strstr( pathname, "MOD02QKM.A" );
+            if ( start != NULL )
+            {
+                start += 10;
+                break;
+            }
+
+            FATAL_MSG("Expected MODIS path.\n\tReceived \"%s\"\n", pathname );
+            return NULL;
+
+        } while ( 0 );
+
+        len = 12;
+
+        retString = calloc(len+1,1);
+        strncpy( retString, start, len );
+        return retString;
+    }
+
+    /*********
+     * ASTER *
+     *********/
+    else if ( instrument == 3 )
+    {
+        start = strstr( pathname, "L1T_" );
+        if ( start == NULL )
+        {
+            FATAL_MSG("Expected ASTER path.\n\tReceived \"%s\"\n", pathname );
+            return NULL;
+        }
+
+        // Skip the version number
+        start += 7;
+        len = 14;
+        retString = calloc(len+1,1);
+        strncpy( retString, start, len);
+        return retString;
+    }
+
+    /********
+     * MISR *
+     ********/
+    else if ( instrument == 4 )
+    {
+        start = strstr( pathname, "MISR_" );
+        if ( start == NULL )
+        {
+            FATAL_MSG("Expected MISR path.\n\tReceived \"%s\"\n",pathname );
+            return NULL;
+        }
+
+        // Just want the orbit number
+        start += 32;
+        len = 6;
+        retString = calloc(len+1,1);
+        strncpy( retString, start, len);
+        return retString;
+    }
+
+    FATAL_MSG("Incorrect instrument argument.\n");
+
+    return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * The following function has been copied from the H4toH5 library.
+ * https://bitbucket.hdfgroup.org/projects/HDFEOS/repos/h4h5tools/browse/lib/src/h4toh5util.c
+ *
+    Function:    h4type_to_h5type
+
+    DESCRIPTION:
+        This function converts the given HDF4 datatype to an HDF5 datatype.
+    ARGUMENTS:
+        In:
+            const int32 h4type -- The input hdf4 datatype
+        Out:
+            hid_t* h5memtype -- The corresponding HDF5 datatype
+    EFFECTS:
+        Updates caller variable to contain correct HDF5 datatype
+    RETURN:
+        FAIL upon failure
+        SUCCEED upon success
+
+ */
+int  h4type_to_h5type(
+    const int32 h4type,
+    hid_t* h5memtype)
+{
+
+    size_t h4memsize = 0;
+    switch (h4type)
+    {
+
+    case DFNT_CHAR8:
+
+        
+        h4memsize = sizeof(int8);
+        /* assume DFNT_CHAR8 C type character. */
+        *h5memtype = H5T_STRING;
+        //if(h5type) *h5type =  H5T_STRING;
+        break;
+
+    case DFNT_UCHAR8:
+
+        h4memsize = sizeof(int8);
+        *h5memtype = H5T_STRING;
+        //if(h5type) *h5type = H5T_STRING;
+        break;
+
+    case DFNT_INT8:
+
+        
+        //if(h5type) *h5type = H5T_STD_I8BE;
+        h4memsize = sizeof(int8);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype = H5T_NATIVE_SCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert signed INT8\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_UINT8:
+
+        
+        //if(h5type) *h5type = H5T_STD_U8BE;
+        h4memsize = sizeof(int8);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert unsigned INT8\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NINT8:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting result may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_SCHAR;
+        h4memsize = sizeof(int8);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_SCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert native INT8\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NUINT8:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting result may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_UCHAR;
+        h4memsize = sizeof(int8);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert unsighed naive INT8\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LINT8:
+        
+        //if(h5type) *h5type = H5T_STD_I8LE;
+        h4memsize = sizeof(int8);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+
+            FATAL_MSG("cannot convert little-endian INT8\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LUINT8:
+        
+        //if(h5type) *h5type = H5T_STD_U8LE;
+        h4memsize = sizeof(int8);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian unsigned INT\n8");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_INT16:
+        
+        //if(h5type) *h5type = H5T_STD_I16BE;
+        h4memsize = sizeof(int16);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert signed int16\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_UINT16:
+        
+        //if(h5type) *h5type = H5T_STD_U16BE;
+        h4memsize = sizeof(int16);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert unsigned int16\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NINT16:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting result may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_SHORT;
+        h4memsize = sizeof(int16);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert native int16\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NUINT16:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting result may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_USHORT;
+        h4memsize = sizeof(int16);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert unsigned native int16\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LINT16:
+        
+        //if(h5type) *h5type = H5T_STD_I16LE;
+        h4memsize = sizeof(int16);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian int16\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LUINT16:
+        
+        //if(h5type) *h5type = H5T_STD_U16LE;
+        h4memsize = sizeof(int16);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian unsigned int16\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_INT32:
+        
+        //if(h5type) *h5type = H5T_STD_I32BE;
+        h4memsize = sizeof(int32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert signed int32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_UINT32:
+        
+        //if(h5type) *h5type = H5T_STD_U32BE;
+        h4memsize = sizeof(int32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert unsigned int32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NINT32:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting result may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_INT;
+        h4memsize = sizeof(int32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert native signed int32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NUINT32:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting results may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_UINT;
+        h4memsize = sizeof(int32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert signed int32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LINT32:
+        
+        //if(h5type) *h5type = H5T_STD_I32LE;
+        h4memsize = sizeof(int32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian signed int32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LUINT32:
+        
+        //if(h5type) *h5type = H5T_STD_U32LE;
+        h4memsize = sizeof(int32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian unsigned int32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_INT64:
+        
+        //if(h5type) *h5type = H5T_STD_I64BE;
+        h4memsize = sizeof(long);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
+            *h5memtype = H5T_NATIVE_LLONG;
+        else
+        {
+            FATAL_MSG("cannot convert signed int64\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_UINT64:
+        
+        //if(h5type) *h5type = H5T_STD_U64BE;
+        h4memsize = sizeof(long);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
+            *h5memtype = H5T_NATIVE_ULLONG;
+        else
+        {
+            FATAL_MSG("cannot convert unsigned int64\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NINT64:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting result may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_INT;
+        h4memsize = sizeof(long);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
+            *h5memtype = H5T_NATIVE_LLONG;
+        else
+        {
+            FATAL_MSG("cannot convert native signed int64");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NUINT64:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting results may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_UINT;
+        h4memsize = sizeof(long);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
+            *h5memtype = H5T_NATIVE_ULLONG;
+        else
+        {
+            FATAL_MSG("cannot convert signed int64\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LINT64:
+        
+        //if(h5type) *h5type = H5T_STD_I64LE;
+        h4memsize = sizeof(long);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_CHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_SHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_INT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_LONG;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
+            *h5memtype = H5T_NATIVE_LLONG;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian signed int64\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LUINT64:
+        
+        //if(h5type) *h5type = H5T_STD_U64LE;
+        h4memsize = sizeof(long);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
+            *h5memtype =  H5T_NATIVE_UCHAR;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
+            *h5memtype = H5T_NATIVE_USHORT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
+            *h5memtype = H5T_NATIVE_UINT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
+            *h5memtype = H5T_NATIVE_ULONG;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
+            *h5memtype = H5T_NATIVE_ULLONG;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian unsigned int64\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_FLOAT32:
+        
+        //if(h5type) *h5type = H5T_IEEE_F32BE;
+        h4memsize = sizeof(float32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
+            *h5memtype = H5T_NATIVE_FLOAT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
+            *h5memtype = H5T_NATIVE_DOUBLE;
+        else
+        {
+            FATAL_MSG("cannot convert float32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_FLOAT64:
+        
+        //if(h5type) *h5type = H5T_IEEE_F64BE;
+        h4memsize = sizeof(float64);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
+            *h5memtype = H5T_NATIVE_FLOAT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
+            *h5memtype = H5T_NATIVE_DOUBLE;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LDOUBLE))
+            *h5memtype = H5T_NATIVE_LDOUBLE;
+        else
+        {
+            FATAL_MSG("cannot convert float64\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NFLOAT32:
+        /*printf("warning, Native HDF datatype is encountered");
+        printf(" the converting results may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_FLOAT;
+        h4memsize = sizeof(float32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
+            *h5memtype = H5T_NATIVE_FLOAT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
+            *h5memtype = H5T_NATIVE_DOUBLE;
+        else
+        {
+            FATAL_MSG("cannot convert native float32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_NFLOAT64:
+        /*    printf("warning, Native HDF datatype is encountered");
+            printf(" the converting result may not be correct.\n");*/
+        
+        //if(h5type) *h5type = H5T_NATIVE_DOUBLE;
+        h4memsize = sizeof(float64);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
+            *h5memtype = H5T_NATIVE_FLOAT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
+            *h5memtype = H5T_NATIVE_DOUBLE;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LDOUBLE))
+            *h5memtype = H5T_NATIVE_LDOUBLE;
+        else
+        {
+            FATAL_MSG("cannot convert native float64\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LFLOAT32:
+        
+        //if(h5type) *h5type = H5T_IEEE_F32LE;
+        h4memsize = sizeof(float32);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
+            *h5memtype = H5T_NATIVE_FLOAT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
+            *h5memtype = H5T_NATIVE_DOUBLE;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian float32\n");
+            return FAIL;
+        }
+        break;
+
+    case DFNT_LFLOAT64:
+        
+        //if(h5type) *h5type = H5T_IEEE_F64LE;
+        h4memsize = sizeof(float64);
+        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
+            *h5memtype = H5T_NATIVE_FLOAT;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
+            *h5memtype = H5T_NATIVE_DOUBLE;
+        else if(h4memsize == H5Tget_size(H5T_NATIVE_LDOUBLE))
+            *h5memtype = H5T_NATIVE_LDOUBLE;
+        else
+        {
+            FATAL_MSG("cannot convert little-endian float64\n");
+            return FAIL;
+        }
+        break;
+
+    default:
+    {
+        FATAL_MSG("cannot find the corresponding datatype in HDF5.\nReceived type was: %d\n", h4type);
+        return FAIL;
+    }
+    }
+    return SUCCEED;
+}
+
+/****************change_dim_attr_NAME_value*******************************
+*
+* Source: h4h5tools
+    https://bitbucket.hdfgroup.org/projects/HDFEOS/repos/h4h5tools/browse/lib/src/h4toh5sds.c
+*
+* Function:     change_dim_attr_NAME_value
+* Purpose:      change dimension NAME attribute value to follow the netCDF-4 data model
+*
+* Return:       FAIL if failed, SUCCEED if successful.
+*
+* In :
+*
+                ctx:               The conversion context, for the string datatype (see getStringType)
+                h5dset_id:         HDF5 dataset ID this attribute is attached.
+*-------------------------------------------------------------------------
+*/
+
+
+int change_dim_attr_NAME_value( const BFcontext_t* ctx, hid_t h5dset_id )
+{
+
+    hid_t tid = -1;
+    hid_t sid = -1;
+    hid_t aid = -1;
+
+    /* Assign the attribute value for NAME to follow netCDF-4 data model. */
+    char attr_value[] = PURE_DIM_NAME_VALUE;
+
+
+    /* Delete the original attribute. Scales made with H5DSset_scale( id, NULL ) have none. */
+    if(H5Aexists(h5dset_id,"NAME") > 0 && H5Adelete(h5dset_id,"NAME") <0)
+    {
+        FATAL_MSG("cannot delete HDF5 attribute NAME\n");
+        return FAIL;
+    }
+
+    /* The shared string type of getStringType must not be closed */
+    if((tid = getStringType(ctx, strlen(attr_value) + 1)) == FATAL_ERR)
+    {
+        FATAL_MSG("cannot create the datatype of HDF5 attribute NAME\n");
+        return FAIL;
+    }
+
+    if((sid = H5Screate(H5S_SCALAR))<0)
+    {
+        FATAL_MSG("cannot create the dataspace of HDF5 attribute NAME\n");
+        return FAIL;
+    }
+
+    /* Create and write a new attribute. */
+    if ((aid = H5Acreate(h5dset_id, "NAME", tid, sid, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+    {
+        FATAL_MSG("cannot create HDF5 attribute NAME");
+        H5Sclose(sid);
+        return FAIL;
+    }
+
+    if (H5Awrite(aid, tid, (void*)attr_value) <0)
+    {
+        FATAL_MSG("cannot write HDF5 attribute NAME");
+        H5Sclose(sid);
+        H5Aclose(aid);
+        return FAIL;
+    }
+
+
+    if (aid != -1)
+        H5Aclose(aid);
+    if (sid != -1)
+        H5Sclose(sid);
+
+    return SUCCEED;
+}
+
+
+
+
+/*
+            copyDimension
+
+    DESCRIPTION:
+        This function copies the dimension scales from the HDF4 object to the HDF5 object.
+        If the dimension scale does not yet exist in the HDF5 file, it is created. If it does exist, the
+        HDF5 object will have its dimensions attached to the appropriate scale.
+
+    ARGUMENTS:
+        IN
+            BFcontext_t* ctx     -- The conversion context, for the dimension scale registry
+            char* dimSuffix      -- Name of the output dimension scale. Datasets passed to this function should be
+                                     given a unique dimension scale name in the case that their HDF4 dimensions have the
+                                     same name (across multiple HDF4 files) but are not identical dimensions (different
+                                     dimension size, different values inside the dimension). This string will be appended
+                                     to the name of the input HDF4 dataset in the output HDF5 dataset. For instance, if
+                                     the input HDF4 dimension is named:
+                                        "inHDF4dimName"
+                                     and dimSuffix is:
+                                        "_g1"
+                                     The name of the dimension in the HDF5 file will be:
+                                        "inHDF4dimName_g1"
+
+                                     Pass NULL in for this argument if a unique dimension is not required. If NULL is passed,
+                                     this function will attempt to share the generated HDF5 dimension for all objects that
+                                     reference it in the input HDF4 files.
+
+                                     This string must be null terminated, or else a seg fault may occur.
+
+            int32 h4fileID        -- The HDF4 file ID returned by SDstart
+            char* h4datasetName   -- The name of the HDF4 dataset from which to copy from
+            hid_t h5dimGroupID    -- The HDF5 group ID in which to store and/or find the dimension scales
+            hid_t h5dsetID        -- The HDF5 dataset ID in which to attach dimension scales
+
+    EFFECTS:
+        Creates dimension scale if it doesn't exist under the h5dimGroupID group. Attaches the dimension scale
+        to the h5dsetID dataset.
+
+    RETURN:
+        FAIL upon failure.
+        SUCCEED upon success.
+
+*/
+
+herr_t copyDimension( BFcontext_t* ctx, char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID )
+{
+    hsize_t tempInt = 0;
+    char* correct_dsetname = NULL;
+    char* dimName = NULL;
+    herr_t errStatus = 0;
+    int32 ntype = 0;
+    int32 h4dsetID = 0;
+    intn statusn = 0;
+    int rank = 0;
+    int status = 0;
+    hid_t h5dimID = 0;
+    void *dimBuffer = NULL;
+    short fail = 0;
+    hid_t memspace = 0;
+    htri_t dsetExists = 0;
+    short wasHardCodeCopy = 0;
+    char* catString = NULL;
+    char* temp = NULL;
+    char tempStack[STR_LEN] = {'\0'};
+
+    /* Get dataset index */
+    int32 sds_index = SDnametoindex(h4fileID, h4datasetName );
+    if ( sds_index == FAIL )
+    {
+        FATAL_MSG("Failed to get SD index.\n");
+        goto cleanupFail;
+    }
+    /* select the dataset */
+    h4dsetID = SDselect(h4fileID, sds_index);
+    if ( h4dsetID == FAIL )
+    {
+        h4dsetID = 0;
+        FATAL_MSG("Failed to select the HDF4 dataset.\n");
+        goto cleanupFail;
+    }
+
+    /* get the rank of the dataset so we know how many dimensions to copy */
+    statusn = SDgetinfo(h4dsetID, NULL, &rank, NULL, NULL, NULL );
+    if ( statusn == FAIL )
+    {
+        FATAL_MSG("Failed to get SD info.\n");
+        goto cleanupFail;
+    }
+
+
+    int32 dim_index;
+
+    // COPY OVER DIMENSION SCALES TO HDF5 OBJECT
+    dimName = calloc(500, 1);
+    int32 size = 0;
+    int32 num_attrs = 0;
+    hid_t h5type = 0;
+    int32 h4dimID = 0;
+
+    for ( dim_index = 0; dim_index < rank; dim_index++ )
+    {
+        // Get the dimension ID
+        h4dimID = SDgetdimid ( h4dsetID, dim_index );
+        if ( h4dimID == FAIL )
+        {
+            FATAL_MSG("Failed to get dimension ID.\n");
+            h4dimID = 0;
+            goto cleanupFail;
+        }
+
+
+        /* get various useful info about this dimension */
+        statusn = SDdiminfo( h4dimID, dimName, &size, &ntype, &num_attrs );
+        //int32 dimRank = 0;
+        //int32 dimSizes = 0;
+        //statusn = SDgetinfo( h4dimID, dimName, &dimRank, &dimSizes, &ntype, &num_attrs);
+        if ( statusn == FAIL )
+        {
+            FATAL_MSG("Failed to get dimension info.\n");
+            goto cleanupFail;
+        }
+
+
+        /* If dimSuffix is provided, we need to append this string to the dimName variable.*/
+       
+        correct_dsetname = correct_name(dimName);
+
+        if ( dimSuffix ) 
+        {
+            // store allocated memory in temp pointer
+            strcpy(tempStack, dimName);
+            temp = calloc ( sizeof(tempStack) + sizeof(dimSuffix) + 1, 1 );
+            // copy dimName to the temp pointer memory
+            strcpy(temp, tempStack);
+            // concatenate dimName with dimSuffix
+            strcat(temp,dimSuffix);
+            // Fix the name to comply with netCDF standards
+            catString = correct_name(temp);
+            // free the temp memory (catString is separately allocated memory, malloc'ed in the correct_name function
+            free(temp); temp = NULL;
+        }
+        else
+        {
+            catString = correct_name(dimName);
+        }
+        /* Since dimension scales are shared, it is possible this dimension already exists in HDF5 file (previous
+           call to this function created it). Check to see if it does. If so, use the dimension that eixsts.
+        */
+        
+        free(correct_dsetname); correct_dsetname = NULL;
+
+        dsetExists = H5Lexists(h5dimGroupID, catString, H5P_DEFAULT);
+        // if dsetExists is <= 0, then dimension does not yet exist.
+        if ( dsetExists <= 0 )
+        {
+            /* If the dimension is one of the following, we will do an explicit dimension scale copy (hard code
+             * the scale values)
+             */
+            if ( strstr( catString, "Band_250M" ) != NULL )
+            {
+                tempInt = 2;
+                float floatBuffer[2] = {1.0f, 2.0f};
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                /* The dimensions in this if else chain are pure dimensions in HDF4, but we want to convert them to a real
+                 * dimension in the HDF5 file. Set this flag to 1 to indicate that the final result IS a real dimension.
+                 * Flag will be used to prevent setting the NAME attribute downstream
+                 */
+                wasHardCodeCopy = 1;
+            }
+            else if ( strstr( catString, "Band_500M" ) != NULL )
+            {
+                tempInt = 5;
+                float floatBuffer[5] = {3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                wasHardCodeCopy = 1;
+            }
+            else if ( strstr( catString, "Band_1KM_RefSB" ) != NULL )
+            {
+                float floatBuffer[15] = { 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 13.5f, 14.0f, 14.5f, 15.0f, 16.0f, 17.0f, 18.0f, 19.0f, 26.0f };
+                tempInt = 15;
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                wasHardCodeCopy = 1;
+            }
+            else if ( strstr( catString, "Band_1KM_Emissive" ) != NULL )
+            {
+                float floatBuffer[16] = { 20.0f, 21.0f, 22.0f, 23.0f, 24.0f, 25.0f, 27.0f, 28.0f, 29.0f, 30.0f, 31.0f, 32.0f, 33.0f, 34.0f, 35.0f, 36.0f };
+                tempInt = 16;
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                wasHardCodeCopy = 1;
+            }
+
+            /* Else, the dimension is none of those listed. Do a normal copy by reading scale values from
+               the input file (a non-hard coded copy)
+             */
+            else
+            {
+                wasHardCodeCopy = 0;
+                /* SDdiminfo will return 0 for ntype if the dimension has no scale information. This is the case when
+                   it is a pure dimension.  We need two separate cases for when it is and is not a pure dim
+                */
+
+                if ( ntype != 0 )
+                {
+                    /* get the correct HDF5 datatype from ntype */
+                    status = h4type_to_h5type( ntype, &h5type );
+                    if ( status != 0 )
+                    {
+                        FATAL_MSG("Failed to convert HDF4 to HDF5 datatype.\n");
+                        goto cleanupFail;
+                    }
+
+                    /* read the dimension scale into a buffer */
+                    dimBuffer = malloc(size);
+                    //int32 start[1] = {0};
+                    //int32 stride[1] = {1};
+                    //statusn = SDreaddata( h4dimID, start, stride, &dimSizes, dimBuffer );
+                    statusn = SDgetdimscale(h4dimID, dimBuffer);
+                    if ( statusn != 0 )
+                    {
+                        FATAL_MSG("Failed to get dimension scale.\n");
+                        goto cleanupFail;
+                    }
+
+                    /* make a new dataset for our dimension scale */
+
+                    tempInt = size;
+                    h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, h5type, catString, dimBuffer);
+                    if ( h5dimID == FATAL_ERR )
+                    {
+                        h5dimID = 0;
+                        FATAL_MSG("Failed to insert dataset.\n");
+                        goto cleanupFail;
+                    }
+
+                    free(dimBuffer);
+                    dimBuffer = NULL;
+                }
+
+                else
+                {
+                    hsize_t tempSize2 = 0;
+
+                    tempSize2 = (hsize_t) size;
+                    memspace = H5Screate_simple( 1, &tempSize2, NULL );
+
+                    h5dimID = H5Dcreate( h5dimGroupID, catString, H5T_NATIVE_INT, memspace,
+                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+                    if ( h5dimID < 0 )
+                    {
+                        FATAL_MSG("Failed to create dataset.\n");
+                        h5dimID = 0;
+                        goto cleanupFail;
+                    }
+
+                    H5Sclose(memspace);
+                    memspace = 0;
+
+                } // end else
+            } // end else
+
+            /* A pure dimension gets its NAME from change_dim_attr_NAME_value below */
+            errStatus = H5DSset_scale(h5dimID, ( ntype == 0 && !wasHardCodeCopy ) ? NULL : catString);
+            if ( errStatus != 0 )
+            {
+                FATAL_MSG("Failed to set dataset as a dimension scale.\n");
+                goto cleanupFail;
+            }
+
+
+            /* Correct the NAME attribute of the pure dimension to conform with netCDF
+               standards.
+            */
+            if ( ntype == 0 && !wasHardCodeCopy )
+            {
+                statusn = change_dim_attr_NAME_value(ctx,h5dimID);
+                if ( statusn == FAIL )
+                {
+                    FATAL_MSG("Failed to change the NAME attribute of a dimension.\n");
+                    goto cleanupFail;
+                }
+            }
+        } // end if ( dsetExists <= 0 )
+
+        else
+        {
+            h5dimID = H5Dopen2(h5dimGroupID, catString, H5P_DEFAULT);
+            if ( h5dimID < 0 )
+            {
+                h5dimID = 0;
+                FATAL_MSG("Failed to open dataset.\n");
+                goto cleanupFail;
+            }
+        }
+
+
+        errStatus = registerDimScale(ctx,h5dsetID, h5dimID, dim_index);
+        if ( errStatus != 0 )
+        {
+            FATAL_MSG("Failed to attach dimension scale.\n");
+            goto cleanupFail;
+        }
+
+        free(correct_dsetname);
+        correct_dsetname = NULL;
+        H5Dclose(h5dimID);
+        h5dimID = 0;
+        free(catString); catString = NULL;
+    }   // end for loop
+
+    fail = 0;
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    if ( dimName ) free ( dimName );
+    if ( h5dimID ) H5Dclose(h5dimID);
+    if ( dimBuffer ) free(dimBuffer);
+    if ( correct_dsetname ) free(correct_dsetname);
+    if ( memspace ) H5Sclose(memspace);
+    if ( catString ) free(catString);
+    if ( temp ) free(temp);
+
+    if ( fail ) return FAIL;
+
+    return SUCCEED;
+
+}
+
+/*
+            copyDimensionSubset
+
+    TODO
+        This function documentation needs to be fixed. This was just copied over from the copyDimension
+
+    DESCRIPTION:
+        This function copies the dimension scales from the HDF4 object to the HDF5 object.
+        If the dimension scale does not yet exist in the HDF5 file, it is created. If it does exist, the
+        HDF5 object will have its dimensions attached to the appropriate scale.
+
+        
+
+    ARGUMENTS:
+        IN
+            BFcontext_t* ctx     -- The conversion context, for the dimension scale registry
+            char* dimSuffix      -- Name of the output dimension scale. Datasets passed to this function should be
+                                     given a unique dimension scale name in the case that their HDF4 dimensions have the
+                                     same name (across multiple HDF4 files) but are not identical dimensions (different
+                                     dimension size, different values inside the dimension). This string will be appended
+                                     to the name of the input HDF4 dataset in the output HDF5 dataset. For instance, if
+                                     the input HDF4 dimension is named:
+                                        "inHDF4dimName"
+                                     and dimSuffix is:
+                                        "_g1"
+                                     The name of the dimension in the HDF5 file will be:
+                                        "inHDF4dimName_g1"
+
+                                     Pass NULL in for this argument if a unique dimension is not required. If NULL is passed,
+                                     this function will attempt to share the generated HDF5 dimension for all objects that
+                                     reference it in the input HDF4 files.
+
+                                     This string must be null terminated, or else a seg fault may occur.
+
+            int32 h4fileID        -- The HDF4 file ID returned by SDstart
+            char* h4datasetName   -- The name of the HDF4 dataset from which to copy from
+            hid_t h5dimGroupID    -- The HDF5 group ID in which to store and/or find the dimension scales
+            hid_t h5dsetID        -- The HDF5 dataset ID in which to attach dimension scales
+            int32 s_size          -- The subset size
+
+    EFFECTS:
+        Creates dimension scale if it doesn't exist under the h5dimGroupID group. Attaches the dimension scale
+        to the h5dsetID dataset.
+
+    RETURN:
+        FAIL upon failure.
+        SUCCEED upon success.
+
+*/
+herr_t copyDimensionSubset( BFcontext_t* ctx, char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID,
+                            int32 s_size )
+{
+    hsize_t tempInt = 0;
+    char* dimName = NULL;
+    herr_t errStatus = 0;
+    int32 ntype = 0;
+    int32 h4dsetID = 0;
+    intn statusn = 0;
+    int rank = 0;
+    int status = 0;
+    hid_t h5dimID = 0;
+    void *dimBuffer = NULL;
+    short fail = 0;
+    hid_t memspace = 0;
+    htri_t dsetExists = 0;
+    short wasHardCodeCopy = 0;
+
+    char* correct_dimName = NULL;
+    char* output_dim_name = NULL;
+
+    /* Get dataset index */
+    int32 sds_index = SDnametoindex(h4fileID, h4datasetName );
+    if ( sds_index == FAIL )
+    {
+        FATAL_MSG("Failed to get SD index.\n");
+        goto cleanupFail;
+    }
+    /* select the dataset */
+    h4dsetID = SDselect(h4fileID, sds_index);
+    if ( h4dsetID == FAIL )
+    {
+        h4dsetID = 0;
+        FATAL_MSG("Failed to select the HDF4 dataset.\n");
+        goto cleanupFail;
+    }
+
+    /* get the rank of the dataset so we know how many dimensions to copy */
+    statusn = SDgetinfo(h4dsetID, NULL, &rank, NULL, NULL, NULL );
+    if ( statusn == FAIL )
+    {
+        FATAL_MSG("Failed to get SD info.\n");
+        goto cleanupFail;
+    }
+
+
+    int32 dim_index;
+
+    // COPY OVER DIMENSION SCALES TO HDF5 OBJECT
+    dimName = calloc(500, 1);
+    int32 size = 0;
+    int32 num_attrs = 0;
+    hid_t h5type = 0;
+    int32 h4dimID = 0;
+
+    for ( dim_index = 0; dim_index < rank; dim_index++ )
+    {
+        // Get the dimension ID
+        h4dimID = SDgetdimid ( h4dsetID, dim_index );
+        if ( h4dimID == FAIL )
+        {
+            FATAL_MSG("Failed to get dimension ID.\n");
+            h4dimID = 0;
+            goto cleanupFail;
+        }
+
+        /* get various useful info about this dimension */
+        statusn = SDdiminfo( h4dimID, dimName, &size, &ntype, &num_attrs );
+        if ( statusn == FAIL )
+        {
+            FATAL_MSG("Failed to get dimension info.\n");
+            goto cleanupFail;
+        }
+
+        size = s_size;
+
+        correct_dimName = correct_name(dimName);
+
+        // Now we need to add the granule number for this dimenson since each granule will be different.
+        if ( dimSuffix != NULL )
+        {
+            output_dim_name=calloc(strlen(correct_dimName) + 
+                                      strlen(dimSuffix) + 1, 1);
+
+            // Copy over the new dimension name
+            sprintf( output_dim_name, "%s%s", correct_dimName, dimSuffix );
+        }
+        else
+        {
+            // We have to calloc separately because free() will be called on both output_dim_name and correct_dimName
+            output_dim_name = calloc ( strlen(correct_dimName) + 1, 1 );
+            strncpy( output_dim_name, correct_dimName, strlen(correct_dimName) );
+        }
+
+        /* Since dimension scales are shared, it is possible this dimension already exists in HDF5 file (previous
+           call to this function created it). Check to see if it does. If so, use the dimension that eixsts.
+        */
+        dsetExists = H5Lexists(h5dimGroupID, output_dim_name, H5P_DEFAULT);
+
+        // if dsetExists is <= 0, then dimension does not yet exist.
+        if ( dsetExists <= 0 )
+        {
+            wasHardCodeCopy = 0;
+            /* SDdiminfo will return 0 for ntype if the dimension has no scale information. This is the case when
+               it is a pure dimension.  We need two separate cases for when it is and is not a pure dim
+            */
+
+            if ( ntype != 0 )
+            {
+                /* get the correct HDF5 datatype from ntype */
+                status = h4type_to_h5type( ntype, &h5type );
+                if ( status != 0 )
+                {
+                    FATAL_MSG("Failed to convert HDF4 to HDF5 datatype.\n");
+                    goto cleanupFail;
+                }
+
+                /* read the dimension scale into a buffer */
+                dimBuffer = malloc(size);
+                statusn = SDgetdimscale(h4dimID, dimBuffer);
+                if ( statusn != 0 )
+                {
+                    FATAL_MSG("Failed to get dimension scale.\n");
+                    goto cleanupFail;
+                }
+
+                /* make a new dataset for our dimension scale */
+
+                tempInt = size;
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, h5type, output_dim_name, dimBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+
+                free(dimBuffer);
+                dimBuffer = NULL;
+            }
+
+            else
+            {
+                hsize_t tempSize2 = 0;
+
+                tempSize2 = (hsize_t) size;
+                memspace = H5Screate_simple( 1, &tempSize2, NULL );
+
+                h5dimID = H5Dcreate( h5dimGroupID, output_dim_name, H5T_NATIVE_INT, memspace,
+                                     H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+                if ( h5dimID < 0 )
+                {
+                    FATAL_MSG("Failed to create dataset.\n");
+                    h5dimID = 0;
+                    goto cleanupFail;
+                }
+
+                H5Sclose(memspace);
+                memspace = 0;
+
+            } // end else
+
+            /* A pure dimension gets its NAME from change_dim_attr_NAME_value below */
+            errStatus = H5DSset_scale(h5dimID, ( ntype == 0 && !wasHardCodeCopy ) ? NULL : output_dim_name);
+            if ( errStatus != 0 )
+            {
+                FATAL_MSG("Failed to set dataset as a dimension scale.\n");
+                goto cleanupFail;
+            }
+
+
+            /* Correct the NAME attribute of the pure dimension to conform with netCDF
+               standards.
+            */
+            if ( ntype == 0 && !wasHardCodeCopy )
+            {
+                statusn = change_dim_attr_NAME_value(ctx,h5dimID);
+                if ( statusn == FAIL )
+                {
+                    FATAL_MSG("Failed to change the NAME attribute of a dimension.\n");
+                    goto cleanupFail;
+                }
+            }
+        } // end if ( dsetExists <= 0 )
+
+        else
+        {
+            h5dimID = H5Dopen2(h5dimGroupID, output_dim_name, H5P_DEFAULT);
+            if ( h5dimID < 0 )
+            {
+                h5dimID = 0;
+                FATAL_MSG("Failed to open dataset.\n");
+                goto cleanupFail;
+            }
+        }
+
+        errStatus = registerDimScale(ctx,h5dsetID, h5dimID, dim_index);
+        if ( errStatus != 0 )
+        {
+            FATAL_MSG("Failed to attach dimension scale.\n");
+            goto cleanupFail;
+        }
+
+        free(correct_dimName);
+        correct_dimName = NULL;
+        free(output_dim_name);
+        output_dim_name = NULL;
+        H5Dclose(h5dimID);
+        h5dimID = 0;
+    }   // end for loop
+
+    fail = 0;
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    // The following free, espeically free(dimName) may be an issue.
+    if ( dimName ) free ( dimName );
+    if ( h5dimID ) H5Dclose(h5dimID);
+    if ( dimBuffer ) free(dimBuffer);
+    if ( correct_dimName ) free(correct_dimName);
+    if ( memspace ) H5Sclose(memspace);
+    if ( fail ) return FAIL;
+
+    return SUCCEED;
+
+}
+
+herr_t attachDimension( BFcontext_t* ctx, hid_t fileID,char*dimname, hid_t dsetID,int dim_index)
+{
+
+    hid_t h5dimID = H5Dopen2(fileID, dimname, H5P_DEFAULT);
+    if ( h5dimID < 0 )
+    {
+        FATAL_MSG("Failed to open dataset.\n");
+        return FAIL;
+    }
+
+    if(registerDimScale(ctx,dsetID,h5dimID,dim_index))
+    {
+        FATAL_MSG("Failed to attach the dimension scale.\n");
+        H5Dclose(h5dimID);
+        return FAIL;
+    }
+    H5Dclose(h5dimID);
+    return SUCCEED;
+}
+
+/*
+                        registerDimScale
+    DESCRIPTION:
+        This function records that a dimension scale is attached to a dimension of a dataset. It replaces
+        H5DSattach_scale, which rewrites the REFERENCE_LIST attribute of the scale on every call and so becomes
+        quadratic when a scale is shared by hundreds of datasets. The recorded attachments are written by
+        flushDimScales, with one DIMENSION_LIST write per dataset and one REFERENCE_LIST write per scale.
+    ARGUMENTS:
+        BFcontext_t* ctx    -- The conversion context holding the registry
+        hid_t dsetID        -- The dataset
+        hid_t scaleID       -- The dimension scale (see H5DSset_scale)
+        unsigned int idx    -- The dimension of the dataset the scale is attached to
+    EFFECTS:
+        Adds an entry to the dimension registry. Holds a reference to the file of dsetID until the next
+        flushDimScales call.
+    RETURN:
+        FAIL on failure
+        SUCCEED on success
+*/
+
+/* The layout of a REFERENCE_LIST element, as written by H5DSattach_scale */
+typedef struct dimRefEntry
+{
+    hobj_ref_t ref;
+    int dimIndex;
+} dimRefEntry_t;
+
+herr_t registerDimScale( BFcontext_t* ctx, hid_t dsetID, hid_t scaleID, unsigned int idx )
+{
+    H5O_info_t dsetInfo;
+    H5O_info_t scaleInfo;
+    hid_t spaceID = 0;
+    int rank = 0;
+
+    if ( H5Oget_info( dsetID, &dsetInfo ) < 0 || H5Oget_info( scaleID, &scaleInfo ) < 0 )
+    {
+        FATAL_MSG("Failed to get the object info of the dataset or the dimension scale.\n");
+        return FAIL;
+    }
+    if ( dsetInfo.fileno != scaleInfo.fileno || dsetInfo.addr == scaleInfo.addr )
+    {
+        FATAL_MSG("The dimension scale must be another dataset in the same file.\n");
+        return FAIL;
+    }
+
+    spaceID = H5Dget_space( dsetID );
+    if ( spaceID < 0 )
+    {
+        FATAL_MSG("Failed to get the dataspace of the dataset.\n");
+        return FAIL;
+    }
+    rank = H5Sget_simple_extent_ndims( spaceID );
+    H5Sclose(spaceID);
+    if ( rank <= 0 || idx >= (unsigned int) rank )
+    {
+        FATAL_MSG("Dimension index %u is out of range.\n", idx);
+        return FAIL;
+    }
+
+    if ( ctx->dimRegistryNum == ctx->dimRegistrySize )
+    {
+        size_t newSize = ctx->dimRegistrySize ? 2 * ctx->dimRegistrySize : 256;
+        dimAttach_t* tempPtr = realloc( ctx->dimRegistry, newSize * sizeof(dimAttach_t) );
+        if ( tempPtr == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FAIL;
+        }
+        ctx->dimRegistry = tempPtr;
+        ctx->dimRegistrySize = newSize;
+    }
+
+    ctx->dimRegistry[ctx->dimRegistryNum].fileID = H5Iget_file_id( dsetID );
+    if ( ctx->dimRegistry[ctx->dimRegistryNum].fileID < 0 )
+    {
+        FATAL_MSG("Failed to get the file of the dataset.\n");
+        return FAIL;
+    }
+    ctx->dimRegistry[ctx->dimRegistryNum].dsetAddr = dsetInfo.addr;
+    ctx->dimRegistry[ctx->dimRegistryNum].scaleAddr = scaleInfo.addr;
+    ctx->dimRegistry[ctx->dimRegistryNum].dimIndex = idx;
+    ctx->dimRegistryNum++;
+
+    return SUCCEED;
+}
+
+static int compareByDataset( const void* a, const void* b )
+{
+    const dimAttach_t* x = a;
+    const dimAttach_t* y = b;
+
+    if ( x->fileID != y->fileID ) return x->fileID < y->fileID ? -1 : 1;
+    if ( x->dsetAddr != y->dsetAddr ) return x->dsetAddr < y->dsetAddr ? -1 : 1;
+    if ( x->dimIndex != y->dimIndex ) return x->dimIndex < y->dimIndex ? -1 : 1;
+    if ( x->scaleAddr != y->scaleAddr ) return x->scaleAddr < y->scaleAddr ? -1 : 1;
+    return 0;
+}
+
+static int compareByScale( const void* a, const void* b )
+{
+    const dimAttach_t* x = a;
+    const dimAttach_t* y = b;
+
+    if ( x->fileID != y->fileID ) return x->fileID < y->fileID ? -1 : 1;
+    if ( x->scaleAddr != y->scaleAddr ) return x->scaleAddr < y->scaleAddr ? -1 : 1;
+    if ( x->dsetAddr != y->dsetAddr ) return x->dsetAddr < y->dsetAddr ? -1 : 1;
+    if ( x->dimIndex != y->dimIndex ) return x->dimIndex < y->dimIndex ? -1 : 1;
+    return 0;
+}
+
+/* Write the DIMENSION_LIST attribute of one dataset from the registry entries first..last-1, which are sorted
+ * by dimension. References already in the attribute are kept.
+ */
+static herr_t writeDimensionList( const dimAttach_t* first, const dimAttach_t* last )
+{
+    hid_t dsetID = 0;
+    hid_t spaceID = 0;
+    hid_t attrID = 0;
+    hid_t attrType = 0;
+    hid_t attrSpace = 0;
+    hvl_t* oldList = NULL;
+    hvl_t* newList = NULL;
+    hsize_t rank = 0;
+    short fail = 0;
+
+    dsetID = H5Oopen_by_addr( first->fileID, first->dsetAddr );
+    if ( dsetID < 0 )
+    {
+        FATAL_MSG("Failed to open a dataset with attached dimension scales.\n");
+        dsetID = 0;
+        goto cleanupFail;
+    }
+    spaceID = H5Dget_space( dsetID );
+    attrType = H5Tvlen_create( H5T_STD_REF_OBJ );
+    if ( spaceID < 0 || attrType < 0 )
+    {
+        FATAL_MSG("Failed to get the dataspace or to create the DIMENSION_LIST type.\n");
+        if ( spaceID < 0 ) spaceID = 0;
+        if ( attrType < 0 ) attrType = 0;
+        goto cleanupFail;
+    }
+    rank = (hsize_t) H5Sget_simple_extent_ndims( spaceID );
+
+    oldList = calloc( rank, sizeof(hvl_t) );
+    newList = calloc( rank, sizeof(hvl_t) );
+    if ( oldList == NULL || newList == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+
+    if ( H5Aexists( dsetID, "DIMENSION_LIST" ) > 0 )
+    {
+        attrID = H5Aopen( dsetID, "DIMENSION_LIST", H5P_DEFAULT );
+        if ( attrID < 0 || H5Aread( attrID, attrType, oldList ) < 0 )
+        {
+            FATAL_MSG("Failed to read the DIMENSION_LIST attribute.\n");
+            if ( attrID < 0 ) attrID = 0;
+            goto cleanupFail;
+        }
+        H5Aclose(attrID); attrID = 0;
+        if ( H5Adelete( dsetID, "DIMENSION_LIST" ) < 0 )
+        {
+            FATAL_MSG("Failed to delete the DIMENSION_LIST attribute.\n");
+            goto cleanupFail;
+        }
+    }
+
+    for ( hsize_t dim = 0; dim < rank; dim++ )
+    {
+        size_t numNew = 0;
+        hobj_ref_t* refs = NULL;
+
+        for ( const dimAttach_t* entry = first; entry < last; entry++ )
+            if ( entry->dimIndex == dim )
+                numNew++;
+        if ( oldList[dim].len + numNew == 0 )
+            continue;
+
+        refs = malloc( (oldList[dim].len + numNew) * sizeof(hobj_ref_t) );
+        if ( refs == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
+        }
+        if ( oldList[dim].len )
+            memcpy( refs, oldList[dim].p, oldList[dim].len * sizeof(hobj_ref_t) );
+        newList[dim].p = refs;
+        newList[dim].len = oldList[dim].len;
+
+        for ( const dimAttach_t* entry = first; entry < last; entry++ )
+        {
+            int attached = 0;
+
+            if ( entry->dimIndex != dim )
+                continue;
+            for ( size_t j = 0; j < newList[dim].len && !attached; j++ )
+                attached = ( (haddr_t) refs[j] == entry->scaleAddr );
+            if ( !attached )
+                refs[newList[dim].len++] = (hobj_ref_t) entry->scaleAddr;
+        }
+    }
+
+    attrSpace = H5Screate_simple( 1, &rank, NULL );
+    attrID = H5Acreate2( dsetID, "DIMENSION_LIST", attrType, attrSpace, H5P_DEFAULT, H5P_DEFAULT );
+    if ( attrSpace < 0 || attrID < 0 || H5Awrite( attrID, attrType, newList ) < 0 )
+    {
+        FATAL_MSG("Failed to write the DIMENSION_LIST attribute.\n");
+        if ( attrSpace < 0 ) attrSpace = 0;
+        if ( attrID < 0 ) attrID = 0;
+        goto cleanupFail;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    if ( oldList )
+    {
+        if ( spaceID && attrType )
+        {
+            hid_t listSpace = H5Screate_simple( 1, &rank, NULL );
+            H5Dvlen_reclaim( attrType, listSpace, H5P_DEFAULT, oldList );
+            H5Sclose(listSpace);
+        }
+        free(oldList);
+    }
+    if ( newList )
+    {
+        for ( hsize_t dim = 0; dim < rank; dim++ )
+            free(newList[dim].p);
+        free(newList);
+    }
+    if ( attrID ) H5Aclose(attrID);
+    if ( attrSpace ) H5Sclose(attrSpace);
+    if ( attrType ) H5Tclose(attrType);
+    if ( spaceID ) H5Sclose(spaceID);
+    if ( dsetID ) H5Oclose(dsetID);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/* Write the REFERENCE_LIST attribute of one dimension scale from the registry entries first..last-1. Entries
+ * already in the attribute are kept.
+ */
+static herr_t writeReferenceList( const dimAttach_t* first, const dimAttach_t* last )
+{
+    hid_t scaleID = 0;
+    hid_t attrID = 0;
+    hid_t attrType = 0;
+    hid_t attrSpace = 0;
+    dimRefEntry_t* entries = NULL;
+    hsize_t numEntries = 0;
+    hssize_t numOld = 0;
+    short fail = 0;
+
+    scaleID = H5Oopen_by_addr( first->fileID, first->scaleAddr );
+    if ( scaleID < 0 )
+    {
+        FATAL_MSG("Failed to open a dimension scale.\n");
+        scaleID = 0;
+        goto cleanupFail;
+    }
+
+    attrType = H5Tcreate( H5T_COMPOUND, sizeof(dimRefEntry_t) );
+    if ( attrType < 0 ||
+         H5Tinsert( attrType, "dataset", HOFFSET(dimRefEntry_t, ref), H5T_STD_REF_OBJ ) < 0 ||
+         H5Tinsert( attrType, "dimension", HOFFSET(dimRefEntry_t, dimIndex), H5T_NATIVE_INT ) < 0 )
+    {
+        FATAL_MSG("Failed to create the REFERENCE_LIST type.\n");
+        if ( attrType < 0 ) attrType = 0;
+        goto cleanupFail;
+    }
+
+    if ( H5Aexists( scaleID, "REFERENCE_LIST" ) > 0 )
+    {
+        attrID = H5Aopen( scaleID, "REFERENCE_LIST", H5P_DEFAULT );
+        attrSpace = attrID < 0 ? -1 : H5Aget_space( attrID );
+        if ( attrID < 0 || attrSpace < 0 )
+        {
+            FATAL_MSG("Failed to open the REFERENCE_LIST attribute.\n");
+            if ( attrID < 0 ) attrID = 0;
+            if ( attrSpace < 0 ) attrSpace = 0;
+            goto cleanupFail;
+        }
+        numOld = H5Sget_simple_extent_npoints( attrSpace );
+    }
+
+    entries = malloc( (numOld + (last - first)) * sizeof(dimRefEntry_t) );
+    if ( entries == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+
+    if ( attrID )
+    {
+        if ( H5Aread( attrID, attrType, entries ) < 0 )
+        {
+            FATAL_MSG("Failed to read the REFERENCE_LIST attribute.\n");
+            goto cleanupFail;
+        }
+        H5Aclose(attrID); attrID = 0;
+        H5Sclose(attrSpace); attrSpace = 0;
+        if ( H5Adelete( scaleID, "REFERENCE_LIST" ) < 0 )
+        {
+            FATAL_MSG("Failed to delete the REFERENCE_LIST attribute.\n");
+            goto cleanupFail;
+        }
+        numEntries = numOld;
+    }
+
+    for ( const dimAttach_t* entry = first; entry < last; entry++ )
+    {
+        int attached = 0;
+
+        for ( hsize_t j = 0; j < numEntries && !attached; j++ )
+            attached = ( (haddr_t) entries[j].ref == entry->dsetAddr &&
+                         entries[j].dimIndex == (int) entry->dimIndex );
+        if ( attached )
+            continue;
+        entries[numEntries].ref = (hobj_ref_t) entry->dsetAddr;
+        entries[numEntries].dimIndex = (int) entry->dimIndex;
+        numEntries++;
+    }
+
+    attrSpace = H5Screate_simple( 1, &numEntries, NULL );
+    attrID = H5Acreate2( scaleID, "REFERENCE_LIST", attrType, attrSpace, H5P_DEFAULT, H5P_DEFAULT );
+    if ( attrSpace < 0 || attrID < 0 || H5Awrite( attrID, attrType, entries ) < 0 )
+    {
+        FATAL_MSG("Failed to write the REFERENCE_LIST attribute.\n");
+        if ( attrSpace < 0 ) attrSpace = 0;
+        if ( attrID < 0 ) attrID = 0;
+        goto cleanupFail;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    if ( entries ) free(entries);
+    if ( attrID ) H5Aclose(attrID);
+    if ( attrSpace ) H5Sclose(attrSpace);
+    if ( attrType ) H5Tclose(attrType);
+    if ( scaleID ) H5Oclose(scaleID);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/*
+                        flushDimScales
+    DESCRIPTION:
+        This function writes the dimension scale attachments recorded by registerDimScale. Each dataset gets
+        its DIMENSION_LIST attribute and each scale its REFERENCE_LIST attribute written once, merged with
+        what the attribute already holds. It must be called before the attachments are read back and before
+        the output files are closed; basicFusion calls it at the end of every unit of work.
+    ARGUMENTS:
+        ctx -- The conversion context holding the registry
+    EFFECTS:
+        Writes attributes to the files of the recorded datasets. Empties the registry and releases its
+        references to the files, also on failure.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t flushDimScales( BFcontext_t* ctx )
+{
+    herr_t retVal = RET_SUCCESS;
+    size_t first = 0;
+
+    if ( ctx->dimRegistryNum == 0 )
+        return RET_SUCCESS;
+
+    qsort( ctx->dimRegistry, ctx->dimRegistryNum, sizeof(dimAttach_t), compareByDataset );
+    for ( size_t i = 1; i <= ctx->dimRegistryNum && retVal == RET_SUCCESS; i++ )
+    {
+        if ( i < ctx->dimRegistryNum && ctx->dimRegistry[i].fileID == ctx->dimRegistry[first].fileID &&
+             ctx->dimRegistry[i].dsetAddr == ctx->dimRegistry[first].dsetAddr )
+            continue;
+        retVal = writeDimensionList( ctx->dimRegistry + first, ctx->dimRegistry + i );
+        first = i;
+    }
+
+    qsort( ctx->dimRegistry, ctx->dimRegistryNum, sizeof(dimAttach_t), compareByScale );
+    first = 0;
+    for ( size_t i = 1; i <= ctx->dimRegistryNum && retVal == RET_SUCCESS; i++ )
+    {
+        if ( i < ctx->dimRegistryNum && ctx->dimRegistry[i].fileID == ctx->dimRegistry[first].fileID &&
+             ctx->dimRegistry[i].scaleAddr == ctx->dimRegistry[first].scaleAddr )
+            continue;
+        retVal = writeReferenceList( ctx->dimRegistry + first, ctx->dimRegistry + i );
+        first = i;
+    }
+
+    for ( size_t i = 0; i < ctx->dimRegistryNum; i++ )
+        H5Fclose( ctx->dimRegistry[i].fileID );
+    ctx->dimRegistryNum = 0;
+
+    if ( retVal == FATAL_ERR )
+        FATAL_MSG("Failed to write the dimension scale attachments.\n");
+
+    return retVal;
+}
+
+/*
+        makePureDim
+
+ DESCRIPTION:
+    makePureDim takes as input a data buffer containing the data that a new dimension will contain.
+    This function makes sure that the dimension complies with netCDF standards.
+
+ ARGUMENTS:
+    IN
+        BFcontext_t* ctx    -- The conversion context
+        hid_t locID         -- The HDF5 group identifier where the dataset will be placed underneath
+        char* dimName       -- The name that the dataset will have
+        void* dataBuffer    -- The buffer containing the data to be written to the dataset
+        hid_t dataspace     -- The HDF5 dataspace identifier. Contains information on the dimensionality
+                               of dataBuffer
+        hid_t h5Type        -- The HDF5 datatype identifier of dataBuffer
+        
+    IN/OUT
+        hid_t* retID        -- If this pointer is set to non-null, the resultant dimension identifier will
+                               be placed at this memory location. Also, if this is non-null, it will be
+                               the duty of the caller to free this ID with H5Dclose() when done.
+ EFFECTS:
+    Creates a new HDF dimension at locID. If retID is non-null, the ID will be returned. Else if it is null,
+    the identifier will be closed before returning.
+
+ RETURN:
+    RET_SUCCESS
+    FATAL_ERR  
+
+*/
+//herr_t makePureDim( hid_t locID, const char* dimName, void* dataBuffer, hid_t dataspace, hid_t h5Type, hid_t* retID )
+herr_t makePureDim( const BFcontext_t* ctx, hid_t locID, const char* dimName,  hid_t dataspace, hid_t h5Type, hid_t* retID )
+{
+    hid_t dimID = 0;
+    herr_t retVal = RET_SUCCESS;
+    herr_t status = 0;
+    int stat1 = 0;
+
+    dimID = H5Dcreate2( locID, dimName, h5Type, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if ( dimID < 0 )
+    {
+        FATAL_MSG("Failed to create the HDF5 dataset.\n");
+        dimID = 0;
+        goto cleanupFail;
+    }
+
+#if 0
+    status = H5Dwrite( dimID, h5Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, dataBuffer );
+    if ( status < 0 )
+    {
+        FATAL_MSG("Failed to write to the dataset.\n");
+        goto cleanupFail;
+    }    
+#endif
+    
+    // Make this new dataset a dimension. The NAME attribute is written below.
+    status = H5DSset_scale( dimID, NULL );
+    if ( status < 0 )
+    {
+        FATAL_MSG("Failed to make the dataset a dimension.\n");
+        goto cleanupFail;
+    }
+
+    // Add the NAME attribute according to netCDF standards
+    stat1 = change_dim_attr_NAME_value( ctx, dimID );
+    if ( stat1 == FAIL )
+    {
+        FATAL_MSG("Failed to change the NAME attribute.\n");
+        goto cleanupFail;
+    }    
+
+    if ( retID )
+        *retID = dimID;
+    else
+        H5Dclose(dimID);
+
+    if ( 0 )
+    {
+cleanupFail:
+        retVal = FATAL_ERR;        
+        if ( dimID ) 
+        {
+            H5Dclose(dimID);
+            *retID = 0;
+        }
+    }
+ 
+    return retVal;
+}
+
+size_t obtainDimSize(hid_t dsetID)
+{
+
+    hid_t dspace = H5Dget_space(dsetID);
+    size_t ret_size =(size_t)H5Sget_simple_extent_npoints(dspace);
+    H5Sclose(dspace);
+    return ret_size;
+
+}
+
+herr_t Generate2D_Dataset( BFcontext_t* ctx, hid_t h5_group,char* dsetname,hid_t h5_type,void* databuffer,hid_t dim0_id,hid_t dim1_id,size_t dim0_size,size_t dim1_size,unsigned short comp_flag)
+{
+    hsize_t temp[2];
+    temp[0] = (hsize_t) (dim0_size);
+    temp[1] = (hsize_t) (dim1_size);
+    hid_t datasetID;
+
+    if(comp_flag == 1) {
+      short use_chunk = ctx->useChunk;
+
+      if(use_chunk == 1)
+      {// The chunk size will always be the whole dataset size for this case.
+        datasetID = insertDataset_comp( ctx, &h5_group, 1, 2,
+                               temp, h5_type, dsetname, databuffer,0 );
+     
+      }
+      else {
+       datasetID = insertDataset( ctx, &h5_group, 1, 2,
+                               temp, h5_type, dsetname, databuffer );
+      }
+    }
+    else {
+       datasetID = insertDataset( ctx, &h5_group, 1, 2,
+                               temp, h5_type, dsetname, databuffer );
+    }
+
+    if ( datasetID == FATAL_ERR )
+    {
+         FATAL_MSG("Error writing %s dataset.\n", dsetname );
+        return -1;
+    }
+
+    if(registerDimScale(ctx,datasetID,dim0_id,0))
+    {
+        FATAL_MSG("Failed to attach the dimension scale.\n");
+        return FAIL;
+    }
+
+    if(registerDimScale(ctx,datasetID,dim1_id,1))
+    {
+        FATAL_MSG("Failed to attach the dimension scale.\n");
+        return FAIL;
+    }
+
+    H5Dclose(datasetID);
+
+    return SUCCEED;
+
+}
+
+
+/*
+            MOPITTaddDimension
+
+    DESCRIPTION:
+        This function adds a dimension scale to the output HDF5 file. It writes the data stored in scaleBuffer to the dimension.
+        The dimension is created under the HDF5 group/file ID given by h5dimGroupID. It does not attach the dimension to any
+        dataset.
+
+    EFFECTS:
+        A new dimension scale is added to the output HDF5 file.
+
+        IT IS THE DUTY OF THE CALLER to close the returned identifier with H5Dclose() once finished.
+
+    ARGUMENTS:
+        INPUT
+            0. BFcontext_t* ctx        -- The conversion context
+            1. hid_t h5dimGroupID      -- The file or group identifier under which to store the dimension
+            2. const char* dimName     -- The name to be given to the dimension
+            3. hsize_t dimSize         -- The integer size of the dimension
+            4. const void* scaleBuffer -- The data to be written to the scale
+            5. hid_t dimScaleNumType   -- The HDF5 number type of scaleBuffer
+
+    RETURN:
+        Returns the identifier of the dimension upon success.
+        Else, it returns FAIL.
+
+*/
+
+hid_t MOPITTaddDimension ( BFcontext_t* ctx, hid_t h5dimGroupID, const char* dimName, hsize_t dimSize, const void* scaleBuffer, hid_t dimScaleNumType )
+{
+    hid_t dsetID = 0;
+    herr_t status = 0;
+
+    dsetID = insertDataset ( ctx, &h5dimGroupID, 1, 1, &dimSize, dimScaleNumType, dimName, scaleBuffer);
+    if ( dsetID == FATAL_ERR )
+    {
+        dsetID = 0;
+        FATAL_MSG("Failed to insert dataset.\n");
+        return FAIL;
+    }
+
+    status = H5DSset_scale( dsetID, dimName );
+    if ( status < 0 )
+    {
+        FATAL_MSG("Failed to set dataset as a dimension scale.\n");
+        return FAIL;
+    }
+
+    return dsetID;
+
+}
+
+/*
+        initializeTimeOffset
+
+    DESCRIPTION:
+        Initializes the array for TAI93 to UTC conversion. This array contains double precision values
+        (which are actually all integer values) that denote the number of seconds to offset a TAI93 value to
+        UTC time. The index of the array represents days since Jan 1 1993 00:00:00.
+
+        This function must be periodically updated to contain new leap second information as it arrives, otherwise
+        the array may not be able to account for all TAI93 times.
+
+        UTC time is an offset version of Atomic Time. The amount of offset from TAI is periodically incremented or decremented
+        depending on the amount of fluctuation in the Earth's orbit and rotation so that the times remain roughly congruent
+        with solar time. These offsets are not applied according to a formula, but rather by the current astronomical conditions.
+        Therefore it is impossible to predict future offset values -- this function is only valid for previous dates and
+        DOES NOT ACCOUNT FOR FUTURE OFFSETS. This implies that this function must be periodically updated to contain the new
+        offset information.
+
+        TAI93 time is defined to be equal to 0 on Jan 1, 1993 00:00:00.
+
+        Directions to update this function:
+            To add additional offsets to the TAI93toUTCoffset table, one needs to inquire the exact dates the offsets were added.
+            Convert these dates to "days since epoch" (epoch being Jan 1, 1993), being careful to account for leap years.
+            You can use the fact that at the end of June 30th 2017, 8946 full days have passed since epoch. Then:
+
+            1. Update NUM_DAYS to be equal to the number of days since epoch since the last known offset was added.
+            2. Add the additional necessary for loops to initialize the TAI93toUTCoffset with the RUNNING TOTAL offset
+
+            Note that offsets are applied either at the end of June 30th and/or December 31st. i.e. The offsets are applied
+            not during the month of June or December, but AT THE END.
+
+    ARGUMENTS:
+        1. ctx -- The conversion context
+
+    EFFECTS:
+        Sets ctx->TAI93toUTCoffset to the allocated memory on the heap containing the proper offset values.
+        freeContext frees it.
+
+    RETURN:
+        FATAL_ERR
+        RET_SUCCESS
+
+*/
+
+#define NUM_DAYS 8946
+
+herr_t initializeTimeOffset( BFcontext_t* ctx )
+{
+    if ( ctx->TAI93toUTCoffset != NULL )
+    {
+        FATAL_MSG("Failed to allocate memory for time TAI93-UTC offset array.\n\tEither the array already points to valid memory or the\n\tarray was freed and not set back to NULL.\n");
+    }
+
+    ctx->TAI93toUTCoffset = malloc(sizeof(double) * NUM_DAYS) ;
+    if ( ctx->TAI93toUTCoffset == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory for time offset array.\n");
+        return FATAL_ERR;
+    }
+
+    /* Initialize the offset Array */
+    for ( int i = 0; i <= 181; i++ )            // Jan 1993 -> June 1993
+        ctx->TAI93toUTCoffset[i] = 0.0;
+    for ( int i = 182; i <= 546; i++ )          // July 1993 -> June 1994
+        ctx->TAI93toUTCoffset[i] = -1.0;
+    for ( int i = 547; i <= 1095; i++ )         // July 1994 -> Dec 1995
+        ctx->TAI93toUTCoffset[i] = -2.0;
+    for ( int i = 1096; i <= 1642; i++ )        // Jan 1996 -> June 1997
+        ctx->TAI93toUTCoffset[i] = -3.0;
+    for ( int i = 1643; i <= 2191; i++ )        // July 1997 -> Dec 1998
+        ctx->TAI93toUTCoffset[i] = -4.0;
+    for ( int i = 2192; i <= 4748; i++ )        // Jan 1999 -> Dec 2005
+        ctx->TAI93toUTCoffset[i] = -5.0;
+    for ( int i = 4749; i <= 5845; i++ )        // Jan 2006 -> Dec 2008
+        ctx->TAI93toUTCoffset[i] = -6.0;
+    for ( int i = 5846; i <= 7210; i++ )        // Jan 2009 -> June 2012
+        ctx->TAI93toUTCoffset[i] = -7.0;
+    for ( int i = 7211; i <= 8215; i++ )        // July 2012 -> June 2015
+        ctx->TAI93toUTCoffset[i] = -8.0;
+    for ( int i = 8216; i <= 8767; i++ )        // July 2015 -> Dec 2016
+        ctx->TAI93toUTCoffset[i] = -9.0;
+    for ( int i = 8768; i < NUM_DAYS; i++ )    // Jan 2017 -> June 2017
+        ctx->TAI93toUTCoffset[i] = -10.0;                  // Currently, value not known past June 30th 2017
+
+    return RET_SUCCESS;
+}
+
+/*
+            TAItoUTCconvert
+
+    DESCRIPTION:
+        This function converts an array with TAI93 times (International Atomic Time - 1993) to UTC (Universal Coordinated Time).
+        A single dimensional array of double values must be passed to the function along with the number of elements in the array.
+        The function will modify the array to contain the converted UTC times.
+
+
+    EFFECTS:
+        Modifies array passed to it with the converted UTC values. Allocates the offset array of ctx on heap if needed.
+
+    INPUTS:
+        IN/OUT
+            BFcontext_t* ctx        -- The conversion context. The offset table is made on the first call.
+        IN
+            unsigned int size       -- Number of elements in buffer.
+        IN/OUT
+            double* buffer          -- One dimensional array containing the TAI93 values (units given in seconds)
+
+    RETURN:
+        Returns FAIL upon failure. Otherwise, SUCCEED.
+
+*/
+
+
+herr_t TAItoUTCconvert ( BFcontext_t* ctx, double* buffer, unsigned int size )
+{
+    /* this function assumes that buffer is one dimensional */
+    herr_t status = 0;
+
+    if ( buffer == NULL )
+    {
+        FATAL_MSG("Argument cannot be NULL.\n");
+        return FAIL;
+    }
+
+    if ( ctx->TAI93toUTCoffset == NULL )
+        status = initializeTimeOffset( ctx );
+
+    if ( status == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to initialize TAI to UTC time offset.\n");
+        return FAIL;
+    }
+
+    int daysSinceEpoch = 0;
+
+    for ( int i = 0; i < size; i++ )
+    {
+        /* Divide buffer value by 86400 (number of seconds in day) to get a floating point
+           number for the day, then truncate this value to get daysSinceEpoch.
+        */
+
+        daysSinceEpoch = (int) ( buffer[i] / 86400.0 );                 // Casting to int will truncate the float (acts as the floor function)
+
+        if ( daysSinceEpoch < NUM_DAYS && daysSinceEpoch >= 0 )
+        {
+            buffer[i] += ctx->TAI93toUTCoffset[daysSinceEpoch];
+        }
+        else if ( daysSinceEpoch >= NUM_DAYS )                           // Currently, value not known past June 30th 2017
+        {
+            FATAL_MSG("MOPITT time values converted\n\tusing out of date UTC-TAI93 offset.\n\tConverted time values may be incorrect!\n\tPlease update the offset array in the function \"initializeTimeOffset()\".\n" );
+            free(ctx->TAI93toUTCoffset);
+            ctx->TAI93toUTCoffset = NULL;
+            return FAIL;
+
+        }
+        else                        // something bad happened
+        {
+            FATAL_MSG("Failed to convert MOPITT time values to UTC.\n");
+            free(ctx->TAI93toUTCoffset);
+            ctx->TAI93toUTCoffset = NULL;
+            return FAIL;
+        }
+    }
+
+    return SUCCEED;
+}
+
+/*
+        H5allocateMemDouble
+
+    DESCRIPTION:
+        This function allocates enough memory to store the dataset give by datasetPath.
+
+    ARGUMENTS:
+        IN
+            hid_t inputFile   -- The HDF5 input group/file identifier
+            char* datasetPath -- The path of the dataset relative to inputFile
+        OUT
+            void** buffer     -- The buffer in which the data will be stored. Does not need to be pre-allocated.
+            long int* size    -- Returns the number of elements in the allocated array. Can be set to NULL if don't care.
+
+    EFFECTS:
+        Sets the caller's buffer pointer (of the appropriate pointer type) to point to the allocated memory
+        on the heap.
+
+        IT IS THE DUTY OF THE CALLER to release buffer to avoid memory leaks.
+
+    RETURN:
+        FATAL_ERR
+        RET_SUCCESS
+*/
+
+herr_t H5allocateMemDouble ( hid_t inputFile, const char* datasetPath, void** buffer, long int* size )
+{
+    if ( datasetPath == NULL || buffer == NULL )
+    {
+        FATAL_MSG("Invalid arguments passed to function. Pointers cannot be NULL.\n");
+        return FAIL;
+    }
+    hid_t dataset = 0;
+    hid_t dataspace = 0;
+
+    herr_t statusn;
+    unsigned short fail = 0;
+    hsize_t * datasetDims = NULL;
+    int rank = 0;
+
+
+    dataset = H5Dopen2( inputFile, datasetPath, H5F_ACC_RDONLY );
+    if ( dataset < 0 )
+    {
+        FATAL_MSG("Failed to read HDF5 dataset.\n");
+        dataset = 0;
+        goto cleanupFail;
+    }
+
+    dataspace = H5Dget_space(dataset);
+    if ( dataspace < 0 )
+    {
+        dataspace = 0;
+        FATAL_MSG("Failed to get dataspace.\n");
+        goto cleanupFail;
+    }
+
+    rank = H5Sget_simple_extent_ndims(dataspace);
+    if ( rank < 0 )
+    {
+        FATAL_MSG("Failed to get rank of dataset.\n");
+        goto cleanupFail;
+    }
+
+    datasetDims = malloc( sizeof(hsize_t) * DIM_MAX );
+    if ( datasetDims == NULL )
+    {
+        FATAL_MSG("Malloc failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+
+    for ( int i = 0; i < DIM_MAX; i++ )
+        datasetDims[i] = 0;
+
+    statusn = H5Sget_simple_extent_dims(dataspace, datasetDims, NULL);
+    if ( statusn < 0 )
+    {
+        FATAL_MSG("Unable to get dimension size.\n");
+        goto cleanupFail;
+    }
+
+    unsigned long long numElems = 0;
+
+    for ( int i = 0; i < DIM_MAX; i++ )
+        numElems += datasetDims[i];
+
+    *buffer = malloc( sizeof(double) * numElems );
+
+    if ( size ) *size = numElems;
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    if ( dataset ) H5Dclose(dataset);
+    if ( dataspace ) H5Sclose(dataspace);
+    if ( datasetDims ) free(datasetDims);
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/*
+        getTAI93
+
+    DESCRIPTION:
+        This function takes as input the GDateInfo_t struct (as defined in libTERRA.h) which contains date information,
+        and returns the corresponding TAI93 (defined as TAI = 0 on Jan 1 1993 00:00:00) timestamp.
+
+        This function will need to be periodically updated if being used after the year 2035 to contain more running-total
+        leap year information (as shown in the if-else tree).
+
+    ARGUMENTS:
+        IN
+            1. GDateInfo_t date       -- The input date information.
+        OUT
+            2. double* TAI93timestamp -- The corresponding TAI93 time
+
+    EFFECTS:
+        Modifies the memory pointed to by TAI93timestamp
+
+    RETURN:
+        FATAL_ERR
+        RET_SUCCESS
+
+*/
+herr_t getTAI93 ( GDateInfo_t date, double* TAI93timestamp )
+{
+    if ( date.year < 1993 )
+    {
+        FATAL_MSG("Cannot convert to TAI93 with dates before the year 1993.\n");
+        return FATAL_ERR;
+    }
+    if ( TAI93timestamp == NULL )
+    {
+        FATAL_MSG("TAI93timestamp argument cannot be NULL.\n");
+        return FATAL_ERR;
+    }
+
+    double TAI93 = 0.0;
+
+    TAI93 += ( date.year-1993 );         // How many full years since 1993, multiplied by number of seconds in a year
+    TAI93 *= 365.0;
+    TAI93 *= 86400.0;
+    // Find how many leap years since 1993
+    /* Note that the current year is not considered in this else if tree whether or not it is a leap year. That is handled downstream */
+    unsigned short numLeapYears = 0;
+    if ( date.year >= 1993 && date.year <= 1995 )
+        numLeapYears = 0;
+    else if ( date.year >= 1996 && date.year <= 2000 )
+        numLeapYears = 1;
+    else if ( date.year >= 2001 && date.year <= 2004 )
+        numLeapYears = 2;
+    else if ( date.year >= 2005 && date.year <= 2008 )
+        numLeapYears = 3;
+    else if ( date.year >= 2009 && date.year <= 2012 )
+        numLeapYears = 4;
+    else if ( date.year >= 2013 && date.year <= 2016 )
+        numLeapYears = 5;
+    else if ( date.year >= 2017 && date.year <= 2020 )
+        numLeapYears = 6;
+    else if ( date.year >= 2021 && date.year <= 2024 )
+        numLeapYears = 7;
+    else if ( date.year >= 2025 && date.year <= 2028 )
+        numLeapYears = 8;
+    else if ( date.year >= 2029 && date.year <= 2032 )
+        numLeapYears = 9;
+    else if ( date.year >= 2033 && date.year <= 2036 )
+        numLeapYears = 10;
+    else
+    {
+        FATAL_MSG("Failed to find how many leap years since 1993. Maybe this function is\n\tout of date?\n");
+        return FATAL_ERR;
+    }
+
+
+    TAI93 += (double)(numLeapYears * 86400);        // Account for additional days during leap years
+
+    int leapYear = isLeapYear( (int) date.year);
+    if ( leapYear < 0 )
+    {
+        FATAL_MSG("Failed to determine if it is a leap year.\n");
+        return FATAL_ERR;
+    }
+    // Account for the number of seconds in a month
+    // Note that we increment TAI93 based on how many FULL months have passed.
+
+    const unsigned short month = (unsigned short) date.month;
+
+    switch ( month )
+    {
+    case 1:              // Current month is Jan
+        TAI93 += 0.0;
+        break;
+    case 2:              // Feb
+        TAI93 += (double) (31 * 86400);
+        break;
+    case 3:             // Current month is March (previous month is Feb which may or may not have leap day)
+        TAI93 += (double)((31+28)*86400);
+        break;
+    case 4:             // April
+        TAI93 += (double) ((31+28+31)*86400);
+        break;
+    case 5:             // May
+        TAI93 += (double) ((31+28+31+30)*86400);
+        break;
+    case 6:             // June
+        TAI93 += (double) ((31+28+31+30+31)*86400);
+        break;
+    case 7:             // July
+        TAI93 += (double) ((31+28+31+30+31+30)*86400);
+        break;
+    case 8:             // Aug
+        TAI93 += (double) ((31+28+31+30+31+30+31)*86400);
+        break;
+    case 9:             // Sept
+        TAI93 += (double) ((31+28+31+30+31+30+31+31)*86400);
+        break;
+    case 10:            // Oct
+        TAI93 += (double) ((31+28+31+30+31+30+31+31+30)*86400);
+        break;
+    case 11:            // Nov
+        TAI93 += (double) ((31+28+31+30+31+30+31+31+30+31)*86400);
+        break;
+    case 12:            // Dec
+        TAI93 += (double) ((31+28+31+30+31+30+31+31+30+31+30)*86400);
+        break;
+    default:
+        FATAL_MSG("Problem occurred trying to convert date to TAI93 time.\n");
+        return FATAL_ERR;
+    }
+
+    // Add extra day if leap year and month is March or after
+    if ( leapYear && month >= 3)
+    {
+        TAI93 += 86400.0;
+    }
+
+    // Account for the number of FULL days that have passed in this month
+    const short days = (short) date.day - 1;        // date.day is 1-indexed
+    if ( days >= 0 && days <= 31 )
+        TAI93 += (double) ((days) * 86400);          // Number of full days passed multiplied by number of seconds in a day
+    else
+    {
+        FATAL_MSG("Failed to account for the number of days passed in the current month.\n");
+        return FATAL_ERR;
+    }
+
+    // Account for the number of FULL hours that have passed in this day
+
+    const short hours = (short) date.hour;          // hour is 0-indexed
+    if ( hours >= 0 && hours <= 23 )
+        TAI93 += (double)(hours * 3600);        // Number of full hours passed multiplied by number of seconds in an hour
+    else
+    {
+        FATAL_MSG("Failed to acount for the number of hours passed in a day.\n");
+        return FATAL_ERR;
+    }
+
+    // Account for the number of FULL minutes that have passed in this hour
+    const short minutes = (short) date.minute;      // Minutes are 0-indexed
+    if ( minutes >= 0 && minutes <= 60 )            // From 0 to 60 because leap seconds may make minute indicator show 60
+        TAI93 += (double)(minutes * 60);
+    else
+    {
+        FATAL_MSG("Failed to account for number of minutes passed.\n");
+        return FATAL_ERR;
+    }
+
+    // Finally, increment the seconds
+    TAI93 += date.second;
+
+
+    *TAI93timestamp = TAI93;
+
+    return RET_SUCCESS;
+}
+
+/*
+ * isLeapyear
+ * DESCRIPTION:
+ *      Determins if the given year is a leap year.
+ * ARGUMENTS:
+ *      IN
+ *      int year
+ * RETURN:
+ *      -1 upon failure
+ *      0 if not a leap year.
+ *      1 if it is a leap year.
+ */
+int isLeapYear( int year )
+{
+    if ( year < 0 )
+    {
+        FATAL_MSG("I highly doubt there were satellites flying about before the year 0.\n");
+        return -1;
+    }
+    int retVal = 0;
+
+    if ( year % 4 == 0 )           // divisible by 4
+    {
+        if ( year % 100 == 0 )     // divisible by 100
+        {
+            if ( year % 400 == 0 )
+                retVal = 1;
+            else                        // not divisible by 400
+                retVal = 0;
+        }
+
+        else                            // not divisible by 100
+            retVal = 1;
+    }
+    else                                // not divisible by 4
+        retVal = 0;
+
+    return retVal;
+}
+
+/*
+        binarySearchDouble
+
+    DESCRIPTION:
+        This function performs a binary search on a sorted array of double values.
+        If the exact target is not found, the first element that is greater than the target value is returned
+        in the argument targetIndex.
+
+    ARGUMENTS:
+        IN
+            1. double* array                   -- The array to perform the search on
+            2. double target                   -- The value to search for
+            3. hsize_t size                    -- The number of elements in array
+            4. short unsigned int firstGreater -- Set to nonzero to return the first element GREATER than target (if exact match not found).
+                                                  Set to 0 to return element BEFORE the first element that is greater than target.
+        OUT
+            5. long int* targetIndex -- The index of where the target value is. If target doesn't exist in the array,
+                                        this will return the first element in array that is larger than target.
+
+    EFFECTS:
+        Modifies the memory pointed to by targetIndex to contain the selected index of the array.
+
+    RETURN:
+        0 if an exact match is found.
+        1 if an exact match was not found (first element larger than target is returned).
+       -1 if an error occured.
+
+*/
+herr_t binarySearchDouble ( const double* array, double target, hsize_t size, short unsigned int firstGreater, long int* targetIndex )
+{
+    long int left = 0;
+    long int right = (long int)(size - 1);
+    long int middle;
+
+    while ( left <= right )
+    {
+        middle = (left + right)/2;
+        if ( array[middle] < target )
+        {
+            left = middle+1;
+            /* If the search was unable to find an exact match (case where left > right), set middle to the first index that is greater than target.
+               This is useful information for subsetting. It is possible that middle will be set to the very beginning or to
+               the very end of the array. This is okay, this is also useful information.
+             */
+
+            if ( left > right )
+            {
+                while ( middle+1 < size && array[middle] < target )
+                    middle++;
+            }
+            continue;
+        }
+
+        if ( array[middle] > target )
+        {
+            right = middle - 1;
+            /* If the search was unable to find an exact match, set middle to the first index that is greater than target.
+               This is useful information for subsetting. It is possible that middle will be set to the very beginning or to
+               the very end of the array. This is okay, this is also useful information.
+             */
+
+            if ( left > right )
+            {
+                while ( middle-1 >= 0 && array[middle-1] > target )
+                    middle--;
+            }
+            continue;
+        }
+
+        *targetIndex = middle;
+        return 0;
+    }
+
+    /* Final error check to make sure that array[middle] either equals target or is greater than target */
+    if ( middle < 0 || middle >= size || (array[middle] < target && middle != size-1))
+    {
+        FATAL_MSG("Binary search produced an invalid result. Debug information:\n\ttargetIndex = %ld\n\tsize = %u\n", middle, (unsigned int) size);
+        return -1;
+    }
+ 
+    // When middle points to the last element of the array,we should not decrease the middle value by 1. 
+    if ( firstGreater == 0 && middle > 0 && middle<(size-1))
+    //if ( firstGreater == 0 && middle > 0 )
+    {
+        middle--;
+    }
+
+    *targetIndex = middle;
+    return 1;
+
+}
+
+/*
+            MOPITT_OrbitInfo
+
+    DESCRIPTION:
+        This function takes as input the starting and ending times of the orbit (given as OInfo_t struct), the input hid_t
+        HDF5 file/group identifier, the path to the time dataset (relative to inputFile), and gives the starting and ending
+        indices.
+
+    ARGUMENTS:
+        IN
+            1. const hid_t inputFile  -- The HDF5 file or group identifier under which the time dataset is stored.
+            2. OInfo_t cur_orbit_info -- A struct containing the start and end dates of the orbit. Defined in libTERRA.h
+            3. const char* timePath   -- The path to the time dataset relative to inputFile
+        OUT
+            4. unsigned int* start_indx_ptr    -- The index to begin subsetting from
+            5. unsigned int* end_indx_ptr      -- The index to end the subsetting at
+
+    EFFECTS:
+        Modifies start and end_indx_ptr to contain the appropriate values
+
+    RETURN:
+        0 if success.
+        1 if MOPITT file should be skipped (no error, but shouldn't include MOPITT file in output).
+        2 if other failure.
+
+*/
+
+herr_t MOPITT_OrbitInfo( const hid_t inputFile, OInfo_t cur_orbit_info, const char* timePath, unsigned int* start_indx_ptr,
+                         unsigned int* end_indx_ptr )
+{
+    herr_t retStatus = 0;
+    double* timeData = NULL;
+    long int numElems = 0;
+    herr_t status = 0;
+    hid_t dataset = 0;
+    hid_t dataspace = 0;
+    hid_t groupID = 0;
+
+    status = H5allocateMemDouble ( inputFile, timePath, (void**) &timeData, &numElems );
+    if ( status == FAIL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        timeData = NULL;
+        goto cleanupFail;
+    }
+
+
+    status = H5LTread_dataset_double( inputFile, timePath, timeData);
+    if ( status < 0 )
+    {
+        FATAL_MSG("Failed to read dataset.\n");
+        goto cleanupFail;
+    }
+
+    /* We now need to convert the orbit info given by current_orbit_info into TAI93 start time and TAI93 end time.
+       This way, we will know exactly which elements in timeData will be selected for the start and end pointers.
+       We convert to TAI93 because the MOPITT time values are given in TAI93.
+     */
+    GDateInfo_t time;
+    double startTAI93;
+    double endTAI93;
+
+    time.year = cur_orbit_info.start_year;
+    time.month = cur_orbit_info.start_month;
+    time.day = cur_orbit_info.start_day;
+    time.hour = cur_orbit_info.start_hour;
+    time.minute = cur_orbit_info.start_minute;
+    time.second = (double) cur_orbit_info.start_second;
+
+    status = getTAI93 ( time, &startTAI93 );
+    if ( status == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to get TAI93 timestamp.\n");
+        goto cleanupFail;
+    }
+
+    time.year = cur_orbit_info.end_year;
+    time.month = cur_orbit_info.end_month;
+    time.day = cur_orbit_info.end_day;
+    time.hour = cur_orbit_info.end_hour;
+    time.minute = cur_orbit_info.end_minute;
+    time.second = (double) cur_orbit_info.end_second;
+
+
+    status = getTAI93 ( time, &endTAI93 );
+    if ( status == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to get TAI93 timestamp.\n");
+        goto cleanupFail;
+    }
+
+
+
+    /* Perform a binary search on the timeData array to find the start and end indices */
+    long int startIdx, endIdx;
+
+    status = binarySearchDouble ( timeData, startTAI93, (hsize_t) numElems, 1, &startIdx );
+    if ( status == -1 )
+    {
+        FATAL_MSG("Failed to find MOPITT start index.\n");
+        goto cleanupFail;
+    }
+    status = binarySearchDouble ( timeData, endTAI93, (hsize_t) numElems, 0, &endIdx );
+    if ( status == -1 )
+    {
+        FATAL_MSG("Failed to find MOPITT end index.\n");
+        goto cleanupFail;
+    }
+
+    /* If the start and end indices are equal, this file is probably out of bounds of the orbit. */
+    // When the difference of startIdx and endIdx is 1, it may be still out of bound.
+    // orbit 3295, the whole orbit time is between the index 3174 and 3175. In fact, 
+    // there may be a few missing data orbits(3295 to 3297).We need to consider this. KY 2017-10-31
+    if ( startIdx == endIdx ){
+        if((timeData[startIdx]<startTAI93)||(timeData[startIdx]>endTAI93))// Out of bound
+            retStatus = 1;
+
+    }
+    else if ((endIdx-startIdx)==1){
+        if((timeData[startIdx]<startTAI93)||(timeData[endIdx]>endTAI93))// Out of bound
+            retStatus = 1;
+    }
+    else if ((endIdx-startIdx)==-1)
+     // We can make the binary search better to avoid this case.  
+     // However, I think the end results are the same. Just keep it. KY 2017-10-31
+    {
+        if((timeData[endIdx]<startTAI93)||(timeData[startIdx]>endTAI93))// Out of bound
+            retStatus = 1;
+    }
+
+    *start_indx_ptr = startIdx;
+    *end_indx_ptr = endIdx;
+
+    if ( 0 )
+    {
+cleanupFail:
+        retStatus = 2;
+    }
+
+#if 0
+
+    /* This is for debugging only */
+    printf("\nstartYear = %u\nstartMonth = %u\nstartDay = %u\nstartHour = %u\nstartMinute = %u\nstartSecond = %lf\n", time.year, (unsigned short) time.month, (unsigned short) time.day, (unsigned short) time.hour, (unsigned short) time.minute, time.second);
+    printf("\nendYear = %u\nendMonth = %u\nendDay = %u\nendHour = %u\nendMinute = %u\nendSecond = %lf\n", time.year, (unsigned short) time.month, (unsigned short) time.day, (unsigned short) time.hour, (unsigned short) time.minute, time.second);
+    printf("startTAI93: %lf endTAI93: %lf\n", startTAI93, endTAI93);
+
+
+#endif
+
+
+
+
+
+    if(timeData) free(timeData);
+    if (dataset) H5Dclose(dataset);
+    if (dataspace) H5Sclose(dataspace);
+    if ( groupID ) H5Gclose(groupID);
+
+    return retStatus;
+}
+
+
+int comp_greg(GDateInfo_t j1, GDateInfo_t j2)
+{
+
+#define cmp_number(a,b) (((a) > (b)) ? 1 : (((a) == (b)) ? 0 : -1))
+
+    int cmp_year = cmp_number(j1.year,j2.year);
+    if(cmp_year == 0)
+    {
+        int cmp_month = cmp_number(j1.month,j2.month);
+        if(cmp_month == 0)
+        {
+            int cmp_day = cmp_number(j1.day,j2.day);
+            if(cmp_day == 0)
+            {
+                int cmp_hour = cmp_number(j1.hour,j2.hour);
+                if(cmp_hour == 0)
+                {
+                    int cmp_minute = cmp_number(j1.minute,j2.minute);
+                    if(cmp_minute == 0)
+                    {
+                        int cmp_second = cmp_number(j1.second,j2.second);
+                        return cmp_second;
+                    }
+                    else
+                        return cmp_minute;
+                }
+                else
+                    return cmp_hour;
+            }
+            else
+                return cmp_day;
+        }
+        else
+            return cmp_month;
+    }
+    else
+        return cmp_year;
+
+}
+
+/*
+        get_greg
+
+    DESCRIPTION:
+        get_greg converts the julian time given in the argument to a Gregorian calendar
+        date. The code can be seen in two separate parts: the section that converts the
+        date itself, and the code that converts the Gregorian time. The date portion of
+        the code was ported over by Shashank Bansal from a Python implementation. The
+        original Python can be found here:
+
+        https://gist.github.com/jiffyclub/1294443
+
+    ARGUMENTS:
+        double julian       -- The Julian value to be converted
+        int* yearp          -- Where the converted year will go
+        int* monthp         -- Where the converted month will go
+        int* dayp           -- Where the converted day will go
+        int* hourp          -- Where the converted hour will go
+        int* mmp            -- Where the converted minute will go
+        double* ssp         -- Where the converted second will go
+
+    EFFECTS:
+        Modifes the memory pointed to by the arguments to contain the converted Gregorian date
+
+    RETURN:
+        void
+*/
+
+void get_greg(double julian, int*yearp,int*monthp,int*dayp,int*hourp,int*mmp,double*ssp)
+{
+
+    double julian_fract = julian-(int)julian;
+    double total_ss,ss;
+    int hh,mm;
+    if(julian_fract >0.5)
+        total_ss = 86400*(julian_fract-0.5);
+    else
+        total_ss = 86400*(julian_fract+0.5);
+
+    hh = (int)(total_ss/3600);
+    mm = (int)((total_ss-(hh*3600))/60);
+    ss = total_ss-(hh*60.0+mm)*60.0;
+
+
+    /* Calculte fraction */
+
+    julian = julian + 0.5;
+
+    double F, I, B, C, D, E, G, A;
+    int day, month, year;
+
+    F = modf(julian, &I);
+    A = trunc(((int)I - 1867216.25)/36524.25);
+
+    if(I > 2299160)
+    {
+        B = I + 1 + A - trunc(A / 4.0);
+    }
+
+    else
+        B = I;
+
+    C = B + 1524;
+    D = trunc((C - 122.1) / 365.25);
+    E = trunc(365.25 * D);
+    G = trunc((C - E) / 30.6001);
+
+    day = C - E + F - trunc(30.6001 * G);
+
+    if(G < 13.5) 
+        month = G - 1;
+    else 
+        month = G - 13;
+
+    if(month > 2.5) 
+        year = D - 4716;
+    else 
+        year = D - 4715;
+
+    *yearp = year;
+    *monthp = month;
+    *dayp   = day;
+    *hourp  = hh;
+    *mmp    = mm;
+    *ssp    = ss;
+
+    return;
+}
+/*
+        binarySearchUTC
+
+        TODO: NEED to CLEAN UP the comments.
+    DESCRIPTION:
+        This function performs a binary search on a sorted incrased order array of double values.
+        If the exact target is not found, the first element that is greater than the target value is returned
+        in the argument targetIndex.
+
+    ARGUMENTS:
+        IN
+            1. double* array         -- The array to perform the search on
+            2. double target         -- The value to search for
+            3. hsize_t size          -- The number of elements in array
+        OUT
+            4. long int* targetIndex -- The index of where the target value is. If target doesn't exist in the array,
+                                        this will return the first element in array that is larger than target.
+
+    EFFECTS:
+        Modifies the memory pointed to by targetIndex to contain the selected index of the array.
+
+    RETURN:
+        0 if an exact match is found.
+        1 if an exact match was not found (first element larger than target is returned).
+       -1 if an error occured.
+
+*/
+int binarySearchUTC ( const double* jd, GDateInfo_t target, int start_index,int end_index)
+{
+    int middle = 0;
+
+    GDateInfo_t gran_mark_index_time,gran_mark_adj_time;
+
+    int temp_year = 0;
+    int temp_month = 0;
+    int temp_day = 0;
+    int temp_hour = 0;
+    int temp_minute = 0;
+    double temp_second = 0.;
+    int* temp_yearp =&temp_year;
+    int* temp_monthp=&temp_month;
+    int* temp_dayp=&temp_day;
+    int* temp_hourp=&temp_hour;
+    int* temp_minutep=&temp_minute;
+    double* temp_secondp=&temp_second;
+
+    if(start_index >end_index)
+        return -1;
+    middle = (start_index+end_index)/2;
+
+    if(middle == end_index)
+        return end_index;
+
+#if 0
+    printf("orbit year is %d\n",target.year);
+    printf("orbit month is %d\n",target.month);
+    printf("orbit day is %d\n",target.day);
+    printf("orbit hour is %d\n",target.hour);
+    printf("orbit minute is %d\n",target.minute);
+    printf("orbit second is %lf\n",target.second);
+#endif
+    get_greg(jd[middle],temp_yearp,temp_monthp,temp_dayp,temp_hourp,temp_minutep,temp_secondp);
+    gran_mark_index_time.year = *temp_yearp;
+    gran_mark_index_time.month = *temp_monthp;
+    gran_mark_index_time.day = *temp_dayp;
+    gran_mark_index_time.hour = *temp_hourp;
+    gran_mark_index_time.minute = *temp_minutep;
+    gran_mark_index_time.second = *temp_secondp;
+
+#if 0
+    printf("N orbit year is %d\n",gran_mark_index_time.year);
+    printf("N orbit month is %d\n",gran_mark_index_time.month);
+    printf("N orbit day is %d\n",gran_mark_index_time.day);
+    printf("N orbit hour is %d\n",gran_mark_index_time.hour);
+    printf("N orbit minute is %d\n",gran_mark_index_time.minute);
+    printf("N orbit second is %lf\n",gran_mark_index_time.second);
+#endif
+
+
+
+    int cmp_orbit_mark_time = comp_greg(target,gran_mark_index_time);
+
+    get_greg(jd[middle+1],temp_yearp,temp_monthp,temp_dayp,temp_hourp,temp_minutep,temp_secondp);
+    gran_mark_adj_time.year = *temp_yearp;
+    gran_mark_adj_time.month = *temp_monthp;
+    gran_mark_adj_time.day = *temp_dayp;
+    gran_mark_adj_time.hour = *temp_hourp;
+    gran_mark_adj_time.minute = *temp_minutep;
+    gran_mark_adj_time.second = *temp_secondp;
+
+    int cmp_orbit_adj_time = comp_greg(target,gran_mark_adj_time);
+    if ( cmp_orbit_mark_time >=0 && cmp_orbit_adj_time <0)
+        return middle;
+    else if(cmp_orbit_mark_time <0)
+        return binarySearchUTC(jd,target,0,middle);
+    else
+        return binarySearchUTC(jd,target,middle,end_index);
+
+}
+
+int comp_greg_utc(double sgreg,GDateInfo_t sutc)
+{
+
+    GDateInfo_t sgreg_utc;
+    int temp_year = 0;
+    int temp_month = 0;
+    int temp_day = 0;
+    int temp_hour = 0;
+    int temp_minute = 0;
+    double temp_second = 0.0;
+    int* temp_yearp =&temp_year;
+    int* temp_monthp=&temp_month;
+    int* temp_dayp=&temp_day;
+    int* temp_hourp=&temp_hour;
+    int* temp_minutep=&temp_minute;
+    double* temp_secondp=&temp_second;
+
+    get_greg(sgreg,temp_yearp,temp_monthp,temp_dayp,temp_hourp,temp_minutep,temp_secondp);
+    sgreg_utc.year = *temp_yearp;
+    sgreg_utc.month = *temp_monthp;
+    sgreg_utc.day = *temp_dayp;
+    sgreg_utc.hour = *temp_hourp;
+    sgreg_utc.minute = *temp_minutep;
+    sgreg_utc.second = *temp_secondp;
+    return comp_greg(sgreg_utc,sutc);
+
+}
+
+int utc_time_diff(struct tm start_date, struct tm end_date)
+{
+
+
+    //struct tm start_date;
+    //struct tm end_date;
+    time_t start_time, end_time;
+    int seconds;
+
+#if 0
+    start_date.tm_hour = 0;
+    start_date.tm_min = 0;
+    start_date.tm_sec = 0;
+    start_date.tm_mon = 1;
+    start_date.tm_mday = 1;
+    start_date.tm_year = 112;
+
+    end_date.tm_hour = 0;
+    end_date.tm_min = 0;
+    end_date.tm_sec = 0;
+    end_date.tm_mon = 2;
+    end_date.tm_mday = 1;
+    end_date.tm_year = 112;
+#endif
+
+    start_time = mktime(&start_date);
+    end_time = mktime(&end_date);
+
+    seconds = (int)(difftime(end_time, start_time)) ;
+
+    return seconds;
+}
+
+
+/* This function is self-explanatory */
+int numDigits(int digit)
+{
+    if ( digit < 0 ) digit = ( digit == INT_MAX ) ? INT_MIN : -digit;
+    if ( digit < 10 ) return 1;
+    if ( digit < 100 ) return 2;
+    if ( digit < 1000) return 3;
+    if ( digit < 10000) return 4;
+    if ( digit < 100000) return 5;
+    if ( digit < 1000000) return 6;
+    if ( digit < 10000000) return 7;
+    if ( digit < 100000000) return 8;
+    if ( digit < 1000000000) return 9;
+    return 10;
+}
+
+
+/*
+ *      updateGranList
+ *
+ * DESCRIPTION:
+ *      This function handles creating a list of input granules as a string. It takes a running total of all currently visited
+ *      granules, "granList", a new granule to add, "newGran", and appends newGran to granList. This handles all of the necessary
+ *      memory operations for a variable length string. Adding a new granule to the list is an amortized constant operation.
+ *
+ * ARGUMETS:
+ *      IN:
+ *          const char newGran     -- A null terminated string containing the new granule. Should not have any newline characters.
+ *                                    absence of the null terminator risks memory access violations!
+ *      
+ *      IN/OUT:
+ *          char** granList        -- A pointer to a character array. This function updates the character array pointer as needed
+ *                                    when allocating memory. The granList double pointer should point to a NULL value the first
+ *                                    time this function is called because granList will be dereferenced once to contain the
+ *                                    return value of malloc.
+ *          size_t* curSize        -- The current size in bytes of the memory pointed to by *granList. Is updated when new memory
+ *                                    is allocated. *curSize should be zero when first calling this function.
+ *
+ * EFFECTS:
+ *      Allocates new memory as needed. Updates *granList and *curSize variables as needed.
+ *
+ *      IT IS THE DUTY OF THE CALLER to free the granList memory when finished!
+ *
+ * RETURN:
+ *      FATAL_ERR.
+ *      RET_SUCCESS.
+ */
+
+herr_t updateGranList( char** granList, const char* newGran, size_t * curSize )
+{
+    if ( granList == NULL || curSize == NULL || newGran == NULL )
+    {
+        FATAL_MSG("No arguments to this function can be NULL.\n\tgranList = %p\n\tcurSize = %p\n\tnewGran = %p\n", granList,
+                   curSize, newGran);
+        return FATAL_ERR;
+    }
+    size_t granLen = strlen( newGran );
+    if ( granLen < 2 )
+    {
+        FATAL_MSG("The newGran argument contains no string!\n");
+        return FATAL_ERR;
+    }
+
+    size_t granListSize = 0;
+
+    if ( *granList != NULL )
+        granListSize = strlen(*granList);
+
+    if ( *granList == NULL )
+    {
+        if ( *curSize != 0 )
+        {
+            FATAL_MSG("A NULL pointer was passed for the string but the size was indicated to be non-zero.\n");
+            return FATAL_ERR;
+        }
+
+        *granList = calloc( granLen+2, 1 );
+        if ( *granList == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FATAL_ERR;
+        }
+
+        *curSize = granLen+2;
+    }
+
+    else if ( granListSize + granLen + 2 > *curSize )
+    {
+        
+        granListSize = strlen(*granList);
+        // granLen+2 to account for newline and null terminator that will be added
+        void* tempPtr = realloc( *granList, max((*curSize) * 2 , granListSize+granLen+2));
+        if ( tempPtr == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FATAL_ERR;
+        }
+        *granList = (char*) tempPtr;
+
+        *curSize = max( (*curSize) * 2 , granListSize+granLen+2);
+    }
+
+    strncat( *granList, newGran, granLen );
+
+    // Set the comma and null terminator on the ends of the granule list
+    size_t newGranListSize = strlen(*granList);
+    (*granList)[newGranListSize]   = ',';
+    (*granList)[newGranListSize+1] = '\0';
+
+    return RET_SUCCESS;
+}
+
+// Quick check for MODIS change dimension(code copied from copyDimension.)
+herr_t copyDimension_MODIS_Special( BFcontext_t* ctx, char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID )
+{
+    hsize_t tempInt = 0;
+    char* correct_dsetname = NULL;
+    char* dimName = NULL;
+    herr_t errStatus = 0;
+    int32 ntype = 0;
+    int32 h4dsetID = 0;
+    intn statusn = 0;
+    int rank = 0;
+    int status = 0;
+    hid_t h5dimID = 0;
+    void *dimBuffer = NULL;
+    short fail = 0;
+    hid_t memspace = 0;
+    htri_t dsetExists = 0;
+    short wasHardCodeCopy = 0;
+    char* catString = NULL;
+    char* temp = NULL;
+    char tempStack[STR_LEN] = {'\0'};
+
+    /* Get dataset index */
+    int32 sds_index = SDnametoindex(h4fileID, h4datasetName );
+    if ( sds_index == FAIL )
+    {
+        FATAL_MSG("Failed to get SD index.\n");
+        goto cleanupFail;
+    }
+    /* select the dataset */
+    h4dsetID = SDselect(h4fileID, sds_index);
+    if ( h4dsetID == FAIL )
+    {
+        h4dsetID = 0;
+        FATAL_MSG("Failed to select the HDF4 dataset.\n");
+        goto cleanupFail;
+    }
+
+    /* get the rank of the dataset so we know how many dimensions to copy */
+    statusn = SDgetinfo(h4dsetID, NULL, &rank, NULL, NULL, NULL );
+    if ( statusn == FAIL )
+    {
+        FATAL_MSG("Failed to get SD info.\n");
+        goto cleanupFail;
+    }
+
+
+    int32 dim_index;
+
+    // COPY OVER DIMENSION SCALES TO HDF5 OBJECT
+    dimName = calloc(500, 1);
+    int32 size = 0;
+    int32 num_attrs = 0;
+    hid_t h5type = 0;
+    int32 h4dimID = 0;
+
+    for ( dim_index = 0; dim_index < rank; dim_index++ )
+    {
+        // Get the dimension ID
+        h4dimID = SDgetdimid ( h4dsetID, dim_index );
+        if ( h4dimID == FAIL )
+        {
+            FATAL_MSG("Failed to get dimension ID.\n");
+            h4dimID = 0;
+            goto cleanupFail;
+        }
+
+
+        /* get various useful info about this dimension */
+        statusn = SDdiminfo( h4dimID, dimName, &size, &ntype, &num_attrs );
+        //int32 dimRank = 0;
+        //int32 dimSizes = 0;
+        //statusn = SDgetinfo( h4dimID, dimName, &dimRank, &dimSizes, &ntype, &num_attrs);
+        if ( statusn == FAIL )
+        {
+            FATAL_MSG("Failed to get dimension info.\n");
+            goto cleanupFail;
+        }
+
+
+        /* If dimSuffix is provided, we need to append this string to the dimName variable.*/
+       
+        correct_dsetname = correct_name(dimName);
+
+        if ( dimSuffix ) 
+        {
+            // store allocated memory in temp pointer
+            strcpy(tempStack, dimName);
+            temp = calloc ( sizeof(tempStack) + sizeof(dimSuffix) + 1, 1 );
+            // copy dimName to the temp pointer memory
+            strcpy(temp, tempStack);
+            // concatenate dimName with dimSuffix
+            strcat(temp,dimSuffix);
+            // Fix the name to comply with netCDF standards
+            catString = correct_name(temp);
+            // free the temp memory (catString is separately allocated memory, malloc'ed in the correct_name function
+            free(temp); temp = NULL;
+        }
+        else
+        {
+           char* special_suffix;
+           unsigned short have_special_suffix = 0;
+           if(size == 2040 || size == 4080 || size == 8160){
+             special_suffix = "_2";
+             have_special_suffix = 1;
+           }
+           else if(size == 2050 || size == 4100 || size == 8200){
+             special_suffix = "_3";
+             have_special_suffix = 1;
+           }
+           else if(size == 2060 || size == 4120 || size == 8240){
+             special_suffix = "_4";
+             have_special_suffix = 1;
+           }
+           else if(size == 2070 || size == 4140 || size == 8280){
+             special_suffix = "_5";
+             have_special_suffix = 1;
+           }
+           else if(size == 2080 || size == 4160 || size == 8320){
+             special_suffix = "_6";
+             have_special_suffix = 1;
+           }
+           else if(size == 2090 || size == 4180 || size == 8360){
+             special_suffix = "_7";
+             have_special_suffix = 1;
+           }
+           else if(size == 2100 || size == 4200 || size == 8400){
+             special_suffix = "_8";
+             have_special_suffix = 1;
+           }
+           else if(size == 2020 || size == 4040 || size == 8080){
+             special_suffix = "_a";
+             have_special_suffix = 1;
+           }
+            else if(size == 2010 || size == 4020 || size == 8040){
+             special_suffix = "_b";
+             have_special_suffix = 1;
+           }
+           else if(size == 2000 || size == 4000 || size == 8000){
+             special_suffix = "_c";
+             have_special_suffix = 1;
+           }
+           else if(size == 1990 || size == 3980 || size == 7960){
+             special_suffix = "_d";
+             have_special_suffix = 1;
+           }
+           else if(size == 1980 || size == 3960 || size == 7920){
+             special_suffix = "_e";
+             have_special_suffix = 1;
+           }
+           else if(size == 1970 || size == 3940 || size == 7880){
+             special_suffix = "_f";
+             have_special_suffix = 1;
+           }
+           else if(size == 1960 || size == 3920 || size == 7840){
+             special_suffix = "_g";
+             have_special_suffix = 1;
+           }
+           else if(size == 1950 || size == 3900 || size == 7800){
+             special_suffix = "_h";
+             have_special_suffix = 1;
+           }
+ 
+           if(have_special_suffix == 1) {
+            // store allocated memory in temp pointer
+            strcpy(tempStack, dimName);
+            temp = calloc ( sizeof(tempStack) + sizeof(special_suffix) + 1, 1 );
+            // copy dimName to the temp pointer memory
+            strcpy(temp, tempStack);
+            // concatenate dimName with dimSuffix
+            strcat(temp,special_suffix);
+            // Fix the name to comply with netCDF standards
+            catString = correct_name(temp);
+            // free the temp memory (catString is separately allocated memory, malloc'ed in the correct_name function
+            free(temp); temp = NULL;
+ 
+           }
+           else 
+             catString = correct_name(dimName);
+        }
+        /* Since dimension scales are shared, it is possible this dimension already exists in HDF5 file (previous
+           call to this function created it). Check to see if it does. If so, use the dimension that eixsts.
+        */
+        
+        free(correct_dsetname); correct_dsetname = NULL;
+
+        dsetExists = H5Lexists(h5dimGroupID, catString, H5P_DEFAULT);
+        // if dsetExists is <= 0, then dimension does not yet exist.
+        if ( dsetExists <= 0 )
+        {
+            /* If the dimension is one of the following, we will do an explicit dimension scale copy (hard code
+             * the scale values)
+             */
+            if ( strstr( catString, "Band_250M" ) != NULL )
+            {
+                tempInt = 2;
+                float floatBuffer[2] = {1.0f, 2.0f};
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                /* The dimensions in this if else chain are pure dimensions in HDF4, but we want to convert them to a real
+                 * dimension in the HDF5 file. Set this flag to 1 to indicate that the final result IS a real dimension.
+                 * Flag will be used to prevent setting the NAME attribute downstream
+                 */
+                wasHardCodeCopy = 1;
+            }
+            else if ( strstr( catString, "Band_500M" ) != NULL )
+            {
+                tempInt = 5;
+                float floatBuffer[5] = {3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                wasHardCodeCopy = 1;
+            }
+            else if ( strstr( catString, "Band_1KM_RefSB" ) != NULL )
+            {
+                float floatBuffer[15] = { 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 13.5f, 14.0f, 14.5f, 15.0f, 16.0f, 17.0f, 18.0f, 19.0f, 26.0f };
+                tempInt = 15;
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                wasHardCodeCopy = 1;
+            }
+            else if ( strstr( catString, "Band_1KM_Emissive" ) != NULL )
+            {
+                float floatBuffer[16] = { 20.0f, 21.0f, 22.0f, 23.0f, 24.0f, 25.0f, 27.0f, 28.0f, 29.0f, 30.0f, 31.0f, 32.0f, 33.0f, 34.0f, 35.0f, 36.0f };
+                tempInt = 16;
+                h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
+                if ( h5dimID == FATAL_ERR )
+                {
+                    h5dimID = 0;
+                    FATAL_MSG("Failed to insert dataset.\n");
+                    goto cleanupFail;
+                }
+                wasHardCodeCopy = 1;
+            }
+
+            /* Else, the dimension is none of those listed. Do a normal copy by reading scale values from
+               the input file (a non-hard coded copy)
+             */
+            else
+            {
+                wasHardCodeCopy = 0;
+                /* SDdiminfo will return 0 for ntype if the dimension has no scale information. This is the case when
+                   it is a pure dimension.  We need two separate cases for when it is and is not a pure dim
+                */
+
+                if ( ntype != 0 )
+                {
+                    /* get the correct HDF5 datatype from ntype */
+                    status = h4type_to_h5type( ntype, &h5type );
+                    if ( status != 0 )
+                    {
+                        FATAL_MSG("Failed to convert HDF4 to HDF5 datatype.\n");
+                        goto cleanupFail;
+                    }
+
+                    /* read the dimension scale into a buffer */
+                    dimBuffer = malloc(size);
+                    //int32 start[1] = {0};
+                    //int32 stride[1] = {1};
+                    //statusn = SDreaddata( h4dimID, start, stride, &dimSizes, dimBuffer );
+                    statusn = SDgetdimscale(h4dimID, dimBuffer);
+                    if ( statusn != 0 )
+                    {
+                        FATAL_MSG("Failed to get dimension scale.\n");
+                        goto cleanupFail;
+                    }
+
+                    /* make a new dataset for our dimension scale */
+
+                    tempInt = size;
+                    h5dimID = insertDataset(ctx, &h5dimGroupID, 1, 1, &tempInt, h5type, catString, dimBuffer);
+                    if ( h5dimID == FATAL_ERR )
+                    {
+                        h5dimID = 0;
+                        FATAL_MSG("Failed to insert dataset.\n");
+                        goto cleanupFail;
+                    }
+
+                    free(dimBuffer);
+                    dimBuffer = NULL;
+                }
+
+                else
+                {
+                    hsize_t tempSize2 = 0;
+
+                    tempSize2 = (hsize_t) size;
+                    memspace = H5Screate_simple( 1, &tempSize2, NULL );
+
+                    h5dimID = H5Dcreate( h5dimGroupID, catString, H5T_NATIVE_INT, memspace,
+                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+                    if ( h5dimID < 0 )
+                    {
+                        FATAL_MSG("Failed to create dataset.\n");
+                        h5dimID = 0;
+                        goto cleanupFail;
+                    }
+
+                    H5Sclose(memspace);
+                    memspace = 0;
+
+                } // end else
+            } // end else
+
+            /* A pure dimension gets its NAME from change_dim_attr_NAME_value below */
+            errStatus = H5DSset_scale(h5dimID, ( ntype == 0 && !wasHardCodeCopy ) ? NULL : catString);
+            if ( errStatus != 0 )
+            {
+                FATAL_MSG("Failed to set dataset as a dimension scale.\n");
+                goto cleanupFail;
+            }
+
+
+            /* Correct the NAME attribute of the pure dimension to conform with netCDF
+               standards.
+            */
+            if ( ntype == 0 && !wasHardCodeCopy )
+            {
+                statusn = change_dim_attr_NAME_value(ctx,h5dimID);
+                if ( statusn == FAIL )
+                {
+                    FATAL_MSG("Failed to change the NAME attribute of a dimension.\n");
+                    goto cleanupFail;
+                }
+            }
+        } // end if ( dsetExists <= 0 )
 
-    case DFNT_NUINT8:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting result may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_UCHAR;
-        h4memsize = sizeof(int8);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
         else
         {
-            FATAL_MSG("cannot convert unsighed naive INT8\n");
-            return FAIL;
+            h5dimID = H5Dopen2(h5dimGroupID, catString, H5P_DEFAULT);
+            if ( h5dimID < 0 )
+            {
+                h5dimID = 0;
+                FATAL_MSG("Failed to open dataset.\n");
+                goto cleanupFail;
+            }
         }
-        break;
 
-    case DFNT_LINT8:
-        
-        //if(h5type) *h5type = H5T_STD_I8LE;
-        h4memsize = sizeof(int8);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
-        {
 
-            FATAL_MSG("cannot convert little-endian INT8\n");
-            return FAIL;
+        errStatus = registerDimScale(ctx,h5dsetID, h5dimID, dim_index);
+        if ( errStatus != 0 )
+        {
+            FATAL_MSG("Failed to attach dimension scale.\n");
+            goto cleanupFail;
         }
-        break;
 
-    case DFNT_LUINT8:
-        
-        //if(h5type) *h5type = H5T_STD_U8LE;
-        h4memsize = sizeof(int8);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else
+        free(correct_dsetname);
+        correct_dsetname = NULL;
+        H5Dclose(h5dimID);
+        h5dimID = 0;
+        free(catString); catString = NULL;
+    }   // end for loop
+
+    fail = 0;
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    if ( dimName ) free ( dimName );
+    if ( h5dimID ) H5Dclose(h5dimID);
+    if ( dimBuffer ) free(dimBuffer);
+    if ( correct_dsetname ) free(correct_dsetname);
+    if ( memspace ) H5Sclose(memspace);
+    if ( catString ) free(catString);
+    if ( temp ) free(temp);
+
+    if ( fail ) return FAIL;
+
+    return SUCCEED;
+
+}
+
+
+
+/*
+                        getSubFileName
+    DESCRIPTION:
+        This function derives the name of a sub-file holding part of the fused orbit, either the
+        part of one instrument (split output), the part one MPI rank wrote, or both. A trailing ".h5"
+        extension of the master file name is kept at the end of the sub-file name, e.g.
+        "TERRA_BF_L1B_O12345.h5" becomes "TERRA_BF_L1B_O12345_MODIS_r3.h5" for instrument "MODIS" and rank 3.
+    ARGUMENTS:
+        const char* outputFileName  -- The name of the master output file
+        const char* instrument      -- The instrument of the sub-file, or NULL if the output is not split by instrument
+        int rank                    -- The rank that writes the sub-file, or -1 if not written by an MPI rank
+    EFFECTS:
+        Allocates memory for the returned string. Caller must free it.
+    RETURN:
+        NULL on failure
+        Pointer to the sub-file name on success
+*/
+
+char* getSubFileName( const char* outputFileName, const char* instrument, int rank )
+{
+    const char* ext = ".h5";
+    size_t baseLen = strlen(outputFileName);
+    char* subFileName = NULL;
+    char rankSuffix[16] = {'\0'};
+
+    if ( baseLen > strlen(ext) && strcmp( outputFileName + baseLen - strlen(ext), ext ) == 0 )
+        baseLen -= strlen(ext);
+    else
+        ext = "";
+
+    if ( rank >= 0 )
+        sprintf( rankSuffix, "_r%d", rank );
+
+    subFileName = calloc( baseLen + (instrument ? strlen(instrument) + 1 : 0) + strlen(rankSuffix) + strlen(ext) + 1, 1 );
+    if ( subFileName == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return NULL;
+    }
+
+    sprintf( subFileName, "%.*s%s%s%s%s", (int) baseLen, outputFileName, instrument ? "_" : "",
+             instrument ? instrument : "", rankSuffix, ext );
+
+    return subFileName;
+}
+
+/* Helpers for linkSubFiles */
+
+typedef struct
+{
+    char** names;
+    size_t num;
+    size_t size;
+} linkNameList_t;
+
+static herr_t collectLinkNames( hid_t loc_id, const char* name, const H5L_info_t* linfo, void* opdata )
+{
+    linkNameList_t* list = (linkNameList_t*) opdata;
+
+    if ( list->num == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 16;
+        char** tempPtr = realloc( list->names, newSize * sizeof(char*) );
+        if ( tempPtr == NULL )
         {
-            FATAL_MSG("cannot convert little-endian unsigned INT\n8");
-            return FAIL;
+            FATAL_MSG("Failed to allocate memory.\n");
+            return -1;
         }
-        break;
+        list->names = tempPtr;
+        list->size = newSize;
+    }
+
+    list->names[list->num] = malloc( strlen(name) + 1 );
+    if ( list->names[list->num] == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return -1;
+    }
+    strcpy( list->names[list->num], name );
+    list->num++;
+
+    return 0;
+}
+
+static void freeLinkNames( linkNameList_t* list )
+{
+    for ( size_t i = 0; i < list->num; i++ )
+        free(list->names[i]);
+    free(list->names);
+    list->names = NULL;
+    list->num = list->size = 0;
+}
+
+static herr_t copyAttrCallback( hid_t srcObjID, const char* attrName, const H5A_info_t* ainfo, void* opdata )
+{
+    hid_t dstObjID = *(hid_t*) opdata;
+    hid_t srcAttrID = 0;
+    hid_t dstAttrID = 0;
+    hid_t typeID = 0;
+    hid_t spaceID = 0;
+    void* buffer = NULL;
+    herr_t ret = -1;
+    hssize_t numElems = 0;
+
+    srcAttrID = H5Aopen( srcObjID, attrName, H5P_DEFAULT );
+    if ( srcAttrID < 0 )
+    {
+        FATAL_MSG("Failed to open the attribute \"%s\".\n", attrName);
+        srcAttrID = 0;
+        goto cleanup;
+    }
+    typeID = H5Aget_type(srcAttrID);
+    spaceID = H5Aget_space(srcAttrID);
+    if ( typeID < 0 || spaceID < 0 )
+    {
+        FATAL_MSG("Failed to get the type or space of the attribute \"%s\".\n", attrName);
+        if ( typeID < 0 ) typeID = 0;
+        if ( spaceID < 0 ) spaceID = 0;
+        goto cleanup;
+    }
+    numElems = H5Sget_simple_extent_npoints(spaceID);
+    buffer = calloc( numElems > 0 ? numElems : 1, H5Tget_size(typeID) );
+    if ( buffer == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanup;
+    }
+    if ( H5Aread( srcAttrID, typeID, buffer ) < 0 )
+    {
+        FATAL_MSG("Failed to read the attribute \"%s\".\n", attrName);
+        goto cleanup;
+    }
+
+    if ( H5Aexists( dstObjID, attrName ) > 0 && H5Adelete( dstObjID, attrName ) < 0 )
+    {
+        FATAL_MSG("Failed to delete the existing attribute \"%s\".\n", attrName);
+        goto cleanup;
+    }
+    dstAttrID = H5Acreate2( dstObjID, attrName, typeID, spaceID, H5P_DEFAULT, H5P_DEFAULT );
+    if ( dstAttrID < 0 )
+    {
+        FATAL_MSG("Failed to create the attribute \"%s\".\n", attrName);
+        dstAttrID = 0;
+        goto cleanup;
+    }
+    if ( H5Awrite( dstAttrID, typeID, buffer ) < 0 )
+    {
+        FATAL_MSG("Failed to write the attribute \"%s\".\n", attrName);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+cleanup:
+    /* Variable-length members (e.g. variable length strings) are allocated by the library */
+    if ( buffer && typeID && spaceID && H5Tdetect_class( typeID, H5T_VLEN ) > 0 )
+        H5Dvlen_reclaim( typeID, spaceID, H5P_DEFAULT, buffer );
+    else if ( buffer && typeID && spaceID && H5Tget_class(typeID) == H5T_STRING && H5Tis_variable_str(typeID) > 0 )
+        H5Dvlen_reclaim( typeID, spaceID, H5P_DEFAULT, buffer );
+    if ( buffer ) free(buffer);
+    if ( dstAttrID ) H5Aclose(dstAttrID);
+    if ( srcAttrID ) H5Aclose(srcAttrID);
+    if ( typeID ) H5Tclose(typeID);
+    if ( spaceID ) H5Sclose(spaceID);
+
+    return ret;
+}
+
+/*
+                        copyObjAttrs
+    DESCRIPTION:
+        This function copies every attribute of one HDF5 object to another HDF5 object. The two objects
+        may live in different files. Attributes that already exist at the destination are overwritten.
+    ARGUMENTS:
+        hid_t srcObjID  -- The object (file, group or dataset) to copy the attributes from
+        hid_t dstObjID  -- The object to copy the attributes to
+    EFFECTS:
+        Creates attributes at dstObjID.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t copyObjAttrs( hid_t srcObjID, hid_t dstObjID )
+{
+    if ( H5Aiterate2( srcObjID, H5_INDEX_NAME, H5_ITER_INC, NULL, copyAttrCallback, &dstObjID ) < 0 )
+    {
+        FATAL_MSG("Failed to copy the attributes.\n");
+        return FATAL_ERR;
+    }
+
+    return RET_SUCCESS;
+}
+
+static const char* fileBaseName( const char* path )
+{
+    const char* slash = strrchr( path, '/' );
+    return slash ? slash + 1 : path;
+}
+
+/* Link the children of groupPath in sub-file subIdx into the master file. Groups that are present in
+ * more than one sub-file are made real groups in the master file and the merge descends into them.
+ */
+static herr_t linkSubFileGroup( hid_t masterFileID, const hid_t subFileIDs[], char* subFileNames[], int numSubFiles,
+                                int subIdx, const char* groupPath )
+{
+    linkNameList_t children = {NULL, 0, 0};
+    char* childPath = NULL;
+    hid_t srcGroupID = 0;
+    hid_t newGroupID = 0;
+    hid_t oldGroupID = 0;
+    void* linkVal = NULL;
+    short fail = 0;
+
+    srcGroupID = H5Gopen2( subFileIDs[subIdx], groupPath, H5P_DEFAULT );
+    if ( srcGroupID < 0 )
+    {
+        FATAL_MSG("Failed to open group \"%s\" in %s.\n", groupPath, subFileNames[subIdx]);
+        srcGroupID = 0;
+        goto cleanupFail;
+    }
+    if ( H5Literate( srcGroupID, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames, &children ) < 0 )
+    {
+        FATAL_MSG("Failed to iterate over group \"%s\" in %s.\n", groupPath, subFileNames[subIdx]);
+        goto cleanupFail;
+    }
 
-    case DFNT_INT16:
-        
-        //if(h5type) *h5type = H5T_STD_I16BE;
-        h4memsize = sizeof(int16);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
-        {
-            FATAL_MSG("cannot convert signed int16\n");
-            return FAIL;
-        }
-        break;
+    for ( size_t i = 0; i < children.num; i++ )
+    {
+        H5O_info_t srcInfo;
+        H5L_info_t masterInfo;
+        htri_t exists = 0;
 
-    case DFNT_UINT16:
-        
-        //if(h5type) *h5type = H5T_STD_U16BE;
-        h4memsize = sizeof(int16);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else
+        childPath = calloc( strlen(groupPath) + strlen(children.names[i]) + 2, 1 );
+        if ( childPath == NULL )
         {
-            FATAL_MSG("cannot convert unsigned int16\n");
-            return FAIL;
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
         }
-        break;
-
-    case DFNT_NINT16:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting result may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_SHORT;
-        h4memsize = sizeof(int16);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
+        if ( strcmp( groupPath, "/" ) == 0 )
+            sprintf( childPath, "/%s", children.names[i] );
         else
-        {
-            FATAL_MSG("cannot convert native int16\n");
-            return FAIL;
-        }
-        break;
+            sprintf( childPath, "%s/%s", groupPath, children.names[i] );
 
-    case DFNT_NUINT16:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting result may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_USHORT;
-        h4memsize = sizeof(int16);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else
+        exists = H5Lexists( masterFileID, childPath, H5P_DEFAULT );
+        if ( exists < 0 )
         {
-            FATAL_MSG("cannot convert unsigned native int16\n");
-            return FAIL;
+            FATAL_MSG("Failed to check the existence of %s in the master file.\n", childPath);
+            goto cleanupFail;
         }
-        break;
 
-    case DFNT_LINT16:
-        
-        //if(h5type) *h5type = H5T_STD_I16LE;
-        h4memsize = sizeof(int16);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
+        /* First come, first linked */
+        if ( exists == 0 )
         {
-            FATAL_MSG("cannot convert little-endian int16\n");
-            return FAIL;
+            if ( H5Lcreate_external( fileBaseName(subFileNames[subIdx]), childPath, masterFileID, childPath,
+                                     H5P_DEFAULT, H5P_DEFAULT ) < 0 )
+            {
+                FATAL_MSG("Failed to create an external link to %s:%s.\n", subFileNames[subIdx], childPath);
+                goto cleanupFail;
+            }
+            free(childPath); childPath = NULL;
+            continue;
         }
-        break;
 
-    case DFNT_LUINT16:
-        
-        //if(h5type) *h5type = H5T_STD_U16LE;
-        h4memsize = sizeof(int16);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else
+        /* The name is already taken. Only groups are merged, the first copy of anything else
+         * (e.g. a dimension scale every rank created for itself) wins.
+         */
+        if ( H5Oget_info_by_name( subFileIDs[subIdx], childPath, &srcInfo, H5P_DEFAULT ) < 0 )
         {
-            FATAL_MSG("cannot convert little-endian unsigned int16\n");
-            return FAIL;
+            FATAL_MSG("Failed to get the object info of %s:%s.\n", subFileNames[subIdx], childPath);
+            goto cleanupFail;
         }
-        break;
-
-    case DFNT_INT32:
-        
-        //if(h5type) *h5type = H5T_STD_I32BE;
-        h4memsize = sizeof(int32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
+        if ( srcInfo.type != H5O_TYPE_GROUP )
         {
-            FATAL_MSG("cannot convert signed int32\n");
-            return FAIL;
+            free(childPath); childPath = NULL;
+            continue;
         }
-        break;
 
-    case DFNT_UINT32:
-        
-        //if(h5type) *h5type = H5T_STD_U32BE;
-        h4memsize = sizeof(int32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else
+        if ( H5Lget_info( masterFileID, childPath, &masterInfo, H5P_DEFAULT ) < 0 )
         {
-            FATAL_MSG("cannot convert unsigned int32\n");
-            return FAIL;
+            FATAL_MSG("Failed to get the link info of %s in the master file.\n", childPath);
+            goto cleanupFail;
         }
-        break;
 
-    case DFNT_NINT32:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting result may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_INT;
-        h4memsize = sizeof(int32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
+        if ( masterInfo.type == H5L_TYPE_EXTERNAL )
         {
-            FATAL_MSG("cannot convert native signed int32\n");
-            return FAIL;
-        }
-        break;
+            /* Replace the external link by a real group holding the attributes of the linked group and
+             * merge the children of the previously linked sub-file into it.
+             */
+            const char* prevFile = NULL;
+            const char* prevPath = NULL;
+            int prevIdx = -1;
 
-    case DFNT_NUINT32:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting results may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_UINT;
-        h4memsize = sizeof(int32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
+            linkVal = malloc( masterInfo.u.val_size );
+            if ( linkVal == NULL )
+            {
+                FATAL_MSG("Failed to allocate memory.\n");
+                goto cleanupFail;
+            }
+            if ( H5Lget_val( masterFileID, childPath, linkVal, masterInfo.u.val_size, H5P_DEFAULT ) < 0 ||
+                 H5Lunpack_elink_val( linkVal, masterInfo.u.val_size, NULL, &prevFile, &prevPath ) < 0 )
+            {
+                FATAL_MSG("Failed to get the external link value of %s.\n", childPath);
+                goto cleanupFail;
+            }
+            for ( int j = 0; j < numSubFiles; j++ )
+                if ( strcmp( fileBaseName(subFileNames[j]), prevFile ) == 0 )
+                    prevIdx = j;
+            if ( prevIdx < 0 )
+            {
+                FATAL_MSG("%s links to the unknown file %s.\n", childPath, prevFile);
+                goto cleanupFail;
+            }
+            free(linkVal); linkVal = NULL;
+
+            if ( H5Ldelete( masterFileID, childPath, H5P_DEFAULT ) < 0 )
+            {
+                FATAL_MSG("Failed to delete the external link %s.\n", childPath);
+                goto cleanupFail;
+            }
+            newGroupID = H5Gcreate2( masterFileID, childPath, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+            if ( newGroupID < 0 )
+            {
+                FATAL_MSG("Failed to create group %s in the master file.\n", childPath);
+                newGroupID = 0;
+                goto cleanupFail;
+            }
+            oldGroupID = H5Gopen2( subFileIDs[prevIdx], childPath, H5P_DEFAULT );
+            if ( oldGroupID < 0 )
+            {
+                FATAL_MSG("Failed to open %s:%s.\n", subFileNames[prevIdx], childPath);
+                oldGroupID = 0;
+                goto cleanupFail;
+            }
+            if ( copyObjAttrs( oldGroupID, newGroupID ) == FATAL_ERR )
+            {
+                FATAL_MSG("Failed to copy the attributes of %s.\n", childPath);
+                goto cleanupFail;
+            }
+            H5Gclose(oldGroupID); oldGroupID = 0;
+            H5Gclose(newGroupID); newGroupID = 0;
+
+            if ( linkSubFileGroup( masterFileID, subFileIDs, subFileNames, numSubFiles, prevIdx, childPath ) == FATAL_ERR )
+                goto cleanupFail;
+        }
         else
         {
-            FATAL_MSG("cannot convert signed int32\n");
-            return FAIL;
+            H5O_info_t masterObjInfo;
+
+            if ( masterInfo.type != H5L_TYPE_HARD ||
+                 H5Oget_info_by_name( masterFileID, childPath, &masterObjInfo, H5P_DEFAULT ) < 0 ||
+                 masterObjInfo.type != H5O_TYPE_GROUP )
+            {
+                free(childPath); childPath = NULL;
+                continue;
+            }
         }
-        break;
 
-    case DFNT_LINT32:
-        
-        //if(h5type) *h5type = H5T_STD_I32LE;
-        h4memsize = sizeof(int32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else
+        if ( linkSubFileGroup( masterFileID, subFileIDs, subFileNames, numSubFiles, subIdx, childPath ) == FATAL_ERR )
+            goto cleanupFail;
+
+        free(childPath); childPath = NULL;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    freeLinkNames(&children);
+    if ( childPath ) free(childPath);
+    if ( linkVal ) free(linkVal);
+    if ( srcGroupID ) H5Gclose(srcGroupID);
+    if ( newGroupID ) H5Gclose(newGroupID);
+    if ( oldGroupID ) H5Gclose(oldGroupID);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/*
+                        linkSubFiles
+    DESCRIPTION:
+        This function assembles several sub-files, each holding part of the fused orbit, into one master
+        file that exposes the usual BF group hierarchy. Every object of a sub-file's root group is made
+        available in the master file through an external link. Groups that exist in more than one sub-file
+        (for instance /ASTER when the ASTER granules were written by several ranks) become real groups in the
+        master file carrying the attributes of the first copy, and their children are linked individually.
+        For any other name clash, the object of the sub-file listed first is kept.
+
+        External links store only the base name of the sub-file, so the master file and its sub-files
+        must be kept in the same directory.
+    ARGUMENTS:
+        hid_t masterFileID      -- The master file. It is expected to be empty.
+        char* subFileNames[]    -- The paths of the sub-files in the order they should take precedence
+        int numSubFiles         -- The number of sub-files
+    EFFECTS:
+        Creates groups and external links in the master file.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t linkSubFiles( hid_t masterFileID, char* subFileNames[], int numSubFiles )
+{
+    hid_t* subFileIDs = NULL;
+    short fail = 0;
+
+    subFileIDs = calloc( numSubFiles, sizeof(hid_t) );
+    if ( subFileIDs == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return FATAL_ERR;
+    }
+
+    for ( int i = 0; i < numSubFiles; i++ )
+    {
+        subFileIDs[i] = H5Fopen( subFileNames[i], H5F_ACC_RDONLY, H5P_DEFAULT );
+        if ( subFileIDs[i] < 0 )
         {
-            FATAL_MSG("cannot convert little-endian signed int32\n");
-            return FAIL;
+            FATAL_MSG("Failed to open the sub-file %s.\n", subFileNames[i]);
+            subFileIDs[i] = 0;
+            goto cleanupFail;
         }
-        break;
+    }
 
-    case DFNT_LUINT32:
-        
-        //if(h5type) *h5type = H5T_STD_U32LE;
-        h4memsize = sizeof(int32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else
+    for ( int i = 0; i < numSubFiles; i++ )
+    {
+        if ( linkSubFileGroup( masterFileID, subFileIDs, subFileNames, numSubFiles, i, "/" ) == FATAL_ERR )
         {
-            FATAL_MSG("cannot convert little-endian unsigned int32\n");
-            return FAIL;
+            FATAL_MSG("Failed to link the sub-file %s into the master file.\n", subFileNames[i]);
+            goto cleanupFail;
         }
-        break;
+    }
 
-    case DFNT_INT64:
-        
-        //if(h5type) *h5type = H5T_STD_I64BE;
-        h4memsize = sizeof(long);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
-            *h5memtype = H5T_NATIVE_LLONG;
-        else
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    for ( int i = 0; i < numSubFiles; i++ )
+        if ( subFileIDs[i] ) H5Fclose(subFileIDs[i]);
+    free(subFileIDs);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/* Helpers for consolidateSubFiles */
+
+/* Copy the children of groupPath in the sub-file into the master file. Groups present in the master file
+ * already are merged, for anything else the first copy wins. The paths of the copied objects are
+ * appended to copiedPaths.
+ */
+static herr_t copySubFileGroup( hid_t masterFileID, hid_t subFileID, const char* groupPath, linkNameList_t* copiedPaths )
+{
+    linkNameList_t children = {NULL, 0, 0};
+    char* childPath = NULL;
+    short fail = 0;
+
+    if ( H5Literate_by_name( subFileID, groupPath, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames,
+                             &children, H5P_DEFAULT ) < 0 )
+    {
+        FATAL_MSG("Failed to iterate over group \"%s\".\n", groupPath);
+        goto cleanupFail;
+    }
+
+    for ( size_t i = 0; i < children.num; i++ )
+    {
+        H5O_info_t srcInfo;
+        H5O_info_t masterInfo;
+        htri_t exists = 0;
+
+        childPath = calloc( strlen(groupPath) + strlen(children.names[i]) + 2, 1 );
+        if ( childPath == NULL )
         {
-            FATAL_MSG("cannot convert signed int64\n");
-            return FAIL;
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
         }
-        break;
-
-    case DFNT_UINT64:
-        
-        //if(h5type) *h5type = H5T_STD_U64BE;
-        h4memsize = sizeof(long);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
-            *h5memtype = H5T_NATIVE_ULLONG;
+        if ( strcmp( groupPath, "/" ) == 0 )
+            sprintf( childPath, "/%s", children.names[i] );
         else
+            sprintf( childPath, "%s/%s", groupPath, children.names[i] );
+
+        exists = H5Lexists( masterFileID, childPath, H5P_DEFAULT );
+        if ( exists < 0 )
         {
-            FATAL_MSG("cannot convert unsigned int64\n");
-            return FAIL;
+            FATAL_MSG("Failed to check the existence of %s in the master file.\n", childPath);
+            goto cleanupFail;
         }
-        break;
 
-    case DFNT_NINT64:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting result may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_INT;
-        h4memsize = sizeof(long);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
-            *h5memtype = H5T_NATIVE_LLONG;
+        if ( exists == 0 )
+        {
+            if ( H5Ocopy( subFileID, childPath, masterFileID, childPath, H5P_DEFAULT, H5P_DEFAULT ) < 0 )
+            {
+                FATAL_MSG("Failed to copy %s into the master file.\n", childPath);
+                goto cleanupFail;
+            }
+            if ( collectLinkNames( masterFileID, childPath, NULL, copiedPaths ) < 0 )
+                goto cleanupFail;
+        }
         else
         {
-            FATAL_MSG("cannot convert native signed int64");
-            return FAIL;
+            if ( H5Oget_info_by_name( subFileID, childPath, &srcInfo, H5P_DEFAULT ) < 0 ||
+                 H5Oget_info_by_name( masterFileID, childPath, &masterInfo, H5P_DEFAULT ) < 0 )
+            {
+                FATAL_MSG("Failed to get the object info of %s.\n", childPath);
+                goto cleanupFail;
+            }
+            if ( srcInfo.type == H5O_TYPE_GROUP && masterInfo.type == H5O_TYPE_GROUP &&
+                 copySubFileGroup( masterFileID, subFileID, childPath, copiedPaths ) == FATAL_ERR )
+                goto cleanupFail;
         }
-        break;
 
-    case DFNT_NUINT64:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting results may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_UINT;
-        h4memsize = sizeof(long);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
-            *h5memtype = H5T_NATIVE_ULLONG;
-        else
+        free(childPath); childPath = NULL;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    freeLinkNames(&children);
+    if ( childPath ) free(childPath);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/* H5Ocopy copies object references in attributes verbatim, so after copying between files the dimension
+ * scale attributes point to nowhere. Strip them from every dataset of the master file.
+ */
+static herr_t stripDimScaleAttrs( hid_t fileID, const char* name, const H5O_info_t* info, void* opdata )
+{
+    hid_t dsetID = 0;
+    herr_t ret = 0;
+
+    if ( info->type != H5O_TYPE_DATASET )
+        return 0;
+
+    dsetID = H5Dopen2( fileID, name, H5P_DEFAULT );
+    if ( dsetID < 0 )
+    {
+        FATAL_MSG("Failed to open dataset %s.\n", name);
+        return -1;
+    }
+    if ( H5Aexists( dsetID, "DIMENSION_LIST" ) > 0 && H5Adelete( dsetID, "DIMENSION_LIST" ) < 0 )
+    {
+        FATAL_MSG("Failed to delete the DIMENSION_LIST attribute of %s.\n", name);
+        ret = -1;
+    }
+    if ( H5Aexists( dsetID, "REFERENCE_LIST" ) > 0 && H5Adelete( dsetID, "REFERENCE_LIST" ) < 0 )
+    {
+        FATAL_MSG("Failed to delete the REFERENCE_LIST attribute of %s.\n", name);
+        ret = -1;
+    }
+    H5Dclose(dsetID);
+
+    return ret;
+}
+
+typedef struct
+{
+    BFcontext_t* ctx;
+    hid_t masterFileID;
+    const char* basePath;
+} reattachInfo_t;
+
+/* Attach the dimension scales of one copied dataset in the master file the same way they are attached
+ * in the sub-file. Scales are looked up by path.
+ */
+static herr_t reattachDimScales( hid_t subGroupID, const char* name, const H5O_info_t* info, void* opdata )
+{
+    reattachInfo_t* reattach = (reattachInfo_t*) opdata;
+    hid_t srcDsetID = 0;
+    hid_t dstDsetID = 0;
+    hid_t scaleID = 0;
+    hid_t attrID = 0;
+    hid_t attrType = 0;
+    hid_t attrSpace = 0;
+    hvl_t* dimList = NULL;
+    char* dsetPath = NULL;
+    char scalePath[STR_LEN];
+    int rank = 0;
+    herr_t ret = -1;
+
+    if ( info->type != H5O_TYPE_DATASET )
+        return 0;
+
+    srcDsetID = H5Dopen2( subGroupID, name, H5P_DEFAULT );
+    if ( srcDsetID < 0 )
+    {
+        FATAL_MSG("Failed to open dataset %s.\n", name);
+        srcDsetID = 0;
+        goto cleanup;
+    }
+    if ( H5Aexists( srcDsetID, "DIMENSION_LIST" ) <= 0 )
+    {
+        ret = 0;
+        goto cleanup;
+    }
+
+    dsetPath = calloc( strlen(reattach->basePath) + strlen(name) + 2, 1 );
+    if ( dsetPath == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanup;
+    }
+    if ( strcmp( name, "." ) == 0 )
+        strcpy( dsetPath, reattach->basePath );
+    else
+        sprintf( dsetPath, "%s/%s", reattach->basePath, name );
+
+    dstDsetID = H5Dopen2( reattach->masterFileID, dsetPath, H5P_DEFAULT );
+    if ( dstDsetID < 0 )
+    {
+        FATAL_MSG("Failed to open dataset %s in the master file.\n", dsetPath);
+        dstDsetID = 0;
+        goto cleanup;
+    }
+
+    attrID = H5Aopen( srcDsetID, "DIMENSION_LIST", H5P_DEFAULT );
+    attrType = H5Tvlen_create( H5T_STD_REF_OBJ );
+    attrSpace = H5Aget_space( attrID );
+    if ( attrID < 0 || attrType < 0 || attrSpace < 0 )
+    {
+        FATAL_MSG("Failed to open the DIMENSION_LIST attribute of %s.\n", dsetPath);
+        if ( attrID < 0 ) attrID = 0;
+        if ( attrType < 0 ) attrType = 0;
+        if ( attrSpace < 0 ) attrSpace = 0;
+        goto cleanup;
+    }
+    rank = (int) H5Sget_simple_extent_npoints( attrSpace );
+    dimList = calloc( rank, sizeof(hvl_t) );
+    if ( dimList == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanup;
+    }
+    if ( H5Aread( attrID, attrType, dimList ) < 0 )
+    {
+        FATAL_MSG("Failed to read the DIMENSION_LIST attribute of %s.\n", dsetPath);
+        goto cleanup;
+    }
+
+    for ( int dim = 0; dim < rank; dim++ )
+    {
+        for ( size_t j = 0; j < dimList[dim].len; j++ )
         {
-            FATAL_MSG("cannot convert signed int64\n");
-            return FAIL;
+            hobj_ref_t* ref = (hobj_ref_t*) dimList[dim].p + j;
+
+            if ( H5Rget_name( srcDsetID, H5R_OBJECT, ref, scalePath, STR_LEN ) <= 0 )
+            {
+                FATAL_MSG("Failed to resolve a dimension scale reference of %s.\n", dsetPath);
+                goto cleanup;
+            }
+            scaleID = H5Dopen2( reattach->masterFileID, scalePath, H5P_DEFAULT );
+            if ( scaleID < 0 )
+            {
+                FATAL_MSG("Failed to open the dimension scale %s in the master file.\n", scalePath);
+                scaleID = 0;
+                goto cleanup;
+            }
+            if ( registerDimScale( reattach->ctx, dstDsetID, scaleID, dim ) < 0 )
+            {
+                FATAL_MSG("Failed to attach %s to %s.\n", scalePath, dsetPath);
+                goto cleanup;
+            }
+            H5Dclose(scaleID); scaleID = 0;
         }
-        break;
+    }
 
-    case DFNT_LINT64:
-        
-        //if(h5type) *h5type = H5T_STD_I64LE;
-        h4memsize = sizeof(long);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_CHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_SHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_INT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_LONG;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
-            *h5memtype = H5T_NATIVE_LLONG;
-        else
+    ret = 0;
+
+cleanup:
+    if ( dimList )
+    {
+        H5Dvlen_reclaim( attrType, attrSpace, H5P_DEFAULT, dimList );
+        free(dimList);
+    }
+    if ( attrID ) H5Aclose(attrID);
+    if ( attrType ) H5Tclose(attrType);
+    if ( attrSpace ) H5Sclose(attrSpace);
+    if ( scaleID ) H5Dclose(scaleID);
+    if ( srcDsetID ) H5Dclose(srcDsetID);
+    if ( dstDsetID ) H5Dclose(dstDsetID);
+    if ( dsetPath ) free(dsetPath);
+
+    return ret;
+}
+
+/*
+                        consolidateSubFiles
+    DESCRIPTION:
+        This function produces the single-file layout out of several sub-files (see linkSubFiles for the
+        linked alternative). The objects of every sub-file are copied into the master file. Groups that
+        exist in more than one sub-file are merged; for any other name clash the object of the sub-file
+        listed first is kept. Since H5Ocopy does not carry dimension scale references across files, all
+        scales are attached again afterwards, matching scales and datasets by their path.
+    ARGUMENTS:
+        BFcontext_t* ctx        -- The conversion context, for the dimension scale registry
+        hid_t masterFileID      -- The master file. It is expected to be empty.
+        char* subFileNames[]    -- The paths of the sub-files in the order they should take precedence
+        int numSubFiles         -- The number of sub-files
+    EFFECTS:
+        Copies objects into the master file. The sub-files are left untouched.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t consolidateSubFiles( BFcontext_t* ctx, hid_t masterFileID, char* subFileNames[], int numSubFiles )
+{
+    hid_t* subFileIDs = NULL;
+    linkNameList_t* copiedPaths = NULL;
+    short fail = 0;
+
+    subFileIDs = calloc( numSubFiles, sizeof(hid_t) );
+    copiedPaths = calloc( numSubFiles, sizeof(linkNameList_t) );
+    if ( subFileIDs == NULL || copiedPaths == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+
+    for ( int i = 0; i < numSubFiles; i++ )
+    {
+        subFileIDs[i] = H5Fopen( subFileNames[i], H5F_ACC_RDONLY, H5P_DEFAULT );
+        if ( subFileIDs[i] < 0 )
         {
-            FATAL_MSG("cannot convert little-endian signed int64\n");
-            return FAIL;
+            FATAL_MSG("Failed to open the sub-file %s.\n", subFileNames[i]);
+            subFileIDs[i] = 0;
+            goto cleanupFail;
+        }
+        if ( copySubFileGroup( masterFileID, subFileIDs[i], "/", &copiedPaths[i] ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to copy the sub-file %s into the master file.\n", subFileNames[i]);
+            goto cleanupFail;
         }
-        break;
+    }
 
-    case DFNT_LUINT64:
-        
-        //if(h5type) *h5type = H5T_STD_U64LE;
-        h4memsize = sizeof(long);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_CHAR))
-            *h5memtype =  H5T_NATIVE_UCHAR;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_SHORT))
-            *h5memtype = H5T_NATIVE_USHORT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_INT))
-            *h5memtype = H5T_NATIVE_UINT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LONG))
-            *h5memtype = H5T_NATIVE_ULONG;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LLONG))
-            *h5memtype = H5T_NATIVE_ULLONG;
-        else
+    if ( H5Ovisit( masterFileID, H5_INDEX_NAME, H5_ITER_INC, stripDimScaleAttrs, NULL ) < 0 )
+    {
+        FATAL_MSG("Failed to remove the copied dimension scale attributes.\n");
+        goto cleanupFail;
+    }
+
+    for ( int i = 0; i < numSubFiles; i++ )
+    {
+        for ( size_t j = 0; j < copiedPaths[i].num; j++ )
         {
-            FATAL_MSG("cannot convert little-endian unsigned int64\n");
-            return FAIL;
+            reattachInfo_t reattach = { ctx, masterFileID, copiedPaths[i].names[j] };
+
+            if ( H5Ovisit_by_name( subFileIDs[i], copiedPaths[i].names[j], H5_INDEX_NAME, H5_ITER_INC,
+                                   reattachDimScales, &reattach, H5P_DEFAULT ) < 0 )
+            {
+                FATAL_MSG("Failed to attach the dimension scales of %s.\n", copiedPaths[i].names[j]);
+                goto cleanupFail;
+            }
         }
-        break;
+    }
 
-    case DFNT_FLOAT32:
-        
-        //if(h5type) *h5type = H5T_IEEE_F32BE;
-        h4memsize = sizeof(float32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
-            *h5memtype = H5T_NATIVE_FLOAT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
-            *h5memtype = H5T_NATIVE_DOUBLE;
-        else
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    /* Write the attachments, which also releases the registry's references to the master file */
+    if ( flushDimScales( ctx ) == FATAL_ERR )
+        fail = 1;
+
+    for ( int i = 0; subFileIDs && i < numSubFiles; i++ )
+        if ( subFileIDs[i] ) H5Fclose(subFileIDs[i]);
+    for ( int i = 0; copiedPaths && i < numSubFiles; i++ )
+        freeLinkNames(&copiedPaths[i]);
+    free(subFileIDs);
+    free(copiedPaths);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/* Checkpoint/resume. While BF_RESUME is set, the output file holds a BF_Checkpoint group that records the
+ * index of the next unit of work and the names of all objects at the root and one level below it at the time
+ * the last unit completed. The groups of completed units carry the BF_UnitComplete attribute, whose value is
+ * the list of input granules the unit wrote.
+ */
+#define CHECKPOINT_GROUP "BF_Checkpoint"
+#define CHECKPOINT_OBJECTS "BF_Checkpoint/objects"
+#define CHECKPOINT_NEXT_UNIT "next_unit"
+#define UNIT_MARKER "BF_UnitComplete"
+
+/* Collect the names of the root objects and of the children of root groups as absolute paths */
+static herr_t collectTopPaths( hid_t fileID, linkNameList_t* paths )
+{
+    linkNameList_t rootNames = {NULL, 0, 0};
+    linkNameList_t childNames = {NULL, 0, 0};
+    char* path = NULL;
+    short fail = 0;
+
+    if ( H5Literate( fileID, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames, &rootNames ) < 0 )
+    {
+        FATAL_MSG("Failed to iterate over the root group.\n");
+        goto cleanupFail;
+    }
+
+    for ( size_t i = 0; i < rootNames.num; i++ )
+    {
+        H5O_info_t info;
+
+        if ( strcmp( rootNames.names[i], CHECKPOINT_GROUP ) == 0 )
+            continue;
+
+        path = malloc( strlen(rootNames.names[i]) + 2 );
+        if ( path == NULL )
         {
-            FATAL_MSG("cannot convert float32\n");
-            return FAIL;
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
         }
-        break;
+        sprintf( path, "/%s", rootNames.names[i] );
+        if ( collectLinkNames( fileID, path, NULL, paths ) < 0 )
+            goto cleanupFail;
 
-    case DFNT_FLOAT64:
-        
-        //if(h5type) *h5type = H5T_IEEE_F64BE;
-        h4memsize = sizeof(float64);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
-            *h5memtype = H5T_NATIVE_FLOAT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
-            *h5memtype = H5T_NATIVE_DOUBLE;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LDOUBLE))
-            *h5memtype = H5T_NATIVE_LDOUBLE;
-        else
+        if ( H5Oget_info_by_name( fileID, path, &info, H5P_DEFAULT ) < 0 )
         {
-            FATAL_MSG("cannot convert float64\n");
-            return FAIL;
+            FATAL_MSG("Failed to get the object info of %s.\n", path);
+            goto cleanupFail;
         }
-        break;
-
-    case DFNT_NFLOAT32:
-        /*printf("warning, Native HDF datatype is encountered");
-        printf(" the converting results may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_FLOAT;
-        h4memsize = sizeof(float32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
-            *h5memtype = H5T_NATIVE_FLOAT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
-            *h5memtype = H5T_NATIVE_DOUBLE;
-        else
+        if ( info.type == H5O_TYPE_GROUP )
         {
-            FATAL_MSG("cannot convert native float32\n");
-            return FAIL;
+            if ( H5Literate_by_name( fileID, path, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames,
+                                     &childNames, H5P_DEFAULT ) < 0 )
+            {
+                FATAL_MSG("Failed to iterate over group %s.\n", path);
+                goto cleanupFail;
+            }
+            for ( size_t j = 0; j < childNames.num; j++ )
+            {
+                char* childPath = malloc( strlen(path) + strlen(childNames.names[j]) + 2 );
+                if ( childPath == NULL )
+                {
+                    FATAL_MSG("Failed to allocate memory.\n");
+                    goto cleanupFail;
+                }
+                sprintf( childPath, "%s/%s", path, childNames.names[j] );
+                if ( collectLinkNames( fileID, childPath, NULL, paths ) < 0 )
+                {
+                    free(childPath);
+                    goto cleanupFail;
+                }
+                free(childPath);
+            }
+            freeLinkNames(&childNames);
         }
-        break;
+        free(path); path = NULL;
+    }
 
-    case DFNT_NFLOAT64:
-        /*    printf("warning, Native HDF datatype is encountered");
-            printf(" the converting result may not be correct.\n");*/
-        
-        //if(h5type) *h5type = H5T_NATIVE_DOUBLE;
-        h4memsize = sizeof(float64);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
-            *h5memtype = H5T_NATIVE_FLOAT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
-            *h5memtype = H5T_NATIVE_DOUBLE;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LDOUBLE))
-            *h5memtype = H5T_NATIVE_LDOUBLE;
-        else
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    freeLinkNames(&rootNames);
+    freeLinkNames(&childNames);
+    if ( path ) free(path);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+static int pathInList( const linkNameList_t* list, const char* path )
+{
+    for ( size_t i = 0; i < list->num; i++ )
+        if ( strcmp( list->names[i], path ) == 0 )
+            return 1;
+    return 0;
+}
+
+/*
+                        checkpointUnit
+    DESCRIPTION:
+        This function records in the output file that a unit of work has been completely written. The groups the
+        unit wrote are marked with the BF_UnitComplete attribute: for a per-granule unit every child of the
+        instrument group that is not marked yet, otherwise the instrument group itself. Then the list of objects
+        in the file and the index of the next unit are saved in the BF_Checkpoint group and the file is flushed,
+        so that resumeFromCheckpoint can roll the file back to this state.
+    ARGUMENTS:
+        hid_t fileID            -- The output file
+        const char* instrument  -- The name of the instrument root group the unit writes to
+        int perGranule          -- Non-zero if the unit is one granule group under the instrument group (MODIS, ASTER)
+        int nextUnit            -- The index of the unit to resume from
+        const char* granules    -- The input granules written by the unit (stored in the marker)
+    EFFECTS:
+        Writes attributes, creates or rewrites the BF_Checkpoint group and flushes the file.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t checkpointUnit( hid_t fileID, const char* instrument, int perGranule, int nextUnit, const char* granules )
+{
+    linkNameList_t paths = {NULL, 0, 0};
+    linkNameList_t children = {NULL, 0, 0};
+    hid_t groupID = 0;
+    hid_t strType = 0;
+    hid_t spaceID = 0;
+    hid_t dsetID = 0;
+    hsize_t numPaths = 0;
+    htri_t exists = 0;
+    short fail = 0;
+
+    if ( granules == NULL )
+        granules = "";
+
+    /* Mark the groups of the unit */
+    exists = H5Lexists( fileID, instrument, H5P_DEFAULT );
+    if ( exists < 0 )
+    {
+        FATAL_MSG("Failed to check the existence of the %s group.\n", instrument);
+        goto cleanupFail;
+    }
+    if ( exists && perGranule )
+    {
+        if ( H5Literate_by_name( fileID, instrument, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames,
+                                 &children, H5P_DEFAULT ) < 0 )
         {
-            FATAL_MSG("cannot convert native float64\n");
-            return FAIL;
+            FATAL_MSG("Failed to iterate over the %s group.\n", instrument);
+            goto cleanupFail;
         }
-        break;
-
-    case DFNT_LFLOAT32:
-        
-        //if(h5type) *h5type = H5T_IEEE_F32LE;
-        h4memsize = sizeof(float32);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
-            *h5memtype = H5T_NATIVE_FLOAT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
-            *h5memtype = H5T_NATIVE_DOUBLE;
-        else
+        for ( size_t i = 0; i < children.num; i++ )
         {
-            FATAL_MSG("cannot convert little-endian float32\n");
-            return FAIL;
+            char* childPath = malloc( strlen(instrument) + strlen(children.names[i]) + 2 );
+            if ( childPath == NULL )
+            {
+                FATAL_MSG("Failed to allocate memory.\n");
+                goto cleanupFail;
+            }
+            sprintf( childPath, "%s/%s", instrument, children.names[i] );
+            if ( H5Aexists_by_name( fileID, childPath, UNIT_MARKER, H5P_DEFAULT ) == 0 &&
+                 H5LTset_attribute_string( fileID, childPath, UNIT_MARKER, granules ) < 0 )
+            {
+                FATAL_MSG("Failed to mark %s as complete.\n", childPath);
+                free(childPath);
+                goto cleanupFail;
+            }
+            free(childPath);
         }
-        break;
+    }
+    else if ( exists && H5LTset_attribute_string( fileID, instrument, UNIT_MARKER, granules ) < 0 )
+    {
+        FATAL_MSG("Failed to mark the %s group as complete.\n", instrument);
+        goto cleanupFail;
+    }
 
-    case DFNT_LFLOAT64:
-        
-        //if(h5type) *h5type = H5T_IEEE_F64LE;
-        h4memsize = sizeof(float64);
-        if(h4memsize == H5Tget_size(H5T_NATIVE_FLOAT))
-            *h5memtype = H5T_NATIVE_FLOAT;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_DOUBLE))
-            *h5memtype = H5T_NATIVE_DOUBLE;
-        else if(h4memsize == H5Tget_size(H5T_NATIVE_LDOUBLE))
-            *h5memtype = H5T_NATIVE_LDOUBLE;
-        else
+    /* Save the objects present at this point */
+    if ( collectTopPaths( fileID, &paths ) == FATAL_ERR )
+        goto cleanupFail;
+
+    exists = H5Lexists( fileID, CHECKPOINT_GROUP, H5P_DEFAULT );
+    if ( exists == 0 )
+    {
+        groupID = H5Gcreate2( fileID, CHECKPOINT_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+        if ( groupID < 0 )
         {
-            FATAL_MSG("cannot convert little-endian float64\n");
-            return FAIL;
+            FATAL_MSG("Failed to create the checkpoint group.\n");
+            groupID = 0;
+            goto cleanupFail;
         }
-        break;
+        H5Gclose(groupID); groupID = 0;
+    }
+    else if ( exists < 0 || ( H5Lexists( fileID, CHECKPOINT_OBJECTS, H5P_DEFAULT ) > 0 &&
+                              H5Ldelete( fileID, CHECKPOINT_OBJECTS, H5P_DEFAULT ) < 0 ) )
+    {
+        FATAL_MSG("Failed to reset the checkpoint group.\n");
+        goto cleanupFail;
+    }
 
-    default:
+    strType = H5Tcopy( H5T_C_S1 );
+    if ( strType < 0 || H5Tset_size( strType, H5T_VARIABLE ) < 0 )
     {
-        FATAL_MSG("cannot find the corresponding datatype in HDF5.\nReceived type was: %d\n", h4type);
-        return FAIL;
+        FATAL_MSG("Failed to create a string datatype.\n");
+        if ( strType < 0 ) strType = 0;
+        goto cleanupFail;
     }
+    numPaths = paths.num;
+    spaceID = numPaths ? H5Screate_simple( 1, &numPaths, NULL ) : H5Screate( H5S_NULL );
+    if ( spaceID < 0 )
+    {
+        FATAL_MSG("Failed to create a dataspace.\n");
+        spaceID = 0;
+        goto cleanupFail;
+    }
+    dsetID = H5Dcreate2( fileID, CHECKPOINT_OBJECTS, strType, spaceID, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( dsetID < 0 )
+    {
+        FATAL_MSG("Failed to create the checkpoint object list.\n");
+        dsetID = 0;
+        goto cleanupFail;
+    }
+    if ( numPaths && H5Dwrite( dsetID, strType, H5S_ALL, H5S_ALL, H5P_DEFAULT, paths.names ) < 0 )
+    {
+        FATAL_MSG("Failed to write the checkpoint object list.\n");
+        goto cleanupFail;
     }
-    return SUCCEED;
-}
 
-/****************change_dim_attr_NAME_value*******************************
-*
-* Source: h4h5tools
-    https://bitbucket.hdfgroup.org/projects/HDFEOS/repos/h4h5tools/browse/lib/src/h4toh5sds.c
-*
-* Function:     change_dim_attr_NAME_value
-* Purpose:      change dimension NAME attribute value to follow the netCDF-4 data model
-*
-* Return:       FAIL if failed, SUCCEED if successful.
-*
-* In :
-*
-                h5dset_id:         HDF5 dataset ID this attribute is attached.
-*-------------------------------------------------------------------------
-*/
+    if ( H5LTset_attribute_int( fileID, CHECKPOINT_GROUP, CHECKPOINT_NEXT_UNIT, &nextUnit, 1 ) < 0 )
+    {
+        FATAL_MSG("Failed to write the checkpoint unit index.\n");
+        goto cleanupFail;
+    }
+
+    if ( H5Fflush( fileID, H5F_SCOPE_GLOBAL ) < 0 )
+    {
+        FATAL_MSG("Failed to flush the output file.\n");
+        goto cleanupFail;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
 
+    freeLinkNames(&paths);
+    freeLinkNames(&children);
+    if ( groupID ) H5Gclose(groupID);
+    if ( strType ) H5Tclose(strType);
+    if ( spaceID ) H5Sclose(spaceID);
+    if ( dsetID ) H5Dclose(dsetID);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
 
-int change_dim_attr_NAME_value(hid_t h5dset_id)
+/* Addresses of the datasets removed by the roll back. Object references are object header addresses. */
+typedef struct
 {
+    haddr_t* addrs;
+    size_t num;
+    size_t size;
+} addrList_t;
 
-    hid_t tid = -1;
-    hid_t sid = -1;
-    hid_t aid = -1;
+static herr_t collectDsetAddrs( hid_t objID, const char* name, const H5O_info_t* info, void* opdata )
+{
+    addrList_t* list = (addrList_t*) opdata;
 
-    /* Assign the attribute value for NAME to follow netCDF-4 data model. */
-    char attr_value[] = "This is a netCDF dimension but not a netCDF variable.";
+    if ( info->type != H5O_TYPE_DATASET )
+        return 0;
+
+    if ( list->num == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 64;
+        haddr_t* tempPtr = realloc( list->addrs, newSize * sizeof(haddr_t) );
+        if ( tempPtr == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return -1;
+        }
+        list->addrs = tempPtr;
+        list->size = newSize;
+    }
+    list->addrs[list->num++] = info->addr;
+
+    return 0;
+}
+
+/* Remove the entries of a dimension scale's REFERENCE_LIST that point to removed datasets. emptied, if not NULL,
+ * is set when the scale was only attached to removed datasets.
+ */
+static herr_t pruneReferenceList( hid_t fileID, const char* scalePath, const addrList_t* removed, int* emptied )
+{
+    hid_t dsetID = 0;
+    hid_t attrID = 0;
+    hid_t fileType = 0;
+    hid_t memType = 0;
+    hid_t spaceID = 0;
+    unsigned char* buffer = NULL;
+    size_t elemSize = 0;
+    size_t refOffset = 0;
+    hssize_t numElems = 0;
+    hsize_t numKept = 0;
+    short fail = 0;
 
+    if ( emptied ) *emptied = 0;
 
-    /* Delete the original attribute. */
-    if(H5Adelete(h5dset_id,"NAME") <0)
+    dsetID = H5Dopen2( fileID, scalePath, H5P_DEFAULT );
+    if ( dsetID < 0 )
     {
-        FATAL_MSG("cannot delete HDF5 attribute NAME\n");
-        return FAIL;
+        FATAL_MSG("Failed to open %s.\n", scalePath);
+        dsetID = 0;
+        goto cleanupFail;
     }
+    if ( H5Aexists( dsetID, "REFERENCE_LIST" ) <= 0 )
+        goto cleanup;
 
-    if((tid = H5Tcopy(H5T_C_S1)) <0)
+    attrID = H5Aopen( dsetID, "REFERENCE_LIST", H5P_DEFAULT );
+    fileType = H5Aget_type( attrID );
+    spaceID = H5Aget_space( attrID );
+    if ( attrID < 0 || fileType < 0 || spaceID < 0 )
     {
-        FATAL_MSG("cannot delete HDF5 attribute NAME\n");
-        return FAIL;
+        FATAL_MSG("Failed to open the REFERENCE_LIST attribute of %s.\n", scalePath);
+        if ( attrID < 0 ) attrID = 0;
+        if ( fileType < 0 ) fileType = 0;
+        if ( spaceID < 0 ) spaceID = 0;
+        goto cleanupFail;
+    }
+    memType = H5Tget_native_type( fileType, H5T_DIR_ASCEND );
+    if ( memType < 0 )
+    {
+        FATAL_MSG("Failed to get the memory type of REFERENCE_LIST.\n");
+        memType = 0;
+        goto cleanupFail;
+    }
+    elemSize = H5Tget_size( memType );
+    refOffset = H5Tget_member_offset( memType, 0 );
+    numElems = H5Sget_simple_extent_npoints( spaceID );
+    buffer = calloc( numElems, elemSize );
+    if ( buffer == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    if ( H5Aread( attrID, memType, buffer ) < 0 )
+    {
+        FATAL_MSG("Failed to read the REFERENCE_LIST attribute of %s.\n", scalePath);
+        goto cleanupFail;
     }
 
-    if (H5Tset_size(tid, strlen(attr_value) + 1) <0)
+    for ( hssize_t i = 0; i < numElems; i++ )
     {
-        FATAL_MSG("cannot delete HDF5 attribute NAME\n");
-        H5Tclose(tid);
-        return FAIL;
+        hobj_ref_t ref;
+        int isRemoved = 0;
+
+        memcpy( &ref, buffer + i * elemSize + refOffset, sizeof(hobj_ref_t) );
+        for ( size_t j = 0; j < removed->num && !isRemoved; j++ )
+            isRemoved = ( (haddr_t) ref == removed->addrs[j] );
+        if ( !isRemoved )
+        {
+            memmove( buffer + numKept * elemSize, buffer + i * elemSize, elemSize );
+            numKept++;
+        }
     }
 
-    if (H5Tset_strpad(tid, H5T_STR_NULLTERM) <0)
+    if ( numKept == (hsize_t) numElems )
+        goto cleanup;
+
+    H5Aclose(attrID); attrID = 0;
+    H5Sclose(spaceID); spaceID = 0;
+    if ( H5Adelete( dsetID, "REFERENCE_LIST" ) < 0 )
     {
-        FATAL_MSG("cannot delete HDF5 attribute NAME\n");
-        H5Tclose(tid);
-        return FAIL;
+        FATAL_MSG("Failed to delete the REFERENCE_LIST attribute of %s.\n", scalePath);
+        goto cleanupFail;
     }
-    if((sid = H5Screate(H5S_SCALAR))<0)
+    if ( numKept == 0 )
     {
-        FATAL_MSG("cannot delete HDF5 attribute NAME\n");
-        H5Tclose(tid);
-        return FAIL;
+        if ( emptied ) *emptied = 1;
+        goto cleanup;
     }
 
-    /* Create and write a new attribute. */
-    if ((aid = H5Acreate(h5dset_id, "NAME", tid, sid, H5P_DEFAULT, H5P_DEFAULT)) < 0)
+    spaceID = H5Screate_simple( 1, &numKept, NULL );
+    attrID = H5Acreate2( dsetID, "REFERENCE_LIST", fileType, spaceID, H5P_DEFAULT, H5P_DEFAULT );
+    if ( spaceID < 0 || attrID < 0 || H5Awrite( attrID, memType, buffer ) < 0 )
     {
-        FATAL_MSG("cannot delete HDF5 attribute NAME");
-        H5Tclose(tid);
-        H5Sclose(sid);
-        return FAIL;
+        FATAL_MSG("Failed to rewrite the REFERENCE_LIST attribute of %s.\n", scalePath);
+        if ( spaceID < 0 ) spaceID = 0;
+        if ( attrID < 0 ) attrID = 0;
+        goto cleanupFail;
     }
 
-    if (H5Awrite(aid, tid, (void*)attr_value) <0)
+    if ( 0 )
     {
-        FATAL_MSG("cannot delete HDF5 attribute NAME");
-        H5Tclose(tid);
-        H5Sclose(sid);
-        H5Aclose(aid);
-        return FAIL;
+cleanupFail:
+        fail = 1;
     }
 
+cleanup:
+    if ( buffer ) free(buffer);
+    if ( attrID ) H5Aclose(attrID);
+    if ( fileType ) H5Tclose(fileType);
+    if ( memType ) H5Tclose(memType);
+    if ( spaceID ) H5Sclose(spaceID);
+    if ( dsetID ) H5Dclose(dsetID);
 
-    if (aid != -1)
-        H5Aclose(aid);
-    if (sid != -1)
-        H5Sclose(sid);
-    if (tid != -1)
-        H5Tclose(tid);
-
-    return SUCCEED;
+    if ( fail ) return FATAL_ERR;
 
+    return RET_SUCCESS;
 }
 
-
-
 /*
-            copyDimension
-
+                        resumeFromCheckpoint
     DESCRIPTION:
-        This function copies the dimension scales from the HDF4 object to the HDF5 object.
-        If the dimension scale does not yet exist in the HDF5 file, it is created. If it does exist, the
-        HDF5 object will have its dimensions attached to the appropriate scale.
-
+        This function validates the checkpoint saved by checkpointUnit and rolls the output file back to it.
+        The checkpoint is valid if every object it lists still exists and every root group it lists is either
+        marked complete or has only complete children. Objects at the root or one level below it that are not
+        in the checkpoint belong to the unit that was interrupted and are deleted, and the REFERENCE_LIST of the
+        remaining dimension scales is cleaned of the deleted datasets.
     ARGUMENTS:
-        IN
-            char* dimSuffix      -- Name of the output dimension scale. Datasets passed to this function should be
-                                     given a unique dimension scale name in the case that their HDF4 dimensions have the
-                                     same name (across multiple HDF4 files) but are not identical dimensions (different
-                                     dimension size, different values inside the dimension). This string will be appended
-                                     to the name of the input HDF4 dataset in the output HDF5 dataset. For instance, if
-                                     the input HDF4 dimension is named:
-                                        "inHDF4dimName"
-                                     and dimSuffix is:
-                                        "_g1"
-                                     The name of the dimension in the HDF5 file will be:
-                                        "inHDF4dimName_g1"
-
-                                     Pass NULL in for this argument if a unique dimension is not required. If NULL is passed,
-                                     this function will attempt to share the generated HDF5 dimension for all objects that
-                                     reference it in the input HDF4 files.
-
-                                     This string must be null terminated, or else a seg fault may occur.
-
-            int32 h4fileID        -- The HDF4 file ID returned by SDstart
-            char* h4datasetName   -- The name of the HDF4 dataset from which to copy from
-            hid_t h5dimGroupID    -- The HDF5 group ID in which to store and/or find the dimension scales
-            hid_t h5dsetID        -- The HDF5 dataset ID in which to attach dimension scales
-
+        hid_t fileID    -- The output file, opened read/write
+        int* nextUnit   -- Set to the index of the first unit that has to be processed again
     EFFECTS:
-        Creates dimension scale if it doesn't exist under the h5dimGroupID group. Attaches the dimension scale
-        to the h5dsetID dataset.
-
+        Deletes objects from the output file.
     RETURN:
-        FAIL upon failure.
-        SUCCEED upon success.
-
+        RET_SUCCESS_NO_PROCESS if the file has no valid checkpoint (the file has not been modified in that case)
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
 
-herr_t copyDimension( char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID )
+herr_t resumeFromCheckpoint( hid_t fileID, int* nextUnit )
 {
-    hsize_t tempInt = 0;
-    char* correct_dsetname = NULL;
-    char* dimName = NULL;
-    herr_t errStatus = 0;
-    int32 ntype = 0;
-    int32 h4dsetID = 0;
-    intn statusn = 0;
-    int rank = 0;
-    int status = 0;
-    hid_t h5dimID = 0;
-    void *dimBuffer = NULL;
-    short fail = 0;
-    hid_t memspace = 0;
-    htri_t dsetExists = 0;
-    short wasHardCodeCopy = 0;
-    char* catString = NULL;
-    char* temp = NULL;
-    char tempStack[STR_LEN] = {'\0'};
+    linkNameList_t saved = {NULL, 0, 0};
+    linkNameList_t current = {NULL, 0, 0};
+    addrList_t removed = {NULL, 0, 0};
+    hid_t dsetID = 0;
+    hid_t strType = 0;
+    hid_t spaceID = 0;
+    herr_t ret = RET_SUCCESS;
 
-    /* Get dataset index */
-    int32 sds_index = SDnametoindex(h4fileID, h4datasetName );
-    if ( sds_index == FAIL )
-    {
-        FATAL_MSG("Failed to get SD index.\n");
-        goto cleanupFail;
-    }
-    /* select the dataset */
-    h4dsetID = SDselect(h4fileID, sds_index);
-    if ( h4dsetID == FAIL )
+    *nextUnit = 0;
+
+    if ( H5Lexists( fileID, CHECKPOINT_GROUP, H5P_DEFAULT ) <= 0 ||
+         H5Aexists_by_name( fileID, CHECKPOINT_GROUP, CHECKPOINT_NEXT_UNIT, H5P_DEFAULT ) <= 0 ||
+         H5Lexists( fileID, CHECKPOINT_OBJECTS, H5P_DEFAULT ) <= 0 )
+        return RET_SUCCESS_NO_PROCESS;
+
+    if ( H5LTget_attribute_int( fileID, CHECKPOINT_GROUP, CHECKPOINT_NEXT_UNIT, nextUnit ) < 0 )
     {
-        h4dsetID = 0;
-        FATAL_MSG("Failed to select the HDF4 dataset.\n");
-        goto cleanupFail;
+        FATAL_MSG("Failed to read the checkpoint unit index.\n");
+        ret = FATAL_ERR;
+        goto cleanup;
     }
 
-    /* get the rank of the dataset so we know how many dimensions to copy */
-    statusn = SDgetinfo(h4dsetID, NULL, &rank, NULL, NULL, NULL );
-    if ( statusn == FAIL )
+    /* Read the saved object list */
+    dsetID = H5Dopen2( fileID, CHECKPOINT_OBJECTS, H5P_DEFAULT );
+    strType = H5Tcopy( H5T_C_S1 );
+    if ( dsetID < 0 || strType < 0 || H5Tset_size( strType, H5T_VARIABLE ) < 0 )
     {
-        FATAL_MSG("Failed to get SD info.\n");
-        goto cleanupFail;
+        FATAL_MSG("Failed to open the checkpoint object list.\n");
+        if ( dsetID < 0 ) dsetID = 0;
+        if ( strType < 0 ) strType = 0;
+        ret = FATAL_ERR;
+        goto cleanup;
     }
-
-
-    int32 dim_index;
-
-    // COPY OVER DIMENSION SCALES TO HDF5 OBJECT
-    dimName = calloc(500, 1);
-    int32 size = 0;
-    int32 num_attrs = 0;
-    hid_t h5type = 0;
-    int32 h4dimID = 0;
-
-    for ( dim_index = 0; dim_index < rank; dim_index++ )
+    spaceID = H5Dget_space( dsetID );
+    saved.num = saved.size = H5Sget_simple_extent_npoints( spaceID );
+    if ( saved.num )
     {
-        // Get the dimension ID
-        h4dimID = SDgetdimid ( h4dsetID, dim_index );
-        if ( h4dimID == FAIL )
+        saved.names = calloc( saved.num, sizeof(char*) );
+        if ( saved.names == NULL || H5Dread( dsetID, strType, H5S_ALL, H5S_ALL, H5P_DEFAULT, saved.names ) < 0 )
         {
-            FATAL_MSG("Failed to get dimension ID.\n");
-            h4dimID = 0;
-            goto cleanupFail;
+            FATAL_MSG("Failed to read the checkpoint object list.\n");
+            saved.num = 0;
+            ret = FATAL_ERR;
+            goto cleanup;
         }
+    }
 
+    /* Validate the completed units */
+    for ( size_t i = 0; i < saved.num; i++ )
+    {
+        H5O_info_t info;
+        const char* slash = strchr( saved.names[i] + 1, '/' );
 
-        /* get various useful info about this dimension */
-        statusn = SDdiminfo( h4dimID, dimName, &size, &ntype, &num_attrs );
-        //int32 dimRank = 0;
-        //int32 dimSizes = 0;
-        //statusn = SDgetinfo( h4dimID, dimName, &dimRank, &dimSizes, &ntype, &num_attrs);
-        if ( statusn == FAIL )
+        if ( H5Lexists( fileID, saved.names[i], H5P_DEFAULT ) <= 0 ||
+             H5Oget_info_by_name( fileID, saved.names[i], &info, H5P_DEFAULT ) < 0 )
         {
-            FATAL_MSG("Failed to get dimension info.\n");
-            goto cleanupFail;
+            WARN_MSG("The checkpointed object %s is missing.\n", saved.names[i]);
+            ret = RET_SUCCESS_NO_PROCESS;
+            goto cleanup;
         }
 
+        /* Children of root groups need a marker unless their parent has one */
+        if ( slash != NULL && info.type == H5O_TYPE_GROUP )
+        {
+            char parent[STR_LEN] = {'\0'};
+            strncpy( parent, saved.names[i], slash - saved.names[i] < STR_LEN ? slash - saved.names[i] : STR_LEN - 1 );
+            if ( H5Aexists_by_name( fileID, parent, UNIT_MARKER, H5P_DEFAULT ) <= 0 &&
+                 H5Aexists_by_name( fileID, saved.names[i], UNIT_MARKER, H5P_DEFAULT ) <= 0 )
+            {
+                WARN_MSG("The checkpointed group %s is not marked complete.\n", saved.names[i]);
+                ret = RET_SUCCESS_NO_PROCESS;
+                goto cleanup;
+            }
+        }
+    }
 
-        /* If dimSuffix is provided, we need to append this string to the dimName variable.*/
-       
-        correct_dsetname = correct_name(dimName);
+    /* Roll back everything the interrupted unit wrote */
+    if ( collectTopPaths( fileID, &current ) == FATAL_ERR )
+    {
+        ret = FATAL_ERR;
+        goto cleanup;
+    }
+    for ( size_t i = 0; i < current.num; i++ )
+    {
+        const char* slash = strchr( current.names[i] + 1, '/' );
+        char parent[STR_LEN] = {'\0'};
 
-        if ( dimSuffix ) 
+        if ( pathInList( &saved, current.names[i] ) )
+            continue;
+        /* The children of a deleted group are gone already */
+        if ( slash != NULL )
         {
-            // store allocated memory in temp pointer
-            strcpy(tempStack, dimName);
-            temp = calloc ( sizeof(tempStack) + sizeof(dimSuffix) + 1, 1 );
-            // copy dimName to the temp pointer memory
-            strcpy(temp, tempStack);
-            // concatenate dimName with dimSuffix
-            strcat(temp,dimSuffix);
-            // Fix the name to comply with netCDF standards
-            catString = correct_name(temp);
-            // free the temp memory (catString is separately allocated memory, malloc'ed in the correct_name function
-            free(temp); temp = NULL;
+            strncpy( parent, current.names[i], slash - current.names[i] < STR_LEN ? slash - current.names[i] : STR_LEN - 1 );
+            if ( !pathInList( &saved, parent ) )
+                continue;
         }
-        else
+
+        if ( H5Ovisit_by_name( fileID, current.names[i], H5_INDEX_NAME, H5_ITER_INC, collectDsetAddrs, &removed,
+                               H5P_DEFAULT ) < 0 ||
+             H5Ldelete( fileID, current.names[i], H5P_DEFAULT ) < 0 )
         {
-            catString = correct_name(dimName);
+            FATAL_MSG("Failed to remove the incomplete object %s.\n", current.names[i]);
+            ret = FATAL_ERR;
+            goto cleanup;
         }
-        /* Since dimension scales are shared, it is possible this dimension already exists in HDF5 file (previous
-           call to this function created it). Check to see if it does. If so, use the dimension that eixsts.
-        */
-        
-        free(correct_dsetname); correct_dsetname = NULL;
+        printf("Removed incomplete object %s.\n", current.names[i]);
+    }
 
-        dsetExists = H5Lexists(h5dimGroupID, catString, H5P_DEFAULT);
-        // if dsetExists is <= 0, then dimension does not yet exist.
-        if ( dsetExists <= 0 )
+    if ( removed.num )
+    {
+        for ( size_t i = 0; i < saved.num; i++ )
         {
-            /* If the dimension is one of the following, we will do an explicit dimension scale copy (hard code
-             * the scale values)
-             */
-            if ( strstr( catString, "Band_250M" ) != NULL )
-            {
-                tempInt = 2;
-                float floatBuffer[2] = {1.0f, 2.0f};
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                /* The dimensions in this if else chain are pure dimensions in HDF4, but we want to convert them to a real
-                 * dimension in the HDF5 file. Set this flag to 1 to indicate that the final result IS a real dimension.
-                 * Flag will be used to prevent setting the NAME attribute downstream
-                 */
-                wasHardCodeCopy = 1;
-            }
-            else if ( strstr( catString, "Band_500M" ) != NULL )
-            {
-                tempInt = 5;
-                float floatBuffer[5] = {3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                wasHardCodeCopy = 1;
-            }
-            else if ( strstr( catString, "Band_1KM_RefSB" ) != NULL )
+            H5O_info_t info;
+
+            if ( H5Oget_info_by_name( fileID, saved.names[i], &info, H5P_DEFAULT ) < 0 )
             {
-                float floatBuffer[15] = { 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 13.5f, 14.0f, 14.5f, 15.0f, 16.0f, 17.0f, 18.0f, 19.0f, 26.0f };
-                tempInt = 15;
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                wasHardCodeCopy = 1;
+                FATAL_MSG("Failed to get the object info of %s.\n", saved.names[i]);
+                ret = FATAL_ERR;
+                goto cleanup;
             }
-            else if ( strstr( catString, "Band_1KM_Emissive" ) != NULL )
+            if ( info.type == H5O_TYPE_DATASET && pruneReferenceList( fileID, saved.names[i], &removed, NULL ) == FATAL_ERR )
             {
-                float floatBuffer[16] = { 20.0f, 21.0f, 22.0f, 23.0f, 24.0f, 25.0f, 27.0f, 28.0f, 29.0f, 30.0f, 31.0f, 32.0f, 33.0f, 34.0f, 35.0f, 36.0f };
-                tempInt = 16;
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                wasHardCodeCopy = 1;
+                ret = FATAL_ERR;
+                goto cleanup;
             }
+        }
+    }
 
-            /* Else, the dimension is none of those listed. Do a normal copy by reading scale values from
-               the input file (a non-hard coded copy)
-             */
-            else
-            {
-                wasHardCodeCopy = 0;
-                /* SDdiminfo will return 0 for ntype if the dimension has no scale information. This is the case when
-                   it is a pure dimension.  We need two separate cases for when it is and is not a pure dim
-                */
-
-                if ( ntype != 0 )
-                {
-                    /* get the correct HDF5 datatype from ntype */
-                    status = h4type_to_h5type( ntype, &h5type );
-                    if ( status != 0 )
-                    {
-                        FATAL_MSG("Failed to convert HDF4 to HDF5 datatype.\n");
-                        goto cleanupFail;
-                    }
-
-                    /* read the dimension scale into a buffer */
-                    dimBuffer = malloc(size);
-                    //int32 start[1] = {0};
-                    //int32 stride[1] = {1};
-                    //statusn = SDreaddata( h4dimID, start, stride, &dimSizes, dimBuffer );
-                    statusn = SDgetdimscale(h4dimID, dimBuffer);
-                    if ( statusn != 0 )
-                    {
-                        FATAL_MSG("Failed to get dimension scale.\n");
-                        goto cleanupFail;
-                    }
+cleanup:
+    if ( saved.num )
+        H5Dvlen_reclaim( strType, spaceID, H5P_DEFAULT, saved.names );
+    free(saved.names);
+    freeLinkNames(&current);
+    free(removed.addrs);
+    if ( dsetID ) H5Dclose(dsetID);
+    if ( strType ) H5Tclose(strType);
+    if ( spaceID ) H5Sclose(spaceID);
 
-                    /* make a new dataset for our dimension scale */
+    return ret;
+}
 
-                    tempInt = size;
-                    h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, h5type, catString, dimBuffer);
-                    if ( h5dimID == FATAL_ERR )
-                    {
-                        h5dimID = 0;
-                        FATAL_MSG("Failed to insert dataset.\n");
-                        goto cleanupFail;
-                    }
+/*
+                        getAttrString
+    DESCRIPTION:
+        This function reads a string attribute of an object.
+    ARGUMENTS:
+        hid_t fileID            -- The file (or any object the path is relative to)
+        const char* objPath     -- The path of the object
+        const char* attrName    -- The name of the attribute
+    EFFECTS:
+        Allocates memory for the returned string. Caller must free it.
+    RETURN:
+        NULL if the object or the attribute does not exist, or on failure
+        Pointer to the attribute value otherwise
+*/
 
-                    free(dimBuffer);
-                    dimBuffer = NULL;
-                }
+char* getAttrString( hid_t fileID, const char* objPath, const char* attrName )
+{
+    hsize_t dims = 0;
+    H5T_class_t typeClass;
+    size_t typeSize = 0;
+    char* value = NULL;
 
-                else
-                {
-                    hsize_t tempSize2 = 0;
+    if ( H5Lexists( fileID, objPath, H5P_DEFAULT ) <= 0 ||
+         H5Aexists_by_name( fileID, objPath, attrName, H5P_DEFAULT ) <= 0 )
+        return NULL;
 
-                    tempSize2 = (hsize_t) size;
-                    memspace = H5Screate_simple( 1, &tempSize2, NULL );
+    if ( H5LTget_attribute_info( fileID, objPath, attrName, &dims, &typeClass, &typeSize ) < 0 )
+    {
+        FATAL_MSG("Failed to get the attribute info of %s.\n", attrName);
+        return NULL;
+    }
+    value = calloc( typeSize + 1, 1 );
+    if ( value == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return NULL;
+    }
+    if ( H5LTget_attribute_string( fileID, objPath, attrName, value ) < 0 )
+    {
+        FATAL_MSG("Failed to read the attribute %s.\n", attrName);
+        free(value);
+        return NULL;
+    }
 
-                    h5dimID = H5Dcreate( h5dimGroupID, catString, H5T_NATIVE_INT, memspace,
-                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
-                    if ( h5dimID < 0 )
-                    {
-                        FATAL_MSG("Failed to create dataset.\n");
-                        h5dimID = 0;
-                        goto cleanupFail;
-                    }
+    return value;
+}
 
-                    H5Sclose(memspace);
-                    memspace = 0;
+/*
+                        getUnitMarker
+    DESCRIPTION:
+        This function returns the list of input granules stored in the BF_UnitComplete attribute of a group.
+    ARGUMENTS:
+        hid_t fileID        -- The output file
+        const char* objPath -- The path of the group
+    EFFECTS:
+        Allocates memory for the returned string. Caller must free it.
+    RETURN:
+        NULL if the group does not exist, is not marked complete or on failure
+        Pointer to the granule list otherwise
+*/
 
-                } // end else
-            } // end else
+char* getUnitMarker( hid_t fileID, const char* objPath )
+{
+    return getAttrString( fileID, objPath, UNIT_MARKER );
+}
 
-            errStatus = H5DSset_scale(h5dimID, catString);
-            if ( errStatus != 0 )
-            {
-                FATAL_MSG("Failed to set dataset as a dimension scale.\n");
-                goto cleanupFail;
-            }
+/*
+                        removeCheckpoint
+    DESCRIPTION:
+        This function removes the checkpoint group and the BF_UnitComplete markers once the output file is
+        complete, leaving the regular BF layout.
+    ARGUMENTS:
+        hid_t fileID    -- The output file
+    EFFECTS:
+        Deletes the BF_Checkpoint group and attributes.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
 
+herr_t removeCheckpoint( hid_t fileID )
+{
+    linkNameList_t paths = {NULL, 0, 0};
+    short fail = 0;
 
-            /* Correct the NAME attribute of the pure dimension to conform with netCDF
-               standards.
-            */
-            if ( ntype == 0 && !wasHardCodeCopy )
-            {
-                statusn = change_dim_attr_NAME_value(h5dimID);
-                if ( statusn == FAIL )
-                {
-                    FATAL_MSG("Failed to change the NAME attribute of a dimension.\n");
-                    goto cleanupFail;
-                }
-            }
-        } // end if ( dsetExists <= 0 )
+    if ( collectTopPaths( fileID, &paths ) == FATAL_ERR )
+        goto cleanupFail;
 
-        else
+    for ( size_t i = 0; i < paths.num; i++ )
+    {
+        if ( H5Aexists_by_name( fileID, paths.names[i], UNIT_MARKER, H5P_DEFAULT ) > 0 &&
+             H5Adelete_by_name( fileID, paths.names[i], UNIT_MARKER, H5P_DEFAULT ) < 0 )
         {
-            h5dimID = H5Dopen2(h5dimGroupID, catString, H5P_DEFAULT);
-            if ( h5dimID < 0 )
-            {
-                h5dimID = 0;
-                FATAL_MSG("Failed to open dataset.\n");
-                goto cleanupFail;
-            }
+            FATAL_MSG("Failed to remove the completion marker of %s.\n", paths.names[i]);
+            goto cleanupFail;
         }
+    }
 
+    if ( H5Lexists( fileID, CHECKPOINT_GROUP, H5P_DEFAULT ) > 0 &&
+         H5Ldelete( fileID, CHECKPOINT_GROUP, H5P_DEFAULT ) < 0 )
+    {
+        FATAL_MSG("Failed to remove the checkpoint group.\n");
+        goto cleanupFail;
+    }
 
-        errStatus = H5DSattach_scale(h5dsetID, h5dimID, dim_index);
-        if ( errStatus != 0 )
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    freeLinkNames(&paths);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/*
+                        removeInstrument
+    DESCRIPTION:
+        This function removes the group tree of one instrument from an existing BF file so that the instrument
+        can be written again. The dimension scales at the root of the file are detached from the removed
+        datasets, and the scales that were only used by the instrument are removed as well, as is the spatial
+        index of the instrument (see indexGeolocation). All other objects are left untouched. The space of the removed objects is only reclaimed by repacking the file (see
+        repackOutputFile).
+    ARGUMENTS:
+        hid_t fileID            -- The BF file, opened read/write
+        const char* instrument  -- The name of the instrument root group
+    EFFECTS:
+        Deletes objects from the file.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t removeInstrument( hid_t fileID, const char* instrument )
+{
+    addrList_t removed = {NULL, 0, 0};
+    linkNameList_t rootNames = {NULL, 0, 0};
+    char* indexPath = NULL;
+    htri_t exists = 0;
+    short fail = 0;
+
+    exists = H5Lexists( fileID, instrument, H5P_DEFAULT );
+    if ( exists < 0 )
+    {
+        FATAL_MSG("Failed to check the existence of the %s group.\n", instrument);
+        goto cleanupFail;
+    }
+    if ( exists == 0 )
+    {
+        WARN_MSG("The file has no %s group to replace.\n", instrument);
+        goto cleanup;
+    }
+
+    if ( H5Ovisit_by_name( fileID, instrument, H5_INDEX_NAME, H5_ITER_INC, collectDsetAddrs, &removed,
+                           H5P_DEFAULT ) < 0 )
+    {
+        FATAL_MSG("Failed to visit the %s group.\n", instrument);
+        goto cleanupFail;
+    }
+    if ( H5Ldelete( fileID, instrument, H5P_DEFAULT ) < 0 )
+    {
+        FATAL_MSG("Failed to remove the %s group.\n", instrument);
+        goto cleanupFail;
+    }
+
+    /* The spatial index of the instrument goes with it */
+    indexPath = malloc( strlen(SPATIAL_INDEX_GROUP) + strlen(instrument) + 3 );
+    if ( indexPath == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    sprintf( indexPath, "/%s/%s", SPATIAL_INDEX_GROUP, instrument );
+    exists = H5Lexists( fileID, "/" SPATIAL_INDEX_GROUP, H5P_DEFAULT );
+    if ( exists > 0 )
+        exists = H5Lexists( fileID, indexPath, H5P_DEFAULT );
+    if ( exists < 0 || ( exists > 0 && H5Ldelete( fileID, indexPath, H5P_DEFAULT ) < 0 ) )
+    {
+        FATAL_MSG("Failed to remove the spatial index %s.\n", indexPath);
+        goto cleanupFail;
+    }
+
+    if ( removed.num == 0 )
+        goto cleanup;
+
+    if ( H5Literate( fileID, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames, &rootNames ) < 0 )
+    {
+        FATAL_MSG("Failed to iterate over the root group.\n");
+        goto cleanupFail;
+    }
+    for ( size_t i = 0; i < rootNames.num; i++ )
+    {
+        H5O_info_t info;
+        int emptied = 0;
+
+        if ( H5Oget_info_by_name( fileID, rootNames.names[i], &info, H5P_DEFAULT ) < 0 )
         {
-            FATAL_MSG("Failed to attach dimension scale.\n");
+            FATAL_MSG("Failed to get the object info of %s.\n", rootNames.names[i]);
+            goto cleanupFail;
+        }
+        if ( info.type != H5O_TYPE_DATASET )
+            continue;
+        if ( pruneReferenceList( fileID, rootNames.names[i], &removed, &emptied ) == FATAL_ERR )
+            goto cleanupFail;
+        if ( emptied && H5Ldelete( fileID, rootNames.names[i], H5P_DEFAULT ) < 0 )
+        {
+            FATAL_MSG("Failed to remove the dimension %s.\n", rootNames.names[i]);
             goto cleanupFail;
         }
+    }
 
-        free(correct_dsetname);
-        correct_dsetname = NULL;
-        H5Dclose(h5dimID);
-        h5dimID = 0;
-        free(catString); catString = NULL;
-    }   // end for loop
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+cleanup:
+    free(removed.addrs);
+    free(indexPath);
+    freeLinkNames(&rootNames);
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+/*
+                        repackOutputFile
+    DESCRIPTION:
+        This function reclaims the free space left in a file by removed objects. HDF5 does not shrink a file,
+        so all objects and root attributes are copied into a new file (see consolidateSubFiles), which then
+        replaces the original.
+    ARGUMENTS:
+        BFcontext_t* ctx        -- The conversion context, for the dataset layout and dimension scales
+        const char* fileName    -- The file to repack. It must not be open.
+    EFFECTS:
+        Replaces the file.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t repackOutputFile( BFcontext_t* ctx, const char* fileName )
+{
+    char* tempName = NULL;
+    hid_t srcFileID = 0;
+    hid_t dstFileID = 0;
+    hid_t srcRootID = 0;
+    hid_t dstRootID = 0;
+    short fail = 0;
+
+    tempName = malloc( strlen(fileName) + strlen(".repack") + 1 );
+    if ( tempName == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    sprintf( tempName, "%s.repack", fileName );
+    remove( tempName );
+
+    if ( createOutputFile( &dstFileID, tempName ) )
+    {
+        FATAL_MSG("Unable to create the file %s.\n", tempName);
+        dstFileID = 0;
+        goto cleanupFail;
+    }
+    if ( consolidateSubFiles( ctx, dstFileID, (char**) &fileName, 1 ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to copy %s.\n", fileName);
+        goto cleanupFail;
+    }
+
+    srcFileID = H5Fopen( fileName, H5F_ACC_RDONLY, H5P_DEFAULT );
+    if ( srcFileID < 0 )
+    {
+        FATAL_MSG("Failed to open %s.\n", fileName);
+        srcFileID = 0;
+        goto cleanupFail;
+    }
+    srcRootID = H5Gopen2( srcFileID, "/", H5P_DEFAULT );
+    dstRootID = H5Gopen2( dstFileID, "/", H5P_DEFAULT );
+    if ( srcRootID < 0 || dstRootID < 0 || copyObjAttrs( srcRootID, dstRootID ) < 0 )
+    {
+        FATAL_MSG("Failed to copy the root attributes of %s.\n", fileName);
+        if ( srcRootID < 0 ) srcRootID = 0;
+        if ( dstRootID < 0 ) dstRootID = 0;
+        goto cleanupFail;
+    }
+
+    H5Gclose(srcRootID); srcRootID = 0;
+    H5Gclose(dstRootID); dstRootID = 0;
+    H5Fclose(srcFileID); srcFileID = 0;
+    H5Fclose(dstFileID); dstFileID = 0;
+
+    if ( rename( tempName, fileName ) != 0 )
+    {
+        FATAL_MSG("Failed to replace %s with the repacked file.\n", fileName);
+        goto cleanupFail;
+    }
 
-    fail = 0;
     if ( 0 )
     {
 cleanupFail:
         fail = 1;
     }
 
-    if ( dimName ) free ( dimName );
-    if ( h5dimID ) H5Dclose(h5dimID);
-    if ( dimBuffer ) free(dimBuffer);
-    if ( correct_dsetname ) free(correct_dsetname);
-    if ( memspace ) H5Sclose(memspace);
-    if ( catString ) free(catString);
-    if ( temp ) free(temp);
-
-    if ( fail ) return FAIL;
+    if ( srcRootID ) H5Gclose(srcRootID);
+    if ( dstRootID ) H5Gclose(dstRootID);
+    if ( srcFileID ) H5Fclose(srcFileID);
+    if ( dstFileID ) H5Fclose(dstFileID);
+    if ( fail && tempName ) remove( tempName );
+    if ( tempName ) free(tempName);
 
-    return SUCCEED;
+    if ( fail ) return FATAL_ERR;
 
+    return RET_SUCCESS;
 }
 
+/* Spatial and temporal subsetting. bfSubset is filled in by initSubset from the BF_BBOX and BF_TIME_WINDOW
+ * environment variables. Every instrument function consults it before reading its data, so that the data
+ * outside the box or the time window is skipped as early as possible.
+ */
+BFsubset_t bfSubset;
+
 /*
-            copyDimensionSubset
+                        initSubset
+    DESCRIPTION:
+        This function reads the subsetting options.
+            BF_BBOX="latMin,latMax,lonMin,lonMax" in degrees. Longitudes are in -180 to 180. lonMin larger than
+                lonMax selects a box crossing the antimeridian.
+            BF_TIME_WINDOW="YYYY-MM-DDThh:mm:ss/YYYY-MM-DDThh:mm:ss" in UTC.
+    ARGUMENTS:
+        None
+    EFFECTS:
+        Sets the global bfSubset.
+    RETURN:
+        FATAL_ERR if an option is malformed
+        RET_SUCCESS on success
+*/
 
-    TODO
-        This function documentation needs to be fixed. This was just copied over from the copyDimension
+herr_t initSubset( void )
+{
+    const char* s = NULL;
 
-    DESCRIPTION:
-        This function copies the dimension scales from the HDF4 object to the HDF5 object.
-        If the dimension scale does not yet exist in the HDF5 file, it is created. If it does exist, the
-        HDF5 object will have its dimensions attached to the appropriate scale.
+    memset( &bfSubset, 0, sizeof(bfSubset) );
 
-        
+    s = getenv("BF_BBOX");
+    if ( s && *s )
+    {
+        if ( sscanf( s, "%lf,%lf,%lf,%lf", &bfSubset.latMin, &bfSubset.latMax, &bfSubset.lonMin, &bfSubset.lonMax ) != 4 ||
+             bfSubset.latMin > bfSubset.latMax || bfSubset.latMin < -90.0 || bfSubset.latMax > 90.0 ||
+             bfSubset.lonMin < -180.0 || bfSubset.lonMin > 180.0 || bfSubset.lonMax < -180.0 || bfSubset.lonMax > 180.0 )
+        {
+            FATAL_MSG("BF_BBOX must be given as \"latMin,latMax,lonMin,lonMax\" in degrees.\n\tIts current value is %s.\n", s);
+            return FATAL_ERR;
+        }
+        bfSubset.useBox = 1;
+    }
+
+    s = getenv("BF_TIME_WINDOW");
+    if ( s && *s )
+    {
+        unsigned int date[10];
+        double seconds[2];
+
+        if ( sscanf( s, "%u-%u-%uT%u:%u:%lf/%u-%u-%uT%u:%u:%lf", &date[0], &date[1], &date[2], &date[3], &date[4],
+                     &seconds[0], &date[5], &date[6], &date[7], &date[8], &date[9], &seconds[1] ) != 12 )
+        {
+            FATAL_MSG("BF_TIME_WINDOW must be given as \"YYYY-MM-DDThh:mm:ss/YYYY-MM-DDThh:mm:ss\".\n\tIts current value is %s.\n", s);
+            return FATAL_ERR;
+        }
+        bfSubset.timeStart.year = date[0];
+        bfSubset.timeStart.month = date[1];
+        bfSubset.timeStart.day = date[2];
+        bfSubset.timeStart.hour = date[3];
+        bfSubset.timeStart.minute = date[4];
+        bfSubset.timeStart.second = seconds[0];
+        bfSubset.timeEnd.year = date[5];
+        bfSubset.timeEnd.month = date[6];
+        bfSubset.timeEnd.day = date[7];
+        bfSubset.timeEnd.hour = date[8];
+        bfSubset.timeEnd.minute = date[9];
+        bfSubset.timeEnd.second = seconds[1];
+        if ( comp_greg( bfSubset.timeStart, bfSubset.timeEnd ) >= 0 )
+        {
+            FATAL_MSG("The start of BF_TIME_WINDOW must be before its end.\n");
+            return FATAL_ERR;
+        }
+        bfSubset.useTime = 1;
+    }
+
+    return RET_SUCCESS;
+}
 
+/*
+                        subsetOrbitInfo
+    DESCRIPTION:
+        This function narrows the orbit start and end times to the BF_TIME_WINDOW. MOPITT and CERES select
+        their data by the orbit times, so they honor the time window through it.
     ARGUMENTS:
-        IN
-            char* dimSuffix      -- Name of the output dimension scale. Datasets passed to this function should be
-                                     given a unique dimension scale name in the case that their HDF4 dimensions have the
-                                     same name (across multiple HDF4 files) but are not identical dimensions (different
-                                     dimension size, different values inside the dimension). This string will be appended
-                                     to the name of the input HDF4 dataset in the output HDF5 dataset. For instance, if
-                                     the input HDF4 dimension is named:
-                                        "inHDF4dimName"
-                                     and dimSuffix is:
-                                        "_g1"
-                                     The name of the dimension in the HDF5 file will be:
-                                        "inHDF4dimName_g1"
+        OInfo_t* orbitInfo  -- The orbit times to narrow
+    EFFECTS:
+        Modifies orbitInfo.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS_NO_PROCESS if the time window does not overlap the orbit
+        RET_SUCCESS on success
+*/
 
-                                     Pass NULL in for this argument if a unique dimension is not required. If NULL is passed,
-                                     this function will attempt to share the generated HDF5 dimension for all objects that
-                                     reference it in the input HDF4 files.
+herr_t subsetOrbitInfo( OInfo_t* orbitInfo )
+{
+    GDateInfo_t orbitStart;
+    GDateInfo_t orbitEnd;
 
-                                     This string must be null terminated, or else a seg fault may occur.
+    if ( !bfSubset.useTime )
+        return RET_SUCCESS;
 
-            int32 h4fileID        -- The HDF4 file ID returned by SDstart
-            char* h4datasetName   -- The name of the HDF4 dataset from which to copy from
-            hid_t h5dimGroupID    -- The HDF5 group ID in which to store and/or find the dimension scales
-            hid_t h5dsetID        -- The HDF5 dataset ID in which to attach dimension scales
-            int32 s_size          -- The subset size
+    orbitStart.year = orbitInfo->start_year;
+    orbitStart.month = orbitInfo->start_month;
+    orbitStart.day = orbitInfo->start_day;
+    orbitStart.hour = orbitInfo->start_hour;
+    orbitStart.minute = orbitInfo->start_minute;
+    orbitStart.second = orbitInfo->start_second;
+    orbitEnd.year = orbitInfo->end_year;
+    orbitEnd.month = orbitInfo->end_month;
+    orbitEnd.day = orbitInfo->end_day;
+    orbitEnd.hour = orbitInfo->end_hour;
+    orbitEnd.minute = orbitInfo->end_minute;
+    orbitEnd.second = orbitInfo->end_second;
+
+    if ( comp_greg( bfSubset.timeStart, orbitEnd ) >= 0 || comp_greg( orbitStart, bfSubset.timeEnd ) >= 0 )
+        return RET_SUCCESS_NO_PROCESS;
+
+    if ( comp_greg( bfSubset.timeStart, orbitStart ) > 0 )
+    {
+        orbitInfo->start_year = bfSubset.timeStart.year;
+        orbitInfo->start_month = bfSubset.timeStart.month;
+        orbitInfo->start_day = bfSubset.timeStart.day;
+        orbitInfo->start_hour = bfSubset.timeStart.hour;
+        orbitInfo->start_minute = bfSubset.timeStart.minute;
+        orbitInfo->start_second = (unsigned char) bfSubset.timeStart.second;
+    }
+    if ( comp_greg( bfSubset.timeEnd, orbitEnd ) < 0 )
+    {
+        orbitInfo->end_year = bfSubset.timeEnd.year;
+        orbitInfo->end_month = bfSubset.timeEnd.month;
+        orbitInfo->end_day = bfSubset.timeEnd.day;
+        orbitInfo->end_hour = bfSubset.timeEnd.hour;
+        orbitInfo->end_minute = bfSubset.timeEnd.minute;
+        orbitInfo->end_second = (unsigned char) bfSubset.timeEnd.second;
+    }
 
-    EFFECTS:
-        Creates dimension scale if it doesn't exist under the h5dimGroupID group. Attaches the dimension scale
-        to the h5dsetID dataset.
+    return RET_SUCCESS;
+}
+
+/* Bring a longitude to -180 to 180. Returns 0 for values that are not longitudes (fill values). */
+static int normalizeLon( double* lon )
+{
+    if ( *lon < -360.0 || *lon > 360.0 || *lon != *lon )
+        return 0;
+    if ( *lon >= 180.0 ) *lon -= 360.0;
+    if ( *lon < -180.0 ) *lon += 360.0;
+    return 1;
+}
 
+/*
+                        subsetPointInside
+    DESCRIPTION:
+        This function tells whether a point lies in the BF_BBOX box. Fill values are never inside.
+    ARGUMENTS:
+        double lat  -- Latitude in degrees
+        double lon  -- Longitude in degrees, either -180 to 180 or 0 to 360
+    EFFECTS:
+        None
     RETURN:
-        FAIL upon failure.
-        SUCCEED upon success.
+        1 if the point is inside the box or no box is set, 0 otherwise
+*/
+
+int subsetPointInside( double lat, double lon )
+{
+    if ( !bfSubset.useBox )
+        return 1;
+
+    if ( lat < bfSubset.latMin || lat > bfSubset.latMax || !normalizeLon( &lon ) )
+        return 0;
+
+    if ( bfSubset.lonMin <= bfSubset.lonMax )
+        return lon >= bfSubset.lonMin && lon <= bfSubset.lonMax;
+
+    return lon >= bfSubset.lonMin || lon <= bfSubset.lonMax;
+}
 
+/*
+                        subsetExtentOverlaps
+    DESCRIPTION:
+        This function tells whether the lat/lon extent of a set of points overlaps the BF_BBOX box. The
+        longitude extent is taken across the antimeridian when that makes it narrower. Use it for coarse
+        geolocation grids (granule corners, sampled blocks), where the box may fall between the points.
+    ARGUMENTS:
+        const double* lat   -- Latitudes in degrees
+        const double* lon   -- Longitudes in degrees
+        size_t numPoints    -- The number of points
+    EFFECTS:
+        None
+    RETURN:
+        1 if the extent overlaps the box or no box is set, 0 otherwise (also if no point is valid)
 */
-herr_t copyDimensionSubset( char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID,
-                            int32 s_size )
+
+int subsetExtentOverlaps( const double* lat, const double* lon, size_t numPoints )
 {
-    hsize_t tempInt = 0;
-    char* dimName = NULL;
-    herr_t errStatus = 0;
-    int32 ntype = 0;
-    int32 h4dsetID = 0;
-    intn statusn = 0;
-    int rank = 0;
-    int status = 0;
-    hid_t h5dimID = 0;
-    void *dimBuffer = NULL;
-    short fail = 0;
-    hid_t memspace = 0;
-    htri_t dsetExists = 0;
-    short wasHardCodeCopy = 0;
+    double latMin = 90.0, latMax = -90.0;
+    double lonMin = 180.0, lonMax = -180.0;
+    double lon360Min = 360.0, lon360Max = 0.0;
+    double start = 0.0, width = 0.0, boxWidth = 0.0;
+    size_t numValid = 0;
 
-    char* correct_dimName = NULL;
-    char* output_dim_name = NULL;
+    if ( !bfSubset.useBox )
+        return 1;
 
-    /* Get dataset index */
-    int32 sds_index = SDnametoindex(h4fileID, h4datasetName );
-    if ( sds_index == FAIL )
+    for ( size_t i = 0; i < numPoints; i++ )
     {
-        FATAL_MSG("Failed to get SD index.\n");
-        goto cleanupFail;
+        double tempLon = lon[i];
+        double tempLon360 = 0.0;
+
+        if ( lat[i] < -90.0 || lat[i] > 90.0 || !normalizeLon( &tempLon ) )
+            continue;
+        tempLon360 = tempLon < 0.0 ? tempLon + 360.0 : tempLon;
+        latMin = min( latMin, lat[i] );
+        latMax = max( latMax, lat[i] );
+        lonMin = min( lonMin, tempLon );
+        lonMax = max( lonMax, tempLon );
+        lon360Min = min( lon360Min, tempLon360 );
+        lon360Max = max( lon360Max, tempLon360 );
+        numValid++;
     }
-    /* select the dataset */
-    h4dsetID = SDselect(h4fileID, sds_index);
-    if ( h4dsetID == FAIL )
+
+    if ( numValid == 0 || latMax < bfSubset.latMin || latMin > bfSubset.latMax )
+        return 0;
+
+    /* Points around a pole cover all longitudes */
+    if ( latMax >= 89.0 || latMin <= -89.0 )
+        return 1;
+
+    if ( lon360Max - lon360Min < lonMax - lonMin )
     {
-        h4dsetID = 0;
-        FATAL_MSG("Failed to select the HDF4 dataset.\n");
-        goto cleanupFail;
+        start = lon360Min;
+        width = lon360Max - lon360Min;
     }
-
-    /* get the rank of the dataset so we know how many dimensions to copy */
-    statusn = SDgetinfo(h4dsetID, NULL, &rank, NULL, NULL, NULL );
-    if ( statusn == FAIL )
+    else
     {
-        FATAL_MSG("Failed to get SD info.\n");
-        goto cleanupFail;
+        start = lonMin;
+        width = lonMax - lonMin;
     }
 
+    boxWidth = bfSubset.lonMax - bfSubset.lonMin;
+    if ( boxWidth < 0.0 )
+        boxWidth += 360.0;
 
-    int32 dim_index;
+    for ( int k = -1; k <= 1; k++ )
+    {
+        double boxStart = bfSubset.lonMin + k * 360.0;
+        if ( start <= boxStart + boxWidth && boxStart <= start + width )
+            return 1;
+    }
 
-    // COPY OVER DIMENSION SCALES TO HDF5 OBJECT
-    dimName = calloc(500, 1);
-    int32 size = 0;
-    int32 num_attrs = 0;
-    hid_t h5type = 0;
-    int32 h4dimID = 0;
+    return 0;
+}
 
-    for ( dim_index = 0; dim_index < rank; dim_index++ )
-    {
-        // Get the dimension ID
-        h4dimID = SDgetdimid ( h4dsetID, dim_index );
-        if ( h4dimID == FAIL )
-        {
-            FATAL_MSG("Failed to get dimension ID.\n");
-            h4dimID = 0;
-            goto cleanupFail;
-        }
+/*
+                        subsetSDSOverlaps
+    DESCRIPTION:
+        This function tells whether the geolocation datasets of an HDF4 input file have any point inside
+        the BF_BBOX box, or, with extentOnly set, whether their extent overlaps it.
+    ARGUMENTS:
+        int32 inputFileID       -- The HDF4 SD file identifier
+        const char* latName     -- The name of the latitude dataset
+        const char* lonName     -- The name of the longitude dataset
+        int32 dataType          -- DFNT_FLOAT32 or DFNT_FLOAT64, the type of both datasets
+        int extentOnly          -- Compare the extent of the points instead of the points themselves
+    EFFECTS:
+        Reads the datasets.
+    RETURN:
+        FATAL_ERR on failure
+        1 if the data overlaps the box or no box is set, 0 otherwise
+*/
 
-        /* get various useful info about this dimension */
-        statusn = SDdiminfo( h4dimID, dimName, &size, &ntype, &num_attrs );
-        if ( statusn == FAIL )
-        {
-            FATAL_MSG("Failed to get dimension info.\n");
-            goto cleanupFail;
-        }
+int subsetSDSOverlaps( int32 inputFileID, const char* latName, const char* lonName, int32 dataType, int extentOnly )
+{
+    void* latBuf = NULL;
+    void* lonBuf = NULL;
+    double* lat = NULL;
+    double* lon = NULL;
+    int32 rank = 0;
+    int32 dims[DIM_MAX];
+    size_t numPoints = 1;
+    int retVal = 0;
 
-        size = s_size;
+    if ( !bfSubset.useBox )
+        return 1;
 
-        correct_dimName = correct_name(dimName);
+    if ( dataType != DFNT_FLOAT32 && dataType != DFNT_FLOAT64 )
+    {
+        FATAL_MSG("Geolocation must be 32 or 64 bit floating point.\n");
+        return FATAL_ERR;
+    }
 
-        // Now we need to add the granule number for this dimenson since each granule will be different.
-        if ( dimSuffix != NULL )
-        {
-            output_dim_name=calloc(strlen(correct_dimName) + 
-                                      strlen(dimSuffix) + 1, 1);
+    if ( H4readData( inputFileID, latName, &latBuf, &rank, dims, dataType, NULL, NULL, NULL ) == FATAL_ERR ||
+         H4readData( inputFileID, lonName, &lonBuf, NULL, NULL, dataType, NULL, NULL, NULL ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to read the geolocation datasets %s and %s.\n", latName, lonName);
+        retVal = FATAL_ERR;
+        goto cleanup;
+    }
+    for ( int i = 0; i < rank; i++ )
+        numPoints *= dims[i];
 
-            // Copy over the new dimension name
-            sprintf( output_dim_name, "%s%s", correct_dimName, dimSuffix );
+    if ( dataType == DFNT_FLOAT64 )
+    {
+        lat = latBuf;
+        lon = lonBuf;
+    }
+    else
+    {
+        lat = malloc( numPoints * sizeof(double) );
+        lon = malloc( numPoints * sizeof(double) );
+        if ( lat == NULL || lon == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            retVal = FATAL_ERR;
+            goto cleanup;
         }
-        else
+        for ( size_t i = 0; i < numPoints; i++ )
         {
-            // We have to calloc separately because free() will be called on both output_dim_name and correct_dimName
-            output_dim_name = calloc ( strlen(correct_dimName) + 1, 1 );
-            strncpy( output_dim_name, correct_dimName, strlen(correct_dimName) );
+            lat[i] = ((float*) latBuf)[i];
+            lon[i] = ((float*) lonBuf)[i];
         }
+    }
 
-        /* Since dimension scales are shared, it is possible this dimension already exists in HDF5 file (previous
-           call to this function created it). Check to see if it does. If so, use the dimension that eixsts.
-        */
-        dsetExists = H5Lexists(h5dimGroupID, output_dim_name, H5P_DEFAULT);
+    if ( extentOnly )
+        retVal = subsetExtentOverlaps( lat, lon, numPoints );
+    else
+        for ( size_t i = 0; i < numPoints && !retVal; i++ )
+            retVal = subsetPointInside( lat[i], lon[i] );
 
-        // if dsetExists is <= 0, then dimension does not yet exist.
-        if ( dsetExists <= 0 )
-        {
-            wasHardCodeCopy = 0;
-            /* SDdiminfo will return 0 for ntype if the dimension has no scale information. This is the case when
-               it is a pure dimension.  We need two separate cases for when it is and is not a pure dim
-            */
+cleanup:
+    if ( lat != latBuf ) free(lat);
+    if ( lon != lonBuf ) free(lon);
+    free(latBuf);
+    free(lonBuf);
 
-            if ( ntype != 0 )
-            {
-                /* get the correct HDF5 datatype from ntype */
-                status = h4type_to_h5type( ntype, &h5type );
-                if ( status != 0 )
-                {
-                    FATAL_MSG("Failed to convert HDF4 to HDF5 datatype.\n");
-                    goto cleanupFail;
-                }
+    return retVal;
+}
 
-                /* read the dimension scale into a buffer */
-                dimBuffer = malloc(size);
-                statusn = SDgetdimscale(h4dimID, dimBuffer);
-                if ( statusn != 0 )
-                {
-                    FATAL_MSG("Failed to get dimension scale.\n");
-                    goto cleanupFail;
-                }
+/*
+                        subsetTrackRange
+    DESCRIPTION:
+        This function narrows a range of along-track indices to the tracks that have at least one point inside
+        the BF_BBOX box. The tracks between the first and the last such track are kept, so the result is still
+        one contiguous range, as used by the MOPITT and CERES subsetting.
+    ARGUMENTS:
+        const float* lat        -- Latitudes of the tracks start to end (colatitudes if colatitude is set)
+        const float* lon        -- Longitudes of the tracks start to end
+        int colatitude          -- Non-zero if lat holds colatitudes (CERES)
+        size_t pointsPerTrack   -- The number of points per track
+        unsigned int* start     -- In: the first track of the range. Out: the first track inside the box.
+        unsigned int* end       -- In: the last track of the range. Out: the last track inside the box.
+    EFFECTS:
+        Modifies start and end.
+    RETURN:
+        RET_SUCCESS_NO_PROCESS if no track is inside the box
+        RET_SUCCESS otherwise
+*/
 
-                /* make a new dataset for our dimension scale */
+herr_t subsetTrackRange( const float* lat, const float* lon, int colatitude, size_t pointsPerTrack,
+                         unsigned int* start, unsigned int* end )
+{
+    long first = -1;
+    long last = -1;
+    size_t numTracks = *end - *start + 1;
 
-                tempInt = size;
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, h5type, output_dim_name, dimBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
+    if ( !bfSubset.useBox )
+        return RET_SUCCESS;
 
-                free(dimBuffer);
-                dimBuffer = NULL;
-            }
+    for ( size_t i = 0; i < numTracks; i++ )
+    {
+        for ( size_t j = 0; j < pointsPerTrack; j++ )
+        {
+            size_t k = i * pointsPerTrack + j;
+            double tempLat = colatitude ? 90.0 - lat[k] : lat[k];
 
-            else
+            if ( subsetPointInside( tempLat, lon[k] ) )
             {
-                hsize_t tempSize2 = 0;
+                if ( first < 0 ) first = i;
+                last = i;
+                break;
+            }
+        }
+    }
 
-                tempSize2 = (hsize_t) size;
-                memspace = H5Screate_simple( 1, &tempSize2, NULL );
+    if ( first < 0 )
+        return RET_SUCCESS_NO_PROCESS;
 
-                h5dimID = H5Dcreate( h5dimGroupID, output_dim_name, H5T_NATIVE_INT, memspace,
-                                     H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
-                if ( h5dimID < 0 )
-                {
-                    FATAL_MSG("Failed to create dataset.\n");
-                    h5dimID = 0;
-                    goto cleanupFail;
-                }
+    *end = *start + last;
+    *start = *start + first;
 
-                H5Sclose(memspace);
-                memspace = 0;
+    return RET_SUCCESS;
+}
 
-            } // end else
+/* Days before each month in a common year */
+static const int daysBeforeMonth[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
 
-            errStatus = H5DSset_scale(h5dimID, output_dim_name);
-            if ( errStatus != 0 )
-            {
-                FATAL_MSG("Failed to set dataset as a dimension scale.\n");
-                goto cleanupFail;
-            }
+/*
+                        subsetGranuleTime
+    DESCRIPTION:
+        This function tells whether a MODIS or ASTER granule, identified by the time in its file name (see
+        getTime), overlaps the BF_TIME_WINDOW. MODIS granules span 5 minutes, ASTER scenes about 9 seconds.
+    ARGUMENTS:
+        char* pathname  -- The path of the granule
+        int instrument  -- 2 for MODIS, 3 for ASTER (same as getTime)
+    EFFECTS:
+        None
+    RETURN:
+        FATAL_ERR on failure
+        1 if the granule overlaps the time window or no window is set, 0 otherwise
+*/
 
+int subsetGranuleTime( char* pathname, int instrument )
+{
+    char* timeStr = NULL;
+    GDateInfo_t granTime;
+    double granStart = 0.0, windowStart = 0.0, windowEnd = 0.0;
+    double duration = 0.0;
+    unsigned int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    int retVal = 0;
 
-            /* Correct the NAME attribute of the pure dimension to conform with netCDF
-               standards.
-            */
-            if ( ntype == 0 && !wasHardCodeCopy )
-            {
-                statusn = change_dim_attr_NAME_value(h5dimID);
-                if ( statusn == FAIL )
-                {
-                    FATAL_MSG("Failed to change the NAME attribute of a dimension.\n");
-                    goto cleanupFail;
-                }
-            }
-        } // end if ( dsetExists <= 0 )
+    if ( !bfSubset.useTime )
+        return 1;
 
-        else
-        {
-            h5dimID = H5Dopen2(h5dimGroupID, output_dim_name, H5P_DEFAULT);
-            if ( h5dimID < 0 )
-            {
-                h5dimID = 0;
-                FATAL_MSG("Failed to open dataset.\n");
-                goto cleanupFail;
-            }
-        }
+    timeStr = getTime( pathname, instrument );
+    if ( timeStr == NULL )
+    {
+        FATAL_MSG("Failed to get the time of %s.\n", pathname);
+        return FATAL_ERR;
+    }
 
-        errStatus = H5DSattach_scale(h5dsetID, h5dimID, dim_index);
-        if ( errStatus != 0 )
-        {
-            FATAL_MSG("Failed to attach dimension scale.\n");
-            goto cleanupFail;
-        }
+    if ( instrument == 2 )
+    {
+        unsigned int dayOfYear = 0;
+        int leap = 0;
 
-        free(correct_dimName);
-        correct_dimName = NULL;
-        free(output_dim_name);
-        output_dim_name = NULL;
-        H5Dclose(h5dimID);
-        h5dimID = 0;
-    }   // end for loop
+        /* YYYYDDD.hhmm */
+        if ( sscanf( timeStr, "%4u%3u.%2u%2u", &year, &dayOfYear, &hour, &minute ) != 4 )
+            goto parseFail;
+        leap = ( year % 4 == 0 && year % 100 != 0 ) || year % 400 == 0;
+        for ( month = 12; month > 1; month-- )
+            if ( dayOfYear > (unsigned int) ( daysBeforeMonth[month-1] + ( leap && month > 2 ) ) )
+                break;
+        day = dayOfYear - daysBeforeMonth[month-1] - ( leap && month > 2 );
+        duration = 300.0;
+    }
+    else if ( instrument == 3 )
+    {
+        /* MMDDYYYYhhmmss */
+        if ( sscanf( timeStr, "%2u%2u%4u%2u%2u%2u", &month, &day, &year, &hour, &minute, &second ) != 6 )
+            goto parseFail;
+        duration = 9.0;
+    }
+    else
+    {
+        FATAL_MSG("Granule times are only known for MODIS and ASTER.\n");
+        free(timeStr);
+        return FATAL_ERR;
+    }
 
-    fail = 0;
-    if ( 0 )
+    granTime.year = year;
+    granTime.month = month;
+    granTime.day = day;
+    granTime.hour = hour;
+    granTime.minute = minute;
+    granTime.second = second;
+
+    if ( getTAI93( granTime, &granStart ) == FATAL_ERR || getTAI93( bfSubset.timeStart, &windowStart ) == FATAL_ERR ||
+         getTAI93( bfSubset.timeEnd, &windowEnd ) == FATAL_ERR )
     {
-cleanupFail:
-        fail = 1;
+        FATAL_MSG("Failed to get TAI93 timestamps.\n");
+        free(timeStr);
+        return FATAL_ERR;
     }
 
-    // The following free, espeically free(dimName) may be an issue.
-    if ( dimName ) free ( dimName );
-    if ( h5dimID ) H5Dclose(h5dimID);
-    if ( dimBuffer ) free(dimBuffer);
-    if ( correct_dimName ) free(correct_dimName);
-    if ( memspace ) H5Sclose(memspace);
-    if ( fail ) return FAIL;
+    retVal = ( granStart < windowEnd && granStart + duration > windowStart );
+    free(timeStr);
 
-    return SUCCEED;
+    return retVal;
+
+parseFail:
+    FATAL_MSG("Failed to parse the granule time %s.\n", timeStr);
+    free(timeStr);
+    return FATAL_ERR;
+}
 
+/* Helpers for indexGeolocation */
+
+/* The extent of a set of points. Longitudes are tracked both from -180 to 180 and from 0 to 360, so that an
+ * extent crossing the antimeridian stays narrow (as in subsetExtentOverlaps).
+ */
+typedef struct
+{
+    double latMin;
+    double latMax;
+    double lonMin;
+    double lonMax;
+    double lon360Min;
+    double lon360Max;
+    size_t numValid;
+} geoExtent_t;
+
+static void initGeoExtent( geoExtent_t* ext )
+{
+    ext->latMin = 90.0;
+    ext->latMax = -90.0;
+    ext->lonMin = 180.0;
+    ext->lonMax = -180.0;
+    ext->lon360Min = 360.0;
+    ext->lon360Max = 0.0;
+    ext->numValid = 0;
 }
 
-herr_t attachDimension(hid_t fileID,char*dimname, hid_t dsetID,int dim_index)
+static void addGeoPoint( geoExtent_t* ext, double lat, double lon )
 {
+    double lon360 = 0.0;
+
+    if ( lat < -90.0 || lat > 90.0 || !normalizeLon( &lon ) )
+        return;
+    lon360 = lon < 0.0 ? lon + 360.0 : lon;
+    ext->latMin = min( ext->latMin, lat );
+    ext->latMax = max( ext->latMax, lat );
+    ext->lonMin = min( ext->lonMin, lon );
+    ext->lonMax = max( ext->lonMax, lon );
+    ext->lon360Min = min( ext->lon360Min, lon360 );
+    ext->lon360Max = max( ext->lon360Max, lon360 );
+    ext->numValid++;
+}
 
-    hid_t h5dimID = H5Dopen2(fileID, dimname, H5P_DEFAULT);
-    if ( h5dimID < 0 )
+/* Round outwards, so that the float box still holds every point */
+static float floatBelow( double value )
+{
+    float f = (float) value;
+    return f > value ? nextafterf( f, -HUGE_VALF ) : f;
+}
+
+static float floatAbove( double value )
+{
+    float f = (float) value;
+    return f < value ? nextafterf( f, HUGE_VALF ) : f;
+}
+
+/* Turn an extent into a box. Extents reaching a pole cover all longitudes. Returns 0 if no point was valid. */
+static int finishGeoExtent( const geoExtent_t* ext, spatialBox_t* box )
+{
+    if ( ext->numValid == 0 )
+        return 0;
+
+    box->latMin = floatBelow( ext->latMin );
+    box->latMax = floatAbove( ext->latMax );
+    if ( ext->latMax >= 89.0 || ext->latMin <= -89.0 )
     {
-        FATAL_MSG("Failed to open dataset.\n");
-        return FAIL;
+        box->lonMin = -180.0f;
+        box->lonMax = 180.0f;
     }
-
-    if(H5DSattach_scale(dsetID,h5dimID,dim_index))
+    else if ( ext->lon360Max - ext->lon360Min < ext->lonMax - ext->lonMin )
     {
-        FATAL_MSG("Failed to attach the dimension scale.\n");
-        H5Dclose(h5dimID);
-        return FAIL;
+        box->lonMin = floatBelow( ext->lon360Min >= 180.0 ? ext->lon360Min - 360.0 : ext->lon360Min );
+        box->lonMax = floatAbove( ext->lon360Max >= 180.0 ? ext->lon360Max - 360.0 : ext->lon360Max );
     }
-    H5Dclose(h5dimID);
-    return SUCCEED;
+    else
+    {
+        box->lonMin = floatBelow( ext->lonMin );
+        box->lonMax = floatAbove( ext->lonMax );
+    }
+
+    return 1;
 }
 
-/*
-        makePureDim
+/* Write the boxes of one geolocation dataset to SPATIAL_INDEX_GROUP/instrument in the output file. The table
+ * is named after the path of the latitude dataset, with '.' for '/', so that tables written by different
+ * processes do not clash when their files are linked or consolidated. A table left by an interrupted run is
+ * replaced.
+ */
+static herr_t writeSpatialIndexTable( const BFcontext_t* ctx, const char* instrument, const char* latPath, const char* lonPath,
+                                      const spatialBox_t* boxes, size_t numBoxes, const geoExtent_t* total )
+{
+    char* groupPath = NULL;
+    char* tableName = NULL;
+    hid_t groupID = -1;
+    hid_t boxType = -1;
+    hid_t space = -1;
+    hid_t table = -1;
+    hsize_t dims = numBoxes;
+    spatialBox_t extent;
+    float extentAttr[4];
+    attrStage_t stage;
+    htri_t exists = 0;
+    int fail = 0;
+
+    if ( numBoxes == 0 || !finishGeoExtent( total, &extent ) )
+        return RET_SUCCESS;
 
- DESCRIPTION:
-    makePureDim takes as input a data buffer containing the data that a new dimension will contain.
-    This function makes sure that the dimension complies with netCDF standards.
+    initAttrStage( ctx, &stage, -1 );
 
- ARGUMENTS:
-    IN
-        hid_t locID         -- The HDF5 group identifier where the dataset will be placed underneath
-        char* dimName       -- The name that the dataset will have
-        void* dataBuffer    -- The buffer containing the data to be written to the dataset
-        hid_t dataspace     -- The HDF5 dataspace identifier. Contains information on the dimensionality
-                               of dataBuffer
-        hid_t h5Type        -- The HDF5 datatype identifier of dataBuffer
-        
-    IN/OUT
-        hid_t* retID        -- If this pointer is set to non-null, the resultant dimension identifier will
-                               be placed at this memory location. Also, if this is non-null, it will be
-                               the duty of the caller to free this ID with H5Dclose() when done.
- EFFECTS:
-    Creates a new HDF dimension at locID. If retID is non-null, the ID will be returned. Else if it is null,
-    the identifier will be closed before returning.
+    groupPath = malloc( strlen(SPATIAL_INDEX_GROUP) + strlen(instrument) + 3 );
+    tableName = malloc( strlen(latPath) + 1 );
+    if ( groupPath == NULL || tableName == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    sprintf( groupPath, "/%s/%s", SPATIAL_INDEX_GROUP, instrument );
+    strcpy( tableName, latPath[0] == '/' ? latPath + 1 : latPath );
+    for ( char* c = tableName; *c; c++ )
+        if ( *c == '/' )
+            *c = '.';
 
- RETURN:
-    RET_SUCCESS
-    FATAL_ERR  
+    /* Create the index group and the instrument group as needed */
+    for ( char* slash = strchr( groupPath + 1, '/' ); ; slash = NULL )
+    {
+        hid_t tempGroup = -1;
 
-*/
-//herr_t makePureDim( hid_t locID, const char* dimName, void* dataBuffer, hid_t dataspace, hid_t h5Type, hid_t* retID )
-herr_t makePureDim( hid_t locID, const char* dimName,  hid_t dataspace, hid_t h5Type, hid_t* retID )
-{
-    hid_t dimID = 0;
-    herr_t retVal = RET_SUCCESS;
-    herr_t status = 0;
-    int stat1 = 0;
+        if ( slash ) *slash = '\0';
+        exists = H5Lexists( ctx->outputFile, groupPath, H5P_DEFAULT );
+        if ( exists < 0 )
+        {
+            FATAL_MSG("Failed to check the existence of %s.\n", groupPath);
+            goto cleanupFail;
+        }
+        if ( !exists )
+        {
+            tempGroup = H5Gcreate2( ctx->outputFile, groupPath, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+            if ( tempGroup < 0 )
+            {
+                FATAL_MSG("Failed to create the group %s.\n", groupPath);
+                goto cleanupFail;
+            }
+            H5Gclose(tempGroup);
+        }
+        if ( !slash )
+            break;
+        *slash = '/';
+    }
 
-    dimID = H5Dcreate2( locID, dimName, h5Type, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-    if ( dimID < 0 )
+    groupID = H5Gopen2( ctx->outputFile, groupPath, H5P_DEFAULT );
+    if ( groupID < 0 )
     {
-        FATAL_MSG("Failed to create the HDF5 dataset.\n");
-        dimID = 0;
+        FATAL_MSG("Failed to open the group %s.\n", groupPath);
         goto cleanupFail;
     }
 
-#if 0
-    status = H5Dwrite( dimID, h5Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, dataBuffer );
-    if ( status < 0 )
+    exists = H5Lexists( groupID, tableName, H5P_DEFAULT );
+    if ( exists < 0 || ( exists && H5Ldelete( groupID, tableName, H5P_DEFAULT ) < 0 ) )
     {
-        FATAL_MSG("Failed to write to the dataset.\n");
+        FATAL_MSG("Failed to replace the spatial index table %s.\n", tableName);
         goto cleanupFail;
-    }    
-#endif
-    
-    // Make this new dataset a dimension
-    status = H5DSset_scale( dimID, dimName );
-    if ( status < 0 )
+    }
+
+    boxType = H5Tcreate( H5T_COMPOUND, sizeof(spatialBox_t) );
+    if ( boxType < 0 ||
+         H5Tinsert( boxType, "row_start", HOFFSET(spatialBox_t, rowStart), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( boxType, "row_count", HOFFSET(spatialBox_t, rowCount), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( boxType, "lat_min", HOFFSET(spatialBox_t, latMin), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( boxType, "lat_max", HOFFSET(spatialBox_t, latMax), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( boxType, "lon_min", HOFFSET(spatialBox_t, lonMin), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( boxType, "lon_max", HOFFSET(spatialBox_t, lonMax), H5T_NATIVE_FLOAT ) < 0 )
     {
-        FATAL_MSG("Failed to make the dataset a dimension.\n");
+        FATAL_MSG("Failed to create the spatial index datatype.\n");
         goto cleanupFail;
     }
 
-    // Change the NAME attribute (created by H5DSset_scale) according to netCDF standards
-    stat1 = change_dim_attr_NAME_value( dimID );
-    if ( stat1 == FAIL )
+    space = H5Screate_simple( 1, &dims, NULL );
+    if ( space < 0 )
     {
-        FATAL_MSG("Failed to change the NAME attribute.\n");
+        FATAL_MSG("Failed to create the dataspace of %s.\n", tableName);
         goto cleanupFail;
-    }    
+    }
+    table = H5Dcreate2( groupID, tableName, boxType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( table < 0 || H5Dwrite( table, boxType, H5S_ALL, H5S_ALL, H5P_DEFAULT, boxes ) < 0 )
+    {
+        FATAL_MSG("Failed to write the spatial index table %s.\n", tableName);
+        goto cleanupFail;
+    }
 
-    if ( retID )
-        *retID = dimID;
-    else
-        H5Dclose(dimID);
+    extentAttr[0] = extent.latMin;
+    extentAttr[1] = extent.latMax;
+    extentAttr[2] = extent.lonMin;
+    extentAttr[3] = extent.lonMax;
+    initAttrStage( ctx, &stage, table );
+    if ( stageAttrString( &stage, "latitude", latPath ) == FATAL_ERR ||
+         stageAttrString( &stage, "longitude", lonPath ) == FATAL_ERR ||
+         stageAttr( &stage, "extent", H5T_NATIVE_FLOAT, 4, extentAttr ) == FATAL_ERR ||
+         flushAttrStage( &stage ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the attributes of the spatial index table %s.\n", tableName);
+        goto cleanupFail;
+    }
 
     if ( 0 )
     {
 cleanupFail:
-        retVal = FATAL_ERR;        
-        if ( dimID ) 
-        {
-            H5Dclose(dimID);
-            *retID = 0;
-        }
+        fail = 1;
     }
- 
-    return retVal;
+
+    discardAttrStage( &stage );
+    if ( table >= 0 ) H5Dclose(table);
+    if ( space >= 0 ) H5Sclose(space);
+    if ( boxType >= 0 ) H5Tclose(boxType);
+    if ( groupID >= 0 ) H5Gclose(groupID);
+    free(groupPath);
+    free(tableName);
+
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
 }
 
-size_t obtainDimSize(hid_t dsetID)
+/* The path of an object, allocated with malloc. NULL on failure. */
+static char* getObjectPath( hid_t objectID )
 {
+    ssize_t len = H5Iget_name( objectID, NULL, 0 );
+    char* path = len > 0 ? malloc( len + 1 ) : NULL;
 
-    hid_t dspace = H5Dget_space(dsetID);
-    size_t ret_size =(size_t)H5Sget_simple_extent_npoints(dspace);
-    H5Sclose(dspace);
-    return ret_size;
+    if ( path && H5Iget_name( objectID, path, len + 1 ) < 0 )
+    {
+        free(path);
+        path = NULL;
+    }
 
+    return path;
 }
 
-herr_t Generate2D_Dataset(hid_t h5_group,char* dsetname,hid_t h5_type,void* databuffer,hid_t dim0_id,hid_t dim1_id,size_t dim0_size,size_t dim1_size,unsigned short comp_flag)
+/* Add a box to a growing array of boxes */
+static herr_t appendSpatialBox( spatialBox_t** boxes, size_t* numBoxes, size_t* size, const geoExtent_t* ext,
+                                hsize_t rowStart, hsize_t rowCount )
 {
-    hsize_t temp[2];
-    temp[0] = (hsize_t) (dim0_size);
-    temp[1] = (hsize_t) (dim1_size);
-    hid_t dummy_output_file_id, datasetID;
+    spatialBox_t box;
+
+    if ( !finishGeoExtent( ext, &box ) )
+        return RET_SUCCESS;
+    box.rowStart = (uint32_t) rowStart;
+    box.rowCount = (uint32_t) rowCount;
+
+    if ( *numBoxes == *size )
+    {
+        size_t newSize = *size ? 2 * *size : 64;
+        spatialBox_t* temp = realloc( *boxes, newSize * sizeof **boxes );
+        if ( temp == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FATAL_ERR;
+        }
+        *boxes = temp;
+        *size = newSize;
+    }
+    (*boxes)[(*numBoxes)++] = box;
 
-    if(comp_flag == 1) {
-      short use_chunk = 0;
+    return RET_SUCCESS;
+}
 
-      /* If using chunk */
-      {
-        const char *s;
-        s = getenv("USE_CHUNK");
+/*
+                        indexGeolocation
+    DESCRIPTION:
+        This function adds a geolocation dataset pair of the output file to the spatial index. The rows of the
+        datasets (the slowest dimension) are cut into units of unitRows rows: MODIS scans, MISR SOM blocks,
+        CERES footprint runs, MOPITT track segments, or the whole dataset for ASTER. The bounding box of each
+        unit is stored as one row of a table in SPATIAL_INDEX_GROUP/instrument, and the box of the whole
+        dataset in the "extent" attribute of the table. A box with lonMin > lonMax crosses the antimeridian,
+        and a box reaching a pole covers all longitudes. Boxes are rounded outwards to float, and units
+        without valid points are left out. Readers query the index with util/SpatialQuery instead of reading
+        the geolocation itself. BF_SPATIAL_INDEX=0 turns the index off.
+
+        The datasets are read back a unit at a time right after they were written. Use
+        indexGeolocationBuffer when the geolocation is still in memory.
+    ARGUMENTS:
+        const BFcontext_t* ctx  -- The conversion context
+        const char* instrument  -- The instrument name, also the name of its index group
+        hid_t groupID           -- The group holding the geolocation datasets
+        const char* latName     -- The name of the latitude dataset
+        const char* lonName     -- The name of the longitude dataset, of the same shape
+        hsize_t unitRows        -- The rows per box, or SPATIAL_UNIT_ALL for one box
+    EFFECTS:
+        Reads the datasets and writes the index table to ctx->outputFile.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
 
-        if(s && isdigit((int)*s))
-            if((unsigned int)strtol(s,NULL,0) == 1)
-                use_chunk = 1;
-      }
+herr_t indexGeolocation( const BFcontext_t* ctx, const char* instrument, hid_t groupID, const char* latName, const char* lonName,
+                         hsize_t unitRows )
+{
+    hid_t latID = -1;
+    hid_t lonID = -1;
+    hid_t latSpace = -1;
+    hid_t lonSpace = -1;
+    hid_t memSpace = -1;
+    hsize_t latDims[DIM_MAX];
+    hsize_t lonDims[DIM_MAX];
+    hsize_t rowElems = 1;
+    hsize_t batchRows = 0;
+    int rank = 0;
+    double* lat = NULL;
+    double* lon = NULL;
+    char* latPath = NULL;
+    char* lonPath = NULL;
+    spatialBox_t* boxes = NULL;
+    size_t numBoxes = 0;
+    size_t boxesSize = 0;
+    geoExtent_t total;
+    int fail = 0;
+
+    if ( !ctx->spatialIndex )
+        return RET_SUCCESS;
 
-      if(use_chunk == 1)
-      {// The chunk size will always be the whole dataset size for this case.
-        datasetID = insertDataset_comp( &dummy_output_file_id, &h5_group, 1, 2,
-                               temp, h5_type, dsetname, databuffer,0 );
-     
-      }
-      else {
-       datasetID = insertDataset( &dummy_output_file_id, &h5_group, 1, 2,
-                               temp, h5_type, dsetname, databuffer );
-      }
-    }
-    else {
-       datasetID = insertDataset( &dummy_output_file_id, &h5_group, 1, 2,
-                               temp, h5_type, dsetname, databuffer );
+    latID = H5Dopen2( groupID, latName, H5P_DEFAULT );
+    lonID = H5Dopen2( groupID, lonName, H5P_DEFAULT );
+    if ( latID < 0 || lonID < 0 )
+    {
+        FATAL_MSG("Failed to open the geolocation datasets %s and %s.\n", latName, lonName);
+        goto cleanupFail;
     }
-
-    if ( datasetID == FATAL_ERR )
+    latSpace = H5Dget_space( latID );
+    lonSpace = H5Dget_space( lonID );
+    rank = H5Sget_simple_extent_ndims( latSpace );
+    if ( rank < 1 || rank > DIM_MAX || H5Sget_simple_extent_ndims( lonSpace ) != rank ||
+         H5Sget_simple_extent_dims( latSpace, latDims, NULL ) < 0 ||
+         H5Sget_simple_extent_dims( lonSpace, lonDims, NULL ) < 0 ||
+         memcmp( latDims, lonDims, rank * sizeof(hsize_t) ) != 0 )
     {
-         FATAL_MSG("Error writing %s dataset.\n", dsetname );
-        return -1;
+        WARN_MSG("%s and %s differ in shape. They are not indexed.\n", latName, lonName);
+        goto cleanup;
     }
 
-    if(H5DSattach_scale(datasetID,dim0_id,0))
+    latPath = getObjectPath( latID );
+    lonPath = getObjectPath( lonID );
+    if ( latPath == NULL || lonPath == NULL )
     {
-        FATAL_MSG("Failed to attach the dimension scale.\n");
-        return FAIL;
+        FATAL_MSG("Failed to get the path of the geolocation datasets.\n");
+        goto cleanupFail;
     }
 
-    if(H5DSattach_scale(datasetID,dim1_id,1))
+    for ( int i = 1; i < rank; i++ )
+        rowElems *= latDims[i];
+    if ( unitRows == SPATIAL_UNIT_ALL || unitRows > latDims[0] )
+        unitRows = latDims[0];
+
+    /* Read at most a million points at a time */
+    batchRows = ( 1 << 20 ) / rowElems;
+    if ( batchRows < 1 ) batchRows = 1;
+    if ( batchRows > unitRows ) batchRows = unitRows;
+    lat = malloc( batchRows * rowElems * sizeof *lat );
+    lon = malloc( batchRows * rowElems * sizeof *lon );
+    if ( lat == NULL || lon == NULL )
     {
-        FATAL_MSG("Failed to attach the dimension scale.\n");
-        return FAIL;
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
     }
 
-    H5Dclose(datasetID);
+    initGeoExtent( &total );
+    for ( hsize_t unitStart = 0; unitStart < latDims[0]; unitStart += unitRows )
+    {
+        hsize_t unitEnd = min( unitStart + unitRows, latDims[0] );
+        geoExtent_t ext;
 
-    return SUCCEED;
+        initGeoExtent( &ext );
+        for ( hsize_t row = unitStart; row < unitEnd; row += batchRows )
+        {
+            hsize_t start[DIM_MAX] = {0};
+            hsize_t count[DIM_MAX];
+            hsize_t numPoints = 0;
+
+            memcpy( count, latDims, rank * sizeof(hsize_t) );
+            start[0] = row;
+            count[0] = min( batchRows, unitEnd - row );
+            numPoints = count[0] * rowElems;
+
+            memSpace = H5Screate_simple( 1, &numPoints, NULL );
+            if ( memSpace < 0 ||
+                 H5Sselect_hyperslab( latSpace, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ||
+                 H5Sselect_hyperslab( lonSpace, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ||
+                 H5Dread( latID, H5T_NATIVE_DOUBLE, memSpace, latSpace, H5P_DEFAULT, lat ) < 0 ||
+                 H5Dread( lonID, H5T_NATIVE_DOUBLE, memSpace, lonSpace, H5P_DEFAULT, lon ) < 0 )
+            {
+                FATAL_MSG("Failed to read rows %llu to %llu of %s and %s.\n", (unsigned long long) row,
+                          (unsigned long long) ( row + count[0] ), latPath, lonPath);
+                goto cleanupFail;
+            }
+            H5Sclose(memSpace);
+            memSpace = -1;
 
-}
+            for ( hsize_t i = 0; i < numPoints; i++ )
+            {
+                addGeoPoint( &ext, lat[i], lon[i] );
+                addGeoPoint( &total, lat[i], lon[i] );
+            }
+        }
 
+        if ( appendSpatialBox( &boxes, &numBoxes, &boxesSize, &ext, unitStart, unitEnd - unitStart ) == FATAL_ERR )
+            goto cleanupFail;
+    }
 
-/*
-            MOPITTaddDimension
+    if ( writeSpatialIndexTable( ctx, instrument, latPath, lonPath, boxes, numBoxes, &total ) == FATAL_ERR )
+        goto cleanupFail;
 
-    DESCRIPTION:
-        This function adds a dimension scale to the output HDF5 file. It writes the data stored in scaleBuffer to the dimension.
-        The dimension is created under the HDF5 group/file ID given by h5dimGroupID. It does not attach the dimension to any
-        dataset.
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
 
-    EFFECTS:
-        A new dimension scale is added to the output HDF5 file.
+cleanup:
+    if ( memSpace >= 0 ) H5Sclose(memSpace);
+    if ( latSpace >= 0 ) H5Sclose(latSpace);
+    if ( lonSpace >= 0 ) H5Sclose(lonSpace);
+    if ( latID >= 0 ) H5Dclose(latID);
+    if ( lonID >= 0 ) H5Dclose(lonID);
+    free(lat);
+    free(lon);
+    free(latPath);
+    free(lonPath);
+    free(boxes);
 
-        IT IS THE DUTY OF THE CALLER to close the returned identifier with H5Dclose() once finished.
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
+}
 
+/*
+                        indexGeolocationBuffer
+    DESCRIPTION:
+        This function adds geolocation that is still in memory to the spatial index, in the same way as
+        indexGeolocation does for datasets of the output file.
     ARGUMENTS:
-        INPUT
-            1. hid_t h5dimGroupID      -- The file or group identifier under which to store the dimension
-            2. const char* dimName     -- The name to be given to the dimension
-            3. hsize_t dimSize         -- The integer size of the dimension
-            4. const void* scaleBuffer -- The data to be written to the scale
-            5. hid_t dimScaleNumType   -- The HDF5 number type of scaleBuffer
-
+        const BFcontext_t* ctx  -- The conversion context
+        const char* instrument  -- The instrument name, also the name of its index group
+        const char* latPath     -- The path of the latitude dataset in the output file
+        const char* lonPath     -- The path of the longitude dataset in the output file
+        const double* lat       -- The latitudes, numRows by rowElems
+        const double* lon       -- The longitudes, numRows by rowElems
+        hsize_t numRows         -- The size of the slowest dimension
+        hsize_t rowElems        -- The number of points per row
+        hsize_t unitRows        -- The rows per box, or SPATIAL_UNIT_ALL for one box
+    EFFECTS:
+        Writes the index table to ctx->outputFile.
     RETURN:
-        Returns the identifier of the dimension upon success.
-        Else, it returns FAIL.
-
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
 
-hid_t MOPITTaddDimension ( hid_t h5dimGroupID, const char* dimName, hsize_t dimSize, const void* scaleBuffer, hid_t dimScaleNumType )
+herr_t indexGeolocationBuffer( const BFcontext_t* ctx, const char* instrument, const char* latPath, const char* lonPath, const double* lat,
+                               const double* lon, hsize_t numRows, hsize_t rowElems, hsize_t unitRows )
 {
-    hid_t dsetID = 0;
-    herr_t status = 0;
+    spatialBox_t* boxes = NULL;
+    size_t numBoxes = 0;
+    size_t boxesSize = 0;
+    geoExtent_t total;
+    herr_t status = RET_SUCCESS;
 
-    dsetID = insertDataset ( &outputFile, &h5dimGroupID, 1, 1, &dimSize, dimScaleNumType, dimName, scaleBuffer);
-    if ( dsetID == FATAL_ERR )
-    {
-        dsetID = 0;
-        FATAL_MSG("Failed to insert dataset.\n");
-        return FAIL;
-    }
+    if ( !ctx->spatialIndex )
+        return RET_SUCCESS;
 
-    status = H5DSset_scale( dsetID, dimName );
-    if ( status < 0 )
+    if ( unitRows == SPATIAL_UNIT_ALL || unitRows > numRows )
+        unitRows = numRows;
+
+    initGeoExtent( &total );
+    for ( hsize_t unitStart = 0; unitStart < numRows && status != FATAL_ERR; unitStart += unitRows )
     {
-        FATAL_MSG("Failed to set dataset as a dimension scale.\n");
-        return FAIL;
+        hsize_t unitEnd = min( unitStart + unitRows, numRows );
+        geoExtent_t ext;
+
+        initGeoExtent( &ext );
+        for ( hsize_t i = unitStart * rowElems; i < unitEnd * rowElems; i++ )
+        {
+            addGeoPoint( &ext, lat[i], lon[i] );
+            addGeoPoint( &total, lat[i], lon[i] );
+        }
+        status = appendSpatialBox( &boxes, &numBoxes, &boxesSize, &ext, unitStart, unitEnd - unitStart );
     }
 
-    return dsetID;
+    if ( status != FATAL_ERR )
+        status = writeSpatialIndexTable( ctx, instrument, latPath, lonPath, boxes, numBoxes, &total );
 
+    free(boxes);
+    return status;
 }
 
-/*
-        initializeTimeOffset
+/* Helpers for collocateInstruments */
 
-    DESCRIPTION:
-        Initializes the array for TAI93 to UTC conversion. This array contains double precision values
-        (which are actually all integer values) that denote the number of seconds to offset a TAI93 value to
-        UTC time. The index of the array represents days since Jan 1 1993 00:00:00.
+#ifndef M_PI
+#    define M_PI 3.14159265358979323846
+#endif
+#define KM_PER_DEGREE 111.195
+#define EARTH_RADIUS_KM 6371.0
 
-        This function must be periodically updated to contain new leap second information as it arrives, otherwise
-        the array may not be able to account for all TAI93 times.
+/* A point of a source instrument: a CERES footprint or a MISR geolocation point. The key orders the points
+ * by latitude band, then by longitude cell.
+ */
+typedef struct
+{
+    uint64_t key;
+    float lat;
+    float lon;
+    float cosLat;
+    uint32_t unit;              // The footprint or block of the point
+} collocPoint_t;
+
+/* The points of a source geolocation dataset, bucketed into latitude bands and longitude cells as wide as the
+ * search radius. The points near a pixel are then found with binary searches in three bands.
+ */
+typedef struct
+{
+    double radiusKm;
+    double cellDeg;
+    uint32_t numBands;
+    uint32_t numCells;          // Longitude cells per band
+    size_t* bandStart;          // numBands+1 offsets into points
+    collocPoint_t* points;
+    size_t numPoints;
+    uint32_t numUnits;
+    int nearestOnly;            // Match the nearest point only (MISR blocks)
+} collocGrid_t;
+
+/* The runs of pixels matched to each unit of a source, in the order they were found */
+typedef struct
+{
+    collocRun_t* runs;
+    uint32_t* runUnit;
+    size_t numRuns;
+    size_t size;
+    size_t* lastRun;            // Per unit, the run that can still grow, or SIZE_MAX
+    uint32_t numUnits;
+} collocRuns_t;
+
+static int compareCollocPoints( const void* a, const void* b )
+{
+    uint64_t keyA = ((const collocPoint_t*) a)->key;
+    uint64_t keyB = ((const collocPoint_t*) b)->key;
 
-        UTC time is an offset version of Atomic Time. The amount of offset from TAI is periodically incremented or decremented
-        depending on the amount of fluctuation in the Earth's orbit and rotation so that the times remain roughly congruent
-        with solar time. These offsets are not applied according to a formula, but rather by the current astronomical conditions.
-        Therefore it is impossible to predict future offset values -- this function is only valid for previous dates and
-        DOES NOT ACCOUNT FOR FUTURE OFFSETS. This implies that this function must be periodically updated to contain the new
-        offset information.
+    return keyA < keyB ? -1 : keyA > keyB;
+}
 
-        TAI93 time is defined to be equal to 0 on Jan 1, 1993 00:00:00.
+static uint32_t collocBand( const collocGrid_t* grid, double lat )
+{
+    uint32_t band = (uint32_t) ( ( lat + 90.0 ) / grid->cellDeg );
 
-        Directions to update this function:
-            To add additional offsets to the TAI93toUTCoffset, one needs to inquire the exact dates the offsets were added.
-            Convert these dates to "days since epoch" (epoch being Jan 1, 1993), being careful to account for leap years.
-            You can use the fact that at the end of June 30th 2017, 8946 full days have passed since epoch. Then:
+    return band < grid->numBands ? band : grid->numBands - 1;
+}
 
-            1. Update NUM_DAYS to be equal to the number of days since epoch since the last known offset was added.
-            2. Add the additional necessary for loops to initialize the TAI93toUTCoffset with the RUNNING TOTAL offset
+static uint32_t collocCell( const collocGrid_t* grid, double lon )
+{
+    uint32_t cell = (uint32_t) ( ( lon + 180.0 ) / grid->cellDeg );
 
-            Note that offsets are applied either at the end of June 30th and/or December 31st. i.e. The offsets are applied
-            not during the month of June or December, but AT THE END.
+    return cell < grid->numCells ? cell : grid->numCells - 1;
+}
 
-    ARGUMENTS:
-        None
+static void freeCollocGrid( collocGrid_t* grid )
+{
+    free(grid->bandStart);
+    free(grid->points);
+    grid->bandStart = NULL;
+    grid->points = NULL;
+    grid->numPoints = 0;
+}
 
+/*
+                    buildCollocGrid
+    DESCRIPTION:
+        This function reads a source geolocation dataset pair of the output file into a collocation grid.
+        A unit is either one point (a CERES footprint) or the first dimension (a MISR block). Points with
+        invalid geolocation are left out.
+    ARGUMENTS:
+        1. fileID      -- The output file
+        2. latPath     -- The path of the latitude dataset
+        3. lonPath     -- The path of the longitude dataset
+        4. perBlock    -- Non-zero if a unit is a slice of the first dimension
+        5. radiusKm    -- The search radius
+        6. nearestOnly -- Match the nearest point only
+        7. grid        -- The grid to fill
     EFFECTS:
-        Updates the global variable TAI93toUTCoffset to point to the allocated memory on the heap containing the proper
-        offset values.
+        Allocates the grid. Free it with freeCollocGrid, also on failure.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
 
-        IT IS THE DUTY OF THE CALLER to free the TAI93toUTCoffset array when the offset values are no longer needed.
-        The caller must also set TAI93toUTCoffset to NULL once freed to prevent main.c from erroneously freeing it
-        again.
+static herr_t buildCollocGrid( hid_t fileID, const char* latPath, const char* lonPath, int perBlock, double radiusKm,
+                               int nearestOnly, collocGrid_t* grid )
+{
+    hid_t latID = -1;
+    hid_t lonID = -1;
+    hid_t latSpace = -1;
+    hid_t lonSpace = -1;
+    hid_t memSpace = -1;
+    hsize_t latDims[DIM_MAX];
+    hsize_t lonDims[DIM_MAX];
+    hsize_t rowElems = 1;
+    hsize_t numElems = 0;
+    hsize_t batchRows = 0;
+    double* lat = NULL;
+    double* lon = NULL;
+    int rank = 0;
+    int fail = 0;
 
-    RETURN:
-        FATAL_ERR
-        RET_SUCCESS
+    memset( grid, 0, sizeof *grid );
+    grid->radiusKm = radiusKm;
+    grid->cellDeg = radiusKm / KM_PER_DEGREE;
+    grid->numBands = (uint32_t) ceil( 180.0 / grid->cellDeg );
+    grid->numCells = (uint32_t) ceil( 360.0 / grid->cellDeg );
+    grid->nearestOnly = nearestOnly;
 
-*/
+    latID = H5Dopen2( fileID, latPath, H5P_DEFAULT );
+    lonID = H5Dopen2( fileID, lonPath, H5P_DEFAULT );
+    if ( latID < 0 || lonID < 0 )
+    {
+        FATAL_MSG("Failed to open the geolocation datasets %s and %s.\n", latPath, lonPath);
+        goto cleanupFail;
+    }
+    latSpace = H5Dget_space( latID );
+    lonSpace = H5Dget_space( lonID );
+    rank = H5Sget_simple_extent_ndims( latSpace );
+    if ( rank < 1 || rank > DIM_MAX || H5Sget_simple_extent_ndims( lonSpace ) != rank ||
+         H5Sget_simple_extent_dims( latSpace, latDims, NULL ) < 0 ||
+         H5Sget_simple_extent_dims( lonSpace, lonDims, NULL ) < 0 ||
+         memcmp( latDims, lonDims, rank * sizeof(hsize_t) ) != 0 )
+    {
+        FATAL_MSG("%s and %s differ in shape.\n", latPath, lonPath);
+        goto cleanupFail;
+    }
+    for ( int i = 1; i < rank; i++ )
+        rowElems *= latDims[i];
+    numElems = latDims[0] * rowElems;
+    if ( numElems >= UINT32_MAX )
+    {
+        FATAL_MSG("%s has too many points to be collocated.\n", latPath);
+        goto cleanupFail;
+    }
+    grid->numUnits = (uint32_t) ( perBlock ? latDims[0] : numElems );
 
-double* TAI93toUTCoffset = NULL;
-#define NUM_DAYS 8946
+    grid->bandStart = calloc( grid->numBands + 1, sizeof *grid->bandStart );
+    grid->points = malloc( numElems * sizeof *grid->points );
+    batchRows = ( 1 << 20 ) / rowElems;
+    if ( batchRows < 1 ) batchRows = 1;
+    lat = malloc( batchRows * rowElems * sizeof *lat );
+    lon = malloc( batchRows * rowElems * sizeof *lon );
+    if ( grid->bandStart == NULL || ( numElems && grid->points == NULL ) || lat == NULL || lon == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
 
-herr_t initializeTimeOffset()
-{
-    if ( TAI93toUTCoffset != NULL )
+    for ( hsize_t row = 0; row < latDims[0]; row += batchRows )
     {
-        FATAL_MSG("Failed to allocate memory for time TAI93-UTC offset array.\n\tEither the array already points to valid memory or the\n\tarray was freed and not set back to NULL.\n");
+        hsize_t start[DIM_MAX] = {0};
+        hsize_t count[DIM_MAX];
+        hsize_t numPoints = 0;
+
+        memcpy( count, latDims, rank * sizeof(hsize_t) );
+        start[0] = row;
+        count[0] = min( batchRows, latDims[0] - row );
+        numPoints = count[0] * rowElems;
+
+        memSpace = H5Screate_simple( 1, &numPoints, NULL );
+        if ( memSpace < 0 ||
+             H5Sselect_hyperslab( latSpace, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ||
+             H5Sselect_hyperslab( lonSpace, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ||
+             H5Dread( latID, H5T_NATIVE_DOUBLE, memSpace, latSpace, H5P_DEFAULT, lat ) < 0 ||
+             H5Dread( lonID, H5T_NATIVE_DOUBLE, memSpace, lonSpace, H5P_DEFAULT, lon ) < 0 )
+        {
+            FATAL_MSG("Failed to read %s and %s.\n", latPath, lonPath);
+            goto cleanupFail;
+        }
+        H5Sclose(memSpace);
+        memSpace = -1;
+
+        for ( hsize_t i = 0; i < numPoints; i++ )
+        {
+            collocPoint_t* point = &grid->points[grid->numPoints];
+            hsize_t elem = row * rowElems + i;
+            double tempLon = lon[i];
+            uint32_t band = 0;
+
+            if ( lat[i] < -90.0 || lat[i] > 90.0 || !normalizeLon( &tempLon ) )
+                continue;
+            band = collocBand( grid, lat[i] );
+            point->key = (uint64_t) band * grid->numCells + collocCell( grid, tempLon );
+            point->lat = (float) lat[i];
+            point->lon = (float) tempLon;
+            point->cosLat = (float) cos( lat[i] * M_PI / 180.0 );
+            point->unit = (uint32_t) ( perBlock ? elem / rowElems : elem );
+            grid->bandStart[band + 1]++;
+            grid->numPoints++;
+        }
     }
 
-    TAI93toUTCoffset = malloc(sizeof(double) * NUM_DAYS) ;
-    if ( TAI93toUTCoffset == NULL )
+    qsort( grid->points, grid->numPoints, sizeof *grid->points, compareCollocPoints );
+    for ( uint32_t band = 0; band < grid->numBands; band++ )
+        grid->bandStart[band + 1] += grid->bandStart[band];
+
+    if ( 0 )
     {
-        FATAL_MSG("Failed to allocate memory for time offset array.\n");
-        return FATAL_ERR;
+cleanupFail:
+        fail = 1;
     }
 
-    /* Initialize the offset Array */
-    for ( int i = 0; i <= 181; i++ )            // Jan 1993 -> June 1993
-        TAI93toUTCoffset[i] = 0.0;
-    for ( int i = 182; i <= 546; i++ )          // July 1993 -> June 1994
-        TAI93toUTCoffset[i] = -1.0;
-    for ( int i = 547; i <= 1095; i++ )         // July 1994 -> Dec 1995
-        TAI93toUTCoffset[i] = -2.0;
-    for ( int i = 1096; i <= 1642; i++ )        // Jan 1996 -> June 1997
-        TAI93toUTCoffset[i] = -3.0;
-    for ( int i = 1643; i <= 2191; i++ )        // July 1997 -> Dec 1998
-        TAI93toUTCoffset[i] = -4.0;
-    for ( int i = 2192; i <= 4748; i++ )        // Jan 1999 -> Dec 2005
-        TAI93toUTCoffset[i] = -5.0;
-    for ( int i = 4749; i <= 5845; i++ )        // Jan 2006 -> Dec 2008
-        TAI93toUTCoffset[i] = -6.0;
-    for ( int i = 5846; i <= 7210; i++ )        // Jan 2009 -> June 2012
-        TAI93toUTCoffset[i] = -7.0;
-    for ( int i = 7211; i <= 8215; i++ )        // July 2012 -> June 2015
-        TAI93toUTCoffset[i] = -8.0;
-    for ( int i = 8216; i <= 8767; i++ )        // July 2015 -> Dec 2016
-        TAI93toUTCoffset[i] = -9.0;
-    for ( int i = 8768; i < NUM_DAYS; i++ )    // Jan 2017 -> June 2017
-        TAI93toUTCoffset[i] = -10.0;                  // Currently, value not known past June 30th 2017
+    if ( memSpace >= 0 ) H5Sclose(memSpace);
+    if ( latSpace >= 0 ) H5Sclose(latSpace);
+    if ( lonSpace >= 0 ) H5Sclose(lonSpace);
+    if ( latID >= 0 ) H5Dclose(latID);
+    if ( lonID >= 0 ) H5Dclose(lonID);
+    free(lat);
+    free(lon);
 
+    if ( fail )
+        return FATAL_ERR;
     return RET_SUCCESS;
 }
 
 /*
-            TAItoUTCconvert
-
+                    queryCollocGrid
     DESCRIPTION:
-        This function converts an array with TAI93 times (International Atomic Time - 1993) to UTC (Universal Coordinated Time).
-        A single dimensional array of double values must be passed to the function along with the number of elements in the array.
-        The function will modify the array to contain the converted UTC times.
-
-
+        This function finds the units of a collocation grid with a point within the search radius of a
+        pixel. Distances are great-circle distances on a sphere. With nearestOnly, only the unit of the
+        nearest point is returned.
+    ARGUMENTS:
+        1. grid  -- The collocation grid
+        2. lat   -- The latitude of the pixel
+        3. lon   -- The longitude of the pixel, normalized to [-180,180)
+        4. units -- Receives at most COLLOCATE_MAX_HITS units
     EFFECTS:
-        Modifies array passed to it with the converted UTC values. Temporarily allocates offset array on heap, frees before
-        return.
-
-    INPUTS:
-        IN
-            unsigned int size       -- Number of elements in buffer.
-        IN/OUT
-            double* buffer          -- One dimensional array containing the TAI93 values (units given in seconds)
-
+        Fills units.
     RETURN:
-        Returns FAIL upon failure. Otherwise, SUCCEED.
-
+        The number of units found, which may exceed COLLOCATE_MAX_HITS
 */
 
-
-herr_t TAItoUTCconvert ( double* buffer, unsigned int size )
+static int queryCollocGrid( const collocGrid_t* grid, double lat, double lon, uint32_t* units )
 {
-    /* this function assumes that buffer is one dimensional */
-    herr_t status = 0;
+    const double radiusDeg = grid->radiusKm / KM_PER_DEGREE;
+    const double sinHalf = sin( grid->radiusKm / ( 2.0 * EARTH_RADIUS_KM ) );
+    const double maxHav = sinHalf * sinHalf;
+    const double cosLat = cos( lat * M_PI / 180.0 );
+    const uint32_t band = collocBand( grid, lat );
+    const int64_t cell = collocCell( grid, lon );
+    double nearestHav = 2.0;
+    double edgeCos = cos( min( 90.0, fabs(lat) + radiusDeg ) * M_PI / 180.0 );
+    int64_t span = grid->numCells;
+    int numHits = 0;
+
+    /* The longitude cells that can hold points within the radius widen towards the poles */
+    if ( edgeCos > 1e-6 )
+        span = (int64_t) ceil( radiusDeg / ( edgeCos * grid->cellDeg ) );
+
+    for ( uint32_t b = band > 0 ? band - 1 : 0; b <= band + 1 && b < grid->numBands; b++ )
+    {
+        int64_t ranges[2][2];
+        int numRanges = 1;
+
+        if ( 2 * span + 1 >= grid->numCells )
+        {
+            ranges[0][0] = 0;
+            ranges[0][1] = grid->numCells - 1;
+        }
+        else if ( cell - span < 0 )
+        {
+            ranges[0][0] = 0;
+            ranges[0][1] = cell + span;
+            ranges[1][0] = cell - span + grid->numCells;
+            ranges[1][1] = grid->numCells - 1;
+            numRanges = 2;
+        }
+        else if ( cell + span >= grid->numCells )
+        {
+            ranges[0][0] = cell - span;
+            ranges[0][1] = grid->numCells - 1;
+            ranges[1][0] = 0;
+            ranges[1][1] = cell + span - grid->numCells;
+            numRanges = 2;
+        }
+        else
+        {
+            ranges[0][0] = cell - span;
+            ranges[0][1] = cell + span;
+        }
 
-    if ( buffer == NULL )
-    {
-        FATAL_MSG("Argument cannot be NULL.\n");
-        return FAIL;
-    }
+        for ( int r = 0; r < numRanges; r++ )
+        {
+            uint64_t firstKey = (uint64_t) b * grid->numCells + ranges[r][0];
+            uint64_t lastKey = (uint64_t) b * grid->numCells + ranges[r][1];
+            size_t lo = grid->bandStart[b];
+            size_t hi = grid->bandStart[b + 1];
 
-    if ( TAI93toUTCoffset == NULL )
-        status = initializeTimeOffset();
+            /* The first point of the band at or after the first cell */
+            while ( lo < hi )
+            {
+                size_t mid = lo + ( hi - lo ) / 2;
+                if ( grid->points[mid].key < firstKey )
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
 
-    if ( status == FATAL_ERR )
-    {
-        FATAL_MSG("Failed to initialize TAI to UTC time offset.\n");
-        return FAIL;
+            for ( size_t i = lo; i < grid->bandStart[b + 1] && grid->points[i].key <= lastKey; i++ )
+            {
+                const collocPoint_t* point = &grid->points[i];
+                double sinLat = sin( ( point->lat - lat ) * M_PI / 360.0 );
+                double sinLon = sin( ( point->lon - lon ) * M_PI / 360.0 );
+                double hav = sinLat * sinLat + cosLat * point->cosLat * sinLon * sinLon;
+                int known = 0;
+
+                if ( hav > maxHav )
+                    continue;
+                if ( grid->nearestOnly )
+                {
+                    if ( hav < nearestHav )
+                    {
+                        nearestHav = hav;
+                        units[0] = point->unit;
+                        numHits = 1;
+                    }
+                    continue;
+                }
+                for ( int h = 0; h < numHits && h < COLLOCATE_MAX_HITS && !known; h++ )
+                    known = ( units[h] == point->unit );
+                if ( known )
+                    continue;
+                if ( numHits < COLLOCATE_MAX_HITS )
+                    units[numHits] = point->unit;
+                numHits++;
+            }
+        }
     }
 
-    int daysSinceEpoch = 0;
+    return numHits;
+}
 
-    for ( int i = 0; i < size; i++ )
-    {
-        /* Divide buffer value by 86400 (number of seconds in day) to get a floating point
-           number for the day, then truncate this value to get daysSinceEpoch.
-        */
+/* Add a pixel to the runs of a unit, growing its last run if the pixel follows it */
+static herr_t addCollocHit( collocRuns_t* list, uint32_t unit, uint32_t target, uint32_t element )
+{
+    size_t last = list->lastRun[unit];
 
-        daysSinceEpoch = (int) ( buffer[i] / 86400.0 );                 // Casting to int will truncate the float (acts as the floor function)
+    if ( last != SIZE_MAX && list->runs[last].target == target &&
+         list->runs[last].start + list->runs[last].count == element )
+    {
+        list->runs[last].count++;
+        return RET_SUCCESS;
+    }
 
-        if ( daysSinceEpoch < NUM_DAYS && daysSinceEpoch >= 0 )
-        {
-            buffer[i] += TAI93toUTCoffset[daysSinceEpoch];
-        }
-        else if ( daysSinceEpoch >= NUM_DAYS )                           // Currently, value not known past June 30th 2017
-        {
-            FATAL_MSG("MOPITT time values converted\n\tusing out of date UTC-TAI93 offset.\n\tConverted time values may be incorrect!\n\tPlease update the offset array in the function \"initializeTimeOffset()\".\n" );
-            free(TAI93toUTCoffset);
-            TAI93toUTCoffset = NULL;
-            return FAIL;
+    if ( list->numRuns == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 4096;
+        collocRun_t* tempRuns = realloc( list->runs, newSize * sizeof *list->runs );
+        uint32_t* tempUnits = NULL;
 
-        }
-        else                        // something bad happened
+        if ( tempRuns )
+            list->runs = tempRuns;
+        tempUnits = tempRuns ? realloc( list->runUnit, newSize * sizeof *list->runUnit ) : NULL;
+        if ( tempUnits == NULL )
         {
-            FATAL_MSG("Failed to convert MOPITT time values to UTC.\n");
-            free(TAI93toUTCoffset);
-            TAI93toUTCoffset = NULL;
-            return FAIL;
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FATAL_ERR;
         }
+        list->runUnit = tempUnits;
+        list->size = newSize;
     }
 
-    return SUCCEED;
+    list->runs[list->numRuns].target = target;
+    list->runs[list->numRuns].start = element;
+    list->runs[list->numRuns].count = 1;
+    list->runUnit[list->numRuns] = unit;
+    list->lastRun[unit] = list->numRuns++;
+
+    return RET_SUCCESS;
 }
 
 /*
-        H5allocateMemDouble
-
+                    collocateTarget
     DESCRIPTION:
-        This function allocates enough memory to store the dataset give by datasetPath.
-
+        This function matches the pixels of one target geolocation dataset pair of the output file against a
+        collocation grid and adds them to the runs of the units they fall in. The pixels are read in batches
+        and each batch is matched on OpenMP threads when the library is built with OpenMP.
     ARGUMENTS:
-        IN
-            hid_t inputFile   -- The HDF5 input group/file identifier
-            char* datasetPath -- The path of the dataset relative to inputFile
-        OUT
-            void** buffer     -- The buffer in which the data will be stored. Does not need to be pre-allocated.
-            long int* size    -- Returns the number of elements in the allocated array. Can be set to NULL if don't care.
-
+        1. fileID    -- The output file
+        2. grid      -- The collocation grid of the source
+        3. target    -- The index of the target
+        4. latPath   -- The path of the latitude dataset
+        5. lonPath   -- The path of the longitude dataset
+        6. list      -- The runs to add to
+        7. numCapped -- Incremented for every pixel with more than COLLOCATE_MAX_HITS units
     EFFECTS:
-        Sets the caller's buffer pointer (of the appropriate pointer type) to point to the allocated memory
-        on the heap.
-
-        IT IS THE DUTY OF THE CALLER to release buffer to avoid memory leaks.
-
+        Grows the runs.
     RETURN:
-        FATAL_ERR
-        RET_SUCCESS
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
 
-herr_t H5allocateMemDouble ( hid_t inputFile, const char* datasetPath, void** buffer, long int* size )
+static herr_t collocateTarget( hid_t fileID, const collocGrid_t* grid, uint32_t target, const char* latPath,
+                               const char* lonPath, collocRuns_t* list, size_t* numCapped )
 {
-    if ( datasetPath == NULL || buffer == NULL )
-    {
-        FATAL_MSG("Invalid arguments passed to function. Pointers cannot be NULL.\n");
-        return FAIL;
-    }
-    hid_t dataset = 0;
-    hid_t dataspace = 0;
-
-    herr_t statusn;
-    unsigned short fail = 0;
-    hsize_t * datasetDims = NULL;
+    hid_t latID = -1;
+    hid_t lonID = -1;
+    hid_t latSpace = -1;
+    hid_t lonSpace = -1;
+    hid_t memSpace = -1;
+    hsize_t latDims[DIM_MAX];
+    hsize_t lonDims[DIM_MAX];
+    hsize_t rowElems = 1;
+    hsize_t batchRows = 0;
+    double* lat = NULL;
+    double* lon = NULL;
+    uint32_t* hits = NULL;
+    int* numHits = NULL;
     int rank = 0;
+    int fail = 0;
 
-
-    dataset = H5Dopen2( inputFile, datasetPath, H5F_ACC_RDONLY );
-    if ( dataset < 0 )
+    latID = H5Dopen2( fileID, latPath, H5P_DEFAULT );
+    lonID = H5Dopen2( fileID, lonPath, H5P_DEFAULT );
+    if ( latID < 0 || lonID < 0 )
     {
-        FATAL_MSG("Failed to read HDF5 dataset.\n");
-        dataset = 0;
+        FATAL_MSG("Failed to open the geolocation datasets %s and %s.\n", latPath, lonPath);
         goto cleanupFail;
     }
-
-    dataspace = H5Dget_space(dataset);
-    if ( dataspace < 0 )
+    latSpace = H5Dget_space( latID );
+    lonSpace = H5Dget_space( lonID );
+    rank = H5Sget_simple_extent_ndims( latSpace );
+    if ( rank < 1 || rank > DIM_MAX || H5Sget_simple_extent_ndims( lonSpace ) != rank ||
+         H5Sget_simple_extent_dims( latSpace, latDims, NULL ) < 0 ||
+         H5Sget_simple_extent_dims( lonSpace, lonDims, NULL ) < 0 ||
+         memcmp( latDims, lonDims, rank * sizeof(hsize_t) ) != 0 )
     {
-        dataspace = 0;
-        FATAL_MSG("Failed to get dataspace.\n");
+        FATAL_MSG("%s and %s differ in shape.\n", latPath, lonPath);
         goto cleanupFail;
     }
-
-    rank = H5Sget_simple_extent_ndims(dataspace);
-    if ( rank < 0 )
+    for ( int i = 1; i < rank; i++ )
+        rowElems *= latDims[i];
+    if ( latDims[0] * rowElems >= UINT32_MAX )
     {
-        FATAL_MSG("Failed to get rank of dataset.\n");
+        FATAL_MSG("%s has too many pixels to be collocated.\n", latPath);
         goto cleanupFail;
     }
 
-    datasetDims = malloc( sizeof(hsize_t) * DIM_MAX );
-    if ( datasetDims == NULL )
+    /* A quarter of a million pixels at a time */
+    batchRows = ( 1 << 18 ) / rowElems;
+    if ( batchRows < 1 ) batchRows = 1;
+    lat = malloc( batchRows * rowElems * sizeof *lat );
+    lon = malloc( batchRows * rowElems * sizeof *lon );
+    hits = malloc( batchRows * rowElems * COLLOCATE_MAX_HITS * sizeof *hits );
+    numHits = malloc( batchRows * rowElems * sizeof *numHits );
+    if ( lat == NULL || lon == NULL || hits == NULL || numHits == NULL )
     {
-        FATAL_MSG("Malloc failed to allocate memory.\n");
+        FATAL_MSG("Failed to allocate memory.\n");
         goto cleanupFail;
     }
 
-    for ( int i = 0; i < DIM_MAX; i++ )
-        datasetDims[i] = 0;
-
-    statusn = H5Sget_simple_extent_dims(dataspace, datasetDims, NULL);
-    if ( statusn < 0 )
+    for ( hsize_t row = 0; row < latDims[0]; row += batchRows )
     {
-        FATAL_MSG("Unable to get dimension size.\n");
-        goto cleanupFail;
-    }
+        hsize_t start[DIM_MAX] = {0};
+        hsize_t count[DIM_MAX];
+        hsize_t numPoints = 0;
+        uint32_t first = (uint32_t) ( row * rowElems );
 
-    unsigned long long numElems = 0;
+        memcpy( count, latDims, rank * sizeof(hsize_t) );
+        start[0] = row;
+        count[0] = min( batchRows, latDims[0] - row );
+        numPoints = count[0] * rowElems;
 
-    for ( int i = 0; i < DIM_MAX; i++ )
-        numElems += datasetDims[i];
+        memSpace = H5Screate_simple( 1, &numPoints, NULL );
+        if ( memSpace < 0 ||
+             H5Sselect_hyperslab( latSpace, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ||
+             H5Sselect_hyperslab( lonSpace, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ||
+             H5Dread( latID, H5T_NATIVE_DOUBLE, memSpace, latSpace, H5P_DEFAULT, lat ) < 0 ||
+             H5Dread( lonID, H5T_NATIVE_DOUBLE, memSpace, lonSpace, H5P_DEFAULT, lon ) < 0 )
+        {
+            FATAL_MSG("Failed to read %s and %s.\n", latPath, lonPath);
+            goto cleanupFail;
+        }
+        H5Sclose(memSpace);
+        memSpace = -1;
 
-    *buffer = malloc( sizeof(double) * numElems );
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+        for ( long i = 0; i < (long) numPoints; i++ )
+        {
+            double tempLon = lon[i];
 
-    if ( size ) *size = numElems;
+            numHits[i] = 0;
+            if ( lat[i] >= -90.0 && lat[i] <= 90.0 && normalizeLon( &tempLon ) )
+                numHits[i] = queryCollocGrid( grid, lat[i], tempLon, hits + i * COLLOCATE_MAX_HITS );
+        }
+
+        /* Pixels are added in element order, so the runs of every unit come out sorted */
+        for ( hsize_t i = 0; i < numPoints; i++ )
+        {
+            if ( numHits[i] > COLLOCATE_MAX_HITS )
+            {
+                (*numCapped)++;
+                numHits[i] = COLLOCATE_MAX_HITS;
+            }
+            for ( int h = 0; h < numHits[i]; h++ )
+                if ( addCollocHit( list, hits[i * COLLOCATE_MAX_HITS + h], target, first + (uint32_t) i ) == FATAL_ERR )
+                    goto cleanupFail;
+        }
+    }
 
     if ( 0 )
     {
@@ -5177,1272 +11832,1863 @@ cleanupFail:
         fail = 1;
     }
 
-    if ( dataset ) H5Dclose(dataset);
-    if ( dataspace ) H5Sclose(dataspace);
-    if ( datasetDims ) free(datasetDims);
-    if ( fail ) return FATAL_ERR;
+    if ( memSpace >= 0 ) H5Sclose(memSpace);
+    if ( latSpace >= 0 ) H5Sclose(latSpace);
+    if ( lonSpace >= 0 ) H5Sclose(lonSpace);
+    if ( latID >= 0 ) H5Dclose(latID);
+    if ( lonID >= 0 ) H5Dclose(lonID);
+    free(lat);
+    free(lon);
+    free(hits);
+    free(numHits);
 
+    if ( fail )
+        return FATAL_ERR;
     return RET_SUCCESS;
 }
 
-/*
-        getTAI93
-
-    DESCRIPTION:
-        This function takes as input the GDateInfo_t struct (as defined in libTERRA.h) which contains date information,
-        and returns the corresponding TAI93 (defined as TAI = 0 on Jan 1 1993 00:00:00) timestamp.
-
-        This function will need to be periodically updated if being used after the year 2035 to contain more running-total
-        leap year information (as shown in the if-else tree).
-
-    ARGUMENTS:
-        IN
-            1. GDateInfo_t date       -- The input date information.
-        OUT
-            2. double* TAI93timestamp -- The corresponding TAI93 time
-
-    EFFECTS:
-        Modifies the memory pointed to by TAI93timestamp
-
-    RETURN:
-        FATAL_ERR
-        RET_SUCCESS
+/* The geolocation datasets of one instrument, as listed in the spatial index */
+typedef struct
+{
+    linkNameList_t names;       // The index tables
+    char** latPaths;
+    char** lonPaths;
+} collocTables_t;
 
-*/
-herr_t getTAI93 ( GDateInfo_t date, double* TAI93timestamp )
+static void freeCollocTables( collocTables_t* tables )
 {
-    if ( date.year < 1993 )
+    for ( size_t i = 0; i < tables->names.num; i++ )
     {
-        FATAL_MSG("Cannot convert to TAI93 with dates before the year 1993.\n");
+        if ( tables->latPaths ) free(tables->latPaths[i]);
+        if ( tables->lonPaths ) free(tables->lonPaths[i]);
+    }
+    free(tables->latPaths);
+    free(tables->lonPaths);
+    tables->latPaths = tables->lonPaths = NULL;
+    freeLinkNames( &tables->names );
+}
+
+/* Read the tables of SPATIAL_INDEX_GROUP/instrument. For ASTER only the geolocation of the subsystems is
+ * kept; the granule geolocation is a coarse grid. An instrument without an index has no tables.
+ */
+static herr_t listCollocTables( hid_t fileID, const char* instrument, collocTables_t* tables )
+{
+    char groupPath[64];
+    hid_t groupID = -1;
+    htri_t exists = 0;
+    size_t numKept = 0;
+    herr_t status = RET_SUCCESS;
+
+    memset( tables, 0, sizeof *tables );
+    snprintf( groupPath, sizeof groupPath, "/%s/%s", SPATIAL_INDEX_GROUP, instrument );
+    exists = H5Lexists( fileID, "/" SPATIAL_INDEX_GROUP, H5P_DEFAULT );
+    if ( exists > 0 )
+        exists = H5Lexists( fileID, groupPath, H5P_DEFAULT );
+    if ( exists <= 0 )
+        return exists < 0 ? FATAL_ERR : RET_SUCCESS;
+
+    groupID = H5Gopen2( fileID, groupPath, H5P_DEFAULT );
+    if ( groupID < 0 || H5Literate( groupID, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames, &tables->names ) < 0 )
+    {
+        FATAL_MSG("Failed to list the spatial index tables of %s.\n", instrument);
+        if ( groupID >= 0 ) H5Gclose(groupID);
         return FATAL_ERR;
     }
-    if ( TAI93timestamp == NULL )
+    H5Gclose(groupID);
+
+    tables->latPaths = calloc( tables->names.num + 1, sizeof(char*) );
+    tables->lonPaths = calloc( tables->names.num + 1, sizeof(char*) );
+    if ( tables->latPaths == NULL || tables->lonPaths == NULL )
     {
-        FATAL_MSG("TAI93timestamp argument cannot be NULL.\n");
+        FATAL_MSG("Failed to allocate memory.\n");
         return FATAL_ERR;
     }
 
-    double TAI93 = 0.0;
-
-    TAI93 += ( date.year-1993 );         // How many full years since 1993, multiplied by number of seconds in a year
-    TAI93 *= 365.0;
-    TAI93 *= 86400.0;
-    // Find how many leap years since 1993
-    /* Note that the current year is not considered in this else if tree whether or not it is a leap year. That is handled downstream */
-    unsigned short numLeapYears = 0;
-    if ( date.year >= 1993 && date.year <= 1995 )
-        numLeapYears = 0;
-    else if ( date.year >= 1996 && date.year <= 2000 )
-        numLeapYears = 1;
-    else if ( date.year >= 2001 && date.year <= 2004 )
-        numLeapYears = 2;
-    else if ( date.year >= 2005 && date.year <= 2008 )
-        numLeapYears = 3;
-    else if ( date.year >= 2009 && date.year <= 2012 )
-        numLeapYears = 4;
-    else if ( date.year >= 2013 && date.year <= 2016 )
-        numLeapYears = 5;
-    else if ( date.year >= 2017 && date.year <= 2020 )
-        numLeapYears = 6;
-    else if ( date.year >= 2021 && date.year <= 2024 )
-        numLeapYears = 7;
-    else if ( date.year >= 2025 && date.year <= 2028 )
-        numLeapYears = 8;
-    else if ( date.year >= 2029 && date.year <= 2032 )
-        numLeapYears = 9;
-    else if ( date.year >= 2033 && date.year <= 2036 )
-        numLeapYears = 10;
-    else
+    for ( size_t i = 0; i < tables->names.num && status != FATAL_ERR; i++ )
     {
-        FATAL_MSG("Failed to find how many leap years since 1993. Maybe this function is\n\tout of date?\n");
-        return FATAL_ERR;
+        char* tablePath = malloc( strlen(groupPath) + strlen(tables->names.names[i]) + 2 );
+        char* latPath = NULL;
+        char* lonPath = NULL;
+
+        if ( tablePath == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            status = FATAL_ERR;
+            break;
+        }
+        sprintf( tablePath, "%s/%s", groupPath, tables->names.names[i] );
+        latPath = getAttrString( fileID, tablePath, "latitude" );
+        lonPath = getAttrString( fileID, tablePath, "longitude" );
+        free(tablePath);
+        if ( latPath == NULL || lonPath == NULL )
+        {
+            FATAL_MSG("The spatial index table %s of %s has no geolocation paths.\n", tables->names.names[i], instrument);
+            status = FATAL_ERR;
+        }
+        else if ( strcmp( instrument, "ASTER" ) != 0 || strstr( latPath, "/VNIR/" ) || strstr( latPath, "/SWIR/" ) ||
+                  strstr( latPath, "/TIR/" ) )
+        {
+            /* Keep the entries in step with the table names */
+            char* name = tables->names.names[i];
+            tables->names.names[i] = tables->names.names[numKept];
+            tables->names.names[numKept] = name;
+            tables->latPaths[numKept] = latPath;
+            tables->lonPaths[numKept] = lonPath;
+            numKept++;
+            continue;
+        }
+        free(latPath);
+        free(lonPath);
     }
 
+    /* The names past numKept are freed by freeLinkNames, the paths past numKept are NULL */
+    for ( size_t i = numKept; i < tables->names.num; i++ )
+        free(tables->names.names[i]);
+    tables->names.num = numKept;
 
-    TAI93 += (double)(numLeapYears * 86400);        // Account for additional days during leap years
+    return status;
+}
 
-    int leapYear = isLeapYear( (int) date.year);
-    if ( leapYear < 0 )
+/*
+                    writeCollocRuns
+    DESCRIPTION:
+        This function writes the runs of one source and target instrument in compressed sparse row form to
+        a new group: "offsets" holds numUnits+1 offsets into "runs", so that the runs of unit u are
+        runs[offsets[u]] to runs[offsets[u+1]-1]. Each run gives the index of the target in "targets" (the
+        latitude paths of the target geolocation) and a range of consecutive elements of its flattened
+        geolocation.
+    ARGUMENTS:
+        1. ctx         -- The conversion context, for the dataset layout
+        2. fileID      -- The output file
+        3. groupPath   -- The path of the group to create
+        4. list        -- The runs
+        5. targetPaths -- The latitude paths of the targets
+        6. numTargets  -- The number of targets
+    EFFECTS:
+        Creates the group, with any missing parent groups, and its datasets.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t writeCollocRuns( const BFcontext_t* ctx, hid_t fileID, const char* groupPath, const collocRuns_t* list, char** targetPaths,
+                               size_t numTargets )
+{
+    uint64_t* offsets = NULL;
+    collocRun_t* sorted = NULL;
+    char* targetBuffer = NULL;
+    size_t targetLen = 1;
+    hid_t lcpl = -1;
+    hid_t groupID = -1;
+    hid_t runType = -1;
+    hid_t stringType = -1;
+    hid_t datasetID = -1;
+    hsize_t dims = 0;
+    short use_chunk = ctx->useChunk;
+    int fail = 0;
+
+    offsets = calloc( (size_t) list->numUnits + 1, sizeof *offsets );
+    sorted = malloc( ( list->numRuns ? list->numRuns : 1 ) * sizeof *sorted );
+    for ( size_t i = 0; i < numTargets; i++ )
+        targetLen = max( targetLen, strlen(targetPaths[i]) + 1 );
+    targetBuffer = calloc( numTargets ? numTargets : 1, targetLen );
+    if ( offsets == NULL || sorted == NULL || targetBuffer == NULL )
     {
-        FATAL_MSG("Failed to determine if it is a leap year.\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
     }
-    // Account for the number of seconds in a month
-    // Note that we increment TAI93 based on how many FULL months have passed.
 
-    const unsigned short month = (unsigned short) date.month;
+    /* Counting sort of the runs by unit. It is stable, so the runs of a unit stay in element order. */
+    for ( size_t i = 0; i < list->numRuns; i++ )
+        offsets[list->runUnit[i] + 1]++;
+    for ( uint32_t u = 0; u < list->numUnits; u++ )
+        offsets[u + 1] += offsets[u];
+    for ( size_t i = 0; i < list->numRuns; i++ )
+        sorted[offsets[list->runUnit[i]]++] = list->runs[i];
+    for ( uint32_t u = list->numUnits; u > 0; u-- )
+        offsets[u] = offsets[u - 1];
+    offsets[0] = 0;
 
-    switch ( month )
+    for ( size_t i = 0; i < numTargets; i++ )
+        strcpy( targetBuffer + i * targetLen, targetPaths[i] );
+
+    lcpl = H5Pcreate( H5P_LINK_CREATE );
+    if ( lcpl < 0 || H5Pset_create_intermediate_group( lcpl, 1 ) < 0 )
     {
-    case 1:              // Current month is Jan
-        TAI93 += 0.0;
-        break;
-    case 2:              // Feb
-        TAI93 += (double) (31 * 86400);
-        break;
-    case 3:             // Current month is March (previous month is Feb which may or may not have leap day)
-        TAI93 += (double)((31+28)*86400);
-        break;
-    case 4:             // April
-        TAI93 += (double) ((31+28+31)*86400);
-        break;
-    case 5:             // May
-        TAI93 += (double) ((31+28+31+30)*86400);
-        break;
-    case 6:             // June
-        TAI93 += (double) ((31+28+31+30+31)*86400);
-        break;
-    case 7:             // July
-        TAI93 += (double) ((31+28+31+30+31+30)*86400);
-        break;
-    case 8:             // Aug
-        TAI93 += (double) ((31+28+31+30+31+30+31)*86400);
-        break;
-    case 9:             // Sept
-        TAI93 += (double) ((31+28+31+30+31+30+31+31)*86400);
-        break;
-    case 10:            // Oct
-        TAI93 += (double) ((31+28+31+30+31+30+31+31+30)*86400);
-        break;
-    case 11:            // Nov
-        TAI93 += (double) ((31+28+31+30+31+30+31+31+30+31)*86400);
-        break;
-    case 12:            // Dec
-        TAI93 += (double) ((31+28+31+30+31+30+31+31+30+31+30)*86400);
-        break;
-    default:
-        FATAL_MSG("Problem occurred trying to convert date to TAI93 time.\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to create the link creation property list.\n");
+        goto cleanupFail;
     }
-
-    // Add extra day if leap year and month is March or after
-    if ( leapYear && month >= 3)
+    groupID = H5Gcreate2( fileID, groupPath, lcpl, H5P_DEFAULT, H5P_DEFAULT );
+    if ( groupID < 0 )
     {
-        TAI93 += 86400.0;
+        FATAL_MSG("Failed to create the group %s.\n", groupPath);
+        goto cleanupFail;
     }
 
-    // Account for the number of FULL days that have passed in this month
-    const short days = (short) date.day - 1;        // date.day is 1-indexed
-    if ( days >= 0 && days <= 31 )
-        TAI93 += (double) ((days) * 86400);          // Number of full days passed multiplied by number of seconds in a day
-    else
+    runType = H5Tcreate( H5T_COMPOUND, sizeof(collocRun_t) );
+    stringType = H5Tcopy( H5T_C_S1 );
+    if ( runType < 0 || stringType < 0 ||
+         H5Tinsert( runType, "target", HOFFSET(collocRun_t, target), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( runType, "start", HOFFSET(collocRun_t, start), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( runType, "count", HOFFSET(collocRun_t, count), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tset_size( stringType, targetLen ) < 0 )
     {
-        FATAL_MSG("Failed to account for the number of days passed in the current month.\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to create the collocation datatypes.\n");
+        goto cleanupFail;
     }
 
-    // Account for the number of FULL hours that have passed in this day
-
-    const short hours = (short) date.hour;          // hour is 0-indexed
-    if ( hours >= 0 && hours <= 23 )
-        TAI93 += (double)(hours * 3600);        // Number of full hours passed multiplied by number of seconds in an hour
+    dims = (hsize_t) list->numUnits + 1;
+    if ( use_chunk )
+        datasetID = insertDataset_comp_shuffle( ctx, &groupID, 0, 1, &dims, H5T_NATIVE_UINT64, "offsets", offsets, 0 );
     else
+        datasetID = insertDataset( ctx, &groupID, 0, 1, &dims, H5T_NATIVE_UINT64, "offsets", offsets );
+    if ( datasetID == FATAL_ERR )
     {
-        FATAL_MSG("Failed to acount for the number of hours passed in a day.\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to write the offsets of %s.\n", groupPath);
+        goto cleanupFail;
     }
 
-    // Account for the number of FULL minutes that have passed in this hour
-    const short minutes = (short) date.minute;      // Minutes are 0-indexed
-    if ( minutes >= 0 && minutes <= 60 )            // From 0 to 60 because leap seconds may make minute indicator show 60
-        TAI93 += (double)(minutes * 60);
+    dims = list->numRuns;
+    if ( use_chunk && dims > 0 )
+        datasetID = insertDataset_comp_shuffle( ctx, &groupID, 0, 1, &dims, runType, "runs", sorted, 0 );
     else
+        datasetID = insertDataset( ctx, &groupID, 0, 1, &dims, runType, "runs", sorted );
+    if ( datasetID == FATAL_ERR )
     {
-        FATAL_MSG("Failed to account for number of minutes passed.\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to write the runs of %s.\n", groupPath);
+        goto cleanupFail;
     }
 
-    // Finally, increment the seconds
-    TAI93 += date.second;
-
-
-    *TAI93timestamp = TAI93;
-
-    return RET_SUCCESS;
-}
-
-/*
- * isLeapyear
- * DESCRIPTION:
- *      Determins if the given year is a leap year.
- * ARGUMENTS:
- *      IN
- *      int year
- * RETURN:
- *      -1 upon failure
- *      0 if not a leap year.
- *      1 if it is a leap year.
- */
-int isLeapYear( int year )
-{
-    if ( year < 0 )
+    dims = numTargets;
+    datasetID = insertDataset( ctx, &groupID, 0, 1, &dims, stringType, "targets", targetBuffer );
+    if ( datasetID == FATAL_ERR )
     {
-        FATAL_MSG("I highly doubt there were satellites flying about before the year 0.\n");
-        return -1;
+        FATAL_MSG("Failed to write the targets of %s.\n", groupPath);
+        goto cleanupFail;
     }
-    int retVal = 0;
 
-    if ( year % 4 == 0 )           // divisible by 4
+    if ( 0 )
     {
-        if ( year % 100 == 0 )     // divisible by 100
-        {
-            if ( year % 400 == 0 )
-                retVal = 1;
-            else                        // not divisible by 400
-                retVal = 0;
-        }
-
-        else                            // not divisible by 100
-            retVal = 1;
+cleanupFail:
+        fail = 1;
     }
-    else                                // not divisible by 4
-        retVal = 0;
 
-    return retVal;
+    if ( stringType >= 0 ) H5Tclose(stringType);
+    if ( runType >= 0 ) H5Tclose(runType);
+    if ( groupID >= 0 ) H5Gclose(groupID);
+    if ( lcpl >= 0 ) H5Pclose(lcpl);
+    free(offsets);
+    free(sorted);
+    free(targetBuffer);
+
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
 }
 
 /*
-        binarySearchDouble
-
+                        collocateInstruments
     DESCRIPTION:
-        This function performs a binary search on a sorted array of double values.
-        If the exact target is not found, the first element that is greater than the target value is returned
-        in the argument targetIndex.
-
+        This function records, for every CERES footprint and every MISR block, which MODIS and ASTER pixels
+        it covers, so that readers do not have to search the geolocation arrays themselves. It runs once all
+        instruments are in the output file and is turned on with BF_COLLOCATE=1.
+
+        The geolocation datasets are taken from the spatial index (see indexGeolocation): the CERES footprints,
+        the MISR low-resolution geolocation, the MODIS 1 km geolocation and the high-resolution geolocation of
+        the ASTER subsystems (which is only written for unpacked radiances). The 250 m and 500 m MODIS pixels
+        map onto the 1 km pixels. The points of each source are bucketed into a grid with cells as wide as
+        the search radius (see buildCollocGrid), and every target pixel is looked up in it. A pixel belongs
+        to all footprints whose center lies within BF_COLLOCATE_CERES_KM (COLLOCATE_CERES_KM by default), and
+        to the block of the nearest MISR point within COLLOCATE_MISR_KM.
+
+        The result goes to COLLOCATION_GROUP/<source>/<index table name>/<target> (see writeCollocRuns). The
+        source group carries the attributes latitude, longitude, unit ("footprint" or "block") and radius_km.
+        An existing COLLOCATION_GROUP is replaced.
     ARGUMENTS:
-        IN
-            1. double* array                   -- The array to perform the search on
-            2. double target                   -- The value to search for
-            3. hsize_t size                    -- The number of elements in array
-            4. short unsigned int firstGreater -- Set to nonzero to return the first element GREATER than target (if exact match not found).
-                                                  Set to 0 to return element BEFORE the first element that is greater than target.
-        OUT
-            5. long int* targetIndex -- The index of where the target value is. If target doesn't exist in the array,
-                                        this will return the first element in array that is larger than target.
-
+        const BFcontext_t* ctx  -- The conversion context
+        hid_t fileID            -- The output file
     EFFECTS:
-        Modifies the memory pointed to by targetIndex to contain the selected index of the array.
-
+        Reads the geolocation and writes COLLOCATION_GROUP.
     RETURN:
-        0 if an exact match is found.
-        1 if an exact match was not found (first element larger than target is returned).
-       -1 if an error occured.
-
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
-herr_t binarySearchDouble ( const double* array, double target, hsize_t size, short unsigned int firstGreater, long int* targetIndex )
+
+herr_t collocateInstruments( const BFcontext_t* ctx, hid_t fileID )
 {
-    long int left = 0;
-    long int right = (long int)(size - 1);
-    long int middle;
+    static const char* sourceNames[2] = { "CERES", "MISR" };
+    static const char* targetNames[2] = { "MODIS", "ASTER" };
+    collocTables_t sources[2];
+    collocTables_t targets[2];
+    collocGrid_t grid;
+    collocRuns_t list;
+    double ceresKm = ctx->collocateCeresKm;
+    char* groupPath = NULL;
+    size_t numCapped = 0;
+    htri_t exists = 0;
+    attrStage_t stage;
+    hid_t sourceGroupID = -1;
+    int fail = 0;
+
+    if ( !ctx->collocate )
+        return RET_SUCCESS;
 
-    while ( left <= right )
+    memset( sources, 0, sizeof sources );
+    memset( targets, 0, sizeof targets );
+    memset( &grid, 0, sizeof grid );
+    memset( &list, 0, sizeof list );
+    initAttrStage( ctx, &stage, -1 );
+
+    exists = H5Lexists( fileID, "/" COLLOCATION_GROUP, H5P_DEFAULT );
+    if ( exists < 0 || ( exists && H5Ldelete( fileID, "/" COLLOCATION_GROUP, H5P_DEFAULT ) < 0 ) )
     {
-        middle = (left + right)/2;
-        if ( array[middle] < target )
+        FATAL_MSG("Failed to replace the %s group.\n", COLLOCATION_GROUP);
+        goto cleanupFail;
+    }
+    if ( H5Lexists( fileID, "/" SPATIAL_INDEX_GROUP, H5P_DEFAULT ) <= 0 )
+    {
+        WARN_MSG("Collocation needs the spatial index (BF_SPATIAL_INDEX). The instruments are not collocated.\n");
+        goto cleanup;
+    }
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        if ( listCollocTables( fileID, sourceNames[i], &sources[i] ) == FATAL_ERR ||
+             listCollocTables( fileID, targetNames[i], &targets[i] ) == FATAL_ERR )
+            goto cleanupFail;
+    }
+
+    for ( int s = 0; s < 2; s++ )
+    {
+        int perBlock = ( s == 1 );
+        double radiusKm = perBlock ? COLLOCATE_MISR_KM : ceresKm;
+
+        for ( size_t i = 0; i < sources[s].names.num; i++ )
         {
-            left = middle+1;
-            /* If the search was unable to find an exact match (case where left > right), set middle to the first index that is greater than target.
-               This is useful information for subsetting. It is possible that middle will be set to the very beginning or to
-               the very end of the array. This is okay, this is also useful information.
-             */
+            const char* tableName = sources[s].names.names[i];
 
-            if ( left > right )
+            if ( buildCollocGrid( fileID, sources[s].latPaths[i], sources[s].lonPaths[i], perBlock, radiusKm,
+                                  perBlock, &grid ) == FATAL_ERR )
+                goto cleanupFail;
+            if ( grid.numPoints == 0 )
             {
-                while ( middle+1 < size && array[middle] < target )
-                    middle++;
+                freeCollocGrid( &grid );
+                continue;
             }
-            continue;
-        }
-
-        if ( array[middle] > target )
-        {
-            right = middle - 1;
-            /* If the search was unable to find an exact match, set middle to the first index that is greater than target.
-               This is useful information for subsetting. It is possible that middle will be set to the very beginning or to
-               the very end of the array. This is okay, this is also useful information.
-             */
 
-            if ( left > right )
+            for ( int t = 0; t < 2; t++ )
             {
-                while ( middle-1 >= 0 && array[middle-1] > target )
-                    middle--;
+                if ( targets[t].names.num == 0 )
+                    continue;
+
+                list.numUnits = grid.numUnits;
+                list.lastRun = malloc( ( grid.numUnits ? grid.numUnits : 1 ) * sizeof *list.lastRun );
+                if ( list.lastRun == NULL )
+                {
+                    FATAL_MSG("Failed to allocate memory.\n");
+                    goto cleanupFail;
+                }
+                for ( uint32_t u = 0; u < grid.numUnits; u++ )
+                    list.lastRun[u] = SIZE_MAX;
+
+                for ( size_t k = 0; k < targets[t].names.num; k++ )
+                    if ( collocateTarget( fileID, &grid, (uint32_t) k, targets[t].latPaths[k], targets[t].lonPaths[k],
+                                          &list, &numCapped ) == FATAL_ERR )
+                        goto cleanupFail;
+
+                groupPath = malloc( strlen(COLLOCATION_GROUP) + strlen(sourceNames[s]) + strlen(tableName) +
+                                    strlen(targetNames[t]) + 5 );
+                if ( groupPath == NULL )
+                {
+                    FATAL_MSG("Failed to allocate memory.\n");
+                    goto cleanupFail;
+                }
+                sprintf( groupPath, "/%s/%s/%s/%s", COLLOCATION_GROUP, sourceNames[s], tableName, targetNames[t] );
+                if ( writeCollocRuns( ctx, fileID, groupPath, &list, targets[t].latPaths, targets[t].names.num ) == FATAL_ERR )
+                    goto cleanupFail;
+
+                /* The source group was created with the target group */
+                *strrchr( groupPath, '/' ) = '\0';
+                if ( H5Aexists_by_name( fileID, groupPath, "unit", H5P_DEFAULT ) == 0 )
+                {
+                    sourceGroupID = H5Gopen2( fileID, groupPath, H5P_DEFAULT );
+                    initAttrStage( ctx, &stage, sourceGroupID );
+                    if ( sourceGroupID < 0 ||
+                         stageAttrString( &stage, "latitude", sources[s].latPaths[i] ) == FATAL_ERR ||
+                         stageAttrString( &stage, "longitude", sources[s].lonPaths[i] ) == FATAL_ERR ||
+                         stageAttrString( &stage, "unit", perBlock ? "block" : "footprint" ) == FATAL_ERR ||
+                         stageAttr( &stage, "radius_km", H5T_NATIVE_DOUBLE, 0, &radiusKm ) == FATAL_ERR ||
+                         flushAttrStage( &stage ) == FATAL_ERR )
+                    {
+                        FATAL_MSG("Failed to write the attributes of %s.\n", groupPath);
+                        goto cleanupFail;
+                    }
+                    H5Gclose(sourceGroupID);
+                    sourceGroupID = -1;
+                }
+                free(groupPath);
+                groupPath = NULL;
+
+                free(list.runs);
+                free(list.runUnit);
+                free(list.lastRun);
+                memset( &list, 0, sizeof list );
             }
-            continue;
-        }
 
-        *targetIndex = middle;
-        return 0;
+            freeCollocGrid( &grid );
+        }
     }
 
-    /* Final error check to make sure that array[middle] either equals target or is greater than target */
-    if ( middle < 0 || middle >= size || (array[middle] < target && middle != size-1))
+    if ( numCapped )
+        WARN_MSG("%zu pixels fall in more than %d CERES footprints. Only %d of them are kept.\n", numCapped,
+                 COLLOCATE_MAX_HITS, COLLOCATE_MAX_HITS);
+
+    if ( 0 )
     {
-        FATAL_MSG("Binary search produced an invalid result. Debug information:\n\ttargetIndex = %ld\n\tsize = %u\n", middle, (unsigned int) size);
-        return -1;
+cleanupFail:
+        fail = 1;
     }
- 
-    // When middle points to the last element of the array,we should not decrease the middle value by 1. 
-    if ( firstGreater == 0 && middle > 0 && middle<(size-1))
-    //if ( firstGreater == 0 && middle > 0 )
+
+cleanup:
+    discardAttrStage( &stage );
+    if ( sourceGroupID >= 0 ) H5Gclose(sourceGroupID);
+    for ( int i = 0; i < 2; i++ )
     {
-        middle--;
+        freeCollocTables( &sources[i] );
+        freeCollocTables( &targets[i] );
     }
+    freeCollocGrid( &grid );
+    free(list.runs);
+    free(list.runUnit);
+    free(list.lastRun);
+    free(groupPath);
 
-    *targetIndex = middle;
-    return 1;
-
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
 }
 
-/*
-            MOPITT_OrbitInfo
+/* Helpers for writeChecksums and writeChecksumManifest */
 
-    DESCRIPTION:
-        This function takes as input the starting and ending times of the orbit (given as OInfo_t struct), the input hid_t
-        HDF5 file/group identifier, the path to the time dataset (relative to inputFile), and gives the starting and ending
-        indices.
+/* The blocks of a dataset that are checksummed separately: the chunks of a chunked dataset, or runs of
+ * whole rows of about CHECKSUM_BLOCK_BYTES. Beyond CHECKSUM_MAX_BLOCKS, blocks are doubled along the
+ * slowest dimensions. Returns the number of blocks.
+ */
+static size_t getChecksumBlock( int rank, const hsize_t* dims, const hsize_t* chunkDims, size_t elemSize,
+                                hsize_t* block )
+{
+    size_t numBlocks = 1;
 
-    ARGUMENTS:
-        IN
-            1. const hid_t inputFile  -- The HDF5 file or group identifier under which the time dataset is stored.
-            2. OInfo_t cur_orbit_info -- A struct containing the start and end dates of the orbit. Defined in libTERRA.h
-            3. const char* timePath   -- The path to the time dataset relative to inputFile
-        OUT
-            4. unsigned int* start_indx_ptr    -- The index to begin subsetting from
-            5. unsigned int* end_indx_ptr      -- The index to end the subsetting at
+    if ( chunkDims )
+        memcpy( block, chunkDims, rank * sizeof(hsize_t) );
+    else if ( rank > 0 )
+    {
+        hsize_t rowBytes = elemSize;
 
-    EFFECTS:
-        Modifies start and end_indx_ptr to contain the appropriate values
+        for ( int i = 1; i < rank; i++ )
+        {
+            block[i] = dims[i];
+            rowBytes *= dims[i];
+        }
+        block[0] = rowBytes >= CHECKSUM_BLOCK_BYTES ? 1 : CHECKSUM_BLOCK_BYTES / rowBytes;
+    }
 
-    RETURN:
-        0 if success.
-        1 if MOPITT file should be skipped (no error, but shouldn't include MOPITT file in output).
-        2 if other failure.
+    for ( int d = 0; ; )
+    {
+        numBlocks = 1;
+        for ( int i = 0; i < rank; i++ )
+        {
+            if ( block[i] > dims[i] ) block[i] = dims[i];
+            if ( block[i] == 0 ) block[i] = 1;
+            numBlocks *= ( dims[i] + block[i] - 1 ) / block[i];
+        }
+        if ( numBlocks <= CHECKSUM_MAX_BLOCKS || d == rank )
+            break;
+        if ( block[d] >= dims[d] )
+            d++;
+        else
+            block[d] *= 2;
+    }
 
-*/
+    return numBlocks;
+}
 
-herr_t MOPITT_OrbitInfo( const hid_t inputFile, OInfo_t cur_orbit_info, const char* timePath, unsigned int* start_indx_ptr,
-                         unsigned int* end_indx_ptr )
+/* The XXH64 of the values of one block of a row-major array, taken in row-major order within the block */
+static uint64_t checksumBlock( const unsigned char* data, int rank, const hsize_t* dims, const hsize_t* start,
+                               const hsize_t* count, size_t elemSize )
 {
-    herr_t retStatus = 0;
-    double* timeData = NULL;
-    long int numElems = 0;
-    herr_t status = 0;
-    hid_t dataset = 0;
-    hid_t dataspace = 0;
-    hid_t groupID = 0;
+    xxh64State_t state;
+    hsize_t stride[H5S_MAX_RANK];
+    hsize_t pos[H5S_MAX_RANK];
+    size_t runBytes = elemSize;
+    int split = rank - 1;
 
-    status = H5allocateMemDouble ( inputFile, timePath, (void**) &timeData, &numElems );
-    if ( status == FAIL )
+    xxh64Init( &state, 0 );
+    if ( rank == 0 )
     {
-        FATAL_MSG("Failed to allocate memory.\n");
-        timeData = NULL;
-        goto cleanupFail;
+        xxh64Update( &state, data, elemSize );
+        return xxh64Digest( &state );
     }
 
+    /* The values of the block are contiguous in the array from dimension split on */
+    while ( split > 0 && count[split] == dims[split] )
+        split--;
+    for ( int i = rank - 1; i >= 0; i-- )
+    {
+        stride[i] = i == rank - 1 ? elemSize : stride[i + 1] * dims[i + 1];
+        if ( i >= split )
+            runBytes *= count[i];
+        pos[i] = 0;
+    }
 
-    status = H5LTread_dataset_double( inputFile, timePath, timeData);
-    if ( status < 0 )
+    for ( ;; )
     {
-        FATAL_MSG("Failed to read dataset.\n");
-        goto cleanupFail;
+        size_t offset = 0;
+        int i;
+
+        for ( i = 0; i < rank; i++ )
+            offset += ( start[i] + pos[i] ) * stride[i];
+        xxh64Update( &state, data + offset, runBytes );
+
+        for ( i = split - 1; i >= 0; i-- )
+        {
+            if ( ++pos[i] < count[i] )
+                break;
+            pos[i] = 0;
+        }
+        if ( i < 0 )
+            break;
     }
 
-    /* We now need to convert the orbit info given by current_orbit_info into TAI93 start time and TAI93 end time.
-       This way, we will know exactly which elements in timeData will be selected for the start and end pointers.
-       We convert to TAI93 because the MOPITT time values are given in TAI93.
-     */
-    GDateInfo_t time;
-    double startTAI93;
-    double endTAI93;
+    return xxh64Digest( &state );
+}
+
+/*
+                        writeChecksums
+    DESCRIPTION:
+        This function stores XXH64 checksums of the values just written to a dataset, so that corrupted
+        files can be found without a second copy (see util/BFChecksum). It is called by insertDataset and
+        its variants with the buffer they wrote, so the values are not read back. It is turned on with
+        BF_CHECKSUM=1.
+
+        The dataset is divided into blocks (see getChecksumBlock): its chunks, or runs of rows of a
+        contiguous dataset. The checksum of a block covers the bytes of its values in the memory type,
+        in row-major order within the block. The checksum of the dataset is the XXH64 of the block
+        checksums, in row-major order of the blocks, as little-endian 64-bit words (see xxh64Words). The
+        blocks are hashed on OpenMP threads.
+
+        The dataset gets the attributes CHECKSUM_ATTR (the dataset checksum), CHECKSUM_BLOCKS_ATTR (the
+        block checksums) and, unless it is scalar, CHECKSUM_BLOCK_DIMS_ATTR. Empty datasets and values
+        holding pointers or references are skipped.
+    ARGUMENTS:
+        const BFcontext_t* ctx   -- The conversion context
+        hid_t datasetID          -- The dataset
+        int rank                 -- The rank of the dataset
+        const hsize_t* dims      -- The dimensions of the dataset
+        hid_t memType            -- The memory type the values were written in
+        const void* data         -- The values of the whole dataset
+        const hsize_t* chunkDims -- The chunk dimensions, NULL for a contiguous dataset
+    EFFECTS:
+        Writes the checksum attributes. Does nothing if BF_CHECKSUM is not set.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t writeChecksums( const BFcontext_t* ctx, hid_t datasetID, int rank, const hsize_t* dims, hid_t memType, const void* data,
+                       const hsize_t* chunkDims )
+{
+    hsize_t block[H5S_MAX_RANK];
+    hsize_t grid[H5S_MAX_RANK];
+    uint64_t blockDims[H5S_MAX_RANK];
+    uint64_t* sums = NULL;
+    uint64_t checksum = 0;
+    size_t elemSize = H5Tget_size( memType );
+    size_t numBlocks = 0;
+    hsize_t numElems = 1;
+    attrStage_t stage;
+    int fail = 0;
+
+    if ( !ctx->checksum )
+        return RET_SUCCESS;
+
+    for ( int i = 0; i < rank; i++ )
+        numElems *= dims[i];
+    if ( numElems == 0 || elemSize == 0 || H5Tis_variable_str( memType ) > 0 ||
+         H5Tdetect_class( memType, H5T_VLEN ) > 0 || H5Tdetect_class( memType, H5T_REFERENCE ) > 0 )
+        return RET_SUCCESS;
 
-    time.year = cur_orbit_info.start_year;
-    time.month = cur_orbit_info.start_month;
-    time.day = cur_orbit_info.start_day;
-    time.hour = cur_orbit_info.start_hour;
-    time.minute = cur_orbit_info.start_minute;
-    time.second = (double) cur_orbit_info.start_second;
+    initAttrStage( ctx, &stage, datasetID );
 
-    status = getTAI93 ( time, &startTAI93 );
-    if ( status == FATAL_ERR )
+    numBlocks = getChecksumBlock( rank, dims, chunkDims, elemSize, block );
+    sums = malloc( numBlocks * sizeof *sums );
+    if ( sums == NULL )
     {
-        FATAL_MSG("Failed to get TAI93 timestamp.\n");
+        FATAL_MSG("Failed to allocate memory.\n");
         goto cleanupFail;
     }
+    for ( int i = 0; i < rank; i++ )
+    {
+        grid[i] = ( dims[i] + block[i] - 1 ) / block[i];
+        blockDims[i] = block[i];
+    }
 
-    time.year = cur_orbit_info.end_year;
-    time.month = cur_orbit_info.end_month;
-    time.day = cur_orbit_info.end_day;
-    time.hour = cur_orbit_info.end_hour;
-    time.minute = cur_orbit_info.end_minute;
-    time.second = (double) cur_orbit_info.end_second;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for ( long b = 0; b < (long) numBlocks; b++ )
+    {
+        hsize_t start[H5S_MAX_RANK];
+        hsize_t count[H5S_MAX_RANK];
+        hsize_t rest = (hsize_t) b;
 
+        for ( int i = rank - 1; i >= 0; i-- )
+        {
+            start[i] = ( rest % grid[i] ) * block[i];
+            rest /= grid[i];
+            count[i] = dims[i] - start[i] < block[i] ? dims[i] - start[i] : block[i];
+        }
+        sums[b] = checksumBlock( data, rank, dims, start, count, elemSize );
+    }
+    checksum = xxh64Words( sums, numBlocks, 0 );
 
-    status = getTAI93 ( time, &endTAI93 );
-    if ( status == FATAL_ERR )
+    if ( stageAttr( &stage, CHECKSUM_ATTR, H5T_NATIVE_UINT64, 0, &checksum ) == FATAL_ERR ||
+         stageAttr( &stage, CHECKSUM_BLOCKS_ATTR, H5T_NATIVE_UINT64, numBlocks, sums ) == FATAL_ERR ||
+         ( rank > 0 && stageAttr( &stage, CHECKSUM_BLOCK_DIMS_ATTR, H5T_NATIVE_UINT64, rank, blockDims ) == FATAL_ERR ) ||
+         flushAttrStage( &stage ) == FATAL_ERR )
     {
-        FATAL_MSG("Failed to get TAI93 timestamp.\n");
+        FATAL_MSG("Failed to write the checksum attributes.\n");
         goto cleanupFail;
     }
 
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    discardAttrStage( &stage );
+    free(sums);
 
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
+}
 
-    /* Perform a binary search on the timeData array to find the start and end indices */
-    long int startIdx, endIdx;
+typedef struct checksumList
+{
+    checksumEntry_t* entries;
+    size_t num;
+    size_t size;
+} checksumList_t;
 
-    status = binarySearchDouble ( timeData, startTAI93, (hsize_t) numElems, 1, &startIdx );
-    if ( status == -1 )
+static void freeChecksumList( checksumList_t* list )
+{
+    for ( size_t i = 0; i < list->num; i++ )
+        free(list->entries[i].path);
+    free(list->entries);
+    memset( list, 0, sizeof *list );
+}
+
+/* Add the dataset at path to the list if it has checksums */
+static herr_t addChecksumEntry( hid_t fileID, const char* path, checksumList_t* list )
+{
+    hid_t attrID = -1;
+    hid_t spaceID = -1;
+    checksumEntry_t entry;
+    htri_t exists = H5Aexists_by_name( fileID, path, CHECKSUM_ATTR, H5P_DEFAULT );
+    int fail = 0;
+
+    if ( exists <= 0 )
+        return exists < 0 ? FATAL_ERR : RET_SUCCESS;
+
+    memset( &entry, 0, sizeof entry );
+    attrID = H5Aopen_by_name( fileID, path, CHECKSUM_ATTR, H5P_DEFAULT, H5P_DEFAULT );
+    if ( attrID < 0 || H5Aread( attrID, H5T_NATIVE_UINT64, &entry.checksum ) < 0 )
     {
-        FATAL_MSG("Failed to find MOPITT start index.\n");
+        FATAL_MSG("Failed to read the checksum of %s.\n", path);
         goto cleanupFail;
     }
-    status = binarySearchDouble ( timeData, endTAI93, (hsize_t) numElems, 0, &endIdx );
-    if ( status == -1 )
+    H5Aclose(attrID);
+
+    attrID = H5Aopen_by_name( fileID, path, CHECKSUM_BLOCKS_ATTR, H5P_DEFAULT, H5P_DEFAULT );
+    spaceID = attrID >= 0 ? H5Aget_space( attrID ) : -1;
+    if ( spaceID < 0 )
     {
-        FATAL_MSG("Failed to find MOPITT end index.\n");
+        FATAL_MSG("Failed to read the block checksums of %s.\n", path);
         goto cleanupFail;
     }
+    entry.numBlocks = H5Sget_simple_extent_npoints( spaceID );
 
-    /* If the start and end indices are equal, this file is probably out of bounds of the orbit. */
-    // When the difference of startIdx and endIdx is 1, it may be still out of bound.
-    // orbit 3295, the whole orbit time is between the index 3174 and 3175. In fact, 
-    // there may be a few missing data orbits(3295 to 3297).We need to consider this. KY 2017-10-31
-    if ( startIdx == endIdx ){
-        if((timeData[startIdx]<startTAI93)||(timeData[startIdx]>endTAI93))// Out of bound
-            retStatus = 1;
-
-    }
-    else if ((endIdx-startIdx)==1){
-        if((timeData[startIdx]<startTAI93)||(timeData[endIdx]>endTAI93))// Out of bound
-            retStatus = 1;
+    if ( list->num == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 64;
+        checksumEntry_t* temp = realloc( list->entries, newSize * sizeof *temp );
+        if ( temp == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
+        }
+        list->entries = temp;
+        list->size = newSize;
     }
-    else if ((endIdx-startIdx)==-1)
-     // We can make the binary search better to avoid this case.  
-     // However, I think the end results are the same. Just keep it. KY 2017-10-31
+    entry.path = malloc( strlen(path) + 1 );
+    if ( entry.path == NULL )
     {
-        if((timeData[endIdx]<startTAI93)||(timeData[startIdx]>endTAI93))// Out of bound
-            retStatus = 1;
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
     }
-
-    *start_indx_ptr = startIdx;
-    *end_indx_ptr = endIdx;
+    strcpy( entry.path, path );
+    list->entries[list->num++] = entry;
 
     if ( 0 )
     {
 cleanupFail:
-        retStatus = 2;
+        fail = 1;
     }
 
-#if 0
-
-    /* This is for debugging only */
-    printf("\nstartYear = %u\nstartMonth = %u\nstartDay = %u\nstartHour = %u\nstartMinute = %u\nstartSecond = %lf\n", time.year, (unsigned short) time.month, (unsigned short) time.day, (unsigned short) time.hour, (unsigned short) time.minute, time.second);
-    printf("\nendYear = %u\nendMonth = %u\nendDay = %u\nendHour = %u\nendMinute = %u\nendSecond = %lf\n", time.year, (unsigned short) time.month, (unsigned short) time.day, (unsigned short) time.hour, (unsigned short) time.minute, time.second);
-    printf("startTAI93: %lf endTAI93: %lf\n", startTAI93, endTAI93);
-
-
-#endif
-
+    if ( spaceID >= 0 ) H5Sclose(spaceID);
+    if ( attrID >= 0 ) H5Aclose(attrID);
 
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
+}
 
+/* Collect the checksums of the datasets below groupPath, in the order of their names. External links are
+ * followed, so that the manifest of a master file covers its sub-files.
+ */
+static herr_t collectChecksums( hid_t fileID, const char* groupPath, checksumList_t* list )
+{
+    linkNameList_t children = {NULL, 0, 0};
+    char* childPath = NULL;
+    int fail = 0;
 
+    if ( H5Literate_by_name( fileID, groupPath, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames, &children,
+                             H5P_DEFAULT ) < 0 )
+    {
+        FATAL_MSG("Failed to iterate over the group %s.\n", groupPath);
+        goto cleanupFail;
+    }
 
-    if(timeData) free(timeData);
-    if (dataset) H5Dclose(dataset);
-    if (dataspace) H5Sclose(dataspace);
-    if ( groupID ) H5Gclose(groupID);
+    for ( size_t i = 0; i < children.num; i++ )
+    {
+        H5O_info_t info;
 
-    return retStatus;
-}
+        childPath = malloc( strlen(groupPath) + strlen(children.names[i]) + 2 );
+        if ( childPath == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
+        }
+        sprintf( childPath, "%s/%s", strcmp( groupPath, "/" ) == 0 ? "" : groupPath, children.names[i] );
 
+        if ( strcmp( childPath, "/" CHECKSUM_GROUP ) == 0 )
+        {
+            free(childPath); childPath = NULL;
+            continue;
+        }
+        if ( H5Oget_info_by_name( fileID, childPath, &info, H5P_DEFAULT ) < 0 )
+        {
+            WARN_MSG("%s cannot be opened. It is left out of the checksum manifest.\n", childPath);
+            free(childPath); childPath = NULL;
+            continue;
+        }
 
-int comp_greg(GDateInfo_t j1, GDateInfo_t j2)
-{
+        if ( info.type == H5O_TYPE_GROUP && collectChecksums( fileID, childPath, list ) == FATAL_ERR )
+            goto cleanupFail;
+        if ( info.type == H5O_TYPE_DATASET && addChecksumEntry( fileID, childPath, list ) == FATAL_ERR )
+            goto cleanupFail;
 
-#define cmp_number(a,b) (((a) > (b)) ? 1 : (((a) == (b)) ? 0 : -1))
+        free(childPath); childPath = NULL;
+    }
 
-    int cmp_year = cmp_number(j1.year,j2.year);
-    if(cmp_year == 0)
+    if ( 0 )
     {
-        int cmp_month = cmp_number(j1.month,j2.month);
-        if(cmp_month == 0)
-        {
-            int cmp_day = cmp_number(j1.day,j2.day);
-            if(cmp_day == 0)
-            {
-                int cmp_hour = cmp_number(j1.hour,j2.hour);
-                if(cmp_hour == 0)
-                {
-                    int cmp_minute = cmp_number(j1.minute,j2.minute);
-                    if(cmp_minute == 0)
-                    {
-                        int cmp_second = cmp_number(j1.second,j2.second);
-                        return cmp_second;
-                    }
-                    else
-                        return cmp_minute;
-                }
-                else
-                    return cmp_hour;
-            }
-            else
-                return cmp_day;
-        }
-        else
-            return cmp_month;
+cleanupFail:
+        fail = 1;
     }
-    else
-        return cmp_year;
 
+    freeLinkNames( &children );
+    free(childPath);
+
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
 }
 
 /*
-        get_greg
-
+                        writeChecksumManifest
     DESCRIPTION:
-        get_greg converts the julian time given in the argument to a Gregorian calendar
-        date. The code can be seen in two separate parts: the section that converts the
-        date itself, and the code that converts the Gregorian time. The date portion of
-        the code was ported over by Shashank Bansal from a Python implementation. The
-        original Python can be found here:
-
-        https://gist.github.com/jiffyclub/1294443
-
+        This function lists the checksums of all datasets of the output file (see writeChecksums) in the
+        table CHECKSUM_GROUP/manifest, so that a verifier can tell a dataset that lost its checksum
+        attributes, or disappeared, from one that never had them. It runs once all instruments are in the
+        file. For a master file, the datasets of the sub-files are listed under their master file paths.
+
+        Each row of the manifest holds the path of a dataset, its checksum and its number of blocks. The
+        group carries the attributes algorithm ("XXH64") and CHECKSUM_ATTR, the XXH64 of the dataset
+        checksums in the order of the manifest (see xxh64Words), which stands for the whole file. An
+        existing CHECKSUM_GROUP is replaced.
     ARGUMENTS:
-        double julian       -- The Julian value to be converted
-        int* yearp          -- Where the converted year will go
-        int* monthp         -- Where the converted month will go
-        int* dayp           -- Where the converted day will go
-        int* hourp          -- Where the converted hour will go
-        int* mmp            -- Where the converted minute will go
-        double* ssp         -- Where the converted second will go
-
+        const BFcontext_t* ctx  -- The conversion context
+        hid_t fileID            -- The output file
     EFFECTS:
-        Modifes the memory pointed to by the arguments to contain the converted Gregorian date
-
+        Writes CHECKSUM_GROUP. Does nothing if BF_CHECKSUM is not set.
     RETURN:
-        void
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
 
-void get_greg(double julian, int*yearp,int*monthp,int*dayp,int*hourp,int*mmp,double*ssp)
+herr_t writeChecksumManifest( const BFcontext_t* ctx, hid_t fileID )
 {
+    checksumList_t list = {NULL, 0, 0};
+    uint64_t* sums = NULL;
+    uint64_t fileChecksum = 0;
+    hid_t groupID = -1;
+    hid_t strType = -1;
+    hid_t entryType = -1;
+    hid_t space = -1;
+    hid_t table = -1;
+    hsize_t dims = 0;
+    htri_t exists = 0;
+    attrStage_t stage;
+    int fail = 0;
+
+    if ( !ctx->checksum )
+        return RET_SUCCESS;
 
-    double julian_fract = julian-(int)julian;
-    double total_ss,ss;
-    int hh,mm;
-    if(julian_fract >0.5)
-        total_ss = 86400*(julian_fract-0.5);
-    else
-        total_ss = 86400*(julian_fract+0.5);
+    initAttrStage( ctx, &stage, -1 );
 
-    hh = (int)(total_ss/3600);
-    mm = (int)((total_ss-(hh*3600))/60);
-    ss = total_ss-(hh*60.0+mm)*60.0;
+    exists = H5Lexists( fileID, "/" CHECKSUM_GROUP, H5P_DEFAULT );
+    if ( exists < 0 || ( exists && H5Ldelete( fileID, "/" CHECKSUM_GROUP, H5P_DEFAULT ) < 0 ) )
+    {
+        FATAL_MSG("Failed to replace the %s group.\n", CHECKSUM_GROUP);
+        goto cleanupFail;
+    }
 
+    if ( collectChecksums( fileID, "/", &list ) == FATAL_ERR )
+        goto cleanupFail;
+    if ( list.num == 0 )
+    {
+        WARN_MSG("No dataset has checksums. The checksum manifest is not written.\n");
+        goto cleanup;
+    }
 
-    /* Calculte fraction */
+    sums = malloc( list.num * sizeof *sums );
+    if ( sums == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    for ( size_t i = 0; i < list.num; i++ )
+        sums[i] = list.entries[i].checksum;
+    fileChecksum = xxh64Words( sums, list.num, 0 );
 
-    julian = julian + 0.5;
+    strType = H5Tcopy( H5T_C_S1 );
+    entryType = H5Tcreate( H5T_COMPOUND, sizeof(checksumEntry_t) );
+    if ( strType < 0 || H5Tset_size( strType, H5T_VARIABLE ) < 0 || entryType < 0 ||
+         H5Tinsert( entryType, "path", HOFFSET(checksumEntry_t, path), strType ) < 0 ||
+         H5Tinsert( entryType, "checksum", HOFFSET(checksumEntry_t, checksum), H5T_NATIVE_UINT64 ) < 0 ||
+         H5Tinsert( entryType, "blocks", HOFFSET(checksumEntry_t, numBlocks), H5T_NATIVE_UINT64 ) < 0 )
+    {
+        FATAL_MSG("Failed to create the checksum manifest datatype.\n");
+        goto cleanupFail;
+    }
 
-    double F, I, B, C, D, E, G, A;
-    int day, month, year;
+    groupID = H5Gcreate2( fileID, "/" CHECKSUM_GROUP, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    dims = list.num;
+    space = H5Screate_simple( 1, &dims, NULL );
+    if ( groupID < 0 || space < 0 )
+    {
+        FATAL_MSG("Failed to create the %s group.\n", CHECKSUM_GROUP);
+        goto cleanupFail;
+    }
+    table = H5Dcreate2( groupID, "manifest", entryType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( table < 0 || H5Dwrite( table, entryType, H5S_ALL, H5S_ALL, H5P_DEFAULT, list.entries ) < 0 )
+    {
+        FATAL_MSG("Failed to write the checksum manifest.\n");
+        goto cleanupFail;
+    }
 
-    F = modf(julian, &I);
-    A = trunc(((int)I - 1867216.25)/36524.25);
+    initAttrStage( ctx, &stage, groupID );
+    if ( stageAttrString( &stage, "algorithm", "XXH64" ) == FATAL_ERR ||
+         stageAttr( &stage, CHECKSUM_ATTR, H5T_NATIVE_UINT64, 0, &fileChecksum ) == FATAL_ERR ||
+         flushAttrStage( &stage ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the attributes of the %s group.\n", CHECKSUM_GROUP);
+        goto cleanupFail;
+    }
 
-    if(I > 2299160)
+    if ( 0 )
     {
-        B = I + 1 + A - trunc(A / 4.0);
+cleanupFail:
+        fail = 1;
     }
 
-    else
-        B = I;
+cleanup:
+    discardAttrStage( &stage );
+    freeChecksumList( &list );
+    free(sums);
+    if ( table >= 0 ) H5Dclose(table);
+    if ( space >= 0 ) H5Sclose(space);
+    if ( entryType >= 0 ) H5Tclose(entryType);
+    if ( strType >= 0 ) H5Tclose(strType);
+    if ( groupID >= 0 ) H5Gclose(groupID);
 
-    C = B + 1524;
-    D = trunc((C - 122.1) / 365.25);
-    E = trunc(365.25 * D);
-    G = trunc((C - E) / 30.6001);
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
+}
 
-    day = C - E + F - trunc(30.6001 * G);
+/*
+                        getGranuleMetadataFormat
+    DESCRIPTION:
+        This function tells which granule metadata BF_GRANULE_METADATA asks for: "echo10" for an ECHO10
+        Granule XML document, as CMR/cdl2echo10.py makes from a CDL dump of the file, or "json" for the same
+        fields as JSON.
+    ARGUMENTS:
+        None
+    EFFECTS:
+        None
+    RETURN:
+        FATAL_ERR if BF_GRANULE_METADATA is unknown
+        GRANULE_META_NONE, GRANULE_META_ECHO10 or GRANULE_META_JSON otherwise
+*/
 
-    if(G < 13.5) 
-        month = G - 1;
-    else 
-        month = G - 13;
+int getGranuleMetadataFormat( void )
+{
+    const char* s = getenv("BF_GRANULE_METADATA");
+
+    if ( s == NULL || *s == '\0' )
+        return GRANULE_META_NONE;
+    if ( strcmp( s, "echo10" ) == 0 )
+        return GRANULE_META_ECHO10;
+    if ( strcmp( s, "json" ) == 0 )
+        return GRANULE_META_JSON;
+
+    FATAL_MSG("Unknown BF_GRANULE_METADATA \"%s\". Use echo10 or json.\n", s);
+    return FATAL_ERR;
+}
+
+/* Add the "extent" attributes of the spatial index tables of one instrument to total. A box 180 degrees or
+ * more wide cannot be told apart from its complement by its corners, so it sets allLon instead.
+ */
+static herr_t addIndexExtents( hid_t fileID, const char* instrument, geoExtent_t* total, int* allLon )
+{
+    char groupPath[64];
+    linkNameList_t tables = {0};
+    hid_t groupID = -1;
+    herr_t status = RET_SUCCESS;
+
+    snprintf( groupPath, sizeof groupPath, "/%s/%s", SPATIAL_INDEX_GROUP, instrument );
+    groupID = H5Gopen2( fileID, groupPath, H5P_DEFAULT );
+    if ( groupID < 0 || H5Literate( groupID, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames, &tables ) < 0 )
+    {
+        FATAL_MSG("Failed to list the spatial index tables of %s.\n", instrument);
+        status = FATAL_ERR;
+    }
 
-    if(month > 2.5) 
-        year = D - 4716;
-    else 
-        year = D - 4715;
+    for ( size_t i = 0; i < tables.num && status != FATAL_ERR; i++ )
+    {
+        float extent[4];
+        double width = 0.0;
+        hid_t attrID = H5Aopen_by_name( groupID, tables.names[i], "extent", H5P_DEFAULT, H5P_DEFAULT );
 
-    *yearp = year;
-    *monthp = month;
-    *dayp   = day;
-    *hourp  = hh;
-    *mmp    = mm;
-    *ssp    = ss;
+        if ( attrID < 0 || H5Aread( attrID, H5T_NATIVE_FLOAT, extent ) < 0 )
+        {
+            FATAL_MSG("Failed to read the extent of the spatial index table %s.\n", tables.names[i]);
+            status = FATAL_ERR;
+        }
+        else
+        {
+            width = extent[3] - extent[2];
+            if ( width < 0.0 ) width += 360.0;
+            if ( width >= 180.0 )
+                *allLon = 1;
+            addGeoPoint( total, extent[0], extent[2] );
+            addGeoPoint( total, extent[1], extent[3] );
+        }
+        if ( attrID >= 0 ) H5Aclose(attrID);
+    }
 
-    return;
+    if ( groupID >= 0 ) H5Gclose(groupID);
+    freeLinkNames(&tables);
+
+    return status;
 }
-/*
-        binarySearchUTC
 
-        TODO: NEED to CLEAN UP the comments.
+/*
+                        collectGranuleMetadata
     DESCRIPTION:
-        This function performs a binary search on a sorted incrased order array of double values.
-        If the exact target is not found, the first element that is greater than the target value is returned
-        in the argument targetIndex.
-
+        This function gathers the granule metadata that is known before the output file is closed: the
+        orbit and its times, and the bounding box of the whole file, made from the extents the spatial index
+        already holds for each geolocation dataset (see indexGeolocation), so that no geolocation is read
+        again. Without the index the metadata has no spatial part. Nothing is gathered unless
+        BF_GRANULE_METADATA is set. writeGranuleMetadata writes the metadata once the file is closed.
     ARGUMENTS:
-        IN
-            1. double* array         -- The array to perform the search on
-            2. double target         -- The value to search for
-            3. hsize_t size          -- The number of elements in array
-        OUT
-            4. long int* targetIndex -- The index of where the target value is. If target doesn't exist in the array,
-                                        this will return the first element in array that is larger than target.
-
+        hid_t fileID                -- The output file, or the master file that links the sub-files
+        const OInfo_t* orbitInfo    -- The orbit of the file, narrowed to BF_TIME_WINDOW (see subsetOrbitInfo)
+        granuleMeta_t* meta         -- Set to the metadata
     EFFECTS:
-        Modifies the memory pointed to by targetIndex to contain the selected index of the array.
-
+        Reads the spatial index of fileID. Fills meta.
     RETURN:
-        0 if an exact match is found.
-        1 if an exact match was not found (first element larger than target is returned).
-       -1 if an error occured.
-
+        FATAL_ERR on failure
+        RET_SUCCESS on success
 */
-int binarySearchUTC ( const double* jd, GDateInfo_t target, int start_index,int end_index)
-{
-    int middle = 0;
 
-    GDateInfo_t gran_mark_index_time,gran_mark_adj_time;
-
-    int temp_year = 0;
-    int temp_month = 0;
-    int temp_day = 0;
-    int temp_hour = 0;
-    int temp_minute = 0;
-    double temp_second = 0.;
-    int* temp_yearp =&temp_year;
-    int* temp_monthp=&temp_month;
-    int* temp_dayp=&temp_day;
-    int* temp_hourp=&temp_hour;
-    int* temp_minutep=&temp_minute;
-    double* temp_secondp=&temp_second;
-
-    if(start_index >end_index)
-        return -1;
-    middle = (start_index+end_index)/2;
+herr_t collectGranuleMetadata( hid_t fileID, const OInfo_t* orbitInfo, granuleMeta_t* meta )
+{
+    linkNameList_t instruments = {0};
+    geoExtent_t total;
+    int allLon = 0;
+    htri_t exists = 0;
+    herr_t status = RET_SUCCESS;
+
+    memset( meta, 0, sizeof *meta );
+    meta->format = getGranuleMetadataFormat();
+    if ( meta->format == FATAL_ERR )
+        return FATAL_ERR;
+    if ( meta->format == GRANULE_META_NONE )
+        return RET_SUCCESS;
+    meta->orbit = *orbitInfo;
 
-    if(middle == end_index)
-        return end_index;
+    exists = H5Lexists( fileID, "/" SPATIAL_INDEX_GROUP, H5P_DEFAULT );
+    if ( exists <= 0 )
+        return exists < 0 ? FATAL_ERR : RET_SUCCESS;
 
-#if 0
-    printf("orbit year is %d\n",target.year);
-    printf("orbit month is %d\n",target.month);
-    printf("orbit day is %d\n",target.day);
-    printf("orbit hour is %d\n",target.hour);
-    printf("orbit minute is %d\n",target.minute);
-    printf("orbit second is %lf\n",target.second);
-#endif
-    get_greg(jd[middle],temp_yearp,temp_monthp,temp_dayp,temp_hourp,temp_minutep,temp_secondp);
-    gran_mark_index_time.year = *temp_yearp;
-    gran_mark_index_time.month = *temp_monthp;
-    gran_mark_index_time.day = *temp_dayp;
-    gran_mark_index_time.hour = *temp_hourp;
-    gran_mark_index_time.minute = *temp_minutep;
-    gran_mark_index_time.second = *temp_secondp;
+    if ( H5Literate_by_name( fileID, "/" SPATIAL_INDEX_GROUP, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLinkNames,
+                             &instruments, H5P_DEFAULT ) < 0 )
+    {
+        FATAL_MSG("Failed to iterate over the %s group.\n", SPATIAL_INDEX_GROUP);
+        freeLinkNames(&instruments);
+        return FATAL_ERR;
+    }
 
-#if 0
-    printf("N orbit year is %d\n",gran_mark_index_time.year);
-    printf("N orbit month is %d\n",gran_mark_index_time.month);
-    printf("N orbit day is %d\n",gran_mark_index_time.day);
-    printf("N orbit hour is %d\n",gran_mark_index_time.hour);
-    printf("N orbit minute is %d\n",gran_mark_index_time.minute);
-    printf("N orbit second is %lf\n",gran_mark_index_time.second);
-#endif
+    initGeoExtent( &total );
+    for ( size_t i = 0; i < instruments.num && status != FATAL_ERR; i++ )
+        status = addIndexExtents( fileID, instruments.names[i], &total, &allLon );
+    freeLinkNames(&instruments);
+    if ( status == FATAL_ERR )
+        return FATAL_ERR;
 
+    meta->haveExtent = finishGeoExtent( &total, &meta->extent );
+    if ( meta->haveExtent && allLon )
+    {
+        meta->extent.lonMin = -180.0f;
+        meta->extent.lonMax = 180.0f;
+    }
 
+    return RET_SUCCESS;
+}
 
-    int cmp_orbit_mark_time = comp_greg(target,gran_mark_index_time);
+/* Helpers for writeGranuleMetadata */
 
-    get_greg(jd[middle+1],temp_yearp,temp_monthp,temp_dayp,temp_hourp,temp_minutep,temp_secondp);
-    gran_mark_adj_time.year = *temp_yearp;
-    gran_mark_adj_time.month = *temp_monthp;
-    gran_mark_adj_time.day = *temp_dayp;
-    gran_mark_adj_time.hour = *temp_hourp;
-    gran_mark_adj_time.minute = *temp_minutep;
-    gran_mark_adj_time.second = *temp_secondp;
+/* The CMR instrument names, told by the prefix of the input granules */
+static const struct
+{
+    const char* prefix;
+    const char* name;
+} granuleInstruments[] = { { "MOP01", "MOPITT" }, { "CER_SSF_Terra-FM1", "CERES-FM1" }, { "CER_SSF_Terra-FM2", "CERES-FM2" },
+                           { "MISR_", "MISR" }, { "MOD0", "MODIS" }, { "AST_L1T", "ASTER" } };
+#define NUM_GRANULE_INSTRUMENTS ( sizeof(granuleInstruments) / sizeof(granuleInstruments[0]) )
+
+/* The next entry of a comma-separated granule list, or NULL at the end. "None" stands for an empty list. */
+static const char* nextGranule( const char** list, size_t* len )
+{
+    while ( *list && **list )
+    {
+        const char* entry = *list;
 
-    int cmp_orbit_adj_time = comp_greg(target,gran_mark_adj_time);
-    if ( cmp_orbit_mark_time >=0 && cmp_orbit_adj_time <0)
-        return middle;
-    else if(cmp_orbit_mark_time <0)
-        return binarySearchUTC(jd,target,0,middle);
-    else
-        return binarySearchUTC(jd,target,middle,end_index);
+        *len = strcspn( entry, "," );
+        *list = entry[*len] ? entry + *len + 1 : entry + *len;
+        if ( *len > 0 && !( *len == 4 && strncmp( entry, "None", 4 ) == 0 ) )
+            return entry;
+    }
 
+    return NULL;
 }
 
-int comp_greg_utc(double sgreg,GDateInfo_t sutc)
+/* Print len characters of s, escaped for XML text or a JSON string */
+static void printEscaped( FILE* out, const char* s, size_t len, int json )
 {
+    for ( size_t i = 0; i < len; i++ )
+    {
+        unsigned char c = s[i];
+
+        if ( json && ( c == '"' || c == '\\' ) )
+            fprintf( out, "\\%c", c );
+        else if ( json && c < 0x20 )
+            fprintf( out, "\\u%04x", c );
+        else if ( !json && c == '&' )
+            fputs( "&amp;", out );
+        else if ( !json && c == '<' )
+            fputs( "&lt;", out );
+        else if ( !json && c == '>' )
+            fputs( "&gt;", out );
+        else
+            fputc( c, out );
+    }
+}
 
-    GDateInfo_t sgreg_utc;
-    int temp_year = 0;
-    int temp_month = 0;
-    int temp_day = 0;
-    int temp_hour = 0;
-    int temp_minute = 0;
-    double temp_second = 0.0;
-    int* temp_yearp =&temp_year;
-    int* temp_monthp=&temp_month;
-    int* temp_dayp=&temp_day;
-    int* temp_hourp=&temp_hour;
-    int* temp_minutep=&temp_minute;
-    double* temp_secondp=&temp_second;
+static void writeEcho10( FILE* out, const granuleMeta_t* meta, const char* name, double sizeMB, const char* now,
+                         const char* begin, const char* end, const int* present, const char* granuleList )
+{
+    const char* list = granuleList;
+    const char* entry = NULL;
+    size_t len = 0;
+    int anyPresent = 0;
+
+    fputs( "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Granule>\n  <GranuleUR>", out );
+    printEscaped( out, name, strlen(name), 0 );
+    fprintf( out, "</GranuleUR>\n  <InsertTime>%s</InsertTime>\n  <LastUpdate>%s</LastUpdate>\n", now, now );
+    fprintf( out, "  <Collection>\n    <ShortName>%s</ShortName>\n    <VersionId>%s</VersionId>\n  </Collection>\n",
+             GRANULE_COLLECTION, GRANULE_COLLECTION_VERSION );
+    fprintf( out, "  <DataGranule>\n    <SizeMBDataGranule>%.6f</SizeMBDataGranule>\n    <ProducerGranuleId>", sizeMB );
+    printEscaped( out, name, strlen(name), 0 );
+    fprintf( out, "</ProducerGranuleId>\n    <DayNightFlag>UNSPECIFIED</DayNightFlag>\n"
+                  "    <ProductionDateTime>%s</ProductionDateTime>\n  </DataGranule>\n", now );
+    fprintf( out, "  <Temporal>\n    <RangeDateTime>\n      <BeginningDateTime>%s</BeginningDateTime>\n"
+                  "      <EndingDateTime>%s</EndingDateTime>\n    </RangeDateTime>\n  </Temporal>\n", begin, end );
+    if ( meta->haveExtent )
+        fprintf( out, "  <Spatial>\n    <HorizontalSpatialDomain>\n      <Geometry>\n        <BoundingRectangle>\n"
+                      "          <WestBoundingCoordinate>%.9g</WestBoundingCoordinate>\n"
+                      "          <NorthBoundingCoordinate>%.9g</NorthBoundingCoordinate>\n"
+                      "          <EastBoundingCoordinate>%.9g</EastBoundingCoordinate>\n"
+                      "          <SouthBoundingCoordinate>%.9g</SouthBoundingCoordinate>\n"
+                      "        </BoundingRectangle>\n      </Geometry>\n    </HorizontalSpatialDomain>\n  </Spatial>\n",
+                 meta->extent.lonMin, meta->extent.latMax, meta->extent.lonMax, meta->extent.latMin );
+    fprintf( out, "  <OrbitCalculatedSpatialDomains>\n    <OrbitCalculatedSpatialDomain>\n"
+                  "      <OrbitNumber>%u</OrbitNumber>\n    </OrbitCalculatedSpatialDomain>\n"
+                  "  </OrbitCalculatedSpatialDomains>\n", meta->orbit.orbit_number );
+
+    fputs( "  <Platforms>\n    <Platform>\n      <ShortName>TERRA</ShortName>\n", out );
+    for ( size_t i = 0; i < NUM_GRANULE_INSTRUMENTS; i++ )
+    {
+        if ( !present[i] )
+            continue;
+        if ( !anyPresent++ )
+            fputs( "      <Instruments>\n", out );
+        fprintf( out, "        <Instrument>\n          <ShortName>%s</ShortName>\n        </Instrument>\n",
+                 granuleInstruments[i].name );
+    }
+    if ( anyPresent )
+        fputs( "      </Instruments>\n", out );
+    fputs( "    </Platform>\n  </Platforms>\n", out );
 
-    get_greg(sgreg,temp_yearp,temp_monthp,temp_dayp,temp_hourp,temp_minutep,temp_secondp);
-    sgreg_utc.year = *temp_yearp;
-    sgreg_utc.month = *temp_monthp;
-    sgreg_utc.day = *temp_dayp;
-    sgreg_utc.hour = *temp_hourp;
-    sgreg_utc.minute = *temp_minutep;
-    sgreg_utc.second = *temp_secondp;
-    return comp_greg(sgreg_utc,sutc);
+    for ( anyPresent = 0; ( entry = nextGranule( &list, &len ) ) != NULL; anyPresent = 1 )
+    {
+        fputs( anyPresent ? "    <InputGranule>" : "  <InputGranules>\n    <InputGranule>", out );
+        printEscaped( out, entry, len, 0 );
+        fputs( "</InputGranule>\n", out );
+    }
+    if ( anyPresent )
+        fputs( "  </InputGranules>\n", out );
 
+    fputs( "  <Orderable>true</Orderable>\n</Granule>\n", out );
 }
 
-int utc_time_diff(struct tm start_date, struct tm end_date)
+static void writeGranuleJson( FILE* out, const granuleMeta_t* meta, const char* name, double sizeMB, const char* now,
+                              const char* begin, const char* end, const int* present, const char* granuleList )
 {
+    const char* list = granuleList;
+    const char* entry = NULL;
+    size_t len = 0;
+    const char* sep = "";
+
+    fputs( "{\n  \"GranuleUR\": \"", out );
+    printEscaped( out, name, strlen(name), 1 );
+    fprintf( out, "\",\n  \"InsertTime\": \"%s\",\n  \"LastUpdate\": \"%s\",\n", now, now );
+    fprintf( out, "  \"Collection\": {\"ShortName\": \"%s\", \"VersionId\": \"%s\"},\n", GRANULE_COLLECTION,
+             GRANULE_COLLECTION_VERSION );
+    fprintf( out, "  \"DataGranule\": {\"SizeMBDataGranule\": %.6f, \"ProducerGranuleId\": \"", sizeMB );
+    printEscaped( out, name, strlen(name), 1 );
+    fprintf( out, "\", \"DayNightFlag\": \"UNSPECIFIED\", \"ProductionDateTime\": \"%s\"},\n", now );
+    fprintf( out, "  \"Temporal\": {\"BeginningDateTime\": \"%s\", \"EndingDateTime\": \"%s\"},\n", begin, end );
+    if ( meta->haveExtent )
+        fprintf( out, "  \"BoundingRectangle\": {\"WestBoundingCoordinate\": %.9g, \"NorthBoundingCoordinate\": %.9g, "
+                      "\"EastBoundingCoordinate\": %.9g, \"SouthBoundingCoordinate\": %.9g},\n",
+                 meta->extent.lonMin, meta->extent.latMax, meta->extent.lonMax, meta->extent.latMin );
+    fprintf( out, "  \"OrbitNumber\": %u,\n  \"Platform\": \"TERRA\",\n  \"Instruments\": [", meta->orbit.orbit_number );
+    for ( size_t i = 0; i < NUM_GRANULE_INSTRUMENTS; i++ )
+    {
+        if ( !present[i] )
+            continue;
+        fprintf( out, "%s\"%s\"", sep, granuleInstruments[i].name );
+        sep = ", ";
+    }
+    fputs( "],\n  \"InputGranules\": [", out );
+    for ( sep = "\n    "; ( entry = nextGranule( &list, &len ) ) != NULL; sep = ",\n    " )
+    {
+        fprintf( out, "%s\"", sep );
+        printEscaped( out, entry, len, 1 );
+        fputc( '"', out );
+    }
+    fputs( *sep == ',' ? "\n  ],\n" : "],\n", out );
+    fputs( "  \"Orderable\": true\n}\n", out );
+}
 
+/*
+                        writeGranuleMetadata
+    DESCRIPTION:
+        This function writes the granule metadata of a closed output file next to it, as fileName.xml in
+        ECHO10 or fileName.json, depending on BF_GRANULE_METADATA. The metadata gathered by
+        collectGranuleMetadata is completed with the size of the file (and of the sub-files it links), the
+        input granules, and the instruments they come from. It holds the same elements as the documents
+        CMR/cdl2echo10.py makes, except for those it looks up in CMR: the GranuleUR is the file name. Nothing
+        is written unless BF_GRANULE_METADATA is set.
+    ARGUMENTS:
+        const char* fileName        -- The closed output file
+        const granuleMeta_t* meta   -- The metadata from collectGranuleMetadata
+        const char* granuleList     -- The comma-separated input granules (see updateGranList)
+    EFFECTS:
+        Creates or replaces the metadata file.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
 
-    //struct tm start_date;
-    //struct tm end_date;
-    time_t start_time, end_time;
-    int seconds;
-
-#if 0
-    start_date.tm_hour = 0;
-    start_date.tm_min = 0;
-    start_date.tm_sec = 0;
-    start_date.tm_mon = 1;
-    start_date.tm_mday = 1;
-    start_date.tm_year = 112;
+herr_t writeGranuleMetadata( const char* fileName, const granuleMeta_t* meta, const char* granuleList )
+{
+    const OInfo_t* orbit = &meta->orbit;
+    const char* name = strrchr( fileName, '/' ) ? strrchr( fileName, '/' ) + 1 : fileName;
+    const char* list = granuleList;
+    const char* entry = NULL;
+    char* metaName = NULL;
+    char now[32];
+    char begin[32];
+    char end[32];
+    int present[NUM_GRANULE_INSTRUMENTS] = {0};
+    size_t len = 0;
+    struct stat fileStat;
+    time_t nowTime = time(NULL);
+    FILE* out = NULL;
+    int fail = 0;
+
+    if ( meta->format == GRANULE_META_NONE )
+        return RET_SUCCESS;
 
-    end_date.tm_hour = 0;
-    end_date.tm_min = 0;
-    end_date.tm_sec = 0;
-    end_date.tm_mon = 2;
-    end_date.tm_mday = 1;
-    end_date.tm_year = 112;
-#endif
+    if ( stat( fileName, &fileStat ) != 0 )
+    {
+        FATAL_MSG("Failed to get the size of %s.\n", fileName);
+        return FATAL_ERR;
+    }
 
-    start_time = mktime(&start_date);
-    end_time = mktime(&end_date);
+    while ( ( entry = nextGranule( &list, &len ) ) != NULL )
+        for ( size_t i = 0; i < NUM_GRANULE_INSTRUMENTS; i++ )
+            if ( strncmp( entry, granuleInstruments[i].prefix, strlen(granuleInstruments[i].prefix) ) == 0 )
+                present[i] = 1;
 
-    seconds = (int)(difftime(end_time, start_time)) ;
+    strftime( now, sizeof now, "%Y-%m-%dT%H:%M:%SZ", gmtime(&nowTime) );
+    snprintf( begin, sizeof begin, "%04u-%02u-%02uT%02u:%02u:%02uZ", orbit->start_year, orbit->start_month,
+              orbit->start_day, orbit->start_hour, orbit->start_minute, orbit->start_second );
+    snprintf( end, sizeof end, "%04u-%02u-%02uT%02u:%02u:%02uZ", orbit->end_year, orbit->end_month, orbit->end_day,
+              orbit->end_hour, orbit->end_minute, orbit->end_second );
 
-    return seconds;
-}
+    metaName = malloc( strlen(fileName) + 6 );
+    if ( metaName == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    sprintf( metaName, "%s.%s", fileName, meta->format == GRANULE_META_JSON ? "json" : "xml" );
+    out = fopen( metaName, "w" );
+    if ( out == NULL )
+    {
+        FATAL_MSG("Failed to create %s.\n", metaName);
+        goto cleanupFail;
+    }
 
+    if ( meta->format == GRANULE_META_JSON )
+        writeGranuleJson( out, meta, name, ( fileStat.st_size + meta->linkedBytes ) / ( 1024.0 * 1024.0 ), now, begin,
+                          end, present, granuleList );
+    else
+        writeEcho10( out, meta, name, ( fileStat.st_size + meta->linkedBytes ) / ( 1024.0 * 1024.0 ), now, begin, end,
+                     present, granuleList );
 
-/* This function is self-explanatory */
-int numDigits(int digit)
-{
-    if ( digit < 0 ) digit = ( digit == INT_MAX ) ? INT_MIN : -digit;
-    if ( digit < 10 ) return 1;
-    if ( digit < 100 ) return 2;
-    if ( digit < 1000) return 3;
-    if ( digit < 10000) return 4;
-    if ( digit < 100000) return 5;
-    if ( digit < 1000000) return 6;
-    if ( digit < 10000000) return 7;
-    if ( digit < 100000000) return 8;
-    if ( digit < 1000000000) return 9;
-    return 10;
-}
+    if ( ferror(out) )
+    {
+        FATAL_MSG("Failed to write %s.\n", metaName);
+        goto cleanupFail;
+    }
 
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
 
-/*
- *      updateGranList
- *
- * DESCRIPTION:
- *      This function handles creating a list of input granules as a string. It takes a running total of all currently visited
- *      granules, "granList", a new granule to add, "newGran", and appends newGran to granList. This handles all of the necessary
- *      memory operations for a variable length string. Adding a new granule to the list is an amortized constant operation.
- *
- * ARGUMETS:
- *      IN:
- *          const char newGran     -- A null terminated string containing the new granule. Should not have any newline characters.
- *                                    absence of the null terminator risks memory access violations!
- *      
- *      IN/OUT:
- *          char** granList        -- A pointer to a character array. This function updates the character array pointer as needed
- *                                    when allocating memory. The granList double pointer should point to a NULL value the first
- *                                    time this function is called because granList will be dereferenced once to contain the
- *                                    return value of malloc.
- *          size_t* curSize        -- The current size in bytes of the memory pointed to by *granList. Is updated when new memory
- *                                    is allocated. *curSize should be zero when first calling this function.
- *
- * EFFECTS:
- *      Allocates new memory as needed. Updates *granList and *curSize variables as needed.
- *
- *      IT IS THE DUTY OF THE CALLER to free the granList memory when finished!
- *
- * RETURN:
- *      FATAL_ERR.
- *      RET_SUCCESS.
+    if ( out && fclose(out) != 0 && !fail )
+    {
+        FATAL_MSG("Failed to write %s.\n", metaName);
+        fail = 1;
+    }
+    if ( fail && out )
+        remove( metaName );
+    free(metaName);
+
+    if ( fail )
+        return FATAL_ERR;
+    return RET_SUCCESS;
+}
+
+/* Helpers for sinkDatasets */
+
+/* What sinkDatasets reads of one dataset besides its values. The arrays are parallel: raw holds the values
+ * of attribute i as read, strings the pointers handed to the sink for string attributes.
  */
+typedef struct
+{
+    BFsinkAttr_t* attrs;
+    hid_t* spaces;
+    void** raw;
+    char*** strings;
+    size_t num;
+    size_t size;
+} sinkAttrList_t;
+
+typedef struct
+{
+    BFcontext_t* ctx;
+    const char* basePath;
+    int withGroups;
+    size_t numNew;              // Addresses appended past ctx->sinkSentNum by this visit
+    int trim;                   // Non-zero to remove the datasets handed over from the file (see sinkDatasets)
+    char** trimPaths;           // The datasets to remove once the visit is over
+    size_t numTrim;
+    size_t sizeTrim;
+} sinkVisit_t;
+
+static int compareAddr( const void* a, const void* b )
+{
+    haddr_t addrA = *(const haddr_t*) a;
+    haddr_t addrB = *(const haddr_t*) b;
 
-herr_t updateGranList( char** granList, const char* newGran, size_t * curSize )
+    return ( addrA > addrB ) - ( addrA < addrB );
+}
+
+static void freeSinkAttrs( sinkAttrList_t* list )
 {
-    if ( granList == NULL || curSize == NULL || newGran == NULL )
+    for ( size_t i = 0; i < list->num; i++ )
+    {
+        if ( list->raw[i] )
+            H5Dvlen_reclaim( list->attrs[i].type, list->spaces[i], H5P_DEFAULT, list->raw[i] );
+        free( list->raw[i] );
+        free( list->strings[i] );
+        free( (char*) list->attrs[i].name );
+        H5Tclose( list->attrs[i].type );
+        H5Sclose( list->spaces[i] );
+    }
+    free( list->attrs );
+    free( list->spaces );
+    free( list->raw );
+    free( list->strings );
+    memset( list, 0, sizeof *list );
+}
+
+/* Read one attribute for the sink. Attributes holding references (the dimension scale bookkeeping) are
+ * left out. Strings are read as NUL-terminated strings.
+ */
+static herr_t readSinkAttr( hid_t dsetID, const char* name, const H5A_info_t* info, void* opdata )
+{
+    sinkAttrList_t* list = (sinkAttrList_t*) opdata;
+    hid_t attrID = -1;
+    hid_t fileType = -1;
+    hid_t memType = -1;
+    hid_t space = -1;
+    hssize_t numElems = 0;
+    void* raw = NULL;
+    char** strings = NULL;
+    char* nameCopy = NULL;
+    herr_t ret = -1;
+
+    (void) info;
+
+    attrID = H5Aopen( dsetID, name, H5P_DEFAULT );
+    if ( attrID < 0 )
     {
-        FATAL_MSG("No arguments to this function can be NULL.\n\tgranList = %p\n\tcurSize = %p\n\tnewGran = %p\n", granList,
-                   curSize, newGran);
-        return FATAL_ERR;
+        FATAL_MSG("Failed to open the attribute %s.\n", name);
+        return -1;
     }
-    size_t granLen = strlen( newGran );
-    if ( granLen < 2 )
+    fileType = H5Aget_type( attrID );
+    space = H5Aget_space( attrID );
+    if ( fileType < 0 || space < 0 )
     {
-        FATAL_MSG("The newGran argument contains no string!\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to get the type or dataspace of the attribute %s.\n", name);
+        goto cleanup;
+    }
+    if ( H5Tdetect_class( fileType, H5T_REFERENCE ) > 0 || H5Tdetect_class( fileType, H5T_VLEN ) > 0 )
+    {
+        ret = 0;
+        goto cleanup;
     }
 
-    size_t granListSize = 0;
-
-    if ( *granList != NULL )
-        granListSize = strlen(*granList);
-
-    if ( *granList == NULL )
+    numElems = H5Sget_simple_extent_npoints( space );
+    if ( H5Tget_class( fileType ) == H5T_STRING )
     {
-        if ( *curSize != 0 )
+        memType = H5Tcopy( fileType );
+        if ( memType >= 0 && !H5Tis_variable_str( fileType ) )
         {
-            FATAL_MSG("A NULL pointer was passed for the string but the size was indicated to be non-zero.\n");
-            return FATAL_ERR;
+            if ( H5Tset_size( memType, H5Tget_size( fileType ) + 1 ) < 0 || H5Tset_strpad( memType, H5T_STR_NULLTERM ) < 0 )
+            {
+                H5Tclose( memType );
+                memType = -1;
+            }
         }
+    }
+    else
+        memType = H5Tget_native_type( fileType, H5T_DIR_ASCEND );
+    if ( memType < 0 || numElems < 0 )
+    {
+        FATAL_MSG("Failed to get the memory type of the attribute %s.\n", name);
+        goto cleanup;
+    }
 
-        *granList = calloc( granLen+2, 1 );
-        if ( *granList == NULL )
+    raw = calloc( numElems ? numElems : 1, H5Tget_size( memType ) );
+    nameCopy = malloc( strlen(name) + 1 );
+    if ( raw == NULL || nameCopy == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanup;
+    }
+    strcpy( nameCopy, name );
+    if ( H5Aread( attrID, memType, raw ) < 0 )
+    {
+        FATAL_MSG("Failed to read the attribute %s.\n", name);
+        goto cleanup;
+    }
+
+    if ( H5Tget_class( fileType ) == H5T_STRING && !H5Tis_variable_str( fileType ) )
+    {
+        size_t stride = H5Tget_size( memType );
+        strings = malloc( ( numElems ? numElems : 1 ) * sizeof(char*) );
+        if ( strings == NULL )
         {
             FATAL_MSG("Failed to allocate memory.\n");
-            return FATAL_ERR;
+            goto cleanup;
         }
-
-        *curSize = granLen+2;
+        for ( hssize_t i = 0; i < numElems; i++ )
+            strings[i] = (char*) raw + i * stride;
     }
 
-    else if ( granListSize + granLen + 2 > *curSize )
+    if ( list->num == list->size )
     {
-        
-        granListSize = strlen(*granList);
-        // granLen+2 to account for newline and null terminator that will be added
-        void* tempPtr = realloc( *granList, max((*curSize) * 2 , granListSize+granLen+2));
-        if ( tempPtr == NULL )
+        size_t newSize = list->size ? 2 * list->size : 16;
+        BFsinkAttr_t* attrs = realloc( list->attrs, newSize * sizeof *attrs );
+        hid_t* spaces = attrs ? realloc( list->spaces, newSize * sizeof *spaces ) : NULL;
+        void** raws = spaces ? realloc( list->raw, newSize * sizeof *raws ) : NULL;
+        char*** stringPtrs = raws ? realloc( list->strings, newSize * sizeof *stringPtrs ) : NULL;
+
+        if ( attrs ) list->attrs = attrs;
+        if ( spaces ) list->spaces = spaces;
+        if ( raws ) list->raw = raws;
+        if ( stringPtrs == NULL )
         {
             FATAL_MSG("Failed to allocate memory.\n");
-            return FATAL_ERR;
+            goto cleanup;
         }
-        *granList = (char*) tempPtr;
+        list->strings = stringPtrs;
+        list->size = newSize;
+    }
+
+    list->attrs[list->num].name = nameCopy;
+    list->attrs[list->num].type = memType;
+    list->attrs[list->num].numElems = (size_t) numElems;
+    list->attrs[list->num].value = strings ? (void*) strings : raw;
+    list->spaces[list->num] = space;
+    list->raw[list->num] = raw;
+    list->strings[list->num] = strings;
+    list->num++;
+    nameCopy = NULL;
+    raw = NULL;
+    strings = NULL;
+    memType = -1;
+    space = -1;
+    ret = 0;
+
+cleanup:
+    free(nameCopy);
+    free(raw);
+    free(strings);
+    if ( memType >= 0 ) H5Tclose(memType);
+    if ( space >= 0 ) H5Sclose(space);
+    if ( fileType >= 0 ) H5Tclose(fileType);
+    H5Aclose(attrID);
+
+    return ret;
+}
 
-        *curSize = max( (*curSize) * 2 , granListSize+granLen+2);
-    }
+/* Get the path of the first dimension scale attached to a dimension */
+static herr_t getScalePath( hid_t dsetID, unsigned int dim, hid_t scaleID, void* opdata )
+{
+    char** path = (char**) opdata;
+    ssize_t len = H5Iget_name( scaleID, NULL, 0 );
 
-    strncat( *granList, newGran, granLen );
+    (void) dsetID;
+    (void) dim;
 
-    // Set the comma and null terminator on the ends of the granule list
-    size_t newGranListSize = strlen(*granList);
-    (*granList)[newGranListSize]   = ',';
-    (*granList)[newGranListSize+1] = '\0';
+    if ( len <= 0 )
+        return 0;
+    *path = malloc( len + 1 );
+    if ( *path == NULL || H5Iget_name( scaleID, *path, len + 1 ) < 0 )
+    {
+        free(*path);
+        *path = NULL;
+        return -1;
+    }
 
-    return RET_SUCCESS;
+    return 1;
 }
 
-// Quick check for MODIS change dimension(code copied from copyDimension.)
-herr_t copyDimension_MODIS_Special( char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID )
+/* Read one dataset with its attributes and dimension scales and hand it to the sink */
+static herr_t sendDataset( BFcontext_t* ctx, hid_t locID, const char* name, const char* fullPath )
 {
-    hsize_t tempInt = 0;
-    char* correct_dsetname = NULL;
-    char* dimName = NULL;
-    herr_t errStatus = 0;
-    int32 ntype = 0;
-    int32 h4dsetID = 0;
-    intn statusn = 0;
+    BFsinkDataset_t dataset;
+    sinkAttrList_t attrs;
+    hsize_t dims[H5S_MAX_RANK];
+    char* scalePaths[H5S_MAX_RANK] = { NULL };
+    char* groupPath = NULL;
+    char* slash = NULL;
+    void* buffer = NULL;
+    hid_t dsetID = -1;
+    hid_t fileType = -1;
+    hid_t memType = -1;
+    hid_t space = -1;
+    hssize_t numElems = 0;
     int rank = 0;
-    int status = 0;
-    hid_t h5dimID = 0;
-    void *dimBuffer = NULL;
-    short fail = 0;
-    hid_t memspace = 0;
-    htri_t dsetExists = 0;
-    short wasHardCodeCopy = 0;
-    char* catString = NULL;
-    char* temp = NULL;
-    char tempStack[STR_LEN] = {'\0'};
+    int fail = 0;
 
-    /* Get dataset index */
-    int32 sds_index = SDnametoindex(h4fileID, h4datasetName );
-    if ( sds_index == FAIL )
+    memset( &attrs, 0, sizeof attrs );
+    memset( &dataset, 0, sizeof dataset );
+
+    dsetID = H5Dopen2( locID, name, H5P_DEFAULT );
+    if ( dsetID < 0 )
     {
-        FATAL_MSG("Failed to get SD index.\n");
+        FATAL_MSG("Failed to open dataset %s.\n", fullPath);
         goto cleanupFail;
     }
-    /* select the dataset */
-    h4dsetID = SDselect(h4fileID, sds_index);
-    if ( h4dsetID == FAIL )
+    fileType = H5Dget_type( dsetID );
+    space = H5Dget_space( dsetID );
+    memType = fileType >= 0 ? H5Tget_native_type( fileType, H5T_DIR_ASCEND ) : -1;
+    rank = space >= 0 ? H5Sget_simple_extent_dims( space, dims, NULL ) : -1;
+    numElems = space >= 0 ? H5Sget_simple_extent_npoints( space ) : -1;
+    if ( memType < 0 || rank < 0 || numElems < 0 )
     {
-        h4dsetID = 0;
-        FATAL_MSG("Failed to select the HDF4 dataset.\n");
+        FATAL_MSG("Failed to get the type or dataspace of %s.\n", fullPath);
         goto cleanupFail;
     }
 
-    /* get the rank of the dataset so we know how many dimensions to copy */
-    statusn = SDgetinfo(h4dsetID, NULL, &rank, NULL, NULL, NULL );
-    if ( statusn == FAIL )
+    buffer = calloc( numElems ? numElems : 1, H5Tget_size( memType ) );
+    groupPath = malloc( strlen(fullPath) + 2 );
+    if ( buffer == NULL || groupPath == NULL )
     {
-        FATAL_MSG("Failed to get SD info.\n");
+        FATAL_MSG("Failed to allocate memory.\n");
         goto cleanupFail;
     }
-
-
-    int32 dim_index;
-
-    // COPY OVER DIMENSION SCALES TO HDF5 OBJECT
-    dimName = calloc(500, 1);
-    int32 size = 0;
-    int32 num_attrs = 0;
-    hid_t h5type = 0;
-    int32 h4dimID = 0;
-
-    for ( dim_index = 0; dim_index < rank; dim_index++ )
+    if ( numElems && H5Dread( dsetID, memType, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer ) < 0 )
     {
-        // Get the dimension ID
-        h4dimID = SDgetdimid ( h4dsetID, dim_index );
-        if ( h4dimID == FAIL )
-        {
-            FATAL_MSG("Failed to get dimension ID.\n");
-            h4dimID = 0;
-            goto cleanupFail;
-        }
-
-
-        /* get various useful info about this dimension */
-        statusn = SDdiminfo( h4dimID, dimName, &size, &ntype, &num_attrs );
-        //int32 dimRank = 0;
-        //int32 dimSizes = 0;
-        //statusn = SDgetinfo( h4dimID, dimName, &dimRank, &dimSizes, &ntype, &num_attrs);
-        if ( statusn == FAIL )
-        {
-            FATAL_MSG("Failed to get dimension info.\n");
-            goto cleanupFail;
-        }
-
-
-        /* If dimSuffix is provided, we need to append this string to the dimName variable.*/
-       
-        correct_dsetname = correct_name(dimName);
-
-        if ( dimSuffix ) 
-        {
-            // store allocated memory in temp pointer
-            strcpy(tempStack, dimName);
-            temp = calloc ( sizeof(tempStack) + sizeof(dimSuffix) + 1, 1 );
-            // copy dimName to the temp pointer memory
-            strcpy(temp, tempStack);
-            // concatenate dimName with dimSuffix
-            strcat(temp,dimSuffix);
-            // Fix the name to comply with netCDF standards
-            catString = correct_name(temp);
-            // free the temp memory (catString is separately allocated memory, malloc'ed in the correct_name function
-            free(temp); temp = NULL;
-        }
-        else
-        {
-           char* special_suffix;
-           unsigned short have_special_suffix = 0;
-           if(size == 2040 || size == 4080 || size == 8160){
-             special_suffix = "_2";
-             have_special_suffix = 1;
-           }
-           else if(size == 2050 || size == 4100 || size == 8200){
-             special_suffix = "_3";
-             have_special_suffix = 1;
-           }
-           else if(size == 2060 || size == 4120 || size == 8240){
-             special_suffix = "_4";
-             have_special_suffix = 1;
-           }
-           else if(size == 2070 || size == 4140 || size == 8280){
-             special_suffix = "_5";
-             have_special_suffix = 1;
-           }
-           else if(size == 2080 || size == 4160 || size == 8320){
-             special_suffix = "_6";
-             have_special_suffix = 1;
-           }
-           else if(size == 2090 || size == 4180 || size == 8360){
-             special_suffix = "_7";
-             have_special_suffix = 1;
-           }
-           else if(size == 2100 || size == 4200 || size == 8400){
-             special_suffix = "_8";
-             have_special_suffix = 1;
-           }
-           else if(size == 2020 || size == 4040 || size == 8080){
-             special_suffix = "_a";
-             have_special_suffix = 1;
-           }
-            else if(size == 2010 || size == 4020 || size == 8040){
-             special_suffix = "_b";
-             have_special_suffix = 1;
-           }
-           else if(size == 2000 || size == 4000 || size == 8000){
-             special_suffix = "_c";
-             have_special_suffix = 1;
-           }
-           else if(size == 1990 || size == 3980 || size == 7960){
-             special_suffix = "_d";
-             have_special_suffix = 1;
-           }
-           else if(size == 1980 || size == 3960 || size == 7920){
-             special_suffix = "_e";
-             have_special_suffix = 1;
-           }
-           else if(size == 1970 || size == 3940 || size == 7880){
-             special_suffix = "_f";
-             have_special_suffix = 1;
-           }
-           else if(size == 1960 || size == 3920 || size == 7840){
-             special_suffix = "_g";
-             have_special_suffix = 1;
-           }
-           else if(size == 1950 || size == 3900 || size == 7800){
-             special_suffix = "_h";
-             have_special_suffix = 1;
-           }
- 
-           if(have_special_suffix == 1) {
-            // store allocated memory in temp pointer
-            strcpy(tempStack, dimName);
-            temp = calloc ( sizeof(tempStack) + sizeof(special_suffix) + 1, 1 );
-            // copy dimName to the temp pointer memory
-            strcpy(temp, tempStack);
-            // concatenate dimName with dimSuffix
-            strcat(temp,special_suffix);
-            // Fix the name to comply with netCDF standards
-            catString = correct_name(temp);
-            // free the temp memory (catString is separately allocated memory, malloc'ed in the correct_name function
-            free(temp); temp = NULL;
- 
-           }
-           else 
-             catString = correct_name(dimName);
-        }
-        /* Since dimension scales are shared, it is possible this dimension already exists in HDF5 file (previous
-           call to this function created it). Check to see if it does. If so, use the dimension that eixsts.
-        */
-        
-        free(correct_dsetname); correct_dsetname = NULL;
+        FATAL_MSG("Failed to read %s.\n", fullPath);
+        goto cleanupFail;
+    }
 
-        dsetExists = H5Lexists(h5dimGroupID, catString, H5P_DEFAULT);
-        // if dsetExists is <= 0, then dimension does not yet exist.
-        if ( dsetExists <= 0 )
+    if ( H5Aiterate2( dsetID, H5_INDEX_NAME, H5_ITER_INC, NULL, readSinkAttr, &attrs ) < 0 )
+    {
+        FATAL_MSG("Failed to read the attributes of %s.\n", fullPath);
+        goto cleanupFail;
+    }
+
+    for ( int i = 0; i < rank; i++ )
+        if ( H5DSget_num_scales( dsetID, (unsigned int) i ) > 0 &&
+             H5DSiterate_scales( dsetID, (unsigned int) i, NULL, getScalePath, &scalePaths[i] ) < 0 )
         {
-            /* If the dimension is one of the following, we will do an explicit dimension scale copy (hard code
-             * the scale values)
-             */
-            if ( strstr( catString, "Band_250M" ) != NULL )
-            {
-                tempInt = 2;
-                float floatBuffer[2] = {1.0f, 2.0f};
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                /* The dimensions in this if else chain are pure dimensions in HDF4, but we want to convert them to a real
-                 * dimension in the HDF5 file. Set this flag to 1 to indicate that the final result IS a real dimension.
-                 * Flag will be used to prevent setting the NAME attribute downstream
-                 */
-                wasHardCodeCopy = 1;
-            }
-            else if ( strstr( catString, "Band_500M" ) != NULL )
-            {
-                tempInt = 5;
-                float floatBuffer[5] = {3.0f, 4.0f, 5.0f, 6.0f, 7.0f};
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                wasHardCodeCopy = 1;
-            }
-            else if ( strstr( catString, "Band_1KM_RefSB" ) != NULL )
-            {
-                float floatBuffer[15] = { 8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 13.5f, 14.0f, 14.5f, 15.0f, 16.0f, 17.0f, 18.0f, 19.0f, 26.0f };
-                tempInt = 15;
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                wasHardCodeCopy = 1;
-            }
-            else if ( strstr( catString, "Band_1KM_Emissive" ) != NULL )
-            {
-                float floatBuffer[16] = { 20.0f, 21.0f, 22.0f, 23.0f, 24.0f, 25.0f, 27.0f, 28.0f, 29.0f, 30.0f, 31.0f, 32.0f, 33.0f, 34.0f, 35.0f, 36.0f };
-                tempInt = 16;
-                h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, H5T_NATIVE_FLOAT, catString, floatBuffer);
-                if ( h5dimID == FATAL_ERR )
-                {
-                    h5dimID = 0;
-                    FATAL_MSG("Failed to insert dataset.\n");
-                    goto cleanupFail;
-                }
-                wasHardCodeCopy = 1;
-            }
+            FATAL_MSG("Failed to get the dimension scales of %s.\n", fullPath);
+            goto cleanupFail;
+        }
 
-            /* Else, the dimension is none of those listed. Do a normal copy by reading scale values from
-               the input file (a non-hard coded copy)
-             */
-            else
-            {
-                wasHardCodeCopy = 0;
-                /* SDdiminfo will return 0 for ntype if the dimension has no scale information. This is the case when
-                   it is a pure dimension.  We need two separate cases for when it is and is not a pure dim
-                */
+    strcpy( groupPath, fullPath );
+    slash = strrchr( groupPath, '/' );
+    if ( slash == groupPath )
+        slash[1] = '\0';
+    else
+        *slash = '\0';
 
-                if ( ntype != 0 )
-                {
-                    /* get the correct HDF5 datatype from ntype */
-                    status = h4type_to_h5type( ntype, &h5type );
-                    if ( status != 0 )
-                    {
-                        FATAL_MSG("Failed to convert HDF4 to HDF5 datatype.\n");
-                        goto cleanupFail;
-                    }
+    dataset.groupPath = groupPath;
+    dataset.name = slash == groupPath ? fullPath + 1 : fullPath + ( slash - groupPath ) + 1;
+    dataset.rank = rank;
+    dataset.dims = dims;
+    dataset.dimScales = (const char* const*) scalePaths;
+    dataset.type = memType;
+    dataset.buffer = buffer;
+    dataset.numAttrs = attrs.num;
+    dataset.attrs = attrs.attrs;
 
-                    /* read the dimension scale into a buffer */
-                    dimBuffer = malloc(size);
-                    //int32 start[1] = {0};
-                    //int32 stride[1] = {1};
-                    //statusn = SDreaddata( h4dimID, start, stride, &dimSizes, dimBuffer );
-                    statusn = SDgetdimscale(h4dimID, dimBuffer);
-                    if ( statusn != 0 )
-                    {
-                        FATAL_MSG("Failed to get dimension scale.\n");
-                        goto cleanupFail;
-                    }
+    if ( ctx->sink->dataset( ctx->sink->userData, &dataset ) < 0 )
+    {
+        FATAL_MSG("The sink did not take %s.\n", fullPath);
+        goto cleanupFail;
+    }
 
-                    /* make a new dataset for our dimension scale */
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
 
-                    tempInt = size;
-                    h5dimID = insertDataset(&outputFile, &h5dimGroupID, 1, 1, &tempInt, h5type, catString, dimBuffer);
-                    if ( h5dimID == FATAL_ERR )
-                    {
-                        h5dimID = 0;
-                        FATAL_MSG("Failed to insert dataset.\n");
-                        goto cleanupFail;
-                    }
+    if ( buffer && memType >= 0 && space >= 0 )
+        H5Dvlen_reclaim( memType, space, H5P_DEFAULT, buffer );
+    free(buffer);
+    free(groupPath);
+    for ( int i = 0; i < rank; i++ )
+        free(scalePaths[i]);
+    freeSinkAttrs( &attrs );
+    if ( memType >= 0 ) H5Tclose(memType);
+    if ( fileType >= 0 ) H5Tclose(fileType);
+    if ( space >= 0 ) H5Sclose(space);
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
 
-                    free(dimBuffer);
-                    dimBuffer = NULL;
-                }
+    if ( fail ) return FATAL_ERR;
+    return RET_SUCCESS;
+}
 
-                else
-                {
-                    hsize_t tempSize2 = 0;
+/* Hand the attributes of one group to the sink */
+static herr_t sendGroup( BFcontext_t* ctx, hid_t locID, const char* name, const char* fullPath )
+{
+    sinkAttrList_t attrs;
+    hid_t groupID = -1;
+    herr_t status = RET_SUCCESS;
 
-                    tempSize2 = (hsize_t) size;
-                    memspace = H5Screate_simple( 1, &tempSize2, NULL );
+    memset( &attrs, 0, sizeof attrs );
 
-                    h5dimID = H5Dcreate( h5dimGroupID, catString, H5T_NATIVE_INT, memspace,
-                                         H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
-                    if ( h5dimID < 0 )
-                    {
-                        FATAL_MSG("Failed to create dataset.\n");
-                        h5dimID = 0;
-                        goto cleanupFail;
-                    }
+    groupID = H5Oopen( locID, name, H5P_DEFAULT );
+    if ( groupID < 0 )
+    {
+        FATAL_MSG("Failed to open group %s.\n", fullPath);
+        return FATAL_ERR;
+    }
+    if ( H5Aiterate2( groupID, H5_INDEX_NAME, H5_ITER_INC, NULL, readSinkAttr, &attrs ) < 0 )
+    {
+        FATAL_MSG("Failed to read the attributes of %s.\n", fullPath);
+        status = FATAL_ERR;
+    }
+    else if ( ctx->sink->group( ctx->sink->userData, fullPath, attrs.num, attrs.attrs ) < 0 )
+    {
+        FATAL_MSG("The sink did not take the group %s.\n", fullPath);
+        status = FATAL_ERR;
+    }
 
-                    H5Sclose(memspace);
-                    memspace = 0;
+    freeSinkAttrs( &attrs );
+    H5Oclose( groupID );
 
-                } // end else
-            } // end else
+    return status;
+}
 
-            errStatus = H5DSset_scale(h5dimID, catString);
-            if ( errStatus != 0 )
-            {
-                FATAL_MSG("Failed to set dataset as a dimension scale.\n");
-                goto cleanupFail;
-            }
+/* Whether the dataset name under locID is a dimension scale. Errors count as one, which keeps the dataset. */
+static int isDimScale( hid_t locID, const char* name )
+{
+    hid_t dsetID = H5Dopen2( locID, name, H5P_DEFAULT );
+    htri_t isScale = dsetID >= 0 ? H5DSis_scale( dsetID ) : -1;
 
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    return isScale != 0;
+}
 
-            /* Correct the NAME attribute of the pure dimension to conform with netCDF
-               standards.
-            */
-            if ( ntype == 0 && !wasHardCodeCopy )
-            {
-                statusn = change_dim_attr_NAME_value(h5dimID);
-                if ( statusn == FAIL )
-                {
-                    FATAL_MSG("Failed to change the NAME attribute of a dimension.\n");
-                    goto cleanupFail;
-                }
-            }
-        } // end if ( dsetExists <= 0 )
+/* Hand one dataset to the sink unless it was handed over before. H5Ovisit visits an object once, so the
+ * addresses of this visit are appended unsorted past ctx->sinkSentNum and only the sorted part is searched.
+ */
+static herr_t sinkVisitObject( hid_t locID, const char* name, const H5O_info_t* info, void* opdata )
+{
+    sinkVisit_t* visit = (sinkVisit_t*) opdata;
+    BFcontext_t* ctx = visit->ctx;
+    size_t slot = ctx->sinkSentNum + visit->numNew;
+    char* fullPath = NULL;
+    herr_t status = RET_SUCCESS;
 
+    if ( info->type == H5O_TYPE_GROUP && visit->withGroups && ctx->sink->group )
+    {
+        /* The visit starts with the group itself, named "." */
+        fullPath = malloc( strlen(visit->basePath) + strlen(name) + 2 );
+        if ( fullPath == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return -1;
+        }
+        if ( strcmp( name, "." ) == 0 )
+            strcpy( fullPath, visit->basePath );
+        else if ( strcmp( visit->basePath, "/" ) == 0 )
+            sprintf( fullPath, "/%s", name );
         else
+            sprintf( fullPath, "%s/%s", visit->basePath, name );
+        status = sendGroup( ctx, locID, name, fullPath );
+        free(fullPath);
+        return status == FATAL_ERR ? -1 : 0;
+    }
+
+    if ( info->type != H5O_TYPE_DATASET ||
+         bsearch( &info->addr, ctx->sinkSent, ctx->sinkSentNum, sizeof(haddr_t), compareAddr ) != NULL )
+        return 0;
+
+    if ( slot == ctx->sinkSentSize )
+    {
+        size_t newSize = ctx->sinkSentSize ? 2 * ctx->sinkSentSize : 256;
+        haddr_t* tempPtr = realloc( ctx->sinkSent, newSize * sizeof(haddr_t) );
+        if ( tempPtr == NULL )
         {
-            h5dimID = H5Dopen2(h5dimGroupID, catString, H5P_DEFAULT);
-            if ( h5dimID < 0 )
+            FATAL_MSG("Failed to allocate memory.\n");
+            return -1;
+        }
+        ctx->sinkSent = tempPtr;
+        ctx->sinkSentSize = newSize;
+    }
+
+    fullPath = malloc( strlen(visit->basePath) + strlen(name) + 2 );
+    if ( fullPath == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return -1;
+    }
+    if ( strcmp( visit->basePath, "/" ) == 0 )
+        sprintf( fullPath, "/%s", name );
+    else
+        sprintf( fullPath, "%s/%s", visit->basePath, name );
+
+    status = sendDataset( ctx, locID, name, fullPath );
+    if ( status == FATAL_ERR )
+    {
+        free(fullPath);
+        return -1;
+    }
+
+    /* A removed dataset is not visited again, and its address may be taken by a later one */
+    if ( visit->trim && !isDimScale( locID, name ) )
+    {
+        if ( visit->numTrim == visit->sizeTrim )
+        {
+            size_t newSize = visit->sizeTrim ? 2 * visit->sizeTrim : 64;
+            char** tempPtr = realloc( visit->trimPaths, newSize * sizeof(char*) );
+            if ( tempPtr == NULL )
             {
-                h5dimID = 0;
-                FATAL_MSG("Failed to open dataset.\n");
-                goto cleanupFail;
+                FATAL_MSG("Failed to allocate memory.\n");
+                free(fullPath);
+                return -1;
             }
+            visit->trimPaths = tempPtr;
+            visit->sizeTrim = newSize;
         }
+        visit->trimPaths[visit->numTrim++] = fullPath;
+        return 0;
+    }
+    free(fullPath);
 
+    ctx->sinkSent[slot] = info->addr;
+    visit->numNew++;
 
-        errStatus = H5DSattach_scale(h5dsetID, h5dimID, dim_index);
-        if ( errStatus != 0 )
+    return 0;
+}
+
+/* Remove a dataset handed to the sink from the output file, detaching its dimension scales first so that no
+ * scale refers to it */
+static herr_t trimDataset( hid_t fileID, const char* path )
+{
+    hid_t dsetID = H5Dopen2( fileID, path, H5P_DEFAULT );
+    hid_t space = dsetID >= 0 ? H5Dget_space( dsetID ) : -1;
+    int rank = space >= 0 ? H5Sget_simple_extent_ndims( space ) : -1;
+    herr_t status = rank < 0 ? FATAL_ERR : RET_SUCCESS;
+
+    for ( int i = 0; i < rank && status == RET_SUCCESS; i++ )
+        while ( status == RET_SUCCESS && H5DSget_num_scales( dsetID, (unsigned int) i ) > 0 )
         {
-            FATAL_MSG("Failed to attach dimension scale.\n");
-            goto cleanupFail;
+            char* scalePath = NULL;
+            hid_t scaleID = -1;
+
+            if ( H5DSiterate_scales( dsetID, (unsigned int) i, NULL, getScalePath, &scalePath ) < 0 ||
+                 scalePath == NULL || ( scaleID = H5Dopen2( fileID, scalePath, H5P_DEFAULT ) ) < 0 ||
+                 H5DSdetach_scale( dsetID, scaleID, (unsigned int) i ) < 0 )
+                status = FATAL_ERR;
+            if ( scaleID >= 0 ) H5Dclose(scaleID);
+            free(scalePath);
         }
 
-        free(correct_dsetname);
-        correct_dsetname = NULL;
-        H5Dclose(h5dimID);
-        h5dimID = 0;
-        free(catString); catString = NULL;
-    }   // end for loop
+    if ( space >= 0 ) H5Sclose(space);
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    if ( status == RET_SUCCESS && H5Ldelete( fileID, path, H5P_DEFAULT ) < 0 )
+        status = FATAL_ERR;
+    if ( status == FATAL_ERR )
+        FATAL_MSG("Failed to remove %s from the output file.\n", path);
 
-    fail = 0;
-    if ( 0 )
+    return status;
+}
+
+/*
+                    sinkDatasets
+    DESCRIPTION:
+        This function hands the datasets under path that were not handed over before to the sink of the
+        context (see BFsink_t in basicFusion.h). It is called when a unit of work is complete, so that every
+        dataset goes out with all its attributes and dimension scales, and once more for the whole file
+        at the end. The values are read back from the output file, which is in memory unless the sink keeps
+        the file. The groups are only handed over on request, at the end, when their attributes are final.
+
+        When the file is only in memory (the sink does not keep it), the datasets of a unit are removed from
+        it once they are handed over, so that the space they took is reused by the next unit. The dimension
+        scales stay, since later datasets attach to them. BF_COLLOCATE and BF_CHECKSUM read the datasets of
+        all instruments at the end of the run, so with either of them nothing is removed and the whole orbit
+        stays in memory. The last pass, with withGroups set, leaves the file as it is.
+    ARGUMENTS:
+        1. ctx        -- The conversion context. Does nothing if ctx->sink is NULL.
+        2. fileID     -- The output file
+        3. path       -- The absolute path of the group to visit, "/" for the whole file. A missing group is
+                         skipped.
+        4. withGroups -- Non-zero also hands the groups under path, path included, to the sink
+    EFFECTS:
+        Calls the sink. Removes the datasets handed over from the file as described above, and records the
+        addresses of the others in ctx->sinkSent.
+    RETURN:
+        FATAL_ERR on failure, including a sink returning a negative value
+        RET_SUCCESS on success
+*/
+
+herr_t sinkDatasets( BFcontext_t* ctx, hid_t fileID, const char* path, int withGroups )
+{
+    sinkVisit_t visit;
+    htri_t exists = 1;
+    herr_t status = 0;
+
+    if ( ctx->sink == NULL || ctx->sink->dataset == NULL )
+        return RET_SUCCESS;
+
+    memset( &visit, 0, sizeof visit );
+    visit.ctx = ctx;
+    visit.basePath = path;
+    visit.withGroups = withGroups;
+    visit.trim = !ctx->sink->keepFile && !withGroups && !ctx->collocate && !ctx->checksum;
+
+    if ( strcmp( path, "/" ) != 0 )
+        exists = H5Lexists( fileID, path, H5P_DEFAULT );
+    if ( exists < 0 )
     {
-cleanupFail:
-        fail = 1;
+        FATAL_MSG("Failed to check whether %s exists.\n", path);
+        return FATAL_ERR;
     }
+    if ( exists == 0 )
+        return RET_SUCCESS;
 
-    if ( dimName ) free ( dimName );
-    if ( h5dimID ) H5Dclose(h5dimID);
-    if ( dimBuffer ) free(dimBuffer);
-    if ( correct_dsetname ) free(correct_dsetname);
-    if ( memspace ) H5Sclose(memspace);
-    if ( catString ) free(catString);
-    if ( temp ) free(temp);
-
-    if ( fail ) return FAIL;
+    status = H5Ovisit_by_name( fileID, path, H5_INDEX_NAME, H5_ITER_INC, sinkVisitObject, &visit, H5P_DEFAULT );
 
-    return SUCCEED;
+    ctx->sinkSentNum += visit.numNew;
+    qsort( ctx->sinkSent, ctx->sinkSentNum, sizeof(haddr_t), compareAddr );
 
-}
+    /* H5Ovisit must not see the links change, so the datasets are removed after it */
+    for ( size_t i = 0; i < visit.numTrim; i++ )
+    {
+        if ( status >= 0 && trimDataset( fileID, visit.trimPaths[i] ) == FATAL_ERR )
+            status = FATAL_ERR;
+        free(visit.trimPaths[i]);
+    }
+    free(visit.trimPaths);
 
+    if ( status < 0 )
+    {
+        FATAL_MSG("Failed to hand the datasets under %s to the sink.\n", path);
+        return FATAL_ERR;
+    }
 
+    return RET_SUCCESS;
+}
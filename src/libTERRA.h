@@ -5,6 +5,8 @@
 #include <mfhdf.h>
 #include <hdf5.h>
 #include <hdf5_hl.h>
+#include "orbitTable.h"
+#include "basicFusion.h"
 #define DEBUG 0
 #define DIM_MAX 10
 #define FATAL_MSG( ... ) \
@@ -38,24 +40,6 @@ do { \
     #define min( a, b ) ( ((a) < (b)) ? (a) : (b) )
 #endif
 
-typedef struct OInfo
-{
-    unsigned int orbit_number;
-    unsigned short start_year;
-    unsigned char  start_month;
-    unsigned char start_day;
-    unsigned char start_hour;
-    unsigned char start_minute;
-    unsigned char start_second;
-    unsigned short end_year;
-    unsigned char  end_month;
-    unsigned char end_day;
-    unsigned char end_hour;
-    unsigned char end_minute;
-    unsigned char end_second;
-
-} OInfo_t;
-
 typedef struct GDateInfo
 {
     unsigned short year;
@@ -67,71 +51,334 @@ typedef struct GDateInfo
 
 } GDateInfo_t;
 
+/* Output modes of the MODIS, ASTER and MISR radiances, set by TERRA_DATA_UNPACK (see initContext) */
+#define UNPACK_NONE 0
+#define UNPACK_FLOAT 1
+#define UNPACK_SCALED 2
+/* Packed fill value of scaled MISR radiances, above the 14-bit DNs */
+#define MISR_SCALED_FILL 65535
+
+/* BF_KEEP_BITS rounds unpacked radiances to at most KEEP_BITS_MAX mantissa bits (see bitRoundFloat) */
+#define KEEP_BITS_MAX 23
+#define KEEP_BITS_ATTR "_QuantizeBitRoundNumberOfSignificantBits"
+
+/* BF_STATS: statistics of the unpacked radiances, per dataset and per tile of rows (see initDatasetStats) */
+#define STATS_HIST_BINS 64
+#define STATS_TILE_ELEMS (64*1024)
+#define STATS_TABLE_SUFFIX "_tile_stats"
+typedef struct tileStats
+{
+    uint32_t rowStart;
+    uint32_t rowCount;
+    uint64_t validCount;
+    uint64_t fillCount;
+    float min;
+    float max;
+    double sum;
+} tileStats_t;
+
+typedef struct datasetStats
+{
+    int enabled;
+    size_t tileElems;           // Elements per tile: whole rows of the slowest dimension
+    size_t tileRows;
+    size_t numTiles;
+    float fillMin;
+    float fillMax;
+    float histMin;
+    float histMax;
+    tileStats_t* tiles;
+    uint64_t hist[STATS_HIST_BINS];
+} datasetStats_t;
+
+/* BF_OVERVIEWS: levels of 2x downsampled copies of the unpacked radiances (see writeOverviews) */
+#define OVERVIEW_MAX_LEVELS 8
+#define OVERVIEW_SUFFIX "_overview_"
+
+/* Bounding boxes of the geolocation, stored in SPATIAL_INDEX_GROUP (see indexGeolocation). The
+ * SPATIAL_UNIT values are the rows of the geolocation datasets per box. */
+#define SPATIAL_INDEX_GROUP "BF_SpatialIndex"
+#define SPATIAL_UNIT_MODIS 10           // One scan of the 1 km geolocation
+#define SPATIAL_UNIT_MISR 1             // One SOM block
+#define SPATIAL_UNIT_CERES 1000         // A run of footprints
+#define SPATIAL_UNIT_MOPITT 32          // A track segment
+#define SPATIAL_UNIT_ALL 0              // The whole dataset (ASTER granules and subsystems)
+typedef struct spatialBox
+{
+    uint32_t rowStart;
+    uint32_t rowCount;
+    float latMin;
+    float latMax;
+    float lonMin;               // lonMin > lonMax if the box crosses the antimeridian
+    float lonMax;
+} spatialBox_t;
+
+/* BF_COLLOCATE=1: the MODIS and ASTER pixels within each CERES footprint and MISR block, stored in
+ * COLLOCATION_GROUP as runs of consecutive pixels (see collocateInstruments) */
+#define COLLOCATION_GROUP "BF_Collocation"
+#define COLLOCATE_CERES_KM 10.0         // Default footprint radius (BF_COLLOCATE_CERES_KM), the CERES FOV at nadir
+#define COLLOCATE_MISR_KM 1.1           // Spacing of the MISR low-resolution geolocation
+#define COLLOCATE_MAX_HITS 16           // Footprints kept per pixel
+typedef struct collocRun
+{
+    uint32_t target;            // Index into the targets dataset
+    uint32_t start;             // First pixel, as an index into the flattened target geolocation
+    uint32_t count;
+} collocRun_t;
+
+/* BF_CHECKSUM=1: XXH64 checksums of the values written by insertDataset, per block and per dataset
+ * (see writeChecksums), and a manifest of all checksums in CHECKSUM_GROUP (see writeChecksumManifest) */
+#define CHECKSUM_GROUP "BF_Checksums"
+#define CHECKSUM_ATTR "checksum_xxh64"
+#define CHECKSUM_BLOCKS_ATTR "checksum_xxh64_blocks"
+#define CHECKSUM_BLOCK_DIMS_ATTR "checksum_block_dims"
+#define CHECKSUM_BLOCK_BYTES (4*1024*1024)     // Block size of contiguous datasets
+#define CHECKSUM_MAX_BLOCKS 4096                // Blocks are merged beyond this, to bound the attribute size
+typedef struct checksumEntry
+{
+    char* path;
+    uint64_t checksum;
+    uint64_t numBlocks;
+} checksumEntry_t;
+
+/* BF_GRANULE_METADATA=echo10 or json: CMR granule metadata of the output file, written next to it when it is
+ * closed (see collectGranuleMetadata and writeGranuleMetadata) */
+#define GRANULE_COLLECTION "BASICTERRAFUSION"     // Collection of CMR/sample_echo10.xml
+#define GRANULE_COLLECTION_VERSION "1.0"
+#define GRANULE_META_NONE 0
+#define GRANULE_META_ECHO10 1
+#define GRANULE_META_JSON 2
+typedef struct granuleMeta
+{
+    int format;                 // One of the GRANULE_META values
+    OInfo_t orbit;              // Orbit, narrowed to BF_TIME_WINDOW
+    int haveExtent;             // Zero if the file has no spatial index
+    spatialBox_t extent;
+    hsize_t linkedBytes;        // Size of the sub-files linked from the output file
+} granuleMeta_t;
+
+/* Inputs named archive.tar/member in the input file list are read from the archive (see tarInput.c) */
+#define TAR_BLOCK 512
+#define TAR_STAGE_BYTES (4*1024*1024)   // Copy buffer for staging HDF4 members
+
+/* Output files built in memory grow in steps of STAGE_INCREMENT bytes (see createStagedOutputFile) */
+#define STAGE_INCREMENT (64*1024*1024)
+
+/* The Zarr v2 output (BF_OUTPUT_FORMAT=zarr) is a directory store fed through the sink (see zarrStore.c) */
+#define ZARR_CHUNK_BYTES (1024*1024)   // Uncompressed size the chunks are cut to
+typedef struct zarrStore zarrStore_t;
+
+/* Attributes collected in memory and written to one object in one pass (see initAttrStage) */
+#define ATTR_MAX_COMPACT 16
+#define ATTR_MIN_DENSE 12
+#define PURE_DIM_NAME_VALUE "This is a netCDF dimension but not a netCDF variable."
+typedef struct stagedAttr
+{
+    char* name;
+    hid_t type;
+    size_t numElems;            // 0 for a scalar attribute
+    void* value;
+} stagedAttr_t;
+
+typedef struct attrStage
+{
+    const struct BFcontext* ctx;    // For the string datatypes of stageAttrString
+    hid_t objectID;
+    stagedAttr_t* attrs;
+    size_t num;
+    size_t size;
+} attrStage_t;
+
+/* Spatial and temporal subsetting requested with BF_BBOX and BF_TIME_WINDOW (see initSubset) */
+#define SOM_NUM_BLOCKS 180
+typedef struct BFsubset
+{
+    int useBox;
+    double latMin;
+    double latMax;
+    double lonMin;              // lonMin > lonMax if the box crosses the antimeridian
+    double lonMax;
+    int useTime;
+    GDateInfo_t timeStart;
+    GDateInfo_t timeEnd;
+    int32 blockStart;           // Window of MISR SOM blocks read by H4readData. blockCount 0 reads all blocks.
+    int32 blockCount;
+} BFsubset_t;
+
+/* BF_KEEP_BITS: a default number of mantissa bits, then name=bits rules for single datasets (see getKeepBits) */
+#define MAX_KEEP_BITS_RULES 32
+typedef struct keepBitsRule
+{
+    char name[H4_MAX_NC_NAME];
+    int bits;
+} keepBitsRule_t;
+
+/* The state of one conversion. main sets it up with initContext and passes it to the instrument functions,
+ * which pass it on to the readThenWrite, insertDataset and dimension functions. The settings are read from
+ * the environment once by initContext instead of for every dataset. A context is not enough to run two
+ * conversions at once in one process: the run settings and output files of main.c (split output, resume,
+ * staging), bfSubset, the archive indexes and staged copies of tarInput.c are process-wide, and the layout
+ * profile and granule metadata format are read from the environment when they are used.
+ */
+typedef struct BFcontext
+{
+    hid_t outputFile;               // The output file, or the file of the current instrument with split output
+    double* TAI93toUTCoffset;       // TAI93 to UTC offsets by day, made by initializeTimeOffset when needed
+    int gzipLevel;                  // USE_GZIP: the deflate level of chunked datasets, 0 for none
+    short useChunk;                 // USE_CHUNK=1: write datasets chunked, and compressed with gzipLevel
+    int unpack;                     // TERRA_DATA_UNPACK: UNPACK_NONE, UNPACK_FLOAT or UNPACK_SCALED
+    int keepBitsDefault;            // BF_KEEP_BITS
+    int numKeepBitsRules;
+    keepBitsRule_t keepBitsRules[MAX_KEEP_BITS_RULES];
+    int stats;                      // BF_STATS=1 (see initDatasetStats)
+    int overviewLevels;             // BF_OVERVIEWS (see writeOverviews)
+    int checksum;                   // BF_CHECKSUM=1 (see writeChecksums)
+    int spatialIndex;               // BF_SPATIAL_INDEX, on unless 0 (see indexGeolocation)
+    int collocate;                  // BF_COLLOCATE=1 (see collocateInstruments)
+    double collocateCeresKm;        // BF_COLLOCATE_CERES_KM, COLLOCATE_CERES_KM by default
+    struct dimAttach* dimRegistry;  // Dimension scale attachments not yet written (see registerDimScale)
+    size_t dimRegistryNum;
+    size_t dimRegistrySize;
+    const BFsink_t* sink;           // Receives the datasets of the output (see sinkDatasets), or NULL
+    haddr_t* sinkSent;              // Sorted addresses of the datasets already handed to the sink
+    size_t sinkSentNum;
+    size_t sinkSentSize;
+    struct stringTypes* stringTypes;    // The datatypes of getStringType, made by initContext
+} BFcontext_t;
+
 /*********************
  *FUNCTION PROTOTYPES*
  *********************/
-extern hid_t outputFile;
-extern double* TAI93toUTCoffset; // The array containing the TAI93 to UTC offset values
+extern BFsubset_t bfSubset;
 int numDigits(int digit);
 
-int MOPITT( char* inputLine, OInfo_t cur_orbit_info);
-int CERES( char* argv[],int index,int ceres_fm_count,int32*,int32*,int32*);
+herr_t initContext( BFcontext_t* ctx );
+void freeContext( BFcontext_t* ctx );
+
+int MOPITT( BFcontext_t* ctx, char* inputLine, OInfo_t cur_orbit_info);
+int CERES( BFcontext_t* ctx, char* argv[],int index,int ceres_fm_count,int32*,int32*,int32*);
 int CERES_OrbitInfo(char*argv[],int* start_index_ptr,int* end_index_ptr,OInfo_t orbit_info);
-int MODIS( char* argv[],int modis_count,int unpack );
-int ASTER( char* argv[],int aster_count,int unpack );
-int MISR( char* fileList[],int unpack );
+int MODIS( BFcontext_t* ctx, char* argv[],int modis_count );
+int ASTER( BFcontext_t* ctx, char* argv[],int aster_count );
+int MISR( BFcontext_t* ctx, char* fileList[] );
 
-hid_t insertDataset( hid_t const *outputFileID, hid_t *datasetGroup_ID,
+hid_t insertDataset( const BFcontext_t* ctx, hid_t *datasetGroup_ID,
                      int returnDatasetID, int rank, hsize_t* datasetDims,
                      hid_t dataType, const char* datasetName, const void* data_out);
 
 /* The GZIP compression version of insertDataset */
-hid_t insertDataset_comp( hid_t const *outputFileID, hid_t *datasetGroup_ID,
+hid_t insertDataset_comp( const BFcontext_t* ctx, hid_t *datasetGroup_ID,
+                          int returnDatasetID, int rank, hsize_t* datasetDims,
+                          hid_t dataType, const char* datasetName, void* data_out,unsigned short is_modis);
+hid_t insertDataset_comp_shuffle( const BFcontext_t* ctx, hid_t *datasetGroup_ID,
                           int returnDatasetID, int rank, hsize_t* datasetDims,
                           hid_t dataType, const char* datasetName, void* data_out,unsigned short is_modis);
+hid_t insertDataset_comp_tiled( const BFcontext_t* ctx, hid_t *datasetGroup_ID, int returnDatasetID,
+                          int rank, hsize_t* datasetDims, hid_t dataType, const char* datasetName, void* data_out, int shuffle,
+                          const datasetStats_t* stats );
 
 herr_t openFile(hid_t *file, char* inputFileName, unsigned flags );
 herr_t createOutputFile( hid_t *outputFile, char* outputFileName);
+herr_t createStagedOutputFile( hid_t *outputFile, char* outputFileName );
+herr_t createMemoryOutputFile( hid_t *outputFile, char* outputFileName );
+herr_t spillStagedOutputFile( hid_t *outputFile, char* outputFileName );
+char* getSubFileName( const char* outputFileName, const char* instrument, int rank );
+herr_t linkSubFiles( hid_t masterFileID, char* subFileNames[], int numSubFiles );
+herr_t consolidateSubFiles( BFcontext_t* ctx, hid_t masterFileID, char* subFileNames[], int numSubFiles );
+herr_t copyObjAttrs( hid_t srcObjID, hid_t dstObjID );
+herr_t checkpointUnit( hid_t fileID, const char* instrument, int perGranule, int nextUnit, const char* granules );
+herr_t resumeFromCheckpoint( hid_t fileID, int* nextUnit );
+char* getAttrString( hid_t fileID, const char* objPath, const char* attrName );
+char* getUnitMarker( hid_t fileID, const char* objPath );
+herr_t removeCheckpoint( hid_t fileID );
+herr_t removeInstrument( hid_t fileID, const char* instrument );
+herr_t repackOutputFile( BFcontext_t* ctx, const char* fileName );
+herr_t initSubset( void );
+herr_t subsetOrbitInfo( OInfo_t* orbitInfo );
+int subsetPointInside( double lat, double lon );
+int subsetGranuleTime( char* pathname, int instrument );
+int subsetExtentOverlaps( const double* lat, const double* lon, size_t numPoints );
+int subsetSDSOverlaps( int32 inputFileID, const char* latName, const char* lonName, int32 dataType, int extentOnly );
+herr_t subsetTrackRange( const float* lat, const float* lon, int colatitude, size_t pointsPerTrack,
+                         unsigned int* start, unsigned int* end );
+herr_t indexGeolocation( const BFcontext_t* ctx, const char* instrument, hid_t groupID, const char* latName, const char* lonName,
+                         hsize_t unitRows );
+herr_t indexGeolocationBuffer( const BFcontext_t* ctx, const char* instrument, const char* latPath, const char* lonPath, const double* lat,
+                               const double* lon, hsize_t numRows, hsize_t rowElems, hsize_t unitRows );
+herr_t collocateInstruments( const BFcontext_t* ctx, hid_t fileID );
+herr_t writeChecksums( const BFcontext_t* ctx, hid_t datasetID, int rank, const hsize_t* dims, hid_t memType, const void* data,
+                       const hsize_t* chunkDims );
+herr_t writeChecksumManifest( const BFcontext_t* ctx, hid_t fileID );
+herr_t sinkDatasets( BFcontext_t* ctx, hid_t fileID, const char* path, int withGroups );
+int getGranuleMetadataFormat( void );
+herr_t collectGranuleMetadata( hid_t fileID, const OInfo_t* orbitInfo, granuleMeta_t* meta );
+herr_t writeGranuleMetadata( const char* fileName, const granuleMeta_t* meta, const char* granuleList );
+int tarMemberSize( const char* path, hsize_t* size );
+hid_t tarMemberFapl( const char* path );
+const char* inputFilePath( const char* path );
+void releaseStagedInputs( void );
+void closeTarInputs( void );
+zarrStore_t* zarrOpenStore( const char* dirName, int level );
+herr_t zarrSinkDataset( void* userData, const BFsinkDataset_t* dataset );
+herr_t zarrSinkGroup( void* userData, const char* groupPath, size_t numAttrs, const BFsinkAttr_t* attrs );
+herr_t zarrCloseStore( zarrStore_t* store, int consolidate );
 herr_t createGroup( hid_t const *referenceGroup, hid_t *newGroup, char* newGroupName);
 /* general type attribute creation */
 hid_t attributeCreate( hid_t objectID, const char* attrName, hid_t datatypeID );
 /* creates and writes a string attribute */
-hid_t attrCreateString( hid_t objectID, char* name, char* value );
+hid_t attrCreateString( const BFcontext_t* ctx, hid_t objectID, char* name, char* value );
+hid_t getStringType( const BFcontext_t* ctx, size_t size );
+void initAttrStage( const BFcontext_t* ctx, attrStage_t* stage, hid_t objectID );
+herr_t stageAttr( attrStage_t* stage, const char* name, hid_t memType, size_t numElems, const void* value );
+herr_t stageAttrString( attrStage_t* stage, const char* name, const char* value );
+herr_t flushAttrStage( attrStage_t* stage );
+void discardAttrStage( attrStage_t* stage );
+herr_t setAttrPhaseChange( hid_t plistID );
 
 int32 H4ObtainLoneVgroupRef(int32 file_id, char *groupname);
 
 int32 H4readData( int32 fileID, const char* datasetName, void** data,
                   int32 *rank, int32* dimsizes, int32 dataType,int32 *start,int32 *stride,int32 *count);
-hid_t readThenWrite( const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
+hid_t readThenWrite( BFcontext_t* ctx, const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
                      hid_t outputDataType, int32 inputFileID, unsigned short comp_flag );
-hid_t readThenWriteSubset( int CER_LATLON, const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
+hid_t readThenWriteSubset( BFcontext_t* ctx, int CER_LATLON, const char* outDatasetName, hid_t outputGroupID, const char* inDatasetName, int32 inputDataType,
                            hid_t outputDataType, int32 inputFileID,int32*start,int32*stride,int32*count );
 
 char *correct_name(const char* oldname);
 
 /* MOPITT functions */
-hid_t MOPITTaddDimension ( hid_t h5dimGroupID, const char* dimName, hsize_t dimSize, const void* scaleBuffer, hid_t dimScaleNumType );
-hid_t MOPITTinsertDataset( hid_t const *inputFileID, hid_t *datasetGroup_ID, char * inDatasetPath, char* outDatasetName, hid_t dataType, int returnDatasetID, unsigned int bound[2] );
+hid_t MOPITTaddDimension ( BFcontext_t* ctx, hid_t h5dimGroupID, const char* dimName, hsize_t dimSize, const void* scaleBuffer, hid_t dimScaleNumType );
+hid_t MOPITTinsertDataset( const BFcontext_t* ctx, hid_t const *inputFileID, hid_t *datasetGroup_ID, char * inDatasetPath, char* outDatasetName, hid_t dataType, int returnDatasetID, unsigned int bound[2] );
 herr_t MOPITT_OrbitInfo( const hid_t inputFile, OInfo_t cur_orbit_info, const char* timePath, unsigned int* start_indx_ptr,
                          unsigned int* end_indx_ptr );
 /* ASTER functions */
 
-hid_t readThenWrite_ASTER_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
+int getKeepBits( const BFcontext_t* ctx, const char* datasetName );
+void bitRoundFloat( float* data, size_t numElems, int keepBits, float fillMin, float fillMax );
+herr_t setKeepBitsAttr( hid_t datasetID, int keepBits );
+herr_t initDatasetStats( const BFcontext_t* ctx, datasetStats_t* stats, int32 rank, const int32* dims, float fillMin, float fillMax,
+                         float histMin, float histMax );
+void accumulateStats( datasetStats_t* stats, const float* data, size_t first, size_t numElems );
+herr_t writeDatasetStats( const BFcontext_t* ctx, datasetStats_t* stats, hid_t groupID, hid_t datasetID, const char* datasetName );
+void freeDatasetStats( datasetStats_t* stats );
+herr_t writeOverviews( const BFcontext_t* ctx, hid_t groupID, hid_t datasetID, const char* datasetName, const float* data, int32 rank,
+                       const int32* dims, float fillMin, float fillMax, unsigned short is_modis, short use_chunk );
+hid_t readThenWrite_ASTER_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
                                   int32 inputFile, float unc);
 
 /* MISR funcions */
-hid_t readThenWrite_MISR_Unpack( hid_t outputGroupID, char* cameraName,char* datasetName, char** correctedNameptr,int32 inputDataType,
+hid_t readThenWrite_MISR_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* cameraName,char* datasetName, char** correctedNameptr,int32 inputDataType,
                                  int32 inputFile, float scale_factor,unsigned short * has_LAI_POS_DIM_ptr);
-hid_t readThenWrite_MODIS_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
+hid_t readThenWrite_MODIS_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
                                   int32 inputFileID);
-hid_t readThenWrite_MODIS_Uncert_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
+hid_t readThenWrite_MODIS_Uncert_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
         int32 inputFileID);
-hid_t readThenWrite_MODIS_GeoMetry_Unpack( hid_t outputGroupID, char* datasetName, int32 inputDataType,
+hid_t readThenWrite_MODIS_GeoMetry_Unpack( BFcontext_t* ctx, hid_t outputGroupID, char* datasetName, int32 inputDataType,
         int32 inputFileID);
 
 
-herr_t convert_SD_Attrs(int32 sd_id,hid_t h5grp_id,char*h5dset_name,char*sds_name,char*ignore_attr_name);
-herr_t copy_h5_attrs(int32 h4_type,int32 n_values,char* attr_name,char* attr_value,hid_t grp, char* dset_name);
+herr_t convert_SD_Attrs(const BFcontext_t* ctx,int32 sd_id,hid_t h5grp_id,char*h5dset_name,char*sds_name,char*ignore_attr_name);
+herr_t copy_h5_attrs(const BFcontext_t* ctx,int32 h4_type,int32 n_values,char* attr_name,char* attr_value,hid_t grp, char* dset_name);
 herr_t H4readSDSAttr( int32 h4FileID, char* datasetName, char* attrName, void* buffer );
 herr_t copyAttrFromName( int32 inFileID, const char* inObjName, const char* attrName, hid_t outObjID );
 
@@ -145,26 +392,27 @@ int isLeapYear(int year);
 
 int  h4type_to_h5type( const int32 h4type, hid_t* h5memtype);
 
-int change_dim_attr_NAME_value(hid_t h5dset_id);
+int change_dim_attr_NAME_value( const BFcontext_t* ctx, hid_t h5dset_id );
 
-herr_t copyDimension( char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID );
-herr_t copyDimension_MODIS_Special( char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID );
+herr_t copyDimension( BFcontext_t* ctx, char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID );
+herr_t copyDimension_MODIS_Special( BFcontext_t* ctx, char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID );
 
-herr_t copyDimensionSubset( char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID,
+herr_t copyDimensionSubset( BFcontext_t* ctx, char* dimSuffix, int32 h4fileID, char* h4datasetName, hid_t h5dimGroupID, hid_t h5dsetID,
                             int32 s_size );
 
-herr_t attachDimension(hid_t h5fileID, char* dimname, hid_t h5dsetID, int dim_index);
+herr_t attachDimension( BFcontext_t* ctx, hid_t h5fileID, char* dimname, hid_t h5dsetID, int dim_index);
+herr_t registerDimScale( BFcontext_t* ctx, hid_t dsetID, hid_t scaleID, unsigned int idx );
+herr_t flushDimScales( BFcontext_t* ctx );
 //herr_t makePureDim( hid_t locID, const char* dimName, void* dataBuffer, hid_t dataspace, hid_t h5Type, hid_t* retID );
-herr_t makePureDim( hid_t locID, const char* dimName,  hid_t dataspace, hid_t h5Type, hid_t* retID );
+herr_t makePureDim( const BFcontext_t* ctx, hid_t locID, const char* dimName,  hid_t dataspace, hid_t h5Type, hid_t* retID );
 size_t obtainDimSize(hid_t dsetID);
-herr_t Generate2D_Dataset(hid_t h5_group,char* dsetname,hid_t h5_type,void* databuffer,hid_t dim0_id,hid_t dim1_id,size_t dim0_size,size_t dim1_size,unsigned short comp_flag);
+herr_t Generate2D_Dataset( BFcontext_t* ctx, hid_t h5_group,char* dsetname,hid_t h5_type,void* databuffer,hid_t dim0_id,hid_t dim1_id,size_t dim0_size,size_t dim1_size,unsigned short comp_flag);
 
-herr_t TAItoUTCconvert ( double* buffer, unsigned int size );
-herr_t TAItoUTCconvert ( double* buffer, unsigned int size );
+herr_t TAItoUTCconvert ( BFcontext_t* ctx, double* buffer, unsigned int size );
 herr_t binarySearchDouble ( const double* array, double target, hsize_t size, short unsigned int firstGreater, long int* targetIndex );
 herr_t getTAI93 ( GDateInfo_t date, double* TAI93timestamp );
 herr_t H5allocateMemDouble ( hid_t inputFile, const char* datasetPath, void** buffer, long int* size );
-herr_t initializeTimeOffset();
+herr_t initializeTimeOffset( BFcontext_t* ctx );
 
 int comp_greg(GDateInfo_t j1, GDateInfo_t j2);
 int comp_greg_utc(double greg, GDateInfo_t utc);
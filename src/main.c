@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L
 #include "libTERRA.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,15 +7,120 @@
 #include <assert.h>
 #include <curses.h>
 #include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef BF_MPI
+#include <mpi.h>
+#endif
 #define STR_LEN 500
 #define LOGIN_NODE "login"
 #define MOM_NODE
 
 int getNextLine ( char* string, FILE* const inputFile );
-int Add_CF_Provenance_Attrs();
-hid_t outputFile;
-
+int Add_CF_Provenance_Attrs( BFcontext_t* ctx );
+
+/* The units of work of one orbit (the MOPITT files, the CERES files, each MODIS granule, each ASTER
+ * granule and the MISR files) are numbered in input file order and dealt out round-robin to the ranks.
+ * Without BF_MPI there is only one rank, which owns every unit.
+ */
+static int mpiRank = 0;
+static int mpiSize = 1;
+
+/* Output layout. BF_SPLIT_OUTPUT writes each instrument to its own file, and the master file argv[1]
+ * links them. BF_CONSOLIDATE copies the sub-files back into a single file instead.
+ */
+enum { INSTR_MOPITT, INSTR_CERES, INSTR_MODIS, INSTR_ASTER, INSTR_MISR, NUM_INSTR };
+static const char* instrumentNames[NUM_INSTR] = { "MOPITT", "CERES", "MODIS", "ASTER", "MISR" };
+static int splitOutput = 0;
+static int consolidate = 0;
+static hid_t instrumentFiles[NUM_INSTR];
+
+/* Without MPI, split output is written concurrently by one process per instrument. splitWorker is the
+ * instrument of this process. The parent process writes MOPITT and assembles the master file.
+ */
+static int splitWorker = -1;
+static pid_t splitWorkerPids[NUM_INSTR];
+
+/* BF_RESUME keeps a checkpoint in each output file after every completed unit of work. An interrupted run
+ * started again with BF_RESUME set rolls its output files back to the last checkpoint and skips the units
+ * before resumeUnit. beginUnit tells what to do with a unit.
+ */
+enum { UNIT_SKIP, UNIT_DONE, UNIT_PROCESS };
+static int resumeMode = 0;
+static int resumeUnit[NUM_INSTR];
+
+/* BF_REFUSE_INSTRUMENT names one instrument to write again into an existing BF file argv[1]. Only the units
+ * of that instrument are processed, and its entries in InputGranules are replaced. BF_REPACK reclaims the
+ * space of the replaced group afterwards. granulePrefixes tell the instrument of an InputGranules entry.
+ */
+static int refuseInstrument = -1;
+static int repack = 0;
+static const char* granulePrefixes[NUM_INSTR] = { "MOP01", "CER_SSF", "MOD0", "AST_L1T", "MISR_" };
+
+/* BF_STAGE_MEMORY builds the output files in memory and writes each one to disk in one sequential stream
+ * when it is closed (see createStagedOutputFile). Its value is the memory ceiling in MiB. stagedNames holds
+ * the names of the files still in memory, indexed like instrumentFiles (the single output file uses slot
+ * 0). Once they grow past stageCeiling bytes, they are written out and the run goes on with direct writes.
+ */
+static hsize_t stageCeiling = 0;
+static char* stagedNames[NUM_INSTR];
+
+/* A sink given to bfConvert that does not keep the file: the output is built in memory and discarded */
+static int memoryOnly = 0;
+
+static int ownsUnit( int instrument, int unit );
+static herr_t openOutputFile( char* fileName, hid_t* fileID, int instrument );
+static hsize_t estimateOutputSize( const char* inputListName );
+static herr_t spillStagedFiles( BFcontext_t* ctx );
+static herr_t selectOutputFile( BFcontext_t* ctx, const char* masterFileName, int instrument );
+static int beginUnit( BFcontext_t* ctx, const char* masterFileName, int instrument, int unit );
+static herr_t endUnit( BFcontext_t* ctx, int instrument, int unit, int perGranule, const char* granules );
+static herr_t mergeGranuleList( const char* oldList, const char* newList, int instrument, char** merged, size_t* mergedSize );
+static herr_t appendHistory( hid_t fileID, const char* entry );
+static herr_t appendSubFileGranules( hid_t fileID, const char* granules );
+static char* gatherGranuleList( const char* granuleList, char* subFileNames[], int numSubFiles );
+static int assembleMaster( BFcontext_t* ctx, char* masterFileName, int localFail, char* granuleList, const OInfo_t* orbitInfo );
+static int convert( int argc, char* argv[], const BFsink_t* sink );
+
+#ifndef BF_LIBRARY
 int main( int argc, char* argv[] )
+{
+    return convert( argc, argv, NULL );
+}
+#endif
+
+/*
+                        bfConvert
+    DESCRIPTION:
+        The entry point of libbasicfusion (see basicFusion.h). It runs the conversion of the basicFusion
+        program on the given files and hands the datasets to sink.
+*/
+
+int bfConvert( const char* outputFile, const char* inputList, const char* orbitTable, const BFsink_t* sink )
+{
+    char* argv[5] = { "basicFusion", (char*) outputFile, (char*) inputList, (char*) orbitTable, NULL };
+
+    return convert( 4, argv, sink );
+}
+
+/*
+                        convert
+    DESCRIPTION:
+        This function is the basicFusion program: it fuses the orbit of the input file list argv[2] into
+        argv[1]. See the usage message for the arguments and the environment variables.
+    ARGUMENTS:
+        int argc                -- The number of arguments, 4
+        char* argv[]            -- The program name, the output file, the input file list and the orbit table
+        const BFsink_t* sink    -- Receives the datasets of the output (see sinkDatasets), or NULL
+    EFFECTS:
+        Writes the output file(s) and calls the sink.
+    RETURN:
+        0 on success, -1 on failure
+*/
+
+static int convert( int argc, char* argv[], const BFsink_t* sink )
 {
 
     /* Various arguments to each instrument function */
@@ -76,31 +182,193 @@ int main( int argc, char* argv[] )
     int32* ceres_subset_num_elems_ptr=NULL;
     int modis_count = 1;
     int aster_count = 1;
-    FILE* new_orbit_info_b = NULL;
+    orbitTable_t orbitTable = {0};
+    const OInfo_t* orbitRecord = NULL;
     OInfo_t current_orbit_info;
-    OInfo_t* test_orbit_ptr = NULL;
+    granuleMeta_t granuleMeta = {0};
 
     FILE* inputFile = NULL;
     char inputLine[STR_LEN];
     time_t sTime;
     time_t eTime;
 
-    /*MY 2016-12-21: GZ also requests to unpack the MODIS,ASTER and MISR data, this is the flag for this */
-    int unpack      = 1;
-    
-    /* LTC Jun 21, 2017: Add messages for when USE_GZIP and USE_CHUNK environment variables are set */
-    int useGZIP = 0;
-    int useChunk = 0;
+    /* The output file and the settings of the conversion (see initContext) */
+    BFcontext_t context = { 0 };
+    BFcontext_t* ctx = &context;
+
+    /* BF_OUTPUT_FORMAT=zarr writes the output to a Zarr store through a sink */
+    BFsink_t zarrSink = { zarrSinkDataset, NULL, 0, zarrSinkGroup };
+    zarrStore_t* zarrStore = NULL;
+
+    /* The name of the file this process writes to, and the index of the current unit of work */
+    char* outFileName = NULL;
+    char* subFileName = NULL;
+    int unit = 0;
+    int unitState = UNIT_PROCESS;
+    /* Length of the granule list when the current unit started */
+    size_t unitGranMark = 0;
+
+#ifdef BF_MPI
+    MPI_Init( &argc, &argv );
+    MPI_Comm_rank( MPI_COMM_WORLD, &mpiRank );
+    MPI_Comm_size( MPI_COMM_WORLD, &mpiSize );
+#endif
+
+    /* The settings of an earlier conversion in the same process (see bfConvert) */
+    splitOutput = 0;
+    consolidate = 0;
+    splitWorker = -1;
+    resumeMode = 0;
+    refuseInstrument = -1;
+    repack = 0;
+    stageCeiling = 0;
+    memoryOnly = 0;
+    memset( instrumentFiles, 0, sizeof(instrumentFiles) );
+    memset( splitWorkerPids, 0, sizeof(splitWorkerPids) );
+    memset( resumeUnit, 0, sizeof(resumeUnit) );
 
     if ( argc != 4 )
     {
         fprintf( stderr, "Usage: %s [outputFile] [inputFiles.txt] [orbit_info.bin]\n", argv[0] );
-        fprintf( stderr, "Set environment variable TERRA_DATA_UNPACK to zero to retain packed data.\n");
+        fprintf( stderr, "Set environment variable TERRA_DATA_UNPACK to zero to retain packed data, or to 2 for scaled integers with CF attributes.\n");
         fprintf( stderr, "Set environment variable USE_GZIP from 1 to 9 to set HDF compression level.\n");
         fprintf( stderr, "Set environment variable USE_CHUNK to enable HDF dataset chunking.\n");
+        fprintf( stderr, "Set environment variable BF_SPLIT_OUTPUT to write one file per instrument, linked from outputFile.\n");
+        fprintf( stderr, "Set environment variable BF_CONSOLIDATE to merge the per-instrument files into outputFile.\n");
+        fprintf( stderr, "Set environment variable BF_RESUME to checkpoint the output and resume an interrupted run.\n");
+        fprintf( stderr, "Set environment variable BF_REFUSE_INSTRUMENT to MOPITT, CERES, MODIS, ASTER or MISR to replace that instrument in the existing outputFile.\n");
+        fprintf( stderr, "Set environment variable BF_REPACK to reclaim the space of the replaced instrument.\n");
+        fprintf( stderr, "Set environment variable BF_BBOX to \"latMin,latMax,lonMin,lonMax\" to keep only data inside that box.\n");
+        fprintf( stderr, "Set environment variable BF_TIME_WINDOW to \"YYYY-MM-DDThh:mm:ss/YYYY-MM-DDThh:mm:ss\" to keep only data inside that window.\n");
+        fprintf( stderr, "Set environment variable BF_LAYOUT_PROFILE to throughput, cloud-read or archive to tune the output file layout.\n");
+        fprintf( stderr, "Set environment variable BF_KEEP_BITS to the number of mantissa bits to keep in unpacked radiances.\n");
+        fprintf( stderr, "Set environment variable BF_STATS to 1 to store statistics of the unpacked radiances.\n");
+        fprintf( stderr, "Set environment variable BF_OVERVIEWS to N to store N levels of 2x downsampled radiances.\n");
+        fprintf( stderr, "Set environment variable BF_SPATIAL_INDEX to 0 to leave out the spatial index of the geolocation.\n");
+        fprintf( stderr, "Set environment variable BF_COLLOCATE to 1 to list the MODIS and ASTER pixels of each CERES footprint and MISR block.\n");
+        fprintf( stderr, "Set environment variable BF_CHECKSUM to 1 to store XXH64 checksums of every dataset and a manifest of them.\n");
+        fprintf( stderr, "Set environment variable BF_GRANULE_METADATA to echo10 or json to write the CMR granule metadata next to outputFile.\n");
+        fprintf( stderr, "Set environment variable BF_STAGE_MEMORY to a size in MiB to build the output in memory up to that size.\n");
+        fprintf( stderr, "Set environment variable BF_OUTPUT_FORMAT to zarr to convert the output to a Zarr v2 directory store named outputFile.\n");
+        fprintf( stderr, "Input files may be named archive.tar/member to read them from the archive. Set BF_TAR_STAGE_DIR to place the copies of HDF4 members.\n");
         goto cleanupFail;
     }
 
+    {
+        const char *s;
+        s = getenv("BF_SPLIT_OUTPUT");
+        if ( s && isdigit((int)*s) )
+            splitOutput = ( strtol(s, NULL, 10) != 0 );
+#ifdef BF_LIBRARY
+        /* Split output forks a process per instrument, which the library must not do to its caller */
+        if ( splitOutput )
+        {
+            FATAL_MSG("BF_SPLIT_OUTPUT cannot be used with libbasicfusion.\n");
+            goto cleanupFail;
+        }
+#endif
+        s = getenv("BF_CONSOLIDATE");
+        if ( s && isdigit((int)*s) )
+            consolidate = ( strtol(s, NULL, 10) != 0 );
+        s = getenv("BF_RESUME");
+        if ( s && isdigit((int)*s) )
+            resumeMode = ( strtol(s, NULL, 10) != 0 );
+        s = getenv("BF_REPACK");
+        if ( s && isdigit((int)*s) )
+            repack = ( strtol(s, NULL, 10) != 0 );
+        s = getenv("BF_REFUSE_INSTRUMENT");
+        if ( s && *s )
+        {
+            for ( int i = 0; i < NUM_INSTR; i++ )
+                if ( strcmp( s, instrumentNames[i] ) == 0 )
+                    refuseInstrument = i;
+            if ( refuseInstrument < 0 )
+            {
+                FATAL_MSG("BF_REFUSE_INSTRUMENT must be one of MOPITT, CERES, MODIS, ASTER or MISR.\n\tIts current value is %s.\n", s);
+                goto cleanupFail;
+            }
+            if ( mpiSize > 1 || splitOutput || resumeMode )
+            {
+                FATAL_MSG("BF_REFUSE_INSTRUMENT cannot be combined with MPI, BF_SPLIT_OUTPUT or BF_RESUME.\n");
+                goto cleanupFail;
+            }
+        }
+        s = getenv("BF_STAGE_MEMORY");
+        if ( s && isdigit((int)*s) )
+            stageCeiling = (hsize_t) strtoull(s, NULL, 10) * 1024 * 1024;
+        s = getenv("BF_OUTPUT_FORMAT");
+        if ( s && strcmp( s, "zarr" ) == 0 )
+        {
+            if ( sink )
+            {
+                FATAL_MSG("BF_OUTPUT_FORMAT=zarr cannot be combined with the sink of bfConvert.\n");
+                goto cleanupFail;
+            }
+            sink = &zarrSink;
+        }
+        else if ( s && *s && strcmp( s, "hdf5" ) != 0 )
+        {
+            FATAL_MSG("BF_OUTPUT_FORMAT must be hdf5 or zarr.\n\tIts current value is %s.\n", s);
+            goto cleanupFail;
+        }
+
+        /* The sink is called in this process, with one output file to read back from */
+        if ( sink && ( mpiSize > 1 || splitOutput ) )
+        {
+            FATAL_MSG("A sink, and so BF_OUTPUT_FORMAT=zarr, cannot be combined with MPI or BF_SPLIT_OUTPUT.\n");
+            goto cleanupFail;
+        }
+        memoryOnly = sink && !sink->keepFile;
+        if ( memoryOnly && ( resumeMode || refuseInstrument >= 0 ) )
+        {
+            FATAL_MSG("BF_RESUME and BF_REFUSE_INSTRUMENT need the HDF5 output file.\n");
+            goto cleanupFail;
+        }
+        if ( memoryOnly && stageCeiling > 0 )
+        {
+            WARN_MSG("BF_STAGE_MEMORY is ignored when the output is only built in memory for the sink.\n");
+            stageCeiling = 0;
+        }
+
+        /* A checkpoint flush would write the whole image each unit, and a re-fused file already exists */
+        if ( stageCeiling > 0 && ( resumeMode || refuseInstrument >= 0 ) )
+        {
+            WARN_MSG("BF_STAGE_MEMORY is ignored with BF_RESUME or BF_REFUSE_INSTRUMENT.\n");
+            stageCeiling = 0;
+        }
+        if ( stageCeiling > 0 && estimateOutputSize( argv[2] ) > stageCeiling )
+        {
+            printf("The output is expected to exceed BF_STAGE_MEMORY. It will be written directly.\n");
+            stageCeiling = 0;
+        }
+    }
+
+#ifndef BF_LIBRARY
+    /* Fork the instrument workers before any file is opened so that no stdio buffer or file offset is shared */
+    if ( splitOutput && mpiSize == 1 )
+    {
+        splitWorker = INSTR_MOPITT;
+        fflush(stdout);
+        fflush(stderr);
+        for ( int i = INSTR_CERES; i < NUM_INSTR; i++ )
+        {
+            pid_t pid = fork();
+            if ( pid < 0 )
+            {
+                FATAL_MSG("Failed to fork the %s worker process.\n", instrumentNames[i]);
+                goto cleanupFail;
+            }
+            if ( pid == 0 )
+            {
+                splitWorker = i;
+                memset( splitWorkerPids, 0, sizeof(splitWorkerPids) );
+                break;
+            }
+            splitWorkerPids[i] = pid;
+        }
+    }
+#endif
+
     /* Get the starting execution Unix time */
     sTime = time(NULL);    
 
@@ -113,35 +381,10 @@ int main( int argc, char* argv[] )
         goto cleanupFail;
     }
 
-    // open the orbit_info.bin file
-    new_orbit_info_b = fopen(argv[3],"r");
-    if (new_orbit_info_b == NULL) {
-        FATAL_MSG("file \"%s\" does not exist. Exiting program.\n", argv[3]);
-        goto cleanupFail;
-    }
-    long fSize = 0;
-
-    // get the size of the file
-    if(fseek(new_orbit_info_b,0,SEEK_END)!=0) {
-        FATAL_MSG("file \"%s\" fseek function fails. Exiting program.\n", argv[3]);
-        goto cleanupFail;
-    }
-    fSize = ftell(new_orbit_info_b);
-    if(fSize <0) {
-        FATAL_MSG("file \"%s\" ftell function fails. Exiting program.\n", argv[3]);
-        goto cleanupFail;
-    }
-    // rewind file pointer to beginning of file
-    rewind(new_orbit_info_b);
-
-
-    test_orbit_ptr = calloc(fSize/sizeof(OInfo_t),sizeof(OInfo_t));
-
-    // read the file into the test_orbit_ptr struct array
-    size_t result = fread(test_orbit_ptr,sizeof(OInfo_t),fSize/sizeof(OInfo_t),new_orbit_info_b);
-    if(result != fSize/sizeof(OInfo_t))
+    // map the orbit_info.bin file
+    if ( openOrbitTable( argv[3], &orbitTable ) != 0 )
     {
-        FATAL_MSG("fread is not successful.\n");
+        FATAL_MSG("Failed to read the orbit table \"%s\". Exiting program.\n", argv[3]);
         goto cleanupFail;
     }
 
@@ -159,75 +402,53 @@ int main( int argc, char* argv[] )
     }
 
     int current_orbit_number = atoi(inputLine);
-    for ( int i = 0; i<fSize/sizeof(OInfo_t); i++)
+    orbitRecord = findOrbit( &orbitTable, current_orbit_number );
+    if ( orbitRecord == NULL )
     {
-        if( test_orbit_ptr[i].orbit_number == current_orbit_number )
-        {
-            current_orbit_info = test_orbit_ptr[i];
-            break;
-        }
+        FATAL_MSG("Orbit %d is not in the orbit table %s.\n", current_orbit_number, argv[3]);
+        goto cleanupFail;
     }
+    current_orbit_info = *orbitRecord;
+    closeOrbitTable( &orbitTable );
 
-    if(fclose(new_orbit_info_b)!=0) {
-        FATAL_MSG("Failed to close file %s\n",argv[3]);
+    /* BF_BBOX and BF_TIME_WINDOW restrict the output to a subset of the orbit */
+    if ( initSubset() == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to read the subset settings.\n");
         goto cleanupFail;
     }
-    new_orbit_info_b = NULL;
-    free(test_orbit_ptr);
-    test_orbit_ptr = NULL;
-
-
-
-    /*MY 2016-12-21: Currently an environment variable TERRA_DATA_UNPACK should be set
-     *to run the program to generate the unpacked data,
-     *without setting this environment variable, the program will just write the packed data */
-
+    status = subsetOrbitInfo( &current_orbit_info );
+    if ( status == FATAL_ERR )
+        goto cleanupFail;
+    if ( status == RET_SUCCESS_NO_PROCESS )
     {
-        const char *s;
-        s = getenv("TERRA_DATA_UNPACK");
-
-        int envVal;
-
-        if(s && isdigit((int)*s)) 
-        {
-            envVal = strtol(s, NULL, 10);
-            if ( envVal != 0 )
-                unpack = 1;
-            else
-                unpack = 0;
-        }
-
-        s = getenv("USE_CHUNK");
-        
-        if ( s && isdigit((int)*s)) 
-        {   envVal = strtol(s, NULL, 10);
-            useChunk = envVal;
-        }
-        else
-            useChunk = 0;
-
-        s = getenv("USE_GZIP");
-        if ( s && isdigit((int)*s)) 
-        {   envVal = strtol(s, NULL, 10);
-            useGZIP = envVal;
-        }
-        else
-            useGZIP = 0;
+        FATAL_MSG("The BF_TIME_WINDOW time window does not overlap orbit %d.\n", current_orbit_number);
+        goto cleanupFail;
+    }
 
-        // USE_GZIP should always be between 0 through 9. Make sure this is the case.
-        if ( useGZIP < 0 || useGZIP > 9 )
+    /* Read the settings, and check them before any granule is written */
+    if ( initContext( ctx ) == FATAL_ERR )
+        goto cleanupFail;
+    if ( sink == &zarrSink )
+    {
+        zarrStore = zarrOpenStore( argv[1], ctx->gzipLevel );
+        if ( zarrStore == NULL )
         {
-            FATAL_MSG("The environment variable USE_GZIP should be between 0 and 9 inclusive.\n\tIts current value is %d.\n", useGZIP);
+            FATAL_MSG("Failed to create the Zarr store %s.\n", argv[1]);
             goto cleanupFail;
         }
-
+        zarrSink.userData = zarrStore;
     }
+    ctx->sink = sink;
+    if ( getGranuleMetadataFormat() == FATAL_ERR )
+        goto cleanupFail;
 
-    if ( unpack ) printf("\n_____UNPACKING ENABLED_____\n");
+    if ( ctx->unpack == UNPACK_SCALED ) printf("\n_____SCALED INTEGER RADIANCES_____\n");
+    else if ( ctx->unpack ) printf("\n_____UNPACKING ENABLED_____\n");
     else printf("\n_____UNPACKING DISABLED_____\n");
-    if ( useChunk ) printf("_____CHUNKING ENABLED_____\n");
+    if ( ctx->useChunk ) printf("_____CHUNKING ENABLED_____\n");
     else printf("\n_____CHUNKING DISABLED_____\n");
-    if ( useGZIP ) printf("\n_____GZIP ENABLED -- LEVEL %d_____\n", useGZIP );
+    if ( ctx->gzipLevel ) printf("\n_____GZIP ENABLED -- LEVEL %d_____\n", ctx->gzipLevel );
     else printf("\n_____GZIP DISABLED_____\n");
 
     /* remove output file if it already exists. Note that no conditional statements are used. If file does not exist,
@@ -241,14 +462,48 @@ int main( int argc, char* argv[] )
      * remove() provides hardly any performance decrease. It's just a safety measure.
      */
 
-    remove( argv[1] );
+    /* When several ranks are running, each one writes its units to its own sub-file. The master
+     * file argv[1] is assembled from the sub-files at the end. With split output, the instrument
+     * files are created when the first unit of the instrument is written (see selectOutputFile).
+     */
+    outFileName = argv[1];
+    if ( mpiSize > 1 && !splitOutput )
+    {
+        subFileName = getSubFileName( argv[1], NULL, mpiRank );
+        if ( subFileName == NULL )
+        {
+            FATAL_MSG("Failed to get the sub-file name.\n");
+            goto cleanupFail;
+        }
+        outFileName = subFileName;
+        printf("Rank %d of %d writing to %s\n", mpiRank, mpiSize, outFileName);
+    }
 
-    /* create the output file or open it if it exists */
-    if ( createOutputFile( &outputFile, argv[1] ))
+    if ( refuseInstrument >= 0 )
     {
-        FATAL_MSG("Unable to create output file.\n");
-        outputFile = 0;
-        goto cleanupFail;
+        /* Keep the existing file and only clear the group tree of the instrument being replaced */
+        ctx->outputFile = H5Fopen( outFileName, H5F_ACC_RDWR, H5P_DEFAULT );
+        if ( ctx->outputFile < 0 )
+        {
+            FATAL_MSG("Unable to open the existing output file %s.\n", outFileName);
+            ctx->outputFile = 0;
+            goto cleanupFail;
+        }
+        if ( removeInstrument( ctx->outputFile, instrumentNames[refuseInstrument] ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to remove the %s group from %s.\n", instrumentNames[refuseInstrument], outFileName);
+            goto cleanupFail;
+        }
+        printf("Replacing %s in %s.\n", instrumentNames[refuseInstrument], outFileName);
+    }
+    else if ( !splitOutput )
+    {
+        /* create the output file, or reopen it when resuming */
+        if ( openOutputFile( outFileName, &ctx->outputFile, -1 ) == FATAL_ERR )
+        {
+            FATAL_MSG("Unable to create output file.\n");
+            goto cleanupFail;
+        }
     }
 
     /**********
@@ -281,7 +536,25 @@ int main( int argc, char* argv[] )
                 goto cleanupFail;
             }
 
-            status = MOPITT( inputLine, current_orbit_info );
+            /* MOPITT is unit 0, which always belongs to rank 0, the rank that writes the granule list */
+            unitState = beginUnit( ctx, argv[1], INSTR_MOPITT, unit );
+            if ( unitState == FATAL_ERR )
+                goto cleanupFail;
+            if ( unitState == UNIT_PROCESS )
+                status = MOPITT( ctx, inputLine, current_orbit_info );
+            else if ( unitState == UNIT_DONE )
+            {
+                /* A resumed MOPITT unit lists only the granules it wrote, which are kept in its marker */
+                char* marker = getUnitMarker( ctx->outputFile, instrumentNames[INSTR_MOPITT] );
+                granTempPtr = strrchr( inputLine, '/' );
+                if ( marker && granTempPtr && strstr( marker, granTempPtr + 1 ) )
+                    status = RET_SUCCESS;
+                else
+                    status = RET_SUCCESS_NO_PROCESS;
+                if ( marker ) free(marker);
+            }
+            else
+                status = RET_SUCCESS_NO_PROCESS;
             if(status == FATAL_ERR )
             {
                 FATAL_MSG("MOPITT failed data transfer on file:\n\t%s\nExiting program.\n", inputLine);
@@ -306,7 +579,7 @@ int main( int argc, char* argv[] )
             }
 
 #if 0
-            if ( MOPITT( inputLine, current_orbit_info ) == FATAL_ERR )
+            if ( MOPITT( ctx, inputLine, current_orbit_info ) == FATAL_ERR )
             {
                 FATAL_MSG("MOPITT failed data transfer on file:\n\t%s\nExiting program.\n", inputLine);
                 goto cleanupFail;
@@ -337,13 +610,18 @@ int main( int argc, char* argv[] )
         }
     }
 
+    if ( endUnit( ctx, INSTR_MOPITT, unit, 0, granuleList ? granuleList + unitGranMark : NULL ) == FATAL_ERR )
+        goto cleanupFail;
+    unit++;
+    unitGranMark = granuleList ? strlen(granuleList) : 0;
+
     /*********
      * CERES *
      *********/
     /* Get the CERES  */
 
     CERESargs[0] = argv[0];
-    CERESargs[1] = argv[1];
+    CERESargs[1] = outFileName;
 
     if ( strstr(inputLine, "CER N/A" ) == NULL )
     {
@@ -378,7 +656,12 @@ int main( int argc, char* argv[] )
                 CERESargs[2] = calloc(strlen(inputLine)+1, 1);
                 
                 strncpy( CERESargs[2], inputLine, strlen(inputLine) );
-                status = CERES_OrbitInfo(CERESargs,ceres_start_index_ptr,ceres_end_index_ptr,current_orbit_info);
+                /* Only the owner of the unit reads (and, from an archive, stages) the file. The others list the granule,
+                   and the master file keeps it only if the owner's sub-file holds it (see gatherGranuleList). */
+                if ( ownsUnit( INSTR_CERES, unit ) )
+                    status = CERES_OrbitInfo(CERESargs,ceres_start_index_ptr,ceres_end_index_ptr,current_orbit_info);
+                else
+                    *ceres_start_index_ptr = *ceres_end_index_ptr = 0;
                 if ( status == FATAL_ERR )
                 {
                     FATAL_MSG("CERES failed to obtain orbit info.\nExiting program.\n");
@@ -404,7 +687,11 @@ int main( int argc, char* argv[] )
                         FATAL_MSG("Failed to update the granule list.\n");
                         goto cleanupFail;
                     }
-                    status = CERES(CERESargs,1,ceres_fm1_count,(int32*)ceres_start_index_ptr,NULL,ceres_subset_num_elems_ptr);
+                    unitState = beginUnit( ctx, argv[1], INSTR_CERES, unit );
+                    if ( unitState == FATAL_ERR )
+                        goto cleanupFail;
+                    if ( unitState == UNIT_PROCESS )
+                        status = CERES(ctx,CERESargs,1,ceres_fm1_count,(int32*)ceres_start_index_ptr,NULL,ceres_subset_num_elems_ptr);
                     if ( status == FATAL_ERR )
                     {
                         FATAL_MSG("CERES failed data transfer on file:\n\t%s\nExiting program.\n", inputLine);
@@ -421,7 +708,11 @@ int main( int argc, char* argv[] )
                 CERESargs[2] = calloc(strlen(inputLine)+1, 1);
                 strncpy( CERESargs[2], inputLine, strlen(inputLine) );
                 
-                status = CERES_OrbitInfo(CERESargs,ceres_start_index_ptr,ceres_end_index_ptr,current_orbit_info);
+                /* As for FM1, only the owner of the unit reads the file */
+                if ( ownsUnit( INSTR_CERES, unit ) )
+                    status = CERES_OrbitInfo(CERESargs,ceres_start_index_ptr,ceres_end_index_ptr,current_orbit_info);
+                else
+                    *ceres_start_index_ptr = *ceres_end_index_ptr = 0;
                 if ( status == FATAL_ERR )
                 {
                     FATAL_MSG("CERES failed to obtain orbit info.\nExiting program.\n");
@@ -445,7 +736,11 @@ int main( int argc, char* argv[] )
                         FATAL_MSG("Failed to update the granule list.\n");
                         goto cleanupFail;
                     }
-                    status = CERES(CERESargs,2,ceres_fm2_count,(int32*)ceres_start_index_ptr,NULL,ceres_subset_num_elems_ptr);
+                    unitState = beginUnit( ctx, argv[1], INSTR_CERES, unit );
+                    if ( unitState == FATAL_ERR )
+                        goto cleanupFail;
+                    if ( unitState == UNIT_PROCESS )
+                        status = CERES(ctx,CERESargs,2,ceres_fm2_count,(int32*)ceres_start_index_ptr,NULL,ceres_subset_num_elems_ptr);
                     if ( status == FATAL_ERR )
                     {
                         FATAL_MSG("CERES failed data transfer on file:\n\t%s\nExiting program.\n", inputLine);
@@ -496,13 +791,18 @@ int main( int argc, char* argv[] )
         }    
     }
 
+    if ( endUnit( ctx, INSTR_CERES, unit, 0, granuleList ? granuleList + unitGranMark : NULL ) == FATAL_ERR )
+        goto cleanupFail;
+    unit++;
+    unitGranMark = granuleList ? strlen(granuleList) : 0;
+
     /*********
      * MODIS *
      *********/
 
 
     MODISargs[0] = argv[0];
-    MODISargs[6] = argv[1];
+    MODISargs[6] = outFileName;
 
     /* MY 2016-12-21: Need to form a loop to read various number of MODIS files
     *  A pre-processing check of the inputFile should be provided to make sure the processing
@@ -640,7 +940,11 @@ int main( int argc, char* argv[] )
                 strncpy( MODISargs[4], inputLine, strlen(inputLine) );
                 sprintf(modis_granule_suffix,"%d",modis_count);
 
-                status = MODIS( MODISargs,modis_count,unpack);
+                unitState = beginUnit( ctx, argv[1], INSTR_MODIS, unit );
+                if ( unitState == FATAL_ERR )
+                    goto cleanupFail;
+                if ( unitState == UNIT_PROCESS )
+                    status = MODIS( ctx, MODISargs,modis_count);
                 if ( status == FATAL_ERR )
                 {    
                     FATAL_MSG("MODIS failed data transfer on this granule:\n)");
@@ -672,7 +976,11 @@ int main( int argc, char* argv[] )
                 strncpy(MODISargs[5],granule,strlen(granule));
                 strncat(MODISargs[5],modis_granule_suffix,strlen(modis_granule_suffix));
 
-                status = MODIS( MODISargs,modis_count,unpack );
+                unitState = beginUnit( ctx, argv[1], INSTR_MODIS, unit );
+                if ( unitState == FATAL_ERR )
+                    goto cleanupFail;
+                if ( unitState == UNIT_PROCESS )
+                    status = MODIS( ctx, MODISargs,modis_count );
                 if ( status == FATAL_ERR )
                 {
                     FATAL_MSG("MODIS failed data transfer on this granule:\n)");
@@ -692,6 +1000,10 @@ int main( int argc, char* argv[] )
                 goto cleanupFail;
             }
 
+            /* A granule outside of the subset is not listed */
+            if ( unitState == UNIT_PROCESS && status == RET_SUCCESS_NO_PROCESS )
+                granuleList[unitGranMark] = '\0';
+
             if(MODISargs[1]) free(MODISargs[1]);
             MODISargs[1] = NULL;
             if(MODISargs[2]) free(MODISargs[2]);
@@ -711,7 +1023,11 @@ int main( int argc, char* argv[] )
                 goto cleanupFail;
             }
 
+            if ( endUnit( ctx, INSTR_MODIS, unit, 1, granuleList + unitGranMark ) == FATAL_ERR )
+                goto cleanupFail;
             modis_count++;
+            unit++;
+            unitGranMark = strlen(granuleList);
 
         }
 
@@ -735,7 +1051,7 @@ int main( int argc, char* argv[] )
      *********/
 
     ASTERargs[0] = argv[0];
-    ASTERargs[3] = argv[1];
+    ASTERargs[3] = outFileName;
 
     /* Get the ASTER input files */
     /* MY 2016-12-20, Need to loop ASTER files since the number of granules may be different for each orbit */
@@ -764,15 +1080,25 @@ int main( int argc, char* argv[] )
                 strncpy( ASTERargs[1], inputLine, strlen(inputLine) );
 
                 /* EXECUTE ASTER DATA TRANSFER */
-                status = ASTER( ASTERargs,aster_count,unpack);
+                unitState = beginUnit( ctx, argv[1], INSTR_ASTER, unit );
+                if ( unitState == FATAL_ERR )
+                    goto cleanupFail;
+                if ( unitState == UNIT_PROCESS )
+                    status = ASTER( ctx, ASTERargs,aster_count);
 
                 if ( status == FATAL_ERR )
                 {
                     FATAL_MSG("ASTER failed data transfer on file:\n\t%s\nExiting program.\n", inputLine);
                     goto cleanupFail;
                 }
+                if ( unitState == UNIT_PROCESS && status == RET_SUCCESS_NO_PROCESS )
+                    granuleList[unitGranMark] = '\0';
 
+                if ( endUnit( ctx, INSTR_ASTER, unit, 1, granuleList + unitGranMark ) == FATAL_ERR )
+                    goto cleanupFail;
                 aster_count++;
+                unit++;
+                unitGranMark = strlen(granuleList);
                 free(ASTERargs[1]);
                 ASTERargs[1] = NULL;
                 free(ASTERargs[2]);
@@ -939,25 +1265,57 @@ int main( int argc, char* argv[] )
         strncpy( MISRargs[12], inputLine, strlen(inputLine) );
 
         // EXECUTE MISR DATA TRANSFER
-        status = MISR( MISRargs,unpack);
+        unitState = beginUnit( ctx, argv[1], INSTR_MISR, unit );
+        if ( unitState == FATAL_ERR )
+            goto cleanupFail;
+        if ( unitState == UNIT_PROCESS )
+            status = MISR( ctx, MISRargs);
         if ( status == FATAL_ERR )
         {
             FATAL_MSG("MISR failed data transfer.\nExiting program.\n");
             goto cleanupFail;
         }
+        if ( unitState == UNIT_PROCESS && status == RET_SUCCESS_NO_PROCESS )
+        {
+            printf("MISR orbit is outside of the BF_BBOX box.\n");
+            granuleList[unitGranMark] = '\0';
+        }
+        if ( endUnit( ctx, INSTR_MISR, unit, 0, granuleList + unitGranMark ) == FATAL_ERR )
+            goto cleanupFail;
         printf("MISR done.\n");
     }
     else
         printf("No MISR files found.\n");
 
-    // Add some CF Provenance attributes
-    errStatus = Add_CF_Provenance_Attrs();
-    if ( errStatus < 0 )
+    /* The entries of the other instruments come from the existing file */
+    if ( refuseInstrument >= 0 )
     {
-        FATAL_MSG("Failed to add CF provenance attributes in root group.\n");
-        goto cleanupFail;
+        char* oldList = getAttrString( ctx->outputFile, "/", "InputGranules" );
+        char* mergedList = NULL;
+        size_t mergedSize = 0;
+        char historyEntry[STR_LEN] = {'\0'};
+        time_t now = time(NULL);
+
+        errStatus = mergeGranuleList( oldList, granuleList, refuseInstrument, &mergedList, &mergedSize );
+        if ( oldList ) free(oldList);
+        if ( errStatus == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to update the granule list.\n");
+            goto cleanupFail;
+        }
+        if ( granuleList ) free(granuleList);
+        granuleList = mergedList;
+
+        strftime( historyEntry, STR_LEN, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now) );
+        snprintf( historyEntry + strlen(historyEntry), STR_LEN - strlen(historyEntry), " basicFusion: replaced the %s group",
+                  instrumentNames[refuseInstrument] );
+        if ( appendHistory( ctx->outputFile, historyEntry ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to update the history attribute in root group.\n");
+            goto cleanupFail;
+        }
     }
-    
+
     /* Attach the granuleList as an attribute to the root HDF5 object */
     // Sometimes there are no any granules for this orbit. Now I just record as a string "None".
     if(granuleList == NULL) {
@@ -967,11 +1325,56 @@ int main( int argc, char* argv[] )
        granuleList[4]='\0';
 
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "InputGranules", granuleList);
-    if ( errStatus < 0 )
+
+    /* With several ranks or split output, the root attributes go to the master file once it is assembled */
+    if ( mpiSize == 1 && !splitOutput )
     {
-        FATAL_MSG("Failed to set Input Granules attribute in root group.\n");
-        goto cleanupFail;
+        /* The orbit is complete, the checkpoint is not needed anymore */
+        if ( resumeMode && removeCheckpoint( ctx->outputFile ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to remove the checkpoint from the output file.\n");
+            goto cleanupFail;
+        }
+
+        if ( collocateInstruments( ctx, ctx->outputFile ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to collocate the instruments.\n");
+            goto cleanupFail;
+        }
+
+        if ( writeChecksumManifest( ctx, ctx->outputFile ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to write the checksum manifest.\n");
+            goto cleanupFail;
+        }
+
+        if ( collectGranuleMetadata( ctx->outputFile, &current_orbit_info, &granuleMeta ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to collect the granule metadata.\n");
+            goto cleanupFail;
+        }
+
+        // Add some CF Provenance attributes
+        errStatus = Add_CF_Provenance_Attrs( ctx );
+        if ( errStatus < 0 )
+        {
+            FATAL_MSG("Failed to add CF provenance attributes in root group.\n");
+            goto cleanupFail;
+        }
+
+        errStatus = H5LTset_attribute_string( ctx->outputFile, "/", "InputGranules", granuleList);
+        if ( errStatus < 0 )
+        {
+            FATAL_MSG("Failed to set Input Granules attribute in root group.\n");
+            goto cleanupFail;
+        }
+
+        /* The spatial index, collocation and checksum manifest, and whatever a unit did not hand over */
+        if ( sinkDatasets( ctx, ctx->outputFile, "/", 1 ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to hand the output to the sink.\n");
+            goto cleanupFail;
+        }
     }
     
 
@@ -985,7 +1388,59 @@ cleanupFail:
         fail = 1;
     }
 
-    if ( outputFile ) H5Fclose(outputFile);
+    /* Attachments of an interrupted unit, so that the registry lets go of the output files */
+    if ( flushDimScales( ctx ) == FATAL_ERR )
+        fail = 1;
+
+    /* Closing a staged file is when it is written to disk, so its failure is the run's failure */
+    if ( splitOutput )
+    {
+        for ( int i = 0; i < NUM_INSTR; i++ )
+            if ( instrumentFiles[i] && H5Fclose(instrumentFiles[i]) < 0 && stagedNames[i] )
+            {
+                FATAL_MSG("Failed to write %s to disk.\n", stagedNames[i]);
+                fail = 1;
+            }
+    }
+    else if ( ctx->outputFile && H5Fclose(ctx->outputFile) < 0 && stagedNames[0] )
+    {
+        FATAL_MSG("Failed to write %s to disk.\n", stagedNames[0]);
+        fail = 1;
+    }
+    ctx->outputFile = 0;
+    for ( int i = 0; i < NUM_INSTR; i++ )
+    {
+        free(stagedNames[i]);
+        stagedNames[i] = NULL;
+    }
+
+    if ( !fail && refuseInstrument >= 0 && repack )
+    {
+        printf("Repacking %s...\n", argv[1]);
+        if ( repackOutputFile( ctx, argv[1] ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to repack %s.\n", argv[1]);
+            fail = 1;
+        }
+    }
+
+    /* The size of the file is only known once it is closed */
+    if ( !fail && mpiSize == 1 && !splitOutput && !memoryOnly && writeGranuleMetadata( argv[1], &granuleMeta, granuleList ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the granule metadata of %s.\n", argv[1]);
+        fail = 1;
+    }
+
+    /* Every rank and worker process has to get here, failed or not, since assembling the master file
+     * waits for all of them.
+     */
+    if ( ( mpiSize > 1 || splitOutput ) && assembleMaster( ctx, argv[1], fail, granuleList, &current_orbit_info ) == FATAL_ERR )
+        fail = 1;
+#ifdef BF_MPI
+    MPI_Finalize();
+#endif
+
+    if ( subFileName ) free(subFileName);
     if ( inputFile ) fclose(inputFile);
     if ( MODISargs[1] ) free(MODISargs[1]);
     if (  MODISargs[2] ) free( MODISargs[2]);
@@ -994,14 +1449,20 @@ cleanupFail:
     if ( MODISargs[5] ) free( MODISargs[5] );
     if ( ASTERargs[1] ) free ( ASTERargs[1] );
     if ( ASTERargs[2] ) free ( ASTERargs[2] );
-    if ( TAI93toUTCoffset ) free(TAI93toUTCoffset);
-    if ( test_orbit_ptr) free(test_orbit_ptr);
-    if ( new_orbit_info_b) fclose(new_orbit_info_b);
+    freeContext( ctx );
+    /* A store that failed is left without the consolidated metadata */
+    if ( zarrStore && zarrCloseStore( zarrStore, !fail ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the consolidated metadata of %s.\n", argv[1]);
+        fail = 1;
+    }
+    closeOrbitTable( &orbitTable );
     if ( CER_curTime ) free( CER_curTime );
     if ( CER_prevTime ) free(CER_prevTime);
     for ( int j = 1; j <= 12; j++ )
         if ( MISRargs[j] ) free (MISRargs[j]);
     if ( granuleList ) free(granuleList);
+    closeTarInputs();
 
     eTime = time(NULL);
     /* Print the program execution time */
@@ -1055,108 +1516,865 @@ int getNextLine ( char* string, FILE* const inputFile )
     return RET_SUCCESS;
 }
 
-int Add_CF_Provenance_Attrs() {
+/*
+                        ownsUnit
+    DESCRIPTION:
+        This function tells whether this process writes the given unit of work. Units are dealt out
+        round-robin to the MPI ranks, while each forked split output worker writes one instrument.
+        When an instrument is being replaced, only its units are written.
+    ARGUMENTS:
+        int instrument  -- The instrument of the unit (INSTR_MOPITT etc.)
+        int unit        -- The running index of the unit in the input file list
+    EFFECTS:
+        None
+    RETURN:
+        Non-zero if this process owns the unit, zero otherwise
+*/
 
-    int errStatus = RET_SUCCESS;
-    char *tf_acknowledge = "This data set was created with funding from NASA ACCESS Grant #NNX16AM07A.";
-    char *tf_version = "First version of this product";
-    char *tf_contri_name ="Muqun Yang, Landon Clipp, Yizhao Gao, Guangyu Zhao, Larry Di Girolamo"; 
-    char *tf_contri_email ="myang6@hdfgroup.org, gzhao1@illinois.edu";
-    char *tf_inst ="The HDF Group, University of Illinois";
-    char *tf_kw = "Earth Science, TERRA, MISR, MODIS, ASTER,CERES,MOPITT, Radiance";
-    char *tf_lic = "No constraints on data access or use";
-    char *tf_plat= "TERRA";
-    char *tf_Pro_Level = "Level 1";
-    char *tf_Pro_Version = "V001";
-    char *tf_project  = "NASA ACCESS to Terra Fusion Product";
-    char *tf_sensors ="MODIS,MISR,ASTER,CERES,MOPITT";
-    char *tf_summary ="A Terra level-1 radiance basic fusion product that combines calibrated radiance measurements from MISR, MODIS, ASTER, CERES and MOPITT";
-    char *tf_title = "TERRA L1B Radiance Basic Fusion Product"; 
-    errStatus = H5LTset_attribute_string( outputFile, "/", "acknowledgement", tf_acknowledge);
-    if ( errStatus < 0 )
-    {
-        FATAL_MSG("Failed to set the acknowledgement attribute in root group.\n");
-        return FATAL_ERR;
-    }
+static int ownsUnit( int instrument, int unit )
+{
+    if ( refuseInstrument >= 0 )
+        return instrument == refuseInstrument;
+
+    if ( splitWorker >= 0 )
+        return instrument == splitWorker;
+
+    return unit % mpiSize == mpiRank;
+}
+
+/*
+                        openOutputFile
+    DESCRIPTION:
+        This function creates an output file. When BF_RESUME is set and the file exists with a valid
+        checkpoint, the file is instead reopened and rolled back to the checkpoint (see resumeFromCheckpoint),
+        and the units of work before the checkpoint are recorded as done.
+    ARGUMENTS:
+        char* fileName  -- The name of the output file
+        hid_t* fileID   -- Set to the ID of the opened file
+        int instrument  -- The instrument written to the file (INSTR_MOPITT etc.), or -1 if the file holds all of them
+    EFFECTS:
+        Creates or modifies the file. Updates resumeUnit. With BF_STAGE_MEMORY set, a new file is built in
+        memory and its name is kept in stagedNames. With memoryOnly set, the file is only built in memory.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t openOutputFile( char* fileName, hid_t* fileID, int instrument )
+{
+    FILE* tempFile = NULL;
+    int nextUnit = 0;
+    herr_t status = RET_SUCCESS_NO_PROCESS;
+
+    *fileID = 0;
 
-    errStatus = H5LTset_attribute_string( outputFile, "/", "version", tf_version);
-    if ( errStatus < 0 )
+    if ( resumeMode && ( tempFile = fopen( fileName, "r" ) ) != NULL )
     {
-        FATAL_MSG("Failed to set the version attribute in root group.\n");
-        return FATAL_ERR;
+        fclose(tempFile);
+        *fileID = H5Fopen( fileName, H5F_ACC_RDWR, H5P_DEFAULT );
+        if ( *fileID < 0 )
+            *fileID = 0;
+        else
+        {
+            status = resumeFromCheckpoint( *fileID, &nextUnit );
+            if ( status == FATAL_ERR )
+            {
+                FATAL_MSG("Failed to roll %s back to its checkpoint.\n", fileName);
+                H5Fclose(*fileID);
+                *fileID = 0;
+                return FATAL_ERR;
+            }
+            if ( status != RET_SUCCESS )
+            {
+                H5Fclose(*fileID);
+                *fileID = 0;
+            }
+        }
+
+        if ( status != RET_SUCCESS )
+            WARN_MSG("%s has no valid checkpoint. It will be recreated.\n", fileName);
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "contributor_name", tf_contri_name);
-    if ( errStatus < 0 )
+
+    if ( status == RET_SUCCESS )
+        printf("Resuming %s from unit %d.\n", fileName, nextUnit);
+    else
     {
-        FATAL_MSG("Failed to set the contributor_name attribute in root group.\n");
-        return FATAL_ERR;
+        nextUnit = 0;
+        if ( memoryOnly )
+            status = createMemoryOutputFile( fileID, fileName );
+        else
+        {
+            remove( fileName );
+            status = stageCeiling > 0 ? createStagedOutputFile( fileID, fileName ) : createOutputFile( fileID, fileName );
+        }
+        if ( status )
+        {
+            FATAL_MSG("Unable to create output file %s.\n", fileName);
+            *fileID = 0;
+            return FATAL_ERR;
+        }
+        if ( stageCeiling > 0 )
+        {
+            int slot = instrument < 0 ? 0 : instrument;
+            stagedNames[slot] = malloc( strlen(fileName) + 1 );
+            if ( stagedNames[slot] == NULL )
+            {
+                FATAL_MSG("Failed to allocate memory.\n");
+                return FATAL_ERR;
+            }
+            strcpy( stagedNames[slot], fileName );
+        }
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "contributor_email", tf_contri_email);
-    if ( errStatus < 0 )
+
+    for ( int i = 0; i < NUM_INSTR; i++ )
+        if ( instrument < 0 || i == instrument )
+            resumeUnit[i] = nextUnit;
+
+    return RET_SUCCESS;
+}
+
+/*
+                        selectOutputFile
+    DESCRIPTION:
+        With split output, this function points ctx->outputFile to the file of the given
+        instrument, creating the file (see openOutputFile) if this process has not written to it yet.
+        Otherwise the single output file stays selected.
+    ARGUMENTS:
+        BFcontext_t* ctx            -- The conversion context
+        const char* masterFileName  -- The name of the master file (argv[1])
+        int instrument              -- The instrument about to be written (INSTR_MOPITT etc.)
+    EFFECTS:
+        May create an output file. Updates ctx->outputFile.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t selectOutputFile( BFcontext_t* ctx, const char* masterFileName, int instrument )
+{
+    char* fileName = NULL;
+
+    if ( !splitOutput )
+        return RET_SUCCESS;
+
+    if ( instrumentFiles[instrument] == 0 )
     {
-        FATAL_MSG("Failed to set the contributor_email attribute in root group.\n");
+        fileName = getSubFileName( masterFileName, instrumentNames[instrument], mpiSize > 1 ? mpiRank : -1 );
+        if ( fileName == NULL )
+        {
+            FATAL_MSG("Failed to get the %s output file name.\n", instrumentNames[instrument]);
+            return FATAL_ERR;
+        }
+
+        if ( openOutputFile( fileName, &instrumentFiles[instrument], instrument ) == FATAL_ERR )
+        {
+            FATAL_MSG("Unable to create output file %s.\n", fileName);
+            free(fileName);
+            return FATAL_ERR;
+        }
+        free(fileName);
+    }
+
+    ctx->outputFile = instrumentFiles[instrument];
+
+    return RET_SUCCESS;
+}
+
+/*
+                        beginUnit
+    DESCRIPTION:
+        This function is called before a unit of work is written. It selects the output file of the unit
+        and tells whether the unit has to be written by this process.
+    ARGUMENTS:
+        BFcontext_t* ctx            -- The conversion context
+        const char* masterFileName  -- The name of the master file (argv[1])
+        int instrument              -- The instrument of the unit (INSTR_MOPITT etc.)
+        int unit                    -- The running index of the unit in the input file list
+    EFFECTS:
+        May create or reopen an output file. Updates ctx->outputFile.
+    RETURN:
+        FATAL_ERR on failure
+        UNIT_SKIP if another process owns the unit
+        UNIT_DONE if the unit was completed by the run being resumed
+        UNIT_PROCESS if the unit has to be written
+*/
+
+static int beginUnit( BFcontext_t* ctx, const char* masterFileName, int instrument, int unit )
+{
+    if ( !ownsUnit( instrument, unit ) )
+        return UNIT_SKIP;
+
+    if ( selectOutputFile( ctx, masterFileName, instrument ) == FATAL_ERR )
         return FATAL_ERR;
+
+    if ( unit < resumeUnit[instrument] )
+        return UNIT_DONE;
+
+    return UNIT_PROCESS;
+}
+
+/*
+                        endUnit
+    DESCRIPTION:
+        This function is called after a unit of work has been written. It writes the dimension scale
+        attachments of the unit (see flushDimScales) and hands the new datasets of the instrument to the sink
+        (see sinkDatasets). Copies of inputs taken from a tar archive are removed
+        (see releaseStagedInputs). With BF_STAGE_MEMORY set, the staged files are written out if they outgrew
+        the memory ceiling (see spillStagedFiles). With BF_RESUME set, it then saves a checkpoint in the
+        output file of the unit so that a later run can resume after it. A sub-file of MPI or split output
+        lists the granules of the units it holds (see appendSubFileGranules).
+    ARGUMENTS:
+        BFcontext_t* ctx        -- The conversion context
+        int instrument          -- The instrument of the unit (INSTR_MOPITT etc.)
+        int unit                -- The running index of the unit in the input file list
+        int perGranule          -- Non-zero if the unit is one MODIS or ASTER granule
+        const char* granules    -- The input granules of the unit
+    EFFECTS:
+        Writes the dimension scale attachments and the checkpoint to the output file and flushes it.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t endUnit( BFcontext_t* ctx, int instrument, int unit, int perGranule, const char* granules )
+{
+    hid_t fileID = splitOutput ? instrumentFiles[instrument] : ctx->outputFile;
+
+    if ( flushDimScales( ctx ) == FATAL_ERR )
+        return FATAL_ERR;
+
+    if ( ctx->sink && fileID > 0 && ownsUnit( instrument, unit ) )
+    {
+        char groupPath[STR_LEN];
+        snprintf( groupPath, sizeof groupPath, "/%s", instrumentNames[instrument] );
+        if ( sinkDatasets( ctx, fileID, groupPath, 0 ) == FATAL_ERR )
+            return FATAL_ERR;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "institution", tf_inst);
-    if ( errStatus < 0 )
+
+    /* A sub-file lists the granules it holds, since only its owner knows which ones the subset dropped */
+    if ( ( mpiSize > 1 || splitOutput ) && fileID > 0 && ownsUnit( instrument, unit ) &&
+         unit >= resumeUnit[instrument] && appendSubFileGranules( fileID, granules ) == FATAL_ERR )
+        return FATAL_ERR;
+
+    releaseStagedInputs();
+
+    if ( stageCeiling > 0 && spillStagedFiles( ctx ) == FATAL_ERR )
+        return FATAL_ERR;
+
+    if ( !resumeMode || fileID == 0 || !ownsUnit( instrument, unit ) || unit < resumeUnit[instrument] )
+        return RET_SUCCESS;
+
+    if ( checkpointUnit( fileID, instrumentNames[instrument], perGranule, unit + 1, granules ) == FATAL_ERR )
     {
-        FATAL_MSG("Failed to set the institution attribute in root group.\n");
+        FATAL_MSG("Failed to save the checkpoint after unit %d.\n", unit);
         return FATAL_ERR;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "keywords", tf_kw);
-    if ( errStatus < 0 )
+
+    return RET_SUCCESS;
+}
+
+/*
+                        estimateOutputSize
+    DESCRIPTION:
+        This function estimates the size of the output from the sizes of the input files. Unpacking turns
+        most 16-bit fields into 32-bit floats, so the estimate is twice the input size.
+    ARGUMENTS:
+        const char* inputListName   -- The name of the input file list (argv[2])
+    EFFECTS:
+        None
+    RETURN:
+        The estimated output size in bytes. Files that cannot be read are left out.
+*/
+
+static hsize_t estimateOutputSize( const char* inputListName )
+{
+    FILE* listFile = fopen( inputListName, "r" );
+    char line[STR_LEN];
+    hsize_t total = 0;
+    hsize_t memberSize = 0;
+    struct stat fileStat;
+
+    if ( listFile == NULL )
+        return 0;
+
+    while ( fgets( line, sizeof(line), listFile ) )
     {
-        FATAL_MSG("Failed to set the keywords attribute in root group.\n");
-        return FATAL_ERR;
+        line[strcspn( line, "\r\n" )] = '\0';
+        if ( line[0] == '#' || line[0] == '\0' )
+            continue;
+        if ( stat( line, &fileStat ) == 0 )
+            total += (hsize_t) fileStat.st_size;
+        else if ( tarMemberSize( line, &memberSize ) == 1 )
+            total += memberSize;
+    }
+    fclose(listFile);
+
+    return 2 * total;
+}
+
+/*
+                        spillStagedFiles
+    DESCRIPTION:
+        With BF_STAGE_MEMORY set, this function checks the size of the output files still in memory. If
+        together they exceed the memory ceiling, they are written to disk and reopened for direct writes
+        (see spillStagedOutputFile). A file with objects still open stays in memory until the next call.
+    ARGUMENTS:
+        BFcontext_t* ctx    -- The conversion context
+    EFFECTS:
+        May close and reopen the output files. Updates ctx->outputFile, instrumentFiles and stagedNames.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t spillStagedFiles( BFcontext_t* ctx )
+{
+    hsize_t total = 0;
+    hsize_t size = 0;
+
+    for ( int i = 0; i < NUM_INSTR; i++ )
+    {
+        hid_t fileID = splitOutput ? instrumentFiles[i] : ctx->outputFile;
+        if ( stagedNames[i] && fileID > 0 && H5Fget_filesize( fileID, &size ) >= 0 )
+            total += size;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "license", tf_lic);
-    if ( errStatus < 0 )
+    if ( total <= stageCeiling )
+        return RET_SUCCESS;
+
+    for ( int i = 0; i < NUM_INSTR; i++ )
     {
-        FATAL_MSG("Failed to set the license attribute in root group.\n");
-        return FATAL_ERR;
+        hid_t* fileID = splitOutput ? &instrumentFiles[i] : &ctx->outputFile;
+        hid_t oldID = *fileID;
+        herr_t status;
+
+        if ( stagedNames[i] == NULL || *fileID <= 0 )
+            continue;
+
+        printf("Writing %s to disk, the staged output exceeds BF_STAGE_MEMORY.\n", stagedNames[i]);
+        status = spillStagedOutputFile( fileID, stagedNames[i] );
+        if ( status == FATAL_ERR )
+            return FATAL_ERR;
+        if ( status == RET_SUCCESS_NO_PROCESS )
+            continue;
+
+        if ( splitOutput && ctx->outputFile == oldID )
+            ctx->outputFile = *fileID;
+        free(stagedNames[i]);
+        stagedNames[i] = NULL;
     }
 
-    errStatus = H5LTset_attribute_string( outputFile, "/", "platform", tf_plat);
-    if ( errStatus < 0 )
+    return RET_SUCCESS;
+}
+
+/*
+                        mergeGranuleList
+    DESCRIPTION:
+        This function builds the InputGranules list of a file in which one instrument was replaced. The
+        entries of the replaced instrument are taken from the new list and those of the other instruments
+        from the old list, keeping the usual MOPITT, CERES, MODIS, ASTER, MISR order.
+    ARGUMENTS:
+        const char* oldList     -- The InputGranules attribute of the existing file. May be NULL.
+        const char* newList     -- The granule list of this run. May be NULL.
+        int instrument          -- The replaced instrument (INSTR_MOPITT etc.)
+        char** merged           -- Set to the merged list, NULL if it is empty. Caller must free it.
+        size_t* mergedSize      -- Set to the allocated size of the merged list (see updateGranList)
+    EFFECTS:
+        Allocates memory.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t mergeGranuleList( const char* oldList, const char* newList, int instrument, char** merged, size_t* mergedSize )
+{
+    char* listCopy = NULL;
+
+    *merged = NULL;
+    *mergedSize = 0;
+
+    for ( int i = 0; i < NUM_INSTR; i++ )
     {
-        FATAL_MSG("Failed to set the platform attribute in root group.\n");
-        return FATAL_ERR;
+        const char* list = ( i == instrument ) ? newList : oldList;
+
+        if ( list == NULL )
+            continue;
+
+        listCopy = malloc( strlen(list) + 1 );
+        if ( listCopy == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            return FATAL_ERR;
+        }
+        strcpy( listCopy, list );
+
+        for ( char* gran = strtok( listCopy, "," ); gran != NULL; gran = strtok( NULL, "," ) )
+        {
+            if ( strncmp( gran, granulePrefixes[i], strlen(granulePrefixes[i]) ) != 0 )
+                continue;
+            if ( updateGranList( merged, gran, mergedSize ) == FATAL_ERR )
+            {
+                FATAL_MSG("Failed to update the granule list.\n");
+                free(listCopy);
+                return FATAL_ERR;
+            }
+        }
+        free(listCopy);
+        listCopy = NULL;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "processing_level", tf_Pro_Level);
-    if ( errStatus < 0 )
+
+    return RET_SUCCESS;
+}
+
+/*
+                        appendHistory
+    DESCRIPTION:
+        This function appends a line to the history attribute of the root group, creating the attribute if
+        the file does not have one yet.
+    ARGUMENTS:
+        hid_t fileID        -- The output file
+        const char* entry   -- The line to append
+    EFFECTS:
+        Rewrites the history attribute.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t appendHistory( hid_t fileID, const char* entry )
+{
+    char* history = getAttrString( fileID, "/", "history" );
+    char* newHistory = NULL;
+    herr_t status = RET_SUCCESS;
+
+    newHistory = calloc( ( history ? strlen(history) + 1 : 0 ) + strlen(entry) + 1, 1 );
+    if ( newHistory == NULL )
     {
-        FATAL_MSG("Failed to set the processing_level attribute in root group.\n");
+        FATAL_MSG("Failed to allocate memory.\n");
+        if ( history ) free(history);
         return FATAL_ERR;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "product_version", tf_Pro_Version);
-    if ( errStatus < 0 )
+    if ( history )
     {
-        FATAL_MSG("Failed to set the product_version attribute in root group.\n");
-        return FATAL_ERR;
+        strcpy( newHistory, history );
+        strcat( newHistory, "\n" );
     }
+    strcat( newHistory, entry );
 
-    errStatus = H5LTset_attribute_string( outputFile, "/", "project", tf_project);
-    if ( errStatus < 0 )
+    if ( H5LTset_attribute_string( fileID, "/", "history", newHistory ) < 0 )
     {
-        FATAL_MSG("Failed to set the project attribute in root group.\n");
-        return FATAL_ERR;
+        FATAL_MSG("Failed to set the history attribute.\n");
+        status = FATAL_ERR;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "sensors", tf_sensors);
-    if ( errStatus < 0 )
+
+    if ( history ) free(history);
+    free(newHistory);
+
+    return status;
+}
+
+/*
+                        appendSubFileGranules
+    DESCRIPTION:
+        This function appends the granules of a unit to the InputGranules attribute of a sub-file of MPI or
+        split output, creating the attribute with the first unit. A granule that the subset left out is not
+        in granules, so the attribute lists what the sub-file holds.
+    ARGUMENTS:
+        hid_t fileID            -- The sub-file
+        const char* granules    -- The comma terminated granules of the unit. May be empty.
+    EFFECTS:
+        Rewrites the InputGranules attribute of fileID.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+static herr_t appendSubFileGranules( hid_t fileID, const char* granules )
+{
+    char* oldList = NULL;
+    char* newList = NULL;
+    herr_t status = RET_SUCCESS;
+
+    if ( granules == NULL || granules[0] == '\0' )
+        return RET_SUCCESS;
+
+    oldList = getAttrString( fileID, "/", "InputGranules" );
+    newList = malloc( ( oldList ? strlen(oldList) : 0 ) + strlen(granules) + 1 );
+    if ( newList == NULL )
     {
-        FATAL_MSG("Failed to set the sensors attribute in root group.\n");
+        FATAL_MSG("Failed to allocate memory.\n");
+        if ( oldList ) free(oldList);
         return FATAL_ERR;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "summary", tf_summary);
-    if ( errStatus < 0 )
+    strcpy( newList, oldList ? oldList : "" );
+    strcat( newList, granules );
+
+    if ( H5LTset_attribute_string( fileID, "/", "InputGranules", newList ) < 0 )
     {
-        FATAL_MSG("Failed to set the summary attribute in root group.\n");
+        FATAL_MSG("Failed to set the InputGranules attribute of the sub-file.\n");
+        status = FATAL_ERR;
+    }
+
+    if ( oldList ) free(oldList);
+    free(newList);
+
+    return status;
+}
+
+/*
+                        gatherGranuleList
+    DESCRIPTION:
+        This function builds the InputGranules list of a master file. Every process walks the whole input
+        file list, but only the owner of a unit knows whether the subset left its granules out (and only the
+        owner of the CERES unit reads the CERES files to see whether they fall in the orbit), so the list of
+        rank 0 may name granules that no sub-file holds. The granules of granuleList that appear in the
+        InputGranules attribute of some sub-file (see appendSubFileGranules) are kept, in their order.
+    ARGUMENTS:
+        const char* granuleList -- The comma terminated granule list of rank 0. May be NULL.
+        char* subFileNames[]    -- The sub-files
+        int numSubFiles         -- The number of sub-files
+    EFFECTS:
+        Reads the sub-files.
+    RETURN:
+        NULL on failure
+        The list on success, "None" if it is empty. The caller must free it.
+*/
+
+static char* gatherGranuleList( const char* granuleList, char* subFileNames[], int numSubFiles )
+{
+    char* held = NULL;
+    char* listCopy = NULL;
+    char* masterList = NULL;
+    size_t masterSize = 0;
+    size_t heldLen = 1;
+    int fail = 0;
+
+    /* The granules held by the sub-files, as ",a,b,...," so that ",<granule>," finds a whole entry */
+    held = calloc( 2, 1 );
+    if ( held == NULL )
+        goto cleanupFail;
+    held[0] = ',';
+    for ( int i = 0; i < numSubFiles; i++ )
+    {
+        hid_t subFileID = H5Fopen( subFileNames[i], H5F_ACC_RDONLY, H5P_DEFAULT );
+        char* subList = NULL;
+        char* tempPtr = NULL;
+
+        if ( subFileID < 0 )
+        {
+            FATAL_MSG("Failed to open %s.\n", subFileNames[i]);
+            goto cleanupFail;
+        }
+        subList = getAttrString( subFileID, "/", "InputGranules" );
+        H5Fclose(subFileID);
+        if ( subList == NULL )
+            continue;
+        tempPtr = realloc( held, heldLen + strlen(subList) + 1 );
+        if ( tempPtr == NULL )
+        {
+            free(subList);
+            goto cleanupFail;
+        }
+        held = tempPtr;
+        strcpy( held + heldLen, subList );
+        heldLen += strlen(subList);
+        free(subList);
+    }
+
+    if ( granuleList )
+    {
+        listCopy = malloc( strlen(granuleList) + 1 );
+        if ( listCopy == NULL )
+            goto cleanupFail;
+        strcpy( listCopy, granuleList );
+    }
+
+    for ( char* gran = listCopy ? strtok( listCopy, "," ) : NULL; gran != NULL; gran = strtok( NULL, "," ) )
+    {
+        char* entry = malloc( strlen(gran) + 3 );
+        int isHeld = 0;
+
+        if ( entry == NULL )
+            goto cleanupFail;
+        sprintf( entry, ",%s,", gran );
+        isHeld = strstr( held, entry ) != NULL;
+        free(entry);
+        if ( isHeld && updateGranList( &masterList, gran, &masterSize ) == FATAL_ERR )
+            goto cleanupFail;
+    }
+
+    if ( masterList == NULL )
+    {
+        masterList = malloc( 5 );
+        if ( masterList == NULL )
+            goto cleanupFail;
+        strcpy( masterList, "None" );
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        FATAL_MSG("Failed to gather the granule list.\n");
+        fail = 1;
+    }
+
+    free(held);
+    free(listCopy);
+    if ( fail )
+    {
+        free(masterList);
+        return NULL;
+    }
+
+    return masterList;
+}
+
+/*
+                        assembleMaster
+    DESCRIPTION:
+        This function waits until every MPI rank and every split output worker has closed its files and,
+        if none of them failed, has rank 0 (the parent process) create the master output file. The master
+        file either links the objects of all sub-files (see linkSubFiles) or, with BF_CONSOLIDATE set,
+        holds a copy of them (see consolidateSubFiles), in which case the sub-files are removed. It carries
+        the root attributes (CF provenance attributes and InputGranules, with only the granules that some
+        sub-file holds, see gatherGranuleList), the collocation of the instruments (see
+        collocateInstruments) and the checksum manifest (see writeChecksumManifest). The granule metadata
+        of BF_GRANULE_METADATA describes the master file and the sub-files it links. It must be called by
+        all ranks.
+    ARGUMENTS:
+        BFcontext_t* ctx            -- The conversion context
+        char* masterFileName        -- The name of the master file (argv[1])
+        int localFail               -- Non-zero if this process failed
+        char* granuleList           -- The list of input granules of the orbit. Only used on rank 0.
+        const OInfo_t* orbitInfo    -- The orbit, for the granule metadata. Only used on rank 0.
+    EFFECTS:
+        Rank 0 creates the master file. Uses ctx->outputFile for it and closes it again.
+    RETURN:
+        FATAL_ERR if this or any other process failed
+        RET_SUCCESS on success
+*/
+
+static int assembleMaster( BFcontext_t* ctx, char* masterFileName, int localFail, char* granuleList, const OInfo_t* orbitInfo )
+{
+    int anyFail = localFail;
+    char** subFileNames = NULL;
+    int numSubFiles = 0;
+    int numInstr = splitOutput ? NUM_INSTR : 1;
+    granuleMeta_t granuleMeta = {0};
+    char* masterList = NULL;
+    short fail = 0;
+
+#ifdef BF_MPI
+    MPI_Allreduce( &localFail, &anyFail, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD );
+#endif
+
+    for ( int i = 0; i < NUM_INSTR; i++ )
+    {
+        int wstatus = 0;
+
+        if ( splitWorkerPids[i] <= 0 )
+            continue;
+        if ( waitpid( splitWorkerPids[i], &wstatus, 0 ) < 0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0 )
+        {
+            FATAL_MSG("The %s worker process failed.\n", instrumentNames[i]);
+            anyFail = 1;
+        }
+        splitWorkerPids[i] = 0;
+    }
+
+    if ( mpiRank != 0 || splitWorker > INSTR_MOPITT )
+        return anyFail ? FATAL_ERR : RET_SUCCESS;
+
+    if ( anyFail )
+    {
+        FATAL_MSG("Part of the orbit failed. The master file will not be created.\n");
         return FATAL_ERR;
     }
-    errStatus = H5LTset_attribute_string( outputFile, "/", "title", tf_title);
-    if ( errStatus < 0 )
+
+    subFileNames = calloc( numInstr * mpiSize, sizeof(char*) );
+    if ( subFileNames == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+
+    /* Instruments and ranks that had nothing to write did not create a file */
+    for ( int i = 0; i < numInstr; i++ )
+    {
+        for ( int rank = 0; rank < mpiSize; rank++ )
+        {
+            FILE* tempFile = NULL;
+            char* name = getSubFileName( masterFileName, splitOutput ? instrumentNames[i] : NULL, mpiSize > 1 ? rank : -1 );
+            if ( name == NULL )
+            {
+                FATAL_MSG("Failed to get the sub-file name.\n");
+                goto cleanupFail;
+            }
+            tempFile = fopen( name, "r" );
+            if ( tempFile == NULL )
+            {
+                free(name);
+                continue;
+            }
+            fclose(tempFile);
+            subFileNames[numSubFiles++] = name;
+        }
+    }
+
+    /* Every unit is complete, the checkpoints in the sub-files are not needed anymore */
+    for ( int i = 0; resumeMode && i < numSubFiles; i++ )
+    {
+        hid_t subFileID = H5Fopen( subFileNames[i], H5F_ACC_RDWR, H5P_DEFAULT );
+        if ( subFileID < 0 )
+        {
+            FATAL_MSG("Failed to open %s.\n", subFileNames[i]);
+            goto cleanupFail;
+        }
+        if ( removeCheckpoint( subFileID ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to remove the checkpoint from %s.\n", subFileNames[i]);
+            H5Fclose(subFileID);
+            goto cleanupFail;
+        }
+        H5Fclose(subFileID);
+    }
+
+    remove( masterFileName );
+    if ( createOutputFile( &ctx->outputFile, masterFileName ) )
+    {
+        FATAL_MSG("Unable to create the master output file.\n");
+        ctx->outputFile = 0;
+        goto cleanupFail;
+    }
+
+    if ( consolidate )
+    {
+        if ( consolidateSubFiles( ctx, ctx->outputFile, subFileNames, numSubFiles ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to consolidate the sub-files into the master file.\n");
+            goto cleanupFail;
+        }
+    }
+    else if ( linkSubFiles( ctx->outputFile, subFileNames, numSubFiles ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to link the sub-files into the master file.\n");
+        goto cleanupFail;
+    }
+
+    /* The sub-files each hold part of the instruments, so the collocation is done in the master file */
+    if ( collocateInstruments( ctx, ctx->outputFile ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to collocate the instruments.\n");
+        goto cleanupFail;
+    }
+
+    if ( writeChecksumManifest( ctx, ctx->outputFile ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the checksum manifest.\n");
+        goto cleanupFail;
+    }
+
+    if ( collectGranuleMetadata( ctx->outputFile, orbitInfo, &granuleMeta ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to collect the granule metadata.\n");
+        goto cleanupFail;
+    }
+    for ( int i = 0; !consolidate && i < numSubFiles; i++ )
+    {
+        struct stat subFileStat;
+
+        if ( stat( subFileNames[i], &subFileStat ) == 0 )
+            granuleMeta.linkedBytes += subFileStat.st_size;
+    }
+
+    if ( Add_CF_Provenance_Attrs( ctx ) < 0 )
+    {
+        FATAL_MSG("Failed to add CF provenance attributes in root group.\n");
+        goto cleanupFail;
+    }
+
+    /* Another process may have left granules of this list out of the subset */
+    masterList = gatherGranuleList( granuleList, subFileNames, numSubFiles );
+    if ( masterList == NULL )
+    {
+        FATAL_MSG("Failed to gather the input granules of the sub-files.\n");
+        goto cleanupFail;
+    }
+    if ( H5LTset_attribute_string( ctx->outputFile, "/", "InputGranules", masterList ) < 0 )
+    {
+        FATAL_MSG("Failed to set Input Granules attribute in root group.\n");
+        goto cleanupFail;
+    }
+
+    if ( consolidate )
+        for ( int i = 0; i < numSubFiles; i++ )
+            remove( subFileNames[i] );
+
+    printf("Master file %s assembled from %d sub-files.\n", masterFileName, numSubFiles);
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    if ( ctx->outputFile ) H5Fclose(ctx->outputFile);
+    ctx->outputFile = 0;
+    if ( !fail && writeGranuleMetadata( masterFileName, &granuleMeta, masterList ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to write the granule metadata of %s.\n", masterFileName);
+        fail = 1;
+    }
+    free(masterList);
+    if ( subFileNames )
+    {
+        for ( int i = 0; i < numSubFiles; i++ )
+            free(subFileNames[i]);
+        free(subFileNames);
+    }
+
+    if ( fail ) return FATAL_ERR;
+
+    return RET_SUCCESS;
+}
+
+int Add_CF_Provenance_Attrs( BFcontext_t* ctx ) {
+
+    attrStage_t stage;
+    char *tf_acknowledge = "This data set was created with funding from NASA ACCESS Grant #NNX16AM07A.";
+    char *tf_version = "First version of this product";
+    char *tf_contri_name ="Muqun Yang, Landon Clipp, Yizhao Gao, Guangyu Zhao, Larry Di Girolamo"; 
+    char *tf_contri_email ="myang6@hdfgroup.org, gzhao1@illinois.edu";
+    char *tf_inst ="The HDF Group, University of Illinois";
+    char *tf_kw = "Earth Science, TERRA, MISR, MODIS, ASTER,CERES,MOPITT, Radiance";
+    char *tf_lic = "No constraints on data access or use";
+    char *tf_plat= "TERRA";
+    char *tf_Pro_Level = "Level 1";
+    char *tf_Pro_Version = "V001";
+    char *tf_project  = "NASA ACCESS to Terra Fusion Product";
+    char *tf_sensors ="MODIS,MISR,ASTER,CERES,MOPITT";
+    char *tf_summary ="A Terra level-1 radiance basic fusion product that combines calibrated radiance measurements from MISR, MODIS, ASTER, CERES and MOPITT";
+    char *tf_title = "TERRA L1B Radiance Basic Fusion Product"; 
+    const char* names[] = { "acknowledgement", "version", "contributor_name", "contributor_email", "institution",
+                            "keywords", "license", "platform", "processing_level", "product_version", "project",
+                            "sensors", "summary", "title" };
+    const char* values[] = { tf_acknowledge, tf_version, tf_contri_name, tf_contri_email, tf_inst, tf_kw, tf_lic,
+                             tf_plat, tf_Pro_Level, tf_Pro_Version, tf_project, tf_sensors, tf_summary, tf_title };
+
+    /* Write all the attributes to the root group in one pass */
+    initAttrStage( ctx, &stage, ctx->outputFile );
+    for ( size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++ )
+    {
+        if ( stageAttrString( &stage, names[i], values[i] ) == FATAL_ERR )
+        {
+            FATAL_MSG("Failed to set the %s attribute in root group.\n", names[i]);
+            discardAttrStage( &stage );
+            return FATAL_ERR;
+        }
+    }
+
+    if ( flushAttrStage( &stage ) == FATAL_ERR )
     {
-        FATAL_MSG("Failed to set the title attribute in root group.\n");
+        FATAL_MSG("Failed to set the CF provenance attributes in root group.\n");
         return FATAL_ERR;
     }
 
@@ -0,0 +1,153 @@
+/*
+ *  Read-only access to the orbit table. See orbitTable.h.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "orbitTable.h"
+
+#define TABLE_ERR( ... ) \
+do { \
+    fprintf(stderr,"[%s:%d] Fatal error: ",__FILE__,__LINE__); \
+    fprintf(stderr, __VA_ARGS__); \
+    } while(0)
+
+/*
+                        openOrbitTable
+    DESCRIPTION:
+        Maps the orbit table at path read-only. A file without the header is taken as a bare array of
+        OInfo_t. Such an array is indexed directly if its first and last records show it to be dense,
+        and searched otherwise.
+    ARGUMENTS:
+        IN
+            const char* path        -- The orbit table
+        OUT
+            orbitTable_t* table     -- The mapped table, to be released with closeOrbitTable
+    EFFECTS:
+        Maps the file. The descriptor is closed before returning.
+    RETURN:
+        0 on success, -1 on failure.
+*/
+int openOrbitTable( const char* path, orbitTable_t* table )
+{
+    struct stat st;
+    int fd = -1;
+    const orbitTableHeader_t* header = NULL;
+
+    memset( table, 0, sizeof *table );
+    table->map = MAP_FAILED;
+
+    fd = open( path, O_RDONLY );
+    if ( fd < 0 )
+    {
+        TABLE_ERR("Failed to open the orbit table %s: %s\n", path, strerror(errno));
+        goto cleanupFail;
+    }
+    if ( fstat( fd, &st ) != 0 || st.st_size == 0 )
+    {
+        TABLE_ERR("The orbit table %s is empty or cannot be read.\n", path);
+        goto cleanupFail;
+    }
+    table->mapSize = (size_t) st.st_size;
+    table->map = mmap( NULL, table->mapSize, PROT_READ, MAP_SHARED, fd, 0 );
+    if ( table->map == MAP_FAILED )
+    {
+        TABLE_ERR("Failed to map the orbit table %s: %s\n", path, strerror(errno));
+        goto cleanupFail;
+    }
+    close( fd );
+    fd = -1;
+
+    header = table->map;
+    if ( table->mapSize >= sizeof *header && memcmp( header->magic, ORBIT_TABLE_MAGIC, sizeof header->magic ) == 0 )
+    {
+        if ( header->version != ORBIT_TABLE_VERSION || header->recordSize != sizeof(OInfo_t) )
+        {
+            TABLE_ERR("The orbit table %s is version %u with %u byte records. This program reads version %d "
+                      "with %zu byte records.\n", path, (unsigned) header->version, (unsigned) header->recordSize,
+                      ORBIT_TABLE_VERSION, sizeof(OInfo_t));
+            goto cleanupFail;
+        }
+        if ( ( table->mapSize - sizeof *header ) / sizeof(OInfo_t) < header->numOrbits )
+        {
+            TABLE_ERR("The orbit table %s is truncated.\n", path);
+            goto cleanupFail;
+        }
+        table->records = (const OInfo_t*) ( header + 1 );
+        table->firstOrbit = header->firstOrbit;
+        table->numOrbits = header->numOrbits;
+        table->indexed = 1;
+    }
+    else
+    {
+        if ( table->mapSize % sizeof(OInfo_t) )
+        {
+            TABLE_ERR("%s is not an orbit table.\n", path);
+            goto cleanupFail;
+        }
+        table->records = table->map;
+        table->numOrbits = table->mapSize / sizeof(OInfo_t);
+        table->firstOrbit = table->records[0].orbit_number;
+        if ( table->firstOrbit == 0 || table->records[0].start_month < 1 || table->records[0].start_month > 12 )
+        {
+            TABLE_ERR("%s is not an orbit table.\n", path);
+            goto cleanupFail;
+        }
+        table->indexed = table->records[table->numOrbits - 1].orbit_number ==
+                         table->firstOrbit + table->numOrbits - 1;
+    }
+
+    return 0;
+
+cleanupFail:
+    if ( fd >= 0 ) close( fd );
+    closeOrbitTable( table );
+    return -1;
+}
+
+/*
+                        findOrbit
+    DESCRIPTION:
+        Looks up the record of an orbit.
+    ARGUMENTS:
+        IN
+            const orbitTable_t* table   -- The table from openOrbitTable
+            unsigned int orbit          -- The orbit number
+    EFFECTS:
+        None
+    RETURN:
+        The record in the mapped table, or NULL if the table does not have the orbit.
+*/
+const OInfo_t* findOrbit( const orbitTable_t* table, unsigned int orbit )
+{
+    if ( table->records == NULL || orbit == 0 )
+        return NULL;
+
+    if ( table->indexed )
+    {
+        const OInfo_t* record;
+
+        if ( orbit < table->firstOrbit || orbit - table->firstOrbit >= table->numOrbits )
+            return NULL;
+        record = &table->records[orbit - table->firstOrbit];
+        return record->orbit_number == orbit ? record : NULL;
+    }
+
+    for ( uint32_t i = 0; i < table->numOrbits; i++ )
+        if ( table->records[i].orbit_number == orbit )
+            return &table->records[i];
+    return NULL;
+}
+
+void closeOrbitTable( orbitTable_t* table )
+{
+    if ( table->map != NULL && table->map != MAP_FAILED )
+        munmap( table->map, table->mapSize );
+    memset( table, 0, sizeof *table );
+}
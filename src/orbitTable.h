@@ -0,0 +1,59 @@
+#ifndef ORBITTABLE_H
+#define ORBITTABLE_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* The orbit table (orbit_info.bin) gives the start and end time of every Terra orbit. It is a header
+ * followed by one OInfo_t per orbit from firstOrbit on, so that the record of an orbit is found by
+ * subtraction. Orbits missing from the range have orbit_number 0. The file is mapped read-only, so
+ * any number of concurrent jobs share one copy in the page cache and nothing is parsed or allocated.
+ * All fields are little-endian. Files written before the header was introduced are a bare array of
+ * OInfo_t and are still read. This header depends on nothing else so that tools outside the converter
+ * (util/bf_metadata/read_time_new.c) use the same layout.
+ */
+#define ORBIT_TABLE_MAGIC "BFORBITS"
+#define ORBIT_TABLE_VERSION 1
+
+typedef struct OInfo
+{
+    unsigned int orbit_number;
+    unsigned short start_year;
+    unsigned char  start_month;
+    unsigned char start_day;
+    unsigned char start_hour;
+    unsigned char start_minute;
+    unsigned char start_second;
+    unsigned short end_year;
+    unsigned char  end_month;
+    unsigned char end_day;
+    unsigned char end_hour;
+    unsigned char end_minute;
+    unsigned char end_second;
+
+} OInfo_t;
+
+typedef struct orbitTableHeader
+{
+    char magic[8];              // ORBIT_TABLE_MAGIC, not terminated
+    uint32_t version;           // ORBIT_TABLE_VERSION
+    uint32_t recordSize;        // sizeof(OInfo_t)
+    uint32_t firstOrbit;        // Orbit of the first record
+    uint32_t numOrbits;         // Number of records
+} orbitTableHeader_t;
+
+typedef struct orbitTable
+{
+    void* map;
+    size_t mapSize;
+    const OInfo_t* records;
+    uint32_t firstOrbit;
+    uint32_t numOrbits;
+    int indexed;                // Records are dense from firstOrbit. Only a bare array may not be.
+} orbitTable_t;
+
+int openOrbitTable( const char* path, orbitTable_t* table );
+/* The record of orbit, or NULL if the table does not have it */
+const OInfo_t* findOrbit( const orbitTable_t* table, unsigned int orbit );
+void closeOrbitTable( orbitTable_t* table );
+
+#endif
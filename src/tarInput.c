@@ -0,0 +1,846 @@
+#define _POSIX_C_SOURCE 200809L
+#include "libTERRA.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <hdf5.h>
+
+/*
+ *  Input files read from a per-orbit tar archive instead of the extracted copy. An input line of the form
+ *  path/to/40110archive.tar/MEMBER names a member of the archive. The archive is indexed once, the first time
+ *  one of its members is named. HDF5 members (MOPITT) are read in place through the "bftar" file driver,
+ *  which is the sec2 driver shifted to the offset of the member. HDF4 cannot read from anything but a file,
+ *  so HDF4 members are copied to a staging directory when they are opened (see inputFilePath) and removed
+ *  again when their unit of work is done (see releaseStagedInputs).
+ */
+
+typedef struct tarMember
+{
+    char* name;
+    hsize_t offset;             // Of the member data in the archive
+    hsize_t size;
+} tarMember_t;
+
+typedef struct tarIndex
+{
+    char* path;
+    tarMember_t* members;
+    size_t num;
+} tarIndex_t;
+
+typedef struct stagedInput
+{
+    char* path;                 // As named in the input file list
+    char* stagedPath;
+} stagedInput_t;
+
+static tarIndex_t* tarIndexes = NULL;
+static size_t numTarIndexes = 0;
+
+static char* stageDir = NULL;
+static pid_t stagePid = 0;      // The process that owns stageDir and stagedInputs
+static stagedInput_t* stagedInputs = NULL;
+static size_t numStagedInputs = 0;
+static size_t numStaged = 0;    // Copies made by this process, which name their directories in stageDir
+
+/* Header fields of a ustar archive, as offsets into the 512-byte header */
+#define TAR_NAME 0
+#define TAR_SIZE 124
+#define TAR_CHKSUM 148
+#define TAR_TYPE 156
+#define TAR_MAGIC 257
+#define TAR_PREFIX 345
+#define TAR_NAME_LEN 100
+#define TAR_PREFIX_LEN 155
+
+/* A numeric header field: octal, or base-256 for sizes of 8 GiB and up */
+static hsize_t tarNumber( const unsigned char* field, size_t len )
+{
+    hsize_t value = 0;
+
+    if ( field[0] & 0x80 )
+    {
+        value = field[0] & 0x3f;
+        for ( size_t i = 1; i < len; i++ )
+            value = ( value << 8 ) | field[i];
+        return value;
+    }
+    for ( ; len > 0 && *field == ' '; field++, len-- )
+        ;
+    for ( ; len > 0 && *field >= '0' && *field <= '7'; field++, len-- )
+        value = value * 8 + ( *field - '0' );
+
+    return value;
+}
+
+/* Whether the header checksum matches: the sum of the header bytes, with the checksum field taken as
+   spaces. Some old archivers summed signed chars, so that sum is accepted too. */
+static int tarChecksumOK( const unsigned char* header )
+{
+    hsize_t stored = tarNumber( header + TAR_CHKSUM, 8 );
+    hsize_t sum = 0;
+    long signedSum = 0;
+
+    for ( size_t i = 0; i < TAR_BLOCK; i++ )
+    {
+        int inField = i >= TAR_CHKSUM && i < TAR_CHKSUM + 8;
+        sum += inField ? ' ' : header[i];
+        signedSum += inField ? ' ' : (signed char) header[i];
+    }
+
+    return stored == sum || (long) stored == signedSum;
+}
+
+/* Read len bytes at offset, retrying short reads. Returns 0 on success. */
+static int readFully( int fd, void* buffer, size_t len, hsize_t offset )
+{
+    char* p = buffer;
+
+    while ( len > 0 )
+    {
+        ssize_t got = pread( fd, p, len, (off_t) offset );
+        if ( got < 0 && errno == EINTR )
+            continue;
+        if ( got <= 0 )
+            return -1;
+        p += got;
+        len -= got;
+        offset += got;
+    }
+
+    return 0;
+}
+
+/* The value of key in the records of a pax extended header, allocated with malloc. NULL if it is absent. */
+static char* paxValue( const char* records, size_t len, const char* key )
+{
+    size_t keyLen = strlen(key);
+
+    for ( size_t pos = 0; pos < len; )
+    {
+        const char* rec = records + pos;
+        char* end = NULL;
+        long recLen = strtol( rec, &end, 10 );
+        const char* field = end + 1;
+
+        if ( recLen <= 0 || pos + recLen > len || *end != ' ' )
+            break;
+        if ( strncmp( field, key, keyLen ) == 0 && field[keyLen] == '=' )
+        {
+            size_t valueLen = rec + recLen - 1 - ( field + keyLen + 1 );
+            char* value = malloc( valueLen + 1 );
+            if ( value )
+            {
+                memcpy( value, field + keyLen + 1, valueLen );
+                value[valueLen] = '\0';
+            }
+            return value;
+        }
+        pos += recLen;
+    }
+
+    return NULL;
+}
+
+/*
+                        indexTarArchive
+    DESCRIPTION:
+        This function lists the regular files of a tar archive with the offset and size of their data. It
+        reads only the headers. ustar names with a prefix, GNU long names and pax path and size records are
+        understood. A header whose checksum does not match fails the index, since an archive that is
+        cut short or damaged would otherwise give members with the wrong data. The list is kept for the rest
+        of the run.
+    ARGUMENTS:
+        const char* tarPath     -- The archive
+    EFFECTS:
+        Adds the archive to tarIndexes.
+    RETURN:
+        The index, or NULL on failure
+*/
+
+static tarIndex_t* indexTarArchive( const char* tarPath )
+{
+    tarIndex_t index = {0};
+    tarIndex_t* temp = NULL;
+    unsigned char header[TAR_BLOCK];
+    char* longName = NULL;
+    char* paxPath = NULL;
+    hsize_t paxSize = 0;
+    int havePaxSize = 0;
+    size_t size = 0;
+    hsize_t pos = 0;
+    int fd = open( tarPath, O_RDONLY );
+    int fail = 0;
+
+    if ( fd < 0 )
+    {
+        FATAL_MSG("Failed to open the archive %s.\n", tarPath);
+        return NULL;
+    }
+
+    while ( readFully( fd, header, TAR_BLOCK, pos ) == 0 && header[0] != '\0' )
+    {
+        hsize_t dataSize = havePaxSize ? paxSize : tarNumber( header + TAR_SIZE, 12 );
+        char type = header[TAR_TYPE];
+        hsize_t dataStart = pos + TAR_BLOCK;
+
+        if ( !tarChecksumOK( header ) )
+        {
+            FATAL_MSG("The header at byte %llu of %s has a bad checksum.\n", (unsigned long long) pos, tarPath);
+            goto cleanupFail;
+        }
+        pos = dataStart + ( dataSize + TAR_BLOCK - 1 ) / TAR_BLOCK * TAR_BLOCK;
+
+        /* GNU long names and pax headers describe the entry that follows */
+        if ( type == 'L' || type == 'x' )
+        {
+            char* data = malloc( dataSize + 1 );
+
+            if ( data == NULL || readFully( fd, data, dataSize, dataStart ) != 0 )
+            {
+                FATAL_MSG("Failed to read an extended header of %s.\n", tarPath);
+                free(data);
+                goto cleanupFail;
+            }
+            data[dataSize] = '\0';
+            if ( type == 'L' )
+            {
+                free(longName);
+                longName = data;
+                continue;
+            }
+            {
+                char* value = paxValue( data, dataSize, "size" );
+
+                free(paxPath);
+                paxPath = paxValue( data, dataSize, "path" );
+                havePaxSize = value != NULL;
+                paxSize = value ? strtoull( value, NULL, 10 ) : 0;
+                free(value);
+            }
+            free(data);
+            continue;
+        }
+
+        if ( type == '0' || type == '\0' || type == '7' )
+        {
+            tarMember_t member = { NULL, dataStart, dataSize };
+
+            if ( paxPath )
+            {
+                member.name = paxPath;
+                paxPath = NULL;
+            }
+            else if ( longName )
+            {
+                member.name = longName;
+                longName = NULL;
+            }
+            else
+            {
+                char name[TAR_PREFIX_LEN + 1 + TAR_NAME_LEN + 1];
+
+                if ( memcmp( header + TAR_MAGIC, "ustar", 5 ) == 0 && header[TAR_PREFIX] != '\0' )
+                    snprintf( name, sizeof name, "%.155s/%.100s", (char*) header + TAR_PREFIX, (char*) header + TAR_NAME );
+                else
+                    snprintf( name, sizeof name, "%.100s", (char*) header + TAR_NAME );
+                member.name = strdup( name );
+            }
+
+            if ( member.name == NULL )
+            {
+                FATAL_MSG("Failed to allocate memory.\n");
+                goto cleanupFail;
+            }
+            if ( index.num == size )
+            {
+                size_t newSize = size ? 2 * size : 64;
+                tarMember_t* tempMembers = realloc( index.members, newSize * sizeof *tempMembers );
+                if ( tempMembers == NULL )
+                {
+                    FATAL_MSG("Failed to allocate memory.\n");
+                    free(member.name);
+                    goto cleanupFail;
+                }
+                index.members = tempMembers;
+                size = newSize;
+            }
+            index.members[index.num++] = member;
+        }
+
+        free(longName);
+        free(paxPath);
+        longName = paxPath = NULL;
+        havePaxSize = 0;
+    }
+
+    index.path = strdup( tarPath );
+    temp = realloc( tarIndexes, ( numTarIndexes + 1 ) * sizeof *tarIndexes );
+    if ( index.path == NULL || temp == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        if ( temp ) tarIndexes = temp;
+        goto cleanupFail;
+    }
+    tarIndexes = temp;
+    tarIndexes[numTarIndexes] = index;
+    printf("Indexed %zu members of %s.\n", index.num, tarPath);
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+        for ( size_t i = 0; i < index.num; i++ )
+            free(index.members[i].name);
+        free(index.members);
+        free(index.path);
+    }
+
+    free(longName);
+    free(paxPath);
+    close(fd);
+
+    if ( fail )
+        return NULL;
+    return &tarIndexes[numTarIndexes++];
+}
+
+/*
+                        findTarMember
+    DESCRIPTION:
+        This function tells whether an input path names a member of a tar archive: a path of the form
+        archive.tar/member, where archive.tar is a regular file. The member is looked up by its name in the
+        archive, or else by its file name, since the archives of the Terra inputs may keep a directory.
+    ARGUMENTS:
+        const char* path        -- The input path
+        tarIndex_t** index      -- Set to the index of the archive
+        tarMember_t** member    -- Set to the member
+    EFFECTS:
+        Indexes the archive the first time it is named.
+    RETURN:
+        FATAL_ERR if the archive cannot be read or has no such member
+        0 if the path does not name an archive member
+        1 if it does
+*/
+
+static int findTarMember( const char* path, tarIndex_t** index, tarMember_t** member )
+{
+    for ( const char* tar = strstr( path, ".tar/" ); tar; tar = strstr( tar + 1, ".tar/" ) )
+    {
+        size_t tarLen = tar + 4 - path;
+        const char* memberName = tar + 5;
+        const char* baseName = strrchr( memberName, '/' ) ? strrchr( memberName, '/' ) + 1 : memberName;
+        tarIndex_t* found = NULL;
+        char* tarPath = NULL;
+        struct stat tarStat;
+
+        for ( size_t i = 0; i < numTarIndexes && !found; i++ )
+            if ( strlen( tarIndexes[i].path ) == tarLen && strncmp( tarIndexes[i].path, path, tarLen ) == 0 )
+                found = &tarIndexes[i];
+
+        if ( found == NULL )
+        {
+            tarPath = strndup( path, tarLen );
+            if ( tarPath == NULL )
+            {
+                FATAL_MSG("Failed to allocate memory.\n");
+                return FATAL_ERR;
+            }
+            if ( stat( tarPath, &tarStat ) != 0 || !S_ISREG(tarStat.st_mode) )
+            {
+                free(tarPath);
+                continue;
+            }
+            found = indexTarArchive( tarPath );
+            free(tarPath);
+            if ( found == NULL )
+                return FATAL_ERR;
+        }
+
+        *index = found;
+        for ( int byBaseName = 0; byBaseName < 2; byBaseName++ )
+            for ( size_t i = 0; i < found->num; i++ )
+            {
+                const char* name = found->members[i].name;
+                if ( byBaseName && strrchr( name, '/' ) )
+                    name = strrchr( name, '/' ) + 1;
+                if ( strcmp( name, byBaseName ? baseName : memberName ) == 0 )
+                {
+                    *member = &found->members[i];
+                    return 1;
+                }
+            }
+
+        FATAL_MSG("The archive %s has no member %s.\n", found->path, memberName);
+        return FATAL_ERR;
+    }
+
+    return 0;
+}
+
+/*
+                        tarMemberSize
+    DESCRIPTION:
+        This function gives the size of an input file named as archive.tar/member (see findTarMember).
+    ARGUMENTS:
+        const char* path    -- The input path
+        hsize_t* size       -- Set to the size of the member
+    EFFECTS:
+        Indexes the archive the first time it is named.
+    RETURN:
+        FATAL_ERR on failure
+        0 if the path does not name an archive member
+        1 if it does
+*/
+
+int tarMemberSize( const char* path, hsize_t* size )
+{
+    tarIndex_t* index = NULL;
+    tarMember_t* member = NULL;
+    int status = findTarMember( path, &index, &member );
+
+    if ( status == 1 )
+        *size = member->size;
+
+    return status;
+}
+
+/* The "bftar" HDF5 file driver. The driver info of the access property list gives the archive and the
+ * place of the member in it. Only reading is supported.
+ */
+
+typedef struct tarDriverInfo
+{
+    char tarPath[STR_LEN];
+    hsize_t offset;
+    hsize_t size;
+} tarDriverInfo_t;
+
+typedef struct tarDriverFile
+{
+    H5FD_t pub;                 // Must be first
+    int fd;
+    dev_t device;
+    ino_t inode;
+    hsize_t offset;
+    haddr_t eof;
+    haddr_t eoa;
+} tarDriverFile_t;
+
+static hid_t tarDriverID = -1;
+
+static H5FD_t* tarDriverOpen( const char* name, unsigned flags, hid_t fapl, haddr_t maxaddr )
+{
+    const tarDriverInfo_t* info = H5Pget_driver_info( fapl );
+    tarDriverFile_t* file = NULL;
+    struct stat tarStat;
+    int fd = -1;
+
+    (void) name;
+    (void) maxaddr;
+    if ( info == NULL || ( flags & ( H5F_ACC_RDWR | H5F_ACC_CREAT | H5F_ACC_TRUNC ) ) )
+        return NULL;
+
+    fd = open( info->tarPath, O_RDONLY );
+    if ( fd < 0 || fstat( fd, &tarStat ) != 0 || ( file = calloc( 1, sizeof *file ) ) == NULL )
+    {
+        if ( fd >= 0 ) close(fd);
+        return NULL;
+    }
+    file->fd = fd;
+    file->device = tarStat.st_dev;
+    file->inode = tarStat.st_ino;
+    file->offset = info->offset;
+    file->eof = info->size;
+
+    return &file->pub;
+}
+
+static herr_t tarDriverClose( H5FD_t* _file )
+{
+    tarDriverFile_t* file = (tarDriverFile_t*) _file;
+    int status = close( file->fd );
+
+    free(file);
+    return status == 0 ? 0 : -1;
+}
+
+static int tarDriverCmp( const H5FD_t* _f1, const H5FD_t* _f2 )
+{
+    const tarDriverFile_t* f1 = (const tarDriverFile_t*) _f1;
+    const tarDriverFile_t* f2 = (const tarDriverFile_t*) _f2;
+
+    if ( f1->device != f2->device )
+        return f1->device < f2->device ? -1 : 1;
+    if ( f1->inode != f2->inode )
+        return f1->inode < f2->inode ? -1 : 1;
+    if ( f1->offset != f2->offset )
+        return f1->offset < f2->offset ? -1 : 1;
+    return 0;
+}
+
+static herr_t tarDriverQuery( const H5FD_t* file, unsigned long* flags )
+{
+    (void) file;
+    *flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE |
+             H5FD_FEAT_AGGREGATE_SMALLDATA;
+    return 0;
+}
+
+static haddr_t tarDriverGetEoa( const H5FD_t* file, H5FD_mem_t type )
+{
+    (void) type;
+    return ( (const tarDriverFile_t*) file )->eoa;
+}
+
+static herr_t tarDriverSetEoa( H5FD_t* file, H5FD_mem_t type, haddr_t addr )
+{
+    (void) type;
+    ( (tarDriverFile_t*) file )->eoa = addr;
+    return 0;
+}
+
+#if H5_VERSION_GE(1,10,0)
+static haddr_t tarDriverGetEof( const H5FD_t* file, H5FD_mem_t type )
+{
+    (void) type;
+#else
+static haddr_t tarDriverGetEof( const H5FD_t* file )
+{
+#endif
+    return ( (const tarDriverFile_t*) file )->eof;
+}
+
+static herr_t tarDriverGetHandle( H5FD_t* file, hid_t fapl, void** handle )
+{
+    (void) fapl;
+    *handle = &( (tarDriverFile_t*) file )->fd;
+    return 0;
+}
+
+/* Reads past the end of the member give zeros, as with the sec2 driver past the end of a file */
+static herr_t tarDriverRead( H5FD_t* _file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, void* buffer )
+{
+    tarDriverFile_t* file = (tarDriverFile_t*) _file;
+    size_t inMember = addr >= file->eof ? 0 : (size_t) min( (haddr_t) size, file->eof - addr );
+
+    (void) type;
+    (void) dxpl;
+    if ( inMember && readFully( file->fd, buffer, inMember, file->offset + addr ) != 0 )
+        return -1;
+    memset( (char*) buffer + inMember, 0, size - inMember );
+
+    return 0;
+}
+
+static herr_t tarDriverWrite( H5FD_t* file, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, const void* buffer )
+{
+    (void) file; (void) type; (void) dxpl; (void) addr; (void) size; (void) buffer;
+    return -1;
+}
+
+static const H5FD_class_t tarDriverClass = {
+    .name = "bftar",
+    .maxaddr = ( (haddr_t) 1 << 62 ) - 1,
+    .fc_degree = H5F_CLOSE_WEAK,
+    .fapl_size = sizeof(tarDriverInfo_t),
+    .open = tarDriverOpen,
+    .close = tarDriverClose,
+    .cmp = tarDriverCmp,
+    .query = tarDriverQuery,
+    .get_eoa = tarDriverGetEoa,
+    .set_eoa = tarDriverSetEoa,
+    .get_eof = tarDriverGetEof,
+    .get_handle = tarDriverGetHandle,
+    .read = tarDriverRead,
+    .write = tarDriverWrite,
+    .fl_map = H5FD_FLMAP_DICHOTOMY
+};
+
+/*
+                        tarMemberFapl
+    DESCRIPTION:
+        This function gives the file access property list to open an HDF5 input file with. For a member of a
+        tar archive (see findTarMember) it selects the bftar driver, which reads the member in place. The
+        file can only be opened read-only.
+    ARGUMENTS:
+        const char* path    -- The input path
+    EFFECTS:
+        Registers the bftar driver on first use.
+    RETURN:
+        FATAL_ERR on failure
+        H5P_DEFAULT if the path does not name an archive member
+        A new property list otherwise, to be closed by the caller
+*/
+
+hid_t tarMemberFapl( const char* path )
+{
+    tarIndex_t* index = NULL;
+    tarMember_t* member = NULL;
+    tarDriverInfo_t info;
+    hid_t fapl = -1;
+    int status = findTarMember( path, &index, &member );
+
+    if ( status != 1 )
+        return status == 0 ? H5P_DEFAULT : FATAL_ERR;
+
+    if ( strlen( index->path ) >= sizeof info.tarPath )
+    {
+        FATAL_MSG("The archive path %s is too long.\n", index->path);
+        return FATAL_ERR;
+    }
+    memset( &info, 0, sizeof info );
+    strcpy( info.tarPath, index->path );
+    info.offset = member->offset;
+    info.size = member->size;
+
+    if ( tarDriverID < 0 )
+        tarDriverID = H5FDregister( &tarDriverClass );
+    fapl = H5Pcreate( H5P_FILE_ACCESS );
+    if ( tarDriverID < 0 || fapl < 0 || H5Pset_driver( fapl, tarDriverID, &info ) < 0 )
+    {
+        FATAL_MSG("Failed to set up the archive driver for %s.\n", path);
+        if ( fapl >= 0 ) H5Pclose(fapl);
+        return FATAL_ERR;
+    }
+
+    return fapl;
+}
+
+/* Forget the staged files of the parent process after a fork. They are the parent's to remove. */
+static void claimStagedInputs( void )
+{
+    if ( stagePid == getpid() )
+        return;
+
+    for ( size_t i = 0; i < numStagedInputs; i++ )
+    {
+        free(stagedInputs[i].path);
+        free(stagedInputs[i].stagedPath);
+    }
+    free(stagedInputs);
+    free(stageDir);
+    stagedInputs = NULL;
+    numStagedInputs = 0;
+    numStaged = 0;
+    stageDir = NULL;
+    stagePid = getpid();
+}
+
+/* Create the staging directory: BF_TAR_STAGE_DIR, or /dev/shm (a tmpfs) if it exists, or TMPDIR, or /tmp */
+static int makeStageDir( void )
+{
+    const char* base = getenv("BF_TAR_STAGE_DIR");
+    char* dir = NULL;
+
+    if ( base == NULL || *base == '\0' )
+        base = access( "/dev/shm", W_OK ) == 0 ? "/dev/shm" : getenv("TMPDIR");
+    if ( base == NULL || *base == '\0' )
+        base = "/tmp";
+
+    dir = malloc( strlen(base) + 16 );
+    if ( dir == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return FATAL_ERR;
+    }
+    sprintf( dir, "%s/bfTar_XXXXXX", base );
+    if ( mkdtemp( dir ) == NULL )
+    {
+        FATAL_MSG("Failed to create a staging directory in %s.\n", base);
+        free(dir);
+        return FATAL_ERR;
+    }
+    stageDir = dir;
+
+    return RET_SUCCESS;
+}
+
+/* Remove a staged copy and its directory */
+static void removeStagedCopy( char* stagedPath )
+{
+    char* slash = strrchr( stagedPath, '/' );
+
+    remove( stagedPath );
+    *slash = '\0';
+    rmdir( stagedPath );
+    *slash = '/';
+}
+
+/* Copy a member to stagedPath */
+static herr_t copyTarMember( const tarIndex_t* index, const tarMember_t* member, const char* stagedPath )
+{
+    char* buffer = malloc( TAR_STAGE_BYTES );
+    int inFD = open( index->path, O_RDONLY );
+    int outFD = open( stagedPath, O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+    herr_t status = RET_SUCCESS;
+
+    if ( buffer == NULL || inFD < 0 || outFD < 0 )
+        status = FATAL_ERR;
+
+    for ( hsize_t done = 0; status != FATAL_ERR && done < member->size; )
+    {
+        size_t len = (size_t) min( (hsize_t) TAR_STAGE_BYTES, member->size - done );
+        size_t written = 0;
+
+        if ( readFully( inFD, buffer, len, member->offset + done ) != 0 )
+            status = FATAL_ERR;
+        while ( status != FATAL_ERR && written < len )
+        {
+            ssize_t put = write( outFD, buffer + written, len - written );
+            if ( put < 0 && errno == EINTR )
+                continue;
+            if ( put <= 0 )
+                status = FATAL_ERR;
+            else
+                written += put;
+        }
+        done += len;
+    }
+
+    if ( outFD >= 0 && close(outFD) != 0 )
+        status = FATAL_ERR;
+    if ( inFD >= 0 ) close(inFD);
+    free(buffer);
+    if ( status == FATAL_ERR )
+        remove( stagedPath );
+
+    return status;
+}
+
+/*
+                        inputFilePath
+    DESCRIPTION:
+        This function gives the path to open an HDF4 input file with. An input named as archive.tar/member
+        (see findTarMember) is copied to the staging directory the first time it is opened, and the copy is
+        used until releaseStagedInputs removes it. Each copy keeps its file name in a directory of its own, so
+        that members of the same name from other directories or archives do not overwrite it. The staging directory is
+        BF_TAR_STAGE_DIR, or else /dev/shm, so that the copy normally stays in memory. Other paths are given
+        back as they are. HDF5 inputs are read in place instead (see tarMemberFapl).
+    ARGUMENTS:
+        const char* path    -- The input path
+    EFFECTS:
+        May create the staging directory and a file in it.
+    RETURN:
+        The path to open. On failure the input path is given back, so that opening it fails.
+*/
+
+const char* inputFilePath( const char* path )
+{
+    tarIndex_t* index = NULL;
+    tarMember_t* member = NULL;
+    stagedInput_t* temp = NULL;
+    char* stagedPath = NULL;
+    const char* baseName = NULL;
+
+    if ( findTarMember( path, &index, &member ) != 1 )
+        return path;
+
+    claimStagedInputs();
+    for ( size_t i = 0; i < numStagedInputs; i++ )
+        if ( strcmp( stagedInputs[i].path, path ) == 0 )
+            return stagedInputs[i].stagedPath;
+
+    if ( stageDir == NULL && makeStageDir() == FATAL_ERR )
+        return path;
+
+    baseName = strrchr( path, '/' ) + 1;
+    stagedPath = malloc( strlen(stageDir) + 21 + strlen(baseName) + 3 );
+    temp = realloc( stagedInputs, ( numStagedInputs + 1 ) * sizeof *stagedInputs );
+    if ( temp ) stagedInputs = temp;
+    if ( stagedPath == NULL || temp == NULL || ( stagedInputs[numStagedInputs].path = strdup( path ) ) == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        free(stagedPath);
+        return path;
+    }
+    sprintf( stagedPath, "%s/%zu", stageDir, numStaged++ );
+    if ( mkdir( stagedPath, 0700 ) != 0 )
+    {
+        FATAL_MSG("Failed to create the staging directory %s.\n", stagedPath);
+        free(stagedInputs[numStagedInputs].path);
+        free(stagedPath);
+        return path;
+    }
+    sprintf( stagedPath + strlen(stagedPath), "/%s", baseName );
+
+    if ( copyTarMember( index, member, stagedPath ) == FATAL_ERR )
+    {
+        FATAL_MSG("Failed to copy %s to %s.\n", path, stagedPath);
+        removeStagedCopy( stagedPath );
+        free(stagedInputs[numStagedInputs].path);
+        free(stagedPath);
+        return path;
+    }
+    stagedInputs[numStagedInputs].stagedPath = stagedPath;
+
+    return stagedInputs[numStagedInputs++].stagedPath;
+}
+
+/*
+                        releaseStagedInputs
+    DESCRIPTION:
+        This function removes the copies that inputFilePath made of archive members. main calls it when a
+        unit of work is done, so that only the inputs of one unit take up the staging directory.
+    ARGUMENTS:
+        None
+    EFFECTS:
+        Removes the staged files of this process.
+    RETURN:
+        None
+*/
+
+void releaseStagedInputs( void )
+{
+    claimStagedInputs();
+    for ( size_t i = 0; i < numStagedInputs; i++ )
+    {
+        removeStagedCopy( stagedInputs[i].stagedPath );
+        free(stagedInputs[i].path);
+        free(stagedInputs[i].stagedPath);
+    }
+    numStagedInputs = 0;
+}
+
+/*
+                        closeTarInputs
+    DESCRIPTION:
+        This function removes the staged files and the staging directory of this process, and frees the
+        archive indexes.
+    ARGUMENTS:
+        None
+    EFFECTS:
+        Removes the staging directory.
+    RETURN:
+        None
+*/
+
+void closeTarInputs( void )
+{
+    releaseStagedInputs();
+    free(stagedInputs);
+    stagedInputs = NULL;
+    if ( stageDir )
+        rmdir( stageDir );
+    free(stageDir);
+    stageDir = NULL;
+
+    for ( size_t i = 0; i < numTarIndexes; i++ )
+    {
+        for ( size_t j = 0; j < tarIndexes[i].num; j++ )
+            free(tarIndexes[i].members[j].name);
+        free(tarIndexes[i].members);
+        free(tarIndexes[i].path);
+    }
+    free(tarIndexes);
+    tarIndexes = NULL;
+    numTarIndexes = 0;
+    if ( tarDriverID >= 0 )
+        H5FDunregister( tarDriverID );
+    tarDriverID = -1;
+}
@@ -0,0 +1,165 @@
+/*
+ *  XXH64, following the reference description of the algorithm. See xxhash64.h.
+ */
+
+#include <string.h>
+#include "xxhash64.h"
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl64( uint64_t x, int r )
+{
+    return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+static uint64_t read64( const unsigned char* p )
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t v;
+
+    memcpy( &v, p, sizeof v );
+    return v;
+#else
+    return (uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24 |
+           (uint64_t) p[4] << 32 | (uint64_t) p[5] << 40 | (uint64_t) p[6] << 48 | (uint64_t) p[7] << 56;
+#endif
+}
+
+static uint64_t read32( const unsigned char* p )
+{
+    return (uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24;
+}
+
+static uint64_t round64( uint64_t acc, uint64_t input )
+{
+    acc += input * PRIME64_2;
+    return rotl64( acc, 31 ) * PRIME64_1;
+}
+
+static uint64_t mergeRound64( uint64_t acc, uint64_t val )
+{
+    acc ^= round64( 0, val );
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+/* Consume whole 32-byte stripes. Returns the number of bytes consumed. */
+static size_t consumeStripes( uint64_t acc[4], const unsigned char* p, size_t len )
+{
+    size_t done = 0;
+
+    for ( ; done + 32 <= len; done += 32, p += 32 )
+    {
+        acc[0] = round64( acc[0], read64( p ) );
+        acc[1] = round64( acc[1], read64( p + 8 ) );
+        acc[2] = round64( acc[2], read64( p + 16 ) );
+        acc[3] = round64( acc[3], read64( p + 24 ) );
+    }
+    return done;
+}
+
+void xxh64Init( xxh64State_t* state, uint64_t seed )
+{
+    memset( state, 0, sizeof *state );
+    state->seed = seed;
+    state->acc[0] = seed + PRIME64_1 + PRIME64_2;
+    state->acc[1] = seed + PRIME64_2;
+    state->acc[2] = seed;
+    state->acc[3] = seed - PRIME64_1;
+}
+
+void xxh64Update( xxh64State_t* state, const void* data, size_t len )
+{
+    const unsigned char* p = data;
+
+    state->totalLen += len;
+
+    /* Complete a stripe left over from the previous update */
+    if ( state->memSize )
+    {
+        size_t fill = 32 - state->memSize;
+
+        if ( len < fill )
+        {
+            memcpy( state->mem + state->memSize, p, len );
+            state->memSize += len;
+            return;
+        }
+        memcpy( state->mem + state->memSize, p, fill );
+        consumeStripes( state->acc, state->mem, 32 );
+        state->memSize = 0;
+        p += fill;
+        len -= fill;
+    }
+
+    {
+        size_t done = consumeStripes( state->acc, p, len );
+
+        memcpy( state->mem, p + done, len - done );
+        state->memSize = len - done;
+    }
+}
+
+uint64_t xxh64Digest( const xxh64State_t* state )
+{
+    const unsigned char* p = state->mem;
+    const unsigned char* end = state->mem + state->memSize;
+    uint64_t h;
+
+    if ( state->totalLen >= 32 )
+    {
+        h = rotl64( state->acc[0], 1 ) + rotl64( state->acc[1], 7 ) + rotl64( state->acc[2], 12 ) +
+            rotl64( state->acc[3], 18 );
+        for ( int i = 0; i < 4; i++ )
+            h = mergeRound64( h, state->acc[i] );
+    }
+    else
+        h = state->seed + PRIME64_5;
+
+    h += state->totalLen;
+
+    for ( ; p + 8 <= end; p += 8 )
+        h = rotl64( h ^ round64( 0, read64( p ) ), 27 ) * PRIME64_1 + PRIME64_4;
+    if ( p + 4 <= end )
+    {
+        h = rotl64( h ^ ( read32( p ) * PRIME64_1 ), 23 ) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for ( ; p < end; p++ )
+        h = rotl64( h ^ ( *p * PRIME64_5 ), 11 ) * PRIME64_1;
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t xxh64( const void* data, size_t len, uint64_t seed )
+{
+    xxh64State_t state;
+
+    xxh64Init( &state, seed );
+    xxh64Update( &state, data, len );
+    return xxh64Digest( &state );
+}
+
+uint64_t xxh64Words( const uint64_t* words, size_t num, uint64_t seed )
+{
+    xxh64State_t state;
+
+    xxh64Init( &state, seed );
+    for ( size_t i = 0; i < num; i++ )
+    {
+        unsigned char bytes[8];
+
+        for ( int j = 0; j < 8; j++ )
+            bytes[j] = (unsigned char) ( words[i] >> ( 8 * j ) );
+        xxh64Update( &state, bytes, 8 );
+    }
+    return xxh64Digest( &state );
+}
@@ -0,0 +1,26 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* XXH64 (https://github.com/Cyan4973/xxHash), used for the dataset checksums (see writeChecksums). It
+ * depends on nothing else so that tools outside the converter can verify the checksums. Input is read
+ * as little-endian words whatever the host, so a checksum of the same bytes is the same everywhere.
+ */
+typedef struct xxh64State
+{
+    uint64_t totalLen;
+    uint64_t acc[4];
+    unsigned char mem[32];      // Input not yet consumed, less than a stripe
+    size_t memSize;
+    uint64_t seed;
+} xxh64State_t;
+
+void xxh64Init( xxh64State_t* state, uint64_t seed );
+void xxh64Update( xxh64State_t* state, const void* data, size_t len );
+uint64_t xxh64Digest( const xxh64State_t* state );
+uint64_t xxh64( const void* data, size_t len, uint64_t seed );
+/* The XXH64 of 64-bit words taken as little-endian bytes */
+uint64_t xxh64Words( const uint64_t* words, size_t num, uint64_t seed );
+
+#endif
@@ -0,0 +1,1087 @@
+#define _POSIX_C_SOURCE 200809L
+#include "libTERRA.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <hdf5.h>
+
+/*
+ *  The Zarr v2 output (BF_OUTPUT_FORMAT=zarr). The store is a directory with the group hierarchy of the
+ *  HDF5 output: every group is a directory with a .zgroup, every dataset a directory with a .zarray and
+ *  one file per chunk, and the attributes go into .zattrs. It is fed through the sink of the conversion
+ *  (see BFsink_t in basicFusion.h), so the values are those of the HDF5 output, in its native types.
+ *  This is a converter of the in-memory HDF5 output, not a parallel writer: the instruments write into
+ *  the one memory file, and sinkDatasets reads each dataset back from it whole, one at a time. Only the
+ *  zlib compression of the chunks of a dataset is spread over the OpenMP threads, each chunk to its own
+ *  file. The metadata of the whole store is consolidated into .zmetadata when the store is closed.
+ */
+
+typedef struct zarrMeta
+{
+    char* key;                  // Relative to the store, e.g. "MODIS/.zgroup"
+    char* json;
+} zarrMeta_t;
+
+struct zarrStore
+{
+    char* root;
+    int level;                  // zlib level, 0 for uncompressed chunks
+    char** groups;              // Relative paths of the groups written so far, "" for the root
+    size_t numGroups;
+    size_t sizeGroups;
+    zarrMeta_t* meta;
+    size_t numMeta;
+    size_t sizeMeta;
+};
+
+typedef struct zarrJson
+{
+    char* text;
+    size_t len;
+    size_t size;
+    int failed;                 // Set when an allocation failed. The text is then incomplete.
+} zarrJson_t;
+
+static void jsonAppend( zarrJson_t* json, const char* format, ... )
+{
+    va_list args;
+    int len = 0;
+
+    if ( json->failed )
+        return;
+
+    va_start( args, format );
+    len = vsnprintf( NULL, 0, format, args );
+    va_end( args );
+
+    if ( len < 0 )
+    {
+        json->failed = 1;
+        return;
+    }
+    if ( json->len + len + 1 > json->size )
+    {
+        size_t newSize = json->size ? json->size : 256;
+        char* tempPtr = NULL;
+
+        while ( json->len + len + 1 > newSize )
+            newSize *= 2;
+        tempPtr = realloc( json->text, newSize );
+        if ( tempPtr == NULL )
+        {
+            json->failed = 1;
+            return;
+        }
+        json->text = tempPtr;
+        json->size = newSize;
+    }
+
+    va_start( args, format );
+    vsnprintf( json->text + json->len, len + 1, format, args );
+    va_end( args );
+    json->len += len;
+}
+
+/* The length of the UTF-8 multibyte sequence at s, of at most maxLen bytes, or 0 if it is not valid */
+static size_t utf8Length( const unsigned char* s, size_t maxLen )
+{
+    size_t len = 0;
+    unsigned long code = 0;
+
+    if ( s[0] >= 0xc2 && s[0] <= 0xdf ) { len = 2; code = s[0] & 0x1f; }
+    else if ( s[0] >= 0xe0 && s[0] <= 0xef ) { len = 3; code = s[0] & 0x0f; }
+    else if ( s[0] >= 0xf0 && s[0] <= 0xf4 ) { len = 4; code = s[0] & 0x07; }
+    else return 0;
+
+    if ( len > maxLen )
+        return 0;
+    for ( size_t i = 1; i < len; i++ )
+    {
+        if ( ( s[i] & 0xc0 ) != 0x80 )
+            return 0;
+        code = ( code << 6 ) | ( s[i] & 0x3f );
+    }
+
+    /* Overlong forms, surrogates and code points past U+10FFFF */
+    if ( ( len == 3 && code < 0x800 ) || ( len == 4 && code < 0x10000 ) ||
+         ( code >= 0xd800 && code <= 0xdfff ) || code > 0x10ffff )
+        return 0;
+    return len;
+}
+
+/* A JSON string of at most maxLen bytes of s, stopping at a NUL. UTF-8 text is kept as it is, and bytes that are
+ * not part of a valid UTF-8 sequence become U+FFFD. */
+static void jsonString( zarrJson_t* json, const char* s, size_t maxLen )
+{
+    jsonAppend( json, "\"" );
+    for ( size_t i = 0; s && i < maxLen && s[i] != '\0'; i++ )
+    {
+        unsigned char c = (unsigned char) s[i];
+        size_t len = 0;
+
+        if ( c >= 0x80 )
+        {
+            len = utf8Length( (const unsigned char*) s + i, maxLen - i );
+            if ( len == 0 )
+                jsonAppend( json, "\\ufffd" );
+            else
+                jsonAppend( json, "%.*s", (int) len, s + i );
+            i += len ? len - 1 : 0;
+        }
+        else if ( c == '"' || c == '\\' )
+            jsonAppend( json, "\\%c", c );
+        else if ( c == '\n' )
+            jsonAppend( json, "\\n" );
+        else if ( c == '\t' )
+            jsonAppend( json, "\\t" );
+        else if ( c < 0x20 || c == 0x7f )
+            jsonAppend( json, "\\u%04x", c );
+        else
+            jsonAppend( json, "%c", c );
+    }
+    jsonAppend( json, "\"" );
+}
+
+/* One value of type at value. Floats are written with enough digits to read back the same value. */
+static void jsonValue( zarrJson_t* json, hid_t type, const void* value )
+{
+    H5T_class_t typeClass = H5Tget_class( type );
+    size_t size = H5Tget_size( type );
+
+    if ( typeClass == H5T_ENUM )
+    {
+        hid_t baseType = H5Tget_super( type );
+        jsonValue( json, baseType, value );
+        H5Tclose( baseType );
+    }
+    else if ( typeClass == H5T_INTEGER && H5Tget_sign( type ) == H5T_SGN_2 )
+    {
+        long long number = 0;
+        if ( size == 1 ) number = *(const int8_t*) value;
+        else if ( size == 2 ) { int16_t v; memcpy( &v, value, 2 ); number = v; }
+        else if ( size == 4 ) { int32_t v; memcpy( &v, value, 4 ); number = v; }
+        else { int64_t v; memcpy( &v, value, 8 ); number = v; }
+        jsonAppend( json, "%lld", number );
+    }
+    else if ( typeClass == H5T_INTEGER )
+    {
+        unsigned long long number = 0;
+        if ( size == 1 ) number = *(const uint8_t*) value;
+        else if ( size == 2 ) { uint16_t v; memcpy( &v, value, 2 ); number = v; }
+        else if ( size == 4 ) { uint32_t v; memcpy( &v, value, 4 ); number = v; }
+        else { uint64_t v; memcpy( &v, value, 8 ); number = v; }
+        jsonAppend( json, "%llu", number );
+    }
+    else if ( typeClass == H5T_FLOAT )
+    {
+        double number = 0;
+        if ( size == 4 ) { float v; memcpy( &v, value, 4 ); number = v; }
+        else memcpy( &number, value, sizeof number );
+
+        /* JSON has no literals for these. Zarr takes the same strings for fill_value. */
+        if ( isnan( number ) )
+            jsonAppend( json, "\"NaN\"" );
+        else if ( isinf( number ) )
+            jsonAppend( json, number > 0 ? "\"Infinity\"" : "\"-Infinity\"" );
+        else
+            jsonAppend( json, size == 4 ? "%.9g" : "%.17g", number );
+    }
+    else if ( typeClass == H5T_STRING )
+    {
+        if ( H5Tis_variable_str( type ) )
+            jsonString( json, *(const char* const*) value, SIZE_MAX );
+        else
+            jsonString( json, (const char*) value, size );
+    }
+    else if ( typeClass == H5T_COMPOUND )
+    {
+        int numMembers = H5Tget_nmembers( type );
+
+        jsonAppend( json, "{" );
+        for ( int i = 0; i < numMembers; i++ )
+        {
+            char* name = H5Tget_member_name( type, (unsigned) i );
+            hid_t memberType = H5Tget_member_type( type, (unsigned) i );
+
+            jsonAppend( json, i ? ", " : "" );
+            jsonString( json, name, SIZE_MAX );
+            jsonAppend( json, ": " );
+            jsonValue( json, memberType, (const char*) value + H5Tget_member_offset( type, (unsigned) i ) );
+            H5Tclose( memberType );
+            H5free_memory( name );
+        }
+        jsonAppend( json, "}" );
+    }
+    else
+        jsonAppend( json, "null" );
+}
+
+/* The Zarr dtype of type, which must be packed (see packType). Returns -1 for types Zarr has no dtype for. */
+static int jsonDtype( zarrJson_t* json, hid_t type )
+{
+    H5T_class_t typeClass = H5Tget_class( type );
+    size_t size = H5Tget_size( type );
+    char order = size == 1 ? '|' : ( H5Tget_order( type ) == H5T_ORDER_BE ? '>' : '<' );
+    int ret = 0;
+
+    if ( typeClass == H5T_ENUM )
+    {
+        hid_t baseType = H5Tget_super( type );
+        ret = jsonDtype( json, baseType );
+        H5Tclose( baseType );
+        return ret;
+    }
+    if ( typeClass == H5T_INTEGER || typeClass == H5T_BITFIELD )
+    {
+        jsonAppend( json, "\"%c%c%zu\"", order, typeClass == H5T_INTEGER && H5Tget_sign( type ) == H5T_SGN_2 ? 'i' : 'u',
+                    size );
+        return 0;
+    }
+    if ( typeClass == H5T_FLOAT && ( size == 4 || size == 8 ) )
+    {
+        jsonAppend( json, "\"%cf%zu\"", order, size );
+        return 0;
+    }
+    if ( typeClass == H5T_STRING && !H5Tis_variable_str( type ) )
+    {
+        jsonAppend( json, "\"|S%zu\"", size );
+        return 0;
+    }
+    if ( typeClass == H5T_COMPOUND )
+    {
+        int numMembers = H5Tget_nmembers( type );
+
+        jsonAppend( json, "[" );
+        for ( int i = 0; i < numMembers && ret == 0; i++ )
+        {
+            char* name = H5Tget_member_name( type, (unsigned) i );
+            hid_t memberType = H5Tget_member_type( type, (unsigned) i );
+
+            jsonAppend( json, i ? ", [" : "[" );
+            jsonString( json, name, SIZE_MAX );
+            jsonAppend( json, ", " );
+            ret = jsonDtype( json, memberType );
+            jsonAppend( json, "]" );
+            H5Tclose( memberType );
+            H5free_memory( name );
+        }
+        jsonAppend( json, "]" );
+        return ret;
+    }
+
+    return -1;
+}
+
+/* A copy of type with the members of compounds laid out back to back in index order, as Zarr expects */
+static hid_t packType( hid_t type )
+{
+    hid_t packed = -1;
+    size_t size = 0;
+    int numMembers = 0;
+
+    if ( H5Tget_class( type ) != H5T_COMPOUND )
+        return H5Tcopy( type );
+
+    numMembers = H5Tget_nmembers( type );
+    hid_t memberTypes[numMembers > 0 ? numMembers : 1];
+    for ( int i = 0; i < numMembers; i++ )
+    {
+        hid_t memberType = H5Tget_member_type( type, (unsigned) i );
+        memberTypes[i] = memberType >= 0 ? packType( memberType ) : -1;
+        if ( memberType >= 0 ) H5Tclose( memberType );
+        size += memberTypes[i] >= 0 ? H5Tget_size( memberTypes[i] ) : 0;
+    }
+
+    packed = H5Tcreate( H5T_COMPOUND, size ? size : 1 );
+    size = 0;
+    for ( int i = 0; i < numMembers; i++ )
+    {
+        char* name = H5Tget_member_name( type, (unsigned) i );
+
+        if ( packed >= 0 && ( memberTypes[i] < 0 || name == NULL || H5Tinsert( packed, name, size, memberTypes[i] ) < 0 ) )
+        {
+            H5Tclose( packed );
+            packed = -1;
+        }
+        if ( memberTypes[i] >= 0 )
+        {
+            size += H5Tget_size( memberTypes[i] );
+            H5Tclose( memberTypes[i] );
+        }
+        H5free_memory( name );
+    }
+
+    return packed;
+}
+
+/* Create path and its parents. Existing directories are fine. */
+static herr_t makeDirs( char* path )
+{
+    for ( char* p = path + 1; ; p++ )
+    {
+        if ( *p != '/' && *p != '\0' )
+            continue;
+
+        char c = *p;
+        *p = '\0';
+        if ( mkdir( path, 0755 ) != 0 && errno != EEXIST )
+        {
+            FATAL_MSG("Failed to create the directory %s: %s\n", path, strerror(errno));
+            *p = c;
+            return FATAL_ERR;
+        }
+        *p = c;
+        if ( c == '\0' )
+            return RET_SUCCESS;
+    }
+}
+
+static herr_t writeFile( const char* path, const void* data, size_t size )
+{
+    FILE* file = fopen( path, "wb" );
+
+    if ( file == NULL )
+    {
+        FATAL_MSG("Failed to create %s: %s\n", path, strerror(errno));
+        return FATAL_ERR;
+    }
+    if ( ( size && fwrite( data, 1, size, file ) != size ) | ( fclose( file ) != 0 ) )
+    {
+        FATAL_MSG("Failed to write %s.\n", path);
+        return FATAL_ERR;
+    }
+
+    return RET_SUCCESS;
+}
+
+/* The directory of key, a path relative to the store ("" is the store itself) */
+static char* storePath( const zarrStore_t* store, const char* key )
+{
+    char* path = malloc( strlen(store->root) + strlen(key) + 2 );
+
+    if ( path == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return NULL;
+    }
+    if ( *key )
+        sprintf( path, "%s/%s", store->root, key );
+    else
+        strcpy( path, store->root );
+
+    return path;
+}
+
+/* Write one metadata file (.zgroup, .zarray, .zattrs) of the object at key and keep it for .zmetadata */
+static herr_t writeMeta( zarrStore_t* store, const char* key, const char* fileName, const zarrJson_t* json )
+{
+    char* metaKey = NULL;
+    char* path = NULL;
+    char* text = NULL;
+    int fail = 0;
+
+    if ( json->failed )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return FATAL_ERR;
+    }
+
+    metaKey = malloc( strlen(key) + strlen(fileName) + 2 );
+    text = malloc( json->len + 1 );
+    if ( metaKey == NULL || text == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    if ( *key )
+        sprintf( metaKey, "%s/%s", key, fileName );
+    else
+        strcpy( metaKey, fileName );
+    memcpy( text, json->text, json->len );
+    text[json->len] = '\0';
+
+    path = storePath( store, metaKey );
+    if ( path == NULL || writeFile( path, text, json->len ) == FATAL_ERR )
+        goto cleanupFail;
+
+    if ( store->numMeta == store->sizeMeta )
+    {
+        size_t newSize = store->sizeMeta ? 2 * store->sizeMeta : 256;
+        zarrMeta_t* tempPtr = realloc( store->meta, newSize * sizeof *tempPtr );
+        if ( tempPtr == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
+        }
+        store->meta = tempPtr;
+        store->sizeMeta = newSize;
+    }
+    store->meta[store->numMeta].key = metaKey;
+    store->meta[store->numMeta].json = text;
+    store->numMeta++;
+    metaKey = NULL;
+    text = NULL;
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    free(metaKey);
+    free(text);
+    free(path);
+
+    if ( fail ) return FATAL_ERR;
+    return RET_SUCCESS;
+}
+
+/* Make key and its parents groups of the store, unless they are already */
+static herr_t ensureGroup( zarrStore_t* store, const char* key )
+{
+    char* prefix = malloc( strlen(key) + 1 );
+    size_t len = 0;
+    int fail = 0;
+
+    if ( prefix == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        return FATAL_ERR;
+    }
+
+    /* The root, then every prefix of key ending before a '/' or at the end */
+    for ( ;; )
+    {
+        size_t i = 0;
+
+        memcpy( prefix, key, len );
+        prefix[len] = '\0';
+        for ( i = 0; i < store->numGroups && strcmp( store->groups[i], prefix ) != 0; i++ )
+            ;
+        if ( i == store->numGroups )
+        {
+            zarrJson_t json = { NULL, 0, 0, 0 };
+            char* path = storePath( store, prefix );
+
+            if ( path == NULL || makeDirs( path ) == FATAL_ERR )
+            {
+                free(path);
+                goto cleanupFail;
+            }
+            free(path);
+            jsonAppend( &json, "{\n    \"zarr_format\": 2\n}\n" );
+            if ( writeMeta( store, prefix, ".zgroup", &json ) == FATAL_ERR )
+            {
+                free(json.text);
+                goto cleanupFail;
+            }
+            free(json.text);
+
+            if ( store->numGroups == store->sizeGroups )
+            {
+                size_t newSize = store->sizeGroups ? 2 * store->sizeGroups : 64;
+                char** tempPtr = realloc( store->groups, newSize * sizeof *tempPtr );
+                if ( tempPtr == NULL )
+                {
+                    FATAL_MSG("Failed to allocate memory.\n");
+                    goto cleanupFail;
+                }
+                store->groups = tempPtr;
+                store->sizeGroups = newSize;
+            }
+            store->groups[store->numGroups] = malloc( len + 1 );
+            if ( store->groups[store->numGroups] == NULL )
+            {
+                FATAL_MSG("Failed to allocate memory.\n");
+                goto cleanupFail;
+            }
+            strcpy( store->groups[store->numGroups++], prefix );
+        }
+
+        if ( key[len] == '\0' )
+            break;
+        if ( len > 0 )
+            len++;
+        while ( key[len] != '\0' && key[len] != '/' )
+            len++;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    free(prefix);
+
+    if ( fail ) return FATAL_ERR;
+    return RET_SUCCESS;
+}
+
+/* The .zattrs of an object. dimNames, if not NULL, are added as _ARRAY_DIMENSIONS, the dimension names
+ * read by xarray.
+ */
+static void jsonAttrs( zarrJson_t* json, size_t numAttrs, const BFsinkAttr_t* attrs, int rank, char* const* dimNames )
+{
+    jsonAppend( json, "{" );
+    for ( size_t i = 0; i < numAttrs; i++ )
+    {
+        const BFsinkAttr_t* attr = &attrs[i];
+        int isString = H5Tget_class( attr->type ) == H5T_STRING;
+        size_t size = H5Tget_size( attr->type );
+
+        jsonAppend( json, i ? ",\n    " : "\n    " );
+        jsonString( json, attr->name, SIZE_MAX );
+        jsonAppend( json, ": " );
+        if ( attr->numElems != 1 )
+            jsonAppend( json, "[" );
+        for ( size_t j = 0; j < attr->numElems; j++ )
+        {
+            jsonAppend( json, j ? ", " : "" );
+            if ( isString )
+                jsonString( json, ( (const char* const*) attr->value )[j], SIZE_MAX );
+            else
+                jsonValue( json, attr->type, (const char*) attr->value + j * size );
+        }
+        if ( attr->numElems != 1 )
+            jsonAppend( json, "]" );
+    }
+    if ( dimNames )
+    {
+        jsonAppend( json, numAttrs ? ",\n    " : "\n    " );
+        jsonAppend( json, "\"_ARRAY_DIMENSIONS\": [" );
+        for ( int i = 0; i < rank; i++ )
+        {
+            jsonAppend( json, i ? ", " : "" );
+            jsonString( json, dimNames[i], SIZE_MAX );
+        }
+        jsonAppend( json, "]" );
+    }
+    jsonAppend( json, "\n}\n" );
+}
+
+/* The names of the dimensions of a dataset: the name of the attached dimension scale, the dataset itself
+ * if it is a scale, or phony_dim_<size> like netCDF readers do for dimensions without a scale.
+ */
+static char** getDimNames( const BFsinkDataset_t* dataset )
+{
+    char** names = calloc( dataset->rank > 0 ? dataset->rank : 1, sizeof(char*) );
+    int isScale = 0;
+
+    if ( names == NULL )
+        return NULL;
+
+    for ( size_t i = 0; i < dataset->numAttrs; i++ )
+        if ( strcmp( dataset->attrs[i].name, "CLASS" ) == 0 && H5Tget_class( dataset->attrs[i].type ) == H5T_STRING &&
+             dataset->attrs[i].numElems == 1 && ( (const char* const*) dataset->attrs[i].value )[0] &&
+             strcmp( ( (const char* const*) dataset->attrs[i].value )[0], "DIMENSION_SCALE" ) == 0 )
+            isScale = 1;
+
+    for ( int i = 0; i < dataset->rank; i++ )
+    {
+        const char* scale = dataset->dimScales[i];
+        char phony[64];
+
+        if ( scale )
+            scale = strrchr( scale, '/' ) ? strrchr( scale, '/' ) + 1 : scale;
+        else if ( isScale && dataset->rank == 1 )
+            scale = dataset->name;
+        else
+        {
+            snprintf( phony, sizeof phony, "phony_dim_%llu", (unsigned long long) dataset->dims[i] );
+            for ( int j = 0; j < i; j++ )
+                if ( strcmp( names[j], phony ) == 0 )
+                    snprintf( phony, sizeof phony, "phony_dim_%llu_%d", (unsigned long long) dataset->dims[i], i );
+            scale = phony;
+        }
+
+        names[i] = malloc( strlen(scale) + 1 );
+        if ( names[i] == NULL )
+        {
+            for ( int j = 0; j < i; j++ )
+                free(names[j]);
+            free(names);
+            return NULL;
+        }
+        strcpy( names[i], scale );
+    }
+
+    return names;
+}
+
+/* Copy chunk c of data into chunkBuf, compress it and write it to arrayDir. Edge chunks are padded with
+ * zeros to the full chunk size, as Zarr requires.
+ */
+static herr_t writeChunk( const zarrStore_t* store, const char* arrayDir, const void* data, int rank, const hsize_t* dims,
+                          const hsize_t* chunks, const hsize_t* grid, size_t elemSize, hsize_t c )
+{
+    hsize_t start[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];
+    hsize_t chunkElems = 1;
+    hsize_t numRows = 1;
+    hsize_t rest = c;
+    size_t chunkBytes = 0;
+    char* chunkBuf = NULL;
+    Bytef* compressed = NULL;
+    char* path = NULL;
+    size_t keyLen = 0;
+    int fail = 0;
+
+    for ( int i = rank - 1; i >= 0; i-- )
+    {
+        start[i] = ( rest % grid[i] ) * chunks[i];
+        rest /= grid[i];
+        count[i] = dims[i] - start[i] < chunks[i] ? dims[i] - start[i] : chunks[i];
+        chunkElems *= chunks[i];
+        if ( i < rank - 1 )
+            numRows *= count[i];
+    }
+    chunkBytes = chunkElems * elemSize;
+
+    chunkBuf = calloc( chunkBytes, 1 );
+    path = malloc( strlen(arrayDir) + 2 + rank * 21 + 2 );
+    if ( chunkBuf == NULL || path == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+
+    /* Rows along the last dimension, in C order */
+    for ( hsize_t row = 0; row < numRows; row++ )
+    {
+        hsize_t srcOffset = 0;
+        hsize_t dstOffset = 0;
+        hsize_t rowRest = row;
+        hsize_t index[H5S_MAX_RANK];
+
+        for ( int i = rank - 2; i >= 0; i-- )
+        {
+            index[i] = rowRest % count[i];
+            rowRest /= count[i];
+        }
+        for ( int i = 0; i < rank - 1; i++ )
+        {
+            srcOffset = ( srcOffset + start[i] + index[i] ) * dims[i + 1];
+            dstOffset = ( dstOffset + index[i] ) * chunks[i + 1];
+        }
+        if ( rank > 0 )
+            srcOffset += start[rank - 1];
+        memcpy( chunkBuf + dstOffset * elemSize, (const char*) data + srcOffset * elemSize,
+                ( rank > 0 ? count[rank - 1] : 1 ) * elemSize );
+    }
+
+    keyLen = sprintf( path, "%s/", arrayDir );
+    if ( rank == 0 )
+        sprintf( path + keyLen, "0" );
+    for ( int i = 0; i < rank; i++ )
+        keyLen += sprintf( path + keyLen, i ? ".%llu" : "%llu", (unsigned long long) ( start[i] / chunks[i] ) );
+
+    if ( store->level > 0 )
+    {
+        uLongf compressedSize = compressBound( (uLong) chunkBytes );
+
+        compressed = malloc( compressedSize );
+        if ( compressed == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            goto cleanupFail;
+        }
+        if ( compress2( compressed, &compressedSize, (const Bytef*) chunkBuf, (uLong) chunkBytes, store->level ) != Z_OK )
+        {
+            FATAL_MSG("Failed to compress the chunk %s.\n", path);
+            goto cleanupFail;
+        }
+        if ( writeFile( path, compressed, compressedSize ) == FATAL_ERR )
+            goto cleanupFail;
+    }
+    else if ( writeFile( path, chunkBuf, chunkBytes ) == FATAL_ERR )
+        goto cleanupFail;
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    free(chunkBuf);
+    free(compressed);
+    free(path);
+
+    if ( fail ) return FATAL_ERR;
+    return RET_SUCCESS;
+}
+
+/*
+                    zarrOpenStore
+    DESCRIPTION:
+        This function starts a Zarr v2 store in the directory dirName, which is created. An existing
+        directory must be empty, so that the store does not mix with the arrays of an earlier run.
+    ARGUMENTS:
+        1. dirName -- The directory of the store
+        2. level   -- The zlib compression level of the chunks (ctx->gzipLevel). 0 writes them uncompressed.
+    EFFECTS:
+        Creates the directory.
+    RETURN:
+        The store, to be passed as the userData of a sink with zarrSinkDataset and zarrSinkGroup and then
+        to zarrCloseStore. NULL on failure.
+*/
+
+zarrStore_t* zarrOpenStore( const char* dirName, int level )
+{
+    zarrStore_t* store = calloc( 1, sizeof *store );
+    DIR* dir = NULL;
+    struct dirent* entry = NULL;
+
+    if ( store == NULL || ( store->root = malloc( strlen(dirName) + 1 ) ) == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        free(store);
+        return NULL;
+    }
+    strcpy( store->root, dirName );
+    store->level = level;
+
+    /* No trailing slashes, the keys are appended with one */
+    for ( size_t len = strlen(store->root); len > 1 && store->root[len - 1] == '/'; len-- )
+        store->root[len - 1] = '\0';
+
+    if ( makeDirs( store->root ) == FATAL_ERR )
+        goto cleanupFail;
+    dir = opendir( store->root );
+    if ( dir == NULL )
+    {
+        FATAL_MSG("Failed to open the directory %s: %s\n", store->root, strerror(errno));
+        goto cleanupFail;
+    }
+    while ( ( entry = readdir( dir ) ) != NULL )
+        if ( strcmp( entry->d_name, "." ) != 0 && strcmp( entry->d_name, ".." ) != 0 )
+        {
+            FATAL_MSG("The Zarr output directory %s is not empty. Remove it first.\n", store->root);
+            closedir( dir );
+            goto cleanupFail;
+        }
+    closedir( dir );
+
+    if ( ensureGroup( store, "" ) == FATAL_ERR )
+        goto cleanupFail;
+
+    return store;
+
+cleanupFail:
+    zarrCloseStore( store, 0 );
+    return NULL;
+}
+
+/*
+                    zarrSinkDataset
+    DESCRIPTION:
+        This function is the dataset callback of the Zarr sink (see BFsink_t). It writes the dataset as an
+        array of the store under the same path: the .zarray, the .zattrs with the attributes and the
+        dimension names, and the chunks. The chunks are about ZARR_CHUNK_BYTES, split along the outer
+        dimensions, and are compressed and written by the OpenMP threads. Compound types are stored as
+        structured dtypes. Variable length strings are stored as fixed length strings of the longest one.
+    ARGUMENTS:
+        1. userData -- The store (see zarrOpenStore)
+        2. dataset  -- The dataset
+    EFFECTS:
+        Writes the array to the store.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success. Datasets of types Zarr has no dtype for are skipped with a warning.
+*/
+
+herr_t zarrSinkDataset( void* userData, const BFsinkDataset_t* dataset )
+{
+    zarrStore_t* store = (zarrStore_t*) userData;
+    zarrJson_t json = { NULL, 0, 0, 0 };
+    hsize_t chunks[H5S_MAX_RANK];
+    hsize_t grid[H5S_MAX_RANK];
+    hsize_t numElems = 1;
+    hsize_t numChunks = 1;
+    hsize_t inner = 0;
+    hid_t packed = -1;
+    void* converted = NULL;
+    const void* data = dataset->buffer;
+    char** dimNames = NULL;
+    char* key = NULL;
+    char* arrayDir = NULL;
+    size_t elemSize = 0;
+    int rank = dataset->rank;
+    int failed = 0;
+    int fail = 0;
+
+    for ( int i = 0; i < rank; i++ )
+        numElems *= dataset->dims[i];
+
+    /* The values as Zarr lays them out: compounds packed, variable length strings made fixed */
+    if ( H5Tis_variable_str( dataset->type ) > 0 )
+    {
+        size_t maxLen = 1;
+        const char* const* strings = (const char* const*) dataset->buffer;
+
+        for ( hsize_t i = 0; i < numElems; i++ )
+            if ( strings[i] && strlen(strings[i]) > maxLen )
+                maxLen = strlen(strings[i]);
+        packed = H5Tcopy( H5T_C_S1 );
+        converted = calloc( numElems ? numElems : 1, maxLen );
+        if ( packed < 0 || H5Tset_size( packed, maxLen ) < 0 || converted == NULL )
+        {
+            FATAL_MSG("Failed to convert the strings of %s.\n", dataset->name);
+            goto cleanupFail;
+        }
+        for ( hsize_t i = 0; i < numElems; i++ )
+            if ( strings[i] )
+                strncpy( (char*) converted + i * maxLen, strings[i], maxLen );
+        data = converted;
+    }
+    else if ( H5Tget_class( dataset->type ) == H5T_COMPOUND )
+    {
+        size_t bufferSize = 0;
+        void* background = NULL;
+
+        packed = packType( dataset->type );
+        if ( packed < 0 )
+        {
+            FATAL_MSG("Failed to pack the datatype of %s.\n", dataset->name);
+            goto cleanupFail;
+        }
+        bufferSize = H5Tget_size( packed ) > H5Tget_size( dataset->type ) ? H5Tget_size( packed ) : H5Tget_size( dataset->type );
+        converted = malloc( ( numElems ? numElems : 1 ) * bufferSize );
+        background = calloc( numElems ? numElems : 1, bufferSize );
+        if ( converted == NULL || background == NULL )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            free(background);
+            goto cleanupFail;
+        }
+        memcpy( converted, dataset->buffer, numElems * H5Tget_size( dataset->type ) );
+        if ( numElems && H5Tconvert( dataset->type, packed, (size_t) numElems, converted, background, H5P_DEFAULT ) < 0 )
+        {
+            FATAL_MSG("Failed to pack the values of %s.\n", dataset->name);
+            free(background);
+            goto cleanupFail;
+        }
+        free(background);
+        data = converted;
+    }
+    else
+        packed = H5Tcopy( dataset->type );
+    if ( packed < 0 )
+    {
+        FATAL_MSG("Failed to copy the datatype of %s.\n", dataset->name);
+        goto cleanupFail;
+    }
+    elemSize = H5Tget_size( packed );
+
+    /* Whole rows of the inner dimensions, as many as make about ZARR_CHUNK_BYTES */
+    inner = elemSize;
+    for ( int i = 0; i < rank; i++ )
+        inner *= dataset->dims[i] ? dataset->dims[i] : 1;
+    for ( int i = 0; i < rank; i++ )
+    {
+        hsize_t dim = dataset->dims[i] ? dataset->dims[i] : 1;
+
+        inner /= dim;
+        if ( inner >= ZARR_CHUNK_BYTES )
+            chunks[i] = 1;
+        else
+        {
+            chunks[i] = ZARR_CHUNK_BYTES / inner < dim ? ZARR_CHUNK_BYTES / inner : dim;
+            for ( int j = i + 1; j < rank; j++ )
+                chunks[j] = dataset->dims[j] ? dataset->dims[j] : 1;
+            break;
+        }
+    }
+    for ( int i = 0; i < rank; i++ )
+    {
+        grid[i] = ( dataset->dims[i] + chunks[i] - 1 ) / chunks[i];
+        numChunks *= grid[i];
+    }
+
+    jsonAppend( &json, "{\n    \"chunks\": [" );
+    for ( int i = 0; i < rank; i++ )
+        jsonAppend( &json, i ? ", %llu" : "%llu", (unsigned long long) chunks[i] );
+    if ( store->level > 0 )
+        jsonAppend( &json, "],\n    \"compressor\": {\n        \"id\": \"zlib\",\n        \"level\": %d\n    },\n", store->level );
+    else
+        jsonAppend( &json, "],\n    \"compressor\": null,\n" );
+    jsonAppend( &json, "    \"dtype\": " );
+    if ( jsonDtype( &json, packed ) < 0 )
+    {
+        WARN_MSG("%s/%s has a datatype Zarr cannot store. It is left out of the Zarr output.\n",
+                 strcmp( dataset->groupPath, "/" ) ? dataset->groupPath : "", dataset->name);
+        goto cleanup;
+    }
+    jsonAppend( &json, ",\n    \"fill_value\": null,\n    \"filters\": null,\n    \"order\": \"C\",\n    \"shape\": [" );
+    for ( int i = 0; i < rank; i++ )
+        jsonAppend( &json, i ? ", %llu" : "%llu", (unsigned long long) dataset->dims[i] );
+    jsonAppend( &json, "],\n    \"zarr_format\": 2\n}\n" );
+
+    /* The key of the array: the path without the leading '/' */
+    key = malloc( strlen(dataset->groupPath) + strlen(dataset->name) + 2 );
+    if ( key == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    if ( strcmp( dataset->groupPath, "/" ) == 0 )
+        strcpy( key, dataset->name );
+    else
+        sprintf( key, "%s/%s", dataset->groupPath + 1, dataset->name );
+    if ( ensureGroup( store, strcmp( dataset->groupPath, "/" ) ? dataset->groupPath + 1 : "" ) == FATAL_ERR )
+        goto cleanupFail;
+    arrayDir = storePath( store, key );
+    if ( arrayDir == NULL || makeDirs( arrayDir ) == FATAL_ERR || writeMeta( store, key, ".zarray", &json ) == FATAL_ERR )
+        goto cleanupFail;
+
+    dimNames = rank > 0 ? getDimNames( dataset ) : NULL;
+    if ( rank > 0 && dimNames == NULL )
+    {
+        FATAL_MSG("Failed to allocate memory.\n");
+        goto cleanupFail;
+    }
+    json.len = 0;
+    jsonAttrs( &json, dataset->numAttrs, dataset->attrs, rank, dimNames );
+    if ( writeMeta( store, key, ".zattrs", &json ) == FATAL_ERR )
+        goto cleanupFail;
+
+    if ( numElems > 0 )
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(|:failed)
+#endif
+        for ( long c = 0; c < (long) numChunks; c++ )
+            failed |= writeChunk( store, arrayDir, data, rank, dataset->dims, chunks, grid, elemSize, (hsize_t) c ) == FATAL_ERR;
+    }
+    if ( failed )
+    {
+        FATAL_MSG("Failed to write the chunks of %s.\n", key);
+        goto cleanupFail;
+    }
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+cleanup:
+    if ( dimNames )
+        for ( int i = 0; i < rank; i++ )
+            free(dimNames[i]);
+    free(dimNames);
+    free(json.text);
+    free(converted);
+    free(key);
+    free(arrayDir);
+    if ( packed >= 0 ) H5Tclose(packed);
+
+    if ( fail ) return FATAL_ERR;
+    return RET_SUCCESS;
+}
+
+/*
+                    zarrSinkGroup
+    DESCRIPTION:
+        This function is the group callback of the Zarr sink (see BFsink_t). It makes groupPath a group of
+        the store, so that groups without datasets are kept, and writes its attributes to .zattrs.
+    ARGUMENTS:
+        1. userData  -- The store (see zarrOpenStore)
+        2. groupPath -- The absolute path of the group
+        3. numAttrs  -- The number of attributes
+        4. attrs     -- The attributes
+    EFFECTS:
+        Writes the group to the store.
+    RETURN:
+        FATAL_ERR on failure
+        RET_SUCCESS on success
+*/
+
+herr_t zarrSinkGroup( void* userData, const char* groupPath, size_t numAttrs, const BFsinkAttr_t* attrs )
+{
+    zarrStore_t* store = (zarrStore_t*) userData;
+    zarrJson_t json = { NULL, 0, 0, 0 };
+    const char* key = strcmp( groupPath, "/" ) ? groupPath + 1 : "";
+    herr_t status = RET_SUCCESS;
+
+    if ( ensureGroup( store, key ) == FATAL_ERR )
+        return FATAL_ERR;
+    if ( numAttrs == 0 )
+        return RET_SUCCESS;
+
+    jsonAttrs( &json, numAttrs, attrs, 0, NULL );
+    status = writeMeta( store, key, ".zattrs", &json );
+    free(json.text);
+
+    return status;
+}
+
+/*
+                    zarrCloseStore
+    DESCRIPTION:
+        This function finishes a store started by zarrOpenStore. With consolidate set, the metadata of all
+        groups and arrays is written to .zmetadata, so that readers open the store with one read.
+    ARGUMENTS:
+        1. store       -- The store. May be NULL.
+        2. consolidate -- Non-zero writes .zmetadata. Zero leaves a failed store without it.
+    EFFECTS:
+        Frees the store.
+    RETURN:
+        FATAL_ERR if .zmetadata could not be written
+        RET_SUCCESS otherwise
+*/
+
+herr_t zarrCloseStore( zarrStore_t* store, int consolidate )
+{
+    zarrJson_t json = { NULL, 0, 0, 0 };
+    char* path = NULL;
+    herr_t status = RET_SUCCESS;
+
+    if ( store == NULL )
+        return RET_SUCCESS;
+
+    if ( consolidate )
+    {
+        jsonAppend( &json, "{\n    \"metadata\": {" );
+        for ( size_t i = 0; i < store->numMeta; i++ )
+        {
+            jsonAppend( &json, i ? ",\n        " : "\n        " );
+            jsonString( &json, store->meta[i].key, SIZE_MAX );
+            jsonAppend( &json, ": %s", store->meta[i].json );
+        }
+        jsonAppend( &json, "\n    },\n    \"zarr_consolidated_format\": 1\n}\n" );
+
+        path = storePath( store, ".zmetadata" );
+        if ( json.failed )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            status = FATAL_ERR;
+        }
+        else if ( path == NULL || writeFile( path, json.text, json.len ) == FATAL_ERR )
+            status = FATAL_ERR;
+        free(path);
+        free(json.text);
+    }
+
+    for ( size_t i = 0; i < store->numGroups; i++ )
+        free(store->groups[i]);
+    for ( size_t i = 0; i < store->numMeta; i++ )
+    {
+        free(store->meta[i].key);
+        free(store->meta[i].json);
+    }
+    free(store->groups);
+    free(store->meta);
+    free(store->root);
+    free(store);
+
+    return status;
+}
@@ -0,0 +1,516 @@
+/*
+ *  This program verifies the checksums that the converter stores with BF_CHECKSUM=1 (see writeChecksums
+ *  and writeChecksumManifest in src/libTERRA.c). It replaces reading every file with an external command
+ *  to find corrupt outputs (util/verification_scripts/Corrupt_Files_all.py).
+ *
+ *  Every dataset with checksums is read back one block at a time, as it was checksummed when written,
+ *  and the XXH64 of each block is compared with the stored one, so damage is located to a block (a chunk
+ *  of a chunked dataset). The datasets found are checked against the manifest in /BF_Checksums, so that
+ *  datasets that lost their checksums or disappeared are reported too. External links are followed, so
+ *  a master file is verified together with its sub-files.
+ *
+ *  Usage: BFChecksum [-j procs] [-q] file.h5 ...
+ *
+ *  With -j, that many files are verified at once, each in its own process. -q prints only problems.
+ *  Returns 0 if all files are intact, 1 if any is damaged, 2 if any could not be verified.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "hdf5.h"
+#include "xxhash64.h"
+
+/* As in src/libTERRA.h */
+#define CHECKSUM_GROUP "BF_Checksums"
+#define CHECKSUM_ATTR "checksum_xxh64"
+#define CHECKSUM_BLOCKS_ATTR "checksum_xxh64_blocks"
+#define CHECKSUM_BLOCK_DIMS_ATTR "checksum_block_dims"
+
+typedef struct
+{
+    char* path;
+    uint64_t checksum;
+    uint64_t numBlocks;
+} checksumEntry_t;
+
+typedef struct
+{
+    checksumEntry_t* entries;
+    size_t num;
+    size_t size;
+} checksumList_t;
+
+typedef struct
+{
+    FILE* out;
+    const char* fileName;
+    hid_t fileID;
+    int quiet;
+    unsigned long numDatasets;
+    unsigned long long numBlocks;
+    unsigned long long numBytes;
+    unsigned long numDamaged;
+    unsigned long numErrors;
+    checksumList_t found;
+} verifyState_t;
+
+static int addEntry( checksumList_t* list, const char* path, uint64_t checksum, uint64_t numBlocks )
+{
+    if ( list->num == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 64;
+        checksumEntry_t* temp = realloc( list->entries, newSize * sizeof *temp );
+        if ( temp == NULL )
+            return -1;
+        list->entries = temp;
+        list->size = newSize;
+    }
+    list->entries[list->num].path = malloc( strlen(path) + 1 );
+    if ( list->entries[list->num].path == NULL )
+        return -1;
+    strcpy( list->entries[list->num].path, path );
+    list->entries[list->num].checksum = checksum;
+    list->entries[list->num].numBlocks = numBlocks;
+    list->num++;
+    return 0;
+}
+
+static void freeEntries( checksumList_t* list )
+{
+    for ( size_t i = 0; i < list->num; i++ )
+        free(list->entries[i].path);
+    free(list->entries);
+    memset( list, 0, sizeof *list );
+}
+
+static int compareEntries( const void* a, const void* b )
+{
+    return strcmp( ((const checksumEntry_t*) a)->path, ((const checksumEntry_t*) b)->path );
+}
+
+static void damaged( verifyState_t* state, const char* path, const char* message )
+{
+    fprintf( state->out, "%s: %s %s\n", state->fileName, path, message );
+    state->numDamaged++;
+}
+
+static int readUint64Attr( hid_t objID, const char* name, uint64_t** values, hssize_t* num )
+{
+    hid_t attrID = H5Aopen( objID, name, H5P_DEFAULT );
+    hid_t spaceID = attrID >= 0 ? H5Aget_space( attrID ) : -1;
+    int ret = -1;
+
+    *values = NULL;
+    *num = spaceID >= 0 ? H5Sget_simple_extent_npoints( spaceID ) : -1;
+    if ( *num > 0 )
+    {
+        *values = malloc( *num * sizeof(uint64_t) );
+        if ( *values && H5Aread( attrID, H5T_NATIVE_UINT64, *values ) >= 0 )
+            ret = 0;
+    }
+
+    if ( spaceID >= 0 ) H5Sclose(spaceID);
+    if ( attrID >= 0 ) H5Aclose(attrID);
+    if ( ret < 0 )
+    {
+        free(*values);
+        *values = NULL;
+    }
+    return ret;
+}
+
+/* Verify the blocks of one dataset against its checksum attributes */
+static void verifyDataset( verifyState_t* state, const char* path )
+{
+    hid_t dsetID = H5Dopen2( state->fileID, path, H5P_DEFAULT );
+    hid_t fileType = -1;
+    hid_t memType = -1;
+    hid_t fileSpace = -1;
+    hid_t memSpace = -1;
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t block[H5S_MAX_RANK];
+    hsize_t grid[H5S_MAX_RANK];
+    uint64_t* checksum = NULL;
+    uint64_t* sums = NULL;
+    uint64_t* blockDims = NULL;
+    hssize_t numChecksum = 0;
+    hssize_t numSums = 0;
+    hssize_t numBlockDims = 0;
+    size_t elemSize = 0;
+    size_t blockElems = 1;
+    unsigned char* buffer = NULL;
+    int rank = 0;
+
+    if ( dsetID < 0 || readUint64Attr( dsetID, CHECKSUM_ATTR, &checksum, &numChecksum ) < 0 ||
+         readUint64Attr( dsetID, CHECKSUM_BLOCKS_ATTR, &sums, &numSums ) < 0 )
+    {
+        damaged( state, path, "has unreadable checksum attributes" );
+        goto done;
+    }
+    state->numDatasets++;
+    if ( addEntry( &state->found, path, checksum[0], (uint64_t) numSums ) < 0 )
+    {
+        fprintf( state->out, "%s: cannot allocate memory\n", state->fileName );
+        state->numErrors++;
+        goto done;
+    }
+    if ( xxh64Words( sums, numSums, 0 ) != checksum[0] )
+        damaged( state, path, "has block checksums that do not match its checksum" );
+
+    fileSpace = H5Dget_space( dsetID );
+    fileType = H5Dget_type( dsetID );
+    memType = fileType >= 0 ? H5Tget_native_type( fileType, H5T_DIR_ASCEND ) : -1;
+    rank = fileSpace >= 0 ? H5Sget_simple_extent_ndims( fileSpace ) : -1;
+    if ( memType < 0 || rank < 0 || H5Sget_simple_extent_dims( fileSpace, dims, NULL ) < 0 ||
+         ( rank > 0 && ( readUint64Attr( dsetID, CHECKSUM_BLOCK_DIMS_ATTR, &blockDims, &numBlockDims ) < 0 ||
+                         numBlockDims != rank ) ) )
+    {
+        damaged( state, path, "has an unreadable shape or block shape" );
+        goto done;
+    }
+
+    {
+        hssize_t numBlocks = 1;
+
+        for ( int i = 0; i < rank; i++ )
+        {
+            block[i] = blockDims[i] ? blockDims[i] : 1;
+            grid[i] = ( dims[i] + block[i] - 1 ) / block[i];
+            numBlocks *= grid[i];
+            blockElems *= block[i];
+        }
+        if ( numBlocks != numSums )
+        {
+            damaged( state, path, "has a different number of blocks than checksums" );
+            goto done;
+        }
+    }
+
+    elemSize = H5Tget_size( memType );
+    buffer = malloc( blockElems * elemSize );
+    if ( buffer == NULL )
+    {
+        fprintf( state->out, "%s: cannot allocate %zu bytes for %s\n", state->fileName, blockElems * elemSize, path );
+        state->numErrors++;
+        goto done;
+    }
+
+    /* Read the blocks in the order they were checksummed */
+    for ( hssize_t b = 0; b < numSums; b++ )
+    {
+        hsize_t start[H5S_MAX_RANK];
+        hsize_t count[H5S_MAX_RANK];
+        hsize_t numElems = 1;
+        hsize_t rest = (hsize_t) b;
+        int ok = 0;
+
+        for ( int i = rank - 1; i >= 0; i-- )
+        {
+            start[i] = ( rest % grid[i] ) * block[i];
+            rest /= grid[i];
+            count[i] = dims[i] - start[i] < block[i] ? dims[i] - start[i] : block[i];
+            numElems *= count[i];
+        }
+
+        memSpace = H5Screate_simple( 1, &numElems, NULL );
+        if ( memSpace >= 0 &&
+             ( rank == 0 || H5Sselect_hyperslab( fileSpace, H5S_SELECT_SET, start, NULL, count, NULL ) >= 0 ) &&
+             H5Dread( dsetID, memType, memSpace, fileSpace, H5P_DEFAULT, buffer ) >= 0 )
+            ok = xxh64( buffer, numElems * elemSize, 0 ) == sums[b];
+        if ( memSpace >= 0 ) H5Sclose(memSpace);
+        memSpace = -1;
+
+        state->numBlocks++;
+        state->numBytes += numElems * elemSize;
+        if ( !ok )
+        {
+            char message[256];
+            int len = snprintf( message, sizeof message, "block %lld at (", (long long) b );
+
+            for ( int i = 0; i < rank && len < (int) sizeof message; i++ )
+                len += snprintf( message + len, sizeof message - len, i ? ",%llu" : "%llu", (unsigned long long) start[i] );
+            if ( len < (int) sizeof message )
+                snprintf( message + len, sizeof message - len, ") is damaged" );
+            damaged( state, path, message );
+        }
+    }
+
+done:
+    free(buffer);
+    free(checksum);
+    free(sums);
+    free(blockDims);
+    if ( memType >= 0 ) H5Tclose(memType);
+    if ( fileType >= 0 ) H5Tclose(fileType);
+    if ( fileSpace >= 0 ) H5Sclose(fileSpace);
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+}
+
+static herr_t collectName( hid_t group, const char* name, const H5L_info_t* info, void* opdata )
+{
+    return addEntry( (checksumList_t*) opdata, name, 0, 0 );
+}
+
+/* Verify the datasets below groupPath, following external links */
+static void verifyGroup( verifyState_t* state, const char* groupPath )
+{
+    checksumList_t children = { NULL, 0, 0 };
+
+    if ( H5Literate_by_name( state->fileID, groupPath, H5_INDEX_NAME, H5_ITER_INC, NULL, collectName, &children,
+                             H5P_DEFAULT ) < 0 )
+    {
+        damaged( state, groupPath, "cannot be listed" );
+        freeEntries( &children );
+        return;
+    }
+
+    for ( size_t i = 0; i < children.num; i++ )
+    {
+        char* path = malloc( strlen(groupPath) + strlen(children.entries[i].path) + 2 );
+        H5O_info_t info;
+
+        if ( path == NULL )
+            break;
+        sprintf( path, "%s/%s", strcmp( groupPath, "/" ) == 0 ? "" : groupPath, children.entries[i].path );
+
+        if ( strcmp( path, "/" CHECKSUM_GROUP ) == 0 )
+            ;
+        else if ( H5Oget_info_by_name( state->fileID, path, &info, H5P_DEFAULT ) < 0 )
+            damaged( state, path, "cannot be opened" );
+        else if ( info.type == H5O_TYPE_GROUP )
+            verifyGroup( state, path );
+        else if ( info.type == H5O_TYPE_DATASET && H5Aexists_by_name( state->fileID, path, CHECKSUM_ATTR, H5P_DEFAULT ) > 0 )
+            verifyDataset( state, path );
+        free(path);
+    }
+
+    freeEntries( &children );
+}
+
+/* Compare the datasets found with the manifest */
+static void verifyManifest( verifyState_t* state )
+{
+    checksumList_t manifest = { NULL, 0, 0 };
+    hid_t tableID = -1;
+    hid_t spaceID = -1;
+    hid_t strType = -1;
+    hid_t entryType = -1;
+    hid_t groupID = -1;
+    uint64_t* fileChecksum = NULL;
+    uint64_t* sums = NULL;
+    hssize_t numFileChecksum = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    if ( H5Lexists( state->fileID, "/" CHECKSUM_GROUP, H5P_DEFAULT ) <= 0 )
+    {
+        if ( state->numDatasets )
+            damaged( state, "/" CHECKSUM_GROUP, "is missing" );
+        return;
+    }
+
+    groupID = H5Gopen2( state->fileID, "/" CHECKSUM_GROUP, H5P_DEFAULT );
+    tableID = groupID >= 0 ? H5Dopen2( groupID, "manifest", H5P_DEFAULT ) : -1;
+    spaceID = tableID >= 0 ? H5Dget_space( tableID ) : -1;
+    strType = H5Tcopy( H5T_C_S1 );
+    entryType = H5Tcreate( H5T_COMPOUND, sizeof(checksumEntry_t) );
+    if ( spaceID < 0 || H5Tset_size( strType, H5T_VARIABLE ) < 0 ||
+         H5Tinsert( entryType, "path", HOFFSET(checksumEntry_t, path), strType ) < 0 ||
+         H5Tinsert( entryType, "checksum", HOFFSET(checksumEntry_t, checksum), H5T_NATIVE_UINT64 ) < 0 ||
+         H5Tinsert( entryType, "blocks", HOFFSET(checksumEntry_t, numBlocks), H5T_NATIVE_UINT64 ) < 0 )
+    {
+        damaged( state, "/" CHECKSUM_GROUP "/manifest", "cannot be opened" );
+        goto done;
+    }
+
+    manifest.num = manifest.size = H5Sget_simple_extent_npoints( spaceID );
+    manifest.entries = calloc( manifest.num ? manifest.num : 1, sizeof(checksumEntry_t) );
+    sums = malloc( ( manifest.num ? manifest.num : 1 ) * sizeof *sums );
+    if ( manifest.entries == NULL || sums == NULL ||
+         H5Dread( tableID, entryType, H5S_ALL, H5S_ALL, H5P_DEFAULT, manifest.entries ) < 0 )
+    {
+        damaged( state, "/" CHECKSUM_GROUP "/manifest", "cannot be read" );
+        goto done;
+    }
+
+    /* The file checksum covers the manifest in its stored order */
+    for ( i = 0; i < manifest.num; i++ )
+        sums[i] = manifest.entries[i].checksum;
+    if ( readUint64Attr( groupID, CHECKSUM_ATTR, &fileChecksum, &numFileChecksum ) < 0 ||
+         xxh64Words( sums, manifest.num, 0 ) != fileChecksum[0] )
+        damaged( state, "/" CHECKSUM_GROUP, "has a file checksum that does not match the manifest" );
+
+    qsort( manifest.entries, manifest.num, sizeof(checksumEntry_t), compareEntries );
+    qsort( state->found.entries, state->found.num, sizeof(checksumEntry_t), compareEntries );
+    for ( i = 0, j = 0; i < manifest.num || j < state->found.num; )
+    {
+        int cmp = i == manifest.num ? 1 : j == state->found.num ? -1 :
+                  strcmp( manifest.entries[i].path, state->found.entries[j].path );
+
+        if ( cmp < 0 )
+            damaged( state, manifest.entries[i++].path, "is in the manifest but has no checksums" );
+        else if ( cmp > 0 )
+            damaged( state, state->found.entries[j++].path, "has checksums but is not in the manifest" );
+        else
+        {
+            if ( manifest.entries[i].checksum != state->found.entries[j].checksum ||
+                 manifest.entries[i].numBlocks != state->found.entries[j].numBlocks )
+                damaged( state, manifest.entries[i].path, "has a checksum that differs from the manifest" );
+            i++;
+            j++;
+        }
+    }
+
+done:
+    if ( manifest.entries && spaceID >= 0 )
+        H5Dvlen_reclaim( entryType, spaceID, H5P_DEFAULT, manifest.entries );
+    free(manifest.entries);
+    free(sums);
+    free(fileChecksum);
+    if ( entryType >= 0 ) H5Tclose(entryType);
+    if ( strType >= 0 ) H5Tclose(strType);
+    if ( spaceID >= 0 ) H5Sclose(spaceID);
+    if ( tableID >= 0 ) H5Dclose(tableID);
+    if ( groupID >= 0 ) H5Gclose(groupID);
+}
+
+/* Verify one file and print its report. Returns 0 if it is intact, 1 if damaged, 2 on errors. */
+static int verifyFile( const char* fileName, int quiet, FILE* out )
+{
+    verifyState_t state;
+    int ret = 0;
+
+    memset( &state, 0, sizeof state );
+    state.out = out;
+    state.fileName = fileName;
+    state.quiet = quiet;
+    state.fileID = H5Fopen( fileName, H5F_ACC_RDONLY, H5P_DEFAULT );
+    if ( state.fileID < 0 )
+    {
+        fprintf( out, "%s: cannot be opened\n", fileName );
+        fflush( out );
+        return 2;
+    }
+
+    verifyGroup( &state, "/" );
+    verifyManifest( &state );
+
+    if ( state.numErrors )
+        ret = 2;
+    else if ( state.numDamaged )
+        ret = 1;
+    else if ( state.numDatasets == 0 )
+    {
+        fprintf( out, "%s: has no checksums (written without BF_CHECKSUM=1?)\n", fileName );
+        ret = 2;
+    }
+
+    if ( !quiet || ret )
+        fprintf( out, "%s: %s, %lu datasets, %llu blocks, %.1f MiB verified\n", fileName,
+                 ret == 0 ? "OK" : ret == 1 ? "DAMAGED" : "NOT VERIFIED", state.numDatasets, state.numBlocks,
+                 state.numBytes / 1048576.0 );
+    fflush( out );
+
+    freeEntries( &state.found );
+    H5Fclose( state.fileID );
+    return ret;
+}
+
+int main( int argc, char* argv[] )
+{
+    int numProcs = 1;
+    int quiet = 0;
+    int ret = 0;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "j:q" ) ) != -1 )
+    {
+        if ( opt == 'j' )
+            numProcs = atoi( optarg );
+        else if ( opt == 'q' )
+            quiet = 1;
+        else
+            optind = argc + 1;
+    }
+    if ( optind >= argc )
+    {
+        fprintf( stderr, "Usage: %s [-j procs] [-q] file.h5 ...\n", argv[0] );
+        return 2;
+    }
+
+    /* Damage is reported by the library calls that fail, not by the library itself */
+    H5Eset_auto2( H5E_DEFAULT, NULL, NULL );
+
+    if ( numProcs <= 1 )
+    {
+        for ( int i = optind; i < argc; i++ )
+        {
+            int status = verifyFile( argv[i], quiet, stdout );
+            if ( status > ret ) ret = status;
+        }
+    }
+    else
+    {
+        /* Each file is verified in its own process with its own report. The reports are printed in the
+         * order of the files once their processes are done.
+         */
+        int numFiles = argc - optind;
+        FILE** reports = calloc( numFiles, sizeof(FILE*) );
+        pid_t* pids = calloc( numFiles, sizeof(pid_t) );
+        int next = 0;
+        int printed = 0;
+
+        if ( reports == NULL || pids == NULL )
+        {
+            fprintf( stderr, "Cannot allocate memory.\n" );
+            return 2;
+        }
+
+        while ( printed < numFiles )
+        {
+            if ( next < numFiles && next - printed < numProcs )
+            {
+                fflush( stdout );
+                reports[next] = tmpfile();
+                pids[next] = reports[next] ? fork() : -1;
+                if ( pids[next] == 0 )
+                    _exit( verifyFile( argv[optind + next], quiet, reports[next] ) );
+                if ( pids[next] < 0 )
+                {
+                    fprintf( stderr, "Cannot start the verification of %s.\n", argv[optind + next] );
+                    ret = 2;
+                }
+                next++;
+                continue;
+            }
+
+            if ( pids[printed] > 0 )
+            {
+                int wstatus = 0;
+                char buffer[65536];
+                size_t len;
+
+                if ( waitpid( pids[printed], &wstatus, 0 ) < 0 || !WIFEXITED(wstatus) )
+                    ret = 2;
+                else if ( WEXITSTATUS(wstatus) > ret )
+                    ret = WEXITSTATUS(wstatus);
+                rewind( reports[printed] );
+                while ( ( len = fread( buffer, 1, sizeof buffer, reports[printed] ) ) > 0 )
+                    fwrite( buffer, 1, len, stdout );
+            }
+            if ( reports[printed] ) fclose( reports[printed] );
+            printed++;
+        }
+
+        free(reports);
+        free(pids);
+    }
+
+    return ret;
+}
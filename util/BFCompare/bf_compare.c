@@ -0,0 +1,1047 @@
+/*
+ *  This program compares BF files object by object. It replaces dumping both files to CDL and
+ *  running diff on the text (util/verification_scripts/diff.py and cdl_line_diff.py).
+ *
+ *  Both group trees are walked by name, following external links, so master files of split or MPI
+ *  runs can be compared as well. Attributes must match exactly. Dimension scales are compared by
+ *  the names of the scales attached to each dimension. Datasets must have the same datatype and
+ *  shape, and their values are compared a block at a time (a chunk of the first file, or whole rows
+ *  of a contiguous dataset), so memory use stays bounded. The values of a block are compared on
+ *  OpenMP threads.
+ *
+ *  Two floating point values match if they are equal, both NaN, or within any of the given
+ *  tolerances. Integers match if they are equal or within the absolute or relative tolerance. Other
+ *  types must be equal byte for byte. Values equal to the _FillValue of a dataset are never matched
+ *  with a tolerance: a fill value on one side only is counted as a fill mismatch.
+ *
+ *  Usage: BFCompare [-a abs] [-r rel] [-u ulps] [-o report] a.h5 b.h5
+ *         BFCompare [-a abs] [-r rel] [-u ulps] [-o report] [-j procs] -l pairs.txt
+ *
+ *  pairs.txt lists one pair of files per line. With -j, that many pairs are compared at once, each
+ *  in its own process. The report has one JSON object per line: one per difference found and one
+ *  summary per pair. Returns 0 if all pairs match, 1 if any differ, 2 on errors.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "hdf5.h"
+#include "hdf5_hl.h"
+
+#define BLOCK_ELEMS ( 1 << 22 )     /* Elements per block of a contiguous dataset */
+#define MAX_PATH_LEN 4096
+
+typedef struct
+{
+    double absTol;
+    double relTol;
+    double ulpTol;
+} tolerance_t;
+
+typedef struct
+{
+    FILE* report;
+    int pair;
+    hid_t fileA;
+    hid_t fileB;
+    const tolerance_t* tol;
+    unsigned long numObjects;
+    unsigned long numAttrs;
+    unsigned long numDatasets;
+    unsigned long long numElements;
+    unsigned long numDifferences;
+    unsigned long numTolerated;     /* Datasets that differ within the tolerances only */
+    unsigned long numErrors;
+} compareState_t;
+
+/* The outcome of comparing the values of a dataset */
+typedef struct
+{
+    unsigned long long numDiffer;
+    unsigned long long numFill;
+    unsigned long long numTolerated;
+    unsigned long long firstIndex;
+    double maxAbs;
+    double maxRel;
+    double maxUlp;
+} valueStats_t;
+
+typedef struct
+{
+    char** names;
+    size_t num;
+    size_t size;
+} nameList_t;
+
+/* Report helpers */
+
+static void jsonString( FILE* out, const char* s )
+{
+    fputc( '"', out );
+    for ( ; *s; s++ )
+    {
+        if ( *s == '"' || *s == '\\' )
+            fprintf( out, "\\%c", *s );
+        else if ( (unsigned char) *s < 0x20 )
+            fprintf( out, "\\u%04x", (unsigned char) *s );
+        else
+            fputc( *s, out );
+    }
+    fputc( '"', out );
+}
+
+/* One difference. detailFmt, if not NULL, formats further members of the JSON object. */
+static void reportDiff( compareState_t* state, const char* path, const char* kind, const char* detailFmt, ... )
+{
+    fprintf( state->report, "{\"pair\":%d,\"object\":", state->pair );
+    jsonString( state->report, path );
+    fprintf( state->report, ",\"kind\":\"%s\"", kind );
+    if ( detailFmt )
+    {
+        va_list args;
+        fputc( ',', state->report );
+        va_start( args, detailFmt );
+        vfprintf( state->report, detailFmt, args );
+        va_end( args );
+    }
+    fprintf( state->report, "}\n" );
+
+    if ( strcmp( kind, "error" ) == 0 )
+        state->numErrors++;
+    else if ( strcmp( kind, "not_compared" ) != 0 )
+        state->numDifferences++;
+}
+
+static void reportAttrDiff( compareState_t* state, const char* path, const char* kind, const char* attrName )
+{
+    fprintf( state->report, "{\"pair\":%d,\"object\":", state->pair );
+    jsonString( state->report, path );
+    fprintf( state->report, ",\"kind\":\"%s\",\"attribute\":", kind );
+    jsonString( state->report, attrName );
+    fprintf( state->report, "}\n" );
+    state->numDifferences++;
+}
+
+/* Name lists */
+
+static herr_t addName( nameList_t* list, const char* name )
+{
+    if ( list->num == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 16;
+        char** temp = realloc( list->names, newSize * sizeof(char*) );
+        if ( temp == NULL )
+            return -1;
+        list->names = temp;
+        list->size = newSize;
+    }
+    list->names[list->num] = malloc( strlen(name) + 1 );
+    if ( list->names[list->num] == NULL )
+        return -1;
+    strcpy( list->names[list->num++], name );
+    return 0;
+}
+
+static void freeNames( nameList_t* list )
+{
+    for ( size_t i = 0; i < list->num; i++ )
+        free(list->names[i]);
+    free(list->names);
+    memset( list, 0, sizeof *list );
+}
+
+static int compareNames( const void* a, const void* b )
+{
+    return strcmp( *(char* const*) a, *(char* const*) b );
+}
+
+static herr_t collectLink( hid_t group, const char* name, const H5L_info_t* info, void* opdata )
+{
+    return addName( (nameList_t*) opdata, name );
+}
+
+static herr_t collectAttr( hid_t obj, const char* name, const H5A_info_t* info, void* opdata )
+{
+    return addName( (nameList_t*) opdata, name );
+}
+
+/* Call match for names in both lists and missing for names in one of them. Both lists must be sorted. */
+static void mergeNames( const nameList_t* a, const nameList_t* b, void (*match)( const char*, void* ),
+                        void (*missing)( const char*, int inA, void* ), void* data )
+{
+    size_t i = 0;
+    size_t j = 0;
+
+    while ( i < a->num || j < b->num )
+    {
+        int cmp = i == a->num ? 1 : j == b->num ? -1 : strcmp( a->names[i], b->names[j] );
+
+        if ( cmp == 0 )
+        {
+            match( a->names[i], data );
+            i++;
+            j++;
+        }
+        else if ( cmp < 0 )
+            missing( a->names[i++], 1, data );
+        else
+            missing( b->names[j++], 0, data );
+    }
+}
+
+/* Attributes */
+
+typedef struct
+{
+    compareState_t* state;
+    const char* path;
+    hid_t objA;
+    hid_t objB;
+} attrContext_t;
+
+/* Compare one attribute present on both objects. The attributes of dimension scales hold object
+ * references, which differ between files; they are compared by compareScales instead.
+ */
+static void compareAttr( const char* name, void* data )
+{
+    attrContext_t* ctx = data;
+    compareState_t* state = ctx->state;
+    hid_t attrA = -1;
+    hid_t attrB = -1;
+    hid_t typeA = -1;
+    hid_t typeB = -1;
+    hid_t memType = -1;
+    hid_t memTypeB = -1;
+    hid_t spaceA = -1;
+    hid_t spaceB = -1;
+    hssize_t numElems = 0;
+    size_t size = 0;
+    void* bufA = NULL;
+    void* bufB = NULL;
+
+    if ( strcmp( name, "DIMENSION_LIST" ) == 0 || strcmp( name, "REFERENCE_LIST" ) == 0 )
+        return;
+    state->numAttrs++;
+
+    attrA = H5Aopen( ctx->objA, name, H5P_DEFAULT );
+    attrB = H5Aopen( ctx->objB, name, H5P_DEFAULT );
+    typeA = attrA >= 0 ? H5Aget_type( attrA ) : -1;
+    typeB = attrB >= 0 ? H5Aget_type( attrB ) : -1;
+    spaceA = attrA >= 0 ? H5Aget_space( attrA ) : -1;
+    spaceB = attrB >= 0 ? H5Aget_space( attrB ) : -1;
+    memType = typeA >= 0 ? H5Tget_native_type( typeA, H5T_DIR_ASCEND ) : -1;
+    memTypeB = typeB >= 0 ? H5Tget_native_type( typeB, H5T_DIR_ASCEND ) : -1;
+    if ( memType < 0 || memTypeB < 0 || spaceA < 0 || spaceB < 0 )
+    {
+        reportDiff( state, ctx->path, "error", "\"message\":\"cannot open attribute %s\"", name );
+        goto done;
+    }
+
+    if ( H5Tdetect_class( typeA, H5T_REFERENCE ) > 0 )
+        goto done;
+    if ( H5Tget_class( memType ) == H5T_STRING && H5Tget_class( memTypeB ) == H5T_STRING &&
+         H5Tis_variable_str( memType ) <= 0 && H5Tis_variable_str( memTypeB ) <= 0 &&
+         H5Sget_simple_extent_npoints( spaceA ) == 1 && H5Sget_simple_extent_npoints( spaceB ) == 1 )
+    {
+        /* Fixed length strings are compared as text: a longer value is not a different type */
+        size_t sizeA = H5Tget_size( memType );
+        size_t sizeB = H5Tget_size( memTypeB );
+
+        bufA = calloc( 1, sizeA + 1 );
+        bufB = calloc( 1, sizeB + 1 );
+        if ( bufA == NULL || bufB == NULL || H5Aread( attrA, memType, bufA ) < 0 || H5Aread( attrB, memTypeB, bufB ) < 0 )
+            reportDiff( state, ctx->path, "error", "\"message\":\"cannot read attribute %s\"", name );
+        else if ( strcmp( bufA, bufB ) != 0 )
+            reportAttrDiff( state, ctx->path, "attribute_value", name );
+        goto done;
+    }
+    if ( H5Tequal( memType, memTypeB ) <= 0 )
+    {
+        reportAttrDiff( state, ctx->path, "attribute_datatype", name );
+        goto done;
+    }
+    numElems = H5Sget_simple_extent_npoints( spaceA );
+    if ( numElems != H5Sget_simple_extent_npoints( spaceB ) ||
+         H5Sget_simple_extent_ndims( spaceA ) != H5Sget_simple_extent_ndims( spaceB ) )
+    {
+        reportAttrDiff( state, ctx->path, "attribute_shape", name );
+        goto done;
+    }
+
+    size = H5Tget_size( memType );
+    bufA = calloc( numElems ? numElems : 1, size );
+    bufB = calloc( numElems ? numElems : 1, size );
+    if ( bufA == NULL || bufB == NULL || H5Aread( attrA, memType, bufA ) < 0 || H5Aread( attrB, memType, bufB ) < 0 )
+    {
+        reportDiff( state, ctx->path, "error", "\"message\":\"cannot read attribute %s\"", name );
+        goto done;
+    }
+
+    if ( H5Tis_variable_str( memType ) > 0 )
+    {
+        char** strA = bufA;
+        char** strB = bufB;
+        int differ = 0;
+
+        for ( hssize_t i = 0; i < numElems && !differ; i++ )
+            differ = ( strA[i] == NULL || strB[i] == NULL ) ? strA[i] != strB[i] : strcmp( strA[i], strB[i] ) != 0;
+        if ( differ )
+            reportAttrDiff( state, ctx->path, "attribute_value", name );
+        H5Dvlen_reclaim( memType, spaceA, H5P_DEFAULT, bufA );
+        H5Dvlen_reclaim( memType, spaceB, H5P_DEFAULT, bufB );
+    }
+    else if ( H5Tdetect_class( memType, H5T_VLEN ) > 0 )
+    {
+        H5Dvlen_reclaim( memType, spaceA, H5P_DEFAULT, bufA );
+        H5Dvlen_reclaim( memType, spaceB, H5P_DEFAULT, bufB );
+        reportDiff( state, ctx->path, "not_compared", "\"attribute\":\"%s\"", name );
+    }
+    else if ( memcmp( bufA, bufB, numElems * size ) != 0 )
+        reportAttrDiff( state, ctx->path, "attribute_value", name );
+
+done:
+    free(bufA);
+    free(bufB);
+    if ( memType >= 0 ) H5Tclose(memType);
+    if ( memTypeB >= 0 ) H5Tclose(memTypeB);
+    if ( typeA >= 0 ) H5Tclose(typeA);
+    if ( typeB >= 0 ) H5Tclose(typeB);
+    if ( spaceA >= 0 ) H5Sclose(spaceA);
+    if ( spaceB >= 0 ) H5Sclose(spaceB);
+    if ( attrA >= 0 ) H5Aclose(attrA);
+    if ( attrB >= 0 ) H5Aclose(attrB);
+}
+
+static void missingAttr( const char* name, int inA, void* data )
+{
+    attrContext_t* ctx = data;
+
+    if ( strcmp( name, "DIMENSION_LIST" ) == 0 || strcmp( name, "REFERENCE_LIST" ) == 0 )
+        return;
+    ctx->state->numAttrs++;
+    reportAttrDiff( ctx->state, ctx->path, inA ? "attribute_missing_in_b" : "attribute_missing_in_a", name );
+}
+
+static void compareAttrs( compareState_t* state, const char* path, hid_t objA, hid_t objB )
+{
+    nameList_t namesA = { 0 };
+    nameList_t namesB = { 0 };
+    attrContext_t ctx = { state, path, objA, objB };
+
+    if ( H5Aiterate2( objA, H5_INDEX_NAME, H5_ITER_INC, NULL, collectAttr, &namesA ) < 0 ||
+         H5Aiterate2( objB, H5_INDEX_NAME, H5_ITER_INC, NULL, collectAttr, &namesB ) < 0 )
+        reportDiff( state, path, "error", "\"message\":\"cannot list the attributes\"" );
+    else
+    {
+        qsort( namesA.names, namesA.num, sizeof(char*), compareNames );
+        qsort( namesB.names, namesB.num, sizeof(char*), compareNames );
+        mergeNames( &namesA, &namesB, compareAttr, missingAttr, &ctx );
+    }
+
+    freeNames( &namesA );
+    freeNames( &namesB );
+}
+
+/* Dimension scales */
+
+static herr_t appendScaleName( hid_t did, unsigned dim, hid_t dsid, void* opdata )
+{
+    char name[MAX_PATH_LEN] = "";
+    char* list = opdata;
+
+    H5Iget_name( dsid, name, sizeof name );
+    if ( strlen(list) + strlen(name) + 2 < MAX_PATH_LEN )
+    {
+        strcat( list, name );
+        strcat( list, ";" );
+    }
+    return 0;
+}
+
+/* The names of the scales attached to each dimension, as "dim0scale;|dim1scale;|..." */
+static void getScaleNames( hid_t dset, int rank, char* list )
+{
+    list[0] = '\0';
+    for ( int dim = 0; dim < rank; dim++ )
+    {
+        if ( H5DSget_num_scales( dset, dim ) > 0 )
+            H5DSiterate_scales( dset, dim, NULL, appendScaleName, list );
+        if ( strlen(list) + 2 < MAX_PATH_LEN )
+            strcat( list, "|" );
+    }
+}
+
+static void compareScales( compareState_t* state, const char* path, hid_t dsetA, hid_t dsetB, int rank )
+{
+    static char scalesA[MAX_PATH_LEN];
+    static char scalesB[MAX_PATH_LEN];
+
+    getScaleNames( dsetA, rank, scalesA );
+    getScaleNames( dsetB, rank, scalesB );
+    if ( strcmp( scalesA, scalesB ) != 0 )
+        reportDiff( state, path, "dimension_scales", NULL );
+}
+
+/* Values */
+
+/* The distance between two floats in units in the last place */
+static double floatUlps( float a, float b )
+{
+    int32_t ia;
+    int32_t ib;
+
+    memcpy( &ia, &a, sizeof ia );
+    memcpy( &ib, &b, sizeof ib );
+    if ( ia < 0 ) ia = INT32_MIN - ia;
+    if ( ib < 0 ) ib = INT32_MIN - ib;
+    return fabs( (double) ia - (double) ib );
+}
+
+static double doubleUlps( double a, double b )
+{
+    int64_t ia;
+    int64_t ib;
+
+    memcpy( &ia, &a, sizeof ia );
+    memcpy( &ib, &b, sizeof ib );
+    if ( ia < 0 ) ia = INT64_MIN - ia;
+    if ( ib < 0 ) ib = INT64_MIN - ib;
+    return ia > ib ? (double) ( (uint64_t) ia - (uint64_t) ib ) : (double) ( (uint64_t) ib - (uint64_t) ia );
+}
+
+/* Whether two unequal finite values are within a tolerance. ulps < 0 for integers. */
+static int withinTolerance( const tolerance_t* tol, double diff, double magnitude, double ulps )
+{
+    return ( tol->absTol > 0 && diff <= tol->absTol ) || ( tol->relTol > 0 && diff <= tol->relTol * magnitude ) ||
+           ( tol->ulpTol > 0 && ulps >= 0 && ulps <= tol->ulpTol );
+}
+
+#ifdef _OPENMP
+#    define OMP_COMPARE_LOOP _Pragma("omp parallel for reduction(+:numDiffer,numFill,numTolerated) reduction(max:maxAbs,maxRel,maxUlp) reduction(min:first)")
+#else
+#    define OMP_COMPARE_LOOP
+#endif
+
+/* The body of the comparison loops. VALUE is the element type, ULPS the ulp function or nothing. */
+#define COMPARE_VALUES( VALUE, IS_FLOAT, ULPS )                                                          \
+    {                                                                                                    \
+        const VALUE* a = bufA;                                                                           \
+        const VALUE* b = bufB;                                                                           \
+        const VALUE fillValue = hasFill ? *(const VALUE*) fill : 0;                                      \
+        long first = LONG_MAX;                                                                           \
+        unsigned long long numDiffer = 0, numFill = 0, numTolerated = 0;                                 \
+        double maxAbs = stats->maxAbs, maxRel = stats->maxRel, maxUlp = stats->maxUlp;                   \
+        OMP_COMPARE_LOOP                                                                                 \
+        for ( long i = 0; i < (long) numElems; i++ )                                                     \
+        {                                                                                                \
+            int fillA = hasFill && a[i] == fillValue;                                                    \
+            int fillB = hasFill && b[i] == fillValue;                                                    \
+            double diff, magnitude, ulps;                                                                \
+                                                                                                         \
+            if ( a[i] == b[i] || ( IS_FLOAT && a[i] != a[i] && b[i] != b[i] ) )                          \
+                continue;                                                                                \
+            if ( fillA || fillB )                                                                        \
+            {                                                                                            \
+                numFill++;                                                                               \
+                numDiffer++;                                                                             \
+                if ( i < first ) first = i;                                                              \
+                continue;                                                                                \
+            }                                                                                            \
+            diff = fabs( (double) a[i] - (double) b[i] );                                                \
+            magnitude = fmax( fabs( (double) a[i] ), fabs( (double) b[i] ) );                            \
+            ulps = ULPS;                                                                                 \
+            if ( diff == diff && diff != HUGE_VAL )                                                      \
+            {                                                                                            \
+                if ( diff > maxAbs ) maxAbs = diff;                                                      \
+                if ( magnitude > 0 && diff / magnitude > maxRel ) maxRel = diff / magnitude;             \
+                if ( ulps > maxUlp ) maxUlp = ulps;                                                      \
+                if ( withinTolerance( tol, diff, magnitude, ulps ) )                                     \
+                {                                                                                        \
+                    numTolerated++;                                                                      \
+                    continue;                                                                            \
+                }                                                                                        \
+            }                                                                                            \
+            numDiffer++;                                                                                 \
+            if ( i < first ) first = i;                                                                  \
+        }                                                                                                \
+        stats->numDiffer += numDiffer;                                                                   \
+        stats->numFill += numFill;                                                                       \
+        stats->numTolerated += numTolerated;                                                             \
+        stats->maxAbs = maxAbs;                                                                          \
+        stats->maxRel = maxRel;                                                                          \
+        stats->maxUlp = maxUlp;                                                                          \
+        *firstLocal = first;                                                                             \
+    }
+
+enum { VALUES_FLOAT, VALUES_DOUBLE, VALUES_INT, VALUES_UINT, VALUES_VLSTRING, VALUES_BYTES };
+
+/* Compare a block of values. firstLocal receives the index of the first differing value in the block,
+ * or LONG_MAX.
+ */
+static void compareBlock( int kind, const void* bufA, const void* bufB, size_t numElems, size_t elemSize,
+                          int hasFill, const void* fill, const tolerance_t* tol, valueStats_t* stats, long* firstLocal )
+{
+    *firstLocal = LONG_MAX;
+
+    switch ( kind )
+    {
+        case VALUES_FLOAT:
+            COMPARE_VALUES( float, 1, floatUlps( a[i], b[i] ) )
+            break;
+        case VALUES_DOUBLE:
+            COMPARE_VALUES( double, 1, doubleUlps( a[i], b[i] ) )
+            break;
+        case VALUES_INT:
+            COMPARE_VALUES( long long, 0, -1.0 )
+            break;
+        case VALUES_UINT:
+            COMPARE_VALUES( unsigned long long, 0, -1.0 )
+            break;
+        case VALUES_VLSTRING:
+            for ( size_t i = 0; i < numElems; i++ )
+            {
+                const char* a = ((char* const*) bufA)[i];
+                const char* b = ((char* const*) bufB)[i];
+                if ( ( a == NULL || b == NULL ) ? a != b : strcmp( a, b ) != 0 )
+                {
+                    stats->numDiffer++;
+                    if ( (long) i < *firstLocal ) *firstLocal = (long) i;
+                }
+            }
+            break;
+        default:
+            for ( size_t i = 0; i < numElems; i++ )
+                if ( memcmp( (const char*) bufA + i * elemSize, (const char*) bufB + i * elemSize, elemSize ) != 0 )
+                {
+                    stats->numDiffer++;
+                    if ( (long) i < *firstLocal ) *firstLocal = (long) i;
+                }
+            break;
+    }
+}
+
+/* The memory type values of a dataset are read in, and how they are compared */
+static hid_t getValueType( hid_t fileType, int* kind )
+{
+    H5T_class_t typeClass = H5Tget_class( fileType );
+
+    if ( typeClass == H5T_FLOAT )
+    {
+        *kind = H5Tget_size( fileType ) <= 4 ? VALUES_FLOAT : VALUES_DOUBLE;
+        return H5Tcopy( *kind == VALUES_FLOAT ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE );
+    }
+    if ( typeClass == H5T_INTEGER )
+    {
+        *kind = H5Tget_sign( fileType ) == H5T_SGN_NONE ? VALUES_UINT : VALUES_INT;
+        return H5Tcopy( *kind == VALUES_UINT ? H5T_NATIVE_ULLONG : H5T_NATIVE_LLONG );
+    }
+    *kind = H5Tis_variable_str( fileType ) > 0 ? VALUES_VLSTRING : VALUES_BYTES;
+    return H5Tget_native_type( fileType, H5T_DIR_ASCEND );
+}
+
+/* Datasets */
+
+static void compareData( compareState_t* state, const char* path, hid_t dsetA, hid_t dsetB, hid_t fileType,
+                         int rank, const hsize_t* dims )
+{
+    hid_t memType = -1;
+    hid_t spaceA = -1;
+    hid_t spaceB = -1;
+    hid_t memSpace = -1;
+    hid_t dcpl = -1;
+    hsize_t block[H5S_MAX_RANK];
+    hsize_t index[H5S_MAX_RANK] = { 0 };
+    hsize_t numElems = 1;
+    size_t blockElems = 1;
+    size_t elemSize = 0;
+    void* bufA = NULL;
+    void* bufB = NULL;
+    void* fill = NULL;
+    int hasFill = 0;
+    int kind = 0;
+    int done = 0;
+    int haveFirst = 0;
+    valueStats_t stats;
+
+    memset( &stats, 0, sizeof stats );
+    for ( int i = 0; i < rank; i++ )
+        numElems *= dims[i];
+    if ( numElems == 0 )
+        return;
+
+    memType = getValueType( fileType, &kind );
+    if ( memType < 0 || H5Tdetect_class( memType, H5T_REFERENCE ) > 0 ||
+         ( kind == VALUES_BYTES && H5Tdetect_class( memType, H5T_VLEN ) > 0 ) )
+    {
+        reportDiff( state, path, "not_compared", NULL );
+        goto done;
+    }
+    elemSize = H5Tget_size( memType );
+
+    /* Blocks are the chunks of the first file, or whole rows of a contiguous dataset */
+    dcpl = H5Dget_create_plist( dsetA );
+    if ( rank > 0 && ( H5Pget_layout( dcpl ) != H5D_CHUNKED || H5Pget_chunk( dcpl, rank, block ) != rank ) )
+    {
+        hsize_t rowElems = 1;
+        for ( int i = 1; i < rank; i++ )
+        {
+            block[i] = dims[i];
+            rowElems *= dims[i];
+        }
+        block[0] = rowElems >= BLOCK_ELEMS ? 1 : BLOCK_ELEMS / rowElems;
+    }
+    for ( int i = 0; i < rank; i++ )
+    {
+        if ( block[i] > dims[i] ) block[i] = dims[i];
+        blockElems *= block[i];
+    }
+
+    /* Fill values are compared without tolerance */
+    if ( H5Aexists( dsetA, "_FillValue" ) > 0 && kind != VALUES_VLSTRING )
+    {
+        hid_t attr = H5Aopen( dsetA, "_FillValue", H5P_DEFAULT );
+        hid_t attrSpace = attr >= 0 ? H5Aget_space( attr ) : -1;
+
+        fill = calloc( 1, elemSize );
+        hasFill = fill && attrSpace >= 0 && H5Sget_simple_extent_npoints( attrSpace ) == 1 &&
+                  H5Aread( attr, memType, fill ) >= 0;
+        if ( attrSpace >= 0 ) H5Sclose(attrSpace);
+        if ( attr >= 0 ) H5Aclose(attr);
+    }
+
+    bufA = calloc( blockElems, elemSize );
+    bufB = calloc( blockElems, elemSize );
+    spaceA = H5Dget_space( dsetA );
+    spaceB = H5Dget_space( dsetB );
+    if ( bufA == NULL || bufB == NULL || spaceA < 0 || spaceB < 0 )
+    {
+        reportDiff( state, path, "error", "\"message\":\"cannot allocate %zu bytes\"", 2 * blockElems * elemSize );
+        goto done;
+    }
+
+    while ( !done )
+    {
+        hsize_t start[H5S_MAX_RANK];
+        hsize_t count[H5S_MAX_RANK];
+        hsize_t readElems = 1;
+        long firstLocal = LONG_MAX;
+
+        for ( int i = 0; i < rank; i++ )
+        {
+            start[i] = index[i] * block[i];
+            count[i] = dims[i] - start[i] < block[i] ? dims[i] - start[i] : block[i];
+            readElems *= count[i];
+        }
+
+        memSpace = H5Screate_simple( 1, &readElems, NULL );
+        if ( memSpace < 0 ||
+             ( rank > 0 && ( H5Sselect_hyperslab( spaceA, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ||
+                             H5Sselect_hyperslab( spaceB, H5S_SELECT_SET, start, NULL, count, NULL ) < 0 ) ) ||
+             H5Dread( dsetA, memType, memSpace, spaceA, H5P_DEFAULT, bufA ) < 0 ||
+             H5Dread( dsetB, memType, memSpace, spaceB, H5P_DEFAULT, bufB ) < 0 )
+        {
+            reportDiff( state, path, "error", "\"message\":\"cannot read the values\"" );
+            goto done;
+        }
+
+        compareBlock( kind, bufA, bufB, readElems, elemSize, hasFill, fill, state->tol, &stats, &firstLocal );
+        if ( kind == VALUES_VLSTRING )
+        {
+            H5Dvlen_reclaim( memType, memSpace, H5P_DEFAULT, bufA );
+            H5Dvlen_reclaim( memType, memSpace, H5P_DEFAULT, bufB );
+        }
+        H5Sclose(memSpace);
+        memSpace = -1;
+
+        /* The index of the first differing value in the whole dataset */
+        if ( firstLocal != LONG_MAX )
+        {
+            hsize_t rest = (hsize_t) firstLocal;
+            hsize_t global = 0;
+
+            for ( int i = 0; i < rank; i++ )
+            {
+                hsize_t inner = 1;
+                for ( int j = i + 1; j < rank; j++ )
+                    inner *= count[j];
+                global = global * dims[i] + start[i] + rest / inner;
+                rest %= inner;
+            }
+            if ( !haveFirst || global < stats.firstIndex )
+                stats.firstIndex = global;
+            haveFirst = 1;
+        }
+
+        /* The next block */
+        done = 1;
+        for ( int i = rank - 1; i >= 0; i-- )
+        {
+            if ( ( index[i] + 1 ) * block[i] < dims[i] )
+            {
+                index[i]++;
+                done = 0;
+                break;
+            }
+            index[i] = 0;
+        }
+    }
+
+    state->numElements += numElems;
+    if ( stats.numDiffer )
+        reportDiff( state, path, "data",
+                    "\"elements\":%llu,\"differing\":%llu,\"fill_mismatches\":%llu,\"within_tolerance\":%llu,"
+                    "\"max_abs_diff\":%.9g,\"max_rel_diff\":%.9g,\"max_ulp_diff\":%.0f,\"first_index\":%llu",
+                    (unsigned long long) numElems, stats.numDiffer, stats.numFill, stats.numTolerated, stats.maxAbs,
+                    stats.maxRel, stats.maxUlp, stats.firstIndex );
+    else if ( stats.numTolerated )
+        state->numTolerated++;
+
+done:
+    free(bufA);
+    free(bufB);
+    free(fill);
+    if ( memSpace >= 0 ) H5Sclose(memSpace);
+    if ( spaceA >= 0 ) H5Sclose(spaceA);
+    if ( spaceB >= 0 ) H5Sclose(spaceB);
+    if ( dcpl >= 0 ) H5Pclose(dcpl);
+    if ( memType >= 0 ) H5Tclose(memType);
+}
+
+static void compareDataset( compareState_t* state, const char* path )
+{
+    hid_t dsetA = H5Dopen2( state->fileA, path, H5P_DEFAULT );
+    hid_t dsetB = H5Dopen2( state->fileB, path, H5P_DEFAULT );
+    hid_t typeA = -1;
+    hid_t typeB = -1;
+    hid_t spaceA = -1;
+    hid_t spaceB = -1;
+    hsize_t dimsA[H5S_MAX_RANK];
+    hsize_t dimsB[H5S_MAX_RANK];
+    int rank = 0;
+
+    state->numDatasets++;
+    if ( dsetA < 0 || dsetB < 0 )
+    {
+        reportDiff( state, path, "error", "\"message\":\"cannot open the dataset\"" );
+        goto done;
+    }
+    compareAttrs( state, path, dsetA, dsetB );
+
+    typeA = H5Dget_type( dsetA );
+    typeB = H5Dget_type( dsetB );
+    if ( H5Tequal( typeA, typeB ) <= 0 )
+    {
+        reportDiff( state, path, "datatype", NULL );
+        goto done;
+    }
+
+    spaceA = H5Dget_space( dsetA );
+    spaceB = H5Dget_space( dsetB );
+    rank = H5Sget_simple_extent_ndims( spaceA );
+    if ( rank < 0 || rank != H5Sget_simple_extent_ndims( spaceB ) ||
+         H5Sget_simple_extent_dims( spaceA, dimsA, NULL ) < 0 || H5Sget_simple_extent_dims( spaceB, dimsB, NULL ) < 0 ||
+         memcmp( dimsA, dimsB, rank * sizeof(hsize_t) ) != 0 )
+    {
+        reportDiff( state, path, "shape", NULL );
+        goto done;
+    }
+
+    compareScales( state, path, dsetA, dsetB, rank );
+    compareData( state, path, dsetA, dsetB, typeA, rank, dimsA );
+
+done:
+    if ( spaceA >= 0 ) H5Sclose(spaceA);
+    if ( spaceB >= 0 ) H5Sclose(spaceB);
+    if ( typeA >= 0 ) H5Tclose(typeA);
+    if ( typeB >= 0 ) H5Tclose(typeB);
+    if ( dsetA >= 0 ) H5Dclose(dsetA);
+    if ( dsetB >= 0 ) H5Dclose(dsetB);
+}
+
+/* Groups */
+
+typedef struct
+{
+    compareState_t* state;
+    const char* parent;
+} groupContext_t;
+
+static void compareObject( compareState_t* state, const char* path );
+
+static void childPath( const char* parent, const char* name, char* path )
+{
+    snprintf( path, MAX_PATH_LEN, "%s/%s", strcmp( parent, "/" ) == 0 ? "" : parent, name );
+}
+
+static void compareChild( const char* name, void* data )
+{
+    groupContext_t* ctx = data;
+    char* path = malloc( MAX_PATH_LEN );
+
+    if ( path == NULL )
+    {
+        reportDiff( ctx->state, ctx->parent, "error", "\"message\":\"cannot allocate memory\"" );
+        return;
+    }
+    childPath( ctx->parent, name, path );
+    compareObject( ctx->state, path );
+    free(path);
+}
+
+static void missingChild( const char* name, int inA, void* data )
+{
+    groupContext_t* ctx = data;
+    char path[MAX_PATH_LEN];
+
+    childPath( ctx->parent, name, path );
+    ctx->state->numObjects++;
+    reportDiff( ctx->state, path, inA ? "missing_in_b" : "missing_in_a", NULL );
+}
+
+static void compareGroup( compareState_t* state, const char* path )
+{
+    hid_t groupA = H5Gopen2( state->fileA, path, H5P_DEFAULT );
+    hid_t groupB = H5Gopen2( state->fileB, path, H5P_DEFAULT );
+    nameList_t namesA = { 0 };
+    nameList_t namesB = { 0 };
+    groupContext_t ctx = { state, path };
+
+    if ( groupA < 0 || groupB < 0 )
+        reportDiff( state, path, "error", "\"message\":\"cannot open the group\"" );
+    else if ( H5Literate( groupA, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLink, &namesA ) < 0 ||
+              H5Literate( groupB, H5_INDEX_NAME, H5_ITER_INC, NULL, collectLink, &namesB ) < 0 )
+        reportDiff( state, path, "error", "\"message\":\"cannot list the group\"" );
+    else
+    {
+        compareAttrs( state, path, groupA, groupB );
+        qsort( namesA.names, namesA.num, sizeof(char*), compareNames );
+        qsort( namesB.names, namesB.num, sizeof(char*), compareNames );
+        mergeNames( &namesA, &namesB, compareChild, missingChild, &ctx );
+    }
+
+    freeNames( &namesA );
+    freeNames( &namesB );
+    if ( groupA >= 0 ) H5Gclose(groupA);
+    if ( groupB >= 0 ) H5Gclose(groupB);
+}
+
+static void compareObject( compareState_t* state, const char* path )
+{
+    H5O_info_t infoA;
+    H5O_info_t infoB;
+
+    state->numObjects++;
+    if ( H5Oget_info_by_name( state->fileA, path, &infoA, H5P_DEFAULT ) < 0 ||
+         H5Oget_info_by_name( state->fileB, path, &infoB, H5P_DEFAULT ) < 0 )
+    {
+        reportDiff( state, path, "error", "\"message\":\"cannot open the object (dangling link?)\"" );
+        return;
+    }
+    if ( infoA.type != infoB.type )
+        reportDiff( state, path, "object_type", NULL );
+    else if ( infoA.type == H5O_TYPE_GROUP )
+        compareGroup( state, path );
+    else if ( infoA.type == H5O_TYPE_DATASET )
+        compareDataset( state, path );
+}
+
+/* Compare one pair of files and write its report. Returns 0 if they match, 1 if they differ, 2 on errors. */
+static int compareFiles( const char* nameA, const char* nameB, int pair, const tolerance_t* tol, FILE* report )
+{
+    compareState_t state;
+    const char* status = "identical";
+    int ret = 0;
+
+    memset( &state, 0, sizeof state );
+    state.report = report;
+    state.pair = pair;
+    state.tol = tol;
+    state.fileA = H5Fopen( nameA, H5F_ACC_RDONLY, H5P_DEFAULT );
+    state.fileB = H5Fopen( nameB, H5F_ACC_RDONLY, H5P_DEFAULT );
+
+    if ( state.fileA < 0 || state.fileB < 0 )
+        reportDiff( &state, state.fileA < 0 ? nameA : nameB, "error", "\"message\":\"cannot open the file\"" );
+    else
+        compareGroup( &state, "/" );
+
+    if ( state.numErrors )
+    {
+        status = "error";
+        ret = 2;
+    }
+    else if ( state.numDifferences )
+    {
+        status = "different";
+        ret = 1;
+    }
+    else if ( state.numTolerated )
+        status = "within_tolerance";
+
+    fprintf( report, "{\"pair\":%d,\"summary\":true,\"file_a\":", pair );
+    jsonString( report, nameA );
+    fprintf( report, ",\"file_b\":" );
+    jsonString( report, nameB );
+    fprintf( report, ",\"status\":\"%s\",\"objects\":%lu,\"attributes\":%lu,\"datasets\":%lu,\"elements\":%llu,"
+             "\"differences\":%lu,\"errors\":%lu}\n", status, state.numObjects, state.numAttrs, state.numDatasets,
+             state.numElements, state.numDifferences, state.numErrors );
+    fflush( report );
+
+    if ( state.fileA >= 0 ) H5Fclose(state.fileA);
+    if ( state.fileB >= 0 ) H5Fclose(state.fileB);
+    return ret;
+}
+
+/* Read the pairs of a list file. Lines starting with # are skipped. */
+static int readPairs( const char* listName, nameList_t* names )
+{
+    FILE* list = fopen( listName, "r" );
+    char line[2 * MAX_PATH_LEN];
+
+    if ( list == NULL )
+    {
+        fprintf( stderr, "Cannot open %s\n", listName );
+        return -1;
+    }
+    while ( fgets( line, sizeof line, list ) )
+    {
+        char a[MAX_PATH_LEN];
+        char b[MAX_PATH_LEN];
+
+        if ( line[0] == '#' || sscanf( line, "%4095s %4095s", a, b ) != 2 )
+            continue;
+        if ( addName( names, a ) < 0 || addName( names, b ) < 0 )
+        {
+            fclose(list);
+            return -1;
+        }
+    }
+    fclose(list);
+    return 0;
+}
+
+int main( int argc, char* argv[] )
+{
+    tolerance_t tol = { 0.0, 0.0, 0.0 };
+    nameList_t files = { 0 };
+    FILE* report = stdout;
+    const char* listName = NULL;
+    int numProcs = 1;
+    int numPairs = 0;
+    int ret = 0;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "a:r:u:j:l:o:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'a': tol.absTol = strtod( optarg, NULL ); break;
+            case 'r': tol.relTol = strtod( optarg, NULL ); break;
+            case 'u': tol.ulpTol = strtod( optarg, NULL ); break;
+            case 'j': numProcs = atoi( optarg ); break;
+            case 'l': listName = optarg; break;
+            case 'o':
+                report = fopen( optarg, "w" );
+                if ( report == NULL )
+                {
+                    fprintf( stderr, "Cannot open %s\n", optarg );
+                    return 2;
+                }
+                break;
+            default:
+                fprintf( stderr, "Usage: %s [-a abs] [-r rel] [-u ulps] [-o report] a.h5 b.h5\n"
+                                 "       %s [-a abs] [-r rel] [-u ulps] [-o report] [-j procs] -l pairs.txt\n",
+                         argv[0], argv[0] );
+                return 2;
+        }
+    }
+
+    if ( listName ? readPairs( listName, &files ) < 0 : argc - optind != 2 ||
+                    addName( &files, argv[optind] ) < 0 || addName( &files, argv[optind + 1] ) < 0 )
+    {
+        fprintf( stderr, "Usage: %s [-a abs] [-r rel] [-u ulps] [-o report] a.h5 b.h5\n"
+                         "       %s [-a abs] [-r rel] [-u ulps] [-o report] [-j procs] -l pairs.txt\n", argv[0], argv[0] );
+        return 2;
+    }
+    numPairs = (int) ( files.num / 2 );
+    if ( numProcs < 1 ) numProcs = 1;
+
+    /* Differences are reported by the library calls that fail, not by the library itself */
+    H5Eset_auto2( H5E_DEFAULT, NULL, NULL );
+
+    if ( numProcs == 1 )
+    {
+        for ( int i = 0; i < numPairs; i++ )
+        {
+            int status = compareFiles( files.names[2 * i], files.names[2 * i + 1], i, &tol, report );
+            if ( status > ret ) ret = status;
+        }
+    }
+    else
+    {
+        /* Each pair is compared in its own process with its own report. The reports are copied to the
+         * output in the order of the pairs once their processes are done.
+         */
+        FILE** reports = calloc( numPairs, sizeof(FILE*) );
+        pid_t* pids = calloc( numPairs, sizeof(pid_t) );
+        int next = 0;
+        int copied = 0;
+
+        if ( reports == NULL || pids == NULL )
+        {
+            fprintf( stderr, "Cannot allocate memory.\n" );
+            return 2;
+        }
+
+        while ( copied < numPairs )
+        {
+            if ( next < numPairs && next - copied < numProcs )
+            {
+                fflush( report );
+                reports[next] = tmpfile();
+                pids[next] = reports[next] ? fork() : -1;
+                if ( pids[next] == 0 )
+                    _exit( compareFiles( files.names[2 * next], files.names[2 * next + 1], next, &tol, reports[next] ) );
+                if ( pids[next] < 0 )
+                {
+                    fprintf( stderr, "Cannot start the comparison of pair %d.\n", next );
+                    ret = 2;
+                }
+                next++;
+                continue;
+            }
+
+            if ( pids[copied] > 0 )
+            {
+                int wstatus = 0;
+                char buffer[65536];
+                size_t len;
+
+                if ( waitpid( pids[copied], &wstatus, 0 ) < 0 || !WIFEXITED(wstatus) )
+                    ret = 2;
+                else if ( WEXITSTATUS(wstatus) > ret )
+                    ret = WEXITSTATUS(wstatus);
+                rewind( reports[copied] );
+                while ( ( len = fread( buffer, 1, sizeof buffer, reports[copied] ) ) > 0 )
+                    fwrite( buffer, 1, len, report );
+            }
+            if ( reports[copied] ) fclose( reports[copied] );
+            copied++;
+        }
+
+        free(reports);
+        free(pids);
+    }
+
+    if ( report != stdout )
+        fclose(report);
+    freeNames( &files );
+    return ret;
+}
@@ -0,0 +1,40 @@
+/*
+ *  Shared checks of the BFTests programs. Each program exercises one feature of the converter through
+ *  the functions of libTERRA.h, reads back what it wrote and exits with 1 if any check failed.
+ */
+
+#ifndef BF_TEST_H
+#define BF_TEST_H
+
+#include <stdio.h>
+
+static int bfTestFailures = 0;
+
+/* Count and report a failed condition, and go on with the next check */
+#define CHECK(cond) \
+    do { \
+        if ( !(cond) ) \
+        { \
+            fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond ); \
+            bfTestFailures++; \
+        } \
+    } while ( 0 )
+
+/* Stop the program when a step the later checks depend on failed */
+#define REQUIRE(cond) \
+    do { \
+        if ( !(cond) ) \
+        { \
+            fprintf( stderr, "%s:%d: required step failed: %s\n", __FILE__, __LINE__, #cond ); \
+            return 1; \
+        } \
+    } while ( 0 )
+
+/* The exit status of main */
+static int bfTestResult( const char* name )
+{
+    printf( "%s: %s\n", name, bfTestFailures ? "FAILED" : "passed" );
+    return bfTestFailures != 0;
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ *  Bit-rounding of unpacked radiances (BF_KEEP_BITS). bitRoundFloat must keep every value within
+ *  2^-(keepBits+1) of its magnitude, zero the dropped mantissa bits, round ties to even and leave fill
+ *  values, infinities and NaNs alone. The rules of BF_KEEP_BITS must pick the bits by dataset name.
+ *
+ *  The program also writes bf_test_bitround.h5 and bf_test_bitround_ref.h5, a rounded and an unrounded
+ *  copy of the same radiance, for BFBitRoundCheck to compare (see the Makefile).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#define NUM_VALUES 4096
+#define FILL_VALUE -999.0f
+#define KEEP_BITS 10
+
+static uint32_t floatBits( float value )
+{
+    uint32_t bits = 0;
+    memcpy( &bits, &value, sizeof bits );
+    return bits;
+}
+
+/* A radiance over several orders of magnitude with fill values, infinities and NaNs */
+static void makeRadiance( float* data )
+{
+    for ( int i = 0; i < NUM_VALUES; i++ )
+        data[i] = (float) ( ( 1.0 + 0.37 * i ) * pow( 10.0, i % 7 - 3 ) );
+    for ( int i = 0; i < NUM_VALUES; i += 97 )
+        data[i] = FILL_VALUE;
+    data[5] = INFINITY;
+    data[6] = -INFINITY;
+    data[7] = NAN;
+    data[8] = 0.0f;
+    data[9] = -1234.5678f;
+}
+
+static herr_t writeRadiance( const char* fileName, const float* data, int keepBits )
+{
+    hsize_t dims = NUM_VALUES;
+    float fill = FILL_VALUE;
+    hid_t fileID = H5Fcreate( fileName, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT );
+    hid_t dsetID = -1;
+    herr_t status = -1;
+
+    if ( fileID >= 0 && H5LTmake_dataset_float( fileID, "/EV_1KM_RefSB", 1, &dims, data ) >= 0 &&
+         H5LTset_attribute_float( fileID, "/EV_1KM_RefSB", "_FillValue", &fill, 1 ) >= 0 )
+    {
+        dsetID = H5Dopen2( fileID, "/EV_1KM_RefSB", H5P_DEFAULT );
+        status = ( dsetID >= 0 && ( keepBits == 0 || setKeepBitsAttr( dsetID, keepBits ) == RET_SUCCESS ) ) ? 0 : -1;
+    }
+
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    if ( fileID >= 0 ) H5Fclose(fileID);
+
+    return status;
+}
+
+int main( void )
+{
+    static float data[NUM_VALUES];
+    static float rounded[NUM_VALUES];
+    BFcontext_t ctx;
+
+    makeRadiance( data );
+
+    for ( int keepBits = 1; keepBits <= KEEP_BITS_MAX; keepBits++ )
+    {
+        const uint32_t dropped = ( (uint32_t) 1 << ( KEEP_BITS_MAX - keepBits ) ) - 1;
+        int numBad = 0;
+
+        memcpy( rounded, data, sizeof data );
+        bitRoundFloat( rounded, NUM_VALUES, keepBits, FILL_VALUE, FILL_VALUE );
+        for ( int i = 0; i < NUM_VALUES; i++ )
+        {
+            if ( data[i] == FILL_VALUE || isinf(data[i]) || isnan(data[i]) )
+            {
+                if ( floatBits( rounded[i] ) != floatBits( data[i] ) )
+                    numBad++;
+                continue;
+            }
+            if ( fabs( (double) rounded[i] - data[i] ) > ldexp( fabs( data[i] ), -( keepBits + 1 ) ) ||
+                 ( floatBits( rounded[i] ) & dropped ) != 0 )
+                numBad++;
+        }
+        CHECK( numBad == 0 );
+    }
+
+    /* Ties go to the even mantissa: with one bit kept, 1.25 lies between 1.0 and 1.5, 1.75 between 1.5 and 2.0 */
+    {
+        float ties[4] = { 1.25f, 1.75f, -1.25f, -1.75f };
+
+        bitRoundFloat( ties, 4, 1, FILL_VALUE, FILL_VALUE );
+        CHECK( ties[0] == 1.0f && ties[1] == 2.0f && ties[2] == -1.0f && ties[3] == -2.0f );
+    }
+
+    /* The default, and the last rule whose name is in the dataset name */
+    setenv( "BF_KEEP_BITS", "12,EV_1KM_RefSB=14,Red Radiance=10,EV_1KM=9", 1 );
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    CHECK( getKeepBits( &ctx, "EV_250_RefSB" ) == 12 );
+    CHECK( getKeepBits( &ctx, "EV_1KM_RefSB" ) == 9 );
+    CHECK( getKeepBits( &ctx, "Red Radiance/RDQI" ) == 10 );
+    freeContext( &ctx );
+    setenv( "BF_KEEP_BITS", "12,=3", 1 );
+    CHECK( initContext( &ctx ) == FATAL_ERR );
+    freeContext( &ctx );
+    setenv( "BF_KEEP_BITS", "24", 1 );
+    CHECK( initContext( &ctx ) == FATAL_ERR );
+    freeContext( &ctx );
+
+    /* The files for BFBitRoundCheck */
+    memcpy( rounded, data, sizeof data );
+    bitRoundFloat( rounded, NUM_VALUES, KEEP_BITS, FILL_VALUE, FILL_VALUE );
+    CHECK( writeRadiance( "bf_test_bitround_ref.h5", data, 0 ) >= 0 );
+    CHECK( writeRadiance( "bf_test_bitround.h5", rounded, KEEP_BITS ) >= 0 );
+
+    return bfTestResult( "bitround" );
+}
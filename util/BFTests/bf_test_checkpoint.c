@@ -0,0 +1,115 @@
+/*
+ *  Checkpoint and resume (BF_RESUME). Two units are written and checkpointed, a third one is cut short.
+ *  After reopening, resumeFromCheckpoint must remove what the third unit wrote, including its dimension
+ *  scale references, keep the completed units and their markers and give back the unit to redo.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#define FILE_NAME "bf_test_checkpoint.h5"
+
+/* A group with one dataset attached to the scale /Band */
+static herr_t writeUnit( hid_t fileID, const char* groupPath )
+{
+    float values[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    hsize_t dims = 4;
+    hid_t lcpl = H5Pcreate( H5P_LINK_CREATE );
+    hid_t groupID = -1;
+    hid_t dsetID = -1;
+    hid_t scaleID = -1;
+    herr_t status = -1;
+
+    H5Pset_create_intermediate_group( lcpl, 1 );
+    groupID = H5Gcreate2( fileID, groupPath, lcpl, H5P_DEFAULT, H5P_DEFAULT );
+    if ( groupID >= 0 && H5LTmake_dataset_float( groupID, "Radiance", 1, &dims, values ) >= 0 )
+    {
+        dsetID = H5Dopen2( groupID, "Radiance", H5P_DEFAULT );
+        scaleID = H5Dopen2( fileID, "/Band", H5P_DEFAULT );
+        if ( dsetID >= 0 && scaleID >= 0 )
+            status = H5DSattach_scale( dsetID, scaleID, 0 );
+    }
+
+    if ( scaleID >= 0 ) H5Dclose(scaleID);
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    if ( groupID >= 0 ) H5Gclose(groupID);
+    H5Pclose(lcpl);
+
+    return status;
+}
+
+int main( void )
+{
+    float band[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    hsize_t dims = 4;
+    hid_t fileID = -1;
+    hid_t scaleID = -1;
+    int nextUnit = -1;
+    char* marker = NULL;
+
+    fileID = H5Fcreate( FILE_NAME, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT );
+    REQUIRE( fileID >= 0 );
+    REQUIRE( H5LTmake_dataset_float( fileID, "/Band", 1, &dims, band ) >= 0 );
+    scaleID = H5Dopen2( fileID, "/Band", H5P_DEFAULT );
+    REQUIRE( scaleID >= 0 && H5DSset_scale( scaleID, "Band" ) >= 0 );
+    H5Dclose(scaleID);
+
+    /* A file without a checkpoint is left as it is */
+    CHECK( resumeFromCheckpoint( fileID, &nextUnit ) == RET_SUCCESS_NO_PROCESS );
+
+    /* Unit 0 writes the instrument group, unit 1 one granule of a per-granule instrument */
+    REQUIRE( writeUnit( fileID, "/MOPITT" ) >= 0 );
+    REQUIRE( checkpointUnit( fileID, "MOPITT", 0, 1, "MOP01-20070703-L1V3.50.0.he5," ) == RET_SUCCESS );
+    REQUIRE( writeUnit( fileID, "/MODIS/granule_2007184_1610" ) >= 0 );
+    REQUIRE( checkpointUnit( fileID, "MODIS", 1, 2, "MOD021KM.A2007184.1610.006.hdf," ) == RET_SUCCESS );
+
+    /* Unit 2 is interrupted: a second granule and a new instrument group without a checkpoint */
+    REQUIRE( writeUnit( fileID, "/MODIS/granule_2007184_1615" ) >= 0 );
+    REQUIRE( writeUnit( fileID, "/ASTER/granule_07032007014224" ) >= 0 );
+    H5Fclose(fileID);
+
+    fileID = H5Fopen( FILE_NAME, H5F_ACC_RDWR, H5P_DEFAULT );
+    REQUIRE( fileID >= 0 );
+    CHECK( resumeFromCheckpoint( fileID, &nextUnit ) == RET_SUCCESS );
+    CHECK( nextUnit == 2 );
+
+    CHECK( H5Lexists( fileID, "/MOPITT/Radiance", H5P_DEFAULT ) > 0 );
+    CHECK( H5Lexists( fileID, "/MODIS/granule_2007184_1610/Radiance", H5P_DEFAULT ) > 0 );
+    CHECK( H5Lexists( fileID, "/MODIS/granule_2007184_1615", H5P_DEFAULT ) == 0 );
+    CHECK( H5Lexists( fileID, "/ASTER", H5P_DEFAULT ) == 0 );
+
+    marker = getUnitMarker( fileID, "/MODIS/granule_2007184_1610" );
+    CHECK( marker != NULL && strcmp( marker, "MOD021KM.A2007184.1610.006.hdf," ) == 0 );
+    free(marker);
+
+    /* Only the datasets of the completed units are still attached to the scale */
+    {
+        hid_t attrID = H5Aopen_by_name( fileID, "/Band", "REFERENCE_LIST", H5P_DEFAULT, H5P_DEFAULT );
+        hid_t spaceID = attrID >= 0 ? H5Aget_space( attrID ) : -1;
+        hid_t dsetID = H5Dopen2( fileID, "/MOPITT/Radiance", H5P_DEFAULT );
+
+        scaleID = H5Dopen2( fileID, "/Band", H5P_DEFAULT );
+        CHECK( spaceID >= 0 && H5Sget_simple_extent_npoints( spaceID ) == 2 );
+        CHECK( H5DSis_attached( dsetID, scaleID, 0 ) > 0 );
+        H5Dclose(scaleID);
+        H5Dclose(dsetID);
+        if ( spaceID >= 0 ) H5Sclose(spaceID);
+        if ( attrID >= 0 ) H5Aclose(attrID);
+    }
+
+    /* Once the orbit is complete the checkpoint and the markers go away */
+    CHECK( removeCheckpoint( fileID ) == RET_SUCCESS );
+    CHECK( H5Lexists( fileID, "/BF_Checkpoint", H5P_DEFAULT ) == 0 );
+    marker = getUnitMarker( fileID, "/MODIS/granule_2007184_1610" );
+    CHECK( marker == NULL );
+    free(marker);
+
+    H5Fclose(fileID);
+    remove( FILE_NAME );
+
+    return bfTestResult( "checkpoint" );
+}
@@ -0,0 +1,169 @@
+/*
+ *  Checksums of the output (BF_CHECKSUM). The checksums written by insertDataset and its chunked variants
+ *  must be the XXH64 of each block of values, the dataset checksum the XXH64 of the block checksums, and
+ *  the manifest must list every dataset with the XXH64 of the list as the file checksum.
+ *
+ *  The program also writes bf_test_checksum.h5, intact, and bf_test_checksum_bad.h5, where one value was
+ *  changed after it was written, for BFChecksum to verify (see the Makefile).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "xxhash64.h"
+#include "bf_test.h"
+
+#define BANDS 3
+#define ROWS 40
+#define COLS 50
+
+typedef struct
+{
+    char* path;
+    uint64_t checksum;
+    uint64_t blocks;
+} manifestRow_t;
+
+static float radiance[BANDS * ROWS * COLS];
+static int32_t flags[ROWS * COLS];
+
+/* A file with a contiguous and a chunked dataset in a group, and its manifest */
+static herr_t writeFile( const BFcontext_t* ctx, const char* fileName )
+{
+    hsize_t radianceDims[3] = { BANDS, ROWS, COLS };
+    hsize_t flagDims[2] = { ROWS, COLS };
+    hid_t fileID = H5Fcreate( fileName, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT );
+    hid_t groupID = -1;
+    herr_t status = FATAL_ERR;
+
+    if ( fileID >= 0 )
+        groupID = H5Gcreate2( fileID, "/MODIS", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( groupID >= 0 &&
+         insertDataset( ctx, &groupID, 0, 2, flagDims, H5T_NATIVE_INT32, "Flags", flags ) != FATAL_ERR &&
+         insertDataset_comp( ctx, &groupID, 0, 3, radianceDims, H5T_NATIVE_FLOAT, "Radiance", radiance, 1 ) != FATAL_ERR )
+        status = writeChecksumManifest( ctx, fileID );
+
+    if ( groupID >= 0 ) H5Gclose(groupID);
+    if ( fileID >= 0 ) H5Fclose(fileID);
+
+    return status;
+}
+
+static int readChecksums( hid_t fileID, const char* path, uint64_t* checksum, uint64_t* blocks, size_t maxBlocks )
+{
+    hsize_t numBlocks = 0;
+    H5T_class_t typeClass;
+    size_t typeSize = 0;
+
+    if ( H5LTget_attribute( fileID, path, CHECKSUM_ATTR, H5T_NATIVE_UINT64, checksum ) < 0 ||
+         H5LTget_attribute_info( fileID, path, CHECKSUM_BLOCKS_ATTR, &numBlocks, &typeClass, &typeSize ) < 0 ||
+         numBlocks > maxBlocks || H5LTget_attribute( fileID, path, CHECKSUM_BLOCKS_ATTR, H5T_NATIVE_UINT64, blocks ) < 0 )
+        return -1;
+
+    return (int) numBlocks;
+}
+
+int main( void )
+{
+    const char* text = "Terra basic fusion";
+    BFcontext_t ctx;
+    hid_t fileID = -1;
+    hid_t dsetID = -1;
+    hid_t rowType = -1;
+    hid_t strType = -1;
+    manifestRow_t manifest[4];
+    hsize_t numRows = 0;
+    uint64_t checksum = 0;
+    uint64_t fileChecksum = 0;
+    uint64_t blocks[BANDS];
+    uint64_t sums[2];
+    hsize_t blockDims[3] = { 0, 0, 0 };
+
+    for ( int i = 0; i < BANDS * ROWS * COLS; i++ )
+        radiance[i] = 0.25f * i;
+    for ( int i = 0; i < ROWS * COLS; i++ )
+        flags[i] = i % 7 - 3;
+
+    /* Reference values of XXH64, and the same digest whole and in pieces */
+    CHECK( xxh64( "", 0, 0 ) == UINT64_C(0xEF46DB3751D8E999) );
+    CHECK( xxh64( "a", 1, 0 ) == UINT64_C(0xD24EC4F1A98C6E5B) );
+    {
+        xxh64State_t state;
+
+        xxh64Init( &state, 7 );
+        xxh64Update( &state, text, 5 );
+        xxh64Update( &state, text + 5, strlen(text) - 5 );
+        CHECK( xxh64Digest( &state ) == xxh64( text, strlen(text), 7 ) );
+    }
+
+    setenv( "BF_CHECKSUM", "1", 1 );
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    REQUIRE( writeFile( &ctx, "bf_test_checksum.h5" ) == RET_SUCCESS );
+    REQUIRE( writeFile( &ctx, "bf_test_checksum_bad.h5" ) == RET_SUCCESS );
+    freeContext( &ctx );
+
+    fileID = H5Fopen( "bf_test_checksum.h5", H5F_ACC_RDONLY, H5P_DEFAULT );
+    REQUIRE( fileID >= 0 );
+
+    /* The contiguous dataset is a single block */
+    CHECK( readChecksums( fileID, "/MODIS/Flags", &checksum, blocks, BANDS ) == 1 );
+    CHECK( blocks[0] == xxh64( flags, sizeof flags, 0 ) && checksum == xxh64Words( blocks, 1, 0 ) );
+    sums[0] = checksum;
+
+    /* The chunked dataset has a block per chunk, a band of the radiance */
+    CHECK( readChecksums( fileID, "/MODIS/Radiance", &checksum, blocks, BANDS ) == BANDS );
+    for ( int b = 0; b < BANDS; b++ )
+        CHECK( blocks[b] == xxh64( radiance + b * ROWS * COLS, ROWS * COLS * sizeof *radiance, 0 ) );
+    CHECK( checksum == xxh64Words( blocks, BANDS, 0 ) );
+    CHECK( H5LTget_attribute( fileID, "/MODIS/Radiance", CHECKSUM_BLOCK_DIMS_ATTR, H5T_NATIVE_HSIZE, blockDims ) >= 0 );
+    CHECK( blockDims[0] == 1 && blockDims[1] == ROWS && blockDims[2] == COLS );
+    sums[1] = checksum;
+
+    /* The manifest, in the order of the paths */
+    REQUIRE( H5LTget_dataset_info( fileID, "/" CHECKSUM_GROUP "/manifest", &numRows, NULL, NULL ) >= 0 );
+    REQUIRE( numRows == 2 );
+    strType = H5Tcopy( H5T_C_S1 );
+    H5Tset_size( strType, H5T_VARIABLE );
+    rowType = H5Tcreate( H5T_COMPOUND, sizeof(manifestRow_t) );
+    H5Tinsert( rowType, "path", HOFFSET(manifestRow_t, path), strType );
+    H5Tinsert( rowType, "checksum", HOFFSET(manifestRow_t, checksum), H5T_NATIVE_UINT64 );
+    H5Tinsert( rowType, "blocks", HOFFSET(manifestRow_t, blocks), H5T_NATIVE_UINT64 );
+    dsetID = H5Dopen2( fileID, "/" CHECKSUM_GROUP "/manifest", H5P_DEFAULT );
+    REQUIRE( dsetID >= 0 && H5Dread( dsetID, rowType, H5S_ALL, H5S_ALL, H5P_DEFAULT, manifest ) >= 0 );
+    CHECK( strcmp( manifest[0].path, "/MODIS/Flags" ) == 0 && manifest[0].checksum == sums[0] && manifest[0].blocks == 1 );
+    CHECK( strcmp( manifest[1].path, "/MODIS/Radiance" ) == 0 && manifest[1].checksum == sums[1] && manifest[1].blocks == BANDS );
+    free(manifest[0].path);
+    free(manifest[1].path);
+    H5Dclose(dsetID);
+    H5Tclose(rowType);
+    H5Tclose(strType);
+    CHECK( H5LTget_attribute( fileID, "/" CHECKSUM_GROUP, CHECKSUM_ATTR, H5T_NATIVE_UINT64, &fileChecksum ) >= 0 );
+    CHECK( fileChecksum == xxh64Words( sums, 2, 0 ) );
+    H5Fclose(fileID);
+
+    /* Damage one value of the second band */
+    fileID = H5Fopen( "bf_test_checksum_bad.h5", H5F_ACC_RDWR, H5P_DEFAULT );
+    REQUIRE( fileID >= 0 );
+    dsetID = H5Dopen2( fileID, "/MODIS/Radiance", H5P_DEFAULT );
+    REQUIRE( dsetID >= 0 );
+    {
+        hsize_t start[3] = { 1, 17, 23 };
+        hsize_t count[3] = { 1, 1, 1 };
+        hid_t fileSpace = H5Dget_space( dsetID );
+        hid_t memSpace = H5Screate_simple( 1, count, NULL );
+        float value = -1.0f;
+
+        H5Sselect_hyperslab( fileSpace, H5S_SELECT_SET, start, NULL, count, NULL );
+        CHECK( H5Dwrite( dsetID, H5T_NATIVE_FLOAT, memSpace, fileSpace, H5P_DEFAULT, &value ) >= 0 );
+        H5Sclose(memSpace);
+        H5Sclose(fileSpace);
+    }
+    H5Dclose(dsetID);
+    H5Fclose(fileID);
+
+    return bfTestResult( "checksum" );
+}
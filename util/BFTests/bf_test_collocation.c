@@ -0,0 +1,245 @@
+/*
+ *  Collocation of the instruments (BF_COLLOCATE). CERES footprints and MISR blocks are collocated with
+ *  two MODIS granules and an ASTER subsystem around the antimeridian. The runs written by
+ *  collocateInstruments must list exactly the pixels within the footprint radius of each footprint, and
+ *  give each ASTER pixel the block of its nearest MISR point, as found by a brute-force search.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#ifndef M_PI
+#    define M_PI 3.14159265358979323846
+#endif
+
+#define EARTH_RADIUS_KM 6371.0
+#define NUM_FOOTPRINTS 100
+#define BLOCKS 4
+#define BLOCK_ROWS 8
+#define BLOCK_COLS 16
+#define ROWS 60
+#define COLS 70
+
+typedef struct
+{
+    uint32_t target;
+    uint32_t start;
+    uint32_t count;
+} run_t;
+
+static double ceresLat[NUM_FOOTPRINTS], ceresLon[NUM_FOOTPRINTS];
+static double misrLat[BLOCKS * BLOCK_ROWS * BLOCK_COLS], misrLon[BLOCKS * BLOCK_ROWS * BLOCK_COLS];
+static double modisLat[2][ROWS * COLS], modisLon[2][ROWS * COLS];
+
+static double wrap( double lon )
+{
+    return lon >= 180.0 ? lon - 360.0 : lon;
+}
+
+/* The haversine of the angle between two points, compared with that of a distance */
+static double haversine( double lat1, double lon1, double lat2, double lon2 )
+{
+    const double rad = M_PI / 180.0;
+    double sLat = sin( ( lat2 - lat1 ) * rad / 2 );
+    double sLon = sin( ( lon2 - lon1 ) * rad / 2 );
+
+    return sLat * sLat + cos( lat1 * rad ) * cos( lat2 * rad ) * sLon * sLon;
+}
+
+static double haversineOf( double km )
+{
+    double s = sin( km / ( 2 * EARTH_RADIUS_KM ) );
+    return s * s;
+}
+
+/* The library keeps the source points in single precision, as the search does, but its cosines of the
+   latitude too: pixels on the edge of the radius may go either way */
+static int nearEdge( double h, double km )
+{
+    return fabs( h - haversineOf( km ) ) < 1e-5 * haversineOf( km );
+}
+
+static herr_t addGeolocation( const BFcontext_t* ctx, hid_t fileID, const char* instrument, const char* groupPath,
+                              int rank, const hsize_t* dims, const double* lat, const double* lon, hsize_t unitRows )
+{
+    hid_t lcpl = H5Pcreate( H5P_LINK_CREATE );
+    hid_t groupID = -1;
+    herr_t status = FATAL_ERR;
+
+    H5Pset_create_intermediate_group( lcpl, 1 );
+    groupID = H5Gcreate2( fileID, groupPath, lcpl, H5P_DEFAULT, H5P_DEFAULT );
+    if ( groupID >= 0 && H5LTmake_dataset_double( groupID, "Latitude", rank, dims, lat ) >= 0 &&
+         H5LTmake_dataset_double( groupID, "Longitude", rank, dims, lon ) >= 0 )
+        status = indexGeolocation( ctx, instrument, groupID, "Latitude", "Longitude", unitRows );
+
+    if ( groupID >= 0 ) H5Gclose(groupID);
+    H5Pclose(lcpl);
+
+    return status;
+}
+
+/* The CSR runs of one source and target: offsets (numUnits+1) and runs */
+static int readRuns( hid_t fileID, const char* groupPath, uint64_t** offsets, hsize_t* numOffsets, run_t** runs )
+{
+    char path[256];
+    hsize_t numRuns = 0;
+    hid_t runType = H5Tcreate( H5T_COMPOUND, sizeof(run_t) );
+    hid_t dsetID = -1;
+    int status = -1;
+
+    H5Tinsert( runType, "target", HOFFSET(run_t, target), H5T_NATIVE_UINT32 );
+    H5Tinsert( runType, "start", HOFFSET(run_t, start), H5T_NATIVE_UINT32 );
+    H5Tinsert( runType, "count", HOFFSET(run_t, count), H5T_NATIVE_UINT32 );
+
+    sprintf( path, "%s/offsets", groupPath );
+    if ( H5LTget_dataset_info( fileID, path, numOffsets, NULL, NULL ) >= 0 &&
+         ( *offsets = malloc( *numOffsets * sizeof **offsets ) ) != NULL &&
+         H5LTread_dataset( fileID, path, H5T_NATIVE_UINT64, *offsets ) >= 0 )
+    {
+        sprintf( path, "%s/runs", groupPath );
+        dsetID = H5Dopen2( fileID, path, H5P_DEFAULT );
+        if ( dsetID >= 0 && H5LTget_dataset_info( fileID, path, &numRuns, NULL, NULL ) >= 0 &&
+             ( *runs = malloc( ( numRuns ? numRuns : 1 ) * sizeof **runs ) ) != NULL &&
+             H5Dread( dsetID, runType, H5S_ALL, H5S_ALL, H5P_DEFAULT, *runs ) >= 0 )
+            status = 0;
+    }
+
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    H5Tclose(runType);
+
+    return status;
+}
+
+int main( void )
+{
+    static char covered[2][ROWS * COLS];
+    static int block[ROWS * COLS];
+    hsize_t ceresDims = NUM_FOOTPRINTS;
+    hsize_t misrDims[3] = { BLOCKS, BLOCK_ROWS, BLOCK_COLS };
+    hsize_t modisDims[2] = { ROWS, COLS };
+    BFcontext_t ctx;
+    hid_t fapl = H5Pcreate( H5P_FILE_ACCESS );
+    hid_t fileID = -1;
+    uint64_t* offsets = NULL;
+    hsize_t numOffsets = 0;
+    run_t* runs = NULL;
+    char unit[32] = "";
+    long numWrong = 0;
+    long numHits = 0;
+
+    /* Footprints every 0.1 degree from 179.5 to 180.4, MISR and MODIS rows 0.01 and 0.02 degree apart */
+    for ( int i = 0; i < NUM_FOOTPRINTS; i++ )
+    {
+        ceresLat[i] = 10.0 + ( i / 10 ) * 0.1;
+        ceresLon[i] = wrap( 179.5 + ( i % 10 ) * 0.1 );
+    }
+    ceresLat[5] = -999.0;
+    for ( int b = 0; b < BLOCKS; b++ )
+        for ( int r = 0; r < BLOCK_ROWS; r++ )
+            for ( int c = 0; c < BLOCK_COLS; c++ )
+            {
+                int k = ( b * BLOCK_ROWS + r ) * BLOCK_COLS + c;
+                misrLat[k] = 10.0 + ( b * BLOCK_ROWS + r ) * 0.01;
+                misrLon[k] = wrap( 179.9 + c * 0.01 );
+            }
+    for ( int g = 0; g < 2; g++ )
+        for ( int k = 0; k < ROWS * COLS; k++ )
+        {
+            modisLat[g][k] = 9.95 + ( k / COLS ) * 0.02 + g * 0.5;
+            modisLon[g][k] = wrap( 179.4 + ( k % COLS ) * 0.018 );
+        }
+    modisLat[0][7] = -999.0;
+
+    setenv( "BF_COLLOCATE", "1", 1 );
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    H5Pset_fapl_core( fapl, 4 * 1024 * 1024, 0 );
+    fileID = H5Fcreate( "bf_test_collocation.h5", H5F_ACC_TRUNC, H5P_DEFAULT, fapl );
+    REQUIRE( fileID >= 0 );
+    ctx.outputFile = fileID;
+
+    REQUIRE( addGeolocation( &ctx, fileID, "CERES", "/CERES/FM1/Time_and_Position", 1, &ceresDims, ceresLat, ceresLon,
+                             SPATIAL_UNIT_CERES ) == RET_SUCCESS );
+    REQUIRE( addGeolocation( &ctx, fileID, "MISR", "/MISR/Geolocation", 3, misrDims, misrLat, misrLon, SPATIAL_UNIT_MISR ) == RET_SUCCESS );
+    REQUIRE( addGeolocation( &ctx, fileID, "MODIS", "/MODIS/granule_1/_1KM/Geolocation", 2, modisDims, modisLat[0], modisLon[0],
+                             SPATIAL_UNIT_MODIS ) == RET_SUCCESS );
+    REQUIRE( addGeolocation( &ctx, fileID, "MODIS", "/MODIS/granule_2/_1KM/Geolocation", 2, modisDims, modisLat[1], modisLon[1],
+                             SPATIAL_UNIT_MODIS ) == RET_SUCCESS );
+    REQUIRE( addGeolocation( &ctx, fileID, "ASTER", "/ASTER/granule_1/VNIR/Geolocation", 2, modisDims, modisLat[0], modisLon[0],
+                             SPATIAL_UNIT_ALL ) == RET_SUCCESS );
+
+    /* A second run replaces the first one */
+    REQUIRE( collocateInstruments( &ctx, fileID ) == RET_SUCCESS );
+    REQUIRE( collocateInstruments( &ctx, fileID ) == RET_SUCCESS );
+
+    /* CERES x MODIS: all pixels within the footprint radius */
+    REQUIRE( readRuns( fileID, "/" COLLOCATION_GROUP "/CERES/CERES.FM1.Time_and_Position.Latitude/MODIS",
+                       &offsets, &numOffsets, &runs ) == 0 );
+    CHECK( numOffsets == NUM_FOOTPRINTS + 1 );
+    for ( int u = 0; u < NUM_FOOTPRINTS && numOffsets == NUM_FOOTPRINTS + 1; u++ )
+    {
+        memset( covered, 0, sizeof covered );
+        for ( uint64_t r = offsets[u]; r < offsets[u + 1]; r++ )
+            for ( uint32_t e = 0; e < runs[r].count; e++ )
+                covered[runs[r].target][runs[r].start + e] = 1;
+        for ( int g = 0; g < 2; g++ )
+            for ( int k = 0; k < ROWS * COLS; k++ )
+            {
+                double h = haversine( (float) ceresLat[u], (float) ceresLon[u], modisLat[g][k], modisLon[g][k] );
+                int inside = ceresLat[u] > -90.0 && modisLat[g][k] > -90.0 && h <= haversineOf( ctx.collocateCeresKm );
+
+                numHits += inside;
+                numWrong += inside != covered[g][k] && !nearEdge( h, ctx.collocateCeresKm );
+            }
+    }
+    CHECK( numHits > 0 && numWrong == 0 );
+    free(offsets);
+    free(runs);
+
+    /* MISR x ASTER: the block of the nearest MISR point within COLLOCATE_MISR_KM */
+    REQUIRE( readRuns( fileID, "/" COLLOCATION_GROUP "/MISR/MISR.Geolocation.Latitude/ASTER", &offsets, &numOffsets, &runs ) == 0 );
+    CHECK( numOffsets == BLOCKS + 1 );
+    for ( int k = 0; k < ROWS * COLS; k++ )
+        block[k] = -1;
+    for ( int u = 0; u < BLOCKS && numOffsets == BLOCKS + 1; u++ )
+        for ( uint64_t r = offsets[u]; r < offsets[u + 1]; r++ )
+            for ( uint32_t e = 0; e < runs[r].count; e++ )
+                block[runs[r].start + e] = u;
+    numWrong = 0;
+    numHits = 0;
+    for ( int k = 0; k < ROWS * COLS; k++ )
+    {
+        double best = 2.0;
+        int nearest = -1;
+
+        for ( int m = 0; modisLat[0][k] > -90.0 && m < BLOCKS * BLOCK_ROWS * BLOCK_COLS; m++ )
+        {
+            double h = haversine( (float) misrLat[m], (float) misrLon[m], modisLat[0][k], modisLon[0][k] );
+            if ( h <= haversineOf( COLLOCATE_MISR_KM ) && h < best )
+            {
+                best = h;
+                nearest = m / ( BLOCK_ROWS * BLOCK_COLS );
+            }
+        }
+        numHits += nearest >= 0;
+        numWrong += nearest != block[k];
+    }
+    CHECK( numHits > 0 && numWrong == 0 );
+    free(offsets);
+    free(runs);
+
+    CHECK( H5LTget_attribute_string( fileID, "/" COLLOCATION_GROUP "/MISR/MISR.Geolocation.Latitude", "unit", unit ) >= 0 &&
+           strcmp( unit, "block" ) == 0 );
+
+    H5Fclose(fileID);
+    H5Pclose(fapl);
+    freeContext( &ctx );
+
+    return bfTestResult( "collocation" );
+}
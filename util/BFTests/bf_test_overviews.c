@@ -0,0 +1,115 @@
+/*
+ *  Overviews of the unpacked radiances (BF_OVERVIEWS). Each level written by writeOverviews must hold, for
+ *  every block of 2^n x 2^n pixels, the mean of the valid full-resolution values under it (or the fill
+ *  value if there are none), with the bands kept and odd edges rounded up. The levels are written chunked
+ *  and compressed, as MODIS radiances are.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#define BANDS 2
+#define ROWS 37
+#define COLS 53
+#define LEVELS 3
+#define FILL_VALUE -999.0f
+
+int main( void )
+{
+    static float data[BANDS * ROWS * COLS];
+    static float level[BANDS * ROWS * COLS];
+    const int32 dims[3] = { BANDS, ROWS, COLS };
+    hsize_t h5dims[3] = { BANDS, ROWS, COLS };
+    BFcontext_t ctx;
+    hid_t fapl = H5Pcreate( H5P_FILE_ACCESS );
+    hid_t fileID = -1;
+    hid_t dsetID = -1;
+    char overviews[256] = "";
+    int factors[LEVELS] = { 0 };
+
+    /* Fill in a corner of the first band, so that some blocks have no valid values at all */
+    for ( int b = 0; b < BANDS; b++ )
+        for ( int r = 0; r < ROWS; r++ )
+            for ( int c = 0; c < COLS; c++ )
+                data[( b * ROWS + r ) * COLS + c] = ( b == 0 && r < 9 && c < 9 ) || ( r * COLS + c ) % 11 == 0
+                                                    ? FILL_VALUE : (float) ( b * 100 + r + 0.01 * c * c );
+
+    setenv( "BF_OVERVIEWS", "3", 1 );
+    setenv( "USE_GZIP", "2", 1 );
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    H5Pset_fapl_core( fapl, 1024 * 1024, 0 );
+    fileID = H5Fcreate( "bf_test_overviews.h5", H5F_ACC_TRUNC, H5P_DEFAULT, fapl );
+    REQUIRE( fileID >= 0 );
+    ctx.outputFile = fileID;
+    REQUIRE( H5LTmake_dataset_float( fileID, "/Radiance", 3, h5dims, data ) >= 0 );
+    dsetID = H5Dopen2( fileID, "/Radiance", H5P_DEFAULT );
+    REQUIRE( writeOverviews( &ctx, fileID, dsetID, "Radiance", data, 3, dims, FILL_VALUE, FILL_VALUE, 1, 1 ) == RET_SUCCESS );
+    H5Dclose(dsetID);
+
+    CHECK( H5LTget_attribute_string( fileID, "/Radiance", "overviews", overviews ) >= 0 );
+    CHECK( strcmp( overviews, "Radiance_overview_2 Radiance_overview_4 Radiance_overview_8" ) == 0 );
+    CHECK( H5LTget_attribute_int( fileID, "/Radiance", "overview_factors", factors ) >= 0 );
+    CHECK( factors[0] == 2 && factors[1] == 4 && factors[2] == 8 );
+
+    for ( int n = 1; n <= LEVELS; n++ )
+    {
+        const int factor = 1 << n;
+        const size_t rows = ( ROWS + factor - 1 ) / factor;
+        const size_t cols = ( COLS + factor - 1 ) / factor;
+        char name[64];
+        char of[64] = "";
+        hsize_t levelDims[3] = { 0, 0, 0 };
+        int levelFactor = 0;
+        int numBad = 0;
+        int numFill = 0;
+
+        sprintf( name, "/Radiance" OVERVIEW_SUFFIX "%d", factor );
+        REQUIRE( H5LTget_dataset_info( fileID, name, levelDims, NULL, NULL ) >= 0 );
+        CHECK( levelDims[0] == BANDS && levelDims[1] == rows && levelDims[2] == cols );
+        CHECK( H5LTget_attribute_string( fileID, name, "overview_of", of ) >= 0 && strcmp( of, "Radiance" ) == 0 );
+        CHECK( H5LTget_attribute_int( fileID, name, "overview_factor", &levelFactor ) >= 0 && levelFactor == factor );
+        dsetID = H5Dopen2( fileID, name, H5P_DEFAULT );
+        REQUIRE( dsetID >= 0 && H5Dread( dsetID, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, level ) >= 0 );
+        {
+            hid_t dcpl = H5Dget_create_plist( dsetID );
+            CHECK( H5Pget_layout( dcpl ) == H5D_CHUNKED );
+            H5Pclose(dcpl);
+        }
+        H5Dclose(dsetID);
+
+        for ( size_t b = 0; b < BANDS; b++ )
+            for ( size_t r = 0; r < rows; r++ )
+                for ( size_t c = 0; c < cols; c++ )
+                {
+                    double sum = 0.0;
+                    int count = 0;
+                    float value = level[( b * rows + r ) * cols + c];
+
+                    for ( size_t i = r * factor; i < ( r + 1 ) * factor && i < ROWS; i++ )
+                        for ( size_t j = c * factor; j < ( c + 1 ) * factor && j < COLS; j++ )
+                            if ( data[( b * ROWS + i ) * COLS + j] != FILL_VALUE )
+                            {
+                                sum += data[( b * ROWS + i ) * COLS + j];
+                                count++;
+                            }
+                    if ( count == 0 )
+                        numFill++;
+                    if ( count ? fabs( value - sum / count ) > 1e-5 * fabs( sum / count ) : value != FILL_VALUE )
+                        numBad++;
+                }
+        CHECK( numBad == 0 );
+        CHECK( n == LEVELS || numFill > 0 );
+    }
+
+    H5Fclose(fileID);
+    H5Pclose(fapl);
+    freeContext( &ctx );
+
+    return bfTestResult( "overviews" );
+}
@@ -0,0 +1,160 @@
+/*
+ *  The dataset sink of libbasicfusion (see sinkDatasets). Datasets of an in-memory output file are handed
+ *  to the sink group by group, as the units of work complete. Each dataset must be handed over exactly
+ *  once, with its dimensions, dimension scales, attributes and values, and each group once at the end.
+ *  As the sink does not keep the file, the datasets handed over are removed from it, but not the scales.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#define MAX_RECEIVED 16
+
+typedef struct
+{
+    char path[256];
+    int rank;
+    hsize_t dims[2];
+    char scale[256];            // Of the last dimension
+    char units[32];
+    float scaleFactor;
+    float first;
+} received_t;
+
+typedef struct
+{
+    received_t datasets[MAX_RECEIVED];
+    int numDatasets;
+    char groups[MAX_RECEIVED][256];
+    int numGroups;
+    int orbit;
+} sinkLog_t;
+
+static herr_t logDataset( void* userData, const BFsinkDataset_t* dataset )
+{
+    sinkLog_t* log = userData;
+    received_t* r = NULL;
+
+    if ( log->numDatasets == MAX_RECEIVED || dataset->rank > 2 )
+        return -1;
+    r = &log->datasets[log->numDatasets++];
+    memset( r, 0, sizeof *r );
+    snprintf( r->path, sizeof r->path, "%s/%s", strcmp( dataset->groupPath, "/" ) ? dataset->groupPath : "", dataset->name );
+    r->rank = dataset->rank;
+    for ( int i = 0; i < dataset->rank; i++ )
+        r->dims[i] = dataset->dims[i];
+    if ( dataset->rank > 0 && dataset->dimScales[dataset->rank - 1] )
+        snprintf( r->scale, sizeof r->scale, "%s", dataset->dimScales[dataset->rank - 1] );
+    for ( size_t i = 0; i < dataset->numAttrs; i++ )
+    {
+        const BFsinkAttr_t* attr = &dataset->attrs[i];
+
+        if ( strcmp( attr->name, "units" ) == 0 && H5Tget_class( attr->type ) == H5T_STRING )
+            snprintf( r->units, sizeof r->units, "%s", ( (const char* const*) attr->value )[0] );
+        else if ( strcmp( attr->name, "scale_factor" ) == 0 && H5Tequal( attr->type, H5T_NATIVE_FLOAT ) > 0 )
+            r->scaleFactor = ( (const float*) attr->value )[0];
+    }
+    if ( H5Tequal( dataset->type, H5T_NATIVE_FLOAT ) > 0 )
+        r->first = ( (const float*) dataset->buffer )[0];
+
+    return 0;
+}
+
+static herr_t logGroup( void* userData, const char* groupPath, size_t numAttrs, const BFsinkAttr_t* attrs )
+{
+    sinkLog_t* log = userData;
+
+    if ( log->numGroups == MAX_RECEIVED )
+        return -1;
+    snprintf( log->groups[log->numGroups++], 256, "%s", groupPath );
+    for ( size_t i = 0; i < numAttrs; i++ )
+        if ( strcmp( attrs[i].name, "Orbit" ) == 0 && H5Tequal( attrs[i].type, H5T_NATIVE_INT ) > 0 )
+            log->orbit = ( (const int*) attrs[i].value )[0];
+
+    return 0;
+}
+
+static const received_t* findDataset( const sinkLog_t* log, const char* path )
+{
+    const received_t* found = NULL;
+    int count = 0;
+
+    for ( int i = 0; i < log->numDatasets; i++ )
+        if ( strcmp( log->datasets[i].path, path ) == 0 )
+        {
+            found = &log->datasets[i];
+            count++;
+        }
+
+    return count == 1 ? found : NULL;
+}
+
+int main( void )
+{
+    static sinkLog_t log;
+    hsize_t dims[2] = { 2, 3 };
+    float values[6] = { 1.5f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+    float bands[3] = { 0.0f, 1.0f, 2.0f };
+    float scaleFactor = 0.5f;
+    int orbit = 40110;
+    char fileName[] = "bf_test_sink.h5";
+    BFsink_t sink = { logDataset, &log, 0, logGroup };
+    BFcontext_t ctx;
+    hid_t fileID = -1;
+    hid_t dsetID = -1;
+    hid_t scaleID = -1;
+    const received_t* r = NULL;
+
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    ctx.sink = &sink;
+    REQUIRE( createMemoryOutputFile( &fileID, fileName ) == RET_SUCCESS );
+
+    /* A unit of work: a radiance with a band scale */
+    REQUIRE( H5Gclose( H5Gcreate2( fileID, "/MODIS", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT ) ) >= 0 );
+    REQUIRE( H5LTmake_dataset_float( fileID, "/MODIS/Radiance", 2, dims, values ) >= 0 );
+    REQUIRE( H5LTmake_dataset_float( fileID, "/MODIS/Band", 1, dims + 1, bands ) >= 0 );
+    dsetID = H5Dopen2( fileID, "/MODIS/Radiance", H5P_DEFAULT );
+    scaleID = H5Dopen2( fileID, "/MODIS/Band", H5P_DEFAULT );
+    REQUIRE( dsetID >= 0 && scaleID >= 0 );
+    CHECK( H5DSset_scale( scaleID, "Band" ) >= 0 && H5DSattach_scale( dsetID, scaleID, 1 ) >= 0 );
+    H5Dclose(scaleID);
+    H5Dclose(dsetID);
+    CHECK( H5LTset_attribute_string( fileID, "/MODIS/Radiance", "units", "W/m^2/sr/um" ) >= 0 );
+    CHECK( H5LTset_attribute_float( fileID, "/MODIS/Radiance", "scale_factor", &scaleFactor, 1 ) >= 0 );
+    REQUIRE( sinkDatasets( &ctx, fileID, "/MODIS", 0 ) == RET_SUCCESS );
+    CHECK( log.numDatasets == 2 && log.numGroups == 0 );
+
+    /* The sink does not keep the file, so the radiance is gone from it, but not the scale others attach to */
+    CHECK( H5Lexists( fileID, "/MODIS/Radiance", H5P_DEFAULT ) == 0 && H5Lexists( fileID, "/MODIS/Band", H5P_DEFAULT ) > 0 );
+
+    /* A group that does not exist has nothing to hand over */
+    REQUIRE( sinkDatasets( &ctx, fileID, "/MISR", 0 ) == RET_SUCCESS );
+    CHECK( log.numDatasets == 2 );
+
+    /* The end of the orbit: only the new dataset, then every group */
+    REQUIRE( H5LTmake_dataset_float( fileID, "/Time", 1, dims, bands ) >= 0 );
+    CHECK( H5LTset_attribute_int( fileID, "/", "Orbit", &orbit, 1 ) >= 0 );
+    REQUIRE( sinkDatasets( &ctx, fileID, "/", 1 ) == RET_SUCCESS );
+    CHECK( log.numDatasets == 3 && log.numGroups == 2 );
+
+    r = findDataset( &log, "/MODIS/Radiance" );
+    CHECK( r != NULL && r->rank == 2 && r->dims[0] == 2 && r->dims[1] == 3 );
+    CHECK( r != NULL && strcmp( r->scale, "/MODIS/Band" ) == 0 );
+    CHECK( r != NULL && strcmp( r->units, "W/m^2/sr/um" ) == 0 && r->scaleFactor == scaleFactor && r->first == 1.5f );
+    CHECK( findDataset( &log, "/MODIS/Band" ) != NULL );
+    r = findDataset( &log, "/Time" );
+    CHECK( r != NULL && r->rank == 1 && r->dims[0] == 2 && r->first == 0.0f );
+    CHECK( strcmp( log.groups[0], "/" ) == 0 || strcmp( log.groups[1], "/" ) == 0 );
+    CHECK( strcmp( log.groups[0], "/MODIS" ) == 0 || strcmp( log.groups[1], "/MODIS" ) == 0 );
+    CHECK( log.orbit == orbit );
+
+    H5Fclose(fileID);
+    freeContext( &ctx );
+
+    return bfTestResult( "sink" );
+}
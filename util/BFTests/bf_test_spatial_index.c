@@ -0,0 +1,125 @@
+/*
+ *  Spatial index of the geolocation (BF_SPATIAL_INDEX). A MODIS granule of three scans, the last one
+ *  crossing the antimeridian, and a whole ASTER granule are indexed with indexGeolocation and
+ *  indexGeolocationBuffer, and then queried with the API of util/SpatialQuery. Every point of the
+ *  geolocation must be found in the box of its own rows, and points away from it must not be found.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_spatial_query.h"
+#include "bf_test.h"
+
+#define SCAN_ROWS 10
+#define ROWS 30
+#define COLS 20
+
+static double modisLat[ROWS * COLS];
+static double modisLon[ROWS * COLS];
+
+/* Scans 0 and 1 are over Europe, scan 2 straddles 180 degrees over the Pacific */
+static void makeGeolocation( void )
+{
+    for ( int r = 0; r < ROWS; r++ )
+        for ( int c = 0; c < COLS; c++ )
+        {
+            int scan = r / SCAN_ROWS;
+            double lon = scan < 2 ? 10.0 + c * 0.1 : 179.0 + c * 0.1;
+
+            modisLat[r * COLS + c] = 40.0 + r * 0.1;
+            modisLon[r * COLS + c] = lon > 180.0 ? lon - 360.0 : lon;
+        }
+    modisLat[3] = -999.0;       // Fill values are left out of the boxes
+    modisLon[3] = -999.0;
+}
+
+/* The number of hits of a point and whether one of them is the scan of row */
+static size_t queryPoint( hid_t fileID, const char* instrument, double lat, double lon, int row, int* found )
+{
+    BFspatialHit_t* hits = NULL;
+    size_t numHits = 0;
+
+    *found = 0;
+    if ( BFspatialQueryPoint( fileID, instrument, lat, lon, &hits, &numHits ) != 0 )
+        return (size_t) -1;
+    for ( size_t i = 0; i < numHits; i++ )
+        if ( row >= (int) hits[i].rowStart && row < (int) ( hits[i].rowStart + hits[i].rowCount ) )
+            *found = 1;
+    BFspatialFreeHits( hits, numHits );
+
+    return numHits;
+}
+
+int main( void )
+{
+    hsize_t dims[2] = { ROWS, COLS };
+    BFcontext_t ctx;
+    hid_t fapl = H5Pcreate( H5P_FILE_ACCESS );
+    hid_t fileID = -1;
+    hid_t groupID = -1;
+    BFspatialHit_t* hits = NULL;
+    size_t numHits = 0;
+    int numMissed = 0;
+    int found = 0;
+
+    makeGeolocation();
+    setenv( "BF_SPATIAL_INDEX", "1", 1 );
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    H5Pset_fapl_core( fapl, 1024 * 1024, 0 );
+    fileID = H5Fcreate( "bf_test_spatial_index.h5", H5F_ACC_TRUNC, H5P_DEFAULT, fapl );
+    REQUIRE( fileID >= 0 );
+    ctx.outputFile = fileID;
+
+    /* The file has no index yet */
+    CHECK( BFspatialQueryPoint( fileID, NULL, 40.0, 10.0, &hits, &numHits ) == 1 );
+
+    /* MODIS from the output file, one box per scan */
+    REQUIRE( H5Gclose( H5Gcreate2( fileID, "/MODIS", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT ) ) >= 0 );
+    groupID = H5Gcreate2( fileID, "/MODIS/Geolocation", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    REQUIRE( groupID >= 0 );
+    REQUIRE( H5LTmake_dataset_double( groupID, "Latitude", 2, dims, modisLat ) >= 0 );
+    REQUIRE( H5LTmake_dataset_double( groupID, "Longitude", 2, dims, modisLon ) >= 0 );
+    CHECK( indexGeolocation( &ctx, "MODIS", groupID, "Latitude", "Longitude", SCAN_ROWS ) == RET_SUCCESS );
+    H5Gclose(groupID);
+
+    /* ASTER from memory, one box for the granule */
+    {
+        double lat[4] = { -10.0, -10.0, -10.5, -10.5 };
+        double lon[4] = { 30.0, 30.5, 30.0, 30.5 };
+
+        CHECK( indexGeolocationBuffer( &ctx, "ASTER", "/ASTER/granule_1/Geolocation/Latitude",
+                                       "/ASTER/granule_1/Geolocation/Longitude", lat, lon, 2, 2, SPATIAL_UNIT_ALL ) == RET_SUCCESS );
+    }
+
+    /* Every valid MODIS point is in the box of its scan */
+    for ( int r = 0; r < ROWS; r++ )
+        for ( int c = 0; c < COLS; c++ )
+            if ( modisLat[r * COLS + c] > -90.0 &&
+                 ( queryPoint( fileID, "MODIS", modisLat[r * COLS + c], modisLon[r * COLS + c], r, &found ) == 0 || !found ) )
+                numMissed++;
+    CHECK( numMissed == 0 );
+
+    /* The antimeridian scan covers 179..181 degrees, not the rest of the globe */
+    CHECK( queryPoint( fileID, "MODIS", 42.5, 179.95, 25, &found ) == 1 && found );
+    CHECK( queryPoint( fileID, "MODIS", 42.5, -179.5, 25, &found ) == 1 && found );
+    CHECK( queryPoint( fileID, "MODIS", 42.5, 0.0, 25, &found ) == 0 );
+    CHECK( queryPoint( fileID, "MODIS", 20.0, 10.5, 0, &found ) == 0 );
+
+    /* Instruments are kept apart, and a box query finds the boxes it overlaps */
+    CHECK( queryPoint( fileID, "ASTER", -10.2, 30.2, 0, &found ) == 1 && found );
+    CHECK( queryPoint( fileID, "MODIS", -10.2, 30.2, 0, &found ) == 0 );
+    CHECK( queryPoint( fileID, NULL, -10.2, 30.2, 0, &found ) == 1 );
+    CHECK( BFspatialQuery( fileID, NULL, 39.0, 45.0, 5.0, 11.0, &hits, &numHits ) == 0 );
+    CHECK( numHits == 2 && strcmp( hits[0].instrument, "MODIS" ) == 0 && strcmp( hits[0].latitude, "/MODIS/Geolocation/Latitude" ) == 0 );
+    BFspatialFreeHits( hits, numHits );
+
+    H5Fclose(fileID);
+    H5Pclose(fapl);
+    freeContext( &ctx );
+
+    return bfTestResult( "spatial_index" );
+}
@@ -0,0 +1,166 @@
+/*
+ *  Statistics of the unpacked radiances (BF_STATS). The values are fed to accumulateStats in pieces that
+ *  do not line up with the tiles, as the unpack kernels may do. The attributes and the tile table written
+ *  by writeDatasetStats must match the counts, ranges and means computed directly from the values.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#define ROWS 700
+#define COLS 200
+#define FILL_VALUE -999.0f
+#define PIECE 1000
+
+typedef struct
+{
+    uint32_t rowStart;
+    uint32_t rowCount;
+    uint64_t validCount;
+    uint64_t fillCount;
+    float min;
+    float max;
+    float mean;
+} tileRow_t;
+
+/* The row of the tile table as written, read by field name */
+static hid_t tileRowType( void )
+{
+    hid_t type = H5Tcreate( H5T_COMPOUND, sizeof(tileRow_t) );
+
+    H5Tinsert( type, "row_start", HOFFSET(tileRow_t, rowStart), H5T_NATIVE_UINT32 );
+    H5Tinsert( type, "row_count", HOFFSET(tileRow_t, rowCount), H5T_NATIVE_UINT32 );
+    H5Tinsert( type, "valid_count", HOFFSET(tileRow_t, validCount), H5T_NATIVE_UINT64 );
+    H5Tinsert( type, "fill_count", HOFFSET(tileRow_t, fillCount), H5T_NATIVE_UINT64 );
+    H5Tinsert( type, "min", HOFFSET(tileRow_t, min), H5T_NATIVE_FLOAT );
+    H5Tinsert( type, "max", HOFFSET(tileRow_t, max), H5T_NATIVE_FLOAT );
+    H5Tinsert( type, "mean", HOFFSET(tileRow_t, mean), H5T_NATIVE_FLOAT );
+
+    return type;
+}
+
+int main( void )
+{
+    static float data[ROWS * COLS];
+    const int32 dims[2] = { ROWS, COLS };
+    hsize_t h5dims[2] = { ROWS, COLS };
+    BFcontext_t ctx;
+    datasetStats_t stats;
+    hid_t fapl = H5Pcreate( H5P_FILE_ACCESS );
+    hid_t fileID = -1;
+    hid_t dsetID = -1;
+    hid_t rowType = -1;
+    tileRow_t rows[8];
+    uint64_t numValid = 0;
+    uint64_t numFill = 0;
+    uint64_t validCount = 0;
+    uint64_t fillCount = 0;
+    uint64_t histTotal = 0;
+    uint64_t hist[STATS_HIST_BINS];
+    float range[2] = { 0.0f, 0.0f };
+    double mean = 0.0;
+    double sum = 0.0;
+    float min = INFINITY;
+    float max = -INFINITY;
+    char tableName[64] = "";
+    hsize_t numTiles = 0;
+
+    /* Radiances from 0 to 700, with fill rows, and a run of fill covering the whole second tile */
+    for ( int r = 0; r < ROWS; r++ )
+        for ( int c = 0; c < COLS; c++ )
+            data[r * COLS + c] = ( r % 50 == 7 || ( r >= 320 && r < 680 ) ) ? FILL_VALUE : r + c / (float) COLS;
+    data[3] = NAN;
+    data[4] = INFINITY;
+    for ( int i = 0; i < ROWS * COLS; i++ )
+    {
+        if ( data[i] == FILL_VALUE || isnan(data[i]) || isinf(data[i]) )
+        {
+            numFill++;
+            continue;
+        }
+        numValid++;
+        sum += data[i];
+        if ( data[i] < min ) min = data[i];
+        if ( data[i] > max ) max = data[i];
+    }
+
+    setenv( "BF_STATS", "1", 1 );
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    REQUIRE( initDatasetStats( &ctx, &stats, 2, dims, FILL_VALUE, FILL_VALUE, 0.0f, 640.0f ) == RET_SUCCESS );
+    CHECK( stats.numTiles == 3 && stats.tileRows * COLS >= STATS_TILE_ELEMS );
+    for ( size_t first = 0; first < ROWS * COLS; first += PIECE )
+        accumulateStats( &stats, data + first, first, ROWS * COLS - first < PIECE ? ROWS * COLS - first : PIECE );
+
+    H5Pset_fapl_core( fapl, 1024 * 1024, 0 );
+    fileID = H5Fcreate( "bf_test_stats.h5", H5F_ACC_TRUNC, H5P_DEFAULT, fapl );
+    REQUIRE( fileID >= 0 );
+    REQUIRE( H5LTmake_dataset_float( fileID, "/Radiance", 2, h5dims, data ) >= 0 );
+    dsetID = H5Dopen2( fileID, "/Radiance", H5P_DEFAULT );
+    REQUIRE( writeDatasetStats( &ctx, &stats, fileID, dsetID, "Radiance" ) == RET_SUCCESS );
+    H5Dclose(dsetID);
+    freeDatasetStats( &stats );
+
+    /* The dataset attributes */
+    CHECK( H5LTget_attribute( fileID, "/Radiance", "valid_count", H5T_NATIVE_UINT64, &validCount ) >= 0 );
+    CHECK( H5LTget_attribute( fileID, "/Radiance", "fill_count", H5T_NATIVE_UINT64, &fillCount ) >= 0 );
+    CHECK( validCount == numValid && fillCount == numFill );
+    CHECK( H5LTget_attribute_float( fileID, "/Radiance", "actual_range", range ) >= 0 );
+    CHECK( range[0] == min && range[1] == max );
+    CHECK( H5LTget_attribute_double( fileID, "/Radiance", "actual_mean", &mean ) >= 0 );
+    CHECK( fabs( mean - sum / numValid ) < 1e-9 * fabs( mean ) );
+    CHECK( H5LTget_attribute( fileID, "/Radiance", "histogram", H5T_NATIVE_UINT64, hist ) >= 0 );
+    for ( int i = 0; i < STATS_HIST_BINS; i++ )
+        histTotal += hist[i];
+    CHECK( histTotal == numValid );
+    CHECK( hist[STATS_HIST_BINS - 1] > hist[STATS_HIST_BINS - 2] );    // Values above 640 go to the last bin
+    CHECK( H5LTget_attribute_string( fileID, "/Radiance", "tile_statistics", tableName ) >= 0 );
+    CHECK( strcmp( tableName, "Radiance" STATS_TABLE_SUFFIX ) == 0 );
+
+    /* The tile table: tiles of whole rows, the all-fill tile with the fill value as its range */
+    REQUIRE( H5LTget_dataset_info( fileID, "/Radiance" STATS_TABLE_SUFFIX, &numTiles, NULL, NULL ) >= 0 );
+    REQUIRE( numTiles == 3 );
+    rowType = tileRowType();
+    dsetID = H5Dopen2( fileID, "/Radiance" STATS_TABLE_SUFFIX, H5P_DEFAULT );
+    REQUIRE( dsetID >= 0 && H5Dread( dsetID, rowType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows ) >= 0 );
+    H5Dclose(dsetID);
+    H5Tclose(rowType);
+    for ( int t = 0; t < 3; t++ )
+    {
+        uint64_t tileValid = 0;
+        float tileMin = INFINITY;
+        float tileMax = -INFINITY;
+        double tileSum = 0.0;
+
+        for ( uint32_t i = rows[t].rowStart * COLS; i < ( rows[t].rowStart + rows[t].rowCount ) * COLS; i++ )
+        {
+            if ( data[i] == FILL_VALUE || isnan(data[i]) || isinf(data[i]) )
+                continue;
+            tileValid++;
+            tileSum += data[i];
+            if ( data[i] < tileMin ) tileMin = data[i];
+            if ( data[i] > tileMax ) tileMax = data[i];
+        }
+        CHECK( rows[t].rowStart == ( t ? rows[t - 1].rowStart + rows[t - 1].rowCount : 0 ) );
+        CHECK( rows[t].validCount == tileValid && rows[t].validCount + rows[t].fillCount == rows[t].rowCount * COLS );
+        if ( tileValid )
+            CHECK( rows[t].min == tileMin && rows[t].max == tileMax &&
+                   fabs( rows[t].mean - tileSum / tileValid ) < 1e-4 * fabs( tileSum / tileValid ) );
+        else
+            CHECK( rows[t].min == FILL_VALUE && rows[t].max == FILL_VALUE && rows[t].mean == FILL_VALUE );
+    }
+    CHECK( rows[2].rowStart + rows[2].rowCount == ROWS );
+    CHECK( rows[1].validCount == 0 );
+
+    H5Fclose(fileID);
+    H5Pclose(fapl);
+    freeContext( &ctx );
+
+    return bfTestResult( "stats" );
+}
@@ -0,0 +1,164 @@
+/*
+ *  Inputs read from tar archives (see tarInput.c). Two members with the same file name in different
+ *  directories must be staged as distinct copies with their own contents, an HDF5 member must open in place
+ *  through the bftar driver, the staged copies must be removed when released, and an archive with a
+ *  damaged header must be refused.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#define STAGE_DIR "bf_test_tar_stage"
+
+static const char* granule1 = "first MODIS granule";
+static const char* granule2 = "second MODIS granule, longer than the first";
+
+/* Write a ustar member: its header, then its data padded to whole blocks */
+static int writeMember( FILE* tar, const char* name, const void* data, size_t size, int badChecksum )
+{
+    unsigned char header[TAR_BLOCK];
+    static const unsigned char zeros[TAR_BLOCK];
+    unsigned int sum = 0;
+
+    memset( header, 0, sizeof header );
+    strncpy( (char*) header, name, 100 );
+    sprintf( (char*) header + 100, "%07o", 0644 );
+    sprintf( (char*) header + 108, "%07o", 0 );
+    sprintf( (char*) header + 116, "%07o", 0 );
+    sprintf( (char*) header + 124, "%011zo", size );
+    sprintf( (char*) header + 136, "%011o", 0 );
+    header[156] = '0';
+    memcpy( header + 257, "ustar\0" "00", 8 );
+    memset( header + 148, ' ', 8 );
+    for ( int i = 0; i < TAR_BLOCK; i++ )
+        sum += header[i];
+    sprintf( (char*) header + 148, "%06o", sum + ( badChecksum ? 1 : 0 ) );
+
+    if ( fwrite( header, 1, TAR_BLOCK, tar ) != TAR_BLOCK || fwrite( data, 1, size, tar ) != size ||
+         fwrite( zeros, 1, ( TAR_BLOCK - size % TAR_BLOCK ) % TAR_BLOCK, tar ) != ( TAR_BLOCK - size % TAR_BLOCK ) % TAR_BLOCK )
+        return -1;
+    return 0;
+}
+
+static int endArchive( FILE* tar )
+{
+    static const unsigned char zeros[2 * TAR_BLOCK];
+    int status = fwrite( zeros, 1, sizeof zeros, tar ) == sizeof zeros ? 0 : -1;
+
+    return fclose( tar ) == 0 ? status : -1;
+}
+
+/* An HDF5 file, as a MOPITT granule would be, built in memory */
+static void* makeHDF5Image( size_t* size )
+{
+    hsize_t dims = 4;
+    int values[4] = { 3, 1, 4, 1 };
+    hid_t fapl = H5Pcreate( H5P_FILE_ACCESS );
+    hid_t fileID = -1;
+    void* image = NULL;
+    ssize_t len = -1;
+
+    H5Pset_fapl_core( fapl, 64 * 1024, 0 );
+    fileID = H5Fcreate( "bf_test_tar_image.h5", H5F_ACC_TRUNC, H5P_DEFAULT, fapl );
+    if ( fileID >= 0 && H5LTmake_dataset_int( fileID, "/Radiance", 1, &dims, values ) >= 0 && H5Fflush( fileID, H5F_SCOPE_GLOBAL ) >= 0 )
+        len = H5Fget_file_image( fileID, NULL, 0 );
+    if ( len > 0 && ( image = malloc( len ) ) != NULL && H5Fget_file_image( fileID, image, len ) != len )
+    {
+        free(image);
+        image = NULL;
+    }
+    *size = len > 0 ? (size_t) len : 0;
+
+    if ( fileID >= 0 ) H5Fclose(fileID);
+    H5Pclose(fapl);
+
+    return image;
+}
+
+/* Whether a file holds exactly text */
+static int fileHolds( const char* path, const char* text )
+{
+    char buffer[128] = "";
+    FILE* file = fopen( path, "rb" );
+    size_t len = 0;
+
+    if ( file == NULL )
+        return 0;
+    len = fread( buffer, 1, sizeof buffer - 1, file );
+    fclose(file);
+
+    return len == strlen(text) && memcmp( buffer, text, len ) == 0;
+}
+
+int main( void )
+{
+    size_t imageSize = 0;
+    void* image = makeHDF5Image( &imageSize );
+    FILE* tar = NULL;
+    hsize_t size = 0;
+    hid_t fapl = -1;
+    hid_t fileID = -1;
+    char staged1[STR_LEN] = "";
+    char staged2[STR_LEN] = "";
+    int values[4] = { 0, 0, 0, 0 };
+
+    REQUIRE( image != NULL );
+    tar = fopen( "bf_test_tar.tar", "wb" );
+    REQUIRE( tar != NULL );
+    REQUIRE( writeMember( tar, "MODIS/a/MOD021KM.hdf", granule1, strlen(granule1), 0 ) == 0 );
+    REQUIRE( writeMember( tar, "MODIS/b/MOD021KM.hdf", granule2, strlen(granule2), 0 ) == 0 );
+    REQUIRE( writeMember( tar, "MOPITT/MOP01.he5", image, imageSize, 0 ) == 0 );
+    REQUIRE( endArchive( tar ) == 0 );
+    tar = fopen( "bf_test_tar_bad.tar", "wb" );
+    REQUIRE( tar != NULL );
+    REQUIRE( writeMember( tar, "MODIS/a/MOD021KM.hdf", granule1, strlen(granule1), 1 ) == 0 );
+    REQUIRE( endArchive( tar ) == 0 );
+    free(image);
+
+    mkdir( STAGE_DIR, 0700 );
+    setenv( "BF_TAR_STAGE_DIR", STAGE_DIR, 1 );
+
+    /* Members are found by their path, or by their file name alone, and other paths are left alone */
+    CHECK( tarMemberSize( "bf_test_tar.tar/MODIS/b/MOD021KM.hdf", &size ) == 1 && size == strlen(granule2) );
+    CHECK( tarMemberSize( "bf_test_tar.tar/MOP01.he5", &size ) == 1 && size == imageSize );
+    CHECK( tarMemberSize( "bf_test_tar.tar/MOD03.hdf", &size ) == FATAL_ERR );
+    CHECK( tarMemberSize( "bf_test_tar_image.h5", &size ) == 0 );
+    CHECK( strcmp( inputFilePath( "MOD021KM.hdf" ), "MOD021KM.hdf" ) == 0 );
+
+    /* HDF4 members are staged apart, once each */
+    strcpy( staged1, inputFilePath( "bf_test_tar.tar/MODIS/a/MOD021KM.hdf" ) );
+    strcpy( staged2, inputFilePath( "bf_test_tar.tar/MODIS/b/MOD021KM.hdf" ) );
+    CHECK( strncmp( staged1, STAGE_DIR "/", strlen(STAGE_DIR) + 1 ) == 0 && strcmp( staged1, staged2 ) != 0 );
+    CHECK( fileHolds( staged1, granule1 ) && fileHolds( staged2, granule2 ) );
+    CHECK( strcmp( inputFilePath( "bf_test_tar.tar/MODIS/a/MOD021KM.hdf" ), staged1 ) == 0 );
+
+    /* HDF5 members are read in place */
+    fapl = tarMemberFapl( "bf_test_tar.tar/MOPITT/MOP01.he5" );
+    REQUIRE( fapl >= 0 && fapl != H5P_DEFAULT );
+    fileID = H5Fopen( "bf_test_tar.tar/MOPITT/MOP01.he5", H5F_ACC_RDONLY, fapl );
+    CHECK( fileID >= 0 && H5LTread_dataset_int( fileID, "/Radiance", values ) >= 0 );
+    CHECK( values[0] == 3 && values[1] == 1 && values[2] == 4 && values[3] == 1 );
+    if ( fileID >= 0 ) H5Fclose(fileID);
+    H5Pclose(fapl);
+    CHECK( tarMemberFapl( "bf_test_tar_image.h5" ) == H5P_DEFAULT );
+
+    /* Released copies are removed, and the staging directory goes with closeTarInputs */
+    releaseStagedInputs();
+    CHECK( access( staged1, F_OK ) != 0 && access( staged2, F_OK ) != 0 );
+    closeTarInputs();
+    CHECK( rmdir( STAGE_DIR ) == 0 );
+
+    /* A header that does not match its checksum stops the indexing */
+    CHECK( tarMemberSize( "bf_test_tar_bad.tar/MODIS/a/MOD021KM.hdf", &size ) == FATAL_ERR );
+    closeTarInputs();
+
+    return bfTestResult( "tar" );
+}
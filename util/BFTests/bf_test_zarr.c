@@ -0,0 +1,172 @@
+/*
+ *  The Zarr v2 output (BF_OUTPUT_FORMAT=zarr, see zarrStore.c). Datasets of several types and shapes, with
+ *  dimension scales and attributes, are written from an in-memory output file to the store
+ *  bf_test_zarr.zarr through the sink, as the conversion does. bf_zarr_check.py then reads the store back
+ *  with the Python standard library only and compares it with the values written here (see the Makefile).
+ *  This program checks the store layout and that a store is never written over.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include "libTERRA.h"
+#include "bf_test.h"
+
+#define STORE "bf_test_zarr.zarr"
+#define ROWS 1000
+#define COLS 70
+#define BANDS 9
+
+typedef struct
+{
+    uint32_t a;
+    uint64_t b;
+    float c;
+} record_t;
+
+/* Radiances of several chunks with a partial edge chunk, and their band scale */
+static herr_t writeRadiance( hid_t fileID )
+{
+    hsize_t dims[3] = { ROWS, COLS, BANDS };
+    float* values = malloc( ROWS * COLS * BANDS * sizeof *values );
+    float bands[BANDS];
+    float fillValue = -999.0f;
+    double scale[2] = { 0.1, 1e-300 };
+    float special[3] = { NAN, INFINITY, -INFINITY };
+    hid_t dsetID = -1;
+    hid_t scaleID = -1;
+    herr_t status = FATAL_ERR;
+
+    if ( values == NULL )
+        return FATAL_ERR;
+    for ( size_t i = 0; i < ROWS * COLS * BANDS; i++ )
+        values[i] = i * 0.5f - 7.0f;
+    for ( int i = 0; i < BANDS; i++ )
+        bands[i] = i * 1.5f;
+
+    if ( H5LTmake_dataset_float( fileID, "/MODIS/Data Fields/Radiance", 3, dims, values ) >= 0 &&
+         H5LTmake_dataset_float( fileID, "/MODIS/Data Fields/Band", 1, dims + 2, bands ) >= 0 )
+    {
+        dsetID = H5Dopen2( fileID, "/MODIS/Data Fields/Radiance", H5P_DEFAULT );
+        scaleID = H5Dopen2( fileID, "/MODIS/Data Fields/Band", H5P_DEFAULT );
+    }
+    if ( dsetID >= 0 && scaleID >= 0 && H5DSset_scale( scaleID, "Band" ) >= 0 && H5DSattach_scale( dsetID, scaleID, 2 ) >= 0 &&
+         H5LTset_attribute_string( fileID, "/MODIS/Data Fields/Radiance", "units", "W/m^2 \"sr\"" ) >= 0 &&
+         H5LTset_attribute_float( fileID, "/MODIS/Data Fields/Radiance", "_FillValue", &fillValue, 1 ) >= 0 &&
+         H5LTset_attribute_double( fileID, "/MODIS/Data Fields/Radiance", "scale", scale, 2 ) >= 0 &&
+         H5LTset_attribute_float( fileID, "/MODIS/Data Fields/Radiance", "special", special, 3 ) >= 0 &&
+         H5LTset_attribute_string( fileID, "/MODIS/Data Fields/Radiance", "utf8",
+                                   "\xc2\xb5m caf\xc3\xa9 \xf0\x9f\x8c\x8d bad\xff\xc3 x\xe2\x82" ) >= 0 )
+        status = RET_SUCCESS;
+
+    if ( scaleID >= 0 ) H5Dclose(scaleID);
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    free(values);
+
+    return status;
+}
+
+/* A 2D integer, a scalar, a compound with padding, strings and an empty dataset */
+static herr_t writeOthers( hid_t fileID )
+{
+    hsize_t dims2[2] = { 5, 7 };
+    hsize_t dims1 = 3;
+    hsize_t dims0 = 0;
+    short counts[35];
+    int64_t scalar = -1234567890123LL;
+    record_t records[3] = { { 1, 2, 3.5f }, { 4, 5000000000ULL, 6.25f }, { 7, 8, -9.0f } };
+    const char* names[3] = { "alpha", "be", "" };
+    hid_t recordType = H5Tcreate( H5T_COMPOUND, sizeof(record_t) );
+    hid_t strType = H5Tcopy( H5T_C_S1 );
+    hid_t space = -1;
+    hid_t dsetID = -1;
+    herr_t status = RET_SUCCESS;
+
+    for ( int i = 0; i < 35; i++ )
+        counts[i] = (short) ( i * 1000 - 17000 );
+    H5Tinsert( recordType, "a", HOFFSET(record_t, a), H5T_NATIVE_UINT32 );
+    H5Tinsert( recordType, "b", HOFFSET(record_t, b), H5T_NATIVE_UINT64 );
+    H5Tinsert( recordType, "c", HOFFSET(record_t, c), H5T_NATIVE_FLOAT );
+    H5Tset_size( strType, H5T_VARIABLE );
+
+    if ( H5LTmake_dataset_short( fileID, "/MODIS/Counts", 2, dims2, counts ) < 0 )
+        status = FATAL_ERR;
+
+    space = H5Screate( H5S_SCALAR );
+    dsetID = H5Dcreate2( fileID, "/Scalar", H5T_NATIVE_INT64, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( dsetID < 0 || H5Dwrite( dsetID, H5T_NATIVE_INT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, &scalar ) < 0 )
+        status = FATAL_ERR;
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    H5Sclose(space);
+
+    space = H5Screate_simple( 1, &dims1, NULL );
+    dsetID = H5Dcreate2( fileID, "/Records", recordType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( dsetID < 0 || H5Dwrite( dsetID, recordType, H5S_ALL, H5S_ALL, H5P_DEFAULT, records ) < 0 )
+        status = FATAL_ERR;
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    dsetID = H5Dcreate2( fileID, "/Names", strType, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( dsetID < 0 || H5Dwrite( dsetID, strType, H5S_ALL, H5S_ALL, H5P_DEFAULT, names ) < 0 )
+        status = FATAL_ERR;
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    H5Sclose(space);
+
+    space = H5Screate_simple( 1, &dims0, NULL );
+    dsetID = H5Dcreate2( fileID, "/Empty", H5T_NATIVE_FLOAT, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT );
+    if ( dsetID < 0 )
+        status = FATAL_ERR;
+    if ( dsetID >= 0 ) H5Dclose(dsetID);
+    H5Sclose(space);
+
+    H5Tclose(strType);
+    H5Tclose(recordType);
+
+    return status;
+}
+
+int main( void )
+{
+    char fileName[] = STORE;
+    int orbit = 40110;
+    BFcontext_t ctx;
+    BFsink_t sink = { zarrSinkDataset, NULL, 0, zarrSinkGroup };
+    zarrStore_t* store = NULL;
+    hid_t fileID = -1;
+
+    REQUIRE( initContext( &ctx ) == RET_SUCCESS );
+    store = zarrOpenStore( STORE, 4 );
+    REQUIRE( store != NULL );
+    sink.userData = store;
+    ctx.sink = &sink;
+    REQUIRE( createMemoryOutputFile( &fileID, fileName ) == RET_SUCCESS );
+
+    /* A unit of work, then the rest of the file at the end of the orbit */
+    REQUIRE( H5Gclose( H5Gcreate2( fileID, "/MODIS", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT ) ) >= 0 );
+    REQUIRE( H5Gclose( H5Gcreate2( fileID, "/MODIS/Data Fields", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT ) ) >= 0 );
+    REQUIRE( H5Gclose( H5Gcreate2( fileID, "/NoData", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT ) ) >= 0 );
+    REQUIRE( writeRadiance( fileID ) == RET_SUCCESS );
+    REQUIRE( writeOthers( fileID ) == RET_SUCCESS );
+    REQUIRE( sinkDatasets( &ctx, fileID, "/MODIS", 0 ) == RET_SUCCESS );
+    CHECK( H5LTset_attribute_string( fileID, "/", "InputGranules", "g1,g2" ) >= 0 );
+    CHECK( H5LTset_attribute_int( fileID, "/", "Orbit", &orbit, 1 ) >= 0 );
+    REQUIRE( sinkDatasets( &ctx, fileID, "/", 1 ) == RET_SUCCESS );
+    H5Fclose(fileID);
+    freeContext( &ctx );
+    CHECK( zarrCloseStore( store, 1 ) == RET_SUCCESS );
+
+    /* The layout of the store: chunk keys of row-major grid positions, and consolidated metadata */
+    CHECK( access( STORE "/.zgroup", F_OK ) == 0 && access( STORE "/.zmetadata", F_OK ) == 0 );
+    CHECK( access( STORE "/MODIS/Data Fields/Radiance/.zarray", F_OK ) == 0 );
+    CHECK( access( STORE "/MODIS/Data Fields/Radiance/0.0.0", F_OK ) == 0 );
+    CHECK( access( STORE "/NoData/.zgroup", F_OK ) == 0 );
+
+    /* A store that is not empty is not written over */
+    CHECK( zarrOpenStore( STORE, 4 ) == NULL );
+
+    return bfTestResult( "zarr" );
+}
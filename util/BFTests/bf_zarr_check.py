@@ -0,0 +1,109 @@
+"""
+Reads back the Zarr store written by bf_test_zarr and compares it with the values that program wrote.
+Only the Python standard library is used, so that the check does not depend on the zarr package: the
+metadata is parsed as strict JSON and every chunk is decompressed and placed by its key.
+
+Usage: python3 bf_zarr_check.py bf_test_zarr.zarr
+"""
+import itertools
+import json
+import os
+import struct
+import sys
+import zlib
+
+failures = 0
+
+def check(cond, what):
+    global failures
+    if not cond:
+        print('check failed: ' + what)
+        failures += 1
+
+def strict(constant):
+    raise ValueError('bare ' + constant + ' in the metadata')
+
+def readArray(root, meta, key):
+    """The bytes of an array in C order, assembled from its chunks."""
+    zarray = meta[key + '/.zarray']
+    shape, chunks, dtype = zarray['shape'], zarray['chunks'], zarray['dtype']
+    if isinstance(dtype, list):
+        itemSize = sum(int(field[1][2:]) for field in dtype)
+    else:
+        itemSize = int(dtype[2:])
+    numElems = 1
+    for s in shape:
+        numElems *= s
+    chunkElems = 1
+    for c in chunks:
+        chunkElems *= c
+    out = bytearray(numElems * itemSize)
+    grid = [(s + c - 1) // c for s, c in zip(shape, chunks)]
+
+    for pos in itertools.product(*[range(g) for g in grid]):
+        name = '.'.join(map(str, pos)) if shape else '0'
+        with open(os.path.join(root, key, name), 'rb') as f:
+            raw = f.read()
+        if zarray['compressor']:
+            raw = zlib.decompress(raw)
+        check(len(raw) == chunkElems * itemSize, key + '/' + name + ' size')
+        for local in itertools.product(*[range(c) for c in chunks]):
+            index = [p * c + l for p, c, l in zip(pos, chunks, local)]
+            if any(i >= s for i, s in zip(index, shape)):
+                continue
+            src = dst = 0
+            for l, c in zip(local, chunks):
+                src = src * c + l
+            for i, s in zip(index, shape):
+                dst = dst * s + i
+            out[dst * itemSize:(dst + 1) * itemSize] = raw[src * itemSize:(src + 1) * itemSize]
+
+    return zarray, bytes(out)
+
+def main():
+    root = sys.argv[1]
+
+    # Every metadata file is strict JSON in UTF-8
+    for dirPath, dirNames, fileNames in os.walk(root):
+        for name in fileNames:
+            if name.startswith('.'):
+                with open(os.path.join(dirPath, name), encoding='utf-8') as f:
+                    json.load(f, parse_constant=strict)
+    with open(os.path.join(root, '.zmetadata'), encoding='utf-8') as f:
+        meta = json.load(f, parse_constant=strict)['metadata']
+
+    attrs = meta['MODIS/Data Fields/Radiance/.zattrs']
+    check(attrs['units'] == 'W/m^2 "sr"', 'units')
+    check(attrs['_FillValue'] == -999.0, '_FillValue')
+    check(attrs['scale'] == [0.1, 1e-300], 'scale')
+    check(attrs['special'] == ['NaN', 'Infinity', '-Infinity'], 'special')
+    check(attrs['utf8'] == 'µm café \U0001f30d bad�� x��', 'utf8')
+    check(attrs['_ARRAY_DIMENSIONS'][2] == 'Band', '_ARRAY_DIMENSIONS')
+
+    zarray, data = readArray(root, meta, 'MODIS/Data Fields/Radiance')
+    check(zarray['shape'] == [1000, 70, 9] and zarray['dtype'] == '<f4', 'Radiance shape')
+    values = struct.unpack('<%df' % (len(data) // 4), data)
+    expect = struct.unpack('<%df' % len(values), struct.pack('<%df' % len(values), *[i * 0.5 - 7.0 for i in range(len(values))]))
+    check(values == expect, 'Radiance values')
+
+    zarray, data = readArray(root, meta, 'MODIS/Data Fields/Band')
+    check(struct.unpack('<9f', data) == tuple(i * 1.5 for i in range(9)), 'Band values')
+    zarray, data = readArray(root, meta, 'MODIS/Counts')
+    check(list(struct.unpack('<35h', data)) == [i * 1000 - 17000 for i in range(35)], 'Counts values')
+    zarray, data = readArray(root, meta, 'Scalar')
+    check(zarray['shape'] == [] and struct.unpack('<q', data)[0] == -1234567890123, 'Scalar')
+    zarray, data = readArray(root, meta, 'Records')
+    records = [struct.unpack('<IQf', data[i * 16:(i + 1) * 16]) for i in range(3)]
+    check(records == [(1, 2, 3.5), (4, 5000000000, 6.25), (7, 8, -9.0)], 'Records')
+    zarray, data = readArray(root, meta, 'Names')
+    check(data == b'alphabe\0\0\0\0\0\0\0\0', 'Names')
+    check(meta['Empty/.zarray']['shape'] == [0], 'Empty')
+
+    check(meta['.zattrs'] == {'InputGranules': 'g1,g2', 'Orbit': 40110}, 'root attributes')
+    check(meta['NoData/.zgroup'] == {'zarr_format': 2}, 'empty group')
+
+    print('zarr round trip: ' + ('FAILED' if failures else 'passed'))
+    return 1 if failures else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,244 @@
+/*
+ *  This program checks the error of a BF file written with BF_KEEP_BITS against a BF file of the
+ *  same orbit written without it. Every dataset of the rounded file that carries the
+ *  _QuantizeBitRoundNumberOfSignificantBits attribute is compared with the same dataset of the
+ *  reference file. Rounding to k mantissa bits may change a value by at most 2^-(k+1) of its
+ *  magnitude, and must leave fill values, infinities and NaNs alone. The fill values are those of the
+ *  _FillValue attribute of the reference dataset, which the rounded dataset must carry unchanged.
+ *
+ *  Usage: BFBitRoundCheck [rounded.h5] [reference.h5]
+ *  Returns 0 if every rounded dataset is within its bound and keeps its fill values, 1 otherwise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hdf5.h"
+#include "hdf5_hl.h"
+
+#define KEEP_BITS_ATTR "_QuantizeBitRoundNumberOfSignificantBits"
+#define FILL_ATTR "_FillValue"
+
+typedef struct
+{
+    hid_t refFile;
+    int numChecked;
+    int numFailed;
+} checkState_t;
+
+static int checkDataset( hid_t roundedID, const char* name, int keepBits, checkState_t* state );
+
+/* Read the _FillValue attribute of a dataset as floats. Returns the number of fill values, 0 if the
+ * dataset has none, -1 on error. The values are returned in *fill, to be freed by the caller.
+ */
+static int readFillValues( hid_t dset, float** fill )
+{
+    hid_t attr = -1;
+    hid_t space = -1;
+    hssize_t num = 0;
+    htri_t exists = H5Aexists( dset, FILL_ATTR );
+
+    *fill = NULL;
+    if ( exists <= 0 )
+        return exists < 0 ? -1 : 0;
+
+    attr = H5Aopen( dset, FILL_ATTR, H5P_DEFAULT );
+    space = attr >= 0 ? H5Aget_space( attr ) : -1;
+    num = space >= 0 ? H5Sget_simple_extent_npoints( space ) : -1;
+    if ( num > 0 )
+        *fill = malloc( sizeof(float) * (size_t) num );
+    if ( num < 0 || ( num > 0 && ( *fill == NULL || H5Aread( attr, H5T_NATIVE_FLOAT, *fill ) < 0 ) ) )
+    {
+        free(*fill);
+        *fill = NULL;
+        num = -1;
+    }
+    if ( space >= 0 ) H5Sclose(space);
+    if ( attr >= 0 ) H5Aclose(attr);
+
+    return (int) num;
+}
+
+static herr_t visitObject( hid_t loc_id, const char *name, const H5O_info_t *info, void *opdata )
+{
+    checkState_t* state = opdata;
+    hid_t dset;
+    int keepBits = 0;
+
+    if ( info->type != H5O_TYPE_DATASET || H5Aexists_by_name( loc_id, name, KEEP_BITS_ATTR, H5P_DEFAULT ) <= 0 )
+        return 0;
+
+    dset = H5Dopen2( loc_id, name, H5P_DEFAULT );
+    if ( dset < 0 )
+    {
+        fprintf( stderr, "Cannot open dataset %s.\n", name );
+        state->numFailed++;
+        return 0;
+    }
+    if ( H5LTget_attribute_int( dset, ".", KEEP_BITS_ATTR, &keepBits ) < 0 || keepBits < 1 || keepBits > 23 )
+    {
+        fprintf( stderr, "Invalid %s attribute of %s.\n", KEEP_BITS_ATTR, name );
+        state->numFailed++;
+    }
+    else if ( checkDataset( dset, name, keepBits, state ) != 0 )
+        state->numFailed++;
+    state->numChecked++;
+    H5Dclose(dset);
+
+    return 0;
+}
+
+/* Compare one rounded dataset with the reference. Returns 0 if it is within its bound. */
+static int checkDataset( hid_t roundedID, const char* name, int keepBits, checkState_t* state )
+{
+    hid_t refID = -1;
+    hid_t space = -1;
+    hid_t refSpace = -1;
+    float* rounded = NULL;
+    float* ref = NULL;
+    hssize_t numElems = 0;
+    double bound = 0;
+    double maxErr = 0;
+    size_t numOver = 0;
+    hsize_t roundedSize = 0;
+    hsize_t refSize = 0;
+    float* fill = NULL;
+    float* roundedFill = NULL;
+    int numFill = 0;
+    int numRoundedFill = 0;
+    size_t numFillChanged = 0;
+    int ret = 1;
+
+    bound = ldexp( 1.0, -(keepBits + 1) );
+
+    refID = H5Dopen2( state->refFile, name, H5P_DEFAULT );
+    if ( refID < 0 )
+    {
+        fprintf( stderr, "%s is not in the reference file.\n", name );
+        return 1;
+    }
+
+    space = H5Dget_space( roundedID );
+    refSpace = H5Dget_space( refID );
+    numElems = H5Sget_simple_extent_npoints( space );
+    if ( numElems < 0 || numElems != H5Sget_simple_extent_npoints( refSpace ) )
+    {
+        fprintf( stderr, "%s has a different shape in the reference file.\n", name );
+        goto done;
+    }
+
+    numFill = readFillValues( refID, &fill );
+    numRoundedFill = readFillValues( roundedID, &roundedFill );
+    if ( numFill < 0 || numRoundedFill < 0 )
+    {
+        fprintf( stderr, "Cannot read the %s attribute of %s.\n", FILL_ATTR, name );
+        goto done;
+    }
+    if ( numFill != numRoundedFill || ( numFill && memcmp( fill, roundedFill, sizeof(float) * numFill ) != 0 ) )
+    {
+        printf( "%s: FAILED: the %s attribute differs from the reference\n", name, FILL_ATTR );
+        goto done;
+    }
+
+    rounded = malloc( sizeof(float) * (size_t) numElems );
+    ref = malloc( sizeof(float) * (size_t) numElems );
+    if ( rounded == NULL || ref == NULL )
+    {
+        fprintf( stderr, "Cannot allocate memory for %s.\n", name );
+        goto done;
+    }
+    if ( H5Dread( roundedID, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, rounded ) < 0 ||
+         H5Dread( refID, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, ref ) < 0 )
+    {
+        fprintf( stderr, "Cannot read %s.\n", name );
+        goto done;
+    }
+
+    for ( hssize_t i = 0; i < numElems; i++ )
+    {
+        double err = 0;
+        int isFill = 0;
+
+        for ( int j = 0; j < numFill && !isFill; j++ )
+            isFill = memcmp( &ref[i], &fill[j], sizeof(float) ) == 0;
+        if ( isFill )
+        {
+            if ( memcmp( &ref[i], &rounded[i], sizeof(float) ) != 0 )
+                numFillChanged++;
+            continue;
+        }
+        if ( isnan(ref[i]) || isinf(ref[i]) )
+        {
+            if ( memcmp( &ref[i], &rounded[i], sizeof(float) ) != 0 )
+                numOver++;
+            continue;
+        }
+        if ( ref[i] == rounded[i] )
+            continue;
+        err = fabs( (double) rounded[i] - (double) ref[i] ) / fabs( (double) ref[i] );
+        if ( err > maxErr )
+            maxErr = err;
+        if ( err > bound )
+            numOver++;
+    }
+
+    roundedSize = H5Dget_storage_size( roundedID );
+    refSize = H5Dget_storage_size( refID );
+    printf( "%s: %d bits, max relative error %.3g (bound %.3g), storage %llu / %llu bytes\n",
+            name, keepBits, maxErr, bound, (unsigned long long) roundedSize, (unsigned long long) refSize );
+    if ( numOver )
+        printf( "    FAILED: %zu values out of bounds or infinities and NaNs changed\n", numOver );
+    if ( numFillChanged )
+        printf( "    FAILED: %zu fill values changed\n", numFillChanged );
+    if ( !numOver && !numFillChanged )
+        ret = 0;
+
+done:
+    free(fill);
+    free(roundedFill);
+    free(rounded);
+    free(ref);
+    if ( space >= 0 ) H5Sclose(space);
+    if ( refSpace >= 0 ) H5Sclose(refSpace);
+    H5Dclose(refID);
+    return ret;
+}
+
+int main( int argc, char* argv[] )
+{
+    checkState_t state = { -1, 0, 0 };
+    hid_t roundedFile = -1;
+
+    if ( argc != 3 )
+    {
+        fprintf( stderr, "Usage: %s [rounded.h5] [reference.h5]\n", argv[0] );
+        return 1;
+    }
+
+    roundedFile = H5Fopen( argv[1], H5F_ACC_RDONLY, H5P_DEFAULT );
+    if ( roundedFile < 0 )
+    {
+        fprintf( stderr, "Cannot open HDF5 file %s\n", argv[1] );
+        return 1;
+    }
+    state.refFile = H5Fopen( argv[2], H5F_ACC_RDONLY, H5P_DEFAULT );
+    if ( state.refFile < 0 )
+    {
+        fprintf( stderr, "Cannot open HDF5 file %s\n", argv[2] );
+        H5Fclose(roundedFile);
+        return 1;
+    }
+
+    if ( H5Ovisit( roundedFile, H5_INDEX_NAME, H5_ITER_INC, visitObject, &state ) < 0 )
+    {
+        fprintf( stderr, "Cannot iterate over %s\n", argv[1] );
+        state.numFailed++;
+    }
+
+    H5Fclose(state.refFile);
+    H5Fclose(roundedFile);
+
+    printf( "%d rounded datasets checked, %d failed.\n", state.numChecked, state.numFailed );
+    return state.numFailed > 0;
+}
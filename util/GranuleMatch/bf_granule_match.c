@@ -0,0 +1,1073 @@
+/*
+ *  This program writes the canonical BF input file lists (inputN.txt) of a range of orbits in one pass,
+ *  in place of building accesslist.sqlite with metadata-input/build/fusionBuildDB and running
+ *  metadata-input/genInput/genFusionInput.sh --SQL once per orbit on compute nodes.
+ *
+ *  It reads the same inputs as fusionBuildDB: Orbit_Path_Time.txt and the lists of instrument files made
+ *  by metadata-input/build/findFiles, gzipped or not. The files are filtered and their times taken from
+ *  their names as fusionBuildDB does. Each instrument is kept in an array sorted by start time, so the
+ *  files of an orbit are found by binary search, with the rules of the queries in queries.bash:
+ *
+ *      MOPITT, CERES    -- the granule (1 day, 1 hour) overlaps the orbit
+ *      MODIS, ASTER     -- the granule starts in the orbit
+ *      MISR             -- the GRP and GP files of the orbit, and the AGP and HRLL files of its path
+ *
+ *  The files are then ordered and the missing MISR files marked as genFusionInput.sh (orderFiles) and
+ *  genFusionInput.py (MISR_miss) do, so that the lists are the same as theirs. Sorting compares bytes,
+ *  as sort does in the C locale. The verifyFiles checks of genFusionInput.sh are not repeated.
+ *
+ *  Usage: GranuleMatch [-o outDir] Orbit_Path_Time.txt[.gz] startOrbit endOrbit list[.gz] ...
+ *
+ *  The list of orbit N is written to outDir/inputN.txt, as genInputRange_SX.sh names them.
+ *  Returns 0 on success, 1 on failure.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <zlib.h>
+
+#define FATAL_MSG( ... ) \
+do { \
+    fprintf(stderr,"[%s:%d] Fatal error: ",__FILE__,__LINE__); \
+    fprintf(stderr, __VA_ARGS__); \
+    } while(0)
+#define WARN_MSG( ... ) \
+do { \
+    fprintf(stderr,"[%s:%d] Warning: ",__FILE__,__LINE__); \
+    fprintf(stderr, __VA_ARGS__); \
+    } while(0)
+
+#define LINE_LEN 4096
+
+/* Granule lengths, as in fusionBuildDB */
+#define MOP_SECONDS ( 24 * 60 * 60 )
+#define CER_SECONDS ( 60 * 60 )
+
+enum { MOP, CER, MOD, AST, MIS, MIS_ADD, NUM_GROUPS };
+
+typedef struct
+{
+    int64_t key;            // Start time, or the orbit (MIS) or path (MIS_ADD) of the file
+    size_t seq;             // Position in the lists, which is the row order of the database
+    char* path;
+    const char* fname;      // File name part of path
+} granule_t;
+
+typedef struct
+{
+    granule_t* granules;
+    size_t num;
+    size_t size;
+} granuleList_t;
+
+typedef struct
+{
+    int64_t stime;
+    int64_t etime;
+    long path;
+    int valid;
+} orbit_t;
+
+typedef struct
+{
+    orbit_t* orbits;
+    long first;
+    long num;
+} orbitList_t;
+
+/* A file of the orbit with the line orderFiles sorts it by */
+typedef struct
+{
+    const granule_t* granule;
+    char* sortLine;
+} sortEntry_t;
+
+typedef struct
+{
+    sortEntry_t* entries;
+    size_t num;
+    size_t size;
+} sortList_t;
+
+typedef struct
+{
+    const char** lines;
+    size_t num;
+    size_t size;
+} lineList_t;
+
+/* Days since 1970 of a date, without the time zone handling of mktime */
+static int64_t daysFromCivil( long y, long m, long d )
+{
+    long era, yoe, doy, doe;
+
+    y -= m <= 2;
+    era = ( y >= 0 ? y : y - 399 ) / 400;
+    yoe = y - era * 400;
+    doy = ( 153 * ( m + ( m > 2 ? -3 : 9 ) ) + 2 ) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t) era * 146097 + doe - 719468;
+}
+
+static int64_t utcSeconds( long y, long mo, long d, long h, long mi, long s )
+{
+    return daysFromCivil( y, mo, d ) * 86400 + h * 3600 + mi * 60 + s;
+}
+
+/* Reads count digits of str as a number. Returns -1 if they are not all digits. */
+static long digits( const char* str, int count )
+{
+    long val = 0;
+
+    for ( int i = 0; i < count; i++ )
+    {
+        if ( !isdigit( (unsigned char) str[i] ) )
+            return -1;
+        val = val * 10 + ( str[i] - '0' );
+    }
+    return val;
+}
+
+/* Returns the start of field n (from 0) of str split on sep, or NULL. len is set to its length. */
+static const char* field( const char* str, char sep, int n, size_t* len )
+{
+    const char* end;
+
+    for ( int i = 0; i < n; i++ )
+    {
+        str = strchr( str, sep );
+        if ( str == NULL )
+            return NULL;
+        str++;
+    }
+    end = strchr( str, sep );
+    *len = end ? (size_t) ( end - str ) : strlen( str );
+    return str;
+}
+
+static int hasField( const char* str, char sep, const char* value )
+{
+    const char* f;
+    size_t len;
+
+    for ( int i = 0; ( f = field( str, sep, i, &len ) ) != NULL; i++ )
+        if ( len == strlen(value) && strncmp( f, value, len ) == 0 )
+            return 1;
+    return 0;
+}
+
+static const char* baseName( const char* path )
+{
+    const char* slash = strrchr( path, '/' );
+
+    return slash ? slash + 1 : path;
+}
+
+/* Parses all of str (len characters) as a decimal number */
+static int parseLong( const char* str, size_t len, long* val )
+{
+    char buf[32];
+    char* end;
+
+    if ( len == 0 || len >= sizeof buf )
+        return -1;
+    memcpy( buf, str, len );
+    buf[len] = '\0';
+    *val = strtol( buf, &end, 10 );
+    return *end == '\0' ? 0 : -1;
+}
+
+static int addGranule( granuleList_t* list, int64_t key, size_t seq, const char* dir, const char* fname )
+{
+    granule_t* granule;
+
+    if ( list->num == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 1024;
+        granule_t* temp = realloc( list->granules, newSize * sizeof *temp );
+        if ( temp == NULL )
+            return -1;
+        list->granules = temp;
+        list->size = newSize;
+    }
+    granule = &list->granules[list->num];
+    granule->path = malloc( strlen(dir) + strlen(fname) + 2 );
+    if ( granule->path == NULL )
+        return -1;
+    sprintf( granule->path, "%s/%s", dir, fname );
+    granule->fname = granule->path + strlen(dir) + 1;
+    granule->key = key;
+    granule->seq = seq;
+    list->num++;
+    return 0;
+}
+
+static int insertLine( lineList_t* list, size_t pos, const char* line )
+{
+    if ( list->num == list->size )
+    {
+        size_t newSize = list->size ? 2 * list->size : 64;
+        const char** temp = realloc( list->lines, newSize * sizeof *temp );
+        if ( temp == NULL )
+            return -1;
+        list->lines = temp;
+        list->size = newSize;
+    }
+    memmove( &list->lines[pos + 1], &list->lines[pos], ( list->num - pos ) * sizeof *list->lines );
+    list->lines[pos] = line;
+    list->num++;
+    return 0;
+}
+
+static int addLine( lineList_t* list, const char* line )
+{
+    return insertLine( list, list->num, line );
+}
+
+static void stripLine( char* line )
+{
+    size_t len = strlen( line );
+    char* start = line;
+
+    while ( len > 0 && isspace( (unsigned char) line[len - 1] ) )
+        line[--len] = '\0';
+    while ( isspace( (unsigned char) *start ) )
+        start++;
+    memmove( line, start, strlen(start) + 1 );
+}
+
+/*
+                        readOrbits
+    DESCRIPTION:
+        Reads Orbit_Path_Time.txt, one "orbit path start end" line per orbit with times as
+        YYYY-MM-DDThh:mm:ssZ, into a table indexed by orbit number.
+    ARGUMENTS:
+        IN
+            const char* fileName    -- Orbit_Path_Time.txt, gzipped or not
+        OUT
+            orbitList_t* orbits     -- The orbits
+    RETURN:
+        0 on success, -1 on failure.
+*/
+static int readOrbits( const char* fileName, orbitList_t* orbits )
+{
+    gzFile in = NULL;
+    char line[LINE_LEN];
+    long size = 0;
+
+    memset( orbits, 0, sizeof *orbits );
+    in = gzopen( fileName, "rb" );
+    if ( in == NULL )
+    {
+        FATAL_MSG("Failed to open %s.\n", fileName);
+        goto cleanupFail;
+    }
+
+    while ( gzgets( in, line, sizeof line ) )
+    {
+        long orbit, path;
+        int sy, smo, sd, sh, smi, ss, ey, emo, ed, eh, emi, es;
+        orbit_t* o;
+
+        if ( sscanf( line, "%ld %ld %d-%d-%dT%d:%d:%dZ %d-%d-%dT%d:%d:%dZ", &orbit, &path,
+                     &sy, &smo, &sd, &sh, &smi, &ss, &ey, &emo, &ed, &eh, &emi, &es ) != 14 )
+            continue;
+
+        if ( orbits->num == 0 )
+            orbits->first = orbit;
+        if ( orbit < orbits->first )
+        {
+            FATAL_MSG("The orbits of %s are not in increasing order.\n", fileName);
+            goto cleanupFail;
+        }
+        if ( orbit - orbits->first >= size )
+        {
+            long newSize = 2 * ( orbit - orbits->first + 1 );
+            orbit_t* temp = realloc( orbits->orbits, newSize * sizeof *temp );
+            if ( temp == NULL )
+            {
+                FATAL_MSG("Failed to allocate memory.\n");
+                goto cleanupFail;
+            }
+            memset( temp + size, 0, ( newSize - size ) * sizeof *temp );
+            orbits->orbits = temp;
+            size = newSize;
+        }
+        o = &orbits->orbits[orbit - orbits->first];
+        o->stime = utcSeconds( sy, smo, sd, sh, smi, ss );
+        o->etime = utcSeconds( ey, emo, ed, eh, emi, es );
+        o->path = path;
+        o->valid = 1;
+        if ( orbit - orbits->first + 1 > orbits->num )
+            orbits->num = orbit - orbits->first + 1;
+    }
+    gzclose( in );
+    in = NULL;
+
+    if ( orbits->num == 0 )
+    {
+        FATAL_MSG("No orbits were found in %s.\n", fileName);
+        goto cleanupFail;
+    }
+    return 0;
+
+cleanupFail:
+    if ( in ) gzclose( in );
+    free( orbits->orbits );
+    orbits->orbits = NULL;
+    return -1;
+}
+
+static const orbit_t* findOrbit( const orbitList_t* orbits, long orbit )
+{
+    if ( orbit < orbits->first || orbit - orbits->first >= orbits->num || !orbits->orbits[orbit - orbits->first].valid )
+        return NULL;
+    return &orbits->orbits[orbit - orbits->first];
+}
+
+/* The lines fusionBuildDB discards (FILTERS, and CERES or MOPITT files in HDF4) */
+static int isDiscarded( const char* line )
+{
+    static const char* head[] = { "#", "MISBR", "CER_BDS" };
+    static const char* tail[] = { ".met", ".xml" };
+    static const char* in[] = { "MOD06", "TERRAIN" };
+    size_t len = strlen( line );
+
+    for ( size_t i = 0; i < sizeof head / sizeof *head; i++ )
+        if ( strncmp( line, head[i], strlen(head[i]) ) == 0 )
+            return 1;
+    for ( size_t i = 0; i < sizeof tail / sizeof *tail; i++ )
+        if ( len >= strlen(tail[i]) && strcmp( line + len - strlen(tail[i]), tail[i] ) == 0 )
+            return 1;
+    for ( size_t i = 0; i < sizeof in / sizeof *in; i++ )
+        if ( strstr( line, in[i] ) )
+            return 1;
+
+    /* .*CER.*(.hdf)$ and .*MOP.*(.hdf)$, ignoring case */
+    if ( len >= 7 && strncasecmp( line + len - 3, "hdf", 3 ) == 0 )
+        for ( size_t i = 0; i + 3 <= len - 4; i++ )
+            if ( strncasecmp( line + i, "CER", 3 ) == 0 || strncasecmp( line + i, "MOP", 3 ) == 0 )
+                return 1;
+    return 0;
+}
+
+/*
+                        granuleKey
+    DESCRIPTION:
+        Finds the group of a file and its key from its name, as the add functions of fusionBuildDB do.
+    ARGUMENTS:
+        IN
+            const char* fname           -- File name
+            const orbitList_t* orbits
+        OUT
+            int64_t* key                -- Start time, or the orbit of a MISR file or the path of an AGP
+                                           or HRLL file
+    RETURN:
+        The group (MOP, CER, MOD, AST, MIS or MIS_ADD), -1 if the name cannot be parsed and -2 if a MISR
+        file is for an orbit not in orbits.
+*/
+static int granuleKey( const char* fname, const orbitList_t* orbits, int64_t* key )
+{
+    const char* f;
+    size_t len;
+    long val;
+
+    if ( strstr( fname, "HRLL" ) || strstr( fname, "AGP" ) )
+    {
+        /* MISR_HRLL_P022.hdf or MISR_AM1_AGP_P022_F01_24.hdf. The path is compared as a number. */
+        int isHRLL = hasField( fname, '_', "HRLL" );
+
+        f = field( fname, '_', isHRLL ? 2 : 3, &len );
+        if ( f == NULL || len < 2 )
+            return -1;
+        if ( isHRLL && len >= 4 && strncmp( f + len - 4, ".hdf", 4 ) == 0 )
+            len -= 4;
+        if ( parseLong( f + 1, len - 1, &val ) )
+            return -1;
+        *key = val;
+        return MIS_ADD;
+    }
+
+    if ( strncmp( fname, "MOD", 3 ) == 0 )
+    {
+        /* MOD021KM.A2007184.1625.006.2014231113627.hdf */
+        const char* date = field( fname, '.', 1, &len );
+        const char* hm;
+        long y, doy, h, m;
+
+        if ( date == NULL || len != 8 || ( hm = field( fname, '.', 2, &len ) ) == NULL || len != 4 )
+            return -1;
+        y = digits( date + 1, 4 );
+        doy = digits( date + 5, 3 );
+        h = digits( hm, 2 );
+        m = digits( hm + 2, 2 );
+        if ( y < 0 || doy < 1 || doy > 366 || h < 0 || h > 23 || m < 0 || m > 59 )
+            return -1;
+        *key = ( daysFromCivil( y, 1, 1 ) + doy - 1 ) * 86400 + h * 3600 + m * 60;
+        return MOD;
+    }
+
+    if ( strncmp( fname, "AST", 3 ) == 0 )
+    {
+        /* AST_L1T_00307032007162020_20150520034221_121033.hdf: 003, then MMDDYYYYhhmmss */
+        long mo, d, y, h, mi, s;
+
+        f = field( fname, '_', 2, &len );
+        if ( f == NULL || len != 17 || strncmp( f, "003", 3 ) != 0 )
+            return -1;
+        mo = digits( f + 3, 2 );
+        d = digits( f + 5, 2 );
+        y = digits( f + 7, 4 );
+        h = digits( f + 11, 2 );
+        mi = digits( f + 13, 2 );
+        s = digits( f + 15, 2 );
+        if ( mo < 1 || mo > 12 || d < 1 || d > 31 || y < 0 || h < 0 || h > 23 || mi < 0 || mi > 59 || s < 0 || s > 61 )
+            return -1;
+        *key = utcSeconds( y, mo, d, h, mi, s );
+        return AST;
+    }
+
+    if ( strncmp( fname, "CER", 3 ) == 0 )
+    {
+        /* CER_SSF_Terra-FM1-MODIS_Edition4A_400403.2007070316 */
+        const char* date = strrchr( fname, '.' );
+        long y, mo, d, h;
+
+        if ( date == NULL || strlen( ++date ) != 10 )
+            return -1;
+        y = digits( date, 4 );
+        mo = digits( date + 4, 2 );
+        d = digits( date + 6, 2 );
+        h = digits( date + 8, 2 );
+        if ( y < 0 || mo < 1 || mo > 12 || d < 1 || d > 31 || h < 0 || h > 23 )
+            return -1;
+        *key = utcSeconds( y, mo, d, h, 0, 0 );
+        return CER;
+    }
+
+    if ( strncmp( fname, "MOP", 3 ) == 0 )
+    {
+        /* MOP01-20070703-L1V3.50.0.he5 */
+        long y, mo, d;
+
+        f = field( fname, '-', 1, &len );
+        if ( strstr( fname, ".hdf" ) || f == NULL || len != 8 )
+            return -1;
+        y = digits( f, 4 );
+        mo = digits( f + 4, 2 );
+        d = digits( f + 6, 2 );
+        if ( y < 0 || mo < 1 || mo > 12 || d < 1 || d > 31 )
+            return -1;
+        *key = utcSeconds( y, mo, d, 0, 0, 0 );
+        return MOP;
+    }
+
+    if ( strncmp( fname, "MIS", 3 ) == 0 )
+    {
+        /* MISR_AM1_GRP_ELLIPSOID_GM_P022_O040110_AA_F03_0024.hdf or MISR_AM1_GP_GMP_P022_O040110_F03_0013.hdf */
+        f = field( fname, '_', hasField( fname, '_', "GMP" ) ? 5 : 6, &len );
+        if ( f == NULL || len < 2 || parseLong( f + 1, len - 1, &val ) )
+            return -1;
+        if ( findOrbit( orbits, val ) == NULL )
+            return -2;
+        *key = val;
+        return MIS;
+    }
+
+    return -1;
+}
+
+/*
+                        readList
+    DESCRIPTION:
+        Adds the files of one list made by findFiles (one path per line, or "dir:" lines followed by file
+        names) to their groups.
+    ARGUMENTS:
+        IN
+            const char* fileName    -- The list, gzipped or not
+            const orbitList_t* orbits
+        IN/OUT
+            granuleList_t* groups   -- The files of each group
+            size_t* seq             -- Position of the next file in all lists
+    RETURN:
+        0 on success, -1 on failure.
+*/
+static int readList( const char* fileName, const orbitList_t* orbits, granuleList_t* groups, size_t* seq )
+{
+    gzFile in = NULL;
+    char line[LINE_LEN];
+    char lastDir[LINE_LEN] = "";
+    unsigned long count = 0;
+    unsigned long numSkipped = 0;
+
+    in = gzopen( fileName, "rb" );
+    if ( in == NULL )
+    {
+        FATAL_MSG("Failed to open %s.\n", fileName);
+        return -1;
+    }
+
+    while ( gzgets( in, line, sizeof line ) )
+    {
+        char* slash;
+        const char* dir = line;
+        const char* fname;
+        int64_t key;
+        int group;
+        size_t len;
+
+        count++;
+        stripLine( line );
+        len = strlen( line );
+        if ( len == 0 || isDiscarded( line ) )
+            continue;
+        if ( line[0] == '/' && line[len - 1] == ':' )
+        {
+            line[len - 1] = '\0';
+            strcpy( lastDir, line );
+            continue;
+        }
+
+        slash = strrchr( line, '/' );
+        if ( slash )
+        {
+            *slash = '\0';
+            fname = slash + 1;
+        }
+        else
+            fname = line;
+        if ( slash == NULL || slash == line )
+            dir = lastDir;
+
+        group = granuleKey( fname, orbits, &key );
+        if ( group == -2 )
+        {
+            WARN_MSG("%s:%lu: no data for the orbit of %s\n", fileName, count, fname);
+            continue;
+        }
+        if ( group < 0 )
+        {
+            numSkipped++;
+            continue;
+        }
+        if ( addGranule( &groups[group], key, ( *seq )++, dir, fname ) )
+        {
+            FATAL_MSG("Failed to allocate memory.\n");
+            gzclose( in );
+            return -1;
+        }
+    }
+    gzclose( in );
+
+    if ( numSkipped )
+        WARN_MSG("%lu lines of %s are not files of a BF instrument and were skipped.\n", numSkipped, fileName);
+    return 0;
+}
+
+static int compareGranules( const void* a, const void* b )
+{
+    const granule_t* ga = a;
+    const granule_t* gb = b;
+
+    if ( ga->key != gb->key )
+        return ga->key < gb->key ? -1 : 1;
+    return ga->seq < gb->seq ? -1 : ga->seq > gb->seq;
+}
+
+/* Index of the first granule of list with a key >= key */
+static size_t lowerBound( const granuleList_t* list, int64_t key )
+{
+    size_t lo = 0;
+    size_t hi = list->num;
+
+    while ( lo < hi )
+    {
+        size_t mid = lo + ( hi - lo ) / 2;
+
+        if ( list->granules[mid].key < key )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Start of the leftmost match in str of one of the strings in alts, preceded by lead and followed by
+   trail, which may be '\0' for none and '?' for any character. len is set to the length of the match. */
+static const char* leftmostMatch( const char* str, char lead, const char* const* alts, size_t numAlts, char trail,
+                                  size_t* len )
+{
+    for ( const char* p = str; *p; p++ )
+    {
+        const char* q = p;
+
+        if ( lead )
+        {
+            if ( *q != lead )
+                continue;
+            q++;
+        }
+        for ( size_t i = 0; i < numAlts; i++ )
+        {
+            size_t altLen = strlen( alts[i] );
+
+            if ( strncmp( q, alts[i], altLen ) != 0 )
+                continue;
+            if ( trail && q[altLen] != trail && !( trail == '?' && q[altLen] ) )
+                continue;
+            *len = ( q - p ) + altLen + ( trail ? 1 : 0 );
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* The line orderFiles sorts a file by. Each is the path prefixed with the keys the awk commands print. */
+static char* sortLine( int group, const char* path )
+{
+    static const char* cameras[] = { "AA", "AF", "AN", "BA", "BF", "CA", "CF", "DA", "DF" };
+    static const char* fms[] = { "Terra-FM1-", "Terra-FM|-", "Terra-FM2-" };
+    static const char* products[] = { "MOD021KM", "MOD02HKM", "MOD02QKM", "MOD03" };
+    char prefix[64] = "";
+    char* line;
+    const char* m;
+    size_t len = 0;
+
+    if ( group == MOP || group == AST )
+    {
+        /* sort -u -t' ' -k1,1 on "fname path": only the file name is compared */
+        line = malloc( strlen(path) + 1 );
+        if ( line )
+            strcpy( line, baseName( path ) );
+        return line;
+    }
+    if ( group == CER )
+    {
+        /* "YYYYMMDDHH Terra-FMn- path" */
+        const char* fm = leftmostMatch( path, '\0', fms, 3, '\0', &len );
+
+        snprintf( prefix, sizeof prefix, "%s %.*s ", strrchr( path, '.' ) ? strrchr( path, '.' ) + 1 : path,
+                  fm ? (int) len : 0, fm ? fm : "" );
+    }
+    else if ( group == MOD )
+    {
+        /* "AYYYYDDD.hhmm /MOD0xxxx. path", with empty keys where the path has none */
+        const char* date = NULL;
+        const char* product = leftmostMatch( path, '/', products, 4, '?', &len );
+        size_t productLen = len;
+
+        for ( m = path; *m && date == NULL; m++ )
+            if ( *m == 'A' && digits( m + 1, 7 ) >= 0 && m[8] && digits( m + 9, 4 ) >= 0 )
+                date = m;
+        snprintf( prefix, sizeof prefix, "%.*s %.*s ", date ? 13 : 0, date ? date : "",
+                  product ? (int) productLen : 0, product ? product : "" );
+    }
+    else
+    {
+        /* "_AA_ path" to "_DF_ path", "xxa path" (AGP), "xxb path" (GMP) and "xxc path" (HRLL), or the
+           path alone. Each awk command puts its key in front of the line so far. */
+        char temp[64];
+
+        m = leftmostMatch( path, '_', cameras, 9, '_', &len );
+        if ( m )
+            snprintf( prefix, sizeof prefix, "%.*s ", (int) len, m );
+        if ( strstr( path, "_AGP_" ) )
+        {
+            snprintf( temp, sizeof temp, "xxa %s", prefix );
+            strcpy( prefix, temp );
+        }
+        if ( strstr( path, "_GMP_" ) )
+        {
+            snprintf( temp, sizeof temp, "xxb %s", prefix );
+            strcpy( prefix, temp );
+        }
+        if ( strstr( path, "_HRLL_" ) )
+        {
+            snprintf( temp, sizeof temp, "xxc %s", prefix );
+            strcpy( prefix, temp );
+        }
+    }
+
+    line = malloc( strlen(prefix) + strlen(path) + 1 );
+    if ( line )
+        sprintf( line, "%s%s", prefix, path );
+    return line;
+}
+
+/* Sort lines compared as sort does. Equal lines keep their order in the database, as sort -u does. */
+static int compareSortLines( const void* a, const void* b )
+{
+    const sortEntry_t* ea = a;
+    const sortEntry_t* eb = b;
+    int cmp = strcmp( ea->sortLine, eb->sortLine );
+
+    if ( cmp )
+        return cmp;
+    return ea->granule->seq < eb->granule->seq ? -1 : ea->granule->seq > eb->granule->seq;
+}
+
+/*
+                        selectGranules
+    DESCRIPTION:
+        Adds the files of a group with keys in [from, to] that orderFiles keeps (its grep commands) to a
+        list, with the line orderFiles sorts them by.
+    ARGUMENTS:
+        IN
+            const granuleList_t* list   -- The group, sorted by key
+            int64_t from, to            -- Range of keys
+            int group                   -- The group, which decides the sort line
+        IN/OUT
+            sortList_t* out             -- The files of the orbit
+        OUT
+            size_t* numGRP              -- If not NULL, incremented by the number of GRP files in the
+                                           range, before the grep commands
+    RETURN:
+        0 on success, -1 on failure.
+*/
+static int selectGranules( const granuleList_t* list, int64_t from, int64_t to, int group, sortList_t* out,
+                           size_t* numGRP )
+{
+    size_t first = lowerBound( list, from );
+    size_t last = lowerBound( list, to + 1 );
+
+    for ( size_t i = first; i < last; i++ )
+    {
+        const granule_t* g = &list->granules[i];
+        const char* p = g->path;
+        int keep;
+
+        if ( numGRP && strstr( p, "GRP" ) )
+            ( *numGRP )++;
+
+        if ( group == MOP )
+            keep = strstr( p, "MOP" ) && strstr( strstr( p, "MOP" ), "he5" ) && !strstr( p, "xml" );
+        else if ( group == CER )
+            keep = strstr( p, "CER_SSF_Terra" ) != NULL;
+        else if ( group == MOD )
+        {
+            /* MOD0[2HKM|2QKM|21KM|3] */
+            const char* m;
+
+            keep = 0;
+            for ( m = strstr( p, "MOD0" ); m && !keep; m = strstr( m + 1, "MOD0" ) )
+                keep = m[4] && strchr( "2HKM|Q13", m[4] );
+        }
+        else if ( group == AST )
+            keep = strstr( p, "AST" ) && strstr( strstr( p, "AST" ), "hdf" );
+        else
+            keep = strstr( p, "/MISR_" ) != NULL;
+        if ( !keep )
+            continue;
+
+        if ( out->num == out->size )
+        {
+            size_t newSize = out->size ? 2 * out->size : 64;
+            sortEntry_t* temp = realloc( out->entries, newSize * sizeof *temp );
+            if ( temp == NULL )
+                return -1;
+            out->entries = temp;
+            out->size = newSize;
+        }
+        out->entries[out->num].granule = g;
+        out->entries[out->num].sortLine = sortLine( group, p );
+        if ( out->entries[out->num].sortLine == NULL )
+            return -1;
+        out->num++;
+    }
+    return 0;
+}
+
+static void clearSortList( sortList_t* list )
+{
+    for ( size_t i = 0; i < list->num; i++ )
+        free( list->entries[i].sortLine );
+    list->num = 0;
+}
+
+/*
+                        addSection
+    DESCRIPTION:
+        Sorts the files of one instrument as orderFiles does and adds their paths to lines, or naLine if
+        there are none.
+    ARGUMENTS:
+        IN/OUT
+            sortList_t* files       -- The files of the instrument. Sorted on return.
+            lineList_t* lines       -- The lines of the input file list
+        IN
+            int unique              -- Keep only the first file of each name (sort -u)
+            const char* naLine      -- "MOP N/A" and so on
+    RETURN:
+        0 on success, -1 on failure.
+*/
+static int addSection( sortList_t* files, lineList_t* lines, int unique, const char* naLine )
+{
+    if ( files->num == 0 )
+        return addLine( lines, naLine );
+
+    qsort( files->entries, files->num, sizeof *files->entries, compareSortLines );
+    for ( size_t i = 0; i < files->num; i++ )
+    {
+        if ( unique && i > 0 && strcmp( files->entries[i].sortLine, files->entries[i - 1].sortLine ) == 0 )
+            continue;
+        if ( addLine( lines, files->entries[i].granule->path ) )
+            return -1;
+    }
+    return 0;
+}
+
+/* ^AST_L1T_[0-9]+_[0-9]+_[0-9]+.hdf$ */
+static int isASTERFile( const char* fname )
+{
+    const char* p = fname;
+
+    if ( strncmp( p, "AST_L1T_", 8 ) != 0 )
+        return 0;
+    p += 8;
+    for ( int i = 0; i < 3; i++ )
+    {
+        if ( !isdigit( (unsigned char) *p ) )
+            return 0;
+        while ( isdigit( (unsigned char) *p ) )
+            p++;
+        if ( i < 2 && *p++ != '_' )
+            return 0;
+    }
+    return *p && strcmp( p + 1, "hdf" ) == 0;
+}
+
+static int isBlank( const char* line )
+{
+    if ( *line == '\0' )
+        return 0;
+    for ( ; *line; line++ )
+        if ( !isspace( (unsigned char) *line ) )
+            return 0;
+    return 1;
+}
+
+static int isComment( const char* line )
+{
+    while ( isspace( (unsigned char) *line ) )
+        line++;
+    return *line == '#';
+}
+
+/*
+                        markMissingMISR
+    DESCRIPTION:
+        Inserts a line for each MISR file missing after the ASTER files, as MISR_miss in genFusionInput.py
+        does: MISR_AM1_GRP_MISS for a camera, # MISR_AM1_AGP_MISS, MISR_AM1_GP_MISS and
+        # MISR_AM1_HRLL_MISS.
+    ARGUMENTS:
+        IN/OUT
+            lineList_t* lines       -- The lines of the input file list, without the orbit
+    RETURN:
+        0 on success, -1 on failure.
+*/
+static int markMissingMISR( lineList_t* lines )
+{
+    static const char* patterns[] = { "_AA_", "_AF_", "_AN_", "_BA_", "_BF_", "_CA_", "_CF_", "_DA_", "_DF_",
+                                      "MISR_AM1_AGP", "MISR_AM1_GP_GMP_", "MISR_HRLL_" };
+    size_t i = 0;
+    size_t n = lines->num;
+
+    /* Find the first ASTER line, then the line after the last one */
+    while ( ( ( !isASTERFile( baseName( lines->lines[i] ) ) && !strstr( lines->lines[i], "AST N/A" ) ) ||
+              isComment( lines->lines[i] ) || isBlank( lines->lines[i] ) ) && i + 2 < n )
+        i++;
+    while ( ( isASTERFile( baseName( lines->lines[i] ) ) || strstr( lines->lines[i], "AST N/A" ) ||
+              isComment( lines->lines[i] ) || isBlank( lines->lines[i] ) ) && i + 2 < n )
+        i++;
+
+    for ( size_t p = 0; p < sizeof patterns / sizeof *patterns; )
+    {
+        const char* curLine = lines->lines[i];
+
+        if ( ( isBlank( curLine ) || isComment( curLine ) ) && i + 1 < lines->num )
+        {
+            i++;
+            continue;
+        }
+        if ( isComment( curLine ) )
+            curLine = "";
+
+        if ( !strstr( baseName( curLine ), patterns[p] ) )
+        {
+            const char* miss = p <= 8 ? "MISR_AM1_GRP_MISS" : p == 9 ? "# MISR_AM1_AGP_MISS" :
+                               p == 10 ? "MISR_AM1_GP_MISS" : "# MISR_AM1_HRLL_MISS";
+            if ( insertLine( lines, i, miss ) )
+                return -1;
+        }
+        if ( i + 1 < lines->num )
+            i++;
+        p++;
+    }
+    return 0;
+}
+
+/*
+                        writeOrbit
+    DESCRIPTION:
+        Writes the input file list of one orbit.
+    ARGUMENTS:
+        IN
+            const granuleList_t* groups -- The files of each group, sorted by key
+            long orbitNum               -- The orbit
+            const orbit_t* orbit        -- Its times and path
+            const char* outDir          -- Where to write inputN.txt
+        IN/OUT
+            sortList_t* files           -- Scratch space
+            lineList_t* lines           -- Scratch space
+    RETURN:
+        0 on success, -1 on failure.
+*/
+static int writeOrbit( const granuleList_t* groups, long orbitNum, const orbit_t* orbit, const char* outDir,
+                       sortList_t* files, lineList_t* lines )
+{
+    char fileName[LINE_LEN];
+    FILE* out = NULL;
+    size_t numGRP = 0;
+
+    lines->num = 0;
+
+    if ( selectGranules( &groups[MOP], orbit->stime - MOP_SECONDS, orbit->etime, MOP, files, NULL ) ||
+         addSection( files, lines, 1, "MOP N/A" ) )
+        goto cleanupFail;
+    clearSortList( files );
+    if ( selectGranules( &groups[CER], orbit->stime - CER_SECONDS, orbit->etime, CER, files, NULL ) ||
+         addSection( files, lines, 0, "CER N/A" ) )
+        goto cleanupFail;
+    clearSortList( files );
+    if ( selectGranules( &groups[MOD], orbit->stime, orbit->etime, MOD, files, NULL ) ||
+         addSection( files, lines, 0, "MOD N/A" ) )
+        goto cleanupFail;
+    clearSortList( files );
+    if ( selectGranules( &groups[AST], orbit->stime, orbit->etime, AST, files, NULL ) ||
+         addSection( files, lines, 1, "AST N/A" ) )
+        goto cleanupFail;
+    clearSortList( files );
+
+    /* The MISR files of the orbit, then the AGP and HRLL files of its path (UNION ALL) */
+    if ( selectGranules( &groups[MIS], orbitNum, orbitNum, MIS, files, &numGRP ) ||
+         selectGranules( &groups[MIS_ADD], orbit->path, orbit->path, MIS_ADD, files, &numGRP ) )
+        goto cleanupFail;
+    if ( numGRP == 0 )
+        clearSortList( files );
+    if ( addSection( files, lines, 0, "MIS N/A" ) )
+        goto cleanupFail;
+    if ( numGRP && markMissingMISR( lines ) )
+        goto cleanupFail;
+    clearSortList( files );
+
+    snprintf( fileName, sizeof fileName, "%s/input%ld.txt", outDir, orbitNum );
+    out = fopen( fileName, "w" );
+    if ( out == NULL )
+    {
+        FATAL_MSG("Failed to open %s for writing.\n", fileName);
+        goto cleanupFail;
+    }
+    fprintf( out, "%ld\n", orbitNum );
+    for ( size_t i = 0; i < lines->num; i++ )
+        fprintf( out, "%s\n", lines->lines[i] );
+    if ( fclose( out ) != 0 )
+    {
+        out = NULL;
+        FATAL_MSG("Failed to write %s.\n", fileName);
+        goto cleanupFail;
+    }
+    return 0;
+
+cleanupFail:
+    if ( out ) fclose( out );
+    clearSortList( files );
+    return -1;
+}
+
+int main( int argc, char* argv[] )
+{
+    const char* outDir = ".";
+    orbitList_t orbits = { 0 };
+    granuleList_t groups[NUM_GROUPS];
+    sortList_t files = { 0 };
+    lineList_t lines = { 0 };
+    long startOrbit, endOrbit;
+    long numWritten = 0;
+    size_t seq = 0;
+    char* end;
+    int argi = 1;
+    int fail = 0;
+
+    memset( groups, 0, sizeof groups );
+
+    if ( argc > 2 && strcmp( argv[1], "-o" ) == 0 )
+    {
+        outDir = argv[2];
+        argi = 3;
+    }
+    if ( argc - argi < 4 )
+    {
+        fprintf( stderr, "Usage: %s [-o outDir] Orbit_Path_Time.txt[.gz] startOrbit endOrbit list[.gz] ...\n",
+                 argv[0] );
+        return 1;
+    }
+
+    startOrbit = strtol( argv[argi + 1], &end, 10 );
+    if ( *end != '\0' )
+    {
+        FATAL_MSG("Invalid start orbit %s.\n", argv[argi + 1]);
+        return 1;
+    }
+    endOrbit = strtol( argv[argi + 2], &end, 10 );
+    if ( *end != '\0' || endOrbit < startOrbit )
+    {
+        FATAL_MSG("Invalid end orbit %s.\n", argv[argi + 2]);
+        return 1;
+    }
+
+    if ( readOrbits( argv[argi], &orbits ) )
+        goto cleanupFail;
+    for ( int i = argi + 3; i < argc; i++ )
+        if ( readList( argv[i], &orbits, groups, &seq ) )
+            goto cleanupFail;
+    for ( int g = 0; g < NUM_GROUPS; g++ )
+        qsort( groups[g].granules, groups[g].num, sizeof *groups[g].granules, compareGranules );
+
+    for ( long o = startOrbit; o <= endOrbit; o++ )
+    {
+        const orbit_t* orbit = findOrbit( &orbits, o );
+
+        if ( orbit == NULL )
+        {
+            WARN_MSG("Orbit %ld is not in %s and was skipped.\n", o, argv[argi]);
+            continue;
+        }
+        if ( writeOrbit( groups, o, orbit, outDir, &files, &lines ) )
+            goto cleanupFail;
+        numWritten++;
+    }
+    printf( "Wrote %ld input file lists to %s.\n", numWritten, outDir );
+
+    if ( 0 )
+    {
+cleanupFail:
+        fail = 1;
+    }
+
+    for ( int g = 0; g < NUM_GROUPS; g++ )
+    {
+        for ( size_t i = 0; i < groups[g].num; i++ )
+            free( groups[g].granules[i].path );
+        free( groups[g].granules );
+    }
+    clearSortList( &files );
+    free( files.entries );
+    free( lines.lines );
+    free( orbits.orbits );
+
+    return fail;
+}
@@ -0,0 +1,309 @@
+/*
+ *  Query API for the spatial index of BF files. See bf_spatial_query.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hdf5.h"
+#include "bf_spatial_query.h"
+
+/* A row of an index table, as written by the converter */
+typedef struct
+{
+    uint32_t rowStart;
+    uint32_t rowCount;
+    float latMin;
+    float latMax;
+    float lonMin;
+    float lonMax;
+} indexRow_t;
+
+typedef struct
+{
+    const char* instrument;
+    double latMin;
+    double latMax;
+    double lonMin;
+    double lonMax;
+    hid_t rowType;
+    BFspatialHit_t* hits;
+    size_t numHits;
+    size_t size;
+    int fail;
+} queryState_t;
+
+/* Split a longitude range crossing the antimeridian in two. Returns the number of ranges. */
+static int splitLonRange( double lonMin, double lonMax, double ranges[2][2] )
+{
+    if ( lonMin <= lonMax )
+    {
+        ranges[0][0] = lonMin;
+        ranges[0][1] = lonMax;
+        return 1;
+    }
+    ranges[0][0] = lonMin;
+    ranges[0][1] = 180.0;
+    ranges[1][0] = -180.0;
+    ranges[1][1] = lonMax;
+    return 2;
+}
+
+static int boxOverlaps( const queryState_t* state, double latMin, double latMax, double lonMin, double lonMax )
+{
+    double a[2][2];
+    double b[2][2];
+    int na = 0;
+    int nb = 0;
+
+    if ( latMax < state->latMin || latMin > state->latMax )
+        return 0;
+
+    na = splitLonRange( state->lonMin, state->lonMax, a );
+    nb = splitLonRange( lonMin, lonMax, b );
+    for ( int i = 0; i < na; i++ )
+        for ( int j = 0; j < nb; j++ )
+            if ( a[i][0] <= b[j][1] && b[j][0] <= a[i][1] )
+                return 1;
+
+    return 0;
+}
+
+/* Read a fixed-length string attribute. Returns NULL on failure. */
+static char* readStringAttr( hid_t objectID, const char* name )
+{
+    hid_t attr = H5Aopen( objectID, name, H5P_DEFAULT );
+    hid_t type = -1;
+    char* value = NULL;
+    size_t size = 0;
+
+    if ( attr < 0 )
+        return NULL;
+    type = H5Aget_type( attr );
+    if ( type >= 0 && H5Tget_class( type ) == H5T_STRING && !H5Tis_variable_str( type ) )
+    {
+        size = H5Tget_size( type );
+        value = calloc( size + 1, 1 );
+        if ( value && H5Aread( attr, type, value ) < 0 )
+        {
+            free(value);
+            value = NULL;
+        }
+    }
+    if ( type >= 0 ) H5Tclose(type);
+    H5Aclose(attr);
+
+    return value;
+}
+
+static int addHit( queryState_t* state, const char* instrument, const char* latPath, const char* lonPath,
+                   const indexRow_t* row )
+{
+    BFspatialHit_t* hit = NULL;
+
+    if ( state->numHits == state->size )
+    {
+        size_t newSize = state->size ? 2 * state->size : 16;
+        BFspatialHit_t* temp = realloc( state->hits, newSize * sizeof *temp );
+        if ( temp == NULL )
+            return -1;
+        state->hits = temp;
+        state->size = newSize;
+    }
+
+    hit = &state->hits[state->numHits];
+    memset( hit, 0, sizeof *hit );
+    strncpy( hit->instrument, instrument, sizeof hit->instrument - 1 );
+    hit->latitude = malloc( strlen(latPath) + 1 );
+    hit->longitude = malloc( strlen(lonPath) + 1 );
+    if ( hit->latitude == NULL || hit->longitude == NULL )
+    {
+        free(hit->latitude);
+        free(hit->longitude);
+        return -1;
+    }
+    strcpy( hit->latitude, latPath );
+    strcpy( hit->longitude, lonPath );
+    hit->rowStart = row->rowStart;
+    hit->rowCount = row->rowCount;
+    hit->latMin = row->latMin;
+    hit->latMax = row->latMax;
+    hit->lonMin = row->lonMin;
+    hit->lonMax = row->lonMax;
+    state->numHits++;
+
+    return 0;
+}
+
+/* Check the extent of one table, then its rows */
+static int queryTable( hid_t groupID, const char* instrument, const char* name, queryState_t* state )
+{
+    hid_t table = -1;
+    hid_t space = -1;
+    hsize_t numRows = 0;
+    float extent[4];
+    indexRow_t* rows = NULL;
+    char* latPath = NULL;
+    char* lonPath = NULL;
+    hid_t attr = -1;
+    int retVal = -1;
+
+    table = H5Dopen2( groupID, name, H5P_DEFAULT );
+    if ( table < 0 )
+        goto done;
+
+    attr = H5Aopen( table, "extent", H5P_DEFAULT );
+    if ( attr < 0 || H5Aread( attr, H5T_NATIVE_FLOAT, extent ) < 0 )
+        goto done;
+    if ( !boxOverlaps( state, extent[0], extent[1], extent[2], extent[3] ) )
+    {
+        retVal = 0;
+        goto done;
+    }
+
+    latPath = readStringAttr( table, "latitude" );
+    lonPath = readStringAttr( table, "longitude" );
+    space = H5Dget_space( table );
+    if ( latPath == NULL || lonPath == NULL || space < 0 || H5Sget_simple_extent_dims( space, &numRows, NULL ) != 1 )
+        goto done;
+    rows = malloc( numRows * sizeof *rows );
+    if ( rows == NULL || H5Dread( table, state->rowType, H5S_ALL, H5S_ALL, H5P_DEFAULT, rows ) < 0 )
+        goto done;
+
+    for ( hsize_t i = 0; i < numRows; i++ )
+        if ( boxOverlaps( state, rows[i].latMin, rows[i].latMax, rows[i].lonMin, rows[i].lonMax ) &&
+             addHit( state, instrument, latPath, lonPath, &rows[i] ) != 0 )
+            goto done;
+    retVal = 0;
+
+done:
+    if ( retVal != 0 )
+        fprintf( stderr, "Failed to read the spatial index table %s/%s.\n", instrument, name );
+    if ( attr >= 0 ) H5Aclose(attr);
+    if ( space >= 0 ) H5Sclose(space);
+    if ( table >= 0 ) H5Dclose(table);
+    free(rows);
+    free(latPath);
+    free(lonPath);
+
+    return retVal;
+}
+
+static herr_t visitTable( hid_t groupID, const char* name, const H5L_info_t* info, void* opdata )
+{
+    queryState_t* state = opdata;
+    char instrument[16] = {0};
+    ssize_t len = H5Iget_name( groupID, NULL, 0 );
+    char* path = len > 0 ? malloc( len + 1 ) : NULL;
+
+    (void) info;
+    if ( path == NULL || H5Iget_name( groupID, path, len + 1 ) < 0 )
+    {
+        free(path);
+        state->fail = 1;
+        return -1;
+    }
+    strncpy( instrument, strrchr( path, '/' ) + 1, sizeof instrument - 1 );
+    free(path);
+
+    if ( queryTable( groupID, instrument, name, state ) != 0 )
+    {
+        state->fail = 1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static herr_t visitInstrument( hid_t indexID, const char* name, const H5L_info_t* info, void* opdata )
+{
+    queryState_t* state = opdata;
+    hid_t groupID = -1;
+    herr_t status = 0;
+
+    (void) info;
+    if ( state->instrument && strcmp( state->instrument, name ) != 0 )
+        return 0;
+
+    groupID = H5Gopen2( indexID, name, H5P_DEFAULT );
+    if ( groupID < 0 )
+    {
+        state->fail = 1;
+        return -1;
+    }
+    status = H5Literate( groupID, H5_INDEX_NAME, H5_ITER_INC, NULL, visitTable, state );
+    H5Gclose(groupID);
+
+    return status < 0 ? -1 : 0;
+}
+
+int BFspatialQuery( hid_t fileID, const char* instrument, double latMin, double latMax, double lonMin, double lonMax,
+                    BFspatialHit_t** hits, size_t* numHits )
+{
+    queryState_t state;
+    hid_t indexID = -1;
+    htri_t exists = 0;
+
+    memset( &state, 0, sizeof state );
+    state.instrument = instrument;
+    state.latMin = latMin;
+    state.latMax = latMax;
+    state.lonMin = lonMin;
+    state.lonMax = lonMax;
+    *hits = NULL;
+    *numHits = 0;
+
+    exists = H5Lexists( fileID, BF_SPATIAL_INDEX_GROUP, H5P_DEFAULT );
+    if ( exists < 0 )
+        return -1;
+    if ( exists == 0 )
+        return 1;
+
+    state.rowType = H5Tcreate( H5T_COMPOUND, sizeof(indexRow_t) );
+    if ( state.rowType < 0 ||
+         H5Tinsert( state.rowType, "row_start", HOFFSET(indexRow_t, rowStart), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( state.rowType, "row_count", HOFFSET(indexRow_t, rowCount), H5T_NATIVE_UINT32 ) < 0 ||
+         H5Tinsert( state.rowType, "lat_min", HOFFSET(indexRow_t, latMin), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( state.rowType, "lat_max", HOFFSET(indexRow_t, latMax), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( state.rowType, "lon_min", HOFFSET(indexRow_t, lonMin), H5T_NATIVE_FLOAT ) < 0 ||
+         H5Tinsert( state.rowType, "lon_max", HOFFSET(indexRow_t, lonMax), H5T_NATIVE_FLOAT ) < 0 )
+    {
+        if ( state.rowType >= 0 ) H5Tclose(state.rowType);
+        return -1;
+    }
+
+    indexID = H5Gopen2( fileID, BF_SPATIAL_INDEX_GROUP, H5P_DEFAULT );
+    if ( indexID < 0 || H5Literate( indexID, H5_INDEX_NAME, H5_ITER_INC, NULL, visitInstrument, &state ) < 0 )
+        state.fail = 1;
+    if ( indexID >= 0 ) H5Gclose(indexID);
+    H5Tclose(state.rowType);
+
+    if ( state.fail )
+    {
+        BFspatialFreeHits( state.hits, state.numHits );
+        return -1;
+    }
+
+    *hits = state.hits;
+    *numHits = state.numHits;
+    return 0;
+}
+
+int BFspatialQueryPoint( hid_t fileID, const char* instrument, double lat, double lon, BFspatialHit_t** hits,
+                         size_t* numHits )
+{
+    if ( lon >= 180.0 )
+        lon -= 360.0;
+    return BFspatialQuery( fileID, instrument, lat, lat, lon, lon, hits, numHits );
+}
+
+void BFspatialFreeHits( BFspatialHit_t* hits, size_t numHits )
+{
+    for ( size_t i = 0; i < numHits; i++ )
+    {
+        free(hits[i].latitude);
+        free(hits[i].longitude);
+    }
+    free(hits);
+}
@@ -0,0 +1,51 @@
+/*
+ *  Query API for the spatial index of BF files.
+ *
+ *  The converter stores the bounding boxes of the geolocation of every instrument in the group
+ *  /BF_SpatialIndex. /BF_SpatialIndex/<instrument> holds one table per geolocation dataset pair,
+ *  named after the path of the latitude dataset with '.' for '/'. Each row of a table is the box
+ *  of a run of rows of the geolocation (the slowest dimension): a MODIS scan, a MISR SOM block, a
+ *  CERES footprint run, a MOPITT track segment, or a whole ASTER granule or subsystem. The table
+ *  carries the paths of the datasets in its "latitude" and "longitude" attributes and the box of
+ *  all its rows in its "extent" attribute (latMin, latMax, lonMin, lonMax).
+ *
+ *  Longitudes run from -180 to 180. A box with lonMin > lonMax crosses the antimeridian. Boxes are
+ *  conservative, so a hit means the rows may hold the point, and a miss means they do not.
+ */
+
+#ifndef BF_SPATIAL_QUERY_H
+#define BF_SPATIAL_QUERY_H
+
+#include <stddef.h>
+#include "hdf5.h"
+
+#define BF_SPATIAL_INDEX_GROUP "BF_SpatialIndex"
+
+typedef struct
+{
+    char instrument[16];
+    char* latitude;             /* Path of the latitude dataset */
+    char* longitude;            /* Path of the longitude dataset */
+    unsigned int rowStart;      /* First row of the box in the geolocation datasets */
+    unsigned int rowCount;
+    float latMin;
+    float latMax;
+    float lonMin;
+    float lonMax;
+} BFspatialHit_t;
+
+/* Find the boxes overlapping a lat/lon box. instrument is MOPITT, CERES, MODIS, ASTER, MISR or NULL
+ * for all of them. lonMin > lonMax selects a box crossing the antimeridian. The hits are allocated and
+ * must be released with BFspatialFreeHits.
+ * Returns 0 on success, 1 if the file has no spatial index, -1 on failure.
+ */
+int BFspatialQuery( hid_t fileID, const char* instrument, double latMin, double latMax, double lonMin, double lonMax,
+                    BFspatialHit_t** hits, size_t* numHits );
+
+/* Find the boxes holding a point. Same as BFspatialQuery with an empty box. */
+int BFspatialQueryPoint( hid_t fileID, const char* instrument, double lat, double lon, BFspatialHit_t** hits,
+                         size_t* numHits );
+
+void BFspatialFreeHits( BFspatialHit_t* hits, size_t numHits );
+
+#endif
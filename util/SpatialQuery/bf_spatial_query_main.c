@@ -0,0 +1,61 @@
+/*
+ *  This program lists the geolocation rows of a BF file that may hold a point or overlap a box,
+ *  using the spatial index of the file instead of its geolocation.
+ *
+ *  Usage: BFSpatialQuery [file.h5] [lat] [lon] [instrument]
+ *         BFSpatialQuery [file.h5] [latMin] [latMax] [lonMin] [lonMax] [instrument]
+ *  The instrument (MOPITT, CERES, MODIS, ASTER or MISR) is optional.
+ *  Returns 0 if anything was found, 1 if nothing was found, 2 on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hdf5.h"
+#include "bf_spatial_query.h"
+
+int main( int argc, char* argv[] )
+{
+    hid_t fileID = -1;
+    BFspatialHit_t* hits = NULL;
+    size_t numHits = 0;
+    int status = 0;
+
+    if ( argc < 4 || argc > 7 )
+    {
+        fprintf( stderr, "Usage: %s [file.h5] [lat] [lon] [instrument]\n", argv[0] );
+        fprintf( stderr, "       %s [file.h5] [latMin] [latMax] [lonMin] [lonMax] [instrument]\n", argv[0] );
+        return 2;
+    }
+
+    fileID = H5Fopen( argv[1], H5F_ACC_RDONLY, H5P_DEFAULT );
+    if ( fileID < 0 )
+    {
+        fprintf( stderr, "Cannot open %s.\n", argv[1] );
+        return 2;
+    }
+
+    if ( argc <= 5 )
+        status = BFspatialQueryPoint( fileID, argc == 5 ? argv[4] : NULL, atof(argv[2]), atof(argv[3]), &hits, &numHits );
+    else
+        status = BFspatialQuery( fileID, argc == 7 ? argv[6] : NULL, atof(argv[2]), atof(argv[3]), atof(argv[4]),
+                                 atof(argv[5]), &hits, &numHits );
+    H5Fclose(fileID);
+
+    if ( status == 1 )
+    {
+        fprintf( stderr, "%s has no spatial index.\n", argv[1] );
+        return 2;
+    }
+    if ( status != 0 )
+    {
+        fprintf( stderr, "Failed to query the spatial index of %s.\n", argv[1] );
+        return 2;
+    }
+
+    for ( size_t i = 0; i < numHits; i++ )
+        printf( "%s %s rows %u-%u lat %g:%g lon %g:%g\n", hits[i].instrument, hits[i].latitude, hits[i].rowStart,
+                hits[i].rowStart + hits[i].rowCount - 1, hits[i].latMin, hits[i].latMax, hits[i].lonMin, hits[i].lonMax );
+    BFspatialFreeHits( hits, numHits );
+
+    return numHits > 0 ? 0 : 1;
+}
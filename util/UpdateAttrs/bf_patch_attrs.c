@@ -0,0 +1,565 @@
+/*
+ *  This program sets string attributes of existing BF files from a rules file, in place of writing a
+ *  program for each fix (h5_cha_attr.c) and running it on one file after another (chg_attr.py).
+ *
+ *  Each line of the rules file is
+ *
+ *      objectGlob  attribute  value
+ *
+ *  objectGlob is matched against the absolute path of every group and dataset with fnmatch, where '*'
+ *  does not cross a '/'. The value is the rest of the line, which may be put in double quotes to keep
+ *  leading or trailing spaces. Lines that are empty or start with '#' are ignored. aster_units.rules has
+ *  the fix of h5_cha_attr.c as an example. Only object headers are rewritten: dataset data is neither read
+ *  nor moved, and an attribute that already has the value is left alone, so running the rules again
+ *  changes nothing.
+ *
+ *  Usage: BFPatchAttrs [-n] [-j procs] [-f inputFiles.txt] rules.txt [file.h5 ...]
+ *
+ *  -n prints the plan without opening the files for writing. With -j, that many files are patched at
+ *  once, each in its own process. The files are given as arguments or, one per line, in the file of -f.
+ *  Returns 0 on success, 1 if a rule matched nothing in some file and 2 if any file could not be patched.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "hdf5.h"
+#include "hdf5_hl.h"
+
+#define STR_LEN 4096
+
+typedef struct
+{
+    char* glob;
+    char* attr;
+    char* value;
+    int line;
+} rule_t;
+
+typedef struct
+{
+    rule_t* rules;
+    size_t numRules;
+    char** paths;               // Objects matched by any rule, in visiting order
+    size_t numPaths;
+    size_t sizePaths;
+} patchState_t;
+
+int getNextLine( char* string, FILE* const inputFile );
+
+static char* copyString( const char* start, size_t len )
+{
+    char* s = malloc( len + 1 );
+    if ( s )
+    {
+        memcpy( s, start, len );
+        s[len] = '\0';
+    }
+    return s;
+}
+
+/* Split "glob attr value" into the fields of rule. Returns 0 on success, -1 if the line is malformed. */
+static int parseRule( char* line, rule_t* rule )
+{
+    char* field[2];
+    char* p = line;
+    size_t len;
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        while ( isspace( (unsigned char) *p ) ) p++;
+        field[i] = p;
+        while ( *p && !isspace( (unsigned char) *p ) ) p++;
+        if ( p == field[i] || *p == '\0' )
+            return -1;
+        *p++ = '\0';
+    }
+    while ( isspace( (unsigned char) *p ) ) p++;
+    len = strlen( p );
+    while ( len && isspace( (unsigned char) p[len-1] ) ) len--;
+    if ( len >= 2 && p[0] == '"' && p[len-1] == '"' )
+    {
+        p++;
+        len -= 2;
+    }
+    if ( field[0][0] != '/' )
+        return -1;
+
+    rule->glob = copyString( field[0], strlen(field[0]) );
+    rule->attr = copyString( field[1], strlen(field[1]) );
+    rule->value = copyString( p, len );
+    return rule->glob && rule->attr && rule->value ? 0 : -1;
+}
+
+static void freeRules( rule_t* rules, size_t numRules )
+{
+    for ( size_t i = 0; i < numRules; i++ )
+    {
+        free(rules[i].glob);
+        free(rules[i].attr);
+        free(rules[i].value);
+    }
+    free(rules);
+}
+
+/* Read the rules file. Returns the number of rules, or -1 on failure. */
+static long readRules( const char* fileName, rule_t** rules )
+{
+    FILE* rulesFile = fopen( fileName, "r" );
+    char line[STR_LEN];
+    size_t num = 0;
+    size_t size = 0;
+    int lineNum = 0;
+    int fail = 0;
+
+    *rules = NULL;
+    if ( rulesFile == NULL )
+    {
+        fprintf( stderr, "Cannot open the rules file %s.\n", fileName );
+        return -1;
+    }
+
+    while ( fgets( line, sizeof line, rulesFile ) )
+    {
+        char* p = line;
+
+        lineNum++;
+        while ( isspace( (unsigned char) *p ) ) p++;
+        if ( *p == '\0' || *p == '#' )
+            continue;
+        if ( num == size )
+        {
+            rule_t* temp = realloc( *rules, ( size = size ? 2 * size : 16 ) * sizeof(rule_t) );
+            if ( temp == NULL )
+            {
+                fprintf( stderr, "Cannot allocate memory.\n" );
+                fail = 1;
+                break;
+            }
+            *rules = temp;
+        }
+        memset( &(*rules)[num], 0, sizeof(rule_t) );
+        (*rules)[num].line = lineNum;
+        if ( parseRule( p, &(*rules)[num++] ) < 0 )
+        {
+            fprintf( stderr, "%s:%d: expected \"/objectGlob attribute value\".\n", fileName, lineNum );
+            fail = 1;
+            break;
+        }
+    }
+
+    fclose( rulesFile );
+    if ( !fail && num == 0 )
+    {
+        fprintf( stderr, "%s has no rules.\n", fileName );
+        fail = 1;
+    }
+    if ( fail )
+    {
+        freeRules( *rules, num );
+        *rules = NULL;
+        return -1;
+    }
+    return (long) num;
+}
+
+/* H5Ovisit operator: keep the absolute path of every object some rule matches */
+static herr_t collectObject( hid_t objID, const char* name, const H5O_info_t* info, void* opData )
+{
+    patchState_t* state = opData;
+    char* path;
+
+    (void) objID;
+    if ( info->type != H5O_TYPE_GROUP && info->type != H5O_TYPE_DATASET )
+        return 0;
+
+    path = malloc( strlen(name) + 2 );
+    if ( path == NULL )
+        return -1;
+    if ( strcmp( name, "." ) == 0 )
+        strcpy( path, "/" );
+    else
+        sprintf( path, "/%s", name );
+
+    for ( size_t i = 0; i < state->numRules; i++ )
+    {
+        if ( fnmatch( state->rules[i].glob, path, FNM_PATHNAME ) != 0 )
+            continue;
+        if ( state->numPaths == state->sizePaths )
+        {
+            char** temp = realloc( state->paths, ( state->sizePaths = state->sizePaths ? 2 * state->sizePaths : 64 )
+                                                 * sizeof(char*) );
+            if ( temp == NULL )
+                break;
+            state->paths = temp;
+        }
+        state->paths[state->numPaths++] = path;
+        return 0;
+    }
+
+    free(path);
+    return 0;
+}
+
+/* Read a string attribute into a new string. Returns NULL if it is not a string or cannot be read. */
+static char* readStringAttr( hid_t objID, const char* attrName )
+{
+    hid_t attrID = H5Aopen( objID, attrName, H5P_DEFAULT );
+    hid_t typeID = attrID >= 0 ? H5Aget_type( attrID ) : -1;
+    hid_t memType = -1;
+    hid_t spaceID = attrID >= 0 ? H5Aget_space( attrID ) : -1;
+    char* value = NULL;
+
+    if ( typeID < 0 || spaceID < 0 || H5Tget_class( typeID ) != H5T_STRING ||
+         H5Sget_simple_extent_npoints( spaceID ) != 1 )
+        goto done;
+
+    if ( H5Tis_variable_str( typeID ) > 0 )
+    {
+        char* vlen = NULL;
+
+        memType = H5Tcopy( H5T_C_S1 );
+        if ( H5Tset_size( memType, H5T_VARIABLE ) >= 0 && H5Aread( attrID, memType, &vlen ) >= 0 && vlen )
+        {
+            value = copyString( vlen, strlen(vlen) );
+            H5Dvlen_reclaim( memType, spaceID, H5P_DEFAULT, &vlen );
+        }
+    }
+    else
+    {
+        size_t size = H5Tget_size( typeID );
+
+        memType = H5Tcopy( typeID );
+        value = calloc( size + 1, 1 );
+        if ( value && H5Aread( attrID, memType, value ) < 0 )
+        {
+            free(value);
+            value = NULL;
+        }
+    }
+
+done:
+    if ( memType >= 0 ) H5Tclose(memType);
+    if ( spaceID >= 0 ) H5Sclose(spaceID);
+    if ( typeID >= 0 ) H5Tclose(typeID);
+    if ( attrID >= 0 ) H5Aclose(attrID);
+    return value;
+}
+
+/* Apply the rules to one file and print its plan or report. Returns as main does for one file. */
+static int patchFile( const char* fileName, rule_t* rules, size_t numRules, int dryRun, FILE* out )
+{
+    patchState_t state;
+    unsigned long* numMatched = calloc( numRules, sizeof(unsigned long) );
+    unsigned long numSet = 0;
+    unsigned long numSame = 0;
+    unsigned long numErrors = 0;
+    int ret = 0;
+    hid_t fileID = -1;
+
+    memset( &state, 0, sizeof state );
+    state.rules = rules;
+    state.numRules = numRules;
+
+    fileID = H5Fopen( fileName, dryRun ? H5F_ACC_RDONLY : H5F_ACC_RDWR, H5P_DEFAULT );
+    if ( fileID < 0 || numMatched == NULL )
+    {
+        fprintf( out, "%s: cannot be opened%s\n", fileName, dryRun ? "" : " for writing" );
+        fflush( out );
+        free(numMatched);
+        if ( fileID >= 0 ) H5Fclose(fileID);
+        return 2;
+    }
+
+    /* The objects are collected first since attributes must not be changed while the file is visited */
+    if ( H5Ovisit( fileID, H5_INDEX_NAME, H5_ITER_INC, collectObject, &state ) < 0 )
+    {
+        fprintf( out, "%s: cannot be listed\n", fileName );
+        numErrors++;
+    }
+
+    for ( size_t i = 0; i < state.numPaths; i++ )
+    {
+        hid_t objID = H5Oopen( fileID, state.paths[i], H5P_DEFAULT );
+
+        if ( objID < 0 )
+        {
+            fprintf( out, "%s: %s cannot be opened\n", fileName, state.paths[i] );
+            numErrors++;
+            continue;
+        }
+
+        for ( size_t r = 0; r < numRules; r++ )
+        {
+            htri_t exists;
+            char* old = NULL;
+
+            if ( fnmatch( rules[r].glob, state.paths[i], FNM_PATHNAME ) != 0 )
+                continue;
+            numMatched[r]++;
+
+            exists = H5Aexists( objID, rules[r].attr );
+            if ( exists > 0 )
+                old = readStringAttr( objID, rules[r].attr );
+            if ( old && strcmp( old, rules[r].value ) == 0 )
+            {
+                numSame++;
+                free(old);
+                continue;
+            }
+
+            if ( dryRun )
+                fprintf( out, "%s: %s %s: %s \"%s\"\n", fileName, state.paths[i], rules[r].attr,
+                         exists > 0 ? "would replace" : "would add", rules[r].value );
+            /* H5LTset_attribute_string replaces an existing attribute of any type */
+            else if ( H5LTset_attribute_string( objID, ".", rules[r].attr, rules[r].value ) < 0 )
+            {
+                fprintf( out, "%s: %s %s: cannot be set\n", fileName, state.paths[i], rules[r].attr );
+                numErrors++;
+                free(old);
+                continue;
+            }
+            numSet++;
+            free(old);
+        }
+        H5Oclose(objID);
+    }
+
+    for ( size_t r = 0; r < numRules; r++ )
+    {
+        if ( numMatched[r] == 0 )
+        {
+            fprintf( out, "%s: rule %d (%s %s) matches no object\n", fileName, rules[r].line, rules[r].glob,
+                     rules[r].attr );
+            if ( ret < 1 ) ret = 1;
+        }
+    }
+
+    if ( H5Fclose( fileID ) < 0 )
+    {
+        fprintf( out, "%s: cannot be closed\n", fileName );
+        numErrors++;
+    }
+    if ( numErrors )
+        ret = 2;
+
+    fprintf( out, "%s: %s, %lu attributes %s, %lu unchanged\n", fileName, ret == 2 ? "FAILED" : "OK", numSet,
+             dryRun ? "to set" : "set", numSame );
+    fflush( out );
+
+    for ( size_t i = 0; i < state.numPaths; i++ )
+        free(state.paths[i]);
+    free(state.paths);
+    free(numMatched);
+    return ret;
+}
+
+/* Add the files listed in listName to files. Returns 0 on success, -1 on failure. */
+static int readFileList( const char* listName, char*** files, int* numFiles )
+{
+    FILE* listFile = fopen( listName, "r" );
+    char line[STR_LEN];
+    int status;
+    int size = *numFiles;
+
+    if ( listFile == NULL )
+    {
+        fprintf( stderr, "Cannot open the file list %s.\n", listName );
+        return -1;
+    }
+
+    while ( ( status = getNextLine( line, listFile ) ) == 1 )
+    {
+        if ( *numFiles == size )
+        {
+            char** temp = realloc( *files, ( size = 2 * size + 64 ) * sizeof(char*) );
+            if ( temp == NULL )
+            {
+                status = -1;
+                break;
+            }
+            *files = temp;
+        }
+        if ( ( (*files)[*numFiles] = copyString( line, strlen(line) ) ) == NULL )
+        {
+            status = -1;
+            break;
+        }
+        (*numFiles)++;
+    }
+
+    fclose( listFile );
+    if ( status < 0 )
+        fprintf( stderr, "Cannot read the file list %s.\n", listName );
+    return status < 0 ? -1 : 0;
+}
+
+int main( int argc, char* argv[] )
+{
+    rule_t* rules = NULL;
+    long numRules = 0;
+    char** files = NULL;
+    int numFiles = 0;
+    const char* listName = NULL;
+    int numProcs = 1;
+    int dryRun = 0;
+    int ret = 0;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "nj:f:" ) ) != -1 )
+    {
+        if ( opt == 'n' )
+            dryRun = 1;
+        else if ( opt == 'j' )
+            numProcs = atoi( optarg );
+        else if ( opt == 'f' )
+            listName = optarg;
+        else
+            optind = argc + 1;
+    }
+    if ( optind >= argc || ( optind + 1 == argc && listName == NULL ) )
+    {
+        fprintf( stderr, "Usage: %s [-n] [-j procs] [-f inputFiles.txt] rules.txt [file.h5 ...]\n", argv[0] );
+        return 2;
+    }
+
+    numRules = readRules( argv[optind], &rules );
+    if ( numRules < 0 )
+        return 2;
+
+    for ( int i = optind + 1; i < argc; i++ )
+    {
+        char** temp = realloc( files, ( numFiles + 1 ) * sizeof(char*) );
+        if ( temp == NULL || ( temp[numFiles] = copyString( argv[i], strlen(argv[i]) ) ) == NULL )
+        {
+            fprintf( stderr, "Cannot allocate memory.\n" );
+            files = temp ? temp : files;
+            ret = 2;
+            goto done;
+        }
+        files = temp;
+        numFiles++;
+    }
+    if ( listName && readFileList( listName, &files, &numFiles ) < 0 )
+    {
+        ret = 2;
+        goto done;
+    }
+
+    /* Errors are reported per file, not by the library itself */
+    H5Eset_auto2( H5E_DEFAULT, NULL, NULL );
+
+    if ( numProcs <= 1 )
+    {
+        for ( int i = 0; i < numFiles; i++ )
+        {
+            int status = patchFile( files[i], rules, numRules, dryRun, stdout );
+            if ( status > ret ) ret = status;
+        }
+    }
+    else
+    {
+        /* Each file is patched in its own process with its own report. The reports are printed in the
+         * order of the files once their processes are done.
+         */
+        FILE** reports = calloc( numFiles, sizeof(FILE*) );
+        pid_t* pids = calloc( numFiles, sizeof(pid_t) );
+        int next = 0;
+        int printed = 0;
+
+        if ( ( reports == NULL || pids == NULL ) && numFiles )
+        {
+            fprintf( stderr, "Cannot allocate memory.\n" );
+            free(reports);
+            free(pids);
+            ret = 2;
+            goto done;
+        }
+
+        while ( printed < numFiles )
+        {
+            if ( next < numFiles && next - printed < numProcs )
+            {
+                fflush( stdout );
+                reports[next] = tmpfile();
+                pids[next] = reports[next] ? fork() : -1;
+                if ( pids[next] == 0 )
+                    _exit( patchFile( files[next], rules, numRules, dryRun, reports[next] ) );
+                if ( pids[next] < 0 )
+                {
+                    fprintf( stderr, "Cannot start patching %s.\n", files[next] );
+                    ret = 2;
+                }
+                next++;
+                continue;
+            }
+
+            if ( pids[printed] > 0 )
+            {
+                int wstatus = 0;
+                char buffer[65536];
+                size_t len;
+
+                if ( waitpid( pids[printed], &wstatus, 0 ) < 0 || !WIFEXITED(wstatus) )
+                    ret = 2;
+                else if ( WEXITSTATUS(wstatus) > ret )
+                    ret = WEXITSTATUS(wstatus);
+                rewind( reports[printed] );
+                while ( ( len = fread( buffer, 1, sizeof buffer, reports[printed] ) ) > 0 )
+                    fwrite( buffer, 1, len, stdout );
+            }
+            if ( reports[printed] ) fclose( reports[printed] );
+            printed++;
+        }
+
+        free(reports);
+        free(pids);
+    }
+
+done:
+    for ( int i = 0; i < numFiles; i++ )
+        free(files[i]);
+    free(files);
+    freeRules( rules, numRules );
+    return ret;
+}
+
+/*  getNextLine
+ *
+ *   DESCRIPTION:
+ *   As in h5_cha_attr.c: grabs the next file path in inputFile, skipping any line that starts with '#',
+ *   '\n', or ' ', and removes the trailing newline.
+ *
+ *   RETURN:
+ *      0: end of file
+ *      1: successfully obtain a line
+ *      -1: error
+ **/
+
+int getNextLine ( char* string, FILE* const inputFile )
+{
+    size_t len;
+
+    do
+    {
+        if ( fgets( string, STR_LEN, inputFile ) == NULL )
+        {
+            if ( feof(inputFile) != 0 )
+                return 0;
+            fprintf(stderr, "Unable to get next line.\n");
+            return -1;
+        }
+    } while ( string[0] == '#' || string[0] == '\n' || string[0] == ' ' );
+
+    len = strlen( string ) - 1;
+    if ( string[len] == '\n' || string[len] == ' ' )
+        string[len] = '\0';
+
+    return 1;
+}
@@ -6,5 +6,6 @@ __email__  = 'clipp2@illinois.edu.'
 ROOT_DIR = os.path.dirname( os.path.abspath( __file__ ) )
 ORBIT_INFO_TXT = os.path.join( ROOT_DIR, 'Orbit_Path_Time.txt' )
 ORBIT_INFO_JSON = os.path.join( ROOT_DIR, 'Orbit_Path_Time.json' )
+ORBIT_INFO_BIN = os.path.join( ROOT_DIR, 'orbit_info.bin' )
 LOG_FMT='%(asctime)s %(levelname)-8s [%(filename)s:%(lineno)d] %(message)s'
 LOG_DATE_FMT='%d-%m-%Y:%H:%M:%S'
@@ -1,6 +1,7 @@
 import sys, os
 import re
 import bfutils.constants as constants
+import bfutils.orbit_table as orbit_table
 import cPickle as pickle
 import json
 import logging
@@ -44,16 +45,19 @@ _orbit_limits = { 2000 : { 'start' : 1000, 'end' : 5528 }, \
 
 
 _orbit_info_dict = None
+_orbit_tables = {}
 
-def orbit_start( orbit, orbit_info=constants.ORBIT_INFO_JSON ):
+def orbit_start( orbit, orbit_info=None ):
     '''
 **DESCRIPTION:**  
-    This function finds the starting time of the orbit according to the Orbit_Path_Info.json file. Please
-    see the GitHub documentation on how to generate this file.
+    This function finds the starting time of the orbit according to the orbit table (orbit_info.bin) or
+    the Orbit_Path_Info.json file. Please see the GitHub documentation on how to generate these files.
+    The orbit table is mapped rather than parsed, so it is preferred when both are present.
     
 **ARGUMENTS:**  
     *orbit (int)* -- Orbit to find starting time of  
-    *orbit_info (str)*    -- Path to the orbit_info.json file
+    *orbit_info (str)*    -- Path to the orbit table or to the orbit_info.json file. By default, the
+                             orbit_info.bin or else the Orbit_Path_Time.json file of this package.
     
 **EFFECTS:**  
     None
@@ -63,6 +67,20 @@ def orbit_start( orbit, orbit_info=constants.ORBIT_INFO_JSON ):
     '''
     global _orbit_info_dict
 
+    if orbit_info is None:
+        if os.path.isfile( constants.ORBIT_INFO_BIN ):
+            orbit_info = constants.ORBIT_INFO_BIN
+        else:
+            orbit_info = constants.ORBIT_INFO_JSON
+
+    if not orbit_info.endswith( '.json' ):
+        if orbit_info not in _orbit_tables:
+            _orbit_tables[orbit_info] = orbit_table.OrbitTable( orbit_info )
+        try:
+            return _orbit_tables[orbit_info].window( orbit )[0]
+        except ValueError:
+            raise ValueError("Argument 'orbit' is outside the supported bounds.")
+
     if _orbit_info_dict is None:
         with open( orbit_info, 'rb' ) as f:
             _orbit_info_dict = json.load( f )
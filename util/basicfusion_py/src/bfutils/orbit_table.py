@@ -0,0 +1,123 @@
+'''
+Reader and writer of the orbit table (orbit_info.bin) used by the basicFusion program. The layout is
+defined in basicFusion/src/orbitTable.h: a header followed by one record per orbit from the first
+orbit on, so that an orbit is found by subtraction. The file is memory mapped read-only, so looking up
+an orbit neither parses nor loads the table. Files without the header (a bare array of records) are
+also read.
+'''
+
+import mmap
+import struct
+
+MAGIC = b'BFORBITS'
+VERSION = 1
+_header = struct.Struct( '<8sIIII' )
+# OInfo_t: orbit number, start year month day hour minute second, end year month day hour minute second
+_record = struct.Struct( '<IHBBBBBxHBBBBBx' )
+
+class OrbitTable(object):
+    '''
+**DESCRIPTION:**
+    A read-only view of an orbit table.
+**ARGUMENTS:**
+    *path (str)* -- Path to the orbit table.
+    '''
+    def __init__( self, path ):
+        with open( path, 'rb' ) as f:
+            self._map = mmap.mmap( f.fileno(), 0, access=mmap.ACCESS_READ )
+
+        size = len( self._map )
+        if size >= _header.size and self._map[0:len(MAGIC)] == MAGIC:
+            magic, version, recordSize, first, num = _header.unpack_from( self._map, 0 )
+            if version != VERSION or recordSize != _record.size:
+                self.close()
+                raise ValueError('{} is version {} with {} byte records. Version {} with {} byte records ' \
+                    'is supported.'.format( path, version, recordSize, VERSION, _record.size ))
+            if ( size - _header.size ) // _record.size < num:
+                self.close()
+                raise ValueError('{} is truncated.'.format( path ))
+            self._offset = _header.size
+            self._first = first
+            self._num = num
+            self._indexed = True
+        else:
+            if size == 0 or size % _record.size:
+                self.close()
+                raise ValueError('{} is not an orbit table.'.format( path ))
+            self._offset = 0
+            self._num = size // _record.size
+            self._first = _record.unpack_from( self._map, 0 )[0]
+            self._indexed = _record.unpack_from( self._map, ( self._num - 1 ) * _record.size )[0] == \
+                self._first + self._num - 1
+
+    def close( self ):
+        self._map.close()
+
+    def __enter__( self ):
+        return self
+
+    def __exit__( self, *args ):
+        self.close()
+
+    def _unpack( self, i ):
+        return _record.unpack_from( self._map, self._offset + i * _record.size )
+
+    def find( self, orbit ):
+        '''
+**DESCRIPTION:**
+    Looks up the record of an orbit.
+**ARGUMENTS:**
+    *orbit (int)* -- Terra orbit
+**RETURN:**
+    The tuple of OInfo_t fields. Raises ValueError if the table does not have the orbit.
+        '''
+        if self._indexed:
+            if self._first <= orbit < self._first + self._num:
+                rec = self._unpack( orbit - self._first )
+                if rec[0] == orbit:
+                    return rec
+        else:
+            for i in range( self._num ):
+                rec = self._unpack( i )
+                if rec[0] == orbit:
+                    return rec
+
+        raise ValueError("Orbit {} is not in the orbit table.".format( orbit ))
+
+    def window( self, orbit ):
+        '''
+**DESCRIPTION:**
+    Returns the start and end time of orbit.
+**ARGUMENTS:**
+    *orbit (int)* -- Terra orbit
+**RETURN:**
+    Tuple of strings (start, end) in the format yyyymmddHHMMSS.
+        '''
+        rec = self.find( orbit )
+        fmt = '{:04d}{:02d}{:02d}{:02d}{:02d}{:02d}'
+        return ( fmt.format( *rec[1:7] ), fmt.format( *rec[7:13] ) )
+
+def write_orbit_table( path, records ):
+    '''
+**DESCRIPTION:**
+    Writes an orbit table. Orbits missing between the lowest and the highest orbit of records are
+    stored as empty records.
+**ARGUMENTS:**
+    *path (str)*     -- Path of the new orbit table.
+    *records (list)* -- Tuples of the 13 OInfo_t fields, as returned by OrbitTable.find.
+**EFFECTS:**
+    Creates or overwrites path.
+**RETURN:**
+    None
+    '''
+    byOrbit = dict( ( rec[0], rec ) for rec in records )
+    if not byOrbit:
+        raise ValueError("No orbits were given.")
+    first = min( byOrbit )
+    num = max( byOrbit ) - first + 1
+    empty = ( 0, ) * 13
+
+    with open( path, 'wb' ) as f:
+        f.write( _header.pack( MAGIC, VERSION, _record.size, first, num ) )
+        for orbit in range( first, first + num ):
+            f.write( _record.pack( *byOrbit.get( orbit, empty ) ) )
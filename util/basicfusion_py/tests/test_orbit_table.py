@@ -0,0 +1,56 @@
+import bfutils.orbit_table as orbit_table
+import pytest
+import os
+
+# The orbit table shipped with basicFusion, written before the table had a header
+LEGACY_BIN = os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), '..', '..', '..', \
+    'metadata-input', 'data', 'Orbit_Path_Time.bin' )
+
+RECORDS = [ ( 1000, 2000, 2, 25, 0, 25, 7, 2000, 2, 25, 2, 4, 0 ), \
+            ( 1001, 2000, 2, 25, 2, 4, 0, 2000, 2, 25, 3, 42, 53 ), \
+            ( 1003, 2000, 2, 25, 5, 21, 46, 2000, 2, 25, 7, 0, 39 ) ]
+
+class TestOrbitTable(object):
+    def test_round_trip( self, tmpdir ):
+        path = str( tmpdir.join( 'orbit_info.bin' ) )
+        orbit_table.write_orbit_table( path, RECORDS )
+
+        with orbit_table.OrbitTable( path ) as table:
+            for rec in RECORDS:
+                assert table.find( rec[0] ) == rec
+            assert table.window( 1000 ) == ( '20000225002507', '20000225020400' )
+
+    def test_missing( self, tmpdir ):
+        path = str( tmpdir.join( 'orbit_info.bin' ) )
+        orbit_table.write_orbit_table( path, RECORDS )
+
+        with orbit_table.OrbitTable( path ) as table:
+            for orbit in [ 0, 999, 1002, 1004 ]:
+                with pytest.raises( ValueError ):
+                    table.find( orbit )
+
+    def test_version( self, tmpdir ):
+        path = str( tmpdir.join( 'orbit_info.bin' ) )
+        orbit_table.write_orbit_table( path, RECORDS )
+        with open( path, 'r+b' ) as f:
+            f.seek( 8 )
+            f.write( b'\x02' )
+
+        with pytest.raises( ValueError ):
+            orbit_table.OrbitTable( path )
+
+    def test_not_table( self, tmpdir ):
+        path = str( tmpdir.join( 'orbit_info.bin' ) )
+        with open( path, 'wb' ) as f:
+            f.write( b'not an orbit table' )
+
+        with pytest.raises( ValueError ):
+            orbit_table.OrbitTable( path )
+
+    @pytest.mark.skipif( not os.path.isfile( LEGACY_BIN ), reason='Orbit_Path_Time.bin is not available' )
+    def test_legacy( self ):
+        with orbit_table.OrbitTable( LEGACY_BIN ) as table:
+            assert table.window( 1000 )[0] == '20000225002507'
+            assert table.window( 85302 )[0] == '20151231234020'
+            with pytest.raises( ValueError ):
+                table.find( 85303 )
@@ -28,23 +28,8 @@ do { \
     } while(0)
 
 
-typedef struct OInfo {
-        
-    unsigned int orbit_number;
-    unsigned short start_year;
-    unsigned char  start_month;
-    unsigned char start_day;
-    unsigned char start_hour;
-    unsigned char start_minute;
-    unsigned char start_second;
-    unsigned short end_year;
-    unsigned char  end_month;
-    unsigned char end_day;
-    unsigned char end_hour;
-    unsigned char end_minute;
-    unsigned char end_second;
-
-} OInfo_t;
+/* OInfo_t and the layout of the orbit table are shared with basicFusion */
+#include "../../src/orbitTable.h"
 
 void usage() {
     printf("\nUSAGE:  gcc -o read_time_new.o read_time_new.c\n");
@@ -370,10 +355,41 @@ int convert2binary(char* orbitfile) {
     // }
 
 
-    /* Writing all the information to a binary file*/
+    /* Writing all the information to a binary file. The records are placed at orbit - firstOrbit so
+       that basicFusion can index the table directly. Orbits missing from the text file are left zero. */
+    orbitTableHeader_t header;
+    unsigned int firstOrbit = o_info_ptr[0].orbit_number;
+    unsigned int lastOrbit = o_info_ptr[0].orbit_number;
+
+    for(i = 1; i < t_index; i++) {
+        if(o_info_ptr[i].orbit_number < firstOrbit)
+            firstOrbit = o_info_ptr[i].orbit_number;
+        if(o_info_ptr[i].orbit_number > lastOrbit)
+            lastOrbit = o_info_ptr[i].orbit_number;
+    }
+
+    OInfo_t* table_ptr = calloc(lastOrbit - firstOrbit + 1, sizeof(OInfo_t));
+    if(table_ptr == NULL) {
+        free(o_info_ptr);
+        fclose(orbit_info);
+        FATAL_MSG("Failed to allocate the orbit table.\n");
+        return -1;
+    }
+    for(i = 0; i < t_index; i++)
+        table_ptr[o_info_ptr[i].orbit_number - firstOrbit] = o_info_ptr[i];
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ORBIT_TABLE_MAGIC, sizeof(header.magic));
+    header.version = ORBIT_TABLE_VERSION;
+    header.recordSize = sizeof(OInfo_t);
+    header.firstOrbit = firstOrbit;
+    header.numOrbits = lastOrbit - firstOrbit + 1;
+
     FILE * orbit_info_b = fopen("orbit_info.bin", "w+");
-    fwrite(o_info_ptr, sizeof(OInfo_t), (size_t)t_index, orbit_info_b);
+    fwrite(&header, sizeof(header), 1, orbit_info_b);
+    fwrite(table_ptr, sizeof(OInfo_t), (size_t)header.numOrbits, orbit_info_b);
     fclose(orbit_info_b);
+    free(table_ptr);
 
     
     /* Checking the binary file size */
@@ -383,17 +399,12 @@ int convert2binary(char* orbitfile) {
     fSize = ftell(new_orbit_info_b);
     rewind(new_orbit_info_b);
 
-
-    OInfo_t* test_orbit_ptr = NULL;
-    test_orbit_ptr = calloc(fSize/sizeof(OInfo_t), sizeof(OInfo_t));
-    size_t result = fread(test_orbit_ptr, sizeof(OInfo_t), fSize/sizeof(OInfo_t), new_orbit_info_b);
-    
-    if(result != fSize/sizeof(OInfo_t)) {
-        free(test_orbit_ptr);
+    if(fSize != (long)(sizeof(header) + header.numOrbits * sizeof(OInfo_t))) {
         free(o_info_ptr);
         fclose(orbit_info);
         fclose(new_orbit_info_b);
-        WARN_MSG("Memory deallocation was un-successful.\n");
+        WARN_MSG("orbit_info.bin is %ld bytes instead of %ld.\n", fSize,
+                 (long)(sizeof(header) + header.numOrbits * sizeof(OInfo_t)));
         return -1;
 
     }
@@ -420,7 +431,6 @@ int convert2binary(char* orbitfile) {
 
     // }
 
-    free(test_orbit_ptr);
     free(o_info_ptr);
     fclose(orbit_info);
     fclose(new_orbit_info_b);